@@ -0,0 +1,158 @@
+#include "agc.h"
+#include <string.h>
+
+#define UNITY_Q12               (1 << 12)
+#define UNITY_Q15               (1 << 15)
+// 10^(±1/20) and 10^(±1/40) in Q15: whole and half dB steps
+#define DB_UP_Q15               36766
+#define DB_DOWN_Q15             29205
+#define HALF_DB_UP_Q15          34710
+#define HALF_DB_DOWN_Q15        30935
+
+static inline int16_t saturate16(int64_t value)
+{
+    return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t)value;
+}
+
+/**
+ * @brief Scale a value by db whole decibels
+ */
+static int32_t scale_db(int32_t value, int db)
+{
+    for (; db > 0; db--) {
+        value = (int32_t)(((int64_t)value * DB_UP_Q15 + UNITY_Q15 / 2) >> 15);
+    }
+    for (; db < 0; db++) {
+        value = (int32_t)(((int64_t)value * DB_DOWN_Q15 + UNITY_Q15 / 2) >> 15);
+    }
+    return value;
+}
+
+static uint32_t isqrt(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+bool agc_init(agc_t *agc, uint32_t sample_rate, int target_dbfs, int max_gain_db)
+{
+    if ((sample_rate != 8000 && sample_rate != AGC_MAX_RATE) || target_dbfs < -40 || target_dbfs > 0 ||
+        max_gain_db < 0 || max_gain_db > AGC_MAX_GAIN_DB) {
+        return false;
+    }
+    memset(agc, 0, sizeof(*agc));
+    agc->sample_rate = sample_rate;
+    agc->lookahead = (uint16_t)(AGC_LOOKAHEAD_MS * sample_rate / 1000);
+    agc->target = scale_db(INT16_MAX, target_dbfs);
+    agc->gate = scale_db(INT16_MAX, AGC_GATE_DBFS);
+    agc->ceiling = scale_db(INT16_MAX, AGC_CEILING_DBFS);
+    agc->min_gain = scale_db(UNITY_Q12, AGC_MIN_GAIN_DB);
+    agc->max_gain = scale_db(UNITY_Q12, max_gain_db);
+    agc->limiter_release = (int32_t)(((int64_t)AGC_LOOKAHEAD_MS << 15) /
+                                     (AGC_LOOKAHEAD_MS + AGC_LIMITER_RELEASE_MS));
+    // Start as if the talker were at the target, so the first words are not boosted
+    agc->level = agc->target;
+    agc->gain = UNITY_Q12;
+    agc->limiter_gain = UNITY_Q15;
+    agc->delayed_limit = UNITY_Q15;
+    return true;
+}
+
+/**
+ * @brief Follow the block level and return the gain for the end of the block
+ */
+static int32_t update_gain(agc_t *agc, const int16_t *pcm, size_t samples)
+{
+    uint64_t energy = 0;
+    for (size_t i = 0; i < samples; i++) {
+        energy += (uint64_t)((int32_t)pcm[i] * pcm[i]);
+    }
+    int32_t rms = (int32_t)isqrt((uint32_t)(energy / samples));
+    // Pauses and background noise leave level and gain where speech put them
+    if (rms <= agc->gate) {
+        return agc->gain;
+    }
+
+    int32_t block_ms = (int32_t)(samples * 1000 / agc->sample_rate);
+    int32_t tau_ms = rms > agc->level ? AGC_ATTACK_MS : AGC_RELEASE_MS;
+    int32_t weight = (int32_t)(((int64_t)block_ms << 15) / (tau_ms + block_ms));
+    agc->level += (int32_t)(((int64_t)(rms - agc->level) * weight) >> 15);
+
+    int32_t gain = (int32_t)(((int64_t)agc->target << 12) / agc->level);
+    return gain < agc->min_gain ? agc->min_gain : gain > agc->max_gain ? agc->max_gain : gain;
+}
+
+void agc_process(agc_t *agc, int16_t *pcm, size_t samples)
+{
+    const size_t piece = agc->lookahead;
+    samples -= samples % piece;
+    if (samples == 0) {
+        return;
+    }
+    const int32_t start_gain = agc->gain;
+    const int32_t end_gain = update_gain(agc, pcm, samples);
+    int32_t gained[AGC_MAX_LOOKAHEAD];
+
+    for (size_t offset = 0; offset < samples; offset += piece) {
+        // Gain ramped across the whole block, so steps never click
+        int32_t peak = 0;
+        for (size_t i = 0; i < piece; i++) {
+            size_t n = offset + i;
+            int32_t gain = start_gain + (int32_t)((int64_t)(end_gain - start_gain) * (int64_t)(n + 1) / (int64_t)samples);
+            gained[i] = (int32_t)(((int64_t)pcm[n] * gain + UNITY_Q12 / 2) >> 12);
+            int32_t level = gained[i] < 0 ? -gained[i] : gained[i];
+            peak = level > peak ? level : peak;
+        }
+
+        // The limiter gain reaches what this piece needs before it is played
+        int32_t limit = peak > agc->ceiling ? (int32_t)(((int64_t)agc->ceiling << 15) / peak) : UNITY_Q15;
+        int32_t from = agc->limiter_gain;
+        // Rounded up, so the gain gets back to unity rather than just below it
+        int32_t to = from + (int32_t)(((int64_t)(UNITY_Q15 - from) * agc->limiter_release + UNITY_Q15 - 1) >> 15);
+        to = to < agc->delayed_limit ? to : agc->delayed_limit;
+        to = to < limit ? to : limit;
+
+        // Play the delayed piece; both ends of the ramp are within its limit
+        for (size_t i = 0; i < piece; i++) {
+            int32_t gain = from + (to - from) * (int32_t)(i + 1) / (int32_t)piece;
+            pcm[offset + i] = saturate16(((int64_t)agc->delay[i] * gain + UNITY_Q15 / 2) >> 15);
+            if (gain < UNITY_Q15) {
+                agc->limited++;
+            }
+        }
+        memcpy(agc->delay, gained, piece * sizeof(int32_t));
+        agc->delayed_limit = limit;
+        agc->limiter_gain = to;
+    }
+    agc->gain = end_gain;
+}
+
+int agc_gain_db(const agc_t *agc)
+{
+    int32_t step = UNITY_Q12;
+    int db = 0;
+
+    while (((int64_t)step * HALF_DB_UP_Q15 >> 15) <= agc->gain) {
+        step = (int32_t)(((int64_t)step * DB_UP_Q15) >> 15);
+        db++;
+    }
+    while (((int64_t)step * HALF_DB_DOWN_Q15 >> 15) > agc->gain) {
+        step = (int32_t)(((int64_t)step * DB_DOWN_Q15) >> 15);
+        db--;
+    }
+    return db;
+}
@@ -0,0 +1,136 @@
+#ifndef AGC_H
+#define AGC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief How fast the level follows a louder talker
+ */
+#ifndef AGC_ATTACK_MS
+#define AGC_ATTACK_MS               20
+#endif
+
+/**
+ * @brief How fast the level follows a quieter talker, and so how slowly the gain rises
+ */
+#ifndef AGC_RELEASE_MS
+#define AGC_RELEASE_MS              500
+#endif
+
+/**
+ * @brief Most the gain turns a loud talker down
+ */
+#ifndef AGC_MIN_GAIN_DB
+#define AGC_MIN_GAIN_DB             (-12)
+#endif
+
+/**
+ * @brief Block level below which level and gain are held
+ *
+ * Keeps pauses and background noise from being pulled up to speech level.
+ */
+#ifndef AGC_GATE_DBFS
+#define AGC_GATE_DBFS               (-50)
+#endif
+
+/**
+ * @brief Peak level the limiter lets through
+ */
+#ifndef AGC_CEILING_DBFS
+#define AGC_CEILING_DBFS            (-1)
+#endif
+
+/**
+ * @brief How far the limiter looks ahead; also the delay it adds
+ *
+ * Blocks passed to agc_process() are split into pieces of this length,
+ * so it must divide the 20 ms frame.
+ */
+#ifndef AGC_LOOKAHEAD_MS
+#define AGC_LOOKAHEAD_MS            5
+#endif
+
+/**
+ * @brief How fast the limiter lets go after a peak
+ */
+#ifndef AGC_LIMITER_RELEASE_MS
+#define AGC_LIMITER_RELEASE_MS      60
+#endif
+
+/**
+ * @brief Highest gain accepted by agc_init()
+ */
+#define AGC_MAX_GAIN_DB             30
+
+/**
+ * @brief Highest sample rate supported
+ */
+#define AGC_MAX_RATE                16000
+
+#define AGC_MAX_LOOKAHEAD           (AGC_LOOKAHEAD_MS * AGC_MAX_RATE / 1000)
+
+/**
+ * @brief Gain control state of one audio direction
+ *
+ * An automatic gain control followed by a look-ahead peak limiter, in
+ * fixed point. The gain is set once per block from an attack/release
+ * envelope of the block RMS and ramped across the block. The limiter
+ * holds the gained audio back by one look-ahead piece and ramps its own
+ * gain down before a peak arrives, so nothing above the ceiling is
+ * clipped.
+ */
+typedef struct {
+    int32_t delay[AGC_MAX_LOOKAHEAD];   ///< Gained samples waiting for the limiter
+    uint32_t sample_rate;
+    uint16_t lookahead;             ///< Samples per limiter piece
+    int32_t target;                 ///< RMS level aimed for
+    int32_t gate;                   ///< RMS level below which the gain is held
+    int32_t ceiling;                ///< Peak level the limiter allows
+    int32_t min_gain;               ///< Q12
+    int32_t max_gain;               ///< Q12
+    int32_t limiter_release;        ///< Share of the way back to unity per piece, Q15
+    int32_t level;                  ///< RMS envelope of the input
+    int32_t gain;                   ///< Gain at the end of the last block, Q12
+    int32_t limiter_gain;           ///< Limiter gain at the end of the last piece, Q15
+    int32_t delayed_limit;          ///< Largest limiter gain the delayed piece allows, Q15
+    uint32_t limited;               ///< Samples the limiter turned down since init
+} agc_t;
+
+/**
+ * @brief Reset for a new call
+ *
+ * @param sample_rate 8000 or 16000
+ * @param target_dbfs Level to bring speech to, -40 to 0. The level follows
+ *                    the louder syllables quickly and pauses slowly, so
+ *                    the long-term RMS of speech ends up a few dB lower.
+ * @param max_gain_db Most a quiet talker is turned up, 0 to AGC_MAX_GAIN_DB
+ * @return false for an unsupported rate, target or gain
+ */
+bool agc_init(agc_t *agc, uint32_t sample_rate, int target_dbfs, int max_gain_db);
+
+/**
+ * @brief Adjust the gain of a block in place
+ *
+ * The output lags the input by AGC_LOOKAHEAD_MS.
+ *
+ * @param samples A multiple of the look-ahead, such as a 20 ms frame;
+ *                samples after the last whole piece are left untouched
+ */
+void agc_process(agc_t *agc, int16_t *pcm, size_t samples);
+
+/**
+ * @brief Gain of the last block rounded to whole dB, without the limiter
+ */
+int agc_gain_db(const agc_t *agc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AGC_H
@@ -8,6 +8,8 @@
 #include <string.h>
 #include "web_server.h"
 #include "sip_manager.h"
+#include "call_latency.h"
+#include "audio_i2s.h"
 
 static const char *TAG = "app_controller";
 
@@ -23,8 +25,10 @@ static esp_event_loop_handle_t g_app_event_loop = NULL;
 // Forward declarations
 static void app_controller_update_uptime(void);
 static esp_err_t app_controller_transition_state(app_state_t new_state);
+static void app_controller_set_state_locked(app_state_t new_state);
 static void app_controller_log_state_transition(app_state_t old_state, app_state_t new_state);
 static void services_init_task(void *arg);
+static void app_controller_notify_sip_event(void *user_data);
 
 esp_err_t app_controller_init(void)
 {
@@ -120,6 +124,14 @@ static void services_init_task(void *arg)
         ESP_LOGE(TAG, "Failed to start web server: %s", esp_err_to_name(result));
     }
 
+    // Microphone and speaker, on boards with an I2S codec
+    result = audio_i2s_init();
+    if (result == ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGW(TAG, "No I2S pins configured - calls carry no audio");
+    } else if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up audio: %s", esp_err_to_name(result));
+    }
+
     // Start SIP manager
     if (config_manager_validate(&config) == CONFIG_VALIDATION_OK) {
         if (strlen(config.sip_user) > 0 && strlen(config.sip_domain) > 0) {
@@ -168,9 +180,14 @@ esp_err_t app_controller_start_event_loop(void)
         return ret;
     }
 
+    // SIP events are queued without blocking the SIP stack and handled here
+    sip_manager_register_event_notify(app_controller_notify_sip_event, xTaskGetCurrentTaskHandle());
+
     while (1) {
+        // Woken by SIP events, and at least once a second for the uptime
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        app_controller_process_sip_events();
         app_controller_update_uptime();
-        vTaskDelay(pdMS_TO_TICKS(1000));
     }
 
     return ESP_OK;
@@ -213,15 +230,19 @@ esp_err_t app_controller_handle_button_press(void)
         return ESP_ERR_INVALID_STATE;
     }
 
+    call_latency_mark(CALL_LATENCY_BUTTON_HANDLED);
     ESP_LOGI(TAG, "Handling button press event");
 
+    bool start_call = false;
+    bool end_call = false;
     if (xSemaphoreTake(g_state_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
         g_system_state.button_pressed = true;
 
         switch (g_system_state.app_state) {
             case APP_STATE_IDLE:
                 ESP_LOGI(TAG, "Button pressed in idle state - initiating call");
-                app_controller_transition_state(APP_STATE_CALLING);
+                start_call = true;
+                app_controller_set_state_locked(APP_STATE_CALLING);
                 g_system_state.call_start_time = esp_timer_get_time() / 1000000;
                 ERROR_REPORT_SYSTEM(ERROR_SEVERITY_INFO, "app_controller", ESP_OK, 
                                    "Call initiated by button press");
@@ -235,14 +256,15 @@ esp_err_t app_controller_handle_button_press(void)
 
             case APP_STATE_CONNECTED:
                 ESP_LOGI(TAG, "Button pressed during call - ending call");
-                app_controller_transition_state(APP_STATE_IDLE);
+                end_call = true;
+                app_controller_set_state_locked(APP_STATE_IDLE);
                 ERROR_REPORT_SYSTEM(ERROR_SEVERITY_INFO, "app_controller", ESP_OK, 
                                    "Call ended by button press");
                 break;
 
             case APP_STATE_ERROR:
                 ESP_LOGI(TAG, "Button pressed in error state - attempting recovery");
-                app_controller_transition_state(APP_STATE_IDLE);
+                app_controller_set_state_locked(APP_STATE_IDLE);
                 ERROR_REPORT_SYSTEM(ERROR_SEVERITY_INFO, "app_controller", ESP_OK, 
                                    "Error recovery initiated by button press");
                 break;
@@ -255,11 +277,27 @@ esp_err_t app_controller_handle_button_press(void)
 
         xSemaphoreGive(g_state_mutex);
     } else {
+        call_latency_end_attempt();
         ERROR_REPORT_SYSTEM(ERROR_SEVERITY_ERROR, "app_controller", ESP_ERR_TIMEOUT, 
                            "Failed to acquire state mutex for button press handling");
         return ESP_ERR_TIMEOUT;
     }
 
+    // SIP calls stay outside the state mutex, their state changes come back through it
+    if (start_call) {
+        esp_err_t call_result = sip_manager_start_call(NULL);
+        if (call_result != ESP_OK) {
+            call_latency_end_attempt();
+            ESP_LOGW(TAG, "Could not start call: %s", esp_err_to_name(call_result));
+        }
+    } else {
+        // Nothing is being set up, so there is no latency to record
+        call_latency_end_attempt();
+        if (end_call) {
+            sip_manager_end_call();
+        }
+    }
+
     return ESP_OK;
 }
 
@@ -313,6 +351,7 @@ esp_err_t app_controller_handle_sip_state_change(sip_state_t new_sip_state)
 
     ESP_LOGI(TAG, "SIP state changed to: %d", new_sip_state);
 
+    bool registration_failed = false;
     if (xSemaphoreTake(g_state_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
         g_system_state.sip_state = new_sip_state;
         g_system_state.sip_registered = (new_sip_state == SIP_STATE_REGISTERED ||
@@ -321,32 +360,42 @@ esp_err_t app_controller_handle_sip_state_change(sip_state_t new_sip_state)
 
         switch (new_sip_state) {
             case SIP_STATE_REGISTERED:
-                if (g_system_state.app_state == APP_STATE_INITIALIZING) {
-                    app_controller_transition_state(APP_STATE_IDLE);
+                // Also how a call ends: the SIP manager returns to registered
+                if (g_system_state.app_state == APP_STATE_INITIALIZING ||
+                    g_system_state.app_state == APP_STATE_ERROR ||
+                    g_system_state.app_state == APP_STATE_CALLING ||
+                    g_system_state.app_state == APP_STATE_CONNECTED) {
+                    app_controller_set_state_locked(APP_STATE_IDLE);
                 }
                 break;
 
             case SIP_STATE_CALLING:
                 if (g_system_state.app_state == APP_STATE_IDLE) {
-                    app_controller_transition_state(APP_STATE_CALLING);
+                    app_controller_set_state_locked(APP_STATE_CALLING);
                 }
                 break;
 
             case SIP_STATE_CONNECTED:
                 if (g_system_state.app_state == APP_STATE_CALLING) {
-                    app_controller_transition_state(APP_STATE_CONNECTED);
+                    app_controller_set_state_locked(APP_STATE_CONNECTED);
                 }
                 break;
 
             case SIP_STATE_IDLE:
                 if (g_system_state.app_state == APP_STATE_CALLING ||
                     g_system_state.app_state == APP_STATE_CONNECTED) {
-                    app_controller_transition_state(APP_STATE_IDLE);
+                    app_controller_set_state_locked(APP_STATE_IDLE);
                 }
                 break;
 
             case SIP_STATE_ERROR:
-                app_controller_handle_error(-1, "SIP error occurred");
+                // The SIP manager keeps retrying, the next registration recovers
+                registration_failed = true;
+                g_system_state.error_count++;
+                strncpy(g_system_state.last_error, "SIP registration failed",
+                        sizeof(g_system_state.last_error) - 1);
+                g_system_state.last_error[sizeof(g_system_state.last_error) - 1] = '\0';
+                app_controller_set_state_locked(APP_STATE_ERROR);
                 break;
 
             default:
@@ -358,6 +407,11 @@ esp_err_t app_controller_handle_sip_state_change(sip_state_t new_sip_state)
         return ESP_ERR_TIMEOUT;
     }
 
+    if (registration_failed) {
+        ERROR_REPORT_SYSTEM(ERROR_SEVERITY_WARNING, "app_controller", ESP_FAIL,
+                           "SIP registration failed, retrying");
+    }
+
     return ESP_OK;
 }
 
@@ -410,7 +464,7 @@ esp_err_t app_controller_handle_error(int error_code, const char *error_message)
         }
 
         if (g_system_state.app_state != APP_STATE_ERROR) {
-            app_controller_transition_state(APP_STATE_ERROR);
+            app_controller_set_state_locked(APP_STATE_ERROR);
         }
 
         xSemaphoreGive(g_state_mutex);
@@ -496,6 +550,54 @@ esp_err_t app_controller_reset_error_count(void)
     return ESP_OK;
 }
 
+static void app_controller_notify_sip_event(void *user_data)
+{
+    xTaskNotifyGive((TaskHandle_t)user_data);
+}
+
+void app_controller_process_sip_events(void)
+{
+    sip_event_data_t event;
+
+    while (sip_manager_poll_event(&event)) {
+        switch (event.event_type) {
+            case SIP_EVENT_REGISTERED:
+                app_controller_handle_sip_state_change(SIP_STATE_REGISTERED);
+                break;
+
+            case SIP_EVENT_REGISTRATION_FAILED:
+                app_controller_handle_sip_state_change(SIP_STATE_ERROR);
+                break;
+
+            case SIP_EVENT_CALL_STARTED:
+                app_controller_handle_sip_state_change(SIP_STATE_CALLING);
+                break;
+
+            case SIP_EVENT_CALL_CONNECTED:
+                app_controller_handle_sip_state_change(SIP_STATE_CONNECTED);
+                break;
+
+            case SIP_EVENT_CALL_ENDED:
+                app_controller_handle_sip_state_change(SIP_STATE_IDLE);
+                break;
+
+            case SIP_EVENT_CALL_FAILED:
+                ESP_LOGW(TAG, "SIP call failed (%d): %s", event.data.error.error_code,
+                         event.data.error.error_message);
+                app_controller_handle_sip_state_change(SIP_STATE_IDLE);
+                break;
+
+            case SIP_EVENT_DTMF_RECEIVED:
+                app_controller_handle_dtmf(event.data.dtmf.digit);
+                break;
+
+            default:
+                ESP_LOGW(TAG, "Unknown SIP event: %d", event.event_type);
+                break;
+        }
+    }
+}
+
 static void app_controller_update_uptime(void)
 {
     if (xSemaphoreTake(g_state_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
@@ -508,13 +610,7 @@ static void app_controller_update_uptime(void)
 static esp_err_t app_controller_transition_state(app_state_t new_state)
 {
     if (xSemaphoreTake(g_state_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        app_state_t old_state = g_system_state.app_state;
-        
-        if (old_state != new_state) {
-            g_system_state.app_state = new_state;
-            app_controller_log_state_transition(old_state, new_state);
-        }
-        
+        app_controller_set_state_locked(new_state);
         xSemaphoreGive(g_state_mutex);
         return ESP_OK;
     }
@@ -522,6 +618,22 @@ static esp_err_t app_controller_transition_state(app_state_t new_state)
     return ESP_ERR_TIMEOUT;
 }
 
+/**
+ * @brief Change the application state, with g_state_mutex already held
+ *
+ * The mutex is not recursive, so its holders must not go through
+ * app_controller_transition_state().
+ */
+static void app_controller_set_state_locked(app_state_t new_state)
+{
+    app_state_t old_state = g_system_state.app_state;
+
+    if (old_state != new_state) {
+        g_system_state.app_state = new_state;
+        app_controller_log_state_transition(old_state, new_state);
+    }
+}
+
 static void app_controller_log_state_transition(app_state_t old_state, app_state_t new_state)
 {
     ESP_LOGI(TAG, "State transition: %s -> %s", 
@@ -538,6 +650,7 @@ esp_err_t app_controller_stop(void)
     ESP_LOGI(TAG, "Stopping application controller");
 
     app_controller_transition_state(APP_STATE_ERROR);
+    sip_manager_register_event_notify(NULL, NULL);
 
     if (g_app_event_loop != NULL) {
         esp_event_loop_delete(g_app_event_loop);
@@ -117,6 +117,15 @@ esp_err_t app_controller_get_system_state(system_state_t *state);
  */
 esp_err_t app_controller_set_app_state(app_state_t new_state);
 
+/**
+ * @brief Handle the SIP events queued by the SIP manager
+ *
+ * The event loop calls this whenever the SIP manager signals an event.
+ * A return to SIP registered ends a call, and a failed registration
+ * puts the application in the error state until the next one succeeds.
+ */
+void app_controller_process_sip_events(void);
+
 /**
  * @brief Handle button press event
  * 
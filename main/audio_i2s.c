@@ -0,0 +1,177 @@
+#include "audio_i2s.h"
+#include "audio_ring.h"
+#include "rtp_engine.h"
+#include "driver/i2s_std.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "audio_i2s";
+
+#define AUDIO_I2S_PORT              I2S_NUM_0
+#define AUDIO_TASK_STACK_SIZE       3072
+#define AUDIO_TASK_PRIORITY         8       // Above the RTP task, the DMA must never wait
+#define AUDIO_IO_TIMEOUT_MS         (2 * RTP_ENGINE_FRAME_MS)
+#define AUDIO_STOP_WAIT_MS          (2 * AUDIO_IO_TIMEOUT_MS + RTP_ENGINE_FRAME_MS)  // A read and a write timing out
+
+static struct {
+    audio_ring_t capture;
+    audio_ring_t playback;
+    i2s_chan_handle_t tx;
+    i2s_chan_handle_t rx;
+    volatile bool running;
+    volatile bool task_running;
+    size_t frame_samples;
+    // Target of reads while the capture ring is full and source of silence while
+    // the playback ring is empty, so the DMA keeps running either way
+    int16_t scratch[AUDIO_RING_MAX_FRAME_SAMPLES];
+} s_audio;
+
+static void delete_channels(void)
+{
+    if (s_audio.tx != NULL) {
+        i2s_channel_disable(s_audio.tx);
+        i2s_del_channel(s_audio.tx);
+        s_audio.tx = NULL;
+    }
+    if (s_audio.rx != NULL) {
+        i2s_channel_disable(s_audio.rx);
+        i2s_del_channel(s_audio.rx);
+        s_audio.rx = NULL;
+    }
+}
+
+static void audio_task(void *arg)
+{
+    const size_t frame_bytes = s_audio.frame_samples * sizeof(int16_t);
+    const int64_t frame_us = (int64_t)RTP_ENGINE_FRAME_MS * 1000;
+    size_t done;
+
+    while (s_audio.running) {
+        // The driver's DMA buffers are copied straight into the ring slot
+        int16_t *slot = audio_ring_write_begin(&s_audio.capture);
+        int16_t *pcm = slot != NULL ? slot : s_audio.scratch;
+        if (i2s_channel_read(s_audio.rx, pcm, frame_bytes, &done, pdMS_TO_TICKS(AUDIO_IO_TIMEOUT_MS)) == ESP_OK &&
+            slot != NULL) {
+            // The read returns as the last sample of the frame arrives
+            audio_ring_write_end(&s_audio.capture, esp_timer_get_time() - frame_us);
+        }
+
+        const int16_t *play = audio_ring_read_begin(&s_audio.playback, NULL);
+        if (play == NULL) {
+            memset(s_audio.scratch, 0, frame_bytes);
+        }
+        i2s_channel_write(s_audio.tx, play != NULL ? play : s_audio.scratch, frame_bytes, &done,
+                          pdMS_TO_TICKS(AUDIO_IO_TIMEOUT_MS));
+        if (play != NULL) {
+            audio_ring_read_end(&s_audio.playback);
+        }
+    }
+
+    // Only the task knows when it is out of the driver
+    delete_channels();
+    s_audio.task_running = false;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Full-duplex standard I2S, mono 16-bit, one DMA buffer per frame
+ */
+static esp_err_t create_channels(uint32_t sample_rate)
+{
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(AUDIO_I2S_PORT, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = AUDIO_I2S_DMA_BUFFERS;
+    chan_cfg.dma_frame_num = s_audio.frame_samples;
+    chan_cfg.auto_clear = true;     // Silence rather than the last frame if the task is late
+
+    esp_err_t err = i2s_new_channel(&chan_cfg, &s_audio.tx, &s_audio.rx);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(sample_rate),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO),
+        .gpio_cfg = {
+            .mclk = AUDIO_I2S_MCLK_GPIO,
+            .bclk = AUDIO_I2S_BCLK_GPIO,
+            .ws = AUDIO_I2S_WS_GPIO,
+            .dout = AUDIO_I2S_DOUT_GPIO,
+            .din = AUDIO_I2S_DIN_GPIO,
+        },
+    };
+    err = i2s_channel_init_std_mode(s_audio.tx, &std_cfg);
+    if (err == ESP_OK) {
+        err = i2s_channel_init_std_mode(s_audio.rx, &std_cfg);
+    }
+    if (err == ESP_OK) {
+        err = i2s_channel_enable(s_audio.tx);
+    }
+    if (err == ESP_OK) {
+        err = i2s_channel_enable(s_audio.rx);
+    }
+    if (err != ESP_OK) {
+        delete_channels();
+    }
+    return err;
+}
+
+static void audio_stop(void *ctx)
+{
+    s_audio.running = false;
+    for (int waited = 0; s_audio.task_running && waited < AUDIO_STOP_WAIT_MS; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (s_audio.task_running) {
+        ESP_LOGW(TAG, "Audio task still in the driver, it deletes the channels on its way out");
+    }
+    ESP_LOGI(TAG, "Audio stopped: capture %lu overruns, playback %lu underruns",
+             (unsigned long)s_audio.capture.stats.overruns, (unsigned long)s_audio.playback.stats.underruns);
+}
+
+static esp_err_t audio_start(void *ctx, uint32_t sample_rate)
+{
+    if (s_audio.running || s_audio.task_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_audio.frame_samples = sample_rate * RTP_ENGINE_FRAME_MS / 1000;
+    if (!audio_ring_init(&s_audio.capture, (uint16_t)s_audio.frame_samples) ||
+        !audio_ring_init(&s_audio.playback, (uint16_t)s_audio.frame_samples)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = create_channels(sample_rate);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up I2S at %lu Hz: %s", (unsigned long)sample_rate, esp_err_to_name(err));
+        return err;
+    }
+
+    s_audio.running = true;
+    s_audio.task_running = true;
+    if (xTaskCreate(audio_task, "audio_i2s", AUDIO_TASK_STACK_SIZE, NULL, AUDIO_TASK_PRIORITY, NULL) != pdPASS) {
+        s_audio.running = false;
+        s_audio.task_running = false;
+        delete_channels();
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Audio started at %lu Hz, %u samples per frame", (unsigned long)sample_rate,
+             (unsigned)s_audio.frame_samples);
+    return ESP_OK;
+}
+
+esp_err_t audio_i2s_init(void)
+{
+    if (AUDIO_I2S_BCLK_GPIO < 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    const rtp_audio_device_t device = {
+        .start = audio_start,
+        .stop = audio_stop,
+        .capture = &s_audio.capture,
+        .playback = &s_audio.playback,
+        .ctx = NULL
+    };
+    return rtp_engine_set_audio_device(&device);
+}
@@ -0,0 +1,57 @@
+#ifndef AUDIO_I2S_H
+#define AUDIO_I2S_H
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Pins of the I2S audio codec, -1 where not connected
+ *
+ * Audio is off while the bit clock is -1, the default, as the pins depend
+ * on the board. Microphone and speaker share bit clock and word select.
+ */
+#ifndef AUDIO_I2S_BCLK_GPIO
+#define AUDIO_I2S_BCLK_GPIO         (-1)
+#endif
+#ifndef AUDIO_I2S_WS_GPIO
+#define AUDIO_I2S_WS_GPIO           (-1)
+#endif
+#ifndef AUDIO_I2S_DOUT_GPIO
+#define AUDIO_I2S_DOUT_GPIO         (-1)    ///< To the speaker amplifier
+#endif
+#ifndef AUDIO_I2S_DIN_GPIO
+#define AUDIO_I2S_DIN_GPIO          (-1)    ///< From the microphone
+#endif
+#ifndef AUDIO_I2S_MCLK_GPIO
+#define AUDIO_I2S_MCLK_GPIO         (-1)    ///< Only for codecs that need a master clock
+#endif
+
+/**
+ * @brief DMA buffers per direction, each one 20 ms frame
+ *
+ * The speaker side adds up to this many frames of delay.
+ */
+#ifndef AUDIO_I2S_DMA_BUFFERS
+#define AUDIO_I2S_DMA_BUFFERS       3
+#endif
+
+/**
+ * @brief Register the I2S codec as the audio device of the RTP engine
+ *
+ * The I2S channels are created at the rate of each call when its media
+ * starts and deleted when it ends. A task moves one DMA buffer per frame
+ * between the driver and the capture and playback rings the engine works
+ * on in place.
+ *
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED if no pins are configured
+ */
+esp_err_t audio_i2s_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_I2S_H
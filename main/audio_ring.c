@@ -0,0 +1,72 @@
+#include "audio_ring.h"
+#include <string.h>
+
+#define AUDIO_RING_MASK     (AUDIO_RING_FRAMES - 1)
+
+_Static_assert((AUDIO_RING_FRAMES & AUDIO_RING_MASK) == 0, "ring size must be a power of two");
+
+bool audio_ring_init(audio_ring_t *ring, uint16_t frame_samples)
+{
+    if (frame_samples == 0 || frame_samples > AUDIO_RING_MAX_FRAME_SAMPLES) {
+        return false;
+    }
+    memset(ring, 0, sizeof(*ring));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->frame_samples = frame_samples;
+    return true;
+}
+
+int16_t *audio_ring_write_begin(audio_ring_t *ring)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail >= AUDIO_RING_FRAMES) {
+        ring->stats.overruns++;
+        return NULL;
+    }
+    return ring->pcm[head & AUDIO_RING_MASK];
+}
+
+void audio_ring_write_end(audio_ring_t *ring, int64_t stamp_us)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned used = head - atomic_load_explicit(&ring->tail, memory_order_acquire) + 1;
+
+    ring->stamp_us[head & AUDIO_RING_MASK] = stamp_us;
+    ring->stats.frames_written++;
+    if (used > ring->stats.high_water) {
+        ring->stats.high_water = used;
+    }
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+int16_t *audio_ring_read_begin(audio_ring_t *ring, int64_t *stamp_us)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail) {
+        ring->stats.underruns++;
+        return NULL;
+    }
+    if (stamp_us != NULL) {
+        *stamp_us = ring->stamp_us[tail & AUDIO_RING_MASK];
+    }
+    return ring->pcm[tail & AUDIO_RING_MASK];
+}
+
+void audio_ring_read_end(audio_ring_t *ring)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    ring->stats.frames_read++;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+unsigned audio_ring_count(const audio_ring_t *ring)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
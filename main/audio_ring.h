@@ -0,0 +1,107 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Frames a ring holds, a power of two
+ *
+ * Audio waits at most this many frames between the I2S driver and the
+ * RTP task; 8 frames of 20 ms absorb the drift of the two clocks for
+ * minutes before a frame is lost.
+ */
+#ifndef AUDIO_RING_FRAMES
+#define AUDIO_RING_FRAMES           8
+#endif
+
+/**
+ * @brief Largest frame, 20 ms at 16 kHz
+ */
+#define AUDIO_RING_MAX_FRAME_SAMPLES    320
+
+/**
+ * @brief Ring counters
+ */
+typedef struct {
+    uint32_t frames_written;        ///< Frames the producer handed over
+    uint32_t frames_read;           ///< Frames the consumer released
+    uint32_t overruns;              ///< Producer found the ring full and lost a frame
+    uint32_t underruns;             ///< Consumer found the ring empty
+    uint32_t high_water;            ///< Most frames waiting at once
+} audio_ring_stats_t;
+
+/**
+ * @brief Single-producer single-consumer ring of audio frames
+ *
+ * Frames never move: the producer fills a slot in place (the I2S driver
+ * reads straight into it), hands it over by advancing an index, and the
+ * consumer processes and encodes it in the same slot before giving it
+ * back. Each frame carries a time stamp, for latency measurement. Slots
+ * are word aligned for DMA.
+ *
+ * Producer counters are written only by the producer and consumer
+ * counters only by the consumer, so either side may read them at any
+ * time for telemetry.
+ */
+typedef struct {
+    int16_t pcm[AUDIO_RING_FRAMES][AUDIO_RING_MAX_FRAME_SAMPLES] __attribute__((aligned(4)));
+    int64_t stamp_us[AUDIO_RING_FRAMES];
+    atomic_uint head;               ///< Next slot to fill, advanced by the producer
+    atomic_uint tail;               ///< Next slot to read, advanced by the consumer
+    uint16_t frame_samples;
+    audio_ring_stats_t stats;
+} audio_ring_t;
+
+/**
+ * @brief Empty the ring and clear its counters, while neither side uses it
+ *
+ * @param frame_samples Samples per frame, at most AUDIO_RING_MAX_FRAME_SAMPLES
+ * @return false for a frame size out of range
+ */
+bool audio_ring_init(audio_ring_t *ring, uint16_t frame_samples);
+
+/**
+ * @brief Slot to fill next, producer side
+ *
+ * Calling it again before audio_ring_write_end() returns the same slot.
+ *
+ * @return NULL if the ring is full, counted as an overrun
+ */
+int16_t *audio_ring_write_begin(audio_ring_t *ring);
+
+/**
+ * @brief Hand the filled slot to the consumer
+ *
+ * @param stamp_us Time the frame's first sample was captured or is due to be played
+ */
+void audio_ring_write_end(audio_ring_t *ring, int64_t stamp_us);
+
+/**
+ * @brief Oldest frame, consumer side
+ *
+ * @param stamp_us Set to the frame's time stamp; may be NULL
+ * @return NULL if the ring is empty, counted as an underrun
+ */
+int16_t *audio_ring_read_begin(audio_ring_t *ring, int64_t *stamp_us);
+
+/**
+ * @brief Give the frame taken by audio_ring_read_begin() back to the producer
+ */
+void audio_ring_read_end(audio_ring_t *ring);
+
+/**
+ * @brief Frames waiting for the consumer
+ */
+unsigned audio_ring_count(const audio_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_RING_H
@@ -0,0 +1,179 @@
+#include "call_latency.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * @brief The attempt being timed plus the collected histograms
+ */
+static struct {
+    bool open;
+    bool answered;
+    int64_t origin_us;
+    uint32_t stamped;               ///< Bit per phase already recorded in this attempt
+    call_latency_histograms_t hist;
+} s_latency;
+
+// Stamped from the button task, the event loop and the SIP task. The
+// critical sections are short enough for a spinlock.
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+uint32_t call_latency_bucket_index(uint32_t latency_us)
+{
+    if (latency_us < (1U << CALL_LATENCY_MIN_SHIFT)) {
+        return 0;
+    }
+    uint32_t exp = 31 - (uint32_t)__builtin_clz(latency_us);
+    uint32_t sub = (latency_us >> (exp - 2)) & (CALL_LATENCY_SUB_BUCKETS - 1);
+    uint32_t index = 1 + (exp - CALL_LATENCY_MIN_SHIFT) * CALL_LATENCY_SUB_BUCKETS + sub;
+
+    return index < CALL_LATENCY_BUCKETS ? index : CALL_LATENCY_BUCKETS - 1;
+}
+
+uint32_t call_latency_bucket_upper_us(uint32_t index)
+{
+    if (index == 0) {
+        return 1U << CALL_LATENCY_MIN_SHIFT;
+    }
+    if (index >= CALL_LATENCY_BUCKETS - 1) {
+        return UINT32_MAX;
+    }
+    uint32_t exp = CALL_LATENCY_MIN_SHIFT + (index - 1) / CALL_LATENCY_SUB_BUCKETS;
+    uint32_t sub = (index - 1) % CALL_LATENCY_SUB_BUCKETS;
+
+    return (1U << exp) + ((sub + 1) << (exp - 2));
+}
+
+uint32_t call_latency_percentile_us(const call_latency_histogram_t *hist, uint8_t percent)
+{
+    if (hist == NULL || hist->count == 0) {
+        return 0;
+    }
+    if (percent > 100) {
+        percent = 100;
+    }
+
+    // Rank of the sample the percentile refers to, rounded up
+    uint32_t rank = (uint32_t)(((uint64_t)hist->count * percent + 99) / 100);
+    uint32_t seen = 0;
+    uint32_t value = hist->max_us;
+
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (uint32_t i = 0; i < CALL_LATENCY_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            value = call_latency_bucket_upper_us(i);
+            break;
+        }
+    }
+
+    if (value > hist->max_us) {
+        value = hist->max_us;
+    }
+    if (value < hist->min_us) {
+        value = hist->min_us;
+    }
+    return value;
+}
+
+static void histogram_add(call_latency_histogram_t *hist, uint32_t latency_us)
+{
+    if (hist->count == 0 || latency_us < hist->min_us) {
+        hist->min_us = latency_us;
+    }
+    if (latency_us > hist->max_us) {
+        hist->max_us = latency_us;
+    }
+    hist->count++;
+    hist->sum_us += latency_us;
+    hist->buckets[call_latency_bucket_index(latency_us)]++;
+}
+
+/**
+ * @brief Close the open attempt; caller holds s_lock
+ */
+static void close_attempt(void)
+{
+    if (s_latency.open && !s_latency.answered) {
+        s_latency.hist.abandoned++;
+    }
+    s_latency.open = false;
+}
+
+/**
+ * @brief Start an attempt at the given phase; caller holds s_lock
+ */
+static void open_attempt(call_latency_phase_t phase, int64_t now_us)
+{
+    close_attempt();
+    s_latency.open = true;
+    s_latency.answered = false;
+    s_latency.origin_us = now_us;
+    s_latency.stamped = 1U << phase;
+    s_latency.hist.attempts++;
+}
+
+void call_latency_mark(call_latency_phase_t phase)
+{
+    call_latency_mark_at(phase, esp_timer_get_time());
+}
+
+void call_latency_mark_at(call_latency_phase_t phase, int64_t now_us)
+{
+    if ((unsigned)phase >= CALL_LATENCY_PHASE_COUNT) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+
+    if (s_latency.open && now_us - s_latency.origin_us > CALL_LATENCY_ATTEMPT_MAX_US) {
+        close_attempt();
+    }
+
+    // The button always starts a new attempt. Without one, the steps that
+    // begin a call do; a second INVITE means the previous call is over.
+    bool starts_call = phase <= CALL_LATENCY_INVITE_SENT;
+    if (phase == CALL_LATENCY_BUTTON_EDGE ||
+        (starts_call && (!s_latency.open || (s_latency.stamped & (1U << phase)) != 0))) {
+        open_attempt(phase, now_us);
+    } else if (s_latency.open && (s_latency.stamped & (1U << phase)) == 0) {
+        int64_t elapsed = now_us - s_latency.origin_us;
+        if (elapsed < 0) {
+            elapsed = 0;
+        }
+        s_latency.stamped |= 1U << phase;
+        histogram_add(&s_latency.hist.phase[phase], (uint32_t)elapsed);
+        if (phase == CALL_LATENCY_ANSWERED) {
+            s_latency.answered = true;
+        }
+    }
+
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void call_latency_end_attempt(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    close_attempt();
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void call_latency_get(call_latency_histograms_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    memcpy(out, &s_latency.hist, sizeof(*out));
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void call_latency_reset(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    memset(&s_latency, 0, sizeof(s_latency));
+    portEXIT_CRITICAL(&s_lock);
+}
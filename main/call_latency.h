@@ -0,0 +1,118 @@
+#ifndef CALL_LATENCY_H
+#define CALL_LATENCY_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Call setup phases, in the order a doorbell call passes them
+ */
+typedef enum {
+    CALL_LATENCY_BUTTON_EDGE = 0,   ///< Debounced button edge in io_manager
+    CALL_LATENCY_BUTTON_HANDLED,    ///< app_controller_handle_button_press() runs
+    CALL_LATENCY_INVITE_SENT,       ///< First INVITE on the wire
+    CALL_LATENCY_TRYING,            ///< First 100 Trying
+    CALL_LATENCY_RINGING,           ///< First 180/183
+    CALL_LATENCY_ANSWERED,          ///< First 200 OK
+    CALL_LATENCY_ACK_SENT,          ///< ACK for that 200 OK
+    CALL_LATENCY_FIRST_RTP,         ///< First RTP packet received
+    CALL_LATENCY_PHASE_COUNT
+} call_latency_phase_t;
+
+/**
+ * @brief Histogram layout
+ *
+ * Bucket 0 holds everything below 1.024 ms. Above that every power of two
+ * is split into CALL_LATENCY_SUB_BUCKETS linear buckets, so the relative
+ * error of a percentile stays below 25 %. The last bucket also takes
+ * everything beyond its lower bound (about 50 s).
+ */
+#define CALL_LATENCY_BUCKETS            64
+#define CALL_LATENCY_SUB_BUCKETS        4
+#define CALL_LATENCY_MIN_SHIFT          10
+
+/**
+ * @brief Phases stamped later than this after the start of an attempt drop the attempt
+ */
+#define CALL_LATENCY_ATTEMPT_MAX_US     (120LL * 1000 * 1000)
+
+/**
+ * @brief Latency distribution of one phase
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[CALL_LATENCY_BUCKETS];
+} call_latency_histogram_t;
+
+/**
+ * @brief Time from the start of a call attempt to each phase
+ *
+ * An attempt starts at the button edge. Calls that are not started by the
+ * button (web UI, tests) start at the first phase seen instead, which then
+ * has no entry of its own. phase[CALL_LATENCY_BUTTON_EDGE] always stays empty.
+ */
+typedef struct {
+    call_latency_histogram_t phase[CALL_LATENCY_PHASE_COUNT];
+    uint32_t attempts;              ///< Attempts started
+    uint32_t abandoned;             ///< Attempts that ended without being answered
+} call_latency_histograms_t;
+
+/**
+ * @brief Stamp a phase of the current attempt with the current time
+ *
+ * Safe to call from any task. Each phase is recorded at most once per
+ * attempt; repeats (retransmissions, further forked legs) are ignored.
+ */
+void call_latency_mark(call_latency_phase_t phase);
+
+/**
+ * @brief Stamp a phase with an explicit esp_timer timestamp
+ */
+void call_latency_mark_at(call_latency_phase_t phase, int64_t now_us);
+
+/**
+ * @brief Close the current attempt (call ended, failed or was not started)
+ */
+void call_latency_end_attempt(void);
+
+/**
+ * @brief Copy the histograms
+ */
+void call_latency_get(call_latency_histograms_t *out);
+
+/**
+ * @brief Clear the histograms and drop the current attempt
+ */
+void call_latency_reset(void);
+
+/**
+ * @brief Bucket a latency falls into
+ */
+uint32_t call_latency_bucket_index(uint32_t latency_us);
+
+/**
+ * @brief Exclusive upper bound of a bucket in microseconds
+ */
+uint32_t call_latency_bucket_upper_us(uint32_t index);
+
+/**
+ * @brief Estimate a percentile from a histogram
+ *
+ * @param hist Histogram
+ * @param percent Percentile, 1..100
+ * @return Upper bound of the bucket holding the percentile, clamped to the
+ *         observed min/max; 0 for an empty histogram
+ */
+uint32_t call_latency_percentile_us(const call_latency_histogram_t *hist, uint8_t percent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CALL_LATENCY_H
@@ -0,0 +1,45 @@
+#include "comfort_noise.h"
+#include <math.h>
+
+#define FULL_SCALE_RMS          32767.0f    // 0 dBov
+#define SQRT_3                  1.7320508f  // Peak over RMS of uniform noise
+
+void comfort_noise_init(comfort_noise_t *cn, uint32_t seed)
+{
+    cn->seed = seed != 0 ? seed : 0x2545f491u;
+    cn->amplitude = 0;
+    cn->level = COMFORT_NOISE_MAX_LEVEL;
+}
+
+bool comfort_noise_receive(comfort_noise_t *cn, const uint8_t *payload, size_t len)
+{
+    // Reflection coefficients may follow the level (RFC 3389 section 3); white noise ignores them
+    if (len < 1 || payload[0] > COMFORT_NOISE_MAX_LEVEL) {
+        return false;
+    }
+    cn->level = payload[0];
+    cn->amplitude = cn->level == COMFORT_NOISE_MAX_LEVEL ? 0 :
+                    (int32_t)(FULL_SCALE_RMS * SQRT_3 * powf(10.0f, -cn->level / 20.0f) + 0.5f);
+    cn->amplitude = cn->amplitude > INT16_MAX ? INT16_MAX : cn->amplitude;
+    return true;
+}
+
+size_t comfort_noise_write(uint8_t level, uint8_t *payload)
+{
+    payload[0] = level > COMFORT_NOISE_MAX_LEVEL ? COMFORT_NOISE_MAX_LEVEL : level;
+    return COMFORT_NOISE_PAYLOAD_SIZE;
+}
+
+void comfort_noise_generate(comfort_noise_t *cn, int16_t *pcm, size_t samples)
+{
+    uint32_t x = cn->seed;
+
+    for (size_t i = 0; i < samples; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        // Uniform over -amplitude to amplitude
+        pcm[i] = (int16_t)(((int32_t)(x >> 16) - 32768) * cn->amplitude >> 15);
+    }
+    cn->seed = x;
+}
@@ -0,0 +1,67 @@
+#ifndef COMFORT_NOISE_H
+#define COMFORT_NOISE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Quietest level, in -dBov; it means no noise at all
+ */
+#define COMFORT_NOISE_MAX_LEVEL     127
+
+/**
+ * @brief Largest payload written, the level byte alone
+ */
+#define COMFORT_NOISE_PAYLOAD_SIZE  1
+
+/**
+ * @brief Comfort noise generator of one received stream
+ *
+ * Fills the pauses of a far end that stops sending during silence
+ * (RFC 3389), so the line does not sound dead. The noise is white at
+ * the level of the last comfort noise packet; the spectral shape an RFC
+ * 3389 payload may carry is ignored.
+ */
+typedef struct {
+    uint32_t seed;                  ///< State of the xorshift generator
+    int32_t amplitude;              ///< Peak of the uniform noise
+    uint8_t level;                  ///< Level in -dBov
+} comfort_noise_t;
+
+/**
+ * @brief Reset to silence
+ *
+ * @param seed Any value, 0 is replaced
+ */
+void comfort_noise_init(comfort_noise_t *cn, uint32_t seed);
+
+/**
+ * @brief Read the payload of a comfort noise packet
+ *
+ * @return false for an empty payload or a level above COMFORT_NOISE_MAX_LEVEL
+ */
+bool comfort_noise_receive(comfort_noise_t *cn, const uint8_t *payload, size_t len);
+
+/**
+ * @brief Write a comfort noise payload of model order 0: the level only
+ *
+ * @param level Noise level in -dBov
+ * @return Payload bytes
+ */
+size_t comfort_noise_write(uint8_t level, uint8_t *payload);
+
+/**
+ * @brief Generate noise at the received level
+ */
+void comfort_noise_generate(comfort_noise_t *cn, int16_t *pcm, size_t samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMFORT_NOISE_H
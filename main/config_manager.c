@@ -159,6 +159,41 @@ static bool is_valid_sip_uri(const char *uri) {
     return is_valid_domain(domain_part);
 }
 
+/**
+ * @brief Validate a comma-separated list of SIP callee URIs
+ */
+static bool is_valid_sip_callee_list(const char *list) {
+    char uri[64];
+    int count = 0;
+    
+    while (*list != '\0') {
+        while (*list == ' ' || *list == ',') {
+            list++;
+        }
+        if (*list == '\0') {
+            break;
+        }
+        
+        size_t len = strcspn(list, ",");
+        size_t trimmed = len;
+        while (trimmed > 0 && list[trimmed - 1] == ' ') {
+            trimmed--;
+        }
+        if (trimmed >= sizeof(uri) || ++count > CONFIG_MAX_SIP_CALLEES) {
+            return false;
+        }
+        
+        memcpy(uri, list, trimmed);
+        uri[trimmed] = '\0';
+        if (!is_valid_sip_uri(uri)) {
+            return false;
+        }
+        list += len;
+    }
+    
+    return count > 0;
+}
+
 /**
  * @brief Initialize secure NVS partition for sensitive data
  */
@@ -352,7 +387,7 @@ config_validation_error_t config_manager_validate(const door_station_config_t *c
     }
     
     // Validate SIP callee
-    if (strlen(config->sip_callee) > 0 && !is_valid_sip_uri(config->sip_callee)) {
+    if (strlen(config->sip_callee) > 0 && !is_valid_sip_callee_list(config->sip_callee)) {
         return CONFIG_VALIDATION_SIP_CALLEE_INVALID;
     }
     
@@ -9,6 +9,11 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Maximum number of callees rung in parallel
+ */
+#define CONFIG_MAX_SIP_CALLEES 4
+
 /**
  * @brief Configuration structure for the door station
  */
@@ -18,7 +23,7 @@ typedef struct {
     char sip_user[32];               ///< SIP username (3-31 characters, alphanumeric and underscore)
     char sip_domain[64];             ///< SIP domain (hostname or IP address)
     char sip_password[64];           ///< SIP password
-    char sip_callee[64];             ///< SIP callee URI
+    char sip_callee[160];            ///< SIP callee URI, or a comma-separated list rung in parallel
     uint16_t web_port;               ///< Web server port (1024-65535)
     uint32_t door_pulse_duration;    ///< Door relay pulse duration in ms (500-10000)
     uint32_t call_timeout;           ///< SIP call timeout in seconds
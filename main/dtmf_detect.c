@@ -0,0 +1,148 @@
+#include "dtmf_detect.h"
+#include <string.h>
+
+#define DTMF_TONES              8       // Four row tones, then four column tones
+
+// Weakest tone accepted, as peak amplitude: about -29 dBm0 when full scale is +3 dBm0
+#define DTMF_MIN_AMPLITUDE      800
+
+// Share of the block energy both tones must carry together, in percent
+#define DTMF_MIN_TONE_SHARE     60
+
+// Power of the strongest tone of a group over any other tone of the group (6 dB)
+#define DTMF_GROUP_PURITY       4
+
+// Twist as power ratio times ten: the column tone may be 4 dB above the
+// row tone, the row tone 8 dB above the column tone
+#define DTMF_MAX_TWIST_COL_X10  25
+#define DTMF_MAX_TWIST_ROW_X10  63
+
+// Frames without the held digit that end it
+#define DTMF_RELEASE_FRAMES     2
+
+/**
+ * @brief 2 cos(2 pi f / 8000) in Q14 for 697, 770, 852, 941, 1209, 1336, 1477 and 1633 Hz
+ */
+static const int32_t s_coeff[DTMF_TONES] = {
+    27980, 26956, 25701, 24219, 19073, 16325, 13085, 9315
+};
+
+static const char s_digits[4][4] = {
+    { '1', '2', '3', 'A' },
+    { '4', '5', '6', 'B' },
+    { '7', '8', '9', 'C' },
+    { '*', '0', '#', 'D' }
+};
+
+void dtmf_detector_init(dtmf_detector_t *detector)
+{
+    memset(detector, 0, sizeof(*detector));
+}
+
+/**
+ * @brief Index of the strongest tone of a group, or -1 if it is not clearly ahead
+ */
+static int strongest_tone(const int64_t *power)
+{
+    int best = 0;
+    for (int i = 1; i < 4; i++) {
+        if (power[i] > power[best]) {
+            best = i;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        if (i != best && power[i] * DTMF_GROUP_PURITY > power[best]) {
+            return -1;
+        }
+    }
+    return best;
+}
+
+char dtmf_detect_block(const int16_t *pcm, size_t samples)
+{
+    if (samples == 0 || samples > DTMF_DETECT_MAX_BLOCK) {
+        return '\0';
+    }
+
+    // Most frames are speech pauses: skip the filters unless there is
+    // enough energy for two tones at the minimum level
+    int64_t energy = 0;
+    for (size_t i = 0; i < samples; i++) {
+        energy += (int32_t)pcm[i] * pcm[i];
+    }
+    if (energy < (int64_t)DTMF_MIN_AMPLITUDE * DTMF_MIN_AMPLITUDE * (int64_t)samples) {
+        return '\0';
+    }
+
+    // Goertzel: s[n] = x[n] + coeff * s[n-1] - s[n-2], all eight filters in one pass.
+    // The state stays below 2^24 for blocks up to DTMF_DETECT_MAX_BLOCK.
+    int32_t s1[DTMF_TONES] = { 0 };
+    int32_t s2[DTMF_TONES] = { 0 };
+    for (size_t i = 0; i < samples; i++) {
+        int32_t x = pcm[i];
+        for (int k = 0; k < DTMF_TONES; k++) {
+            int32_t s0 = x + (int32_t)(((int64_t)s_coeff[k] * s1[k]) >> 14) - s2[k];
+            s2[k] = s1[k];
+            s1[k] = s0;
+        }
+    }
+
+    // |X(f)|^2, (A * N / 2)^2 for a tone of amplitude A
+    int64_t power[DTMF_TONES];
+    for (int k = 0; k < DTMF_TONES; k++) {
+        power[k] = (int64_t)s1[k] * s1[k] + (int64_t)s2[k] * s2[k] -
+                   (((int64_t)s_coeff[k] * s1[k]) >> 14) * s2[k];
+    }
+
+    int row = strongest_tone(&power[0]);
+    int col = strongest_tone(&power[4]);
+    if (row < 0 || col < 0) {
+        return '\0';
+    }
+    int64_t row_power = power[row];
+    int64_t col_power = power[4 + col];
+
+    int64_t min_power = (int64_t)DTMF_MIN_AMPLITUDE * (int64_t)samples / 2;
+    min_power *= min_power;
+    if (row_power < min_power || col_power < min_power) {
+        return '\0';
+    }
+    if (col_power * 10 > row_power * DTMF_MAX_TWIST_COL_X10 ||
+        row_power * 10 > col_power * DTMF_MAX_TWIST_ROW_X10) {
+        return '\0';
+    }
+    // A pure tone pair gives 2 (P_row + P_col) / (N * E) = 1; speech spreads wider
+    if ((row_power + col_power) * 200 < (int64_t)DTMF_MIN_TONE_SHARE * (int64_t)samples * energy) {
+        return '\0';
+    }
+    return s_digits[row][col];
+}
+
+char dtmf_detector_process(dtmf_detector_t *detector, const int16_t *pcm, size_t samples)
+{
+    char digit = dtmf_detect_block(pcm, samples);
+
+    if (detector->held != '\0') {
+        if (digit == detector->held) {
+            detector->gap_frames = 0;
+            return '\0';
+        }
+        // Ride out a single frame of dropout within the tone
+        if (++detector->gap_frames < DTMF_RELEASE_FRAMES) {
+            return '\0';
+        }
+        detector->held = '\0';
+        detector->candidate = '\0';
+        return '\0';
+    }
+
+    char previous = detector->candidate;
+    detector->candidate = digit;
+    if (digit == '\0' || digit != previous) {
+        return '\0';
+    }
+    detector->held = digit;
+    detector->gap_frames = 0;
+    detector->digits++;
+    return digit;
+}
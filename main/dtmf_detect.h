@@ -0,0 +1,62 @@
+#ifndef DTMF_DETECT_H
+#define DTMF_DETECT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Sample rate of the audio the detector works on
+ */
+#define DTMF_DETECT_SAMPLE_RATE     8000
+
+/**
+ * @brief Largest block dtmf_detect_block() accepts, 40 ms
+ */
+#define DTMF_DETECT_MAX_BLOCK       320
+
+/**
+ * @brief In-band DTMF detector state of one stream
+ *
+ * Fed with consecutive 20 ms frames. A digit is reported once it has been
+ * seen in two frames in a row, so tones of 50 ms or more are found at any
+ * frame alignment. The next digit needs two frames without it first.
+ */
+typedef struct {
+    char candidate;             ///< Digit of the previous frame, '\0' if none
+    char held;                  ///< Digit reported and still sounding, '\0' if none
+    uint8_t gap_frames;         ///< Frames without the held digit
+    uint32_t digits;            ///< Digits reported
+} dtmf_detector_t;
+
+/**
+ * @brief Reset the detector for a new call
+ */
+void dtmf_detector_init(dtmf_detector_t *detector);
+
+/**
+ * @brief Run one frame through the detector
+ *
+ * @return The digit 0-9, *, # or A-D when a tone has lasted long enough,
+ *         '\0' otherwise
+ */
+char dtmf_detector_process(dtmf_detector_t *detector, const int16_t *pcm, size_t samples);
+
+/**
+ * @brief Classify one block without duration checks
+ *
+ * Runs the eight Goertzel filters in fixed point and applies the level,
+ * twist, in-group purity and total energy checks.
+ *
+ * @return The digit the block carries, '\0' if none
+ */
+char dtmf_detect_block(const int16_t *pcm, size_t samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DTMF_DETECT_H
@@ -0,0 +1,122 @@
+#include "dtmf_trie.h"
+#include <string.h>
+
+#define DTMF_TRIE_ROOT  0
+
+/**
+ * @brief Child slot of a digit, -1 if it is not a keypad digit
+ */
+static int digit_index(char digit)
+{
+    if (digit >= '0' && digit <= '9') {
+        return digit - '0';
+    }
+    switch (digit) {
+    case '*': return 10;
+    case '#': return 11;
+    case 'A': case 'a': return 12;
+    case 'B': case 'b': return 13;
+    case 'C': case 'c': return 14;
+    case 'D': case 'd': return 15;
+    default: return -1;
+    }
+}
+
+bool dtmf_trie_valid_digit(char digit)
+{
+    return digit_index(digit) >= 0;
+}
+
+void dtmf_trie_clear(dtmf_trie_t *trie)
+{
+    memset(&trie->nodes[DTMF_TRIE_ROOT], 0, sizeof(trie->nodes[DTMF_TRIE_ROOT]));
+    trie->nodes[DTMF_TRIE_ROOT].entry = -1;
+    trie->node_count = 1;
+}
+
+bool dtmf_trie_add(dtmf_trie_t *trie, const char *sequence, int entry)
+{
+    size_t len = strlen(sequence);
+    if (len == 0 || len > DTMF_TRIE_MAX_SEQUENCE || entry < 0 || entry >= DTMF_TRIE_MAX_ENTRIES) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (digit_index(sequence[i]) < 0) {
+            return false;
+        }
+    }
+
+    uint8_t node = DTMF_TRIE_ROOT;
+    for (size_t i = 0; i < len; i++) {
+        int index = digit_index(sequence[i]);
+        if (trie->nodes[node].next[index] == 0) {
+            if (trie->node_count >= DTMF_TRIE_MAX_NODES) {
+                return false;
+            }
+            uint8_t child = (uint8_t)trie->node_count++;
+            memset(&trie->nodes[child], 0, sizeof(trie->nodes[child]));
+            trie->nodes[child].entry = -1;
+            trie->nodes[node].next[index] = child;
+            trie->nodes[node].children++;
+        }
+        node = trie->nodes[node].next[index];
+    }
+    if (trie->nodes[node].entry >= 0) {
+        return false;
+    }
+    trie->nodes[node].entry = (int8_t)entry;
+    return true;
+}
+
+void dtmf_trie_cursor_reset(dtmf_trie_cursor_t *cursor)
+{
+    cursor->node = DTMF_TRIE_ROOT;
+}
+
+bool dtmf_trie_pending(const dtmf_trie_cursor_t *cursor)
+{
+    return cursor->node != DTMF_TRIE_ROOT;
+}
+
+int dtmf_trie_feed(const dtmf_trie_t *trie, dtmf_trie_cursor_t *cursor, char digit,
+                   uint32_t now_ms, uint32_t timeout_ms)
+{
+    int index = digit_index(digit);
+    if (index < 0) {
+        dtmf_trie_cursor_reset(cursor);
+        return -1;
+    }
+    if (dtmf_trie_pending(cursor) && now_ms - cursor->last_digit_ms > timeout_ms) {
+        dtmf_trie_cursor_reset(cursor);
+    }
+
+    uint8_t next = trie->nodes[cursor->node].next[index];
+    if (next == 0 && dtmf_trie_pending(cursor)) {
+        // Not a continuation: the digit may start a new sequence
+        next = trie->nodes[DTMF_TRIE_ROOT].next[index];
+    }
+    if (next == 0) {
+        dtmf_trie_cursor_reset(cursor);
+        return -1;
+    }
+
+    cursor->node = next;
+    cursor->last_digit_ms = now_ms;
+    const dtmf_trie_node_t *node = &trie->nodes[next];
+    if (node->entry >= 0 && node->children == 0) {
+        dtmf_trie_cursor_reset(cursor);
+        return node->entry;
+    }
+    return -1;
+}
+
+int dtmf_trie_expire(const dtmf_trie_t *trie, dtmf_trie_cursor_t *cursor,
+                     uint32_t now_ms, uint32_t timeout_ms)
+{
+    if (!dtmf_trie_pending(cursor) || now_ms - cursor->last_digit_ms < timeout_ms) {
+        return -1;
+    }
+    int entry = trie->nodes[cursor->node].entry;
+    dtmf_trie_cursor_reset(cursor);
+    return entry;
+}
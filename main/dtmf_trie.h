@@ -0,0 +1,109 @@
+#ifndef DTMF_TRIE_H
+#define DTMF_TRIE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Longest digit sequence
+ */
+#define DTMF_TRIE_MAX_SEQUENCE      8
+
+/**
+ * @brief Most sequences one trie holds
+ */
+#define DTMF_TRIE_MAX_ENTRIES       16
+
+/**
+ * @brief Nodes needed when no two sequences share a prefix, plus the root
+ */
+#define DTMF_TRIE_MAX_NODES         (DTMF_TRIE_MAX_ENTRIES * DTMF_TRIE_MAX_SEQUENCE + 1)
+
+/**
+ * @brief Digits of the keypad: 0-9, *, # and A-D
+ */
+#define DTMF_TRIE_DIGITS            16
+
+typedef struct {
+    uint8_t next[DTMF_TRIE_DIGITS]; ///< Child per digit, 0 for none (the root is never a child)
+    uint8_t children;               ///< Number of children
+    int8_t entry;                   ///< Sequence ending here, -1 if none
+} dtmf_trie_node_t;
+
+/**
+ * @brief Digit sequences compiled into a trie over a fixed node pool
+ */
+typedef struct {
+    dtmf_trie_node_t nodes[DTMF_TRIE_MAX_NODES];
+    uint16_t node_count;
+} dtmf_trie_t;
+
+/**
+ * @brief Digits typed so far in one call
+ */
+typedef struct {
+    uint8_t node;               ///< Node reached, 0 when nothing is pending
+    uint32_t last_digit_ms;     ///< When the last digit arrived
+} dtmf_trie_cursor_t;
+
+/**
+ * @brief Remove all sequences
+ */
+void dtmf_trie_clear(dtmf_trie_t *trie);
+
+/**
+ * @brief Add a sequence
+ *
+ * @param sequence Digits, 1 to DTMF_TRIE_MAX_SEQUENCE of them
+ * @param entry Reported when the sequence is typed, 0 to DTMF_TRIE_MAX_ENTRIES - 1
+ * @return false if the sequence is empty, too long, has an invalid digit,
+ *         is already present or the node pool is full
+ */
+bool dtmf_trie_add(dtmf_trie_t *trie, const char *sequence, int entry);
+
+/**
+ * @brief Forget the digits typed so far
+ */
+void dtmf_trie_cursor_reset(dtmf_trie_cursor_t *cursor);
+
+/**
+ * @brief Advance by one digit
+ *
+ * A digit that continues no sequence starts over from the root, so a
+ * mistyped prefix does not block the next attempt. A sequence that is
+ * also the prefix of a longer one only completes when the timeout
+ * passes, see dtmf_trie_expire(). Input older than the timeout is
+ * discarded before the digit is taken.
+ *
+ * @return Entry of the sequence completed by this digit, -1 if none
+ */
+int dtmf_trie_feed(const dtmf_trie_t *trie, dtmf_trie_cursor_t *cursor, char digit,
+                   uint32_t now_ms, uint32_t timeout_ms);
+
+/**
+ * @brief End the input once the inter-digit timeout has passed
+ *
+ * @return Entry of the sequence typed so far if it is complete, -1 otherwise
+ */
+int dtmf_trie_expire(const dtmf_trie_t *trie, dtmf_trie_cursor_t *cursor,
+                     uint32_t now_ms, uint32_t timeout_ms);
+
+/**
+ * @brief Whether digits are waiting for more input or the timeout
+ */
+bool dtmf_trie_pending(const dtmf_trie_cursor_t *cursor);
+
+/**
+ * @brief Whether a character is a keypad digit
+ */
+bool dtmf_trie_valid_digit(char digit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DTMF_TRIE_H
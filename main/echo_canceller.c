@@ -0,0 +1,143 @@
+#include "echo_canceller.h"
+#include <math.h>
+#include <string.h>
+
+// Taps stay within ±1.0 so a tap times a sample fits 32 bits after the Q15 shift
+#define TAP_LIMIT               (1 << 30)
+#define TAP_SHIFT               15
+// Largest update factor, keeps one update within ±1.0 per tap
+#define GAIN_LIMIT              ((1 << 15) - 1)
+// Far-end level per sample below which the filter does not learn, about -60 dBFS
+#define QUIET_LEVEL             32
+#define HANGOVER_MS             30
+
+static inline int16_t saturate16(int32_t value)
+{
+    return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t)value;
+}
+
+bool echo_canceller_init(echo_canceller_t *aec, uint32_t sample_rate)
+{
+    if (sample_rate != 8000 && sample_rate != ECHO_CANCELLER_MAX_RATE) {
+        return false;
+    }
+    memset(aec, 0, sizeof(*aec));
+    aec->tap_count = (uint16_t)(ECHO_CANCELLER_TAIL_MS * sample_rate / 1000);
+    aec->regularization = (int64_t)aec->tap_count * QUIET_LEVEL * QUIET_LEVEL;
+    aec->hangover = (uint16_t)(HANGOVER_MS * sample_rate / 1000);
+    // The bulk delay starts out as silence in the queue
+    aec->fifo_count = (uint16_t)(ECHO_CANCELLER_BULK_DELAY_MS * sample_rate / 1000);
+    return true;
+}
+
+void echo_canceller_far_end(echo_canceller_t *aec, const int16_t *pcm, size_t samples)
+{
+    for (size_t i = 0; i < samples && aec->fifo_count < ECHO_CANCELLER_FIFO_SIZE; i++) {
+        aec->fifo[(aec->fifo_head + aec->fifo_count) % ECHO_CANCELLER_FIFO_SIZE] = pcm[i];
+        aec->fifo_count++;
+    }
+}
+
+static int16_t next_far_sample(echo_canceller_t *aec)
+{
+    if (aec->fifo_count == 0) {
+        return 0;
+    }
+    int16_t sample = aec->fifo[aec->fifo_head];
+    aec->fifo_head = (uint16_t)((aec->fifo_head + 1) % ECHO_CANCELLER_FIFO_SIZE);
+    aec->fifo_count--;
+    return sample;
+}
+
+/**
+ * @brief Loudest far-end sample the block can be compared against
+ *
+ * Covers the window and the queued samples the block will take, once per
+ * block rather than per sample.
+ */
+static int32_t far_peak(const echo_canceller_t *aec, size_t samples)
+{
+    const int16_t *x = &aec->history[aec->pos];
+    int32_t peak = 0;
+
+    for (unsigned i = 0; i < aec->tap_count; i++) {
+        int32_t level = x[i] < 0 ? -x[i] : x[i];
+        peak = level > peak ? level : peak;
+    }
+    for (size_t i = 0; i < samples && i < aec->fifo_count; i++) {
+        int32_t sample = aec->fifo[(aec->fifo_head + i) % ECHO_CANCELLER_FIFO_SIZE];
+        int32_t level = sample < 0 ? -sample : sample;
+        peak = level > peak ? level : peak;
+    }
+    return peak;
+}
+
+void echo_canceller_process(echo_canceller_t *aec, const int16_t *near, int16_t *out, size_t samples)
+{
+    const unsigned n = aec->tap_count;
+    const int32_t dtd_level = far_peak(aec, samples) * ECHO_CANCELLER_DTD_Q8;
+
+    for (size_t k = 0; k < samples; k++) {
+        // Slide the far-end window by one; the slot written twice is the one leaving
+        int16_t far = next_far_sample(aec);
+        aec->pos = (uint16_t)(aec->pos == 0 ? n - 1 : (unsigned)aec->pos - 1);
+        int16_t leaving = aec->history[aec->pos + n];
+        aec->far_energy += (int32_t)far * far - (int32_t)leaving * leaving;
+        aec->history[aec->pos] = far;
+        aec->history[aec->pos + n] = far;
+
+        const int16_t *x = &aec->history[aec->pos];
+        int32_t *taps = aec->taps;
+
+        int64_t acc = 0;
+        for (unsigned i = 0; i < n; i++) {
+            acc += (taps[i] >> TAP_SHIFT) * x[i];
+        }
+        int32_t mic = near[k];
+        int32_t error = mic - (int32_t)((acc + (1 << (TAP_SHIFT - 1))) >> TAP_SHIFT);
+        out[k] = saturate16(error);
+
+        bool far_active = aec->far_energy > aec->regularization;
+        if (far_active) {
+            aec->near_energy += (uint64_t)((int64_t)mic * mic);
+            aec->out_energy += (uint64_t)((int64_t)out[k] * out[k]);
+        }
+
+        // Geigel: the near end talks if it is louder than the echo could be
+        int32_t mic_level = mic < 0 ? -mic : mic;
+        if (mic_level * 256 > dtd_level && far_active) {
+            aec->hold = aec->hangover;
+        }
+        if (aec->hold > 0) {
+            aec->hold--;
+            aec->double_talk++;
+            continue;
+        }
+        if (!far_active) {
+            continue;
+        }
+
+        // NLMS: taps += step * error * x / |x|², all in Q30
+        int64_t gain = ((int64_t)ECHO_CANCELLER_STEP_Q15 * error * (1 << 15)) /
+                       (aec->far_energy + aec->regularization);
+        if (gain == 0) {
+            continue;
+        }
+        int32_t g = (int32_t)(gain > GAIN_LIMIT ? GAIN_LIMIT : gain < -GAIN_LIMIT ? -GAIN_LIMIT : gain);
+        for (unsigned i = 0; i < n; i++) {
+            int32_t tap = taps[i] + g * x[i];
+            taps[i] = tap > TAP_LIMIT ? TAP_LIMIT : tap < -TAP_LIMIT ? -TAP_LIMIT : tap;
+        }
+    }
+}
+
+float echo_canceller_erle_db(const echo_canceller_t *aec)
+{
+    if (aec->near_energy == 0) {
+        return 0;
+    }
+    if (aec->out_energy == 0) {
+        return 100;
+    }
+    return 10 * log10f((float)aec->near_energy / (float)aec->out_energy);
+}
@@ -0,0 +1,128 @@
+#ifndef ECHO_CANCELLER_H
+#define ECHO_CANCELLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Longest echo path the filter models, from speaker to microphone
+ *
+ * The cost is linear in it: 32 ms is 256 taps at 8 kHz and 512 at 16 kHz.
+ */
+#ifndef ECHO_CANCELLER_TAIL_MS
+#define ECHO_CANCELLER_TAIL_MS          32
+#endif
+
+/**
+ * @brief Delay the far end is held back by before the filter sees it
+ *
+ * For audio hardware whose output and input buffering add a fixed lag
+ * between playing a sample and capturing its echo, so the taps are not
+ * spent on it.
+ */
+#ifndef ECHO_CANCELLER_BULK_DELAY_MS
+#define ECHO_CANCELLER_BULK_DELAY_MS    0
+#endif
+
+/**
+ * @brief NLMS step size in Q15
+ */
+#ifndef ECHO_CANCELLER_STEP_Q15
+#define ECHO_CANCELLER_STEP_Q15         8192
+#endif
+
+/**
+ * @brief Double-talk threshold in Q8 of the far-end peak
+ *
+ * Adaptation pauses while the microphone is louder than this share of
+ * the loudest far-end sample in the tail (Geigel detector). 256 (0 dB)
+ * suits a speaker that couples to the microphone below the far-end level.
+ */
+#ifndef ECHO_CANCELLER_DTD_Q8
+#define ECHO_CANCELLER_DTD_Q8           256
+#endif
+
+/**
+ * @brief Highest sample rate supported
+ */
+#define ECHO_CANCELLER_MAX_RATE         16000
+
+/**
+ * @brief Most samples one call may pass, 20 ms at the highest rate
+ */
+#define ECHO_CANCELLER_MAX_BLOCK        320
+
+#define ECHO_CANCELLER_MAX_TAPS         (ECHO_CANCELLER_TAIL_MS * ECHO_CANCELLER_MAX_RATE / 1000)
+#define ECHO_CANCELLER_MAX_DELAY        (ECHO_CANCELLER_BULK_DELAY_MS * ECHO_CANCELLER_MAX_RATE / 1000)
+#define ECHO_CANCELLER_FIFO_SIZE        (2 * ECHO_CANCELLER_MAX_BLOCK + ECHO_CANCELLER_MAX_DELAY)
+
+/**
+ * @brief Echo canceller state of one call
+ *
+ * A time-domain NLMS filter in fixed point: Q30 taps, 16-bit samples and
+ * a 64-bit accumulator for the echo estimate. The far end is queued as it
+ * is played and taken sample for sample as the microphone is processed,
+ * so playback and capture must run in lock step, as they do in the RTP
+ * task.
+ */
+typedef struct {
+    int32_t taps[ECHO_CANCELLER_MAX_TAPS];          ///< Echo path estimate, Q30
+    int16_t history[2 * ECHO_CANCELLER_MAX_TAPS];   ///< Far end, mirrored so the window is contiguous
+    int16_t fifo[ECHO_CANCELLER_FIFO_SIZE];         ///< Far end played but not yet matched
+    uint16_t tap_count;
+    uint16_t pos;                   ///< Newest sample in history
+    uint16_t fifo_head;
+    uint16_t fifo_count;
+    uint16_t hangover;              ///< Samples adaptation stays paused after double talk
+    uint16_t hold;                  ///< Samples left of the current pause
+    int64_t far_energy;             ///< Sum of squares over the window
+    int64_t regularization;         ///< Added to far_energy, keeps quiet far ends from adapting
+    uint64_t near_energy;           ///< Microphone energy while the far end talked
+    uint64_t out_energy;            ///< Residual energy over the same samples
+    uint32_t double_talk;           ///< Samples adaptation was paused for
+} echo_canceller_t;
+
+/**
+ * @brief Reset for a new call
+ *
+ * @param sample_rate 8000 or 16000
+ * @return false for an unsupported rate
+ */
+bool echo_canceller_init(echo_canceller_t *aec, uint32_t sample_rate);
+
+/**
+ * @brief Queue far-end samples as they are played
+ *
+ * Samples beyond the queue size are dropped.
+ */
+void echo_canceller_far_end(echo_canceller_t *aec, const int16_t *pcm, size_t samples);
+
+/**
+ * @brief Remove the echo from microphone samples
+ *
+ * Takes as many far-end samples as it is given, silence if fewer were
+ * queued. near and out may be the same buffer.
+ *
+ * @param samples At most ECHO_CANCELLER_MAX_BLOCK
+ */
+void echo_canceller_process(echo_canceller_t *aec, const int16_t *near, int16_t *out, size_t samples);
+
+/**
+ * @brief Echo return loss enhancement since init, in dB
+ *
+ * Microphone over residual energy, counted only while the far end talks.
+ *
+ * @return 0 before the far end has talked
+ */
+float echo_canceller_erle_db(const echo_canceller_t *aec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ECHO_CANCELLER_H
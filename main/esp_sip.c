@@ -1,34 +1,1719 @@
 #include "esp_sip.h"
+#include "sip_message.h"
+#include "sip_transport.h"
+#include "sip_transaction.h"
+#include "sip_template.h"
+#include "sip_digest.h"
+#include "sip_dns.h"
+#include "sip_tls.h"
+#include "sip_arena.h"
+#include "sdp.h"
+#include "call_latency.h"
+#include "rtp_engine.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 static const char *TAG = "esp_sip";
 
+#define SIP_DEFAULT_PORT            5060
+#define SIP_DEFAULT_TLS_PORT        5061
+#define SIP_DEFAULT_EXPIRES_SEC     3600
+#define SIP_RTP_PORT                4000
+#define SIP_TASK_STACK_SIZE         6144
+#define SIP_TASK_PRIORITY           5
+#define SIP_POLL_INTERVAL_MS        10
+#define SIP_STOP_WAIT_MS            (SIP_TRANSPORT_CONNECT_TIMEOUT_MS + SIP_TLS_HANDSHAKE_TIMEOUT_MS + 500)   // Covers a re-dial in progress
+#define SIP_MAX_PENDING_EVENTS      4
+#define SIP_USER_AGENT              "OpenDoorStation"
+#define SIP_TOKEN_LEN               12      // Call-ID and tag length
+#define SIP_BRANCH_LEN              23      // z9hG4bK + 16 hex digits
+#define SIP_MAX_AUTH_RETRIES        2       // Fresh challenge plus one stale nonce
+#define SIP_AUTH_HEADER_SIZE        512
+#define SIP_MAX_CALL_LEGS           ESP_SIP_MAX_CALL_LEGS
+#define SIP_TARGET_LIST_LEN         256
+#define SIP_URI_LEN                 96      // Request-URI or Contact of a leg
+#define SIP_REMOTE_TAG_LEN          63
+#define SIP_KEEPALIVE_DEFAULT_SEC   120     // RFC 5626 section 4.4.1 suggests 95-120 s for TCP
+#define SIP_KEEPALIVE_PONG_MS       10000   // RFC 5626 section 4.4.1
+#define SIP_FLOW_RETRY_BASE_MS      2000
+#define SIP_FLOW_RETRY_MAX_MS       60000
+
+// Static pool behind the strings of the call legs, two blocks per leg
+#ifndef SIP_DIALOG_ARENA_SIZE
+#define SIP_DIALOG_ARENA_SIZE       (2 * SIP_MAX_CALL_LEGS * SIP_ARENA_BLOCK_SIZE)
+#endif
+
+/**
+ * @brief INVITE dialog states (UAC side only)
+ */
+typedef enum {
+    CALL_STATE_IDLE,
+    CALL_STATE_INVITING,        ///< INVITE sent, nothing heard back yet
+    CALL_STATE_EARLY,           ///< Provisional response received
+    CALL_STATE_CONFIRMED,       ///< 2xx received and acknowledged
+    CALL_STATE_CANCELLING       ///< CANCEL sent, waiting for the 487
+} call_state_t;
+
+typedef struct {
+    call_state_t state;
+    char call_id[40];
+    char local_tag[SIP_TOKEN_LEN + 1];
+    const char *remote_tag;     ///< "" until a response carries one
+    const char *request_uri;    ///< URI the INVITE was addressed to
+    const char *remote_target;  ///< Callee Contact, used for in-dialog requests
+    char invite_branch[SIP_BRANCH_LEN + 1];
+    uint32_t invite_cseq;
+    uint32_t local_cseq;
+    bool auth_sent;             ///< Current INVITE carried credentials
+    uint8_t auth_retries;       ///< INVITEs re-sent after a challenge
+    sip_timer_t cancel_timer;   ///< Gives up on a 487 that never comes
+    sip_arena_t arena;          ///< Holds the strings above, released with the leg
+} sip_dialog_t;
+
+/**
+ * @brief Event waiting to be delivered outside the client lock
+ */
+typedef struct {
+    esp_sip_event_data_t data;
+    char message[64];
+} pending_event_t;
+
 struct esp_sip_client {
-    esp_sip_config_t config;
+    char username[32];
+    char password[64];
+    char server[64];
+    uint16_t server_port;
+    uint16_t local_port;
+    esp_sip_transport_t transport_type;
+    uint32_t keepalive_interval_ms;
+    sip_tls_t *tls;             ///< Lives as long as the client so every dial can resume its session
+    uint32_t expires_sec;
+    char default_target[SIP_TARGET_LIST_LEN];  ///< Configured callee list, INVITE templates are compiled for it
+
     esp_sip_event_callback_t callback;
     void *user_data;
-    bool started;
+
+    SemaphoreHandle_t lock;
+    TaskHandle_t task;
+    volatile bool started;
+    volatile bool task_running;
+    sip_transport_t transport;
+    bool server_failed;         ///< Last REGISTER timed out, move to the next server of the domain
+
+    // TCP or TLS connection to the registrar, the RFC 5626 flow
+    bool flow_down;             ///< No connection, the SIP task re-dials at flow_retry_us
+    uint8_t flow_failures;      ///< Consecutive failed dials, drives the backoff
+    int64_t flow_retry_us;
+    int64_t keepalive_due_us;   ///< Next CRLF ping
+    int64_t pong_due_us;        ///< Deadline of the outstanding ping, 0 if none
+    uint32_t pongs_seen;        ///< transport.pongs already accounted for
+    bool pongs_answered;        ///< Server has answered a ping on this connection
+
+    // Registration
+    char reg_call_id[40];
+    char reg_tag[SIP_TOKEN_LEN + 1];
+    char reg_branch[SIP_BRANCH_LEN + 1];
+    uint32_t reg_cseq;
+    uint32_t reg_expires_requested;
+    uint32_t reg_expires_granted;
+    bool reg_pending;
+    bool registered;
+    bool reg_auth_sent;
+    uint8_t reg_auth_retries;
+
+    // Digest credentials with cached HA1 and nonce
+    sip_digest_t digest;
+    char auth_buf[SIP_AUTH_HEADER_SIZE];
+    esp_sip_stats_t stats;
+
+    // Outgoing call, one dialog per callee rung in parallel
+    sip_dialog_t legs[SIP_MAX_CALL_LEGS];
+    sip_arena_pool_t dialog_pool;
+    SIP_ARENA_POOL_STORAGE(dialog_storage, SIP_DIALOG_ARENA_SIZE);
+    uint8_t leg_count;
+    sip_dialog_t *answered;     ///< Leg that won the call, NULL until a 2xx
+    int64_t call_start_us;      ///< First INVITE of the call, legs are timed from here
+    uint16_t call_fail_status;  ///< Best final response of the failed legs so far
+    char call_fail_reason[48];
+
+    // Transactions and the timer wheel behind their retransmissions
+    sip_transaction_layer_t transactions;
+
+    // Requests pre-rendered at start, only per-message fields are patched
+    sip_template_t register_tpl;
+    sip_template_t invite_tpl[SIP_MAX_CALL_LEGS];
+    char invite_tpl_target[SIP_MAX_CALL_LEGS][96];
+    char sdp[384];
+    size_t sdp_len;
+    sdp_codec_list_t codecs;    ///< Offered in this order of preference
+    sdp_media_t media;          ///< Agreed with the answered leg, valid while media_agreed
+    bool media_agreed;
+    uint32_t sdp_session;
+
+    uint32_t branch_counter;
+    pending_event_t pending[SIP_MAX_PENDING_EVENTS];
+    uint8_t pending_count;
+
+    // Message buffers live with the client so a packet costs no heap
+    sip_message_t rx_msg;
+    char rx_buf[SIP_TRANSPORT_MAX_MSG_SIZE + 1];
+    char tx_buf[SIP_TRANSPORT_MAX_MSG_SIZE];
 };
 
+/**
+ * @brief Bounded append-only writer over a fixed buffer
+ */
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} sip_writer_t;
+
+// Forward declarations
+static void sip_task(void *arg);
+static void reset_leg(struct esp_sip_client *client, sip_dialog_t *call);
+static void reset_call(struct esp_sip_client *client);
+static void leg_failed(struct esp_sip_client *client, sip_dialog_t *call,
+                       uint16_t status, const char *reason);
+
+static void writer_printf(sip_writer_t *w, const char *fmt, ...)
+{
+    if (w->overflow) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(w->buf + w->len, w->size - w->len, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= w->size - w->len) {
+        w->overflow = true;
+        return;
+    }
+    w->len += (size_t)n;
+}
+
+static void writer_span(sip_writer_t *w, const sip_message_t *msg, sip_span_t span)
+{
+    if (w->overflow) {
+        return;
+    }
+    if ((size_t)span.len >= w->size - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, sip_span_ptr(msg, span), span.len);
+    w->len += span.len;
+    w->buf[w->len] = '\0';
+}
+
+/**
+ * @brief Random token of exactly SIP_TOKEN_LEN characters (Call-ID, tags)
+ */
+static void generate_token(char *out, size_t size)
+{
+    snprintf(out, size, "%08lx%04lx", (unsigned long)esp_random(),
+             (unsigned long)(esp_random() & 0xffff));
+}
+
+/**
+ * @brief Branch of exactly SIP_BRANCH_LEN characters so it fits template slots
+ */
+static void generate_branch(struct esp_sip_client *client, char *out, size_t size)
+{
+    // RFC 3261 magic cookie keeps the branch globally unique across stacks
+    snprintf(out, size, "z9hG4bK%08lx%08lx", (unsigned long)esp_random(),
+             (unsigned long)++client->branch_counter);
+}
+
+/**
+ * @brief Turn a configured callee into a full SIP URI
+ */
+static void normalize_uri(const char *in, const char *domain, char *out, size_t size)
+{
+    bool has_scheme = strncmp(in, "sip:", 4) == 0 || strncmp(in, "sips:", 5) == 0;
+    bool has_host = strchr(in, '@') != NULL;
+
+    snprintf(out, size, "%s%s%s%s", has_scheme ? "" : "sip:", in,
+             has_host ? "" : "@", has_host ? "" : domain);
+}
+
+/**
+ * @brief Copy the next entry of a comma-separated target list
+ *
+ * @return Position after the entry, NULL once the list is exhausted
+ */
+static const char *next_target(const char *list, char *out, size_t size)
+{
+    while (*list == ' ' || *list == ',') {
+        list++;
+    }
+    if (*list == '\0') {
+        return NULL;
+    }
+
+    size_t len = strcspn(list, ",");
+    size_t trimmed = len;
+    while (trimmed > 0 && list[trimmed - 1] == ' ') {
+        trimmed--;
+    }
+    if (trimmed >= size) {
+        trimmed = size - 1;
+    }
+    memcpy(out, list, trimmed);
+    out[trimmed] = '\0';
+    return list + len;
+}
+
+static void queue_event(struct esp_sip_client *client, esp_sip_event_t event,
+                        int code, const char *message)
+{
+    if (client->pending_count >= SIP_MAX_PENDING_EVENTS) {
+        ESP_LOGW(TAG, "Event queue full, dropping event %d", event);
+        return;
+    }
+    pending_event_t *pending = &client->pending[client->pending_count++];
+    memset(pending, 0, sizeof(*pending));
+    pending->data.event = event;
+    pending->data.data.error.code = code;
+    strncpy(pending->message, message ? message : "", sizeof(pending->message) - 1);
+}
+
+static void queue_dtmf(struct esp_sip_client *client, char digit)
+{
+    if (client->pending_count >= SIP_MAX_PENDING_EVENTS) {
+        ESP_LOGW(TAG, "Event queue full, dropping DTMF %c", digit);
+        return;
+    }
+    pending_event_t *pending = &client->pending[client->pending_count++];
+    memset(pending, 0, sizeof(*pending));
+    pending->data.event = ESP_SIP_EVENT_DTMF_RECEIVED;
+    pending->data.data.dtmf.digit = digit;
+}
+
+/**
+ * @brief Deliver queued events without holding the client lock
+ *
+ * Callbacks may call back into esp_sip (e.g. hang up on a DTMF command),
+ * so they must never run while the lock is held.
+ */
+static void dispatch_events(struct esp_sip_client *client)
+{
+    pending_event_t events[SIP_MAX_PENDING_EVENTS];
+    uint8_t count;
+
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    count = client->pending_count;
+    memcpy(events, client->pending, count * sizeof(pending_event_t));
+    client->pending_count = 0;
+    xSemaphoreGive(client->lock);
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (events[i].data.event != ESP_SIP_EVENT_DTMF_RECEIVED) {
+            events[i].data.data.error.message = events[i].message;
+        }
+        client->callback(&events[i].data, client->user_data);
+    }
+}
+
+/**
+ * @brief Leg whose dialog a message belongs to, NULL if none
+ */
+static sip_dialog_t *find_leg(struct esp_sip_client *client, const sip_message_t *msg,
+                              sip_span_t call_id)
+{
+    for (int i = 0; i < SIP_MAX_CALL_LEGS; i++) {
+        sip_dialog_t *call = &client->legs[i];
+        if (call->state != CALL_STATE_IDLE && sip_span_equals(msg, call_id, call->call_id)) {
+            return call;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Leg still waiting for its callee to answer
+ */
+static bool leg_ringing(const sip_dialog_t *call)
+{
+    return call->state == CALL_STATE_INVITING || call->state == CALL_STATE_EARLY;
+}
+
+/**
+ * @brief A call is answered or at least one leg is still ringing
+ *
+ * Legs waiting for the 487 to their CANCEL do not count.
+ */
+static bool call_in_progress(const struct esp_sip_client *client)
+{
+    if (client->answered != NULL) {
+        return true;
+    }
+    for (int i = 0; i < SIP_MAX_CALL_LEGS; i++) {
+        if (leg_ringing(&client->legs[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static esp_sip_leg_timing_t *leg_timing(struct esp_sip_client *client, const sip_dialog_t *call)
+{
+    return &client->stats.last_call_leg[call - client->legs];
+}
+
+static uint32_t call_elapsed_ms(const struct esp_sip_client *client)
+{
+    return (uint32_t)((esp_timer_get_time() - client->call_start_us) / 1000);
+}
+
+static void record_leg_final(struct esp_sip_client *client, const sip_dialog_t *call, uint16_t status)
+{
+    esp_sip_leg_timing_t *timing = leg_timing(client, call);
+
+    if (timing->status == 0) {
+        timing->status = status;
+        timing->final_ms = call_elapsed_ms(client);
+    }
+}
+
+static esp_err_t send_buffer(struct esp_sip_client *client, const sip_writer_t *w)
+{
+    if (w->overflow) {
+        ESP_LOGE(TAG, "Outgoing message exceeds %d bytes", SIP_TRANSPORT_MAX_MSG_SIZE);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ESP_LOGD(TAG, "Sending:\n%.*s", (int)w->len, w->buf);
+    return sip_transport_send(&client->transport, w->buf, w->len);
+}
+
+/**
+ * @brief Send a request inside a new client transaction
+ */
+static esp_err_t send_request(struct esp_sip_client *client, const char *data, size_t len,
+                              sip_method_t method, const char *branch, uint32_t cseq)
+{
+    ESP_LOGD(TAG, "Sending:\n%.*s", (int)len, data);
+    return sip_transaction_client_start(&client->transactions, method, branch, cseq,
+                                        data, len, NULL);
+}
+
+static esp_err_t send_writer_request(struct esp_sip_client *client, const sip_writer_t *w,
+                                     sip_method_t method, const char *branch, uint32_t cseq)
+{
+    if (w->overflow) {
+        ESP_LOGE(TAG, "Outgoing message exceeds %d bytes", SIP_TRANSPORT_MAX_MSG_SIZE);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return send_request(client, w->buf, w->len, method, branch, cseq);
+}
+
+static esp_err_t transport_send_hook(void *ctx, const char *data, size_t len)
+{
+    struct esp_sip_client *client = (struct esp_sip_client *)ctx;
+    return sip_transport_send(&client->transport, data, len);
+}
+
+/**
+ * @brief Timer B/F expiry: the request never got a final response
+ */
+static void transaction_timeout_hook(void *ctx, const sip_transaction_t *transaction)
+{
+    struct esp_sip_client *client = (struct esp_sip_client *)ctx;
+
+    if (transaction->method == SIP_METHOD_REGISTER && client->reg_pending &&
+        strcmp(transaction->branch, client->reg_branch) == 0) {
+        ESP_LOGW(TAG, "REGISTER timed out");
+        client->server_failed = true;
+        client->reg_pending = false;
+        client->registered = false;
+        client->reg_expires_granted = 0;
+        queue_event(client, ESP_SIP_EVENT_REGISTRATION_FAILED, 408, "Request Timeout");
+    } else if (transaction->method == SIP_METHOD_INVITE) {
+        for (int i = 0; i < SIP_MAX_CALL_LEGS; i++) {
+            sip_dialog_t *call = &client->legs[i];
+            if (call->state == CALL_STATE_INVITING && strcmp(transaction->branch, call->invite_branch) == 0) {
+                ESP_LOGW(TAG, "INVITE to %s timed out", call->request_uri);
+                leg_failed(client, call, 408, "Request Timeout");
+                break;
+            }
+        }
+    }
+}
+
+static void cancel_timer_callback(sip_timer_t *timer, void *arg)
+{
+    struct esp_sip_client *client = (struct esp_sip_client *)arg;
+
+    for (int i = 0; i < SIP_MAX_CALL_LEGS; i++) {
+        sip_dialog_t *call = &client->legs[i];
+        if (&call->cancel_timer == timer && call->state == CALL_STATE_CANCELLING) {
+            ESP_LOGW(TAG, "No final response after CANCEL, dropping leg to %s", call->request_uri);
+            reset_leg(client, call);
+        }
+    }
+}
+
+/**
+ * @brief Whether the registrar is reached over one kept-open connection (TCP or TLS)
+ */
+static bool use_stream(const struct esp_sip_client *client)
+{
+    return client->transport_type != ESP_SIP_TRANSPORT_UDP;
+}
+
+static const char *via_transport(const struct esp_sip_client *client)
+{
+    switch (client->transport_type) {
+    case ESP_SIP_TRANSPORT_TCP:
+        return "TCP";
+    case ESP_SIP_TRANSPORT_TLS:
+        return "TLS";
+    default:
+        return "UDP";
+    }
+}
+
+/**
+ * @brief URI parameters of our Contact, so the server reaches us over the same transport
+ */
+static const char *contact_params(const struct esp_sip_client *client)
+{
+    switch (client->transport_type) {
+    case ESP_SIP_TRANSPORT_TCP:
+        return ";transport=tcp";
+    case ESP_SIP_TRANSPORT_TLS:
+        return ";transport=tls";
+    default:
+        return "";
+    }
+}
+
+static sip_dns_transport_t dns_transport(const struct esp_sip_client *client)
+{
+    switch (client->transport_type) {
+    case ESP_SIP_TRANSPORT_TCP:
+        return SIP_DNS_TRANSPORT_TCP;
+    case ESP_SIP_TRANSPORT_TLS:
+        return SIP_DNS_TRANSPORT_TLS;
+    default:
+        return SIP_DNS_TRANSPORT_UDP;
+    }
+}
+
+static void write_via(struct esp_sip_client *client, sip_writer_t *w, const char *branch)
+{
+    writer_printf(w, "Via: SIP/2.0/%s %s:%u;branch=%s;rport\r\n", via_transport(client),
+                  client->transport.local_ip, client->transport.local_port, branch);
+}
+
+static int write_sdp(struct esp_sip_client *client, char *out, size_t size)
+{
+    sdp_offer_t offer = {
+        .username = client->username,
+        .session_id = client->sdp_session,
+        .session_name = SIP_USER_AGENT,
+        .address = client->transport.local_ip,
+        .port = SIP_RTP_PORT,
+        .codecs = &client->codecs
+    };
+    return sdp_write_offer(out, size, &offer);
+}
+
+static void template_via(struct esp_sip_client *client, sip_template_t *tpl)
+{
+    sip_template_append(tpl, "Via: SIP/2.0/%s %s:%u;branch=", via_transport(client),
+                        client->transport.local_ip, client->transport.local_port);
+    sip_template_field(tpl, SIP_TEMPLATE_FIELD_BRANCH, SIP_BRANCH_LEN);
+    sip_template_append(tpl, ";rport\r\n");
+}
+
+/**
+ * @brief Pre-render REGISTER; only branch, CSeq and Expires change per send
+ */
+static esp_err_t compile_register_template(struct esp_sip_client *client)
+{
+    sip_template_t *tpl = &client->register_tpl;
+
+    sip_template_begin(tpl);
+    sip_template_append(tpl, "REGISTER sip:%s SIP/2.0\r\n", client->server);
+    template_via(client, tpl);
+    sip_template_append(tpl,
+                        "Max-Forwards: 70\r\n"
+                        "From: <sip:%s@%s>;tag=%s\r\n"
+                        "To: <sip:%s@%s>\r\n"
+                        "Call-ID: %s\r\n"
+                        "CSeq: ",
+                        client->username, client->server, client->reg_tag,
+                        client->username, client->server,
+                        client->reg_call_id);
+    sip_template_field(tpl, SIP_TEMPLATE_FIELD_CSEQ, SIP_TEMPLATE_CSEQ_WIDTH);
+    sip_template_append(tpl,
+                        " REGISTER\r\n"
+                        "Contact: <sip:%s@%s:%u%s>\r\n"
+                        "Expires: ",
+                        client->username, client->transport.local_ip, client->transport.local_port,
+                        contact_params(client));
+    sip_template_field(tpl, SIP_TEMPLATE_FIELD_EXPIRES, SIP_TEMPLATE_EXPIRES_WIDTH);
+    sip_template_append(tpl, "\r\nUser-Agent: " SIP_USER_AGENT "\r\n");
+    return sip_template_end(tpl);
+}
+
+/**
+ * @brief Pre-render INVITE for one target; branch, tag, Call-ID and CSeq are patched
+ *
+ * Each leg has its own slot, so ringing the configured callees in
+ * parallel renders every INVITE without compiling.
+ */
+static esp_err_t compile_invite_template(struct esp_sip_client *client, int slot, const char *target)
+{
+    sip_template_t *tpl = &client->invite_tpl[slot];
+
+    sip_template_begin(tpl);
+    sip_template_append(tpl, "INVITE %s SIP/2.0\r\n", target);
+    template_via(client, tpl);
+    sip_template_append(tpl, "Max-Forwards: 70\r\nFrom: <sip:%s@%s>;tag=",
+                        client->username, client->server);
+    sip_template_field(tpl, SIP_TEMPLATE_FIELD_TAG, SIP_TOKEN_LEN);
+    sip_template_append(tpl, "\r\nTo: <%s>\r\nCall-ID: ", target);
+    sip_template_field(tpl, SIP_TEMPLATE_FIELD_CALL_ID, SIP_TOKEN_LEN);
+    sip_template_append(tpl, "\r\nCSeq: ");
+    sip_template_field(tpl, SIP_TEMPLATE_FIELD_CSEQ, SIP_TEMPLATE_CSEQ_WIDTH);
+    sip_template_append(tpl,
+                        " INVITE\r\n"
+                        "Contact: <sip:%s@%s:%u%s>\r\n"
+                        "Allow: INVITE, ACK, BYE, CANCEL, OPTIONS, INFO\r\n"
+                        "User-Agent: " SIP_USER_AGENT "\r\n"
+                        "Content-Type: application/sdp\r\n",
+                        client->username, client->transport.local_ip, client->transport.local_port,
+                        contact_params(client));
+
+    esp_err_t ret = sip_template_end(tpl);
+    if (ret == ESP_OK) {
+        strncpy(client->invite_tpl_target[slot], target, sizeof(client->invite_tpl_target[slot]) - 1);
+    } else {
+        ESP_LOGE(TAG, "INVITE to %s exceeds the %d byte template", target, SIP_TEMPLATE_MAX_SIZE);
+        client->invite_tpl_target[slot][0] = '\0';
+    }
+    return ret;
+}
+
+/**
+ * @brief Render the templates that depend on the configuration and local address
+ */
+static esp_err_t compile_templates(struct esp_sip_client *client)
+{
+    int len = write_sdp(client, client->sdp, sizeof(client->sdp));
+    if (len < 0 || (size_t)len >= sizeof(client->sdp)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    client->sdp_len = (size_t)len;
+
+    esp_err_t ret = compile_register_template(client);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    const char *list = client->default_target;
+    char entry[sizeof(client->invite_tpl_target[0])];
+    char target[sizeof(client->invite_tpl_target[0])];
+
+    for (int i = 0; i < SIP_MAX_CALL_LEGS; i++) {
+        client->invite_tpl_target[i][0] = '\0';
+    }
+    for (int i = 0; i < SIP_MAX_CALL_LEGS && (list = next_target(list, entry, sizeof(entry))) != NULL; i++) {
+        normalize_uri(entry, client->server, target, sizeof(target));
+        ret = compile_invite_template(client, i, target);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Pick the server the DNS cache prefers
+ *
+ * Only reads the cache, so it never blocks. The current server is kept
+ * while it is still listed; after a failure the next one is used.
+ *
+ * @return Target in servers, NULL when the domain is not cached
+ */
+static const sip_dns_target_t *preferred_server(struct esp_sip_client *client, sip_dns_result_t *servers)
+{
+    if (sip_dns_lookup_cached(client->server, client->server_port, dns_transport(client),
+                              servers) != ESP_OK || servers->count == 0) {
+        return NULL;
+    }
+
+    int index = 0;
+    for (int i = 0; i < servers->count; i++) {
+        if (servers->targets[i].addr == client->transport.remote_addr &&
+            servers->targets[i].port == client->transport.remote_port) {
+            index = i;
+            break;
+        }
+    }
+    if (client->server_failed) {
+        index = (index + 1) % servers->count;
+        client->server_failed = false;
+    }
+    if (servers->targets[index].addr != client->transport.remote_addr ||
+        servers->targets[index].port != client->transport.remote_port) {
+        ESP_LOGI(TAG, "Using server %d of %d for %s", index + 1, servers->count, client->server);
+    }
+    return &servers->targets[index];
+}
+
+/**
+ * @brief Point the transport at the server the DNS cache prefers
+ *
+ * A TCP or TLS connection is not re-dialled here, that would block the caller;
+ * the SIP task moves it.
+ */
+static void select_server(struct esp_sip_client *client)
+{
+    sip_dns_result_t servers;
+    const sip_dns_target_t *target = preferred_server(client, &servers);
+
+    if (target == NULL ||
+        (target->addr == client->transport.remote_addr && target->port == client->transport.remote_port)) {
+        return;
+    }
+
+    if (use_stream(client)) {
+        client->transport.remote_addr = target->addr;
+        client->transport.remote_port = target->port;
+        client->flow_down = true;
+        client->flow_retry_us = esp_timer_get_time();
+        return;
+    }
+
+    char local_ip[sizeof(client->transport.local_ip)];
+    memcpy(local_ip, client->transport.local_ip, sizeof(local_ip));
+    if (sip_transport_connect_addr(&client->transport, target->addr, target->port) != ESP_OK) {
+        return;
+    }
+
+    // Via, Contact and SDP carry the local address
+    if (strcmp(local_ip, client->transport.local_ip) != 0 && compile_templates(client) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to recompile SIP templates");
+    }
+}
+
+/**
+ * @brief Start the keepalive schedule of a fresh TCP connection
+ */
+static void schedule_keepalive(struct esp_sip_client *client, int64_t now_us)
+{
+    // 80-100 % of the interval, so stations behind one NAT drift apart (RFC 5626 section 4.4.1)
+    uint32_t delay_ms = client->keepalive_interval_ms / 100 * (80 + esp_random() % 21);
+    client->keepalive_due_us = now_us + (int64_t)delay_ms * 1000;
+}
+
+static void flow_connected(struct esp_sip_client *client)
+{
+    client->flow_down = false;
+    client->flow_failures = 0;
+    client->pong_due_us = 0;
+    client->pongs_seen = client->transport.pongs;
+    client->pongs_answered = false;
+    schedule_keepalive(client, esp_timer_get_time());
+}
+
+/**
+ * @brief Schedule the next dial after a failed one
+ *
+ * Exponential backoff randomized to 50-100 % as in RFC 5626 section 4.5,
+ * moving to the next server of the domain each time.
+ */
+static void flow_dial_failed(struct esp_sip_client *client)
+{
+    uint32_t shift = client->flow_failures < 5 ? client->flow_failures : 5;
+    uint32_t delay_ms = SIP_FLOW_RETRY_BASE_MS << shift;
+    if (delay_ms > SIP_FLOW_RETRY_MAX_MS) {
+        delay_ms = SIP_FLOW_RETRY_MAX_MS;
+    }
+    delay_ms = delay_ms / 2 + esp_random() % (delay_ms / 2 + 1);
+
+    if (client->flow_failures < UINT8_MAX) {
+        client->flow_failures++;
+    }
+    client->server_failed = true;
+    client->flow_down = true;
+    client->flow_retry_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+    ESP_LOGW(TAG, "Dialling the registrar again in %lu ms", (unsigned long)delay_ms);
+}
+
+/**
+ * @brief Drop a connection that failed; caller is the SIP task
+ *
+ * The binding named the connection, so the registration is gone with it.
+ */
+static void flow_lost(struct esp_sip_client *client, const char *reason)
+{
+    ESP_LOGW(TAG, "Connection to the registrar lost: %s", reason);
+    sip_transport_close(&client->transport);
+    client->flow_down = true;
+    client->flow_retry_us = esp_timer_get_time();
+    client->reg_pending = false;
+    if (client->registered) {
+        client->registered = false;
+        client->reg_expires_granted = 0;
+        queue_event(client, ESP_SIP_EVENT_REGISTRATION_FAILED, 503, "Connection lost");
+    }
+}
+
+/**
+ * @brief Send CRLF pings and watch for the pongs
+ */
+static void keepalive_tick(struct esp_sip_client *client, int64_t now_us)
+{
+    if (client->transport.pongs != client->pongs_seen) {
+        client->pongs_seen = client->transport.pongs;
+        if (client->pong_due_us != 0) {
+            client->stats.keepalive_pongs++;
+            client->pongs_answered = true;
+            client->pong_due_us = 0;
+        }
+    }
+
+    if (client->pong_due_us != 0 && now_us >= client->pong_due_us) {
+        client->pong_due_us = 0;
+        // Servers that never answer pings are only watched through TCP itself
+        if (client->pongs_answered) {
+            flow_lost(client, "keepalive not answered");
+            return;
+        }
+    }
+
+    if (now_us >= client->keepalive_due_us) {
+        schedule_keepalive(client, now_us);
+        if (sip_transport_send_keepalive(&client->transport) != ESP_OK) {
+            flow_lost(client, "keepalive not sent");
+            return;
+        }
+        client->stats.keepalives_sent++;
+        if (client->pong_due_us == 0) {
+            client->pong_due_us = now_us + (int64_t)SIP_KEEPALIVE_PONG_MS * 1000;
+        }
+    }
+}
+
+/**
+ * @brief Build credentials for a request from the cached challenge
+ *
+ * @return Header line in buf, or NULL when no challenge has been seen yet
+ */
+static const char *build_auth(struct esp_sip_client *client, sip_method_t method,
+                              const char *uri, char *buf, size_t size)
+{
+    if (!client->digest.has_challenge) {
+        return NULL;
+    }
+    if (sip_digest_authorize(&client->digest, method, uri, buf, size) != ESP_OK) {
+        ESP_LOGW(TAG, "Could not build %s credentials", sip_method_name(method));
+        return NULL;
+    }
+    return buf;
+}
+
+static esp_err_t send_register(struct esp_sip_client *client, uint32_t expires)
+{
+    char uri[sizeof(client->server) + 4];
+
+    client->reg_cseq++;
+    generate_branch(client, client->reg_branch, sizeof(client->reg_branch));
+
+    snprintf(uri, sizeof(uri), "sip:%s", client->server);
+    sip_template_values_t values = {
+        .branch = client->reg_branch,
+        .cseq = client->reg_cseq,
+        .expires = expires,
+        .auth = build_auth(client, SIP_METHOD_REGISTER, uri, client->auth_buf, sizeof(client->auth_buf))
+    };
+    client->reg_auth_sent = values.auth != NULL;
+    size_t len = 0;
+    esp_err_t ret = sip_template_render(&client->register_tpl, &values,
+                                        client->tx_buf, sizeof(client->tx_buf), &len);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to render REGISTER: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    client->reg_expires_requested = expires;
+    client->reg_pending = true;
+
+    ESP_LOGI(TAG, "Sending REGISTER (expires %lu)", (unsigned long)expires);
+    return send_request(client, client->tx_buf, len, SIP_METHOD_REGISTER,
+                        client->reg_branch, client->reg_cseq);
+}
+
+static esp_err_t send_invite(struct esp_sip_client *client, sip_dialog_t *call)
+{
+    int slot = (int)(call - client->legs);
+
+    // Calls to anyone but the configured callees pay for one compile
+    if (strcmp(call->request_uri, client->invite_tpl_target[slot]) != 0) {
+        esp_err_t ret = compile_invite_template(client, slot, call->request_uri);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    sip_template_values_t values = {
+        .branch = call->invite_branch,
+        .tag = call->local_tag,
+        .call_id = call->call_id,
+        .cseq = call->invite_cseq,
+        .auth = build_auth(client, SIP_METHOD_INVITE, call->request_uri,
+                           client->auth_buf, sizeof(client->auth_buf)),
+        .body = client->sdp,
+        .body_len = client->sdp_len
+    };
+    call->auth_sent = values.auth != NULL;
+    size_t len = 0;
+    esp_err_t ret = sip_template_render(&client->invite_tpl[slot], &values,
+                                        client->tx_buf, sizeof(client->tx_buf), &len);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to render INVITE: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    return send_request(client, client->tx_buf, len, SIP_METHOD_INVITE,
+                        call->invite_branch, call->invite_cseq);
+}
+
+/**
+ * @brief Send a request inside the call dialog (ACK for 2xx, BYE)
+ */
+static esp_err_t send_in_dialog(struct esp_sip_client *client, sip_dialog_t *call,
+                                sip_method_t method, uint32_t cseq)
+{
+    sip_writer_t w = { .buf = client->tx_buf, .size = sizeof(client->tx_buf) };
+    char branch[32];
+    const char *target = call->remote_target[0] ? call->remote_target : call->request_uri;
+
+    generate_branch(client, branch, sizeof(branch));
+
+    writer_printf(&w, "%s %s SIP/2.0\r\n", sip_method_name(method), target);
+    write_via(client, &w, branch);
+    writer_printf(&w,
+                  "Max-Forwards: 70\r\n"
+                  "From: <sip:%s@%s>;tag=%s\r\n"
+                  "To: <%s>;tag=%s\r\n"
+                  "Call-ID: %s\r\n"
+                  "CSeq: %lu %s\r\n"
+                  "User-Agent: " SIP_USER_AGENT "\r\n"
+                  "Content-Length: 0\r\n\r\n",
+                  client->username, client->server, call->local_tag,
+                  call->request_uri, call->remote_tag,
+                  call->call_id,
+                  (unsigned long)cseq, sip_method_name(method));
+
+    // ACK for a 2xx is end-to-end and never part of a transaction
+    if (method == SIP_METHOD_ACK) {
+        return send_buffer(client, &w);
+    }
+    return send_writer_request(client, &w, method, branch, cseq);
+}
+
+/**
+ * @brief Send CANCEL or the ACK for a non-2xx final response
+ *
+ * Both reuse the INVITE's branch and CSeq number (RFC 3261 9.1, 17.1.1.3).
+ */
+static esp_err_t send_invite_companion(struct esp_sip_client *client, sip_dialog_t *call,
+                                       sip_method_t method, sip_transaction_t *invite_tx)
+{
+    sip_writer_t w = { .buf = client->tx_buf, .size = sizeof(client->tx_buf) };
+
+    writer_printf(&w, "%s %s SIP/2.0\r\n", sip_method_name(method), call->request_uri);
+    write_via(client, &w, call->invite_branch);
+    writer_printf(&w,
+                  "Max-Forwards: 70\r\n"
+                  "From: <sip:%s@%s>;tag=%s\r\n",
+                  client->username, client->server, call->local_tag);
+    if (method == SIP_METHOD_ACK && call->remote_tag[0]) {
+        writer_printf(&w, "To: <%s>;tag=%s\r\n", call->request_uri, call->remote_tag);
+    } else {
+        writer_printf(&w, "To: <%s>\r\n", call->request_uri);
+    }
+    writer_printf(&w,
+                  "Call-ID: %s\r\n"
+                  "CSeq: %lu %s\r\n"
+                  "User-Agent: " SIP_USER_AGENT "\r\n"
+                  "Content-Length: 0\r\n\r\n",
+                  call->call_id,
+                  (unsigned long)call->invite_cseq, sip_method_name(method));
+
+    if (method == SIP_METHOD_CANCEL) {
+        return send_writer_request(client, &w, SIP_METHOD_CANCEL, call->invite_branch, call->invite_cseq);
+    }
+    if (w.overflow) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (invite_tx != NULL) {
+        return sip_transaction_client_ack(&client->transactions, invite_tx, w.buf, w.len);
+    }
+    return send_buffer(client, &w);
+}
+
+/**
+ * @brief Answer a request, echoing its Via/From/To/Call-ID/CSeq spans
+ */
+static esp_err_t send_response(struct esp_sip_client *client, sip_transaction_t *server_tx,
+                               const sip_message_t *req, int code, const char *reason,
+                               const char *body_type, const char *body)
+{
+    sip_writer_t w = { .buf = client->tx_buf, .size = sizeof(client->tx_buf) };
+    const sip_header_t *from = sip_message_get_header(req, SIP_HDR_FROM);
+    const sip_header_t *to = sip_message_get_header(req, SIP_HDR_TO);
+    const sip_header_t *call_id = sip_message_get_header(req, SIP_HDR_CALL_ID);
+    const sip_header_t *cseq = sip_message_get_header(req, SIP_HDR_CSEQ);
+
+    if (from == NULL || to == NULL || call_id == NULL || cseq == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    writer_printf(&w, "SIP/2.0 %d %s\r\n", code, reason);
+    for (uint8_t i = 0; i < req->header_count; i++) {
+        if (req->headers[i].id == SIP_HDR_VIA) {
+            writer_printf(&w, "Via: ");
+            writer_span(&w, req, req->headers[i].value);
+            writer_printf(&w, "\r\n");
+        }
+    }
+    writer_printf(&w, "From: ");
+    writer_span(&w, req, from->value);
+    writer_printf(&w, "\r\nTo: ");
+    writer_span(&w, req, to->value);
+
+    sip_span_t tag;
+    if (code > 100 && sip_message_get_param(req, to->value, "tag", &tag) != ESP_OK) {
+        const sip_dialog_t *call = find_leg(client, req, call_id->value);
+        const char *local_tag = call != NULL ? call->local_tag : client->reg_tag;
+        writer_printf(&w, ";tag=%s", local_tag);
+    }
+    writer_printf(&w, "\r\nCall-ID: ");
+    writer_span(&w, req, call_id->value);
+    writer_printf(&w, "\r\nCSeq: ");
+    writer_span(&w, req, cseq->value);
+    writer_printf(&w, "\r\nUser-Agent: " SIP_USER_AGENT "\r\n");
+
+    if (body != NULL) {
+        writer_printf(&w, "Contact: <sip:%s@%s:%u%s>\r\n", client->username,
+                      client->transport.local_ip, client->transport.local_port, contact_params(client));
+        writer_printf(&w, "Content-Type: %s\r\nContent-Length: %d\r\n\r\n%s",
+                      body_type, (int)strlen(body), body);
+    } else {
+        writer_printf(&w, "Content-Length: 0\r\n\r\n");
+    }
+
+    if (server_tx != NULL && !w.overflow) {
+        return sip_transaction_server_respond(&client->transactions, server_tx,
+                                              (uint16_t)code, w.buf, w.len);
+    }
+    return send_buffer(client, &w);
+}
+
+/**
+ * @brief Keep a string learned from a response in the leg's arena
+ *
+ * An unchanged value is not copied again, so retransmitted responses
+ * cost nothing. A value that is too long or finds no room leaves the
+ * previous one in place.
+ */
+static void dialog_set(sip_dialog_t *call, const char **field, const char *value, size_t len, size_t max)
+{
+    if (strlen(*field) == len && strncmp(*field, value, len) == 0) {
+        return;
+    }
+    char *copy = len <= max ? sip_arena_strndup(&call->arena, value, len) : NULL;
+    if (copy == NULL) {
+        ESP_LOGW(TAG, "Dropped %u bytes of dialog state for %s", (unsigned)len, call->request_uri);
+        return;
+    }
+    *field = copy;
+}
+
+static void reset_leg(struct esp_sip_client *client, sip_dialog_t *call)
+{
+    sip_timer_stop(&call->cancel_timer);
+    sip_arena_release(&call->arena);
+    memset(call, 0, sizeof(*call));
+    call->state = CALL_STATE_IDLE;
+    sip_arena_init(&call->arena, &client->dialog_pool);
+    call->remote_tag = "";
+    call->request_uri = "";
+    call->remote_target = "";
+    sip_timer_init(&call->cancel_timer, cancel_timer_callback, client);
+    if (client->answered == call) {
+        client->answered = NULL;
+        client->media_agreed = false;
+        rtp_engine_stop();
+    }
+}
+
+static void reset_call(struct esp_sip_client *client)
+{
+    for (int i = 0; i < SIP_MAX_CALL_LEGS; i++) {
+        reset_leg(client, &client->legs[i]);
+    }
+    client->leg_count = 0;
+}
+
+/**
+ * @brief CANCEL a leg that is still ringing
+ */
+static void cancel_leg(struct esp_sip_client *client, sip_dialog_t *call)
+{
+    send_invite_companion(client, call, SIP_METHOD_CANCEL, NULL);
+    call->state = CALL_STATE_CANCELLING;
+    sip_timer_start(&client->transactions.wheel, &call->cancel_timer,
+                    sip_timer_ms_to_ticks(64 * SIP_TIMER_T1_MS));
+}
+
+/**
+ * @brief A leg ended without an answer; the call fails with its last leg
+ *
+ * The reported response follows RFC 3261 16.7: a 6xx wins, otherwise the
+ * lowest response class seen on any leg.
+ */
+static void leg_failed(struct esp_sip_client *client, sip_dialog_t *call,
+                       uint16_t status, const char *reason)
+{
+    record_leg_final(client, call, status);
+    if (client->call_fail_status == 0 || status >= 600 ||
+        (client->call_fail_status < 600 && status / 100 < client->call_fail_status / 100)) {
+        client->call_fail_status = status;
+        strncpy(client->call_fail_reason, reason, sizeof(client->call_fail_reason) - 1);
+    }
+    reset_leg(client, call);
+
+    if (call_in_progress(client)) {
+        return;
+    }
+    ESP_LOGW(TAG, "Call failed: %u %s", client->call_fail_status, client->call_fail_reason);
+    queue_event(client, ESP_SIP_EVENT_CALL_FAILED, client->call_fail_status, client->call_fail_reason);
+}
+
+static void copy_reason(const sip_message_t *msg, char *out, size_t size)
+{
+    if (sip_span_copy(msg, msg->reason, out, size) != ESP_OK) {
+        // Reason phrases are informational, truncation is harmless
+        size_t n = msg->reason.len < size - 1 ? msg->reason.len : size - 1;
+        memcpy(out, sip_span_ptr(msg, msg->reason), n);
+        out[n] = '\0';
+    }
+}
+
+static bool is_challenge(const sip_message_t *msg)
+{
+    return msg->status_code == 401 || msg->status_code == 407;
+}
+
+/**
+ * @brief Take a 401/407 challenge if the request may be retried with credentials
+ *
+ * A request that already carried credentials is only retried when the
+ * server flags the nonce as stale or issues a new one; anything else
+ * means the credentials themselves are wrong.
+ */
+static bool accept_challenge(struct esp_sip_client *client, const sip_message_t *msg,
+                             bool auth_sent, uint8_t retries)
+{
+    char old_nonce[sizeof(client->digest.nonce)];
+    bool stale = false;
+
+    if (retries >= SIP_MAX_AUTH_RETRIES || client->digest.password[0] == '\0') {
+        return false;
+    }
+    strcpy(old_nonce, client->digest.nonce);
+    if (sip_digest_handle_challenge(&client->digest, msg, &stale) != ESP_OK) {
+        return false;
+    }
+    if (auth_sent && !stale && strcmp(old_nonce, client->digest.nonce) == 0) {
+        sip_digest_clear_challenge(&client->digest);
+        return false;
+    }
+    client->stats.auth_challenges++;
+    return true;
+}
+
+/**
+ * @brief Binding lifetime from a 2xx to REGISTER
+ *
+ * The expires parameter of our own Contact wins over the Expires header;
+ * without either the registrar accepted the requested value.
+ */
+static uint32_t granted_expires(struct esp_sip_client *client, const sip_message_t *msg)
+{
+    char user_part[sizeof(client->username) + 5];
+    uint32_t value;
+
+    snprintf(user_part, sizeof(user_part), "sip:%s@", client->username);
+    for (uint8_t i = 0; i < msg->header_count; i++) {
+        const sip_header_t *header = &msg->headers[i];
+        sip_span_t uri;
+        sip_span_t expires;
+
+        if (header->id != SIP_HDR_CONTACT) {
+            continue;
+        }
+        uri = sip_message_get_uri(msg, header->value);
+        if (uri.len <= strlen(user_part) ||
+            strncmp(sip_span_ptr(msg, uri), user_part, strlen(user_part)) != 0) {
+            continue;
+        }
+        if (sip_message_get_param(msg, header->value, "expires", &expires) == ESP_OK &&
+            sip_span_to_u32(msg, expires, &value) == ESP_OK) {
+            return value;
+        }
+    }
+
+    const sip_header_t *expires = sip_message_get_header(msg, SIP_HDR_EXPIRES);
+    if (expires != NULL && sip_span_to_u32(msg, expires->value, &value) == ESP_OK) {
+        return value;
+    }
+    return client->reg_expires_requested;
+}
+
+static void handle_register_response(struct esp_sip_client *client, const sip_message_t *msg)
+{
+    char reason[48];
+
+    if (msg->status_code < 200) {
+        return;
+    }
+
+    client->reg_pending = false;
+    copy_reason(msg, reason, sizeof(reason));
+
+    if (is_challenge(msg) &&
+        accept_challenge(client, msg, client->reg_auth_sent, client->reg_auth_retries)) {
+        ESP_LOGI(TAG, "Registrar challenged REGISTER, retrying with credentials");
+        client->reg_auth_retries++;
+        send_register(client, client->reg_expires_requested);
+        return;
+    }
+    if (client->reg_auth_sent && client->reg_auth_retries == 0 && !is_challenge(msg)) {
+        client->stats.auth_challenges_avoided++;
+    }
+    client->reg_auth_retries = 0;
+
+    if (msg->status_code < 300) {
+        if (client->reg_expires_requested == 0) {
+            ESP_LOGI(TAG, "Unregistered from %s", client->server);
+            client->registered = false;
+            return;
+        }
+        client->reg_expires_granted = granted_expires(client, msg);
+        ESP_LOGI(TAG, "Registered with %s for %lu s", client->server,
+                 (unsigned long)client->reg_expires_granted);
+        client->registered = true;
+        queue_event(client, ESP_SIP_EVENT_REGISTERED, msg->status_code, reason);
+        return;
+    }
+
+    ESP_LOGW(TAG, "Registration rejected: %u %s", msg->status_code, reason);
+    client->registered = false;
+    client->reg_expires_granted = 0;
+    queue_event(client, ESP_SIP_EVENT_REGISTRATION_FAILED, msg->status_code, reason);
+}
+
+/**
+ * @brief Start the media of the answered call
+ */
+static void start_media(struct esp_sip_client *client, const sip_message_t *msg)
+{
+    static const rtp_engine_codec_t engine_codecs[] = {
+        [SDP_CODEC_PCMU] = RTP_ENGINE_CODEC_PCMU,
+        [SDP_CODEC_PCMA] = RTP_ENGINE_CODEC_PCMA,
+        [SDP_CODEC_G722] = RTP_ENGINE_CODEC_G722,
+    };
+    sdp_media_t media;
+
+    if (!sdp_parse_answer(sip_span_ptr(msg, msg->body), msg->body.len, &client->codecs, &media)) {
+        ESP_LOGW(TAG, "Answer has no audio codec we offered, call continues without media");
+        return;
+    }
+    ESP_LOGI(TAG, "Answer picked %s as payload type %u", sdp_codec_name(media.codec), media.payload_type);
+    client->media = media;
+    client->media_agreed = true;
+
+    rtp_engine_params_t params = {
+        .local_port = SIP_RTP_PORT,
+        .remote_addr = media.remote_addr,
+        .remote_port = media.remote_port,
+        .codec = engine_codecs[media.codec],
+        .payload_type = media.payload_type,
+        .dtmf_payload_type = media.dtmf_payload_type,
+        .cn_payload_type = media.cn_payload_type
+    };
+    if (rtp_engine_start(&params) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start media");
+    } else if (params.dtmf_payload_type == 0) {
+        ESP_LOGI(TAG, "Answer has no telephone-event, DTMF only via INFO");
+    }
+}
+
+static void handle_invite_response(struct esp_sip_client *client, sip_dialog_t *call,
+                                   const sip_message_t *msg, sip_transaction_t *invite_tx)
+{
+    const sip_header_t *to = sip_message_get_header(msg, SIP_HDR_TO);
+    sip_span_t tag;
+    char reason[48];
+
+    if (msg->cseq != call->invite_cseq) {
+        return;
+    }
+
+    if (to != NULL && sip_message_get_param(msg, to->value, "tag", &tag) == ESP_OK) {
+        dialog_set(call, &call->remote_tag, sip_span_ptr(msg, tag), tag.len, SIP_REMOTE_TAG_LEN);
+    }
+
+    if (msg->status_code < 200) {
+        if (msg->status_code == 100) {
+            call_latency_mark(CALL_LATENCY_TRYING);
+        } else {
+            call_latency_mark(CALL_LATENCY_RINGING);
+            if (call->state == CALL_STATE_INVITING) {
+                call->state = CALL_STATE_EARLY;
+            }
+            if (leg_timing(client, call)->provisional_ms == 0) {
+                leg_timing(client, call)->provisional_ms = call_elapsed_ms(client);
+            }
+        }
+        return;
+    }
+
+    if (call->auth_sent && call->auth_retries == 0 && !is_challenge(msg) &&
+        call->state != CALL_STATE_CONFIRMED) {
+        client->stats.auth_challenges_avoided++;
+        call->auth_sent = false;  // Count once per INVITE
+    }
+
+    if (msg->status_code < 300) {
+        const sip_header_t *contact = sip_message_get_header(msg, SIP_HDR_CONTACT);
+        if (contact != NULL) {
+            sip_span_t uri = sip_message_get_uri(msg, contact->value);
+            dialog_set(call, &call->remote_target, sip_span_ptr(msg, uri), uri.len, SIP_URI_LEN - 1);
+        }
+
+        call_latency_mark(CALL_LATENCY_ANSWERED);
+        send_in_dialog(client, call, SIP_METHOD_ACK, call->invite_cseq);
+        call_latency_mark(CALL_LATENCY_ACK_SENT);
+
+        if (call->state == CALL_STATE_CONFIRMED) {
+            return;  // 2xx retransmission, the ACK above is all it needs
+        }
+        record_leg_final(client, call, msg->status_code);
+        if (call->state == CALL_STATE_CANCELLING || client->answered != NULL) {
+            // Answered while our CANCEL was in flight, or another leg won the race
+            call->local_cseq++;
+            send_in_dialog(client, call, SIP_METHOD_BYE, call->local_cseq);
+            reset_leg(client, call);
+            return;
+        }
+
+        ESP_LOGI(TAG, "Call answered by %s", call->request_uri);
+        call->state = CALL_STATE_CONFIRMED;
+        client->answered = call;
+        client->stats.last_call_answered_leg = (int8_t)(call - client->legs);
+
+        // First answer wins, the other phones stop ringing
+        for (int i = 0; i < SIP_MAX_CALL_LEGS; i++) {
+            if (leg_ringing(&client->legs[i])) {
+                cancel_leg(client, &client->legs[i]);
+            }
+        }
+        start_media(client, msg);
+        queue_event(client, ESP_SIP_EVENT_CALL_CONNECTED, msg->status_code, NULL);
+        return;
+    }
+
+    send_invite_companion(client, call, SIP_METHOD_ACK, invite_tx);
+    copy_reason(msg, reason, sizeof(reason));
+
+    if (call->state != CALL_STATE_CANCELLING && is_challenge(msg) &&
+        accept_challenge(client, msg, call->auth_sent, call->auth_retries)) {
+        // Same dialog identifiers, next CSeq, new transaction (RFC 3261 22.2)
+        ESP_LOGI(TAG, "INVITE challenged, retrying with credentials");
+        call->auth_retries++;
+        call->invite_cseq++;
+        call->local_cseq = call->invite_cseq;
+        call->remote_tag = "";
+        generate_branch(client, call->invite_branch, sizeof(call->invite_branch));
+        call->state = CALL_STATE_INVITING;
+        if (send_invite(client, call) == ESP_OK) {
+            return;
+        }
+    }
+
+    if (call->state == CALL_STATE_CANCELLING) {
+        ESP_LOGI(TAG, "Leg to %s cancelled (%u)", call->request_uri, msg->status_code);
+        record_leg_final(client, call, msg->status_code);
+        reset_leg(client, call);
+        return;
+    }
+
+    ESP_LOGW(TAG, "Leg to %s failed: %u %s", call->request_uri, msg->status_code, reason);
+    leg_failed(client, call, msg->status_code, reason);
+}
+
+static void handle_response(struct esp_sip_client *client, const sip_message_t *msg)
+{
+    const sip_header_t *call_id = sip_message_get_header(msg, SIP_HDR_CALL_ID);
+    if (call_id == NULL) {
+        return;
+    }
+
+    sip_transaction_t *tx = NULL;
+    switch (sip_transaction_client_receive(&client->transactions, msg, &tx)) {
+        case SIP_TRANSACTION_ABSORBED:
+            return;
+        case SIP_TRANSACTION_NO_MATCH:
+            // Only 2xx retransmissions for the INVITE outlive its transaction
+            if (msg->cseq_method != SIP_METHOD_INVITE || msg->status_code < 200 ||
+                msg->status_code >= 300) {
+                return;
+            }
+            tx = NULL;
+            break;
+        default:
+            break;
+    }
+
+    if (msg->cseq_method == SIP_METHOD_REGISTER) {
+        if (client->reg_pending && msg->cseq == client->reg_cseq &&
+            sip_span_equals(msg, call_id->value, client->reg_call_id)) {
+            handle_register_response(client, msg);
+        }
+        return;
+    }
+
+    sip_dialog_t *call = find_leg(client, msg, call_id->value);
+    if (call == NULL) {
+        ESP_LOGD(TAG, "Response for unknown Call-ID ignored");
+        return;
+    }
+
+    if (msg->cseq_method == SIP_METHOD_INVITE) {
+        handle_invite_response(client, call, msg, tx);
+    }
+}
+
+/**
+ * @brief Extract a digit from an INFO body (application/dtmf-relay or application/dtmf)
+ */
+static char parse_dtmf_body(const sip_message_t *msg)
+{
+    const char *body = sip_span_ptr(msg, msg->body);
+    size_t len = msg->body.len;
+
+    for (size_t i = 0; i + 7 <= len; i++) {
+        if (strncasecmp(body + i, "Signal=", 7) == 0) {
+            i += 7;
+            while (i < len && (body[i] == ' ' || body[i] == '\t')) {
+                i++;
+            }
+            return i < len ? body[i] : 0;
+        }
+    }
+    // application/dtmf carries the bare digit
+    for (size_t i = 0; i < len; i++) {
+        if (body[i] != ' ' && body[i] != '\r' && body[i] != '\n') {
+            return body[i];
+        }
+    }
+    return 0;
+}
+
+static bool is_valid_dtmf(char digit)
+{
+    return (digit >= '0' && digit <= '9') || digit == '*' || digit == '#' ||
+           (digit >= 'A' && digit <= 'D');
+}
+
+/**
+ * @brief Answer a session refresh with the stream already agreed
+ */
+static void answer_reinvite(struct esp_sip_client *client, sip_transaction_t *stx, const sip_message_t *msg)
+{
+    char sdp[sizeof(client->sdp)];
+    sdp_offer_t session = {
+        .username = client->username,
+        .session_id = client->sdp_session,
+        .session_name = SIP_USER_AGENT,
+        .address = client->transport.local_ip,
+        .port = SIP_RTP_PORT
+    };
+
+    int len = client->media_agreed ? sdp_write_answer(sdp, sizeof(sdp), &session, &client->media) : -1;
+    if (len < 0 || (size_t)len >= sizeof(sdp)) {
+        // No stream was agreed, so there is nothing to keep
+        send_response(client, stx, msg, 488, "Not Acceptable Here", NULL, NULL);
+        return;
+    }
+    send_response(client, stx, msg, 200, "OK", "application/sdp", sdp);
+}
+
+static void handle_request(struct esp_sip_client *client, const sip_message_t *msg)
+{
+    const sip_header_t *call_id = sip_message_get_header(msg, SIP_HDR_CALL_ID);
+    sip_dialog_t *call = call_id != NULL ? find_leg(client, msg, call_id->value) : NULL;
+    sip_transaction_t *stx = NULL;
+
+    esp_err_t ret = sip_transaction_server_receive(&client->transactions, msg, &stx);
+    if (ret == ESP_OK && stx == NULL) {
+        return;  // ACK or retransmission, handled by the transaction layer
+    }
+    if (ret == ESP_ERR_NO_MEM) {
+        send_response(client, NULL, msg, 503, "Service Unavailable", NULL, NULL);
+        return;
+    }
+
+    switch (msg->method) {
+        case SIP_METHOD_ACK:
+            break;
+
+        case SIP_METHOD_OPTIONS:
+            send_response(client, stx, msg, 200, "OK", NULL, NULL);
+            break;
+
+        case SIP_METHOD_INVITE:
+            if (call != NULL && call->state == CALL_STATE_CONFIRMED) {
+                // Session refresh re-INVITE: keep the same media
+                answer_reinvite(client, stx, msg);
+            } else {
+                // The door station only places calls
+                send_response(client, stx, msg, 486, "Busy Here", NULL, NULL);
+            }
+            break;
+
+        case SIP_METHOD_BYE:
+            if (call == NULL) {
+                send_response(client, stx, msg, 481, "Call/Transaction Does Not Exist", NULL, NULL);
+                break;
+            }
+            send_response(client, stx, msg, 200, "OK", NULL, NULL);
+            if (call == client->answered) {
+                ESP_LOGI(TAG, "Call ended by remote party");
+                queue_event(client, ESP_SIP_EVENT_CALL_ENDED, 0, "Remote hangup");
+            }
+            reset_leg(client, call);
+            break;
+
+        case SIP_METHOD_INFO:
+            if (call == NULL) {
+                send_response(client, stx, msg, 481, "Call/Transaction Does Not Exist", NULL, NULL);
+                break;
+            }
+            send_response(client, stx, msg, 200, "OK", NULL, NULL);
+            {
+                char digit = parse_dtmf_body(msg);
+                if (is_valid_dtmf(digit)) {
+                    ESP_LOGI(TAG, "DTMF via INFO: %c", digit);
+                    queue_dtmf(client, digit);
+                }
+            }
+            break;
+
+        case SIP_METHOD_CANCEL:
+            send_response(client, stx, msg, 481, "Call/Transaction Does Not Exist", NULL, NULL);
+            break;
+
+        default:
+            send_response(client, stx, msg, 501, "Not Implemented", NULL, NULL);
+            break;
+    }
+}
+
+static void process_datagram(struct esp_sip_client *client, size_t len)
+{
+    client->rx_buf[len] = '\0';
+
+    // RFC 5626 keepalive pong, nothing to parse
+    if (len <= 4 && (client->rx_buf[0] == '\r' || client->rx_buf[0] == '\n')) {
+        return;
+    }
+
+    esp_err_t ret = sip_message_parse(client->rx_buf, len, &client->rx_msg);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Dropping malformed message (%d bytes): %s", (int)len, esp_err_to_name(ret));
+        return;
+    }
+
+    if (client->rx_msg.is_request) {
+        handle_request(client, &client->rx_msg);
+    } else {
+        handle_response(client, &client->rx_msg);
+    }
+}
+
+/**
+ * @brief Dial the registrar again once the connection is due
+ *
+ * The handshake runs without the client lock, so calls and stop are not
+ * held up by an unreachable server. Registers again on success.
+ */
+static void flow_reconnect(struct esp_sip_client *client)
+{
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    if (!client->flow_down || esp_timer_get_time() < client->flow_retry_us) {
+        xSemaphoreGive(client->lock);
+        return;
+    }
+    // select_server() leaves the old connection for us to close
+    sip_transport_close(&client->transport);
+
+    sip_dns_result_t servers;
+    const sip_dns_target_t *preferred = preferred_server(client, &servers);
+    uint32_t addr = preferred != NULL ? preferred->addr : client->transport.remote_addr;
+    uint16_t port = preferred != NULL ? preferred->port : client->transport.remote_port;
+    xSemaphoreGive(client->lock);
+
+    sip_transport_conn_t conn;
+    esp_err_t ret = sip_transport_dial(&client->transport, addr, port, &conn);
+
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    if (ret != ESP_OK) {
+        client->transport.remote_addr = addr;
+        client->transport.remote_port = port;
+        flow_dial_failed(client);
+    } else {
+        // Owned by the transport even if we are stopping, stop closes it
+        sip_transport_adopt(&client->transport, &conn, addr, port);
+        if (client->started) {
+            flow_connected(client);
+            client->stats.reconnects++;
+
+            // Via and Contact name the new connection
+            if (compile_templates(client) != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to recompile SIP templates");
+            } else if (!client->reg_pending) {
+                client->reg_auth_retries = 0;
+                send_register(client, client->expires_sec);
+            }
+        }
+    }
+    xSemaphoreGive(client->lock);
+}
+
+static void sip_task(void *arg)
+{
+    struct esp_sip_client *client = (struct esp_sip_client *)arg;
+    size_t len = 0;
+
+    ESP_LOGI(TAG, "SIP task started");
+
+    while (client->started) {
+        if (client->flow_down) {
+            flow_reconnect(client);
+        }
+
+        esp_err_t ret = sip_transport_recv(&client->transport, client->rx_buf,
+                                           sizeof(client->rx_buf) - 1,
+                                           SIP_POLL_INTERVAL_MS, &len);
+
+        xSemaphoreTake(client->lock, portMAX_DELAY);
+        if (ret == ESP_OK && client->started) {
+            process_datagram(client, len);
+        }
+        if (use_stream(client) && client->started && !client->flow_down) {
+            if (ret == ESP_FAIL) {
+                flow_lost(client, "connection closed");
+            } else {
+                keepalive_tick(client, esp_timer_get_time());
+            }
+        }
+        sip_transaction_layer_tick(&client->transactions, esp_timer_get_time() / 1000);
+        xSemaphoreGive(client->lock);
+
+        dispatch_events(client);
+
+        if (ret != ESP_OK && ret != ESP_ERR_TIMEOUT) {
+            // Socket error (e.g. ICMP unreachable) or no connection, avoid spinning
+            vTaskDelay(pdMS_TO_TICKS(SIP_POLL_INTERVAL_MS));
+        }
+    }
+
+    // Whoever stopped the client, the transport is released here, out of recv
+    sip_transport_close(&client->transport);
+    ESP_LOGI(TAG, "SIP task stopped");
+    client->task_running = false;
+    vTaskDelete(NULL);
+}
+
 esp_err_t esp_sip_init(esp_sip_config_t *config, esp_sip_event_callback_t callback, void *user_data, esp_sip_client_handle_t *client) {
-    if (!config || !callback || !client) {
+    if (!config || !callback || !client || !config->username || !config->server_uri) {
         return ESP_ERR_INVALID_ARG;
     }
-    
-    struct esp_sip_client *sip_client = malloc(sizeof(struct esp_sip_client));
+
+    struct esp_sip_client *sip_client = calloc(1, sizeof(struct esp_sip_client));
     if (!sip_client) {
         return ESP_ERR_NO_MEM;
     }
-    
-    memcpy(&sip_client->config, config, sizeof(esp_sip_config_t));
+
+    if (!sdp_parse_codec_list(config->codecs != NULL && config->codecs[0] != '\0' ? config->codecs :
+                              SDP_DEFAULT_CODECS, &sip_client->codecs)) {
+        ESP_LOGE(TAG, "Invalid codec list: %s", config->codecs);
+        free(sip_client);
+        return ESP_ERR_INVALID_ARG;
+    }
+    strncpy(sip_client->username, config->username, sizeof(sip_client->username) - 1);
+    if (config->password) {
+        strncpy(sip_client->password, config->password, sizeof(sip_client->password) - 1);
+    }
+    strncpy(sip_client->server, config->server_uri, sizeof(sip_client->server) - 1);
+    sip_client->server_port = config->port ? config->port :
+                              config->transport == ESP_SIP_TRANSPORT_TLS ? SIP_DEFAULT_TLS_PORT : SIP_DEFAULT_PORT;
+    sip_client->local_port = config->local_port ? config->local_port : SIP_DEFAULT_PORT;
+    sip_client->transport_type = config->transport;
+    sip_client->keepalive_interval_ms = (config->keepalive_interval_sec ?
+                                         config->keepalive_interval_sec : SIP_KEEPALIVE_DEFAULT_SEC) * 1000;
+    sip_client->expires_sec = config->registration_timeout_sec ?
+                              config->registration_timeout_sec : SIP_DEFAULT_EXPIRES_SEC;
+    if (config->uri) {
+        strncpy(sip_client->default_target, config->uri, sizeof(sip_client->default_target) - 1);
+    }
+    sip_digest_init(&sip_client->digest, sip_client->username, sip_client->password);
+    sip_client->stats.last_call_answered_leg = -1;
     sip_client->callback = callback;
     sip_client->user_data = user_data;
-    sip_client->started = false;
-    
+    sip_client->transport.sock = -1;
+    sip_arena_pool_init(&sip_client->dialog_pool, sip_client->dialog_storage, sizeof(sip_client->dialog_storage));
+    reset_call(sip_client);
+
+    if (sip_client->transport_type == ESP_SIP_TRANSPORT_TLS) {
+        esp_err_t ret = sip_tls_create(sip_client->server, config->tls_ca_pem, &sip_client->tls);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to set up TLS for %s", sip_client->server);
+            free(sip_client);
+            return ret;
+        }
+    }
+
+    sip_client->lock = xSemaphoreCreateMutex();
+    if (!sip_client->lock) {
+        sip_tls_destroy(sip_client->tls);
+        free(sip_client);
+        return ESP_ERR_NO_MEM;
+    }
+
     *client = sip_client;
-    
+
     ESP_LOGI(TAG, "SIP client initialized");
     return ESP_OK;
 }
@@ -37,25 +1722,138 @@ esp_err_t esp_sip_start(esp_sip_client_handle_t client) {
     if (!client) {
         return ESP_ERR_INVALID_ARG;
     }
-    
+
+    if (client->started) {
+        return ESP_OK;
+    }
+    if (client->task_running) {
+        // The last task has yet to release the transport
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret;
+    switch (client->transport_type) {
+    case ESP_SIP_TRANSPORT_TCP:
+        ret = sip_transport_open_tcp(&client->transport);
+        break;
+    case ESP_SIP_TRANSPORT_TLS:
+        ret = sip_transport_open_tls(&client->transport, client->tls);
+        break;
+    default:
+        ret = sip_transport_open(&client->transport, client->local_port);
+        break;
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // The only lookup that may block; refreshes and calls use the cached servers
+    sip_dns_result_t servers;
+    if (sip_dns_init(NULL) == ESP_OK &&
+        sip_dns_resolve(client->server, client->server_port, dns_transport(client), &servers) == ESP_OK) {
+        ret = sip_transport_connect_addr(&client->transport, servers.targets[0].addr, servers.targets[0].port);
+    } else {
+        ret = sip_transport_connect(&client->transport, client->server, client->server_port);
+    }
+    client->server_failed = false;
+    client->flow_down = false;
+    client->flow_failures = 0;
+    if (ret != ESP_OK && use_stream(client) && client->transport.remote_addr != 0) {
+        // The server resolved but did not take the connection; keep dialling from the SIP task
+        flow_dial_failed(client);
+        ret = ESP_OK;
+    } else if (ret == ESP_OK && use_stream(client)) {
+        flow_connected(client);
+    }
+    if (ret != ESP_OK) {
+        sip_transport_close(&client->transport);
+        return ret;
+    }
+
+    sip_transaction_user_t user = {
+        .send = transport_send_hook,
+        .on_timeout = transaction_timeout_hook,
+        .ctx = client
+    };
+    sip_transaction_layer_init(&client->transactions, &user, esp_timer_get_time() / 1000);
+    client->transactions.reliable = use_stream(client);
+
+    generate_token(client->reg_call_id, sizeof(client->reg_call_id));
+    generate_token(client->reg_tag, sizeof(client->reg_tag));
+    client->reg_cseq = 0;
+    client->registered = false;
+    client->reg_expires_granted = 0;
+    client->reg_auth_retries = 0;
+    client->sdp_session = esp_random() & 0x7fffffff;
+
+    ret = compile_templates(client);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to compile SIP templates");
+        sip_transport_close(&client->transport);
+        return ret;
+    }
+
     client->started = true;
+    client->task_running = true;
+    BaseType_t task_ret = xTaskCreate(sip_task, "sip_task", SIP_TASK_STACK_SIZE,
+                                      client, SIP_TASK_PRIORITY, &client->task);
+    if (task_ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create SIP task");
+        client->started = false;
+        client->task_running = false;
+        sip_transport_close(&client->transport);
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    if (!client->flow_down) {
+        ret = send_register(client, client->expires_sec);
+    }
+    xSemaphoreGive(client->lock);
+
     ESP_LOGI(TAG, "SIP client started");
-    
-    // Simulate registration success
-    esp_sip_event_data_t event = {
-        .event = ESP_SIP_EVENT_REGISTERED
-    };
-    client->callback(&event, client->user_data);
-    
-    return ESP_OK;
+    return ret;
 }
 
 esp_err_t esp_sip_stop(esp_sip_client_handle_t client) {
     if (!client) {
         return ESP_ERR_INVALID_ARG;
     }
-    
+
+    if (!client->started) {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    if (client->answered != NULL) {
+        client->answered->local_cseq++;
+        send_in_dialog(client, client->answered, SIP_METHOD_BYE, client->answered->local_cseq);
+    }
+    for (int i = 0; i < SIP_MAX_CALL_LEGS; i++) {
+        if (leg_ringing(&client->legs[i])) {
+            send_invite_companion(client, &client->legs[i], SIP_METHOD_CANCEL, NULL);
+        }
+    }
+    reset_call(client);
+    if (client->registered) {
+        send_register(client, 0);
+    }
+    sip_transaction_layer_reset(&client->transactions);
+    client->registered = false;
+    client->reg_expires_granted = 0;
+    client->reg_pending = false;
+    client->pending_count = 0;
     client->started = false;
+    xSemaphoreGive(client->lock);
+
+    // Wait for the SIP task to close the transport unless we are the SIP task
+    if (xTaskGetCurrentTaskHandle() != client->task) {
+        for (int waited = 0; client->task_running && waited < SIP_STOP_WAIT_MS;
+             waited += SIP_POLL_INTERVAL_MS) {
+            vTaskDelay(pdMS_TO_TICKS(SIP_POLL_INTERVAL_MS));
+        }
+    }
+
     ESP_LOGI(TAG, "SIP client stopped");
     return ESP_OK;
 }
@@ -64,15 +1862,79 @@ esp_err_t esp_sip_call(esp_sip_client_handle_t client, const char *uri) {
     if (!client || !uri) {
         return ESP_ERR_INVALID_ARG;
     }
-    
-    ESP_LOGI(TAG, "Making call to: %s", uri);
-    
-    // Simulate call started
-    esp_sip_event_data_t event = {
-        .event = ESP_SIP_EVENT_CALL_STARTED
-    };
-    client->callback(&event, client->user_data);
-    
+
+    if (!client->started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    if (call_in_progress(client)) {
+        xSemaphoreGive(client->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Legs of the previous call still waiting for a 487 are given up
+    reset_call(client);
+    memset(client->stats.last_call_leg, 0, sizeof(client->stats.last_call_leg));
+    client->stats.last_call_legs = 0;
+    client->stats.last_call_answered_leg = -1;
+    client->call_fail_status = 0;
+    memset(client->call_fail_reason, 0, sizeof(client->call_fail_reason));
+    client->call_start_us = esp_timer_get_time();
+
+    const char *list = uri;
+    char entry[SIP_URI_LEN];
+    char request_uri[SIP_URI_LEN];
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+    uint8_t sent = 0;
+
+    while (client->leg_count < SIP_MAX_CALL_LEGS &&
+           (list = next_target(list, entry, sizeof(entry))) != NULL) {
+        sip_dialog_t *call = &client->legs[client->leg_count++];
+
+        // Every leg is its own dialog so the PBX never sees merged requests
+        normalize_uri(entry, client->server, request_uri, sizeof(request_uri));
+        call->request_uri = sip_arena_strndup(&call->arena, request_uri, strlen(request_uri));
+        if (call->request_uri == NULL) {
+            ESP_LOGE(TAG, "No room for the leg to %s", request_uri);
+            ret = ESP_ERR_NO_MEM;
+            reset_leg(client, call);
+            continue;
+        }
+        generate_token(call->call_id, sizeof(call->call_id));
+        generate_token(call->local_tag, sizeof(call->local_tag));
+        generate_branch(client, call->invite_branch, sizeof(call->invite_branch));
+        call->invite_cseq = 1;
+        call->local_cseq = 1;
+        call->state = CALL_STATE_INVITING;
+
+        ESP_LOGI(TAG, "Making call to: %s", call->request_uri);
+
+        ret = send_invite(client, call);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "INVITE to %s not sent: %s", call->request_uri, esp_err_to_name(ret));
+            reset_leg(client, call);
+            continue;
+        }
+        if (sent++ == 0) {
+            call_latency_mark(CALL_LATENCY_INVITE_SENT);
+        }
+    }
+    if (list != NULL && next_target(list, entry, sizeof(entry)) != NULL) {
+        ESP_LOGW(TAG, "Only the first %d callees are rung", SIP_MAX_CALL_LEGS);
+    }
+
+    if (sent == 0) {
+        reset_call(client);
+        xSemaphoreGive(client->lock);
+        return ret;
+    }
+    client->stats.last_call_legs = client->leg_count;
+
+    queue_event(client, ESP_SIP_EVENT_CALL_STARTED, 0, NULL);
+    xSemaphoreGive(client->lock);
+
+    dispatch_events(client);
     return ESP_OK;
 }
 
@@ -80,15 +1942,89 @@ esp_err_t esp_sip_hangup(esp_sip_client_handle_t client) {
     if (!client) {
         return ESP_ERR_INVALID_ARG;
     }
-    
-    ESP_LOGI(TAG, "Hanging up call");
-    
-    // Simulate call ended
-    esp_sip_event_data_t event = {
-        .event = ESP_SIP_EVENT_CALL_ENDED
-    };
-    client->callback(&event, client->user_data);
-    
+
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    sip_dialog_t *call = client->answered;
+    if (call != NULL) {
+        ESP_LOGI(TAG, "Hanging up call");
+        call->local_cseq++;
+        send_in_dialog(client, call, SIP_METHOD_BYE, call->local_cseq);
+        reset_leg(client, call);
+        queue_event(client, ESP_SIP_EVENT_CALL_ENDED, 0, "Local hangup");
+    } else if (call_in_progress(client)) {
+        ESP_LOGI(TAG, "Cancelling call");
+        for (int i = 0; i < SIP_MAX_CALL_LEGS; i++) {
+            if (leg_ringing(&client->legs[i])) {
+                cancel_leg(client, &client->legs[i]);
+            }
+        }
+        queue_event(client, ESP_SIP_EVENT_CALL_ENDED, 0, "Local cancel");
+    }
+    xSemaphoreGive(client->lock);
+
+    dispatch_events(client);
+    return ESP_OK;
+}
+
+esp_err_t esp_sip_register(esp_sip_client_handle_t client) {
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!client->started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    if (!client->reg_pending) {
+        // Follow DNS changes and fail over between calls, never in the middle of one
+        if (!call_in_progress(client)) {
+            select_server(client);
+        }
+        client->reg_auth_retries = 0;
+        if (!client->flow_down) {
+            ret = send_register(client, client->expires_sec);
+        }
+    }
+    xSemaphoreGive(client->lock);
+    return ret;
+}
+
+esp_err_t esp_sip_get_registration_expires(esp_sip_client_handle_t client, uint32_t *expires_sec) {
+    if (!client || !expires_sec) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    *expires_sec = client->registered ? client->reg_expires_granted : 0;
+    xSemaphoreGive(client->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_sip_get_stats(esp_sip_client_handle_t client, esp_sip_stats_t *stats) {
+    if (!client || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sip_arena_pool_stats_t transaction_arena;
+    sip_arena_pool_stats_t dialog_arena;
+    xSemaphoreTake(client->lock, portMAX_DELAY);
+    *stats = client->stats;
+    sip_transaction_get_arena_stats(&client->transactions, &transaction_arena);
+    sip_arena_pool_get_stats(&client->dialog_pool, &dialog_arena);
+    xSemaphoreGive(client->lock);
+
+    stats->transaction_arena_peak = transaction_arena.peak;
+    stats->dialog_arena_peak = dialog_arena.peak;
+    stats->arena_failures = transaction_arena.failures + dialog_arena.failures;
+
+    sip_tls_stats_t tls_stats = { 0 };
+    sip_tls_get_stats(client->tls, &tls_stats);
+    stats->tls_full_handshakes = tls_stats.full_handshakes;
+    stats->tls_resumed_handshakes = tls_stats.resumed_handshakes;
+    stats->tls_full_handshake_ms = tls_stats.full_handshake_ms;
+    stats->tls_resumed_handshake_ms = tls_stats.resumed_handshake_ms;
     return ESP_OK;
 }
 
@@ -96,8 +2032,16 @@ esp_err_t esp_sip_destroy(esp_sip_client_handle_t client) {
     if (!client) {
         return ESP_ERR_INVALID_ARG;
     }
-    
+
+    esp_sip_stop(client);
+    // The lock, TLS context and client belong to the SIP task until it exits
+    if (client->task_running) {
+        ESP_LOGW(TAG, "SIP task still running, client not destroyed");
+        return ESP_ERR_TIMEOUT;
+    }
+    vSemaphoreDelete(client->lock);
+    sip_tls_destroy(client->tls);
     free(client);
     ESP_LOGI(TAG, "SIP client destroyed");
     return ESP_OK;
-}
\ No newline at end of file
+}
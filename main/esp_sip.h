@@ -27,6 +27,15 @@ typedef enum {
     ESP_SIP_EVENT_DTMF_RECEIVED
 } esp_sip_event_t;
 
+/**
+ * @brief Transport towards the registrar
+ */
+typedef enum {
+    ESP_SIP_TRANSPORT_UDP,           ///< Datagrams from the local SIP port
+    ESP_SIP_TRANSPORT_TCP,           ///< One long-lived connection kept open with CRLF keepalives
+    ESP_SIP_TRANSPORT_TLS            ///< As TCP, inside a TLS session resumed on every re-dial
+} esp_sip_transport_t;
+
 /**
  * @brief SIP configuration
  */
@@ -38,6 +47,11 @@ typedef struct {
     uint16_t port;
     uint32_t registration_timeout_sec;
     uint32_t call_timeout_sec;
+    uint16_t local_port;             ///< Local SIP port, 0 for the default 5060 (UDP only)
+    esp_sip_transport_t transport;
+    uint32_t keepalive_interval_sec; ///< CRLF ping period on TCP and TLS, 0 for the default
+    const char *tls_ca_pem;          ///< CA for the server certificate, NULL for the bundle (TLS only)
+    const char *codecs;              ///< Offered codecs in order of preference, e.g. "PCMA,G722,telephone-event"; NULL for SDP_DEFAULT_CODECS
 } esp_sip_config_t;
 
 /**
@@ -56,6 +70,41 @@ typedef struct {
     } data;
 } esp_sip_event_data_t;
 
+/**
+ * @brief Callees rung in parallel by one call
+ */
+#define ESP_SIP_MAX_CALL_LEGS 4
+
+/**
+ * @brief Timing of one leg of a call, relative to the first INVITE
+ */
+typedef struct {
+    uint16_t status;                    ///< Final response, 0 if none arrived
+    uint32_t provisional_ms;            ///< First 18x, 0 if none
+    uint32_t final_ms;                  ///< Final response
+} esp_sip_leg_timing_t;
+
+/**
+ * @brief Counters kept by the SIP client for its lifetime
+ */
+typedef struct {
+    uint32_t auth_challenges;           ///< 401/407 challenges answered with credentials
+    uint32_t auth_challenges_avoided;   ///< Requests accepted on credentials sent up front
+    uint8_t last_call_legs;             ///< Callees rung by the last call
+    int8_t last_call_answered_leg;      ///< Leg that answered the last call, -1 if none
+    esp_sip_leg_timing_t last_call_leg[ESP_SIP_MAX_CALL_LEGS];
+    uint32_t keepalives_sent;           ///< CRLF pings sent on the TCP connection
+    uint32_t keepalive_pongs;           ///< Pings the server answered
+    uint32_t reconnects;                ///< TCP connections re-dialled after a failure
+    uint32_t tls_full_handshakes;       ///< TLS handshakes with a full key exchange
+    uint32_t tls_resumed_handshakes;    ///< TLS handshakes that resumed the previous session
+    uint32_t tls_full_handshake_ms;     ///< Duration of the last full handshake
+    uint32_t tls_resumed_handshake_ms;  ///< Duration of the last resumed handshake
+    uint32_t transaction_arena_peak;    ///< Most bytes the transactions held at once
+    uint32_t dialog_arena_peak;         ///< Most bytes the call legs held at once
+    uint32_t arena_failures;            ///< Allocations neither pool had room for
+} esp_sip_stats_t;
+
 /**
  * @brief SIP event callback
  */
@@ -68,26 +117,85 @@ esp_err_t esp_sip_init(esp_sip_config_t *config, esp_sip_event_callback_t callba
 
 /**
  * @brief Start SIP client
+ *
+ * Opens the transport, starts the SIP task and sends the initial
+ * REGISTER. ESP_SIP_EVENT_REGISTERED or ESP_SIP_EVENT_REGISTRATION_FAILED
+ * is delivered from the SIP task once the registrar answers.
+ *
+ * Over TCP the connection is kept open with RFC 5626 CRLF keepalives. When
+ * it drops, or a ping goes unanswered by a server that answered before,
+ * REGISTRATION_FAILED is reported and the SIP task re-dials with backoff,
+ * registering again once connected. A registrar that cannot be reached at
+ * start is dialled the same way.
+ *
+ * TLS works the same on port 5061 by default. The TLS session is kept
+ * across re-dials and restarts of the client, so a reconnect after a
+ * Wi-Fi drop resumes it by session ticket or ID instead of running the
+ * full ECDHE handshake.
+ *
+ * Returns ESP_ERR_INVALID_STATE while the task of a previous start has
+ * not yet closed the transport.
  */
 esp_err_t esp_sip_start(esp_sip_client_handle_t client);
 
 /**
  * @brief Stop SIP client
+ *
+ * The SIP task closes the transport as it exits. Called from outside the
+ * SIP task, this waits for that.
  */
 esp_err_t esp_sip_stop(esp_sip_client_handle_t client);
 
 /**
  * @brief Make a call
+ *
+ * Sends an INVITE and reports ESP_SIP_EVENT_CALL_STARTED. The outcome
+ * (CALL_CONNECTED or CALL_FAILED) is delivered from the SIP task.
+ *
+ * A comma-separated list rings up to ESP_SIP_MAX_CALL_LEGS targets in
+ * parallel, each in its own dialog. The first 2xx wins and the other legs
+ * are cancelled; CALL_FAILED is only reported once every leg has failed.
+ *
+ * @param uri Target as sip:user@host, user@host or a bare user on the registrar,
+ *            or a comma-separated list of targets
  */
 esp_err_t esp_sip_call(esp_sip_client_handle_t client, const char *uri);
 
 /**
  * @brief End call
+ *
+ * Sends BYE for a connected call or CANCEL for one still ringing.
  */
 esp_err_t esp_sip_hangup(esp_sip_client_handle_t client);
 
+/**
+ * @brief Refresh the registration
+ *
+ * Sends a REGISTER on the existing Call-ID with the next CSeq. The result
+ * is reported as ESP_SIP_EVENT_REGISTERED or ESP_SIP_EVENT_REGISTRATION_FAILED.
+ * Does nothing while a REGISTER is still outstanding. While a TCP
+ * connection is being re-dialled the REGISTER goes out once it is up.
+ */
+esp_err_t esp_sip_register(esp_sip_client_handle_t client);
+
+/**
+ * @brief Get the Expires the registrar granted for the current binding
+ *
+ * @param expires_sec Granted lifetime in seconds, 0 while not registered
+ */
+esp_err_t esp_sip_get_registration_expires(esp_sip_client_handle_t client, uint32_t *expires_sec);
+
+/**
+ * @brief Get the client counters
+ */
+esp_err_t esp_sip_get_stats(esp_sip_client_handle_t client, esp_sip_stats_t *stats);
+
 /**
  * @brief Destroy SIP client
+ *
+ * Returns ESP_ERR_TIMEOUT and frees nothing if the SIP task has not
+ * exited by the end of the stop. The client stays valid, so the call
+ * can be retried.
  */
 esp_err_t esp_sip_destroy(esp_sip_client_handle_t client);
 
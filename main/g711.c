@@ -0,0 +1,146 @@
+#include "g711.h"
+#include <stdbool.h>
+
+#define G711_SIGN_BIT       0x80
+#define G711_QUANT_MASK     0x0f
+#define G711_SEG_SHIFT      4
+#define G711_SEG_MASK       0x70
+#define G711_ULAW_BIAS      0x84
+#define G711_ULAW_CLIP      8159
+
+// Encoder table sizes: µ-law keeps 14 bits of the sample, A-law 13 of which
+// the lowest never reaches the code
+#define G711_ULAW_SHIFT     2
+#define G711_ALAW_SHIFT     4
+#define G711_ULAW_ENTRIES   (1 << (16 - G711_ULAW_SHIFT))
+#define G711_ALAW_ENTRIES   (1 << (16 - G711_ALAW_SHIFT))
+
+static uint8_t ulaw_encode_table[G711_ULAW_ENTRIES];
+static uint8_t alaw_encode_table[G711_ALAW_ENTRIES];
+static int16_t ulaw_decode_table[256];
+static int16_t alaw_decode_table[256];
+static volatile bool tables_ready;
+
+// Upper end of each segment, in the units of the respective law
+static const int16_t ulaw_seg_end[8] = { 0x3f, 0x7f, 0xff, 0x1ff, 0x3ff, 0x7ff, 0xfff, 0x1fff };
+static const int16_t alaw_seg_end[8] = { 0x1f, 0x3f, 0x7f, 0xff, 0x1ff, 0x3ff, 0x7ff, 0xfff };
+
+static int segment(int value, const int16_t *seg_end)
+{
+    int seg = 0;
+    while (seg < 8 && value > seg_end[seg]) {
+        seg++;
+    }
+    return seg;
+}
+
+uint8_t g711_linear_to_ulaw(int16_t pcm)
+{
+    int value = pcm >> 2;
+    uint8_t mask = 0xff;
+
+    if (value < 0) {
+        value = -value;
+        mask = 0x7f;
+    }
+    if (value > G711_ULAW_CLIP) {
+        value = G711_ULAW_CLIP;
+    }
+    value += G711_ULAW_BIAS >> 2;
+
+    int seg = segment(value, ulaw_seg_end);
+    if (seg >= 8) {
+        return 0x7f ^ mask;
+    }
+    return (uint8_t)(((seg << G711_SEG_SHIFT) | ((value >> (seg + 1)) & G711_QUANT_MASK)) ^ mask);
+}
+
+int16_t g711_ulaw_to_linear(uint8_t code)
+{
+    code = ~code;
+    int t = ((code & G711_QUANT_MASK) << 3) + G711_ULAW_BIAS;
+    t <<= (code & G711_SEG_MASK) >> G711_SEG_SHIFT;
+    return (int16_t)((code & G711_SIGN_BIT) ? (G711_ULAW_BIAS - t) : (t - G711_ULAW_BIAS));
+}
+
+uint8_t g711_linear_to_alaw(int16_t pcm)
+{
+    int value = pcm >> 3;
+    uint8_t mask = 0xd5;
+
+    if (value < 0) {
+        value = -value - 1;
+        mask = 0x55;
+    }
+
+    int seg = segment(value, alaw_seg_end);
+    if (seg >= 8) {
+        return 0x7f ^ mask;
+    }
+    int code = seg << G711_SEG_SHIFT;
+    code |= (value >> (seg < 2 ? 1 : seg)) & G711_QUANT_MASK;
+    return (uint8_t)(code ^ mask);
+}
+
+int16_t g711_alaw_to_linear(uint8_t code)
+{
+    code ^= 0x55;
+    int t = (code & G711_QUANT_MASK) << 4;
+    int seg = (code & G711_SEG_MASK) >> G711_SEG_SHIFT;
+
+    switch (seg) {
+        case 0:
+            t += 8;
+            break;
+        case 1:
+            t += 0x108;
+            break;
+        default:
+            t += 0x108;
+            t <<= seg - 1;
+            break;
+    }
+    return (int16_t)((code & G711_SIGN_BIT) ? t : -t);
+}
+
+void g711_init(void)
+{
+    if (tables_ready) {
+        return;
+    }
+
+    // Entries are indexed by the sample shifted down, offset so negative samples come first
+    for (int i = 0; i < G711_ULAW_ENTRIES; i++) {
+        ulaw_encode_table[i] = g711_linear_to_ulaw((int16_t)((i - G711_ULAW_ENTRIES / 2) << G711_ULAW_SHIFT));
+    }
+    for (int i = 0; i < G711_ALAW_ENTRIES; i++) {
+        alaw_encode_table[i] = g711_linear_to_alaw((int16_t)((i - G711_ALAW_ENTRIES / 2) << G711_ALAW_SHIFT));
+    }
+    for (int i = 0; i < 256; i++) {
+        ulaw_decode_table[i] = g711_ulaw_to_linear((uint8_t)i);
+        alaw_decode_table[i] = g711_alaw_to_linear((uint8_t)i);
+    }
+    tables_ready = true;
+}
+
+void g711_encode(g711_law_t law, const int16_t *pcm, uint8_t *out, size_t samples)
+{
+    if (law == G711_ULAW) {
+        for (size_t i = 0; i < samples; i++) {
+            out[i] = ulaw_encode_table[(pcm[i] >> G711_ULAW_SHIFT) + G711_ULAW_ENTRIES / 2];
+        }
+    } else {
+        for (size_t i = 0; i < samples; i++) {
+            out[i] = alaw_encode_table[(pcm[i] >> G711_ALAW_SHIFT) + G711_ALAW_ENTRIES / 2];
+        }
+    }
+}
+
+void g711_decode(g711_law_t law, const uint8_t *in, int16_t *pcm, size_t samples)
+{
+    const int16_t *table = law == G711_ULAW ? ulaw_decode_table : alaw_decode_table;
+
+    for (size_t i = 0; i < samples; i++) {
+        pcm[i] = table[in[i]];
+    }
+}
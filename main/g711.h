@@ -0,0 +1,70 @@
+#ifndef G711_H
+#define G711_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief G.711 companding law
+ */
+typedef enum {
+    G711_ULAW,      ///< PCMU, RTP payload type 0
+    G711_ALAW       ///< PCMA, RTP payload type 8
+} g711_law_t;
+
+/**
+ * @brief Build the lookup tables
+ *
+ * Idempotent and cheap to call again. Encoding and decoding use the
+ * tables, so this must run once before the first frame; the RTP engine
+ * does it when it starts. Needs about 21 KB of RAM.
+ */
+void g711_init(void);
+
+/**
+ * @brief Encode a frame of 16-bit linear PCM
+ *
+ * One table lookup per sample: µ-law is indexed by the top 14 bits,
+ * A-law by the top 12, which is all the precision either law keeps.
+ *
+ * @param law Companding law
+ * @param pcm Samples
+ * @param out Encoded bytes, one per sample
+ * @param samples Number of samples
+ */
+void g711_encode(g711_law_t law, const int16_t *pcm, uint8_t *out, size_t samples);
+
+/**
+ * @brief Decode a frame to 16-bit linear PCM
+ */
+void g711_decode(g711_law_t law, const uint8_t *in, int16_t *pcm, size_t samples);
+
+/**
+ * @brief Reference µ-law encoder the tables are built from (exposed for tests)
+ */
+uint8_t g711_linear_to_ulaw(int16_t pcm);
+
+/**
+ * @brief Reference µ-law decoder
+ */
+int16_t g711_ulaw_to_linear(uint8_t code);
+
+/**
+ * @brief Reference A-law encoder
+ */
+uint8_t g711_linear_to_alaw(int16_t pcm);
+
+/**
+ * @brief Reference A-law decoder
+ */
+int16_t g711_alaw_to_linear(uint8_t code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // G711_H
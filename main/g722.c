@@ -0,0 +1,285 @@
+#include "g722.h"
+#include <string.h>
+
+// Tables and block names follow ITU-T G.722 (09/2012), 64 kbit/s mode only
+
+// Transmit and receive QMF, one half of the symmetric 24-tap filter
+static const int16_t qmf_coeffs[12] = {
+    3, -11, 12, 32, -210, 951, 3876, -805, 362, -156, 53, -11
+};
+
+// Lower band: 6-bit quantizer decision levels and codes
+static const int16_t q6[32] = {
+    0, 35, 72, 110, 150, 190, 233, 276, 323, 370, 422, 473, 530, 587, 650, 714,
+    786, 858, 940, 1023, 1121, 1219, 1339, 1458, 1612, 1765, 1980, 2195, 2557, 2919, 0, 0
+};
+static const uint8_t iln[32] = {
+    0, 63, 62, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19,
+    18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 0
+};
+static const uint8_t ilp[32] = {
+    0, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48, 47,
+    46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 32, 0
+};
+
+// Lower band: inverse quantizers of the 6-bit and the truncated 4-bit code
+static const int16_t qm6[64] = {
+    -136, -136, -136, -136, -24808, -21904, -19008, -16704,
+    -14984, -13512, -12280, -11192, -10232, -9360, -8576, -7856,
+    -7192, -6576, -6000, -5456, -4944, -4464, -4008, -3576,
+    -3168, -2776, -2400, -2032, -1688, -1360, -1040, -728,
+    24808, 21904, 19008, 16704, 14984, 13512, 12280, 11192,
+    10232, 9360, 8576, 7856, 7192, 6576, 6000, 5456,
+    4944, 4464, 4008, 3576, 3168, 2776, 2400, 2032,
+    1688, 1360, 1040, 728, 432, 136, -432, -136
+};
+static const int16_t qm4[16] = {
+    0, -20456, -12896, -8968, -6288, -4240, -2584, -1200,
+    20456, 12896, 8968, 6288, 4240, 2584, 1200, 0
+};
+static const uint8_t rl42[16] = { 0, 7, 6, 5, 4, 3, 2, 1, 7, 6, 5, 4, 3, 2, 1, 0 };
+static const int16_t wl[8] = { -60, -30, 58, 172, 334, 538, 1198, 3042 };
+
+// Upper band: 2-bit quantizer
+static const int16_t qm2[4] = { -7408, -1616, 7408, 1616 };
+static const uint8_t ihn[3] = { 0, 1, 0 };
+static const uint8_t ihp[3] = { 0, 3, 2 };
+static const uint8_t rh2[4] = { 2, 1, 2, 1 };
+static const int16_t wh[3] = { 0, -214, 798 };
+
+// Scale factor antilog
+static const int16_t ilb[32] = {
+    2048, 2093, 2139, 2186, 2233, 2282, 2332, 2383, 2435, 2489, 2543, 2599, 2656, 2714, 2774, 2834,
+    2896, 2960, 3025, 3091, 3158, 3228, 3298, 3371, 3444, 3520, 3597, 3676, 3756, 3838, 3922, 4008
+};
+
+// Limits of the logarithmic scale factors and the antilog shift base
+#define LOW_NB_MAX      18432
+#define HIGH_NB_MAX     22528
+#define LOW_SCALE_BASE  8
+#define HIGH_SCALE_BASE 10
+
+static inline int32_t saturate(int32_t value)
+{
+    if (value > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (value < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return value;
+}
+
+static inline int32_t clamp(int32_t value, int32_t low, int32_t high)
+{
+    return value < low ? low : value > high ? high : value;
+}
+
+/**
+ * @brief Blocks LOGSCL/LOGSCH and SCALEL/SCALEH: adapt the quantizer step
+ */
+static void update_scale(g722_band_t *band, int32_t weight, int32_t nb_max, int base)
+{
+    band->nb = clamp(((band->nb * 127) >> 7) + weight, 0, nb_max);
+
+    int32_t mantissa = ilb[(band->nb >> 6) & 31];
+    int shift = base - (band->nb >> 11);
+    band->det = (shift < 0 ? mantissa << -shift : mantissa >> shift) << 2;
+}
+
+/**
+ * @brief Block 4: reconstruct, adapt the predictor and compute the next estimate
+ */
+static void adapt_predictor(g722_band_t *band, int32_t d)
+{
+    int32_t r0 = saturate(band->s + d);
+    int32_t p0 = saturate(band->sz + d);
+
+    // UPPOL2
+    int32_t sg0 = p0 >> 15;
+    int32_t sg1 = band->p[1] >> 15;
+    int32_t sg2 = band->p[2] >> 15;
+    int32_t wd1 = saturate(band->a[1] << 2);
+    int32_t wd2 = sg0 == sg1 ? -wd1 : wd1;
+    if (wd2 > INT16_MAX) {
+        wd2 = INT16_MAX;
+    }
+    int32_t a2 = (wd2 >> 7) + (sg0 == sg2 ? 128 : -128) + ((band->a[2] * 32512) >> 15);
+    a2 = clamp(a2, -12288, 12288);
+
+    // UPPOL1
+    int32_t a1 = saturate((sg0 == sg1 ? 192 : -192) + ((band->a[1] * 32640) >> 15));
+    int32_t a1_limit = saturate(15360 - a2);
+    a1 = clamp(a1, -a1_limit, a1_limit);
+
+    // UPZERO and DELAYA
+    int32_t step = d == 0 ? 0 : 128;
+    int32_t sgd = d >> 15;
+    for (int i = 6; i > 0; i--) {
+        int32_t bp = saturate(((band->d[i] >> 15) == sgd ? step : -step) + ((band->b[i] * 32640) >> 15));
+        band->b[i] = bp;
+    }
+    for (int i = 6; i > 1; i--) {
+        band->d[i] = band->d[i - 1];
+    }
+    band->d[1] = d;
+    band->r[2] = band->r[1];
+    band->r[1] = r0;
+    band->p[2] = band->p[1];
+    band->p[1] = p0;
+    band->a[1] = a1;
+    band->a[2] = a2;
+
+    // FILTEP, FILTEZ and PREDIC
+    int32_t sp = saturate(((band->a[1] * saturate(band->r[1] + band->r[1])) >> 15) +
+                          ((band->a[2] * saturate(band->r[2] + band->r[2])) >> 15));
+    int32_t sz = 0;
+    for (int i = 6; i > 0; i--) {
+        sz += (band->b[i] * saturate(band->d[i] + band->d[i])) >> 15;
+    }
+    band->sz = saturate(sz);
+    band->s = saturate(sp + band->sz);
+}
+
+void g722_init(g722_state_t *state)
+{
+    memset(state, 0, sizeof(*state));
+    state->band[0].det = 32;
+    state->band[1].det = 8;
+}
+
+/**
+ * @brief Transmit QMF on the newest sample pair, keeping every other output
+ */
+static void split_bands(const int32_t *qmf, int32_t *xlow, int32_t *xhigh)
+{
+    int32_t sum_odd = 0;
+    int32_t sum_even = 0;
+    for (int i = 0; i < 12; i++) {
+        sum_odd += qmf[2 * i] * qmf_coeffs[i];
+        sum_even += qmf[2 * i + 1] * qmf_coeffs[11 - i];
+    }
+    *xlow = (sum_even + sum_odd) >> 14;
+    *xhigh = (sum_even - sum_odd) >> 14;
+}
+
+/**
+ * @brief SUBTRA, QUANTL and QUANTH: the code for one pair of sub-band samples
+ */
+static uint8_t quantize(const g722_state_t *state, int32_t xlow, int32_t xhigh)
+{
+    const g722_band_t *low = &state->band[0];
+    const g722_band_t *high = &state->band[1];
+
+    int32_t el = saturate(xlow - low->s);
+    int32_t magnitude = el >= 0 ? el : -(el + 1);
+    int level;
+    for (level = 1; level < 30; level++) {
+        if (magnitude < ((q6[level] * low->det) >> 12)) {
+            break;
+        }
+    }
+    int ilow = el < 0 ? iln[level] : ilp[level];
+
+    int32_t eh = saturate(xhigh - high->s);
+    magnitude = eh >= 0 ? eh : -(eh + 1);
+    int mih = magnitude >= ((564 * high->det) >> 12) ? 2 : 1;
+    int ihigh = eh < 0 ? ihn[mih] : ihp[mih];
+
+    return (uint8_t)((ihigh << 6) | ilow);
+}
+
+/**
+ * @brief Decode one code into two samples, adapting both bands
+ */
+static void decode_code(g722_state_t *state, uint8_t code, int16_t *pcm)
+{
+    g722_band_t *low = &state->band[0];
+    g722_band_t *high = &state->band[1];
+    int ilow = code & 0x3f;
+    int ihigh = (code >> 6) & 0x03;
+
+    // Lower band: INVQBL and RECONS on the full code, adaptation on the 4-bit one
+    int32_t rlow = clamp(low->s + ((low->det * qm6[ilow]) >> 15), -16384, 16383);
+    int ril = ilow >> 2;
+    int32_t dlow = (low->det * qm4[ril]) >> 15;
+    update_scale(low, wl[rl42[ril]], LOW_NB_MAX, LOW_SCALE_BASE);
+    adapt_predictor(low, dlow);
+
+    // Upper band: INVQAH and RECONS
+    int32_t dhigh = (high->det * qm2[ihigh]) >> 15;
+    int32_t rhigh = clamp(high->s + dhigh, -16384, 16383);
+    update_scale(high, wh[rh2[ihigh]], HIGH_NB_MAX, HIGH_SCALE_BASE);
+    adapt_predictor(high, dhigh);
+
+    // Receive QMF, two output samples per code
+    memmove(state->qmf, state->qmf + 2, 22 * sizeof(state->qmf[0]));
+    state->qmf[22] = rlow + rhigh;
+    state->qmf[23] = rlow - rhigh;
+    int32_t out1 = 0;
+    int32_t out2 = 0;
+    for (int i = 0; i < 12; i++) {
+        out2 += state->qmf[2 * i] * qmf_coeffs[i];
+        out1 += state->qmf[2 * i + 1] * qmf_coeffs[11 - i];
+    }
+    pcm[0] = (int16_t)saturate(out1 >> 11);
+    pcm[1] = (int16_t)saturate(out2 >> 11);
+}
+
+size_t g722_encode(g722_state_t *state, const int16_t *pcm, uint8_t *out, size_t samples)
+{
+    g722_band_t *low = &state->band[0];
+    g722_band_t *high = &state->band[1];
+    size_t len = 0;
+
+    for (size_t j = 0; j + 1 < samples; j += 2) {
+        memmove(state->qmf, state->qmf + 2, 22 * sizeof(state->qmf[0]));
+        state->qmf[22] = pcm[j];
+        state->qmf[23] = pcm[j + 1];
+        int32_t xlow;
+        int32_t xhigh;
+        split_bands(state->qmf, &xlow, &xhigh);
+        uint8_t code = quantize(state, xlow, xhigh);
+
+        // INVQAL and INVQAH on the truncated codes, then adapt as the decoder will
+        int ril = (code & 0x3f) >> 2;
+        int32_t dlow = (low->det * qm4[ril]) >> 15;
+        update_scale(low, wl[rl42[ril]], LOW_NB_MAX, LOW_SCALE_BASE);
+        adapt_predictor(low, dlow);
+        int ihigh = code >> 6;
+        int32_t dhigh = (high->det * qm2[ihigh]) >> 15;
+        update_scale(high, wh[rh2[ihigh]], HIGH_NB_MAX, HIGH_SCALE_BASE);
+        adapt_predictor(high, dhigh);
+
+        out[len++] = code;
+    }
+    return len;
+}
+
+size_t g722_decode(g722_state_t *state, const uint8_t *in, int16_t *pcm, size_t len)
+{
+    for (size_t j = 0; j < len; j++) {
+        decode_code(state, in[j], pcm + 2 * j);
+    }
+    return 2 * len;
+}
+
+void g722_conceal(g722_state_t *state, const int16_t *pcm, size_t samples)
+{
+    // The encoder's input ran G722_CONCEAL_LOOKAHEAD samples ahead of the decoder's output
+    int32_t qmf[24];
+    for (int i = 0; i < 22; i++) {
+        qmf[i + 2] = pcm[i];
+    }
+
+    for (size_t j = 0; j + 1 < samples; j += 2) {
+        memmove(qmf, qmf + 2, 22 * sizeof(qmf[0]));
+        qmf[22] = pcm[j + G722_CONCEAL_LOOKAHEAD];
+        qmf[23] = pcm[j + G722_CONCEAL_LOOKAHEAD + 1];
+        int32_t xlow;
+        int32_t xhigh;
+        split_bands(qmf, &xlow, &xhigh);
+        int16_t decoded[2];
+        decode_code(state, quantize(state, xlow, xhigh), decoded);
+    }
+}
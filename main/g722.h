@@ -0,0 +1,95 @@
+#ifndef G722_H
+#define G722_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Audio rate of G.722; the RTP clock stays at 8000 (RFC 3551)
+ */
+#define G722_SAMPLE_RATE    16000
+
+/**
+ * @brief ADPCM state of one sub-band
+ */
+typedef struct {
+    int32_t s;          ///< Signal estimate
+    int32_t sz;         ///< Zero section of the estimate
+    int32_t r[3];       ///< Reconstructed signal, [0] unused
+    int32_t p[3];       ///< Partial reconstruction, [0] unused
+    int32_t a[3];       ///< Pole coefficients, [0] unused
+    int32_t b[7];       ///< Zero coefficients, [0] unused
+    int32_t d[7];       ///< Quantized differences, [0] unused
+    int32_t nb;         ///< Logarithmic scale factor
+    int32_t det;        ///< Quantizer scale factor
+} g722_band_t;
+
+/**
+ * @brief Encoder or decoder state of one direction of a call
+ */
+typedef struct {
+    int32_t qmf[24];    ///< Quadrature mirror filter delay line
+    g722_band_t band[2];    ///< Lower and upper sub-band
+} g722_state_t;
+
+/**
+ * @brief Reset the state for a new stream
+ */
+void g722_init(g722_state_t *state);
+
+/**
+ * @brief Encode 16 kHz 16-bit PCM at 64 kbit/s
+ *
+ * Fixed-point sub-band ADPCM as in ITU-T G.722: a QMF splits each pair of
+ * samples into a 6-bit lower and a 2-bit upper band code, packed into
+ * one byte.
+ *
+ * @param state Encoder state
+ * @param pcm Samples, an even number
+ * @param out Encoded bytes, one per two samples
+ * @param samples Number of samples
+ * @return Bytes written
+ */
+size_t g722_encode(g722_state_t *state, const int16_t *pcm, uint8_t *out, size_t samples);
+
+/**
+ * @brief Decode to 16 kHz 16-bit PCM
+ *
+ * @param state Decoder state
+ * @param in Encoded bytes
+ * @param pcm Samples, two per byte
+ * @param len Number of bytes
+ * @return Samples written
+ */
+size_t g722_decode(g722_state_t *state, const uint8_t *in, int16_t *pcm, size_t len);
+
+/**
+ * @brief Samples beyond the concealed ones that g722_conceal() reads, the QMF delay
+ */
+#define G722_CONCEAL_LOOKAHEAD  22
+
+/**
+ * @brief Keep the decoder in step across audio that concealed lost packets
+ *
+ * The concealed audio is re-encoded against the decoder's own state and
+ * the codes decoded, as in ITU-T G.722 Appendix III: the sub-band
+ * predictors, quantizer scales and receive QMF adapt to it as if it had
+ * been received, so the first packet after the loss decodes without a
+ * jump.
+ *
+ * @param state Decoder state
+ * @param pcm Concealed samples, an even number, followed by
+ *            G722_CONCEAL_LOOKAHEAD samples of how the concealment goes on
+ * @param samples Number of concealed samples
+ */
+void g722_conceal(g722_state_t *state, const int16_t *pcm, size_t samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // G722_H
@@ -1,6 +1,7 @@
 #include "io_manager.h"
 #include "io_events.h"
 #include "web_server.h"
+#include "call_latency.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
@@ -207,6 +208,7 @@ esp_err_t io_manager_virtual_button_press(void)
     }
 
     ESP_LOGI(TAG, "Virtual button press triggered");
+    call_latency_mark(CALL_LATENCY_BUTTON_EDGE);
     
     // Publish button press event
     io_events_publish_button(true);
@@ -279,7 +281,8 @@ static void button_task(void *arg)
     while (1) {
         // Read button state (active low)
         bool current_state = !gpio_get_level(BUTTON_GPIO);
-        int64_t current_time = esp_timer_get_time() / 1000; // Convert to milliseconds
+        int64_t now_us = esp_timer_get_time();
+        int64_t current_time = now_us / 1000; // Convert to milliseconds
 
         // Check if state changed and debounce time has passed
         if (current_state != s_io_state.button_last_state) {
@@ -287,6 +290,11 @@ static void button_task(void *arg)
                 s_io_state.button_last_state = current_state;
                 s_io_state.button_last_change_time = current_time;
 
+                // Stamp before logging so the log output counts towards call setup latency
+                if (current_state) {
+                    call_latency_mark_at(CALL_LATENCY_BUTTON_EDGE, now_us);
+                }
+
                 ESP_LOGI(TAG, "Button %s", current_state ? "PRESSED" : "RELEASED");
 
                 // Publish button event
@@ -0,0 +1,219 @@
+#include "jitter_buffer.h"
+#include <string.h>
+
+// A timestamp jump of more than this is a new stream, not a late burst
+#define JB_RESYNC_FRAMES        (4 * JITTER_BUFFER_SLOTS)
+
+// The peak delay decays by 1/256 of its excess per packet, about 5 s at 50 packets/s
+#define JB_PEAK_SHIFT           8
+
+// Frames above the playout delay tolerated before one is dropped
+#define JB_SHRINK_HYSTERESIS    2
+
+static void clear_slots(jitter_buffer_t *jb)
+{
+    for (int i = 0; i < JITTER_BUFFER_SLOTS; i++) {
+        jb->slots[i].used = false;
+    }
+}
+
+void jitter_buffer_init(jitter_buffer_t *jb, uint32_t frame_ticks,
+                        uint32_t min_delay_frames, uint32_t max_delay_frames)
+{
+    memset(jb, 0, sizeof(*jb));
+    if (min_delay_frames < 1) {
+        min_delay_frames = 1;
+    }
+    if (max_delay_frames >= JITTER_BUFFER_SLOTS) {
+        max_delay_frames = JITTER_BUFFER_SLOTS - 1;
+    }
+    if (max_delay_frames < min_delay_frames) {
+        max_delay_frames = min_delay_frames;
+    }
+    jb->frame_ticks = frame_ticks;
+    jb->min_delay = min_delay_frames * frame_ticks;
+    jb->max_delay = max_delay_frames * frame_ticks;
+    jb->target_delay = jb->min_delay;
+}
+
+void jitter_buffer_flush(jitter_buffer_t *jb)
+{
+    clear_slots(jb);
+    jb->started = false;
+    jb->playing = false;
+}
+
+void jitter_buffer_pause(jitter_buffer_t *jb)
+{
+    jb->paused = true;
+}
+
+/**
+ * @brief Slot of the frame that is frames_ahead frames after play_ts
+ */
+static jitter_buffer_slot_t *slot_at(jitter_buffer_t *jb, uint32_t frames_ahead)
+{
+    return &jb->slots[(jb->play_index + frames_ahead) % JITTER_BUFFER_SLOTS];
+}
+
+/**
+ * @brief Move playout one frame on, returning the frame that was due
+ */
+static jitter_buffer_slot_t *advance(jitter_buffer_t *jb)
+{
+    jitter_buffer_slot_t *slot = slot_at(jb, 0);
+    bool due = slot->used && slot->timestamp == jb->play_ts;
+
+    slot->used = false;
+    jb->play_ts += jb->frame_ticks;
+    jb->play_index++;
+    return due ? slot : NULL;
+}
+
+static void update_delay(jitter_buffer_t *jb, uint32_t timestamp, uint32_t arrival)
+{
+    int32_t transit = (int32_t)(arrival - timestamp);
+    if (transit - jb->min_transit < 0) {
+        jb->min_transit = transit;
+    }
+
+    // Delay of this packet over the fastest one, capped so the scaling cannot overflow
+    uint32_t delay = (uint32_t)(transit - jb->min_transit);
+    if (delay > jb->max_delay) {
+        delay = jb->max_delay;
+    }
+    uint32_t scaled = delay << JB_PEAK_SHIFT;
+    if (scaled > jb->peak_delay) {
+        jb->peak_delay = scaled;
+    } else {
+        jb->peak_delay -= (jb->peak_delay - scaled) >> JB_PEAK_SHIFT;
+    }
+
+    // Whole frames covering the peak, plus one for the phase of the playout clock
+    uint32_t peak = jb->peak_delay >> JB_PEAK_SHIFT;
+    uint32_t target = ((peak + jb->frame_ticks - 1) / jb->frame_ticks + 1) * jb->frame_ticks;
+    if (target < jb->min_delay) {
+        target = jb->min_delay;
+    } else if (target > jb->max_delay) {
+        target = jb->max_delay;
+    }
+    jb->target_delay = target;
+}
+
+static void insert_frame(jitter_buffer_t *jb, uint32_t timestamp, const uint8_t *payload, size_t len)
+{
+    int32_t offset = (int32_t)(timestamp - jb->play_ts);
+
+    if (offset < 0) {
+        uint32_t behind = ((uint32_t)-offset + jb->frame_ticks - 1) / jb->frame_ticks;
+        if (jb->playing || (uint32_t)(jb->newest_ts - timestamp) / jb->frame_ticks >= JITTER_BUFFER_SLOTS) {
+            jb->stats.late_drops++;
+            return;
+        }
+        // Overtaken by later packets before playout began: start earlier
+        jb->play_ts -= behind * jb->frame_ticks;
+        jb->play_index -= behind;
+        offset = (int32_t)(timestamp - jb->play_ts);
+    }
+
+    uint32_t ahead = (uint32_t)offset / jb->frame_ticks;
+    while (ahead >= JITTER_BUFFER_SLOTS) {
+        // No room: give up the oldest frames rather than the newest
+        if (advance(jb) != NULL) {
+            jb->stats.discarded++;
+        }
+        ahead--;
+    }
+
+    jitter_buffer_slot_t *slot = slot_at(jb, ahead);
+    if (slot->used && slot->timestamp == timestamp) {
+        jb->stats.duplicates++;
+        return;
+    }
+    slot->used = true;
+    slot->timestamp = timestamp;
+    slot->len = (uint16_t)len;
+    memcpy(slot->payload, payload, len);
+
+    if ((int32_t)(timestamp - jb->newest_ts) > 0) {
+        jb->newest_ts = timestamp;
+    }
+}
+
+void jitter_buffer_put(jitter_buffer_t *jb, uint32_t timestamp, const uint8_t *payload,
+                       size_t len, uint32_t arrival)
+{
+    if (len == 0) {
+        return;
+    }
+
+    if (jb->started) {
+        int32_t offset = (int32_t)(timestamp - jb->play_ts);
+        int32_t limit = (int32_t)(JB_RESYNC_FRAMES * jb->frame_ticks);
+        if (offset > limit || offset < -limit) {
+            jb->stats.resyncs++;
+            jitter_buffer_flush(jb);
+        } else if (!jb->playing && offset > 0 && (int32_t)(jb->newest_ts - jb->play_ts) < 0) {
+            // Ran dry, e.g. while the sender paused in silence: the next talkspurt starts here
+            jb->play_ts = timestamp;
+        }
+    }
+    jb->paused = false;
+    if (!jb->started) {
+        jb->started = true;
+        jb->play_ts = timestamp;
+        jb->newest_ts = timestamp;
+        jb->min_transit = (int32_t)(arrival - timestamp);
+    }
+    update_delay(jb, timestamp, arrival);
+
+    while (len > 0) {
+        size_t frame_len = len < JITTER_BUFFER_FRAME_BYTES ? len : JITTER_BUFFER_FRAME_BYTES;
+        insert_frame(jb, timestamp, payload, frame_len);
+        payload += frame_len;
+        len -= frame_len;
+        timestamp += jb->frame_ticks;
+    }
+}
+
+uint32_t jitter_buffer_depth(const jitter_buffer_t *jb)
+{
+    int32_t span = (int32_t)(jb->newest_ts - jb->play_ts);
+    if (!jb->started || span < 0) {
+        return 0;
+    }
+    return (uint32_t)span / jb->frame_ticks + 1;
+}
+
+jitter_buffer_result_t jitter_buffer_get(jitter_buffer_t *jb, uint8_t *payload, size_t *len)
+{
+    uint32_t depth = jitter_buffer_depth(jb);
+    uint32_t target_frames = jb->target_delay / jb->frame_ticks;
+
+    if (!jb->playing) {
+        if (depth == 0 || depth < target_frames) {
+            return JITTER_BUFFER_BUFFERING;
+        }
+        jb->playing = true;
+    } else if (depth == 0) {
+        // Ran dry: wait for the playout delay again, which has grown if packets came late
+        jb->stats.underruns += !jb->paused;
+        jb->playing = false;
+        return JITTER_BUFFER_BUFFERING;
+    } else if (depth > target_frames + JB_SHRINK_HYSTERESIS) {
+        // The delay estimate has come down: catch up by one frame
+        if (advance(jb) != NULL) {
+            jb->stats.discarded++;
+        }
+    }
+
+    jitter_buffer_slot_t *slot = advance(jb);
+    if (slot == NULL) {
+        jb->stats.frames_missing++;
+        return JITTER_BUFFER_MISSING;
+    }
+    memcpy(payload, slot->payload, slot->len);
+    *len = slot->len;
+    jb->stats.frames_played++;
+    return JITTER_BUFFER_FRAME;
+}
@@ -0,0 +1,134 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Frames the buffer can hold, 320 ms at 20 ms per frame
+ */
+#define JITTER_BUFFER_SLOTS         16
+
+/**
+ * @brief Encoded bytes of one frame, 20 ms of G.711
+ */
+#define JITTER_BUFFER_FRAME_BYTES   160
+
+/**
+ * @brief Outcome of taking the next frame out of the buffer
+ */
+typedef enum {
+    JITTER_BUFFER_FRAME,        ///< A received frame is due
+    JITTER_BUFFER_MISSING,      ///< The frame due was lost or is too late, conceal it
+    JITTER_BUFFER_BUFFERING     ///< Filling up to the playout delay, play silence
+} jitter_buffer_result_t;
+
+/**
+ * @brief Counters of one buffer
+ */
+typedef struct {
+    uint32_t frames_played;     ///< Received frames taken out for playout
+    uint32_t frames_missing;    ///< Frames that had to be concealed
+    uint32_t late_drops;        ///< Frames arriving after their playout time
+    uint32_t duplicates;        ///< Frames received twice
+    uint32_t discarded;         ///< Frames dropped to shorten the delay or on overflow
+    uint32_t underruns;         ///< Times the buffer ran dry while playing, pauses not counted
+    uint32_t resyncs;           ///< Timestamp jumps that restarted the buffer
+} jitter_buffer_stats_t;
+
+typedef struct {
+    bool used;
+    uint16_t len;
+    uint32_t timestamp;
+    uint8_t payload[JITTER_BUFFER_FRAME_BYTES];
+} jitter_buffer_slot_t;
+
+/**
+ * @brief Adaptive playout buffer over a fixed pool of frame slots
+ *
+ * Frames are ordered by RTP timestamp, so reordered packets fall into
+ * place and packets carrying several frames are split. The playout delay
+ * follows the peak delay of recent packets over the fastest one seen,
+ * which tracks bursty arrival better than the smoothed RFC 3550 jitter:
+ * it grows at once when a burst arrives late and decays over seconds.
+ * A sender that stops in silence just lets the buffer run dry; the first
+ * frame after the pause starts playout again, with a fresh prebuffer.
+ * All times are in RTP timestamp units.
+ */
+typedef struct {
+    uint32_t frame_ticks;           ///< Timestamp units per frame
+    uint32_t min_delay;             ///< Lower bound of the playout delay
+    uint32_t max_delay;             ///< Upper bound of the playout delay
+
+    bool started;                   ///< A frame has been received
+    bool playing;                   ///< Prebuffering done, frames are due
+    bool paused;                    ///< The sender said it pauses, no frame since
+    uint32_t play_ts;               ///< Timestamp of the next frame to play
+    uint32_t play_index;            ///< Running frame number of play_ts, selects its slot
+    uint32_t newest_ts;             ///< Highest frame timestamp buffered
+    int32_t min_transit;            ///< Smallest arrival minus timestamp seen
+    uint32_t peak_delay;            ///< Decaying peak of the delay over min_transit, scaled by 256
+    uint32_t target_delay;          ///< Current playout delay, a whole number of frames
+
+    jitter_buffer_slot_t slots[JITTER_BUFFER_SLOTS];
+    jitter_buffer_stats_t stats;
+} jitter_buffer_t;
+
+/**
+ * @brief Reset a buffer for a new stream
+ *
+ * @param frame_ticks Timestamp units per frame, 160 for 20 ms at 8 kHz
+ * @param min_delay_frames Smallest playout delay, at least 1
+ * @param max_delay_frames Largest playout delay, below JITTER_BUFFER_SLOTS
+ */
+void jitter_buffer_init(jitter_buffer_t *jb, uint32_t frame_ticks,
+                        uint32_t min_delay_frames, uint32_t max_delay_frames);
+
+/**
+ * @brief Drop all frames but keep the delay estimate, e.g. on a new source
+ */
+void jitter_buffer_flush(jitter_buffer_t *jb);
+
+/**
+ * @brief Note that the sender pauses, e.g. on comfort noise
+ *
+ * The buffered frames still play; running dry after them is not counted
+ * as an underrun.
+ */
+void jitter_buffer_pause(jitter_buffer_t *jb);
+
+/**
+ * @brief Add the payload of one packet
+ *
+ * A payload longer than a frame is split into frames of
+ * JITTER_BUFFER_FRAME_BYTES, one frame_ticks apart.
+ *
+ * @param timestamp RTP timestamp of the packet
+ * @param arrival Arrival time in timestamp units
+ */
+void jitter_buffer_put(jitter_buffer_t *jb, uint32_t timestamp, const uint8_t *payload,
+                       size_t len, uint32_t arrival);
+
+/**
+ * @brief Take the frame due now, called once per frame period
+ *
+ * @param payload Receives the frame for JITTER_BUFFER_FRAME
+ * @param len Receives its length
+ */
+jitter_buffer_result_t jitter_buffer_get(jitter_buffer_t *jb, uint8_t *payload, size_t *len);
+
+/**
+ * @brief Frames buffered ahead of playout, gaps included
+ */
+uint32_t jitter_buffer_depth(const jitter_buffer_t *jb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JITTER_BUFFER_H
@@ -0,0 +1,202 @@
+#include "noise_suppressor.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(ESP_PLATFORM) && __has_include("dsps_fft2r.h")
+#include "dsps_fft2r.h"
+#define NS_USE_ESP_DSP          1
+#else
+#define NS_USE_ESP_DSP          0
+#endif
+
+// Share of the newest hop in the smoothed power spectrum
+#define SMOOTHING               0.2f
+// The tracked floor sits below the mean noise power, this lifts it back
+#define NOISE_BIAS              2.0f
+// Decision-directed weight of the last hop's speech estimate; lower lets more musical noise through
+#define PRIOR_WEIGHT            0.98f
+// Keeps silent bins from dividing by zero
+#define POWER_EPSILON           1.0f
+
+static inline int16_t saturate16(float value)
+{
+    return value >= INT16_MAX ? INT16_MAX : value <= INT16_MIN ? INT16_MIN : (int16_t)lrintf(value);
+}
+
+bool noise_suppressor_set_level(noise_suppressor_t *ns, uint8_t level_db)
+{
+    if (level_db > NOISE_SUPPRESSOR_MAX_LEVEL_DB) {
+        return false;
+    }
+    ns->gain_floor = powf(10.0f, -level_db / 20.0f);
+    return true;
+}
+
+bool noise_suppressor_init(noise_suppressor_t *ns, uint32_t sample_rate, uint8_t level_db)
+{
+    if ((sample_rate != 8000 && sample_rate != NOISE_SUPPRESSOR_MAX_RATE) ||
+        level_db > NOISE_SUPPRESSOR_MAX_LEVEL_DB) {
+        return false;
+    }
+#if NS_USE_ESP_DSP
+    // Shared by every user of the ESP-DSP FFT, allocated once
+    if (dsps_fft2r_init_fc32(NULL, CONFIG_DSP_MAX_FFT_SIZE) != ESP_OK) {
+        return false;
+    }
+#endif
+    memset(ns, 0, sizeof(*ns));
+    ns->hop = (uint16_t)(sample_rate * NOISE_SUPPRESSOR_HOP_MS / 1000);
+    ns->fft_size = sample_rate == NOISE_SUPPRESSOR_MAX_RATE ? NOISE_SUPPRESSOR_MAX_FFT : NOISE_SUPPRESSOR_MAX_FFT / 2;
+    ns->rise = powf(10.0f, NOISE_SUPPRESSOR_RISE_DB_S * NOISE_SUPPRESSOR_HOP_MS / 10000.0f);
+    noise_suppressor_set_level(ns, level_db);
+
+    // Square-root periodic Hann: applied on the way in and out, the overlapping halves sum to one
+    for (unsigned i = 0; i < 2u * ns->hop; i++) {
+        ns->window[i] = sqrtf(0.5f - 0.5f * cosf((float)M_PI * i / ns->hop));
+    }
+    for (unsigned k = 0; k < ns->fft_size / 2u; k++) {
+        ns->cos_table[k] = cosf(2.0f * (float)M_PI * k / ns->fft_size);
+        ns->sin_table[k] = sinf(2.0f * (float)M_PI * k / ns->fft_size);
+    }
+    return true;
+}
+
+/**
+ * @brief In-place forward FFT of the work buffer
+ */
+static void fft(noise_suppressor_t *ns)
+{
+#if NS_USE_ESP_DSP
+    dsps_fft2r_fc32(ns->fft, ns->fft_size);
+    dsps_bit_rev_fc32(ns->fft, ns->fft_size);
+#else
+    float *x = ns->fft;
+    const unsigned n = ns->fft_size;
+
+    for (unsigned i = 1, j = 0; i < n; i++) {
+        unsigned bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j) {
+            float re = x[2 * i];
+            float im = x[2 * i + 1];
+            x[2 * i] = x[2 * j];
+            x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j] = re;
+            x[2 * j + 1] = im;
+        }
+    }
+    for (unsigned half = 1; half < n; half <<= 1) {
+        const unsigned step = n / (2 * half);
+        for (unsigned i = 0; i < n; i += 2 * half) {
+            for (unsigned k = 0; k < half; k++) {
+                float wr = ns->cos_table[k * step];
+                float wi = -ns->sin_table[k * step];
+                float *a = &x[2 * (i + k)];
+                float *b = &x[2 * (i + k + half)];
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Update the noise floor of one bin and return its gain
+ */
+static float bin_gain(noise_suppressor_t *ns, unsigned k, float power)
+{
+    if (ns->hops == 0) {
+        // Nothing to compare against yet: take the first hop as the floor
+        ns->smoothed[k] = power;
+        ns->noise[k] = power;
+    } else {
+        ns->smoothed[k] += SMOOTHING * (power - ns->smoothed[k]);
+        float risen = ns->noise[k] * ns->rise;
+        ns->noise[k] = ns->smoothed[k] < risen ? ns->smoothed[k] : risen;
+    }
+
+    float noise = NOISE_BIAS * ns->noise[k] + POWER_EPSILON;
+    float posterior = power / noise - 1.0f;
+    float prior = PRIOR_WEIGHT * ns->clean[k] / noise +
+                  (1.0f - PRIOR_WEIGHT) * (posterior > 0 ? posterior : 0);
+    float gain = prior / (1.0f + prior);
+    gain = gain > ns->gain_floor ? gain : ns->gain_floor;
+    ns->clean[k] = gain * gain * power;
+    return gain;
+}
+
+/**
+ * @brief Filter the frame ending with the hop just completed
+ */
+static void process_hop(noise_suppressor_t *ns)
+{
+    const unsigned hop = ns->hop;
+    const unsigned n = ns->fft_size;
+    float *x = ns->fft;
+
+    for (unsigned i = 0; i < 2 * hop; i++) {
+        x[2 * i] = ns->frame[i] * ns->window[i];
+        x[2 * i + 1] = 0;
+    }
+    memset(&x[4 * hop], 0, (n - 2 * hop) * 2 * sizeof(float));
+    fft(ns);
+
+    // Real input: bin n - k mirrors bin k, so both take the same gain
+    for (unsigned k = 0; k <= n / 2; k++) {
+        float gain = bin_gain(ns, k, x[2 * k] * x[2 * k] + x[2 * k + 1] * x[2 * k + 1]);
+        x[2 * k] *= gain;
+        x[2 * k + 1] *= gain;
+        if (k > 0 && k < n / 2) {
+            x[2 * (n - k)] *= gain;
+            x[2 * (n - k) + 1] *= gain;
+        }
+    }
+
+    // Inverse by conjugating around the forward transform; the result is real
+    for (unsigned k = 0; k < n; k++) {
+        x[2 * k + 1] = -x[2 * k + 1];
+    }
+    fft(ns);
+
+    const float scale = 1.0f / n;
+    for (unsigned i = 0; i < hop; i++) {
+        ns->ready[i] = saturate16(ns->overlap[i] + x[2 * i] * scale * ns->window[i]);
+        ns->overlap[i] = x[2 * (i + hop)] * scale * ns->window[i + hop];
+    }
+    memmove(ns->frame, &ns->frame[hop], hop * sizeof(float));
+    ns->hops++;
+}
+
+void noise_suppressor_process(noise_suppressor_t *ns, const int16_t *in, int16_t *out, size_t samples)
+{
+    for (size_t i = 0; i < samples; i++) {
+        int32_t sample = in[i];
+        ns->frame[ns->hop + ns->fill] = (float)sample;
+        out[i] = ns->ready[ns->fill];
+        ns->in_energy += (uint64_t)(sample * sample);
+        ns->out_energy += (uint64_t)((int32_t)out[i] * out[i]);
+        if (++ns->fill == ns->hop) {
+            process_hop(ns);
+            ns->fill = 0;
+        }
+    }
+}
+
+float noise_suppressor_reduction_db(const noise_suppressor_t *ns)
+{
+    if (ns->in_energy == 0) {
+        return 0;
+    }
+    if (ns->out_energy == 0) {
+        return 100;
+    }
+    return 10 * log10f((float)ns->in_energy / (float)ns->out_energy);
+}
@@ -0,0 +1,122 @@
+#ifndef NOISE_SUPPRESSOR_H
+#define NOISE_SUPPRESSOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Default suppression level in dB
+ *
+ * The most a frequency band is attenuated when it carries only noise.
+ * Higher levels remove more traffic and wind noise but leave speech
+ * sounding thinner.
+ */
+#ifndef NOISE_SUPPRESSOR_LEVEL_DB
+#define NOISE_SUPPRESSOR_LEVEL_DB       12
+#endif
+
+/**
+ * @brief Highest suppression level accepted
+ */
+#define NOISE_SUPPRESSOR_MAX_LEVEL_DB   30
+
+/**
+ * @brief How fast the noise floor estimate may rise, in dB per second
+ *
+ * It falls to any quieter level at once. Faster rise follows changing
+ * noise sooner but also creeps up under long vowels.
+ */
+#ifndef NOISE_SUPPRESSOR_RISE_DB_S
+#define NOISE_SUPPRESSOR_RISE_DB_S      5
+#endif
+
+/**
+ * @brief Highest sample rate supported
+ */
+#define NOISE_SUPPRESSOR_MAX_RATE       16000
+
+/**
+ * @brief Time between two spectra
+ *
+ * Each output sample needs both frames it falls into, so the stage
+ * delays the audio by two hops.
+ */
+#define NOISE_SUPPRESSOR_HOP_MS         10
+
+#define NOISE_SUPPRESSOR_DELAY_MS       (2 * NOISE_SUPPRESSOR_HOP_MS)
+
+#define NOISE_SUPPRESSOR_MAX_HOP        (NOISE_SUPPRESSOR_MAX_RATE * NOISE_SUPPRESSOR_HOP_MS / 1000)
+#define NOISE_SUPPRESSOR_MAX_FFT        512     // Two hops at the highest rate, zero-padded
+#define NOISE_SUPPRESSOR_MAX_BINS       (NOISE_SUPPRESSOR_MAX_FFT / 2 + 1)
+
+/**
+ * @brief Noise suppressor state of one call
+ *
+ * Short-time spectral attenuation: frames of two hops under a square-root
+ * Hann window overlap by half, each bin is scaled by a Wiener gain from
+ * its a-priori SNR against a tracked noise floor, and the frames are
+ * added back under the same window. Float throughout, for the FPU of the
+ * ESP32-S3 and the ESP-DSP FFT.
+ */
+typedef struct {
+    float fft[2 * NOISE_SUPPRESSOR_MAX_FFT] __attribute__((aligned(16)));  ///< Complex work buffer, re/im pairs
+    float window[2 * NOISE_SUPPRESSOR_MAX_HOP];
+    float frame[2 * NOISE_SUPPRESSOR_MAX_HOP];      ///< Previous hop, then the one being filled
+    float overlap[NOISE_SUPPRESSOR_MAX_HOP];        ///< Second half of the last output frame
+    int16_t ready[NOISE_SUPPRESSOR_MAX_HOP];        ///< Output of the last complete hop
+    float smoothed[NOISE_SUPPRESSOR_MAX_BINS];      ///< Power spectrum averaged over a few hops
+    float noise[NOISE_SUPPRESSOR_MAX_BINS];         ///< Noise floor estimate per bin
+    float clean[NOISE_SUPPRESSOR_MAX_BINS];         ///< Speech power estimate of the last hop
+    float cos_table[NOISE_SUPPRESSOR_MAX_FFT / 2];  ///< Twiddles of the portable FFT
+    float sin_table[NOISE_SUPPRESSOR_MAX_FFT / 2];
+    uint16_t hop;
+    uint16_t fft_size;
+    uint16_t fill;                  ///< Samples of the current hop taken so far
+    float gain_floor;               ///< Smallest gain, from the suppression level
+    float rise;                     ///< Noise floor growth per hop
+    uint32_t hops;                  ///< Hops processed since init
+    uint64_t in_energy;             ///< Input energy since init
+    uint64_t out_energy;            ///< Output energy since init
+} noise_suppressor_t;
+
+/**
+ * @brief Reset for a new call
+ *
+ * @param sample_rate 8000 or 16000
+ * @param level_db Suppression level, 0 passes the audio through delayed
+ * @return false for an unsupported rate or a level above the maximum
+ */
+bool noise_suppressor_init(noise_suppressor_t *ns, uint32_t sample_rate, uint8_t level_db);
+
+/**
+ * @brief Change the suppression level without losing the noise estimate
+ *
+ * @return false for a level above NOISE_SUPPRESSOR_MAX_LEVEL_DB
+ */
+bool noise_suppressor_set_level(noise_suppressor_t *ns, uint8_t level_db);
+
+/**
+ * @brief Suppress the noise in microphone samples
+ *
+ * Any block size works; the output lags the input by two hops
+ * (NOISE_SUPPRESSOR_DELAY_MS). in and out may be the same buffer.
+ */
+void noise_suppressor_process(noise_suppressor_t *ns, const int16_t *in, int16_t *out, size_t samples);
+
+/**
+ * @brief Input over output energy since init, in dB
+ *
+ * @return 0 before any audio was processed
+ */
+float noise_suppressor_reduction_db(const noise_suppressor_t *ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NOISE_SUPPRESSOR_H
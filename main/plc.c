@@ -0,0 +1,246 @@
+#include "plc.h"
+#include <math.h>
+#include <string.h>
+
+#define UNITY_Q15               (1 << 15)
+#define CORR_LEN_8K             160     // 20 ms matched in the pitch search
+#define DECIMATION_8K           2
+#define END_OVERLAP_STEP_8K     32      // 4 ms longer end cross-fade per 10 ms lost
+#define MIN_CORR_POWER          250.0f  // Keeps near-silence from matching anything
+#define ATTENUATION_Q15         (UNITY_Q15 / 5)     // 20% per 10 ms
+
+static inline int16_t saturate16(int32_t value)
+{
+    return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t)value;
+}
+
+bool plc_init(plc_t *plc, uint32_t sample_rate)
+{
+    if (sample_rate != 8000 && sample_rate != PLC_MAX_RATE) {
+        return false;
+    }
+    const uint16_t factor = (uint16_t)(sample_rate / 8000);
+
+    memset(plc, 0, sizeof(*plc));
+    plc->subframe = (uint16_t)(PLC_SUBFRAME_MS * sample_rate / 1000);
+    plc->history_len = PLC_HISTORY_8K * factor;
+    plc->pitch_min = PLC_PITCH_MIN_8K * factor;
+    plc->pitch_max = PLC_PITCH_MAX_8K * factor;
+    plc->overlap_max = PLC_OVERLAP_MAX_8K * factor;
+    plc->corr_len = CORR_LEN_8K * factor;
+    plc->decimation = DECIMATION_8K * factor;
+    plc->end_overlap_step = END_OVERLAP_STEP_8K * factor;
+    return true;
+}
+
+/**
+ * @brief Cross-fade from l to r into out; out may be either
+ */
+static void overlap_add(const int16_t *l, const int16_t *r, int16_t *out, int count)
+{
+    int32_t step = UNITY_Q15 / count;
+    int32_t rw = step;
+
+    for (int i = 0; i < count; i++, rw += step) {
+        out[i] = saturate16((int32_t)(((int64_t)l[i] * (UNITY_Q15 - rw) + (int64_t)r[i] * rw) >> 15));
+    }
+}
+
+/**
+ * @brief Normalised correlation of the last corr_len samples with those a lag earlier
+ */
+static float correlation(const int16_t *recent, const int16_t *earlier, int len, int step, int64_t energy)
+{
+    int64_t corr = 0;
+    for (int i = 0; i < len; i += step) {
+        corr += (int32_t)earlier[i] * recent[i];
+    }
+    float scale = (float)energy < MIN_CORR_POWER ? MIN_CORR_POWER : (float)energy;
+    return (float)corr / sqrtf(scale);
+}
+
+/**
+ * @brief Pitch period of the end of the pitch buffer
+ *
+ * A coarse search on every decimation-th sample and lag, then a fine one
+ * around the best coarse lag.
+ */
+static int find_pitch(const plc_t *plc)
+{
+    const int16_t *end = plc->pitch_buf + plc->history_len;
+    const int16_t *recent = end - plc->corr_len;
+    const int16_t *earliest = end - plc->corr_len - plc->pitch_max;
+    const int range = plc->pitch_max - plc->pitch_min;
+    const int step = plc->decimation;
+
+    int64_t energy = 0;
+    for (int i = 0; i < plc->corr_len; i += step) {
+        energy += (int32_t)earliest[i] * earliest[i];
+    }
+    float best = correlation(recent, earliest, plc->corr_len, step, energy);
+    int best_lag = 0;
+    for (int j = step; j <= range; j += step) {
+        const int16_t *earlier = earliest + j;
+        // Slide the energy window by one decimated sample
+        energy -= (int32_t)earlier[-step] * earlier[-step];
+        energy += (int32_t)earlier[plc->corr_len - step] * earlier[plc->corr_len - step];
+        float corr = correlation(recent, earlier, plc->corr_len, step, energy);
+        if (corr >= best) {
+            best = corr;
+            best_lag = j;
+        }
+    }
+
+    int from = best_lag - (step - 1);
+    int to = best_lag + (step - 1);
+    from = from < 0 ? 0 : from;
+    to = to > range ? range : to;
+    best = -INFINITY;
+    for (int j = from; j <= to; j++) {
+        const int16_t *earlier = earliest + j;
+        energy = 0;
+        for (int i = 0; i < plc->corr_len; i++) {
+            energy += (int32_t)earlier[i] * earlier[i];
+        }
+        float corr = correlation(recent, earlier, plc->corr_len, 1, energy);
+        if (corr >= best) {
+            best = corr;
+            best_lag = j;
+        }
+    }
+    return plc->pitch_max - best_lag;
+}
+
+/**
+ * @brief Next samples of the repeated periods
+ */
+static void repeat_periods(plc_t *plc, int16_t *out, int count)
+{
+    const int16_t *start = plc->pitch_buf + plc->history_len - plc->period_len;
+
+    while (count > 0) {
+        int run = plc->period_len - plc->offset;
+        run = run < count ? run : count;
+        memcpy(out, start + plc->offset, run * sizeof(int16_t));
+        plc->offset = (uint16_t)((plc->offset + run) % plc->period_len);
+        out += run;
+        count -= run;
+    }
+}
+
+/**
+ * @brief Fade a concealed subframe, 20% per 10 ms from the second one
+ */
+static void attenuate(const plc_t *plc, int16_t *out)
+{
+    int32_t gain = UNITY_Q15 - (plc->erased - 1) * ATTENUATION_Q15;
+    int32_t step = ATTENUATION_Q15 / plc->subframe;
+
+    for (int i = 0; i < plc->subframe; i++, gain -= step) {
+        out[i] = (int16_t)(((int32_t)out[i] * (gain > 0 ? gain : 0)) >> 15);
+    }
+}
+
+/**
+ * @brief Append a subframe to the history and replace it with the delayed output
+ */
+static void save_subframe(plc_t *plc, int16_t *pcm)
+{
+    const int keep = plc->history_len - plc->subframe;
+
+    memmove(plc->history, plc->history + plc->subframe, keep * sizeof(int16_t));
+    memcpy(plc->history + keep, pcm, plc->subframe * sizeof(int16_t));
+    memcpy(pcm, plc->history + keep - plc->overlap_max, plc->subframe * sizeof(int16_t));
+}
+
+static void conceal_subframe(plc_t *plc, int16_t *out)
+{
+    int16_t *end = plc->pitch_buf + plc->history_len;
+
+    if (plc->erased == 0) {
+        // Freeze the history and repeat its last period
+        memcpy(plc->pitch_buf, plc->history, plc->history_len * sizeof(int16_t));
+        plc->pitch = (uint16_t)find_pitch(plc);
+        plc->overlap = plc->pitch / 4;
+        memcpy(plc->last_quarter, end - plc->overlap, plc->overlap * sizeof(int16_t));
+        plc->offset = 0;
+        plc->period_len = plc->pitch;
+        // Smooth the seam where the period wraps, and let the delayed output fade into it
+        overlap_add(plc->last_quarter, end - plc->period_len - plc->overlap, end - plc->overlap, plc->overlap);
+        memcpy(plc->history + plc->history_len - plc->overlap, end - plc->overlap,
+               plc->overlap * sizeof(int16_t));
+        repeat_periods(plc, out, plc->subframe);
+    } else if (plc->erased < 3) {
+        // One more period, so longer losses do not buzz
+        int16_t tail[PLC_MAX_OVERLAP];
+        uint16_t offset = plc->offset;
+        repeat_periods(plc, tail, plc->overlap);
+        plc->offset = offset % plc->pitch;
+        plc->period_len += plc->pitch;
+        overlap_add(plc->last_quarter, end - plc->period_len - plc->overlap, end - plc->overlap, plc->overlap);
+        repeat_periods(plc, out, plc->subframe);
+        overlap_add(tail, out, out, plc->overlap);
+        attenuate(plc, out);
+    } else if (plc->erased < PLC_FADE_MS / PLC_SUBFRAME_MS) {
+        repeat_periods(plc, out, plc->subframe);
+        attenuate(plc, out);
+    } else {
+        memset(out, 0, plc->subframe * sizeof(int16_t));
+    }
+    plc->erased++;
+    plc->concealed++;
+    save_subframe(plc, out);
+}
+
+/**
+ * @brief Cross-fade the first audio after a loss in from the concealment
+ */
+static void end_loss(plc_t *plc, int16_t *pcm)
+{
+    int16_t fade[PLC_SUBFRAME_MS * PLC_MAX_RATE / 1000];
+    int count = plc->overlap + (plc->erased - 1) * plc->end_overlap_step;
+    count = count < plc->subframe ? count : plc->subframe;
+    repeat_periods(plc, fade, count);
+
+    // The concealment continues at the level it had reached
+    int32_t gain = UNITY_Q15 - (plc->erased - 1) * ATTENUATION_Q15;
+    gain = gain > 0 ? gain : 0;
+    int32_t step = UNITY_Q15 / count;
+    for (int i = 0; i < count; i++) {
+        int32_t rw = (i + 1) * step;
+        int32_t lw = (int32_t)(((int64_t)(UNITY_Q15 - rw) * gain) >> 15);
+        pcm[i] = saturate16((int32_t)(((int64_t)fade[i] * lw + (int64_t)pcm[i] * rw) >> 15));
+    }
+    plc->erased = 0;
+}
+
+void plc_add_frame(plc_t *plc, int16_t *pcm, size_t samples)
+{
+    for (size_t offset = 0; offset + plc->subframe <= samples; offset += plc->subframe) {
+        if (plc->erased > 0) {
+            end_loss(plc, pcm + offset);
+        }
+        save_subframe(plc, pcm + offset);
+    }
+}
+
+void plc_conceal_frame(plc_t *plc, int16_t *pcm, size_t samples)
+{
+    for (size_t offset = 0; offset + plc->subframe <= samples; offset += plc->subframe) {
+        conceal_subframe(plc, pcm + offset);
+    }
+}
+
+void plc_synthesis(plc_t *plc, int16_t *out, size_t samples, size_t lookahead)
+{
+    memcpy(out, plc->history + plc->history_len - samples, samples * sizeof(int16_t));
+
+    // Continue the periods at the level the next subframe would start at
+    uint16_t offset = plc->offset;
+    int32_t gain = UNITY_Q15 - (plc->erased - 1) * ATTENUATION_Q15;
+    repeat_periods(plc, out + samples, (int)lookahead);
+    plc->offset = offset;
+    for (size_t i = samples; i < samples + lookahead; i++) {
+        out[i] = plc->erased < PLC_FADE_MS / PLC_SUBFRAME_MS && gain > 0 ? (int16_t)((out[i] * gain) >> 15) : 0;
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef PLC_H
+#define PLC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Subframe the concealment works in; frames must be a multiple
+ */
+#define PLC_SUBFRAME_MS             10
+
+/**
+ * @brief Loss after which concealment has faded to silence
+ */
+#define PLC_FADE_MS                 60
+
+/**
+ * @brief Highest sample rate supported
+ */
+#define PLC_MAX_RATE                16000
+
+// Lengths at 8 kHz as in ITU-T G.711 Appendix I, scaled with the rate
+#define PLC_PITCH_MIN_8K            40      ///< Shortest pitch period, 200 Hz
+#define PLC_PITCH_MAX_8K            120     ///< Longest pitch period, 66 Hz
+#define PLC_OVERLAP_MAX_8K          (PLC_PITCH_MAX_8K / 4)
+#define PLC_HISTORY_8K              (3 * PLC_PITCH_MAX_8K + PLC_OVERLAP_MAX_8K)
+
+#define PLC_MAX_HISTORY             (PLC_HISTORY_8K * PLC_MAX_RATE / 8000)
+#define PLC_MAX_OVERLAP             (PLC_OVERLAP_MAX_8K * PLC_MAX_RATE / 8000)
+
+/**
+ * @brief Delay the concealment adds to all audio, in samples at 8 kHz
+ *
+ * 3.75 ms: a quarter of the longest pitch period is held back, so the
+ * start of a loss can be cross-faded into the audio before it.
+ */
+#define PLC_DELAY_8K                PLC_OVERLAP_MAX_8K
+
+/**
+ * @brief Packet loss concealment state of one received stream
+ *
+ * Pitch waveform substitution after ITU-T G.711 Appendix I, in fixed
+ * point. At a loss the pitch period is found by normalised
+ * cross-correlation over the last 20 ms, and the last period is
+ * repeated with a quarter-period cross-fade at each seam. The 2nd and
+ * 3rd lost 10 ms bring in one more period each, so long losses do not
+ * buzz, and from the 2nd on the level falls by 20% per 10 ms until it
+ * is silent after PLC_FADE_MS. The first frame received after a loss is
+ * cross-faded in from the concealment.
+ */
+typedef struct {
+    int16_t history[PLC_MAX_HISTORY];   ///< Recent audio, oldest first, PLC delay included
+    int16_t pitch_buf[PLC_MAX_HISTORY]; ///< History frozen at the loss, periods repeated from its end
+    int16_t last_quarter[PLC_MAX_OVERLAP];  ///< Real audio that ended before the loss
+    uint16_t subframe;              ///< Samples per PLC_SUBFRAME_MS
+    uint16_t history_len;
+    uint16_t pitch_min;
+    uint16_t pitch_max;
+    uint16_t overlap_max;           ///< Also the delay in samples
+    uint16_t corr_len;              ///< Samples matched in the pitch search
+    uint16_t decimation;            ///< Step of the coarse pitch search
+    uint16_t end_overlap_step;      ///< Longer cross-fade at the end per 10 ms lost
+    uint16_t pitch;                 ///< Period found at the start of the loss
+    uint16_t overlap;               ///< Cross-fade length, a quarter period
+    uint16_t period_len;            ///< Samples repeated, one to three periods
+    uint16_t offset;                ///< Position in the repeated samples
+    uint16_t erased;                ///< Subframes concealed in the current loss
+    uint32_t concealed;             ///< Subframes concealed since init
+} plc_t;
+
+/**
+ * @brief Reset for a new call
+ *
+ * @param sample_rate 8000 or 16000
+ * @return false for an unsupported rate
+ */
+bool plc_init(plc_t *plc, uint32_t sample_rate);
+
+/**
+ * @brief Pass a received frame through, in place
+ *
+ * Every received frame goes through here, including silence, as the
+ * output lags by the PLC delay. After a loss the frame is cross-faded
+ * in from the concealment.
+ *
+ * @param samples A multiple of the subframe
+ */
+void plc_add_frame(plc_t *plc, int16_t *pcm, size_t samples);
+
+/**
+ * @brief Make up a lost frame
+ *
+ * @param pcm Receives the frame to play
+ * @param samples A multiple of the subframe
+ */
+void plc_conceal_frame(plc_t *plc, int16_t *pcm, size_t samples);
+
+/**
+ * @brief The audio made up by the last plc_conceal_frame(), without the PLC delay
+ *
+ * In step with the decoder, so a codec can adapt its state to it.
+ *
+ * @param out Receives the concealed frame followed by lookahead samples
+ *            of how the concealment would go on
+ * @param samples The frame size passed to plc_conceal_frame()
+ * @param lookahead At most one subframe
+ */
+void plc_synthesis(plc_t *plc, int16_t *out, size_t samples, size_t lookahead);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLC_H
@@ -0,0 +1,354 @@
+#include "rtcp.h"
+#include <string.h>
+
+#define RTCP_VERSION            2
+#define RTCP_HEADER_SIZE        4
+#define RTCP_SENDER_INFO_SIZE   20
+#define RTCP_REPORT_BLOCK_SIZE  24
+#define RTCP_SDES_CNAME         1
+#define RTCP_XR_VOIP_METRICS    7
+#define RTCP_XR_VOIP_SIZE       36      // Block header included
+#define RTCP_XR_GMIN            16      // Recommended minimum gap, in packets (RFC 3611 section 4.7.6)
+// Receiver configuration: standard concealment (G.711 appendix I), adaptive jitter buffer
+#define RTCP_XR_RX_CONFIG       ((2 << 6) | (3 << 4))
+
+// E-model defaults (ITU-T G.107) and G.711 with concealment (ITU-T G.113 appendix I)
+#define EMODEL_R0               93.2f   // Basic signal-to-noise ratio less simultaneous impairments
+#define EMODEL_BPL              25.1f   // Packet loss robustness
+#define EMODEL_DELAY_KNEE_MS    177.3f  // Delay impairment grows faster beyond
+
+static uint16_t read_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t read_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void write_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static void write_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+/**
+ * @brief Write the common header of a packet whose body is already in place
+ */
+static void write_header(uint8_t *p, uint8_t count, uint8_t type, size_t bytes)
+{
+    p[0] = (uint8_t)((RTCP_VERSION << 6) | count);
+    p[1] = type;
+    write_u16(p + 2, (uint16_t)(bytes / 4 - 1));
+}
+
+void rtcp_session_init(rtcp_session_t *session)
+{
+    memset(session, 0, sizeof(*session));
+}
+
+uint64_t rtcp_ntp_from_us(uint64_t us)
+{
+    uint64_t fraction = ((us % 1000000) << 32) / 1000000;
+    return ((us / 1000000) << 32) | fraction;
+}
+
+uint32_t rtcp_ntp_middle(uint64_t ntp)
+{
+    return (uint32_t)(ntp >> 16);
+}
+
+void rtcp_session_report_block(rtcp_session_t *session, const rtp_receiver_t *receiver, uint32_t now,
+                               rtcp_report_block_t *block)
+{
+    uint32_t expected = rtp_receiver_extended_max(receiver) - receiver->base_seq + 1;
+
+    if (receiver->ssrc != session->ssrc || expected < session->expected_prior ||
+        receiver->received < session->received_prior) {
+        // A new source, or the sequence tracking restarted after a jump
+        session->ssrc = receiver->ssrc;
+        session->expected_prior = 0;
+        session->received_prior = 0;
+    }
+    // Fraction lost over the interval (RFC 3550 appendix A.3)
+    uint32_t expected_interval = expected - session->expected_prior;
+    uint32_t received_interval = receiver->received - session->received_prior;
+    uint32_t lost_interval = expected_interval > received_interval ? expected_interval - received_interval : 0;
+    uint32_t fraction = expected_interval == 0 ? 0 : (uint32_t)(((uint64_t)lost_interval << 8) / expected_interval);
+    session->expected_prior = expected;
+    session->received_prior = receiver->received;
+
+    uint32_t lost = rtp_receiver_lost(receiver);
+    block->ssrc = receiver->ssrc;
+    block->fraction_lost = (uint8_t)(fraction > 255 ? 255 : fraction);
+    block->cumulative_lost = lost > 0x7fffff ? 0x7fffff : lost;
+    block->extended_max_seq = rtp_receiver_extended_max(receiver);
+    block->jitter = receiver->jitter >> 4;
+    block->lsr = session->last_sr;
+    block->dlsr = session->last_sr != 0 ? now - session->last_sr_arrival : 0;
+}
+
+void rtcp_session_receive(rtcp_session_t *session, const rtcp_packet_t *packet, uint32_t now)
+{
+    if (packet->has_sr) {
+        session->last_sr = packet->sr_ntp;
+        session->last_sr_arrival = now;
+    }
+    if (packet->has_report && packet->report.lsr != 0) {
+        // Our SR went out at LSR and sat at the far end for DLSR (RFC 3550 section 6.4.1)
+        uint32_t rtt = now - packet->report.lsr - packet->report.dlsr;
+        if ((int32_t)rtt >= 0) {
+            session->rtt = rtt;
+            session->rtt_valid = true;
+        }
+    }
+}
+
+uint32_t rtcp_session_rtt_ms(const rtcp_session_t *session)
+{
+    return session->rtt_valid ? (uint32_t)(((uint64_t)session->rtt * 1000) >> 16) : 0;
+}
+
+static size_t write_report_block(uint8_t *p, const rtcp_report_block_t *block)
+{
+    write_u32(p, block->ssrc);
+    write_u32(p + 4, ((uint32_t)block->fraction_lost << 24) | (block->cumulative_lost & 0xffffff));
+    write_u32(p + 8, block->extended_max_seq);
+    write_u32(p + 12, block->jitter);
+    write_u32(p + 16, block->lsr);
+    write_u32(p + 20, block->dlsr);
+    return RTCP_REPORT_BLOCK_SIZE;
+}
+
+static size_t write_metrics(uint8_t *p, const rtcp_voip_metrics_t *metrics)
+{
+    memset(p, 0, RTCP_XR_VOIP_SIZE);
+    p[0] = RTCP_XR_VOIP_METRICS;
+    write_u16(p + 2, RTCP_XR_VOIP_SIZE / 4 - 1);
+    write_u32(p + 4, metrics->ssrc);
+    p[8] = metrics->loss_rate;
+    p[9] = metrics->discard_rate;
+    // Burst and gap density and duration stay 0: no burst metrics are kept
+    write_u16(p + 16, metrics->round_trip_ms);
+    write_u16(p + 18, metrics->end_system_ms);
+    p[20] = RTCP_METRIC_UNAVAILABLE;                // Signal level
+    p[21] = (uint8_t)metrics->noise_level_dbm;
+    p[22] = RTCP_METRIC_UNAVAILABLE;                // Residual echo return loss
+    p[23] = RTCP_XR_GMIN;
+    p[24] = metrics->r_factor;
+    p[25] = RTCP_METRIC_UNAVAILABLE;                // External R factor
+    p[26] = metrics->mos_lq;
+    p[27] = metrics->mos_cq;
+    p[28] = RTCP_XR_RX_CONFIG;
+    write_u16(p + 30, metrics->jb_nominal_ms);
+    write_u16(p + 32, metrics->jb_max_ms);
+    write_u16(p + 34, metrics->jb_max_ms);          // Absolute maximum
+    return RTCP_XR_VOIP_SIZE;
+}
+
+size_t rtcp_write(uint8_t *buf, size_t size, const rtcp_report_t *report)
+{
+    if (buf == NULL || report == NULL || report->sender == NULL || size < RTCP_MAX_PACKET_SIZE) {
+        return 0;
+    }
+    uint32_t ssrc = report->sender->ssrc;
+    bool sender = report->sender->packets > 0;
+    size_t len = RTCP_HEADER_SIZE;
+
+    // SR or RR, with a block on the remote source once there is one
+    write_u32(buf + len, ssrc);
+    len += 4;
+    if (sender) {
+        write_u32(buf + len, (uint32_t)(report->ntp >> 32));
+        write_u32(buf + len + 4, (uint32_t)report->ntp);
+        write_u32(buf + len + 8, report->sender->timestamp);
+        write_u32(buf + len + 12, report->sender->packets);
+        write_u32(buf + len + 16, report->sender->octets);
+        len += RTCP_SENDER_INFO_SIZE;
+    }
+    if (report->report != NULL) {
+        len += write_report_block(buf + len, report->report);
+    }
+    write_header(buf, report->report != NULL, sender ? RTCP_PT_SR : RTCP_PT_RR, len);
+
+    // SDES with the CNAME, which every compound packet must carry
+    size_t start = len;
+    const char *cname = report->cname != NULL ? report->cname : "";
+    size_t cname_len = strnlen(cname, RTCP_MAX_CNAME_LEN);
+    write_u32(buf + len + RTCP_HEADER_SIZE, ssrc);
+    len += RTCP_HEADER_SIZE + 4;
+    buf[len++] = RTCP_SDES_CNAME;
+    buf[len++] = (uint8_t)cname_len;
+    memcpy(buf + len, cname, cname_len);
+    len += cname_len;
+    // End of the item list, then padding to a 32-bit boundary
+    do {
+        buf[len++] = 0;
+    } while (len % 4 != 0);
+    write_header(buf + start, 1, RTCP_PT_SDES, len - start);
+
+    if (report->metrics != NULL) {
+        start = len;
+        write_u32(buf + len + RTCP_HEADER_SIZE, ssrc);
+        len += RTCP_HEADER_SIZE + 4;
+        len += write_metrics(buf + len, report->metrics);
+        write_header(buf + start, 0, RTCP_PT_XR, len - start);
+    }
+    if (report->bye) {
+        write_u32(buf + len + RTCP_HEADER_SIZE, ssrc);
+        write_header(buf + len, 1, RTCP_PT_BYE, RTCP_HEADER_SIZE + 4);
+        len += RTCP_HEADER_SIZE + 4;
+    }
+    return len;
+}
+
+/**
+ * @brief Read an SR or RR, keeping the block about our stream
+ */
+static bool parse_reports(const uint8_t *p, size_t bytes, uint32_t ssrc, rtcp_packet_t *packet)
+{
+    size_t offset = RTCP_HEADER_SIZE + 4;
+    size_t count = p[0] & 0x1f;
+
+    if (bytes < offset) {
+        return false;
+    }
+    if (!packet->has_sr && !packet->has_report) {
+        packet->ssrc = read_u32(p + 4);
+    }
+    if (p[1] == RTCP_PT_SR) {
+        if (bytes < offset + RTCP_SENDER_INFO_SIZE) {
+            return false;
+        }
+        packet->has_sr = true;
+        packet->sr_ntp = read_u32(p + offset + 2);
+        packet->sender_packets = read_u32(p + offset + 12);
+        packet->sender_octets = read_u32(p + offset + 16);
+        offset += RTCP_SENDER_INFO_SIZE;
+    }
+    if (offset + count * RTCP_REPORT_BLOCK_SIZE > bytes) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++, offset += RTCP_REPORT_BLOCK_SIZE) {
+        const uint8_t *b = p + offset;
+        if (read_u32(b) != ssrc) {
+            continue;
+        }
+        packet->has_report = true;
+        packet->report.ssrc = ssrc;
+        packet->report.fraction_lost = b[4];
+        packet->report.cumulative_lost = read_u32(b + 4) & 0xffffff;
+        packet->report.extended_max_seq = read_u32(b + 8);
+        packet->report.jitter = read_u32(b + 12);
+        packet->report.lsr = read_u32(b + 16);
+        packet->report.dlsr = read_u32(b + 20);
+    }
+    return true;
+}
+
+/**
+ * @brief Read an XR, keeping the VoIP metrics about our stream
+ */
+static bool parse_extended(const uint8_t *p, size_t bytes, uint32_t ssrc, rtcp_packet_t *packet)
+{
+    size_t offset = RTCP_HEADER_SIZE + 4;
+
+    if (bytes < offset) {
+        return false;
+    }
+    while (offset + 4 <= bytes) {
+        const uint8_t *b = p + offset;
+        size_t block = ((size_t)read_u16(b + 2) + 1) * 4;
+        if (block > bytes - offset) {
+            return false;
+        }
+        if (b[0] == RTCP_XR_VOIP_METRICS && block == RTCP_XR_VOIP_SIZE && read_u32(b + 4) == ssrc) {
+            rtcp_voip_metrics_t *metrics = &packet->metrics;
+            packet->has_metrics = true;
+            metrics->ssrc = ssrc;
+            metrics->loss_rate = b[8];
+            metrics->discard_rate = b[9];
+            metrics->round_trip_ms = read_u16(b + 16);
+            metrics->end_system_ms = read_u16(b + 18);
+            metrics->noise_level_dbm = (int8_t)b[21];
+            metrics->r_factor = b[24];
+            metrics->mos_lq = b[26];
+            metrics->mos_cq = b[27];
+            metrics->jb_nominal_ms = read_u16(b + 30);
+            metrics->jb_max_ms = read_u16(b + 32);
+        }
+        offset += block;
+    }
+    return true;
+}
+
+bool rtcp_parse(const uint8_t *data, size_t len, uint32_t ssrc, rtcp_packet_t *packet)
+{
+    if (data == NULL || packet == NULL || len < RTCP_HEADER_SIZE) {
+        return false;
+    }
+    memset(packet, 0, sizeof(*packet));
+
+    for (size_t offset = 0; offset < len;) {
+        const uint8_t *p = data + offset;
+        if (len - offset < RTCP_HEADER_SIZE || (p[0] >> 6) != RTCP_VERSION) {
+            return false;
+        }
+        // The length counts 32-bit words less one and includes any padding
+        size_t bytes = ((size_t)read_u16(p + 2) + 1) * 4;
+        if (bytes > len - offset) {
+            return false;
+        }
+        bool ok = true;
+        switch (p[1]) {
+            case RTCP_PT_SR:
+            case RTCP_PT_RR:
+                ok = parse_reports(p, bytes, ssrc, packet);
+                break;
+            case RTCP_PT_XR:
+                ok = parse_extended(p, bytes, ssrc, packet);
+                break;
+            case RTCP_PT_BYE:
+                packet->bye = true;
+                break;
+            default:
+                break;
+        }
+        if (!ok) {
+            return false;
+        }
+        offset += bytes;
+    }
+    return true;
+}
+
+uint8_t rtcp_r_factor(uint32_t loss_permille, uint32_t delay_ms)
+{
+    // Effective equipment impairment of random loss; G.711 itself has none
+    float ppl = (loss_permille > 1000 ? 1000 : loss_permille) / 10.0f;
+    float ie_eff = 95.0f * ppl / (ppl + EMODEL_BPL);
+    // Delay impairment, simplified after Cole and Rosenbluth
+    float d = (float)delay_ms;
+    float id = 0.024f * d + (d > EMODEL_DELAY_KNEE_MS ? 0.11f * (d - EMODEL_DELAY_KNEE_MS) : 0);
+    float r = EMODEL_R0 - id - ie_eff;
+    return r <= 0 ? 0 : (uint8_t)(r + 0.5f);
+}
+
+uint8_t rtcp_mos(uint8_t r_factor)
+{
+    if (r_factor >= 100) {
+        return 45;
+    }
+    float r = r_factor;
+    float mos = 1 + 0.035f * r + r * (r - 60) * (100 - r) * 7e-6f;
+    return mos < 1 ? 10 : (uint8_t)(mos * 10 + 0.5f);
+}
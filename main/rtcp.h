@@ -0,0 +1,194 @@
+#ifndef RTCP_H
+#define RTCP_H
+
+#include "rtp_packet.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief RTCP packet types (RFC 3550 section 12.1, RFC 3611)
+ */
+#define RTCP_PT_SR              200
+#define RTCP_PT_RR              201
+#define RTCP_PT_SDES            202
+#define RTCP_PT_BYE             203
+#define RTCP_PT_XR              207
+
+/**
+ * @brief Longest CNAME written
+ */
+#define RTCP_MAX_CNAME_LEN      32
+
+/**
+ * @brief Largest compound packet written: SR with one report block,
+ *        CNAME, VoIP metrics and BYE
+ */
+#define RTCP_MAX_PACKET_SIZE    (52 + 12 + RTCP_MAX_CNAME_LEN + 44 + 8)
+
+/**
+ * @brief Metric value of the VoIP metrics block meaning "unavailable"
+ */
+#define RTCP_METRIC_UNAVAILABLE 127
+
+/**
+ * @brief Reception report block (RFC 3550 section 6.4.1)
+ */
+typedef struct {
+    uint32_t ssrc;              ///< Source the block is about
+    uint8_t fraction_lost;      ///< Lost since the previous report, in 1/256
+    uint32_t cumulative_lost;   ///< Lost since the source started, 24 bits
+    uint32_t extended_max_seq;  ///< Extended highest sequence number received
+    uint32_t jitter;            ///< Interarrival jitter in timestamp units
+    uint32_t lsr;               ///< Middle 32 bits of the NTP time of the last SR from the source, 0 if none
+    uint32_t dlsr;              ///< Time since that SR, in 1/65536 s
+} rtcp_report_block_t;
+
+/**
+ * @brief The fields of a VoIP metrics block (RFC 3611 section 4.7) we fill and read
+ *
+ * Burst and gap metrics are written as zero, signal level, residual echo
+ * return loss and extended R factor as unavailable.
+ */
+typedef struct {
+    uint32_t ssrc;              ///< Source the metrics are about
+    uint8_t loss_rate;          ///< Packets lost in the network, in 1/256
+    uint8_t discard_rate;       ///< Packets the jitter buffer dropped, in 1/256
+    uint16_t round_trip_ms;     ///< Network round trip, 0 if unknown
+    uint16_t end_system_ms;     ///< Jitter buffer, packetization and codec delay
+    int8_t noise_level_dbm;     ///< Background noise in dBm0, RTCP_METRIC_UNAVAILABLE if unknown
+    uint8_t r_factor;           ///< Conversational R factor, RTCP_METRIC_UNAVAILABLE if unknown
+    uint8_t mos_lq;             ///< Listening quality MOS times 10
+    uint8_t mos_cq;             ///< Conversational quality MOS times 10
+    uint16_t jb_nominal_ms;     ///< Playout delay the jitter buffer aims for
+    uint16_t jb_max_ms;         ///< Largest playout delay it may adapt to
+} rtcp_voip_metrics_t;
+
+/**
+ * @brief What was found in a received compound packet
+ */
+typedef struct {
+    uint32_t ssrc;              ///< Sender of the first report
+    bool has_sr;                ///< Sender information present
+    uint32_t sr_ntp;            ///< Middle 32 bits of the SR's NTP timestamp
+    uint32_t sender_packets;    ///< Packets the sender has sent
+    uint32_t sender_octets;     ///< Payload octets the sender has sent
+    bool has_report;            ///< A report block about our stream was found
+    rtcp_report_block_t report;
+    bool has_metrics;           ///< A VoIP metrics block about our stream was found
+    rtcp_voip_metrics_t metrics;
+    bool bye;                   ///< The sender left the session
+} rtcp_packet_t;
+
+/**
+ * @brief Contents of an outgoing compound packet
+ */
+typedef struct {
+    const rtp_sender_t *sender;             ///< Our stream; an SR once it has sent anything, else an RR
+    uint64_t ntp;                           ///< Wallclock now, NTP format
+    const rtcp_report_block_t *report;      ///< On the remote source, NULL before one was heard
+    const char *cname;                      ///< Canonical name, cut at RTCP_MAX_CNAME_LEN
+    const rtcp_voip_metrics_t *metrics;     ///< Appended as an XR packet, NULL for none
+    bool bye;                               ///< Append a BYE
+} rtcp_report_t;
+
+/**
+ * @brief RTCP state of one call (RFC 3550 appendix A.3 and section 6.4)
+ *
+ * The wallclock only has to be steady over the call, not real time:
+ * the round trip is taken from our own SR times echoed back to us.
+ */
+typedef struct {
+    uint32_t ssrc;              ///< Remote source the priors belong to
+    uint32_t expected_prior;    ///< Packets expected at the previous report
+    uint32_t received_prior;    ///< Packets received at the previous report
+    uint32_t last_sr;           ///< Middle 32 bits of the last SR received, 0 if none
+    uint32_t last_sr_arrival;   ///< When it arrived, middle 32 bits of our clock
+    bool rtt_valid;             ///< A report echoed one of our SRs
+    uint32_t rtt;               ///< Round trip of the last echo, in 1/65536 s
+} rtcp_session_t;
+
+/**
+ * @brief Reset at the start of a call
+ */
+void rtcp_session_init(rtcp_session_t *session);
+
+/**
+ * @brief Convert microseconds to NTP format, 32.32 fixed point seconds
+ */
+uint64_t rtcp_ntp_from_us(uint64_t us);
+
+/**
+ * @brief Middle 32 bits of an NTP time, as carried in LSR and DLSR
+ */
+uint32_t rtcp_ntp_middle(uint64_t ntp);
+
+/**
+ * @brief Fill a report block on the remote source and start the next interval
+ *
+ * @param now Our clock as rtcp_ntp_middle(), for the DLSR
+ */
+void rtcp_session_report_block(rtcp_session_t *session, const rtp_receiver_t *receiver, uint32_t now,
+                               rtcp_report_block_t *block);
+
+/**
+ * @brief Note a received compound packet
+ *
+ * Keeps the SR time for our next report block and takes the round trip
+ * from a report block that echoes one of our SRs.
+ *
+ * @param now Our clock at arrival, as rtcp_ntp_middle()
+ */
+void rtcp_session_receive(rtcp_session_t *session, const rtcp_packet_t *packet, uint32_t now);
+
+/**
+ * @brief Round trip of the last echo in milliseconds, 0 if none
+ */
+uint32_t rtcp_session_rtt_ms(const rtcp_session_t *session);
+
+/**
+ * @brief Write a compound packet: SR or RR, SDES CNAME, then optionally XR and BYE
+ *
+ * @param size At least RTCP_MAX_PACKET_SIZE
+ * @return Packet length, 0 if the buffer is too small
+ */
+size_t rtcp_write(uint8_t *buf, size_t size, const rtcp_report_t *report);
+
+/**
+ * @brief Parse a compound packet
+ *
+ * Report and metrics blocks about other sources are skipped, as are
+ * unknown packet types. Reduced-size RTCP (RFC 5506) is accepted.
+ *
+ * @param ssrc Our SSRC, to find the blocks about our stream
+ * @return false if it is not RTCP version 2 or a length is wrong
+ */
+bool rtcp_parse(const uint8_t *data, size_t len, uint32_t ssrc, rtcp_packet_t *packet);
+
+/**
+ * @brief Estimate the R factor of a G.711 call with concealment (ITU-T G.107)
+ *
+ * Uses the default E-model values, random loss and the codec's packet
+ * loss robustness with concealment (ITU-T G.113 appendix I). G.722 is
+ * rated on the same narrowband scale.
+ *
+ * @param loss_permille Packets lost or discarded, per mille
+ * @param delay_ms One-way mouth-to-ear delay, 0 for listening quality
+ * @return R factor from 0 to 93
+ */
+uint8_t rtcp_r_factor(uint32_t loss_permille, uint32_t delay_ms);
+
+/**
+ * @brief MOS of an R factor (ITU-T G.107 annex B), times 10
+ */
+uint8_t rtcp_mos(uint8_t r_factor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RTCP_H
@@ -0,0 +1,42 @@
+#include "rtp_dtmf.h"
+#include <string.h>
+
+void rtp_dtmf_init(rtp_dtmf_receiver_t *receiver)
+{
+    memset(receiver, 0, sizeof(*receiver));
+}
+
+char rtp_dtmf_event_digit(uint8_t event)
+{
+    static const char digits[] = "0123456789*#ABCD";
+
+    return event < sizeof(digits) - 1 ? digits[event] : '\0';
+}
+
+char rtp_dtmf_receive(rtp_dtmf_receiver_t *receiver, const rtp_packet_t *packet)
+{
+    if (packet->payload_len < RTP_DTMF_EVENT_SIZE) {
+        return '\0';
+    }
+    uint8_t event = packet->payload[0];
+
+    if (receiver->active && receiver->ssrc == packet->ssrc) {
+        int32_t age = (int32_t)(packet->timestamp - receiver->timestamp);
+        if (age < 0 || (age == 0 && event == receiver->event)) {
+            // An update or repeat of the current event, or a late one of an older event
+            receiver->duplicates++;
+            return '\0';
+        }
+    }
+
+    char digit = rtp_dtmf_event_digit(event);
+    if (digit == '\0') {
+        return '\0';
+    }
+    receiver->active = true;
+    receiver->ssrc = packet->ssrc;
+    receiver->timestamp = packet->timestamp;
+    receiver->event = event;
+    receiver->events++;
+    return digit;
+}
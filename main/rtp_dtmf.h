@@ -0,0 +1,56 @@
+#ifndef RTP_DTMF_H
+#define RTP_DTMF_H
+
+#include "rtp_packet.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Size of one named event report (RFC 4733 section 2.3)
+ */
+#define RTP_DTMF_EVENT_SIZE     4
+
+/**
+ * @brief Incoming telephone-event state of one stream
+ *
+ * Every packet of an event carries the RTP timestamp of the event start,
+ * and the sender repeats updates and sends the final packet three times.
+ * The first packet with a new timestamp is reported, all others are
+ * duplicates.
+ */
+typedef struct {
+    bool active;                ///< An event has been reported
+    uint32_t ssrc;              ///< Source of the last event
+    uint32_t timestamp;         ///< Start of the last event
+    uint8_t event;              ///< Event code of the last event
+    uint32_t events;            ///< Events reported
+    uint32_t duplicates;        ///< Updates and retransmissions of reported events
+} rtp_dtmf_receiver_t;
+
+/**
+ * @brief Reset the state for a new call
+ */
+void rtp_dtmf_init(rtp_dtmf_receiver_t *receiver);
+
+/**
+ * @brief Take one telephone-event packet
+ *
+ * @return The digit 0-9, *, # or A-D for the first packet of a new event,
+ *         '\0' for duplicates, stale or malformed packets and other events
+ */
+char rtp_dtmf_receive(rtp_dtmf_receiver_t *receiver, const rtp_packet_t *packet);
+
+/**
+ * @brief Digit of a DTMF event code, '\0' for other events
+ */
+char rtp_dtmf_event_digit(uint8_t event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RTP_DTMF_H
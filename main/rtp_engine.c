@@ -0,0 +1,1094 @@
+#include "rtp_engine.h"
+#include "rtp_packet.h"
+#include "g711.h"
+#include "g722.h"
+#include "jitter_buffer.h"
+#include "rtp_dtmf.h"
+#include "dtmf_detect.h"
+#include "echo_canceller.h"
+#include "noise_suppressor.h"
+#include "agc.h"
+#include "plc.h"
+#include "vad.h"
+#include "comfort_noise.h"
+#include "rtcp.h"
+#include "call_latency.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "rtp_engine";
+
+#define RTP_TASK_STACK_SIZE     4096
+#define RTP_TASK_PRIORITY       7       // Above the SIP task, audio must not wait for signalling
+#define RTP_STOP_WAIT_MS        (4 * RTP_ENGINE_FRAME_MS)
+
+// Playout delay range of the jitter buffer, in frames
+#define RTP_JB_MIN_FRAMES       2
+#define RTP_JB_MAX_FRAMES       10
+
+// Gain control of the microphone and of the speaker
+#define RTP_CAPTURE_TARGET_DBFS     (-18)
+#define RTP_CAPTURE_MAX_GAIN_DB     24
+#define RTP_PLAYOUT_TARGET_DBFS     (-15)
+#define RTP_PLAYOUT_MAX_GAIN_DB     12
+
+// Silence suppression: a packet still goes out this often in a pause, and when the noise level moves this much
+#define RTP_SILENCE_REFRESH_MS      1000
+#define RTP_CN_LEVEL_STEP_DB        3
+
+// Mean RTCP report interval, the minimum of RFC 3550 section 6.2; each one is drawn from half to 1.5 times it
+#define RTP_RTCP_INTERVAL_MS        5000
+
+/**
+ * @brief Audio processing switches, set by other tasks and read once per frame
+ */
+typedef struct {
+    bool echo_canceller;
+    uint8_t noise_level_db;         ///< Noise suppression level, 0 when off
+    bool capture_gain;              ///< AGC and limiter on the microphone
+    bool playout_gain;              ///< AGC and limiter on the speaker
+    bool silence_suppression;       ///< No audio packets while the microphone is silent
+} rtp_processing_t;
+
+static struct {
+    volatile bool running;
+    volatile bool task_running;
+    bool stop_in_task;              ///< The RTP task tears down on exit: stopped from the task, or it outlasted the stop wait
+    TaskHandle_t task;
+    int sock;
+    struct sockaddr_in remote;
+    int rtcp_sock;                  ///< On the port above the RTP one, -1 if it could not be opened
+    struct sockaddr_in rtcp_remote;
+    rtp_engine_codec_t codec;
+    g711_law_t law;
+    g722_state_t g722_encoder;
+    g722_state_t g722_decoder;
+    size_t frame_samples;           ///< Audio samples per frame at the codec's rate
+    uint32_t codec_us;              ///< Encode and decode time of the frame in progress
+    uint8_t payload_type;
+    uint8_t dtmf_payload_type;
+    uint8_t cn_payload_type;        ///< Comfort noise payload type, 0 if not agreed
+
+    rtp_sender_t sender;
+    rtp_receiver_t receiver;
+    jitter_buffer_t jitter;         ///< Only touched by the RTP task once media runs
+    rtp_dtmf_receiver_t dtmf;
+    dtmf_detector_t tone_detector;  ///< In-band tones, for callees without telephone-event
+    echo_canceller_t echo;          ///< Removes our own speaker from the microphone
+    uint32_t echo_us;               ///< Echo canceller time of the frame in progress
+    noise_suppressor_t noise;       ///< Takes traffic and wind noise out of the microphone
+    uint32_t noise_us;              ///< Noise suppressor time of the frame in progress
+    agc_t capture_agc;              ///< Evens out visitors near and far from the panel
+    agc_t playout_agc;              ///< Evens out loud and quiet callees
+    uint32_t gain_us;               ///< Gain control time of the frame in progress, both directions
+    plc_t plc;                      ///< Makes up the audio of packets lost on the way
+    uint32_t plc_us;                ///< Concealment time of the frame in progress
+    uint32_t lost_before;           ///< Losses of earlier remote sources in this call
+    vad_t vad;                      ///< Tells talkspurts from pauses on the microphone
+    bool tx_talking;                ///< The last frame was sent as speech
+    uint8_t cn_level;               ///< Noise level of the last comfort noise packet sent
+    uint32_t frames_unsent;         ///< Frames since the last packet went out
+    comfort_noise_t comfort_noise;  ///< Fills the pauses of the far end
+    bool rx_silence;                ///< The far end sent comfort noise, no frame of a new talkspurt played since
+    bool first_packet_seen;
+    rtcp_session_t rtcp;
+    int64_t rtcp_due_us;            ///< When the next report goes out
+    char cname[RTCP_MAX_CNAME_LEN + 1];     ///< Random per call (RFC 7022)
+
+    // Frame buffers, so no packet ever allocates
+    int16_t tx_pcm[RTP_ENGINE_MAX_FRAME_SAMPLES];
+    uint8_t tx_packet[RTP_HEADER_SIZE + RTP_ENGINE_FRAME_SAMPLES];     // Both codecs send 160 bytes per frame
+    int16_t rx_pcm[RTP_ENGINE_MAX_FRAME_SAMPLES];
+    int16_t plc_pcm[RTP_ENGINE_MAX_FRAME_SAMPLES + G722_CONCEAL_LOOKAHEAD];     ///< Concealment the G.722 decoder adapts to
+    int16_t tone_pcm[RTP_ENGINE_FRAME_SAMPLES];     ///< Far-end audio at 8 kHz for the tone detector
+    uint8_t rx_packet[RTP_ENGINE_MAX_PACKET_SIZE];
+    uint8_t rx_frame[JITTER_BUFFER_FRAME_BYTES];
+    uint8_t rtcp_packet[RTCP_MAX_PACKET_SIZE];
+
+    rtp_audio_io_t io;
+    rtp_audio_device_t device;      ///< Only changed while no call runs
+    bool device_running;            ///< The device was started for the current call
+    rtp_processing_t processing;
+    rtp_dtmf_handler_t dtmf_handler;
+    void *dtmf_ctx;
+    rtp_engine_stats_t stats;
+} s_rtp = {
+    .sock = -1,
+    .rtcp_sock = -1,
+    .processing = {
+        .echo_canceller = true,
+        .noise_level_db = NOISE_SUPPRESSOR_LEVEL_DB,
+        .capture_gain = true,
+        .playout_gain = true,
+        .silence_suppression = true
+    }
+};
+
+// Guards io, device, processing, the DTMF handler and stats, which other tasks read and write between frames
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Current time in RTP timestamp units
+ */
+static uint32_t rtp_clock_now(void)
+{
+    return (uint32_t)(esp_timer_get_time() / (1000000 / RTP_ENGINE_CLOCK_RATE));
+}
+
+static void report_digit(char digit)
+{
+    portENTER_CRITICAL(&s_lock);
+    rtp_dtmf_handler_t handler = s_rtp.dtmf_handler;
+    void *ctx = s_rtp.dtmf_ctx;
+    s_rtp.stats.dtmf_events = s_rtp.dtmf.events;
+    s_rtp.stats.dtmf_tones = s_rtp.tone_detector.digits;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (handler != NULL) {
+        handler(digit, ctx);
+    }
+}
+
+/**
+ * @brief Hand a new key press to the handler right away, not at playout
+ */
+static void handle_event(const rtp_packet_t *packet)
+{
+    char digit = rtp_dtmf_receive(&s_rtp.dtmf, packet);
+    if (digit != '\0') {
+        ESP_LOGI(TAG, "DTMF via RTP: %c", digit);
+        report_digit(digit);
+    }
+}
+
+/**
+ * @brief Look for key tones in the far-end audio
+ *
+ * Only while the far end has not sent telephone-events, which would
+ * report the same key presses again. Wideband audio is halved to 8 kHz
+ * by averaging pairs, which leaves the keypad tones below 1.7 kHz
+ * nearly untouched.
+ */
+static void detect_tones(const int16_t *pcm, size_t samples)
+{
+    if (s_rtp.dtmf.events > 0) {
+        return;
+    }
+    if (s_rtp.codec == RTP_ENGINE_CODEC_G722) {
+        samples /= 2;
+        for (size_t i = 0; i < samples; i++) {
+            s_rtp.tone_pcm[i] = (int16_t)((pcm[2 * i] + pcm[2 * i + 1]) / 2);
+        }
+        pcm = s_rtp.tone_pcm;
+    }
+    char digit = dtmf_detector_process(&s_rtp.tone_detector, pcm, samples);
+    if (digit != '\0') {
+        ESP_LOGI(TAG, "DTMF in-band: %c", digit);
+        report_digit(digit);
+    }
+}
+
+/**
+ * @brief Decode a payload into a frame
+ *
+ * @return Samples decoded
+ */
+static size_t decode_frame(const uint8_t *payload, size_t len, int16_t *pcm)
+{
+    int64_t start_us = esp_timer_get_time();
+    size_t samples;
+
+    if (s_rtp.codec == RTP_ENGINE_CODEC_G722) {
+        // Two samples per byte
+        samples = g722_decode(&s_rtp.g722_decoder, payload, pcm, len);
+    } else {
+        // G.711 is one byte per sample
+        g711_decode(s_rtp.law, payload, pcm, len);
+        samples = len;
+    }
+    s_rtp.codec_us += (uint32_t)(esp_timer_get_time() - start_us);
+    return samples;
+}
+
+/**
+ * @brief Encode a frame into the packet being built
+ *
+ * @return Payload bytes
+ */
+static size_t encode_frame(const int16_t *pcm)
+{
+    int64_t start_us = esp_timer_get_time();
+    uint8_t *payload = s_rtp.tx_packet + RTP_HEADER_SIZE;
+    size_t len;
+
+    if (s_rtp.codec == RTP_ENGINE_CODEC_G722) {
+        len = g722_encode(&s_rtp.g722_encoder, pcm, payload, s_rtp.frame_samples);
+    } else {
+        g711_encode(s_rtp.law, pcm, payload, s_rtp.frame_samples);
+        len = s_rtp.frame_samples;
+    }
+    s_rtp.codec_us += (uint32_t)(esp_timer_get_time() - start_us);
+    return len;
+}
+
+/**
+ * @brief Level a frame with the AGC and limiter of its direction
+ */
+static void control_gain(agc_t *agc, int16_t *pcm)
+{
+    int64_t start_us = esp_timer_get_time();
+    agc_process(agc, pcm, s_rtp.frame_samples);
+    s_rtp.gain_us += (uint32_t)(esp_timer_get_time() - start_us);
+}
+
+/**
+ * @brief Pass a frame through the loss concealment, or make one up for a lost packet
+ */
+static void conceal_loss(bool lost, int16_t *pcm)
+{
+    int64_t start_us = esp_timer_get_time();
+
+    if (!lost) {
+        plc_add_frame(&s_rtp.plc, pcm, s_rtp.frame_samples);
+    } else {
+        plc_conceal_frame(&s_rtp.plc, pcm, s_rtp.frame_samples);
+        if (s_rtp.codec == RTP_ENGINE_CODEC_G722) {
+            // The decoder adapts to the made-up audio as if it had been received
+            plc_synthesis(&s_rtp.plc, s_rtp.plc_pcm, s_rtp.frame_samples, G722_CONCEAL_LOOKAHEAD);
+            g722_conceal(&s_rtp.g722_decoder, s_rtp.plc_pcm, s_rtp.frame_samples);
+        }
+    }
+    s_rtp.plc_us = (uint32_t)(esp_timer_get_time() - start_us);
+}
+
+/**
+ * @brief Fill a pause of the far end with comfort noise
+ *
+ * The noise goes through the loss concealment like received audio, so
+ * its delay stays the same and a loss right before the pause fades into
+ * the noise.
+ */
+static void play_comfort_noise(int16_t *pcm)
+{
+    int64_t start_us = esp_timer_get_time();
+
+    if (s_rtp.codec == RTP_ENGINE_CODEC_G722) {
+        // The decoder adapts to the noise, so the next talkspurt does not start from stale state
+        comfort_noise_generate(&s_rtp.comfort_noise, s_rtp.plc_pcm, s_rtp.frame_samples);
+        comfort_noise_t ahead = s_rtp.comfort_noise;
+        comfort_noise_generate(&ahead, s_rtp.plc_pcm + s_rtp.frame_samples, G722_CONCEAL_LOOKAHEAD);
+        g722_conceal(&s_rtp.g722_decoder, s_rtp.plc_pcm, s_rtp.frame_samples);
+        memcpy(pcm, s_rtp.plc_pcm, s_rtp.frame_samples * sizeof(int16_t));
+    } else {
+        comfort_noise_generate(&s_rtp.comfort_noise, pcm, s_rtp.frame_samples);
+    }
+    plc_add_frame(&s_rtp.plc, pcm, s_rtp.frame_samples);
+    s_rtp.plc_us = (uint32_t)(esp_timer_get_time() - start_us);
+}
+
+/**
+ * @brief Play the frame the jitter buffer has due, concealing a lost one
+ */
+static void play_frame(const rtp_audio_io_t *io, const rtp_processing_t *processing)
+{
+    size_t len = 0;
+    jitter_buffer_result_t result = jitter_buffer_get(&s_rtp.jitter, s_rtp.rx_frame, &len);
+
+    portENTER_CRITICAL(&s_lock);
+    s_rtp.stats.jitter_buffer_depth_ms = jitter_buffer_depth(&s_rtp.jitter) * RTP_ENGINE_FRAME_MS;
+    s_rtp.stats.jitter_buffer_delay_ms = s_rtp.jitter.target_delay * 1000 / RTP_ENGINE_CLOCK_RATE;
+    s_rtp.stats.jitter_late_drops = s_rtp.jitter.stats.late_drops;
+    s_rtp.stats.jitter_underruns = s_rtp.jitter.stats.underruns;
+    portEXIT_CRITICAL(&s_lock);
+
+    // With an audio device the decoder writes straight into the speaker's ring
+    int16_t *pcm = s_rtp.rx_pcm;
+    bool speaker = io->playback != NULL;
+    if (s_rtp.device_running) {
+        int16_t *slot = audio_ring_write_begin(s_rtp.device.playback);
+        // A full ring means the speaker is behind: this frame is dropped
+        pcm = slot != NULL ? slot : s_rtp.rx_pcm;
+        speaker = slot != NULL;
+    }
+
+    size_t samples = 0;
+    if (result == JITTER_BUFFER_FRAME) {
+        samples = decode_frame(s_rtp.rx_frame, len, pcm);
+        detect_tones(pcm, samples);
+        // Frames from before the comfort noise still play, the pause is over with the next talkspurt
+        s_rtp.rx_silence &= s_rtp.jitter.paused;
+    }
+    memset(pcm + samples, 0, (s_rtp.frame_samples - samples) * sizeof(int16_t));
+    if (result == JITTER_BUFFER_BUFFERING && s_rtp.rx_silence) {
+        play_comfort_noise(pcm);
+    } else {
+        // Without comfort noise, a buffer that ran dry mid-call is a loss too
+        conceal_loss(result == JITTER_BUFFER_MISSING ||
+                     (result == JITTER_BUFFER_BUFFERING && s_rtp.jitter.stats.frames_played > 0), pcm);
+    }
+    if (!speaker) {
+        return;
+    }
+    if (processing->playout_gain) {
+        control_gain(&s_rtp.playout_agc, pcm);
+    }
+    // What the speaker plays is the reference for the echo in the next capture
+    echo_canceller_far_end(&s_rtp.echo, pcm, s_rtp.frame_samples);
+    if (s_rtp.device_running) {
+        // Due once the frames queued ahead of it have played
+        int64_t due_us = esp_timer_get_time() +
+                         (int64_t)audio_ring_count(s_rtp.device.playback) * RTP_ENGINE_FRAME_MS * 1000;
+        audio_ring_write_end(s_rtp.device.playback, due_us);
+    } else {
+        io->playback(io->ctx, pcm, s_rtp.frame_samples);
+    }
+}
+
+/**
+ * @brief Take a comfort noise packet: the far end pauses until its next audio
+ */
+static void handle_comfort_noise(const rtp_packet_t *packet)
+{
+    if (!comfort_noise_receive(&s_rtp.comfort_noise, packet->payload, packet->payload_len)) {
+        return;
+    }
+    s_rtp.rx_silence = true;
+    jitter_buffer_pause(&s_rtp.jitter);
+    portENTER_CRITICAL(&s_lock);
+    s_rtp.stats.cn_received++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void handle_packet(size_t len)
+{
+    rtp_packet_t packet;
+
+    if (!rtp_packet_parse(s_rtp.rx_packet, len, &packet)) {
+        portENTER_CRITICAL(&s_lock);
+        s_rtp.stats.packets_invalid++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    bool is_event = s_rtp.dtmf_payload_type != 0 && packet.payload_type == s_rtp.dtmf_payload_type;
+    bool is_noise = s_rtp.cn_payload_type != 0 && packet.payload_type == s_rtp.cn_payload_type;
+    if (packet.payload_type != s_rtp.payload_type && !is_event && !is_noise) {
+        return;
+    }
+
+    if (packet.ssrc == s_rtp.sender.ssrc) {
+        // Someone else uses our SSRC (RFC 3550 section 8.2): pick another one
+        s_rtp.sender.ssrc = esp_random();
+        portENTER_CRITICAL(&s_lock);
+        s_rtp.stats.ssrc_collisions++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    if (s_rtp.receiver.active && packet.ssrc != s_rtp.receiver.ssrc) {
+        s_rtp.lost_before += rtp_receiver_lost(&s_rtp.receiver);
+        jitter_buffer_flush(&s_rtp.jitter);
+    }
+    uint32_t arrival = rtp_clock_now();
+    bool accepted = rtp_receiver_update(&s_rtp.receiver, &packet, arrival);
+
+    if (!s_rtp.first_packet_seen) {
+        s_rtp.first_packet_seen = true;
+        call_latency_mark(CALL_LATENCY_FIRST_RTP);
+        ESP_LOGI(TAG, "First RTP packet, SSRC %08lx", (unsigned long)packet.ssrc);
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    if (accepted) {
+        s_rtp.stats.packets_received++;
+    } else {
+        s_rtp.stats.packets_invalid++;
+    }
+    s_rtp.stats.packets_lost = s_rtp.lost_before + rtp_receiver_lost(&s_rtp.receiver);
+    s_rtp.stats.jitter_ms = (s_rtp.receiver.jitter >> 4) * 1000 / RTP_ENGINE_CLOCK_RATE;
+    if (s_rtp.stats.jitter_ms > s_rtp.stats.jitter_max_ms) {
+        s_rtp.stats.jitter_max_ms = s_rtp.stats.jitter_ms;
+    }
+    s_rtp.stats.ssrc_changes = s_rtp.receiver.source_changes;
+    portEXIT_CRITICAL(&s_lock);
+
+    // Events and comfort noise share the sequence numbers of the audio, so they are counted above
+    if (accepted && is_event) {
+        handle_event(&packet);
+    } else if (accepted && is_noise) {
+        handle_comfort_noise(&packet);
+    } else if (accepted) {
+        jitter_buffer_put(&s_rtp.jitter, packet.timestamp, packet.payload, packet.payload_len, arrival);
+    }
+}
+
+/**
+ * @brief Our clock for RTCP: time since boot, steady over the call, in NTP format
+ */
+static uint64_t rtcp_clock_now(void)
+{
+    return rtcp_ntp_from_us((uint64_t)esp_timer_get_time());
+}
+
+/**
+ * @brief Time to the next report, drawn so the reports of many stations do not line up
+ */
+static int64_t rtcp_interval_us(void)
+{
+    return (int64_t)(RTP_RTCP_INTERVAL_MS / 2 + esp_random() % RTP_RTCP_INTERVAL_MS) * 1000;
+}
+
+/**
+ * @brief part of whole in 1/256, as the VoIP metrics rates are given
+ */
+static uint8_t fraction_256(uint32_t part, uint32_t whole)
+{
+    uint64_t fraction = whole > 0 ? (uint64_t)part * 256 / whole : 0;
+    return (uint8_t)(fraction > 255 ? 255 : fraction);
+}
+
+/**
+ * @brief Estimate the quality of the audio played here and fill the VoIP metrics for the far end
+ *
+ * Packets lost on the way and those the jitter buffer dropped as late
+ * both cost audio; the mouth-to-ear delay adds half the round trip to
+ * the playout delay and a frame of packetization.
+ */
+static void measure_quality(rtcp_voip_metrics_t *metrics)
+{
+    uint32_t rtt_ms = rtcp_session_rtt_ms(&s_rtp.rtcp);
+    uint32_t lost = s_rtp.lost_before + rtp_receiver_lost(&s_rtp.receiver);
+    uint32_t late = s_rtp.jitter.stats.late_drops;
+    uint32_t expected = s_rtp.stats.packets_received + lost;
+    uint32_t loss_permille = expected > 0 ? (uint32_t)((uint64_t)(lost + late) * 1000 / expected) : 0;
+    uint32_t playout_ms = s_rtp.jitter.target_delay * 1000 / RTP_ENGINE_CLOCK_RATE;
+    uint8_t r_factor = rtcp_r_factor(loss_permille, rtt_ms / 2 + playout_ms + RTP_ENGINE_FRAME_MS);
+
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->ssrc = s_rtp.receiver.ssrc;
+    metrics->loss_rate = fraction_256(lost, expected);
+    metrics->discard_rate = fraction_256(late, expected);
+    metrics->round_trip_ms = (uint16_t)rtt_ms;
+    metrics->end_system_ms = (uint16_t)(playout_ms + RTP_ENGINE_FRAME_MS);
+    metrics->noise_level_dbm = RTCP_METRIC_UNAVAILABLE;
+    metrics->r_factor = r_factor;
+    metrics->mos_lq = rtcp_mos(rtcp_r_factor(loss_permille, 0));
+    metrics->mos_cq = rtcp_mos(r_factor);
+    metrics->jb_nominal_ms = (uint16_t)playout_ms;
+    metrics->jb_max_ms = (uint16_t)(s_rtp.jitter.max_delay * 1000 / RTP_ENGINE_CLOCK_RATE);
+}
+
+/**
+ * @brief Send a compound report, with a block and metrics on the far end once it was heard
+ */
+static void send_report(bool bye)
+{
+    rtcp_report_block_t block;
+    rtcp_voip_metrics_t metrics;
+    rtcp_report_t report = {
+        .sender = &s_rtp.sender,
+        .ntp = rtcp_clock_now(),
+        .cname = s_rtp.cname,
+        .bye = bye
+    };
+
+    if (s_rtp.receiver.active) {
+        rtcp_session_report_block(&s_rtp.rtcp, &s_rtp.receiver, rtcp_ntp_middle(report.ntp), &block);
+        measure_quality(&metrics);
+        report.report = &block;
+        report.metrics = &metrics;
+    }
+    size_t len = rtcp_write(s_rtp.rtcp_packet, sizeof(s_rtp.rtcp_packet), &report);
+    bool sent = sendto(s_rtp.rtcp_sock, s_rtp.rtcp_packet, len, 0, (struct sockaddr *)&s_rtp.rtcp_remote,
+                       sizeof(s_rtp.rtcp_remote)) == (int)len;
+
+    portENTER_CRITICAL(&s_lock);
+    s_rtp.stats.rtcp_sent += sent;
+    if (report.metrics != NULL) {
+        s_rtp.stats.mos_x10 = metrics.mos_cq;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Take a report from the far end: round trip, and how our packets fare
+ *
+ * Its own VoIP metrics on our stream are taken as they are. Without them
+ * its MOS is estimated from the reported loss, with a playout delay of
+ * twice the reported jitter.
+ */
+static void handle_report(size_t len)
+{
+    rtcp_packet_t packet;
+
+    if (!rtcp_parse(s_rtp.rx_packet, len, s_rtp.sender.ssrc, &packet)) {
+        ESP_LOGD(TAG, "Invalid RTCP packet of %u bytes", (unsigned)len);
+        return;
+    }
+    rtcp_session_receive(&s_rtp.rtcp, &packet, rtcp_ntp_middle(rtcp_clock_now()));
+    if (packet.bye) {
+        ESP_LOGI(TAG, "Far end left the RTP session");
+    }
+
+    uint32_t rtt_ms = rtcp_session_rtt_ms(&s_rtp.rtcp);
+    uint32_t jitter_ms = packet.report.jitter * 1000 / RTP_ENGINE_CLOCK_RATE;
+    uint32_t mos_x10 = 0;
+    if (packet.has_metrics && packet.metrics.mos_cq != RTCP_METRIC_UNAVAILABLE && packet.metrics.mos_cq != 0) {
+        mos_x10 = packet.metrics.mos_cq;
+    } else if (packet.has_report) {
+        uint32_t sent = s_rtp.sender.packets > 0 ? s_rtp.sender.packets : 1;
+        uint32_t loss_permille = (uint32_t)((uint64_t)packet.report.cumulative_lost * 1000 / sent);
+        mos_x10 = rtcp_mos(rtcp_r_factor(loss_permille, rtt_ms / 2 + 2 * jitter_ms + RTP_ENGINE_FRAME_MS));
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_rtp.stats.rtcp_received++;
+    s_rtp.stats.rtt_ms = rtt_ms;
+    if (packet.has_report) {
+        s_rtp.stats.remote_packets_lost = packet.report.cumulative_lost;
+        s_rtp.stats.remote_loss_permille = packet.report.fraction_lost * 1000 / 256;
+        s_rtp.stats.remote_jitter_ms = jitter_ms;
+    }
+    if (mos_x10 != 0) {
+        s_rtp.stats.remote_mos_x10 = mos_x10;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Drain a socket without blocking
+ */
+static void receive_packets(int sock, void (*handle)(size_t len))
+{
+    for (;;) {
+        int received = recv(sock, s_rtp.rx_packet, sizeof(s_rtp.rx_packet), MSG_DONTWAIT);
+        if (received <= 0) {
+            if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                ESP_LOGD(TAG, "Receive failed: errno %d", errno);
+            }
+            return;
+        }
+        handle((size_t)received);
+    }
+}
+
+/**
+ * @brief Cancel the echo of the played audio in the captured frame
+ */
+static void cancel_echo(int16_t *pcm)
+{
+    int64_t start_us = esp_timer_get_time();
+    echo_canceller_process(&s_rtp.echo, pcm, pcm, s_rtp.frame_samples);
+    s_rtp.echo_us = (uint32_t)(esp_timer_get_time() - start_us);
+}
+
+/**
+ * @brief Suppress background noise in the captured frame, after the echo is gone
+ */
+static void suppress_noise(int16_t *pcm, uint8_t level_db)
+{
+    int64_t start_us = esp_timer_get_time();
+    noise_suppressor_set_level(&s_rtp.noise, level_db);
+    noise_suppressor_process(&s_rtp.noise, pcm, pcm, s_rtp.frame_samples);
+    s_rtp.noise_us = (uint32_t)(esp_timer_get_time() - start_us);
+}
+
+/**
+ * @brief Take the next microphone frame
+ *
+ * With an audio device it is the oldest slot of the capture ring, worked
+ * on in place and handed back by release_capture(); otherwise tx_pcm,
+ * filled by the capture callback.
+ *
+ * @param captured_us Set to the capture time of the first sample, 0 if unknown
+ * @return The frame, silence when there is no microphone audio
+ */
+static int16_t *take_capture(const rtp_audio_io_t *io, bool *microphone, int64_t *captured_us)
+{
+    size_t captured = 0;
+    *captured_us = 0;
+
+    if (s_rtp.device_running) {
+        int16_t *slot = audio_ring_read_begin(s_rtp.device.capture, captured_us);
+        *microphone = slot != NULL;
+        if (slot != NULL) {
+            return slot;
+        }
+    } else {
+        *microphone = io->capture != NULL;
+        if (io->capture != NULL) {
+            captured = io->capture(io->ctx, s_rtp.tx_pcm, s_rtp.frame_samples);
+            if (captured > s_rtp.frame_samples) {
+                captured = s_rtp.frame_samples;
+            }
+        }
+    }
+    memset(s_rtp.tx_pcm + captured, 0, (s_rtp.frame_samples - captured) * sizeof(int16_t));
+    return s_rtp.tx_pcm;
+}
+
+static void release_capture(bool microphone)
+{
+    if (s_rtp.device_running && microphone) {
+        audio_ring_read_end(s_rtp.device.capture);
+    }
+}
+
+/**
+ * @brief Build the packet of a frame without speech, if one is due
+ *
+ * Comfort noise goes out at the end of a talkspurt, when the noise level
+ * moves and every RTP_SILENCE_REFRESH_MS. Without comfort noise in the
+ * answer the frame itself goes out that often, so NATs and the media
+ * timeout of the far end still see the stream.
+ *
+ * @param payload_type Set to the comfort noise payload type when it is sent
+ * @return Payload bytes, 0 to send nothing
+ */
+static size_t encode_silence(const int16_t *pcm, uint8_t *payload_type)
+{
+    uint8_t level = vad_noise_level(&s_rtp.vad);
+    bool due = s_rtp.tx_talking || s_rtp.frames_unsent + 1 >= RTP_SILENCE_REFRESH_MS / RTP_ENGINE_FRAME_MS;
+
+    if (s_rtp.cn_payload_type == 0) {
+        return due ? encode_frame(pcm) : 0;
+    }
+    if (!due && abs(level - s_rtp.cn_level) < RTP_CN_LEVEL_STEP_DB) {
+        return 0;
+    }
+    s_rtp.cn_level = level;
+    *payload_type = s_rtp.cn_payload_type;
+    return comfort_noise_write(level, s_rtp.tx_packet + RTP_HEADER_SIZE);
+}
+
+static void send_frame(const rtp_audio_io_t *io, const rtp_processing_t *processing)
+{
+    bool microphone;
+    int64_t captured_us;
+    int16_t *pcm = take_capture(io, &microphone, &captured_us);
+    bool speaker = s_rtp.device_running || io->playback != NULL;
+
+    if (microphone) {
+        if (processing->echo_canceller && speaker) {
+            cancel_echo(pcm);
+        }
+        if (processing->noise_level_db > 0) {
+            suppress_noise(pcm, processing->noise_level_db);
+        }
+        if (processing->capture_gain) {
+            control_gain(&s_rtp.capture_agc, pcm);
+        }
+    }
+    bool speech = !processing->silence_suppression || vad_process(&s_rtp.vad, pcm, s_rtp.frame_samples);
+    uint8_t payload_type = s_rtp.payload_type;
+    size_t payload_len = speech ? encode_frame(pcm) : encode_silence(pcm, &payload_type);
+    release_capture(microphone);
+
+    // Marker on the first packet of each talkspurt (RFC 3551 section 4.1)
+    bool marker = speech && (!s_rtp.tx_talking || s_rtp.sender.packets == 0);
+    s_rtp.tx_talking = speech;
+    if (payload_len == 0) {
+        // The timestamp runs on, so the far end sees a pause and not a loss
+        rtp_sender_skip(&s_rtp.sender, RTP_ENGINE_FRAME_SAMPLES);
+        s_rtp.frames_unsent++;
+        portENTER_CRITICAL(&s_lock);
+        s_rtp.stats.packets_saved++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    s_rtp.frames_unsent = 0;
+    size_t len = rtp_sender_finish(&s_rtp.sender, s_rtp.tx_packet, payload_type, marker, payload_len,
+                                   RTP_ENGINE_FRAME_SAMPLES);
+
+    if (sendto(s_rtp.sock, s_rtp.tx_packet, len, 0, (struct sockaddr *)&s_rtp.remote,
+               sizeof(s_rtp.remote)) == (int)len) {
+        int64_t sent_us = esp_timer_get_time();
+        portENTER_CRITICAL(&s_lock);
+        s_rtp.stats.packets_sent++;
+        s_rtp.stats.cn_sent += payload_type != s_rtp.payload_type;
+        if (captured_us != 0) {
+            s_rtp.stats.mouth_to_network_us = (uint32_t)(sent_us - captured_us);
+        }
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+static void close_rtcp(void)
+{
+    if (s_rtp.rtcp_sock >= 0) {
+        close(s_rtp.rtcp_sock);
+        s_rtp.rtcp_sock = -1;
+    }
+}
+
+/**
+ * @brief Close the sockets, stop the device and log the call's counters
+ *
+ * Once the RTP task has left its loop, or from the task itself on its way out.
+ */
+static void teardown(void)
+{
+    if (s_rtp.sock >= 0) {
+        close(s_rtp.sock);
+        s_rtp.sock = -1;
+    }
+    if (s_rtp.rtcp_sock >= 0 && (!s_rtp.task_running || s_rtp.stop_in_task)) {
+        // A last report with BYE leaves the far end the final counts (RFC 3550 section 6.3.7)
+        send_report(true);
+    }
+    close_rtcp();
+    if (s_rtp.device_running) {
+        s_rtp.device_running = false;
+        if (s_rtp.device.stop != NULL) {
+            s_rtp.device.stop(s_rtp.device.ctx);
+        }
+    }
+
+    rtp_engine_stats_t stats;
+    rtp_engine_get_stats(&stats);
+    ESP_LOGI(TAG, "Media stopped: %lu sent, %lu saved in silence, %lu received, %lu lost, %lu late, %lu underruns",
+             (unsigned long)stats.packets_sent, (unsigned long)stats.packets_saved,
+             (unsigned long)stats.packets_received, (unsigned long)stats.packets_lost,
+             (unsigned long)stats.jitter_late_drops, (unsigned long)stats.jitter_underruns);
+    ESP_LOGI(TAG, "Call quality: jitter %lu ms (peak %lu), far end lost %lu, RTT %lu ms, MOS %lu.%lu here, %lu.%lu there",
+             (unsigned long)stats.jitter_ms, (unsigned long)stats.jitter_max_ms,
+             (unsigned long)stats.remote_packets_lost, (unsigned long)stats.rtt_ms,
+             (unsigned long)stats.mos_x10 / 10, (unsigned long)stats.mos_x10 % 10,
+             (unsigned long)stats.remote_mos_x10 / 10, (unsigned long)stats.remote_mos_x10 % 10);
+}
+
+static void rtp_task(void *arg)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (s_rtp.running) {
+        int64_t start_us = esp_timer_get_time();
+        portENTER_CRITICAL(&s_lock);
+        rtp_audio_io_t io = s_rtp.io;
+        rtp_processing_t processing = s_rtp.processing;
+        portEXIT_CRITICAL(&s_lock);
+        s_rtp.codec_us = 0;
+        s_rtp.echo_us = 0;
+        s_rtp.noise_us = 0;
+        s_rtp.gain_us = 0;
+        s_rtp.plc_us = 0;
+
+        receive_packets(s_rtp.sock, handle_packet);
+        if (s_rtp.rtcp_sock >= 0) {
+            receive_packets(s_rtp.rtcp_sock, handle_report);
+        }
+        play_frame(&io, &processing);
+        send_frame(&io, &processing);
+        if (s_rtp.rtcp_sock >= 0 && start_us >= s_rtp.rtcp_due_us) {
+            send_report(false);
+            s_rtp.rtcp_due_us = start_us + rtcp_interval_us();
+        }
+        float erle_db = echo_canceller_erle_db(&s_rtp.echo);
+        float noise_reduction_db = noise_suppressor_reduction_db(&s_rtp.noise);
+
+        portENTER_CRITICAL(&s_lock);
+        s_rtp.stats.frame_us = (uint32_t)(esp_timer_get_time() - start_us);
+        s_rtp.stats.codec_us = s_rtp.codec_us;
+        s_rtp.stats.echo_us = s_rtp.echo_us;
+        s_rtp.stats.echo_erle_db = erle_db > 0 ? (uint32_t)erle_db : 0;
+        s_rtp.stats.noise_us = s_rtp.noise_us;
+        s_rtp.stats.noise_reduction_db = noise_reduction_db > 0 ? (uint32_t)noise_reduction_db : 0;
+        s_rtp.stats.gain_us = s_rtp.gain_us;
+        s_rtp.stats.plc_us = s_rtp.plc_us;
+        s_rtp.stats.concealed_ms = s_rtp.plc.concealed * PLC_SUBFRAME_MS;
+        s_rtp.stats.capture_gain_db = agc_gain_db(&s_rtp.capture_agc);
+        s_rtp.stats.playout_gain_db = agc_gain_db(&s_rtp.playout_agc);
+        s_rtp.stats.capture_limited_ms = s_rtp.capture_agc.limited / (s_rtp.capture_agc.sample_rate / 1000);
+        s_rtp.stats.playout_limited_ms = s_rtp.playout_agc.limited / (s_rtp.playout_agc.sample_rate / 1000);
+        if (s_rtp.device_running) {
+            s_rtp.stats.capture_overruns = s_rtp.device.capture->stats.overruns;
+            s_rtp.stats.capture_underruns = s_rtp.device.capture->stats.underruns;
+            s_rtp.stats.playback_overruns = s_rtp.device.playback->stats.overruns;
+            s_rtp.stats.playback_underruns = s_rtp.device.playback->stats.underruns;
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(RTP_ENGINE_FRAME_MS));
+    }
+
+    // Decided under the lock, so a stop that gave up waiting cannot be missed
+    portENTER_CRITICAL(&s_lock);
+    bool stop_in_task = s_rtp.stop_in_task;
+    if (!stop_in_task) {
+        s_rtp.task_running = false;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (stop_in_task) {
+        teardown();
+        s_rtp.stop_in_task = false;
+        s_rtp.task_running = false;
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t rtp_engine_set_audio(const rtp_audio_io_t *io)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (io != NULL) {
+        s_rtp.io = *io;
+    } else {
+        memset(&s_rtp.io, 0, sizeof(s_rtp.io));
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t rtp_engine_set_audio_device(const rtp_audio_device_t *device)
+{
+    if (device != NULL && (device->start == NULL || device->capture == NULL || device->playback == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_rtp.running || s_rtp.task_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (device != NULL) {
+        s_rtp.device = *device;
+    } else {
+        memset(&s_rtp.device, 0, sizeof(s_rtp.device));
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t rtp_engine_set_echo_canceller(bool enabled)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_rtp.processing.echo_canceller = enabled;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t rtp_engine_set_noise_suppression(uint8_t level_db)
+{
+    if (level_db > NOISE_SUPPRESSOR_MAX_LEVEL_DB) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_rtp.processing.noise_level_db = level_db;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t rtp_engine_set_gain_control(bool capture, bool playout)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_rtp.processing.capture_gain = capture;
+    s_rtp.processing.playout_gain = playout;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t rtp_engine_set_silence_suppression(bool enabled)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_rtp.processing.silence_suppression = enabled;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t rtp_engine_set_dtmf_handler(rtp_dtmf_handler_t handler, void *ctx)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_rtp.dtmf_handler = handler;
+    s_rtp.dtmf_ctx = ctx;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+/**
+ * @brief Start the audio device at the call's rate; the callbacks are used if it fails
+ */
+static void start_device(void)
+{
+    s_rtp.device_running = false;
+    if (s_rtp.device.start == NULL) {
+        return;
+    }
+    esp_err_t err = s_rtp.device.start(s_rtp.device.ctx, rtp_engine_sample_rate());
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Audio device failed to start: %s", esp_err_to_name(err));
+        return;
+    }
+    if (s_rtp.device.capture->frame_samples != s_rtp.frame_samples ||
+        s_rtp.device.playback->frame_samples != s_rtp.frame_samples) {
+        ESP_LOGE(TAG, "Audio device frames do not match the %u samples of the call",
+                 (unsigned)s_rtp.frame_samples);
+        if (s_rtp.device.stop != NULL) {
+            s_rtp.device.stop(s_rtp.device.ctx);
+        }
+        return;
+    }
+    s_rtp.device_running = true;
+}
+
+static int open_socket(uint16_t local_port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket for port %u: errno %d", local_port, errno);
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_port = htons(local_port),
+        .sin_addr.s_addr = htonl(INADDR_ANY)
+    };
+    if (bind(sock, (struct sockaddr *)&local, sizeof(local)) != 0) {
+        ESP_LOGE(TAG, "Failed to bind port %u: errno %d", local_port, errno);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+esp_err_t rtp_engine_start(const rtp_engine_params_t *params)
+{
+    if (params == NULL || params->remote_addr == 0 || params->remote_port == 0 ||
+        params->codec > RTP_ENGINE_CODEC_G722 || params->payload_type > 127) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_rtp.running || s_rtp.task_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    g711_init();
+    s_rtp.sock = open_socket(params->local_port);
+    if (s_rtp.sock < 0) {
+        return ESP_FAIL;
+    }
+
+    memset(&s_rtp.remote, 0, sizeof(s_rtp.remote));
+    s_rtp.remote.sin_family = AF_INET;
+    s_rtp.remote.sin_port = htons(params->remote_port);
+    s_rtp.remote.sin_addr.s_addr = params->remote_addr;
+    s_rtp.rtcp_sock = open_socket(params->local_port + 1);
+    if (s_rtp.rtcp_sock < 0) {
+        ESP_LOGW(TAG, "No RTCP for this call");
+    }
+    s_rtp.rtcp_remote = s_rtp.remote;
+    s_rtp.rtcp_remote.sin_port = htons(params->remote_port + 1);
+    s_rtp.payload_type = params->payload_type;
+    s_rtp.codec = params->codec;
+    s_rtp.law = params->codec == RTP_ENGINE_CODEC_PCMU ? G711_ULAW : G711_ALAW;
+    s_rtp.frame_samples = params->codec == RTP_ENGINE_CODEC_G722 ? RTP_ENGINE_MAX_FRAME_SAMPLES :
+                          RTP_ENGINE_FRAME_SAMPLES;
+    g722_init(&s_rtp.g722_encoder);
+    g722_init(&s_rtp.g722_decoder);
+    echo_canceller_init(&s_rtp.echo, s_rtp.frame_samples * 1000 / RTP_ENGINE_FRAME_MS);
+    // The level is set again before each frame, from rtp_engine_set_noise_suppression()
+    noise_suppressor_init(&s_rtp.noise, s_rtp.frame_samples * 1000 / RTP_ENGINE_FRAME_MS, 0);
+    agc_init(&s_rtp.capture_agc, s_rtp.frame_samples * 1000 / RTP_ENGINE_FRAME_MS,
+             RTP_CAPTURE_TARGET_DBFS, RTP_CAPTURE_MAX_GAIN_DB);
+    agc_init(&s_rtp.playout_agc, s_rtp.frame_samples * 1000 / RTP_ENGINE_FRAME_MS,
+             RTP_PLAYOUT_TARGET_DBFS, RTP_PLAYOUT_MAX_GAIN_DB);
+    plc_init(&s_rtp.plc, s_rtp.frame_samples * 1000 / RTP_ENGINE_FRAME_MS);
+    s_rtp.dtmf_payload_type = params->dtmf_payload_type;
+    s_rtp.cn_payload_type = params->cn_payload_type;
+    vad_init(&s_rtp.vad, s_rtp.frame_samples * 1000 / RTP_ENGINE_FRAME_MS);
+    s_rtp.tx_talking = false;
+    s_rtp.cn_level = COMFORT_NOISE_MAX_LEVEL;
+    s_rtp.frames_unsent = 0;
+    comfort_noise_init(&s_rtp.comfort_noise, esp_random());
+    s_rtp.rx_silence = false;
+
+    rtp_sender_init(&s_rtp.sender, esp_random(), (uint16_t)esp_random(), esp_random());
+    rtp_receiver_init(&s_rtp.receiver);
+    jitter_buffer_init(&s_rtp.jitter, RTP_ENGINE_FRAME_SAMPLES, RTP_JB_MIN_FRAMES, RTP_JB_MAX_FRAMES);
+    rtp_dtmf_init(&s_rtp.dtmf);
+    dtmf_detector_init(&s_rtp.tone_detector);
+    s_rtp.lost_before = 0;
+    s_rtp.first_packet_seen = false;
+    rtcp_session_init(&s_rtp.rtcp);
+    // The first report after half an interval (RFC 3550 section 6.2)
+    s_rtp.rtcp_due_us = esp_timer_get_time() + rtcp_interval_us() / 2;
+    snprintf(s_rtp.cname, sizeof(s_rtp.cname), "%08lx%08lx%08lx", (unsigned long)esp_random(),
+             (unsigned long)esp_random(), (unsigned long)esp_random());
+    start_device();
+    portENTER_CRITICAL(&s_lock);
+    memset(&s_rtp.stats, 0, sizeof(s_rtp.stats));
+    portEXIT_CRITICAL(&s_lock);
+
+    s_rtp.running = true;
+    s_rtp.task_running = true;
+    if (xTaskCreate(rtp_task, "rtp", RTP_TASK_STACK_SIZE, NULL, RTP_TASK_PRIORITY, &s_rtp.task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create RTP task");
+        s_rtp.running = false;
+        s_rtp.task_running = false;
+        close(s_rtp.sock);
+        s_rtp.sock = -1;
+        close_rtcp();
+        return ESP_ERR_NO_MEM;
+    }
+
+    char host[16];
+    inet_ntoa_r(s_rtp.remote.sin_addr, host, sizeof(host));
+    static const char *const codec_names[] = { "PCMU", "PCMA", "G722" };
+    ESP_LOGI(TAG, "Media started: %s (PT %u) to %s:%u from port %u", codec_names[params->codec],
+             params->payload_type, host, params->remote_port, params->local_port);
+    return ESP_OK;
+}
+
+void rtp_engine_stop(void)
+{
+    if (!s_rtp.running) {
+        return;
+    }
+
+    s_rtp.running = false;
+    if (s_rtp.task_running && xTaskGetCurrentTaskHandle() == s_rtp.task) {
+        // Waiting here would wait for ourselves; the task finishes its frame and tears down
+        s_rtp.stop_in_task = true;
+        return;
+    }
+    for (int waited = 0; s_rtp.task_running && waited < RTP_STOP_WAIT_MS; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    // A task still in its frame owns the sockets, leave the teardown to it
+    portENTER_CRITICAL(&s_lock);
+    bool task_running = s_rtp.task_running;
+    if (task_running) {
+        s_rtp.stop_in_task = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (task_running) {
+        ESP_LOGW(TAG, "RTP task still running after %d ms, it tears down on exit", RTP_STOP_WAIT_MS);
+        return;
+    }
+    teardown();
+}
+
+bool rtp_engine_running(void)
+{
+    return s_rtp.running;
+}
+
+uint32_t rtp_engine_sample_rate(void)
+{
+    return s_rtp.codec == RTP_ENGINE_CODEC_G722 ? RTP_ENGINE_WIDEBAND_RATE : RTP_ENGINE_CLOCK_RATE;
+}
+
+void rtp_engine_get_stats(rtp_engine_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_rtp.stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,291 @@
+#ifndef RTP_ENGINE_H
+#define RTP_ENGINE_H
+
+#include "esp_err.h"
+#include "audio_ring.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Audio format of the media path: 8 kHz mono, 20 ms per packet
+ */
+#define RTP_ENGINE_CLOCK_RATE       8000
+#define RTP_ENGINE_FRAME_MS         20
+#define RTP_ENGINE_FRAME_SAMPLES    (RTP_ENGINE_CLOCK_RATE * RTP_ENGINE_FRAME_MS / 1000)
+
+/**
+ * @brief G.722 carries 16 kHz audio, still stamped with the 8 kHz RTP clock (RFC 3551)
+ */
+#define RTP_ENGINE_WIDEBAND_RATE    16000
+#define RTP_ENGINE_MAX_FRAME_SAMPLES    (RTP_ENGINE_WIDEBAND_RATE * RTP_ENGINE_FRAME_MS / 1000)
+
+/**
+ * @brief Largest RTP datagram accepted
+ */
+#define RTP_ENGINE_MAX_PACKET_SIZE  1500
+
+/**
+ * @brief Where the engine takes microphone audio from and plays the far end to
+ *
+ * Both are called from the RTP task once per frame and should not block
+ * for longer than a frame. Either may be NULL: the engine then sends
+ * silence or drops the received audio. Frames are 20 ms at the rate
+ * rtp_engine_sample_rate() reports for the call: 160 samples for G.711,
+ * 320 for G.722.
+ */
+typedef struct {
+    /**
+     * @brief Fill a frame of microphone samples
+     * @return Samples written; the rest of the frame is sent as silence
+     */
+    size_t (*capture)(void *ctx, int16_t *pcm, size_t samples);
+    /**
+     * @brief Play a frame of far-end samples
+     */
+    void (*playback)(void *ctx, const int16_t *pcm, size_t samples);
+    void *ctx;
+} rtp_audio_io_t;
+
+/**
+ * @brief Audio hardware that exchanges frames with the engine through rings
+ *
+ * The zero-copy alternative to rtp_audio_io_t: the driver fills capture
+ * slots in place and plays playback slots in place, and the engine runs
+ * echo cancellation, noise suppression and gain control in the same
+ * slots and encodes straight from them, or decodes straight into them.
+ * Capture frames are stamped with the time their first sample was
+ * captured, which gives the mouth-to-network latency.
+ */
+typedef struct {
+    /**
+     * @brief Start the audio I/O for a call
+     *
+     * Called from rtp_engine_start(). Must leave both rings initialised
+     * with 20 ms frames at sample_rate before the driver touches them.
+     */
+    esp_err_t (*start)(void *ctx, uint32_t sample_rate);
+    /**
+     * @brief Stop the audio I/O, called from rtp_engine_stop(); may be NULL
+     */
+    void (*stop)(void *ctx);
+    audio_ring_t *capture;          ///< Microphone frames, filled by the driver
+    audio_ring_t *playback;         ///< Speaker frames, filled by the engine
+    void *ctx;
+} rtp_audio_device_t;
+
+/**
+ * @brief Called with each key pressed at the far end
+ *
+ * Runs on the RTP task as soon as the first packet of an RFC 4733 event
+ * arrives, or once an in-band tone has lasted long enough. It must not
+ * block; work such as hanging up belongs on another task.
+ */
+typedef void (*rtp_dtmf_handler_t)(char digit, void *ctx);
+
+/**
+ * @brief Audio codecs of the media path
+ */
+typedef enum {
+    RTP_ENGINE_CODEC_PCMU,      ///< G.711 µ-law, 8 kHz
+    RTP_ENGINE_CODEC_PCMA,      ///< G.711 A-law, 8 kHz
+    RTP_ENGINE_CODEC_G722       ///< G.722 at 64 kbit/s, 16 kHz
+} rtp_engine_codec_t;
+
+/**
+ * @brief Media of one call, from the SDP exchange
+ */
+typedef struct {
+    uint16_t local_port;        ///< Port offered in our SDP
+    uint32_t remote_addr;       ///< IPv4 address from the answer (network order)
+    uint16_t remote_port;       ///< Port from the answer
+    rtp_engine_codec_t codec;   ///< Codec agreed by the answer
+    uint8_t payload_type;       ///< Payload type the answer maps the codec to
+    uint8_t dtmf_payload_type;  ///< telephone-event payload type from the answer, 0 if none
+    uint8_t cn_payload_type;    ///< Comfort noise payload type from the answer, 0 if none
+} rtp_engine_params_t;
+
+/**
+ * @brief Counters of the current or last call
+ */
+typedef struct {
+    uint32_t packets_sent;
+    uint32_t packets_saved;         ///< Frames not sent because the microphone was silent, this call
+    uint32_t cn_sent;               ///< Comfort noise packets among those sent
+    uint32_t cn_received;           ///< Comfort noise packets received
+    uint32_t packets_received;      ///< Packets accepted from the remote source
+    uint32_t packets_lost;          ///< Gaps in the remote sequence numbers
+    uint32_t packets_invalid;       ///< Not RTP or rejected by the sequence checks
+    uint32_t jitter_ms;             ///< Interarrival jitter (RFC 3550)
+    uint32_t jitter_max_ms;         ///< Highest interarrival jitter of the call
+    uint32_t ssrc_changes;          ///< Remote source switched mid-call
+    uint32_t ssrc_collisions;       ///< Remote used our SSRC and we picked a new one
+    uint32_t frame_us;              ///< CPU time of the last frame (capture, encode, decode, playback)
+    uint32_t codec_us;              ///< Encode plus decode time of the last frame
+    uint32_t echo_us;               ///< Echo canceller time of the last frame
+    uint32_t echo_erle_db;          ///< Echo return loss enhancement of the call so far
+    uint32_t noise_us;              ///< Noise suppressor time of the last frame
+    uint32_t noise_reduction_db;    ///< Microphone level taken out by noise suppression so far
+    uint32_t gain_us;               ///< Gain control time of the last frame, both directions
+    uint32_t plc_us;                ///< Packet loss concealment time of the last frame
+    uint32_t concealed_ms;          ///< Lost or late audio made up by concealment, this call
+    int32_t capture_gain_db;        ///< Microphone AGC gain of the last frame
+    int32_t playout_gain_db;        ///< Speaker AGC gain of the last frame
+    uint32_t capture_limited_ms;    ///< Microphone audio the limiter turned down, this call
+    uint32_t playout_limited_ms;    ///< Speaker audio the limiter turned down, this call
+    uint32_t mouth_to_network_us;   ///< Capture of the last frame's first sample to its packet being sent
+    uint32_t capture_overruns;      ///< Microphone frames lost because the engine fell behind
+    uint32_t capture_underruns;     ///< Frames the engine sent as silence for want of microphone audio
+    uint32_t playback_overruns;     ///< Received frames dropped because the speaker fell behind
+    uint32_t playback_underruns;    ///< Frames the speaker ran dry for
+    uint32_t jitter_buffer_depth_ms;    ///< Audio buffered ahead of the speaker
+    uint32_t jitter_buffer_delay_ms;    ///< Playout delay the buffer currently aims for
+    uint32_t jitter_late_drops;         ///< Frames that arrived after their playout time
+    uint32_t jitter_underruns;          ///< Times the buffer ran dry during the call
+    uint32_t dtmf_events;               ///< Key presses received as RFC 4733 events
+    uint32_t dtmf_tones;                ///< Key presses detected as in-band tones
+    uint32_t rtcp_sent;                 ///< RTCP reports sent
+    uint32_t rtcp_received;             ///< RTCP packets received from the far end
+    uint32_t rtt_ms;                    ///< Network round trip from the far end's last report, 0 until one echoes ours
+    uint32_t remote_packets_lost;       ///< Our packets the far end reports lost
+    uint32_t remote_loss_permille;      ///< Share of our packets lost in the far end's last report interval
+    uint32_t remote_jitter_ms;          ///< Interarrival jitter the far end measures on our packets
+    uint32_t mos_x10;                   ///< Estimated MOS of the audio played here, times 10; 0 until known
+    uint32_t remote_mos_x10;            ///< MOS of our audio at the far end, times 10; 0 until it reports
+} rtp_engine_stats_t;
+
+/**
+ * @brief Set the audio source and sink
+ *
+ * Takes effect at the next frame, also during a call.
+ *
+ * @param io Callbacks, copied; NULL to remove them
+ */
+esp_err_t rtp_engine_set_audio(const rtp_audio_io_t *io);
+
+/**
+ * @brief Set the audio hardware that exchanges frames through rings
+ *
+ * Started with each call and stopped with it; the audio callbacks are
+ * not used while it runs. The mouth-to-network latency and the ring
+ * underrun and overrun counters are only reported with a device.
+ *
+ * @param device Copied; NULL to remove it
+ * @return ESP_OK, ESP_ERR_INVALID_ARG without start or rings,
+ *         ESP_ERR_INVALID_STATE during a call
+ */
+esp_err_t rtp_engine_set_audio_device(const rtp_audio_device_t *device);
+
+/**
+ * @brief Switch the acoustic echo canceller on or off
+ *
+ * On by default. While on and both audio callbacks are set, each captured
+ * frame is cleaned of the echo of the audio played just before, using an
+ * adaptive filter that learns the path from speaker to microphone during
+ * the call. Takes effect at the next frame.
+ */
+esp_err_t rtp_engine_set_echo_canceller(bool enabled);
+
+/**
+ * @brief Set how strongly background noise is suppressed
+ *
+ * NOISE_SUPPRESSOR_LEVEL_DB by default. Captured frames are cleaned of
+ * steady noise such as traffic and wind after the echo canceller and
+ * before encoding; noise-only frequency bands are attenuated by up to
+ * level_db. Costs NOISE_SUPPRESSOR_DELAY_MS of delay while on. Takes
+ * effect at the next frame.
+ *
+ * @param level_db 0 to switch suppression off, at most NOISE_SUPPRESSOR_MAX_LEVEL_DB
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a higher level
+ */
+esp_err_t rtp_engine_set_noise_suppression(uint8_t level_db);
+
+/**
+ * @brief Switch automatic gain control on or off per direction
+ *
+ * Both on by default. The AGC brings speech towards a fixed level, so a
+ * visitor at 20 cm and one at 2 m sound alike, and a look-ahead limiter
+ * after it keeps peaks from clipping. On the microphone it runs last
+ * before encoding, on the speaker after decoding. Each direction is
+ * delayed by AGC_LOOKAHEAD_MS. The gain and limiter activity show in rtp_engine_get_stats().
+ * Takes effect at the next frame.
+ */
+esp_err_t rtp_engine_set_gain_control(bool capture, bool playout);
+
+/**
+ * @brief Switch silence suppression on the microphone on or off
+ *
+ * On by default. A voice activity detector looks at each captured frame
+ * after the echo canceller, noise suppressor and AGC. In the pauses no
+ * audio is sent: if the answer agreed comfort noise, an RFC 3389 packet
+ * with the noise level goes out at the end of each talkspurt, when the
+ * level changes and once a second; otherwise one silent frame a second.
+ * The frames saved show in rtp_engine_get_stats(). Comfort noise from the
+ * far end is played whether this is on or not. Takes effect at the next
+ * frame.
+ */
+esp_err_t rtp_engine_set_silence_suppression(bool enabled);
+
+/**
+ * @brief Set the receiver of RFC 4733 key presses
+ *
+ * @param handler Called once per event; NULL to ignore events
+ * @param ctx Passed to the handler
+ */
+esp_err_t rtp_engine_set_dtmf_handler(rtp_dtmf_handler_t handler, void *ctx);
+
+/**
+ * @brief Start sending and receiving media for a call
+ *
+ * Opens the RTP socket and starts the RTP task. A new SSRC, sequence
+ * number and timestamp are drawn for every call. Received audio goes
+ * through an adaptive jitter buffer before playback. The first packet
+ * from the remote is stamped as CALL_LATENCY_FIRST_RTP.
+ *
+ * RTCP runs on the port above local_port, to the port above remote_port
+ * (RFC 3550 section 11). About every 5 s a sender or receiver report
+ * goes out with a VoIP metrics block (RFC 3611) on the received audio,
+ * and reports from the far end give the round trip and what it receives
+ * of ours. Both directions get an E-model MOS estimate. The call goes
+ * on without RTCP if its port cannot be opened.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an unknown codec or payload type,
+ *         ESP_ERR_INVALID_STATE if media is already running, ESP_FAIL if
+ *         the socket could not be opened
+ */
+esp_err_t rtp_engine_start(const rtp_engine_params_t *params);
+
+/**
+ * @brief Stop the media of the current call, no-op when none runs
+ *
+ * Waits for the RTP task to finish its frame. A task that takes longer
+ * closes the sockets and stops the device itself on its way out.
+ */
+void rtp_engine_stop(void);
+
+/**
+ * @brief Whether media is running
+ */
+bool rtp_engine_running(void);
+
+/**
+ * @brief Sample rate of the audio callbacks in the current or last call
+ *
+ * 16000 with G.722, otherwise RTP_ENGINE_CLOCK_RATE.
+ */
+uint32_t rtp_engine_sample_rate(void);
+
+/**
+ * @brief Get the counters of the current or last call
+ */
+void rtp_engine_get_stats(rtp_engine_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RTP_ENGINE_H
@@ -0,0 +1,170 @@
+#include "rtp_packet.h"
+#include <string.h>
+
+#define RTP_VERSION             2
+#define RTP_SEQ_MOD             (1u << 16)
+#define RTP_MAX_DROPOUT         3000
+#define RTP_MAX_MISORDER        100
+
+static uint16_t read_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t read_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void write_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static void write_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+bool rtp_packet_parse(const uint8_t *data, size_t len, rtp_packet_t *packet)
+{
+    if (data == NULL || packet == NULL || len < RTP_HEADER_SIZE || (data[0] >> 6) != RTP_VERSION) {
+        return false;
+    }
+
+    size_t offset = RTP_HEADER_SIZE + (size_t)(data[0] & 0x0f) * 4;
+    if (data[0] & 0x10) {
+        // Header extension: 16-bit profile data, 16-bit length in words
+        if (offset + 4 > len) {
+            return false;
+        }
+        offset += 4 + (size_t)read_u16(data + offset + 2) * 4;
+    }
+    size_t end = len;
+    if (data[0] & 0x20) {
+        // Padding: the last octet counts the padding octets including itself
+        uint8_t padding = data[len - 1];
+        if (padding == 0 || padding > len) {
+            return false;
+        }
+        end -= padding;
+    }
+    if (offset > end) {
+        return false;
+    }
+
+    packet->marker = (data[1] & 0x80) != 0;
+    packet->payload_type = data[1] & 0x7f;
+    packet->seq = read_u16(data + 2);
+    packet->timestamp = read_u32(data + 4);
+    packet->ssrc = read_u32(data + 8);
+    packet->payload = data + offset;
+    packet->payload_len = end - offset;
+    return true;
+}
+
+void rtp_sender_init(rtp_sender_t *sender, uint32_t ssrc, uint16_t seq, uint32_t timestamp)
+{
+    memset(sender, 0, sizeof(*sender));
+    sender->ssrc = ssrc;
+    sender->seq = seq;
+    sender->timestamp = timestamp;
+}
+
+size_t rtp_sender_finish(rtp_sender_t *sender, uint8_t *buf, uint8_t payload_type, bool marker,
+                         size_t payload_len, uint32_t samples)
+{
+    buf[0] = RTP_VERSION << 6;
+    buf[1] = (uint8_t)((marker ? 0x80 : 0) | (payload_type & 0x7f));
+    write_u16(buf + 2, sender->seq);
+    write_u32(buf + 4, sender->timestamp);
+    write_u32(buf + 8, sender->ssrc);
+
+    sender->seq++;
+    sender->timestamp += samples;
+    sender->packets++;
+    sender->octets += (uint32_t)payload_len;
+    return RTP_HEADER_SIZE + payload_len;
+}
+
+void rtp_sender_skip(rtp_sender_t *sender, uint32_t samples)
+{
+    sender->timestamp += samples;
+}
+
+void rtp_receiver_init(rtp_receiver_t *receiver)
+{
+    memset(receiver, 0, sizeof(*receiver));
+}
+
+static void start_source(rtp_receiver_t *receiver, const rtp_packet_t *packet, uint32_t arrival)
+{
+    if (receiver->active && receiver->ssrc != packet->ssrc) {
+        receiver->source_changes++;
+    }
+    receiver->active = true;
+    receiver->ssrc = packet->ssrc;
+    receiver->max_seq = packet->seq;
+    receiver->cycles = 0;
+    receiver->base_seq = packet->seq;
+    receiver->bad_seq = RTP_SEQ_MOD + 1;   // Matches no sequence number
+    receiver->received = 0;
+    receiver->transit = (int32_t)(arrival - packet->timestamp);
+    receiver->jitter = 0;
+}
+
+bool rtp_receiver_update(rtp_receiver_t *receiver, const rtp_packet_t *packet, uint32_t arrival)
+{
+    if (!receiver->active || receiver->ssrc != packet->ssrc) {
+        start_source(receiver, packet, arrival);
+    } else {
+        uint16_t udelta = (uint16_t)(packet->seq - receiver->max_seq);
+
+        if (udelta < RTP_MAX_DROPOUT) {
+            // In order, possibly with a gap
+            if (packet->seq < receiver->max_seq) {
+                receiver->cycles += RTP_SEQ_MOD;
+            }
+            receiver->max_seq = packet->seq;
+        } else if (udelta <= RTP_SEQ_MOD - RTP_MAX_MISORDER) {
+            // A large jump: believe it once the following packet agrees
+            if (packet->seq != receiver->bad_seq) {
+                receiver->bad_seq = (packet->seq + 1) & (RTP_SEQ_MOD - 1);
+                return false;
+            }
+            uint32_t source_changes = receiver->source_changes;
+            start_source(receiver, packet, arrival);
+            receiver->source_changes = source_changes;
+        }
+        // Otherwise a duplicate or a late packet
+    }
+    receiver->received++;
+
+    // J += (|D| - J) / 16, kept scaled by 16 (RFC 3550 appendix A.8)
+    int32_t transit = (int32_t)(arrival - packet->timestamp);
+    int32_t d = transit - receiver->transit;
+    receiver->transit = transit;
+    if (d < 0) {
+        d = -d;
+    }
+    receiver->jitter += (uint32_t)d - ((receiver->jitter + 8) >> 4);
+    return true;
+}
+
+uint32_t rtp_receiver_extended_max(const rtp_receiver_t *receiver)
+{
+    return receiver->cycles + receiver->max_seq;
+}
+
+uint32_t rtp_receiver_lost(const rtp_receiver_t *receiver)
+{
+    if (!receiver->active) {
+        return 0;
+    }
+    uint32_t expected = rtp_receiver_extended_max(receiver) - receiver->base_seq + 1;
+    return expected > receiver->received ? expected - receiver->received : 0;
+}
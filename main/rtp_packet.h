@@ -0,0 +1,140 @@
+#ifndef RTP_PACKET_H
+#define RTP_PACKET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Fixed RTP header without CSRCs (RFC 3550 section 5.1)
+ */
+#define RTP_HEADER_SIZE         12
+
+/**
+ * @brief Static payload types of the audio/video profile (RFC 3551)
+ */
+#define RTP_PT_PCMU             0
+#define RTP_PT_PCMA             8
+#define RTP_PT_G722             9
+#define RTP_PT_CN               13      ///< Comfort noise (RFC 3389)
+
+/**
+ * @brief One parsed RTP packet; payload points into the datagram
+ */
+typedef struct {
+    bool marker;
+    uint8_t payload_type;
+    uint16_t seq;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    const uint8_t *payload;
+    size_t payload_len;
+} rtp_packet_t;
+
+/**
+ * @brief Outgoing stream state
+ */
+typedef struct {
+    uint32_t ssrc;
+    uint16_t seq;               ///< Sequence number of the next packet
+    uint32_t timestamp;         ///< Timestamp of the next packet
+    uint32_t packets;           ///< Packets written
+    uint32_t octets;            ///< Payload octets written
+} rtp_sender_t;
+
+/**
+ * @brief Incoming stream state (RFC 3550 appendix A.1 and A.8)
+ */
+typedef struct {
+    bool active;                ///< A source has been seen
+    uint32_t ssrc;
+    uint16_t max_seq;           ///< Highest sequence number seen
+    uint32_t cycles;            ///< Sequence number wraps, shifted left by 16
+    uint32_t base_seq;          ///< First sequence number of the source
+    uint32_t bad_seq;           ///< Next sequence number expected after a jump
+    uint32_t received;          ///< Packets accepted
+    uint32_t source_changes;    ///< SSRC changes after the first source
+    int32_t transit;            ///< Relative transit time of the previous packet
+    uint32_t jitter;            ///< Interarrival jitter in timestamp units, scaled by 16
+} rtp_receiver_t;
+
+/**
+ * @brief Parse and validate a datagram
+ *
+ * Skips CSRCs and a header extension and strips padding.
+ *
+ * @return false if it is not an RTP version 2 packet or is truncated
+ */
+bool rtp_packet_parse(const uint8_t *data, size_t len, rtp_packet_t *packet);
+
+/**
+ * @brief Start an outgoing stream
+ *
+ * RFC 3550 wants ssrc, seq and timestamp to start at random values.
+ */
+void rtp_sender_init(rtp_sender_t *sender, uint32_t ssrc, uint16_t seq, uint32_t timestamp);
+
+/**
+ * @brief Write the header in front of a payload already in place
+ *
+ * The payload is encoded straight into buf + RTP_HEADER_SIZE, so a
+ * packet is built without copying. Advances seq and timestamp.
+ *
+ * @param sender Stream
+ * @param buf Packet buffer, payload at RTP_HEADER_SIZE
+ * @param payload_type Payload type
+ * @param marker Marker bit (first packet of a talkspurt)
+ * @param payload_len Payload bytes at RTP_HEADER_SIZE
+ * @param samples Timestamp units the payload covers
+ * @return Packet length
+ */
+size_t rtp_sender_finish(rtp_sender_t *sender, uint8_t *buf, uint8_t payload_type, bool marker,
+                         size_t payload_len, uint32_t samples);
+
+/**
+ * @brief Account for samples that are not sent, e.g. silence
+ *
+ * Advances the timestamp only, so the receiver sees the gap as a pause
+ * and not as lost packets.
+ */
+void rtp_sender_skip(rtp_sender_t *sender, uint32_t samples);
+
+/**
+ * @brief Reset an incoming stream, e.g. at the start of a call
+ */
+void rtp_receiver_init(rtp_receiver_t *receiver);
+
+/**
+ * @brief Account for a received packet
+ *
+ * A new SSRC restarts the sequence tracking, since PBXs switch the
+ * source when they re-anchor media. A sequence number far from the
+ * expected one is rejected until the next packet confirms the jump.
+ * Late packets are accepted; ordering them is up to the caller.
+ *
+ * @param receiver Stream
+ * @param packet Parsed packet
+ * @param arrival Arrival time in timestamp units, for the jitter estimate
+ * @return true if the packet should be played
+ */
+bool rtp_receiver_update(rtp_receiver_t *receiver, const rtp_packet_t *packet, uint32_t arrival);
+
+/**
+ * @brief Extended highest sequence number received
+ */
+uint32_t rtp_receiver_extended_max(const rtp_receiver_t *receiver);
+
+/**
+ * @brief Packets lost since the stream started (expected minus received, never negative)
+ */
+uint32_t rtp_receiver_lost(const rtp_receiver_t *receiver);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RTP_PACKET_H
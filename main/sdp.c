@@ -0,0 +1,318 @@
+#include "sdp.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Formats of one m= line we look at, further ones are ignored
+#define SDP_MAX_FORMATS         16
+
+static const struct {
+    const char *name;
+    uint8_t payload_type;
+} s_codecs[] = {
+    [SDP_CODEC_PCMU] = { "PCMU", 0 },
+    [SDP_CODEC_PCMA] = { "PCMA", 8 },
+    [SDP_CODEC_G722] = { "G722", 9 },
+    [SDP_CODEC_TELEPHONE_EVENT] = { "telephone-event", SDP_TELEPHONE_EVENT_PT },
+    [SDP_CODEC_CN] = { "CN", 13 },
+};
+
+/**
+ * @brief Audio section being read
+ */
+typedef struct {
+    uint16_t port;
+    uint8_t count;
+    uint8_t payload_types[SDP_MAX_FORMATS];
+    sdp_codec_t codecs[SDP_MAX_FORMATS];
+    uint32_t addr;
+} audio_section_t;
+
+static bool list_has(const sdp_codec_list_t *list, sdp_codec_t codec)
+{
+    for (unsigned i = 0; i < list->count; i++) {
+        if (list->codecs[i] == codec) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static sdp_codec_t codec_by_name(const char *name, size_t len)
+{
+    for (unsigned codec = 0; codec < SDP_CODEC_NONE; codec++) {
+        if (strlen(s_codecs[codec].name) == len && strncasecmp(s_codecs[codec].name, name, len) == 0) {
+            return (sdp_codec_t)codec;
+        }
+    }
+    return SDP_CODEC_NONE;
+}
+
+/**
+ * @brief RFC 3551 static assignment, telephone-event has none
+ */
+static sdp_codec_t codec_by_static_type(unsigned payload_type)
+{
+    for (unsigned codec = 0; codec < SDP_CODEC_NONE; codec++) {
+        if (codec != SDP_CODEC_TELEPHONE_EVENT && s_codecs[codec].payload_type == payload_type) {
+            return (sdp_codec_t)codec;
+        }
+    }
+    return SDP_CODEC_NONE;
+}
+
+bool sdp_parse_codec_list(const char *text, sdp_codec_list_t *list)
+{
+    bool have_audio = false;
+
+    list->count = 0;
+    for (;;) {
+        const char *end = strchr(text, ',');
+        if (end == NULL) {
+            end = text + strlen(text);
+        }
+        const char *name = text;
+        const char *name_end = end;
+        while (name < name_end && isspace((unsigned char)*name)) {
+            name++;
+        }
+        while (name_end > name && isspace((unsigned char)name_end[-1])) {
+            name_end--;
+        }
+
+        sdp_codec_t codec = codec_by_name(name, (size_t)(name_end - name));
+        if (codec == SDP_CODEC_NONE || list_has(list, codec) || list->count == SDP_MAX_CODECS) {
+            return false;
+        }
+        list->codecs[list->count++] = codec;
+        have_audio |= codec != SDP_CODEC_TELEPHONE_EVENT && codec != SDP_CODEC_CN;
+        if (*end != ',') {
+            return have_audio;
+        }
+        text = end + 1;
+    }
+}
+
+uint8_t sdp_codec_payload_type(sdp_codec_t codec)
+{
+    return codec < SDP_CODEC_NONE ? s_codecs[codec].payload_type : 0;
+}
+
+const char *sdp_codec_name(sdp_codec_t codec)
+{
+    return codec < SDP_CODEC_NONE ? s_codecs[codec].name : "none";
+}
+
+/**
+ * @brief Formats and their a= lines of an m= line being written
+ */
+typedef struct {
+    char formats[4 * SDP_MAX_CODECS + 1];
+    char rtpmaps[48 * SDP_MAX_CODECS + 24];
+    size_t formats_len;
+    size_t rtpmaps_len;
+} format_list_t;
+
+static void add_format(format_list_t *list, sdp_codec_t codec, uint8_t payload_type)
+{
+    list->formats_len += snprintf(list->formats + list->formats_len, sizeof(list->formats) - list->formats_len,
+                                  " %u", payload_type);
+    list->rtpmaps_len += snprintf(list->rtpmaps + list->rtpmaps_len, sizeof(list->rtpmaps) - list->rtpmaps_len,
+                                  "a=rtpmap:%u %s/8000\r\n", payload_type, s_codecs[codec].name);
+    if (codec == SDP_CODEC_TELEPHONE_EVENT) {
+        list->rtpmaps_len += snprintf(list->rtpmaps + list->rtpmaps_len,
+                                      sizeof(list->rtpmaps) - list->rtpmaps_len,
+                                      "a=fmtp:%u 0-15\r\n", payload_type);
+    }
+}
+
+static int write_session(char *out, size_t size, const sdp_offer_t *offer, uint32_t version,
+                         const format_list_t *list)
+{
+    return snprintf(out, size,
+                    "v=0\r\n"
+                    "o=%s %lu %lu IN IP4 %s\r\n"
+                    "s=%s\r\n"
+                    "c=IN IP4 %s\r\n"
+                    "t=0 0\r\n"
+                    "m=audio %u RTP/AVP%s\r\n"
+                    "%s"
+                    "a=ptime:20\r\n"
+                    "a=sendrecv\r\n",
+                    offer->username, (unsigned long)offer->session_id, (unsigned long)version,
+                    offer->address, offer->session_name, offer->address, offer->port, list->formats,
+                    list->rtpmaps);
+}
+
+int sdp_write_offer(char *out, size_t size, const sdp_offer_t *offer)
+{
+    format_list_t list = { .formats_len = 0 };
+
+    for (unsigned i = 0; i < offer->codecs->count; i++) {
+        sdp_codec_t codec = offer->codecs->codecs[i];
+        add_format(&list, codec, s_codecs[codec].payload_type);
+    }
+    return write_session(out, size, offer, offer->session_id, &list);
+}
+
+int sdp_write_answer(char *out, size_t size, const sdp_offer_t *session, const sdp_media_t *media)
+{
+    format_list_t list = { .formats_len = 0 };
+
+    add_format(&list, media->codec, media->payload_type);
+    if (media->dtmf_payload_type != 0) {
+        add_format(&list, SDP_CODEC_TELEPHONE_EVENT, media->dtmf_payload_type);
+    }
+    if (media->cn_payload_type != 0) {
+        add_format(&list, SDP_CODEC_CN, media->cn_payload_type);
+    }
+    // Narrower than the offer, so one version on from it (RFC 3264 section 8)
+    return write_session(out, size, session, session->session_id + 1, &list);
+}
+
+/**
+ * @brief Dotted IPv4 address to network order, 0 if malformed
+ */
+static uint32_t parse_ipv4(const char *text)
+{
+    unsigned octets[4];
+    char tail;
+    if (sscanf(text, "%3u.%3u.%3u.%3u%c", &octets[0], &octets[1], &octets[2], &octets[3], &tail) != 4) {
+        return 0;
+    }
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; i++) {
+        if (octets[i] > 255) {
+            return 0;
+        }
+        bytes[i] = (uint8_t)octets[i];
+    }
+    uint32_t addr;
+    memcpy(&addr, bytes, sizeof(addr));
+    return addr;
+}
+
+static void parse_media_line(const char *line, audio_section_t *section)
+{
+    unsigned port = 0;
+    int consumed = 0;
+
+    memset(section, 0, sizeof(*section));
+    if (sscanf(line, "m=audio %u RTP/AVP%n", &port, &consumed) != 1 || consumed == 0 ||
+        port == 0 || port > UINT16_MAX) {
+        return;     // Not audio, or a rejected stream
+    }
+    section->port = (uint16_t)port;
+
+    // Formats follow the protocol, in order of preference
+    for (const char *fmt = line + consumed; section->count < SDP_MAX_FORMATS; ) {
+        char *fmt_end;
+        unsigned long pt = strtoul(fmt, &fmt_end, 10);
+        if (fmt_end == fmt) {
+            break;
+        }
+        if (pt <= 127) {
+            section->payload_types[section->count] = (uint8_t)pt;
+            section->codecs[section->count] = codec_by_static_type((unsigned)pt);
+            section->count++;
+        }
+        fmt = fmt_end;
+    }
+}
+
+static void parse_rtpmap(const char *line, audio_section_t *section)
+{
+    unsigned pt = 0;
+    unsigned clock = 0;
+    char encoding[24];
+
+    if (sscanf(line, "a=rtpmap:%u %23[^/]/%u", &pt, encoding, &clock) != 3) {
+        return;
+    }
+    for (unsigned i = 0; i < section->count; i++) {
+        if (section->payload_types[i] == pt) {
+            // G.722 also runs an 8000 Hz RTP clock, anything else is another codec
+            sdp_codec_t codec = codec_by_name(encoding, strlen(encoding));
+            section->codecs[i] = clock == 8000 ? codec : SDP_CODEC_NONE;
+        }
+    }
+}
+
+/**
+ * @brief Take the codec of a finished audio section, if it has one we offered
+ */
+static bool select_codec(const audio_section_t *section, uint32_t session_addr,
+                         const sdp_codec_list_t *offered, sdp_media_t *media)
+{
+    int audio = -1;
+    int events = -1;
+    int noise = -1;
+
+    for (unsigned i = 0; i < section->count; i++) {
+        sdp_codec_t codec = section->codecs[i];
+        if (codec == SDP_CODEC_NONE || !list_has(offered, codec)) {
+            continue;
+        }
+        if (codec == SDP_CODEC_TELEPHONE_EVENT) {
+            events = events < 0 ? (int)i : events;
+        } else if (codec == SDP_CODEC_CN) {
+            noise = noise < 0 ? (int)i : noise;
+        } else {
+            audio = audio < 0 ? (int)i : audio;
+        }
+    }
+
+    uint32_t addr = section->addr ? section->addr : session_addr;
+    if (section->port == 0 || audio < 0 || addr == 0) {
+        return false;
+    }
+    media->remote_addr = addr;
+    media->remote_port = section->port;
+    media->codec = section->codecs[audio];
+    media->payload_type = section->payload_types[audio];
+    media->dtmf_payload_type = events >= 0 ? section->payload_types[events] : 0;
+    media->cn_payload_type = noise >= 0 ? section->payload_types[noise] : 0;
+    return true;
+}
+
+bool sdp_parse_answer(const char *body, size_t len, const sdp_codec_list_t *offered, sdp_media_t *media)
+{
+    const char *p = body;
+    const char *end = body + len;
+    audio_section_t section = { 0 };
+    bool in_media = false;
+    uint32_t session_addr = 0;
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        const char *next = eol != NULL ? eol + 1 : end;
+        size_t line_len = (size_t)((eol != NULL ? eol : end) - p);
+        char line[128];
+        if (line_len >= sizeof(line)) {
+            line_len = sizeof(line) - 1;
+        }
+        memcpy(line, p, line_len);
+        line[line_len] = '\0';
+        p = next;
+
+        char addr[16];
+        if (strncmp(line, "m=", 2) == 0) {
+            if (in_media && select_codec(&section, session_addr, offered, media)) {
+                return true;
+            }
+            in_media = true;
+            parse_media_line(line, &section);
+        } else if (strncmp(line, "a=rtpmap:", 9) == 0) {
+            parse_rtpmap(line, &section);
+        } else if (sscanf(line, "c=IN IP4 %15[0-9.]", addr) == 1) {
+            if (in_media) {
+                section.addr = parse_ipv4(addr);
+            } else {
+                session_addr = parse_ipv4(addr);
+            }
+        }
+    }
+    return in_media && select_codec(&section, session_addr, offered, media);
+}
@@ -0,0 +1,137 @@
+#ifndef SDP_H
+#define SDP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Most entries of a codec preference list
+ */
+#define SDP_MAX_CODECS              5
+
+/**
+ * @brief Payload type offered for telephone-event, from the dynamic range
+ */
+#define SDP_TELEPHONE_EVENT_PT      101
+
+/**
+ * @brief Preference used when none is configured: wideband first
+ */
+#define SDP_DEFAULT_CODECS          "G722,PCMU,PCMA,telephone-event,CN"
+
+/**
+ * @brief Formats the door station can send and receive
+ */
+typedef enum {
+    SDP_CODEC_PCMU,             ///< G.711 µ-law, static payload type 0
+    SDP_CODEC_PCMA,             ///< G.711 A-law, static payload type 8
+    SDP_CODEC_G722,             ///< G.722 at 64 kbit/s, static payload type 9
+    SDP_CODEC_TELEPHONE_EVENT,  ///< RFC 4733 key presses, dynamic payload type
+    SDP_CODEC_CN,               ///< RFC 3389 comfort noise, static payload type 13
+    SDP_CODEC_NONE
+} sdp_codec_t;
+
+/**
+ * @brief Codecs in order of preference
+ */
+typedef struct {
+    sdp_codec_t codecs[SDP_MAX_CODECS];
+    uint8_t count;
+} sdp_codec_list_t;
+
+/**
+ * @brief Everything that goes into our offer
+ */
+typedef struct {
+    const char *username;       ///< o= user name
+    uint32_t session_id;        ///< o= session id and version
+    const char *session_name;   ///< s= line
+    const char *address;        ///< Dotted IPv4 address for o= and c=
+    uint16_t port;              ///< RTP port
+    const sdp_codec_list_t *codecs;
+} sdp_offer_t;
+
+/**
+ * @brief Audio stream agreed by the answer
+ */
+typedef struct {
+    uint32_t remote_addr;       ///< IPv4 address (network order)
+    uint16_t remote_port;
+    sdp_codec_t codec;          ///< Audio codec, never telephone-event or CN
+    uint8_t payload_type;       ///< Payload type the answer maps the codec to
+    uint8_t dtmf_payload_type;  ///< telephone-event payload type, 0 if the answer has none
+    uint8_t cn_payload_type;    ///< Comfort noise payload type, 0 if the answer has none
+} sdp_media_t;
+
+/**
+ * @brief Parse a comma-separated preference list
+ *
+ * Names are PCMU, PCMA, G722, telephone-event and CN, case-insensitive;
+ * spaces around them are ignored.
+ *
+ * @return false for an unknown or repeated name, a list without an audio
+ *         codec or more than SDP_MAX_CODECS entries
+ */
+bool sdp_parse_codec_list(const char *text, sdp_codec_list_t *list);
+
+/**
+ * @brief Payload type we offer a codec with
+ */
+uint8_t sdp_codec_payload_type(sdp_codec_t codec);
+
+/**
+ * @brief Encoding name as in a=rtpmap
+ */
+const char *sdp_codec_name(sdp_codec_t codec);
+
+/**
+ * @brief Write the offer
+ *
+ * The m= line lists the codecs in order of preference, each with its
+ * a=rtpmap. G.722 is announced with an 8000 Hz clock as RFC 3551
+ * requires, although it samples at 16 kHz.
+ *
+ * @return Length as snprintf(), not counting the NUL
+ */
+int sdp_write_offer(char *out, size_t size, const sdp_offer_t *offer);
+
+/**
+ * @brief Write an answer that keeps the agreed stream
+ *
+ * For a re-INVITE in an established call: the m= line carries only the
+ * codec, telephone-event and comfort noise formats of media, with the
+ * payload types the far end uses for them. The o= version is one above
+ * the offer's.
+ *
+ * @param session Session lines as for the offer; its codecs are not used
+ * @return Length as snprintf(), not counting the NUL
+ */
+int sdp_write_answer(char *out, size_t size, const sdp_offer_t *session, const sdp_media_t *media);
+
+/**
+ * @brief Pick the audio stream from an answer
+ *
+ * Payload types are mapped through the a=rtpmap lines of the answer,
+ * falling back to the static assignments of RFC 3551, so a dynamic
+ * number for a known codec is followed too. The codec is the first
+ * format of the first usable audio m= line that was offered. A c= line
+ * in the media section overrides the session one.
+ *
+ * @param body SDP text, need not be NUL-terminated
+ * @param len Length of body
+ * @param offered Codecs of our offer
+ * @param media Filled on success
+ * @return false if the answer has no usable audio stream
+ */
+bool sdp_parse_answer(const char *body, size_t len, const sdp_codec_list_t *offered, sdp_media_t *media);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDP_H
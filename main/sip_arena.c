@@ -0,0 +1,146 @@
+#include "sip_arena.h"
+#include <string.h>
+
+_Static_assert(SIP_ARENA_BLOCK_SIZE % SIP_ARENA_ALIGN == 0, "blocks must keep allocations aligned");
+_Static_assert((uint32_t)SIP_ARENA_BLOCK_SIZE * SIP_ARENA_MAX_BLOCKS <= UINT16_MAX + 1u,
+               "run offsets are 16 bits");
+
+static bool block_used(const sip_arena_pool_t *pool, unsigned block)
+{
+    return (pool->used_map[block / 32] >> (block % 32)) & 1;
+}
+
+static void mark_blocks(sip_arena_pool_t *pool, unsigned first, unsigned count, bool used)
+{
+    for (unsigned block = first; block < first + count; block++) {
+        if (used) {
+            pool->used_map[block / 32] |= 1u << (block % 32);
+        } else {
+            pool->used_map[block / 32] &= ~(1u << (block % 32));
+        }
+    }
+    if (used) {
+        pool->blocks_used += count;
+        if (pool->blocks_used > pool->peak_blocks) {
+            pool->peak_blocks = pool->blocks_used;
+        }
+    } else {
+        pool->blocks_used -= count;
+    }
+}
+
+static bool blocks_free(const sip_arena_pool_t *pool, unsigned first, unsigned count)
+{
+    if (first + count > pool->block_count) {
+        return false;
+    }
+    for (unsigned block = first; block < first + count; block++) {
+        if (block_used(pool, block)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief First fit for a run of free blocks, -1 if none is long enough
+ */
+static int find_run(const sip_arena_pool_t *pool, unsigned count)
+{
+    unsigned run = 0;
+    for (unsigned block = 0; block < pool->block_count; block++) {
+        run = block_used(pool, block) ? 0 : run + 1;
+        if (run == count) {
+            return (int)(block + 1 - count);
+        }
+    }
+    return -1;
+}
+
+void sip_arena_pool_init(sip_arena_pool_t *pool, void *storage, size_t size)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->storage = (uint8_t *)storage;
+    size_t blocks = size / SIP_ARENA_BLOCK_SIZE;
+    pool->block_count = (uint16_t)(blocks > SIP_ARENA_MAX_BLOCKS ? SIP_ARENA_MAX_BLOCKS : blocks);
+}
+
+void sip_arena_pool_get_stats(const sip_arena_pool_t *pool, sip_arena_pool_stats_t *stats)
+{
+    stats->size = (uint32_t)pool->block_count * SIP_ARENA_BLOCK_SIZE;
+    stats->in_use = (uint32_t)pool->blocks_used * SIP_ARENA_BLOCK_SIZE;
+    stats->peak = (uint32_t)pool->peak_blocks * SIP_ARENA_BLOCK_SIZE;
+    stats->largest_arena = pool->largest_arena;
+    stats->failures = pool->failures;
+}
+
+void sip_arena_init(sip_arena_t *arena, sip_arena_pool_t *pool)
+{
+    memset(arena, 0, sizeof(*arena));
+    arena->pool = pool;
+}
+
+void *sip_arena_alloc(sip_arena_t *arena, size_t size)
+{
+    sip_arena_pool_t *pool = arena->pool;
+    size_t aligned = (size + SIP_ARENA_ALIGN - 1) & ~(size_t)(SIP_ARENA_ALIGN - 1);
+
+    if (size == 0 || aligned > (size_t)pool->block_count * SIP_ARENA_BLOCK_SIZE) {
+        pool->failures++;
+        return NULL;
+    }
+
+    unsigned last = arena->runs - 1u;
+    if (arena->runs == 0 ||
+        arena->offset + aligned > (size_t)arena->run_blocks[last] * SIP_ARENA_BLOCK_SIZE) {
+        unsigned spare = arena->runs ? arena->run_blocks[last] * SIP_ARENA_BLOCK_SIZE - arena->offset : 0;
+        unsigned grow = (unsigned)((aligned - spare + SIP_ARENA_BLOCK_SIZE - 1) / SIP_ARENA_BLOCK_SIZE);
+        unsigned end = arena->runs ? arena->run_first[last] + arena->run_blocks[last] : 0;
+
+        if (arena->runs && blocks_free(pool, end, grow)) {
+            // The blocks after the last run are free: extend it in place
+            mark_blocks(pool, end, grow, true);
+            arena->run_blocks[last] += grow;
+        } else {
+            unsigned count = (unsigned)((aligned + SIP_ARENA_BLOCK_SIZE - 1) / SIP_ARENA_BLOCK_SIZE);
+            int first = arena->runs < SIP_ARENA_MAX_RUNS ? find_run(pool, count) : -1;
+            if (first < 0) {
+                pool->failures++;
+                return NULL;
+            }
+            mark_blocks(pool, (unsigned)first, count, true);
+            last = arena->runs++;
+            arena->run_first[last] = (uint8_t)first;
+            arena->run_blocks[last] = (uint8_t)count;
+            arena->offset = 0;
+        }
+    }
+
+    void *ptr = pool->storage + (size_t)arena->run_first[last] * SIP_ARENA_BLOCK_SIZE + arena->offset;
+    arena->offset += (uint16_t)aligned;
+    arena->bytes += (uint32_t)aligned;
+    if (arena->bytes > pool->largest_arena) {
+        pool->largest_arena = arena->bytes;
+    }
+    return ptr;
+}
+
+char *sip_arena_strndup(sip_arena_t *arena, const char *str, size_t len)
+{
+    char *copy = sip_arena_alloc(arena, len + 1);
+    if (copy != NULL) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+void sip_arena_release(sip_arena_t *arena)
+{
+    for (unsigned i = 0; i < arena->runs; i++) {
+        mark_blocks(arena->pool, arena->run_first[i], arena->run_blocks[i], false);
+    }
+    arena->runs = 0;
+    arena->offset = 0;
+    arena->bytes = 0;
+}
@@ -0,0 +1,123 @@
+#ifndef SIP_ARENA_H
+#define SIP_ARENA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Granularity of the backing pools
+ */
+#ifndef SIP_ARENA_BLOCK_SIZE
+#define SIP_ARENA_BLOCK_SIZE    128
+#endif
+
+/**
+ * @brief Most blocks one pool manages
+ */
+#define SIP_ARENA_MAX_BLOCKS    255
+
+/**
+ * @brief Separate block runs one arena may hold
+ */
+#define SIP_ARENA_MAX_RUNS      4
+
+/**
+ * @brief Alignment of every allocation
+ */
+#define SIP_ARENA_ALIGN         4
+
+/**
+ * @brief Static backing storage of a pool of the given size in bytes
+ */
+#define SIP_ARENA_POOL_STORAGE(name, size) \
+    uint32_t name[((size) + sizeof(uint32_t) - 1) / sizeof(uint32_t)]
+
+/**
+ * @brief Fixed-size blocks carved from static storage
+ *
+ * Arenas take contiguous runs of blocks and return all of them at once,
+ * so the pool never touches the heap and cannot fragment it.
+ */
+typedef struct {
+    uint8_t *storage;
+    uint16_t block_count;
+    uint16_t blocks_used;
+    uint16_t peak_blocks;               ///< Most blocks in use at once
+    uint32_t largest_arena;             ///< Most bytes one arena held between releases
+    uint32_t failures;                  ///< Allocations that found no room
+    uint32_t used_map[(SIP_ARENA_MAX_BLOCKS + 31) / 32];
+} sip_arena_pool_t;
+
+/**
+ * @brief Pool counters
+ */
+typedef struct {
+    uint32_t size;                      ///< Bytes the pool manages
+    uint32_t in_use;                    ///< Bytes held by arenas now
+    uint32_t peak;                      ///< Most bytes held at once
+    uint32_t largest_arena;             ///< Most bytes one arena held between releases
+    uint32_t failures;                  ///< Allocations that found no room
+} sip_arena_pool_stats_t;
+
+/**
+ * @brief Bump allocator for one transaction or dialog
+ *
+ * Allocations are never freed one by one: sip_arena_release() returns
+ * every block when the owner terminates.
+ */
+typedef struct {
+    sip_arena_pool_t *pool;
+    uint8_t run_first[SIP_ARENA_MAX_RUNS];
+    uint8_t run_blocks[SIP_ARENA_MAX_RUNS];
+    uint8_t runs;
+    uint16_t offset;                    ///< Bytes used in the last run
+    uint32_t bytes;                     ///< Bytes allocated since the last release
+} sip_arena_t;
+
+/**
+ * @brief Set up a pool over static storage
+ *
+ * @param storage Backing storage, aligned to SIP_ARENA_ALIGN
+ * @param size Size of storage, whole blocks beyond SIP_ARENA_MAX_BLOCKS are unused
+ */
+void sip_arena_pool_init(sip_arena_pool_t *pool, void *storage, size_t size);
+
+/**
+ * @brief Copy the pool counters
+ */
+void sip_arena_pool_get_stats(const sip_arena_pool_t *pool, sip_arena_pool_stats_t *stats);
+
+/**
+ * @brief Set up an empty arena drawing from a pool
+ */
+void sip_arena_init(sip_arena_t *arena, sip_arena_pool_t *pool);
+
+/**
+ * @brief Allocate from the arena
+ *
+ * @return Memory aligned to SIP_ARENA_ALIGN, NULL if the pool has no room
+ */
+void *sip_arena_alloc(sip_arena_t *arena, size_t size);
+
+/**
+ * @brief Copy a string of the given length into the arena, NUL-terminated
+ *
+ * @return The copy, NULL if the pool has no room
+ */
+char *sip_arena_strndup(sip_arena_t *arena, const char *str, size_t len);
+
+/**
+ * @brief Return every block of the arena to its pool
+ */
+void sip_arena_release(sip_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIP_ARENA_H
@@ -0,0 +1,362 @@
+#include "sip_digest.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "mbedtls/md.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "sip_digest";
+
+#define MAX_HASH_SIZE   32
+
+/**
+ * @brief Parameters of one Digest challenge, as spans into the response
+ */
+typedef struct {
+    bool usable;
+    sip_digest_algorithm_t algorithm;
+    bool qop_auth;
+    bool stale;
+    sip_span_t realm;
+    sip_span_t nonce;
+    sip_span_t opaque;
+} challenge_t;
+
+static const char *algorithm_name(sip_digest_algorithm_t algorithm)
+{
+    return algorithm == SIP_DIGEST_SHA256 ? "SHA-256" : "MD5";
+}
+
+/**
+ * @brief Hash "part0:part1:...:partN" and write it as lowercase hex
+ */
+static esp_err_t hash_parts(sip_digest_algorithm_t algorithm, const char *const *parts, size_t count,
+                            char *out, size_t size)
+{
+    static const char hex[] = "0123456789abcdef";
+    const mbedtls_md_info_t *info = mbedtls_md_info_from_type(
+        algorithm == SIP_DIGEST_SHA256 ? MBEDTLS_MD_SHA256 : MBEDTLS_MD_MD5);
+    if (info == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    size_t hash_len = mbedtls_md_get_size(info);
+    if (size < hash_len * 2 + 1) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    unsigned char hash[MAX_HASH_SIZE];
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    int ret = mbedtls_md_setup(&ctx, info, 0);
+    if (ret == 0) {
+        ret = mbedtls_md_starts(&ctx);
+    }
+    for (size_t i = 0; i < count && ret == 0; i++) {
+        if (i > 0) {
+            ret = mbedtls_md_update(&ctx, (const unsigned char *)":", 1);
+        }
+        if (ret == 0) {
+            ret = mbedtls_md_update(&ctx, (const unsigned char *)parts[i], strlen(parts[i]));
+        }
+    }
+    if (ret == 0) {
+        ret = mbedtls_md_finish(&ctx, hash);
+    }
+    mbedtls_md_free(&ctx);
+    if (ret != 0) {
+        return ESP_FAIL;
+    }
+
+    for (size_t i = 0; i < hash_len; i++) {
+        out[i * 2] = hex[hash[i] >> 4];
+        out[i * 2 + 1] = hex[hash[i] & 0x0f];
+    }
+    out[hash_len * 2] = '\0';
+    return ESP_OK;
+}
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/**
+ * @brief Check whether a comma separated qop list offers "auth"
+ */
+static bool qop_offers_auth(const char *p, size_t len)
+{
+    size_t i = 0;
+    while (i < len) {
+        while (i < len && (is_space(p[i]) || p[i] == ',')) {
+            i++;
+        }
+        size_t start = i;
+        while (i < len && p[i] != ',' && !is_space(p[i])) {
+            i++;
+        }
+        if (i - start == 4 && strncasecmp(p + start, "auth", 4) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Parse 'Digest name=value, name="value", ...'
+ */
+static void parse_challenge(const sip_message_t *msg, sip_span_t value, challenge_t *ch)
+{
+    const char *p = sip_span_ptr(msg, value);
+    size_t len = value.len;
+    size_t i = 0;
+
+    memset(ch, 0, sizeof(*ch));
+    if (len < 7 || strncasecmp(p, "Digest", 6) != 0 || !is_space(p[6])) {
+        return;
+    }
+    i = 7;
+    ch->usable = true;
+
+    while (i < len) {
+        while (i < len && (is_space(p[i]) || p[i] == ',')) {
+            i++;
+        }
+        size_t name_start = i;
+        while (i < len && p[i] != '=' && p[i] != ',' && !is_space(p[i])) {
+            i++;
+        }
+        size_t name_len = i - name_start;
+        while (i < len && is_space(p[i])) {
+            i++;
+        }
+        if (i >= len || p[i] != '=') {
+            continue;
+        }
+        i++;
+        while (i < len && is_space(p[i])) {
+            i++;
+        }
+
+        size_t val_start;
+        size_t val_len;
+        if (i < len && p[i] == '"') {
+            val_start = ++i;
+            while (i < len && p[i] != '"') {
+                if (p[i] == '\\' && i + 1 < len) {
+                    i++;
+                }
+                i++;
+            }
+            val_len = i - val_start;
+            if (i < len) {
+                i++;
+            }
+        } else {
+            val_start = i;
+            while (i < len && p[i] != ',' && !is_space(p[i])) {
+                i++;
+            }
+            val_len = i - val_start;
+        }
+
+        const char *name = p + name_start;
+        sip_span_t span = { .off = (uint16_t)(value.off + val_start), .len = (uint16_t)val_len };
+        if (name_len == 5 && strncasecmp(name, "realm", 5) == 0) {
+            ch->realm = span;
+        } else if (name_len == 5 && strncasecmp(name, "nonce", 5) == 0) {
+            ch->nonce = span;
+        } else if (name_len == 6 && strncasecmp(name, "opaque", 6) == 0) {
+            ch->opaque = span;
+        } else if (name_len == 3 && strncasecmp(name, "qop", 3) == 0) {
+            ch->qop_auth = qop_offers_auth(p + val_start, val_len);
+        } else if (name_len == 5 && strncasecmp(name, "stale", 5) == 0) {
+            ch->stale = sip_span_equals_nocase(msg, span, "true");
+        } else if (name_len == 9 && strncasecmp(name, "algorithm", 9) == 0) {
+            if (sip_span_equals_nocase(msg, span, "MD5")) {
+                ch->algorithm = SIP_DIGEST_MD5;
+            } else if (sip_span_equals_nocase(msg, span, "SHA-256")) {
+                ch->algorithm = SIP_DIGEST_SHA256;
+            } else {
+                ch->usable = false;  // -sess and SHA-512-256 are not supported
+            }
+        }
+    }
+
+    if (ch->nonce.len == 0) {
+        ch->usable = false;
+    }
+}
+
+esp_err_t sip_digest_init(sip_digest_t *digest, const char *username, const char *password)
+{
+    if (digest == NULL || username == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(digest, 0, sizeof(*digest));
+    strncpy(digest->username, username, sizeof(digest->username) - 1);
+    if (password != NULL) {
+        strncpy(digest->password, password, sizeof(digest->password) - 1);
+    }
+    return ESP_OK;
+}
+
+void sip_digest_clear_challenge(sip_digest_t *digest)
+{
+    digest->has_challenge = false;
+    digest->nonce[0] = '\0';
+    digest->nonce_count = 0;
+}
+
+esp_err_t sip_digest_handle_challenge(sip_digest_t *digest, const sip_message_t *msg, bool *stale)
+{
+    if (digest == NULL || msg == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    challenge_t best = {0};
+    bool best_proxy = false;
+
+    for (uint8_t i = 0; i < msg->header_count; i++) {
+        const sip_header_t *header = &msg->headers[i];
+        if (header->id != SIP_HDR_WWW_AUTHENTICATE && header->id != SIP_HDR_PROXY_AUTHENTICATE) {
+            continue;
+        }
+        challenge_t ch;
+        parse_challenge(msg, header->value, &ch);
+        if (!ch.usable) {
+            continue;
+        }
+        if (!best.usable || (ch.algorithm == SIP_DIGEST_SHA256 && best.algorithm != SIP_DIGEST_SHA256)) {
+            best = ch;
+            best_proxy = header->id == SIP_HDR_PROXY_AUTHENTICATE;
+        }
+    }
+
+    if (!best.usable) {
+        ESP_LOGW(TAG, "No supported Digest challenge");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    char nonce[sizeof(digest->nonce)];
+    char realm[sizeof(digest->realm)];
+    if (sip_span_copy(msg, best.nonce, nonce, sizeof(nonce)) != ESP_OK ||
+        sip_span_copy(msg, best.realm, realm, sizeof(realm)) != ESP_OK) {
+        ESP_LOGW(TAG, "Challenge realm or nonce too long");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (strcmp(nonce, digest->nonce) != 0) {
+        digest->nonce_count = 0;
+    }
+    strcpy(digest->nonce, nonce);
+    strcpy(digest->realm, realm);
+    if (sip_span_copy(msg, best.opaque, digest->opaque, sizeof(digest->opaque)) != ESP_OK) {
+        digest->opaque[0] = '\0';
+    }
+    digest->algorithm = best.algorithm;
+    digest->qop_auth = best.qop_auth;
+    digest->proxy = best_proxy;
+    digest->has_challenge = true;
+
+    if (stale != NULL) {
+        *stale = best.stale;
+    }
+    ESP_LOGD(TAG, "Challenge realm=%s algorithm=%s%s", digest->realm,
+             algorithm_name(digest->algorithm), best.stale ? " (stale)" : "");
+    return ESP_OK;
+}
+
+/**
+ * @brief HA1 = H(username:realm:password), recomputed only when realm or algorithm change
+ */
+static esp_err_t ensure_ha1(sip_digest_t *digest)
+{
+    if (digest->has_ha1 && digest->ha1_algorithm == digest->algorithm &&
+        strcmp(digest->ha1_realm, digest->realm) == 0) {
+        return ESP_OK;
+    }
+
+    const char *parts[] = { digest->username, digest->realm, digest->password };
+    esp_err_t ret = hash_parts(digest->algorithm, parts, 3, digest->ha1, sizeof(digest->ha1));
+    if (ret != ESP_OK) {
+        digest->has_ha1 = false;
+        return ret;
+    }
+    strcpy(digest->ha1_realm, digest->realm);
+    digest->ha1_algorithm = digest->algorithm;
+    digest->has_ha1 = true;
+    digest->ha1_computations++;
+    return ESP_OK;
+}
+
+esp_err_t sip_digest_compute(sip_digest_algorithm_t algorithm, const char *ha1,
+                             const char *nonce, const char *nc, const char *cnonce,
+                             const char *qop, const char *method, const char *uri,
+                             char *out, size_t size)
+{
+    char ha2[65];
+    const char *a2[] = { method, uri };
+    esp_err_t ret = hash_parts(algorithm, a2, 2, ha2, sizeof(ha2));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (qop != NULL) {
+        const char *parts[] = { ha1, nonce, nc, cnonce, qop, ha2 };
+        return hash_parts(algorithm, parts, 6, out, size);
+    }
+    const char *parts[] = { ha1, nonce, ha2 };
+    return hash_parts(algorithm, parts, 3, out, size);
+}
+
+esp_err_t sip_digest_authorize(sip_digest_t *digest, sip_method_t method, const char *uri,
+                               char *out, size_t size)
+{
+    if (digest == NULL || uri == NULL || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!digest->has_challenge) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ensure_ha1(digest);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    char nc[9];
+    char cnonce[9];
+    char response[65];
+    digest->nonce_count++;
+    snprintf(nc, sizeof(nc), "%08lx", (unsigned long)digest->nonce_count);
+    snprintf(cnonce, sizeof(cnonce), "%08lx", (unsigned long)esp_random());
+
+    ret = sip_digest_compute(digest->algorithm, digest->ha1, digest->nonce, nc, cnonce,
+                             digest->qop_auth ? "auth" : NULL, sip_method_name(method), uri,
+                             response, sizeof(response));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    int n = snprintf(out, size,
+                     "%s: Digest username=\"%s\", realm=\"%s\", nonce=\"%s\", uri=\"%s\", "
+                     "response=\"%s\", algorithm=%s",
+                     digest->proxy ? "Proxy-Authorization" : "Authorization",
+                     digest->username, digest->realm, digest->nonce, uri,
+                     response, algorithm_name(digest->algorithm));
+    if (n > 0 && (size_t)n < size && digest->qop_auth) {
+        n += snprintf(out + n, size - n, ", cnonce=\"%s\", qop=auth, nc=%s", cnonce, nc);
+    }
+    if (n > 0 && (size_t)n < size && digest->opaque[0]) {
+        n += snprintf(out + n, size - n, ", opaque=\"%s\"", digest->opaque);
+    }
+    if (n > 0 && (size_t)n < size) {
+        n += snprintf(out + n, size - n, "\r\n");
+    }
+    if (n < 0 || (size_t)n >= size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
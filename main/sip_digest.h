@@ -0,0 +1,105 @@
+#ifndef SIP_DIGEST_H
+#define SIP_DIGEST_H
+
+#include "esp_err.h"
+#include "sip_message.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Digest algorithms (RFC 3261 / RFC 8760)
+ */
+typedef enum {
+    SIP_DIGEST_MD5,
+    SIP_DIGEST_SHA256
+} sip_digest_algorithm_t;
+
+/**
+ * @brief Digest credentials plus the cached challenge
+ *
+ * HA1 only depends on the credentials and the realm, so it is computed
+ * once per realm. The last nonce is kept and reused with an increasing
+ * nonce-count, letting later requests carry credentials up front.
+ */
+typedef struct {
+    char username[32];
+    char password[64];
+
+    // Cached challenge
+    bool has_challenge;
+    bool proxy;                         ///< Challenge came in a 407
+    bool qop_auth;                      ///< Server offered qop=auth
+    sip_digest_algorithm_t algorithm;
+    char realm[64];
+    char nonce[128];
+    char opaque[64];
+    uint32_t nonce_count;
+
+    // Cached HA1 for realm/algorithm
+    bool has_ha1;
+    sip_digest_algorithm_t ha1_algorithm;
+    char ha1_realm[64];
+    char ha1[65];
+    uint32_t ha1_computations;
+} sip_digest_t;
+
+/**
+ * @brief Set the credentials and drop any cached state
+ */
+esp_err_t sip_digest_init(sip_digest_t *digest, const char *username, const char *password);
+
+/**
+ * @brief Forget the cached nonce (the HA1 stays valid)
+ */
+void sip_digest_clear_challenge(sip_digest_t *digest);
+
+/**
+ * @brief Take the challenge from a 401/407 response
+ *
+ * If several challenges are offered, SHA-256 is preferred over MD5.
+ *
+ * @param digest Digest state
+ * @param msg 401 or 407 response
+ * @param stale Set to true if the server only rejected an outdated nonce (optional)
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if no usable challenge is present
+ */
+esp_err_t sip_digest_handle_challenge(sip_digest_t *digest, const sip_message_t *msg, bool *stale);
+
+/**
+ * @brief Build the Authorization (or Proxy-Authorization) header line
+ *
+ * Uses the next nonce-count for the cached nonce.
+ *
+ * @param digest Digest state with a cached challenge
+ * @param method Request method
+ * @param uri Request-URI
+ * @param out Buffer for the header line including CRLF
+ * @param size Size of out
+ * @return ESP_OK, ESP_ERR_INVALID_STATE without a challenge,
+ *         ESP_ERR_INVALID_SIZE if out is too small
+ */
+esp_err_t sip_digest_authorize(sip_digest_t *digest, sip_method_t method, const char *uri,
+                               char *out, size_t size);
+
+/**
+ * @brief Compute a digest response (exposed for tests)
+ *
+ * response = H(HA1:nonce[:nc:cnonce:qop]:H(method:uri))
+ *
+ * @param out Hex string, 33 bytes for MD5 or 65 for SHA-256
+ */
+esp_err_t sip_digest_compute(sip_digest_algorithm_t algorithm, const char *ha1,
+                             const char *nonce, const char *nc, const char *cnonce,
+                             const char *qop, const char *method, const char *uri,
+                             char *out, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIP_DIGEST_H
@@ -0,0 +1,881 @@
+#include "sip_dns.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "lwip/dns.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+static const char *TAG = "sip_dns";
+
+#define SIP_DNS_PORT                    53
+#define SIP_DNS_DEFAULT_TIMEOUT_MS      2000
+#define SIP_DNS_ATTEMPTS                2
+#define SIP_DNS_DEFAULT_MIN_TTL_SEC     30
+#define SIP_DNS_MAX_TTL_SEC             86400
+#define SIP_DNS_REFRESH_PERCENT         75      // Refresh once this much of the TTL is used up
+#define SIP_DNS_RETRY_SEC               30      // After a failed refresh
+#define SIP_DNS_POLL_MS                 1000
+#define SIP_DNS_TASK_STACK_SIZE         4096
+#define SIP_DNS_TASK_PRIORITY           3
+#define SIP_DNS_STOP_WAIT_MS            (SIP_DNS_POLL_MS * 2)
+
+#define SIP_DNS_MSG_SIZE                512     // Plain UDP DNS, no EDNS
+#define SIP_DNS_NAME_LEN                128
+#define SIP_DNS_MAX_SRV                 8
+#define SIP_DNS_MAX_JUMPS               16
+
+#define DNS_TYPE_A                      1
+#define DNS_TYPE_SRV                    33
+#define DNS_TYPE_NAPTR                  35
+#define DNS_CLASS_IN                    1
+#define DNS_FLAG_RD                     0x0100
+#define DNS_FLAG_QR                     0x8000
+#define DNS_FLAG_TC                     0x0200
+#define DNS_RCODE_NXDOMAIN              3
+
+/**
+ * @brief Cached servers of one domain
+ */
+typedef struct {
+    bool used;
+    sip_dns_transport_t transport;
+    uint16_t default_port;
+    char domain[64];
+    int64_t refresh_at_us;
+    int64_t expires_at_us;
+    int64_t last_used_us;
+    sip_dns_result_t result;
+} sip_dns_entry_t;
+
+/**
+ * @brief SRV record plus the address found for its target
+ */
+typedef struct {
+    uint16_t priority;
+    uint16_t weight;
+    uint16_t port;
+    uint32_t addr;
+    char target[SIP_DNS_NAME_LEN];
+} sip_dns_srv_t;
+
+/**
+ * @brief Resource record header as seen by the parser
+ */
+typedef struct {
+    char name[SIP_DNS_NAME_LEN];
+    uint16_t type;
+    uint32_t ttl;
+    size_t rdata;
+    uint16_t rdlen;
+    bool additional;
+} sip_dns_rr_t;
+
+typedef void (*sip_dns_rr_handler_t)(const uint8_t *msg, size_t len, const sip_dns_rr_t *rr, void *ctx);
+
+static struct {
+    bool initialized;
+    bool task_running;
+    TaskHandle_t task;
+    SemaphoreHandle_t lock;         ///< Cache, config and counters
+    SemaphoreHandle_t query_lock;   ///< One resolution at a time; owns the buffers below
+    sip_dns_config_t config;
+    sip_dns_entry_t cache[SIP_DNS_CACHE_SIZE];
+    sip_dns_stats_t stats;
+
+    uint8_t msg[SIP_DNS_MSG_SIZE];
+    sip_dns_srv_t srv[SIP_DNS_MAX_SRV];
+    uint8_t srv_count;
+} s_dns;
+
+static const char *const naptr_services[] = {
+    [SIP_DNS_TRANSPORT_UDP] = "SIP+D2U",
+    [SIP_DNS_TRANSPORT_TCP] = "SIP+D2T",
+    [SIP_DNS_TRANSPORT_TLS] = "SIPS+D2T",
+};
+
+static const char *const srv_prefixes[] = {
+    [SIP_DNS_TRANSPORT_UDP] = "_sip._udp",
+    [SIP_DNS_TRANSPORT_TCP] = "_sip._tcp",
+    [SIP_DNS_TRANSPORT_TLS] = "_sips._tcp",
+};
+
+static uint16_t read_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t read_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t min_u32(uint32_t a, uint32_t b)
+{
+    return a < b ? a : b;
+}
+
+/**
+ * @brief Read a possibly compressed name
+ *
+ * @return Offset just past the name at its original position, 0 on malformed input
+ */
+static size_t read_name(const uint8_t *msg, size_t len, size_t off, char *out, size_t size)
+{
+    size_t end = 0;
+    size_t used = 0;
+    int jumps = 0;
+
+    out[0] = '\0';
+    while (off < len) {
+        uint8_t label = msg[off];
+        if (label == 0) {
+            return end ? end : off + 1;
+        }
+        if ((label & 0xC0) == 0xC0) {
+            if (off + 1 >= len || ++jumps > SIP_DNS_MAX_JUMPS) {
+                return 0;
+            }
+            if (end == 0) {
+                end = off + 2;
+            }
+            off = ((label & 0x3F) << 8) | msg[off + 1];
+            continue;
+        }
+        if ((label & 0xC0) != 0 || off + 1 + label > len || used + label + 2 > size) {
+            return 0;
+        }
+        if (used > 0) {
+            out[used++] = '.';
+        }
+        memcpy(out + used, msg + off + 1, label);
+        used += label;
+        out[used] = '\0';
+        off += 1 + label;
+    }
+    return 0;
+}
+
+/**
+ * @brief Read a <character-string>
+ *
+ * @return Offset past the string, 0 on malformed input
+ */
+static size_t read_string(const uint8_t *msg, size_t end, size_t off, char *out, size_t size)
+{
+    if (off >= end || off + 1 + msg[off] > end) {
+        return 0;
+    }
+    size_t n = msg[off];
+    size_t copy = n < size - 1 ? n : size - 1;
+    memcpy(out, msg + off + 1, copy);
+    out[copy] = '\0';
+    return off + 1 + n;
+}
+
+/**
+ * @brief Encode a query for name/type into s_dns.msg
+ *
+ * @return Message length, 0 if the name does not fit
+ */
+static size_t build_query(uint16_t id, const char *name, uint16_t type)
+{
+    uint8_t *p = s_dns.msg;
+    size_t off = 12;
+
+    memset(p, 0, 12);
+    p[0] = id >> 8;
+    p[1] = id & 0xFF;
+    p[2] = DNS_FLAG_RD >> 8;
+    p[5] = 1;   // QDCOUNT
+
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        size_t label = dot ? (size_t)(dot - name) : strlen(name);
+        if (label == 0 || label > 63 || off + label + 1 + 5 > SIP_DNS_MSG_SIZE) {
+            return 0;
+        }
+        p[off++] = (uint8_t)label;
+        memcpy(p + off, name, label);
+        off += label;
+        name += label;
+        if (*name == '.') {
+            name++;
+        }
+    }
+    p[off++] = 0;
+    p[off++] = type >> 8;
+    p[off++] = type & 0xFF;
+    p[off++] = 0;
+    p[off++] = DNS_CLASS_IN;
+    return off;
+}
+
+static uint32_t default_server(void)
+{
+    const ip_addr_t *server = dns_getserver(0);
+    if (server == NULL || !IP_IS_V4(server)) {
+        return 0;
+    }
+    return ip4_addr_get_u32(ip_2_ip4(server));
+}
+
+/**
+ * @brief Send a query and wait for its answer in s_dns.msg; caller holds query_lock
+ */
+static esp_err_t dns_exchange(const char *name, uint16_t type, size_t *resp_len)
+{
+    sip_dns_config_t config;
+    xSemaphoreTake(s_dns.lock, portMAX_DELAY);
+    config = s_dns.config;
+    s_dns.stats.queries++;
+    xSemaphoreGive(s_dns.lock);
+
+    struct sockaddr_in server = {
+        .sin_family = AF_INET,
+        .sin_port = htons(config.server_port ? config.server_port : SIP_DNS_PORT),
+        .sin_addr.s_addr = config.server_addr ? config.server_addr : default_server()
+    };
+    if (server.sin_addr.s_addr == 0) {
+        ESP_LOGW(TAG, "No DNS server configured");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint16_t id = (uint16_t)esp_random();
+    size_t query_len = build_query(id, name, type);
+    if (query_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        return ESP_FAIL;
+    }
+
+    // The query is rebuilt for every attempt since a stray datagram may overwrite the buffer
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    uint32_t timeout_ms = config.timeout_ms ? config.timeout_ms : SIP_DNS_DEFAULT_TIMEOUT_MS;
+    for (int attempt = 0; attempt < SIP_DNS_ATTEMPTS && ret == ESP_ERR_TIMEOUT; attempt++) {
+        build_query(id, name, type);
+        if (sendto(sock, s_dns.msg, query_len, 0, (struct sockaddr *)&server, sizeof(server)) < 0) {
+            ret = ESP_FAIL;
+            break;
+        }
+
+        int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+        while (ret == ESP_ERR_TIMEOUT) {
+            int64_t left_us = deadline - esp_timer_get_time();
+            if (left_us <= 0) {
+                break;
+            }
+            fd_set readfds;
+            FD_ZERO(&readfds);
+            FD_SET(sock, &readfds);
+            struct timeval tv = {
+                .tv_sec = left_us / 1000000,
+                .tv_usec = left_us % 1000000
+            };
+            if (select(sock + 1, &readfds, NULL, NULL, &tv) <= 0) {
+                break;
+            }
+
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            int n = recvfrom(sock, s_dns.msg, sizeof(s_dns.msg), 0, (struct sockaddr *)&from, &from_len);
+            if (n < 12 || from.sin_addr.s_addr != server.sin_addr.s_addr ||
+                read_u16(s_dns.msg) != id || (read_u16(s_dns.msg + 2) & DNS_FLAG_QR) == 0) {
+                continue;   // Not our answer
+            }
+            *resp_len = (size_t)n;
+            ret = ESP_OK;
+        }
+    }
+    close(sock);
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint16_t flags = read_u16(s_dns.msg + 2);
+    if ((flags & 0x000F) == DNS_RCODE_NXDOMAIN) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if ((flags & 0x000F) != 0 || (flags & DNS_FLAG_TC) != 0) {
+        ESP_LOGW(TAG, "Unusable answer for %s (flags 0x%04x)", name, flags);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Walk the answer and additional sections
+ */
+static esp_err_t parse_records(const uint8_t *msg, size_t len, sip_dns_rr_handler_t handler, void *ctx)
+{
+    char skip[SIP_DNS_NAME_LEN];
+    sip_dns_rr_t rr;
+    uint16_t qdcount = read_u16(msg + 4);
+    uint16_t ancount = read_u16(msg + 6);
+    uint16_t nscount = read_u16(msg + 8);
+    uint16_t arcount = read_u16(msg + 10);
+    size_t off = 12;
+
+    for (int i = 0; i < qdcount; i++) {
+        off = read_name(msg, len, off, skip, sizeof(skip));
+        if (off == 0 || off + 4 > len) {
+            return ESP_FAIL;
+        }
+        off += 4;
+    }
+
+    for (int i = 0; i < ancount + nscount + arcount; i++) {
+        off = read_name(msg, len, off, rr.name, sizeof(rr.name));
+        if (off == 0 || off + 10 > len) {
+            return ESP_FAIL;
+        }
+        rr.type = read_u16(msg + off);
+        rr.ttl = read_u32(msg + off + 4);
+        rr.rdlen = read_u16(msg + off + 8);
+        rr.rdata = off + 10;
+        rr.additional = i >= ancount + nscount;
+        if (rr.rdata + rr.rdlen > len) {
+            return ESP_FAIL;
+        }
+        if (read_u16(msg + off + 2) == DNS_CLASS_IN && (i < ancount || rr.additional)) {
+            handler(msg, len, &rr, ctx);
+        }
+        off = rr.rdata + rr.rdlen;
+    }
+    return ESP_OK;
+}
+
+typedef struct {
+    sip_dns_transport_t transport;
+    bool found;
+    uint16_t order;
+    uint16_t preference;
+    uint32_t ttl;
+    char replacement[SIP_DNS_NAME_LEN];
+} naptr_ctx_t;
+
+static void naptr_handler(const uint8_t *msg, size_t len, const sip_dns_rr_t *rr, void *arg)
+{
+    naptr_ctx_t *ctx = (naptr_ctx_t *)arg;
+    char flags[8];
+    char services[32];
+    char regexp[8];
+    char replacement[SIP_DNS_NAME_LEN];
+    size_t end = rr->rdata + rr->rdlen;
+
+    if (rr->type != DNS_TYPE_NAPTR || rr->additional || rr->rdlen < 7) {
+        return;
+    }
+    uint16_t order = read_u16(msg + rr->rdata);
+    uint16_t preference = read_u16(msg + rr->rdata + 2);
+    size_t off = read_string(msg, end, rr->rdata + 4, flags, sizeof(flags));
+    off = off ? read_string(msg, end, off, services, sizeof(services)) : 0;
+    off = off ? read_string(msg, end, off, regexp, sizeof(regexp)) : 0;
+    if (off == 0 || read_name(msg, len, off, replacement, sizeof(replacement)) == 0) {
+        return;
+    }
+
+    // Only SRV-terminal rules for our transport (RFC 3263 section 4.1)
+    if (strcasecmp(flags, "s") != 0 || strcasecmp(services, naptr_services[ctx->transport]) != 0 ||
+        replacement[0] == '\0') {
+        return;
+    }
+    if (!ctx->found || order < ctx->order || (order == ctx->order && preference < ctx->preference)) {
+        ctx->found = true;
+        ctx->order = order;
+        ctx->preference = preference;
+        ctx->ttl = rr->ttl;
+        strncpy(ctx->replacement, replacement, sizeof(ctx->replacement) - 1);
+        ctx->replacement[sizeof(ctx->replacement) - 1] = '\0';
+    }
+}
+
+typedef struct {
+    uint32_t ttl;
+} srv_ctx_t;
+
+static void srv_handler(const uint8_t *msg, size_t len, const sip_dns_rr_t *rr, void *arg)
+{
+    srv_ctx_t *ctx = (srv_ctx_t *)arg;
+
+    if (rr->type == DNS_TYPE_SRV && !rr->additional && rr->rdlen > 6 && s_dns.srv_count < SIP_DNS_MAX_SRV) {
+        sip_dns_srv_t *srv = &s_dns.srv[s_dns.srv_count];
+        if (read_name(msg, len, rr->rdata + 6, srv->target, sizeof(srv->target)) == 0 ||
+            srv->target[0] == '\0') {
+            return;     // "." means the service is not offered here
+        }
+        srv->priority = read_u16(msg + rr->rdata);
+        srv->weight = read_u16(msg + rr->rdata + 2);
+        srv->port = read_u16(msg + rr->rdata + 4);
+        srv->addr = 0;
+        s_dns.srv_count++;
+        ctx->ttl = min_u32(ctx->ttl, rr->ttl);
+    } else if (rr->type == DNS_TYPE_A && rr->additional && rr->rdlen == 4) {
+        // Glue records save a query per target
+        for (int i = 0; i < s_dns.srv_count; i++) {
+            if (s_dns.srv[i].addr == 0 && strcasecmp(s_dns.srv[i].target, rr->name) == 0) {
+                memcpy(&s_dns.srv[i].addr, msg + rr->rdata, 4);
+                ctx->ttl = min_u32(ctx->ttl, rr->ttl);
+            }
+        }
+    }
+}
+
+typedef struct {
+    uint32_t ttl;
+    uint8_t count;
+    uint32_t addrs[SIP_DNS_MAX_TARGETS];
+} a_ctx_t;
+
+static void a_handler(const uint8_t *msg, size_t len, const sip_dns_rr_t *rr, void *arg)
+{
+    a_ctx_t *ctx = (a_ctx_t *)arg;
+
+    // CNAME chains end in A records owned by another name, so the owner is not checked
+    if (rr->type == DNS_TYPE_A && !rr->additional && rr->rdlen == 4 && ctx->count < SIP_DNS_MAX_TARGETS) {
+        memcpy(&ctx->addrs[ctx->count++], msg + rr->rdata, 4);
+        ctx->ttl = min_u32(ctx->ttl, rr->ttl);
+    }
+}
+
+static esp_err_t query_a(const char *name, a_ctx_t *ctx)
+{
+    size_t len = 0;
+
+    ctx->count = 0;
+    ctx->ttl = UINT32_MAX;
+    esp_err_t ret = dns_exchange(name, DNS_TYPE_A, &len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (parse_records(s_dns.msg, len, a_handler, ctx) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return ctx->count > 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void sip_dns_order_targets(sip_dns_target_t *targets, size_t count)
+{
+    // Stable sort by priority
+    for (size_t i = 1; i < count; i++) {
+        sip_dns_target_t t = targets[i];
+        size_t j = i;
+        while (j > 0 && targets[j - 1].priority > t.priority) {
+            targets[j] = targets[j - 1];
+            j--;
+        }
+        targets[j] = t;
+    }
+
+    // RFC 2782: within a priority, pick by running weight sum, zero weights first
+    for (size_t start = 0; start < count; ) {
+        size_t end = start;
+        while (end < count && targets[end].priority == targets[start].priority) {
+            end++;
+        }
+        for (size_t i = start; i < end; i++) {
+            for (size_t j = i; j > start && targets[j].weight == 0 && targets[j - 1].weight != 0; j--) {
+                sip_dns_target_t t = targets[j];
+                targets[j] = targets[j - 1];
+                targets[j - 1] = t;
+            }
+        }
+        for (size_t pos = start; pos + 1 < end; pos++) {
+            uint32_t total = 0;
+            for (size_t i = pos; i < end; i++) {
+                total += targets[i].weight;
+            }
+            uint32_t pick = esp_random() % (total + 1);
+            uint32_t sum = 0;
+            size_t chosen = pos;
+            for (size_t i = pos; i < end; i++) {
+                sum += targets[i].weight;
+                if (sum >= pick) {
+                    chosen = i;
+                    break;
+                }
+            }
+            sip_dns_target_t t = targets[chosen];
+            memmove(&targets[pos + 1], &targets[pos], (chosen - pos) * sizeof(t));
+            targets[pos] = t;
+        }
+        start = end;
+    }
+}
+
+/**
+ * @brief Run the full NAPTR/SRV/A resolution; caller holds query_lock
+ */
+static esp_err_t resolve_uncached(const char *domain, uint16_t default_port,
+                                  sip_dns_transport_t transport, sip_dns_result_t *result)
+{
+    char srv_name[SIP_DNS_NAME_LEN];
+    naptr_ctx_t naptr = { .transport = transport };
+    srv_ctx_t srv = { .ttl = UINT32_MAX };
+    a_ctx_t a;
+    size_t len = 0;
+    esp_err_t ret;
+
+    memset(result, 0, sizeof(*result));
+
+    // NAPTR tells which SRV name to use; without one the well-known name is used
+    ret = dns_exchange(domain, DNS_TYPE_NAPTR, &len);
+    if (ret == ESP_ERR_TIMEOUT || ret == ESP_ERR_INVALID_STATE) {
+        return ret;
+    }
+    if (ret == ESP_OK) {
+        parse_records(s_dns.msg, len, naptr_handler, &naptr);
+    }
+    if (naptr.found) {
+        strncpy(srv_name, naptr.replacement, sizeof(srv_name) - 1);
+        srv_name[sizeof(srv_name) - 1] = '\0';
+        srv.ttl = naptr.ttl;
+    } else {
+        snprintf(srv_name, sizeof(srv_name), "%s.%s", srv_prefixes[transport], domain);
+    }
+
+    s_dns.srv_count = 0;
+    if (dns_exchange(srv_name, DNS_TYPE_SRV, &len) == ESP_OK) {
+        parse_records(s_dns.msg, len, srv_handler, &srv);
+    }
+
+    if (s_dns.srv_count > 0) {
+        sip_dns_target_t targets[SIP_DNS_MAX_SRV];
+        size_t count = 0;
+
+        for (int i = 0; i < s_dns.srv_count; i++) {
+            sip_dns_srv_t *rec = &s_dns.srv[i];
+            if (rec->addr == 0) {
+                if (query_a(rec->target, &a) != ESP_OK) {
+                    ESP_LOGW(TAG, "SRV target %s does not resolve", rec->target);
+                    continue;
+                }
+                rec->addr = a.addrs[0];
+                srv.ttl = min_u32(srv.ttl, a.ttl);
+            }
+            targets[count++] = (sip_dns_target_t){
+                .addr = rec->addr, .port = rec->port,
+                .priority = rec->priority, .weight = rec->weight
+            };
+        }
+        if (count > 0) {
+            sip_dns_order_targets(targets, count);
+            result->count = count < SIP_DNS_MAX_TARGETS ? count : SIP_DNS_MAX_TARGETS;
+            memcpy(result->targets, targets, result->count * sizeof(targets[0]));
+            result->from_srv = true;
+            result->ttl_sec = srv.ttl;
+            return ESP_OK;
+        }
+    }
+
+    // No usable SRV: the domain itself is the server (RFC 3263 section 4.2)
+    ret = query_a(domain, &a);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    for (int i = 0; i < a.count; i++) {
+        result->targets[i] = (sip_dns_target_t){ .addr = a.addrs[i], .port = default_port };
+    }
+    result->count = a.count;
+    result->ttl_sec = a.ttl;
+    return ESP_OK;
+}
+
+static uint32_t clamp_ttl(uint32_t ttl)
+{
+    uint32_t min_ttl = s_dns.config.min_ttl_sec ? s_dns.config.min_ttl_sec : SIP_DNS_DEFAULT_MIN_TTL_SEC;
+
+    if (ttl < min_ttl) {
+        return min_ttl;
+    }
+    return ttl > SIP_DNS_MAX_TTL_SEC ? SIP_DNS_MAX_TTL_SEC : ttl;
+}
+
+/**
+ * @brief Find a cache entry; caller holds lock
+ */
+static sip_dns_entry_t *find_entry(const char *domain, uint16_t default_port, sip_dns_transport_t transport)
+{
+    for (int i = 0; i < SIP_DNS_CACHE_SIZE; i++) {
+        sip_dns_entry_t *entry = &s_dns.cache[i];
+        if (entry->used && entry->transport == transport && entry->default_port == default_port &&
+            strcasecmp(entry->domain, domain) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Store a fresh result, evicting the least recently used entry; caller holds lock
+ */
+static void store_result(sip_dns_entry_t *entry, const char *domain, uint16_t default_port,
+                         sip_dns_transport_t transport, const sip_dns_result_t *result)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (entry == NULL) {
+        entry = &s_dns.cache[0];
+        for (int i = 0; i < SIP_DNS_CACHE_SIZE; i++) {
+            if (!s_dns.cache[i].used) {
+                entry = &s_dns.cache[i];
+                break;
+            }
+            if (s_dns.cache[i].last_used_us < entry->last_used_us) {
+                entry = &s_dns.cache[i];
+            }
+        }
+        memset(entry, 0, sizeof(*entry));
+        entry->used = true;
+        entry->transport = transport;
+        entry->default_port = default_port;
+        strncpy(entry->domain, domain, sizeof(entry->domain) - 1);
+        entry->last_used_us = now;
+    }
+
+    entry->result = *result;
+    entry->result.ttl_sec = clamp_ttl(result->ttl_sec);
+    entry->expires_at_us = now + (int64_t)entry->result.ttl_sec * 1000000;
+    entry->refresh_at_us = now + (int64_t)entry->result.ttl_sec * SIP_DNS_REFRESH_PERCENT * 10000;
+}
+
+static bool parse_literal(const char *domain, uint16_t default_port, sip_dns_result_t *result)
+{
+    struct in_addr in;
+
+    if (!inet_aton(domain, &in)) {
+        return false;
+    }
+    memset(result, 0, sizeof(*result));
+    result->count = 1;
+    result->targets[0].addr = in.s_addr;
+    result->targets[0].port = default_port;
+    return true;
+}
+
+static bool lookup_locked(const char *domain, uint16_t default_port, sip_dns_transport_t transport,
+                          sip_dns_result_t *result)
+{
+    sip_dns_entry_t *entry = find_entry(domain, default_port, transport);
+    if (entry == NULL) {
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+    *result = entry->result;
+    entry->last_used_us = now;
+    s_dns.stats.cache_hits++;
+    if (now >= entry->expires_at_us) {
+        // Served stale while the refresh task keeps trying; a dead DNS
+        // server must not take the doorbell down with it
+        s_dns.stats.stale_hits++;
+    }
+    return true;
+}
+
+esp_err_t sip_dns_lookup_cached(const char *domain, uint16_t default_port,
+                                sip_dns_transport_t transport, sip_dns_result_t *result)
+{
+    if (domain == NULL || result == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (parse_literal(domain, default_port, result)) {
+        return ESP_OK;
+    }
+    if (!s_dns.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_dns.lock, portMAX_DELAY);
+    bool found = lookup_locked(domain, default_port, transport, result);
+    xSemaphoreGive(s_dns.lock);
+    return found ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t sip_dns_resolve(const char *domain, uint16_t default_port,
+                          sip_dns_transport_t transport, sip_dns_result_t *result)
+{
+    if (domain == NULL || result == NULL || domain[0] == '\0' ||
+        strlen(domain) >= sizeof(s_dns.cache[0].domain)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (parse_literal(domain, default_port, result)) {
+        return ESP_OK;
+    }
+    if (!s_dns.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_dns.lock, portMAX_DELAY);
+    bool found = lookup_locked(domain, default_port, transport, result);
+    xSemaphoreGive(s_dns.lock);
+    if (found) {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(s_dns.query_lock, portMAX_DELAY);
+
+    // Someone else may have resolved it while we waited
+    xSemaphoreTake(s_dns.lock, portMAX_DELAY);
+    found = lookup_locked(domain, default_port, transport, result);
+    xSemaphoreGive(s_dns.lock);
+
+    esp_err_t ret = ESP_OK;
+    if (!found) {
+        ret = resolve_uncached(domain, default_port, transport, result);
+        xSemaphoreTake(s_dns.lock, portMAX_DELAY);
+        if (ret == ESP_OK) {
+            store_result(NULL, domain, default_port, transport, result);
+            result->ttl_sec = clamp_ttl(result->ttl_sec);
+        } else {
+            s_dns.stats.failures++;
+        }
+        xSemaphoreGive(s_dns.lock);
+    }
+    xSemaphoreGive(s_dns.query_lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Could not resolve %s: %s", domain, esp_err_to_name(ret));
+    } else if (!found) {
+        ESP_LOGI(TAG, "%s resolved to %d server(s)%s, TTL %lu s", domain, result->count,
+                 result->from_srv ? " via SRV" : "", (unsigned long)result->ttl_sec);
+    }
+    return ret;
+}
+
+void sip_dns_refresh_due(void)
+{
+    for (int i = 0; i < SIP_DNS_CACHE_SIZE; i++) {
+        char domain[sizeof(s_dns.cache[0].domain)];
+        uint16_t default_port;
+        sip_dns_transport_t transport;
+        sip_dns_result_t result;
+
+        xSemaphoreTake(s_dns.lock, portMAX_DELAY);
+        sip_dns_entry_t *entry = &s_dns.cache[i];
+        bool due = entry->used && esp_timer_get_time() >= entry->refresh_at_us;
+        if (due) {
+            memcpy(domain, entry->domain, sizeof(domain));
+            default_port = entry->default_port;
+            transport = entry->transport;
+        }
+        xSemaphoreGive(s_dns.lock);
+        if (!due) {
+            continue;
+        }
+
+        xSemaphoreTake(s_dns.query_lock, portMAX_DELAY);
+        esp_err_t ret = resolve_uncached(domain, default_port, transport, &result);
+        xSemaphoreGive(s_dns.query_lock);
+
+        xSemaphoreTake(s_dns.lock, portMAX_DELAY);
+        entry = find_entry(domain, default_port, transport);
+        if (entry != NULL) {
+            if (ret == ESP_OK) {
+                if (result.targets[0].addr != entry->result.targets[0].addr ||
+                    result.targets[0].port != entry->result.targets[0].port) {
+                    ESP_LOGI(TAG, "Preferred server for %s changed", domain);
+                }
+                store_result(entry, domain, default_port, transport, &result);
+                s_dns.stats.refreshes++;
+            } else {
+                entry->refresh_at_us = esp_timer_get_time() + (int64_t)SIP_DNS_RETRY_SEC * 1000000;
+                s_dns.stats.failures++;
+                ESP_LOGW(TAG, "Refresh of %s failed (%s), keeping cached servers",
+                         domain, esp_err_to_name(ret));
+            }
+        }
+        xSemaphoreGive(s_dns.lock);
+    }
+}
+
+static void refresh_task(void *arg)
+{
+    while (s_dns.initialized) {
+        vTaskDelay(pdMS_TO_TICKS(SIP_DNS_POLL_MS));
+        if (s_dns.initialized) {
+            sip_dns_refresh_due();
+        }
+    }
+    s_dns.task_running = false;
+    vTaskDelete(NULL);
+}
+
+esp_err_t sip_dns_init(const sip_dns_config_t *config)
+{
+    // The locks outlive deinit so a late caller never sees a freed handle
+    if (s_dns.lock == NULL) {
+        s_dns.lock = xSemaphoreCreateMutex();
+        s_dns.query_lock = xSemaphoreCreateMutex();
+        if (s_dns.lock == NULL || s_dns.query_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(s_dns.lock, portMAX_DELAY);
+    if (config != NULL) {
+        s_dns.config = *config;
+    }
+    bool running = s_dns.initialized;
+    s_dns.initialized = true;
+    xSemaphoreGive(s_dns.lock);
+
+    if (running || s_dns.task_running) {
+        return ESP_OK;
+    }
+
+    s_dns.task_running = true;
+    if (xTaskCreate(refresh_task, "sip_dns", SIP_DNS_TASK_STACK_SIZE, NULL,
+                    SIP_DNS_TASK_PRIORITY, &s_dns.task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create DNS refresh task");
+        s_dns.task_running = false;
+        s_dns.initialized = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void sip_dns_deinit(void)
+{
+    if (!s_dns.initialized) {
+        return;
+    }
+
+    s_dns.initialized = false;
+    for (int waited = 0; s_dns.task_running && waited < SIP_DNS_STOP_WAIT_MS; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    xSemaphoreTake(s_dns.query_lock, portMAX_DELAY);
+    xSemaphoreTake(s_dns.lock, portMAX_DELAY);
+    memset(s_dns.cache, 0, sizeof(s_dns.cache));
+    memset(&s_dns.stats, 0, sizeof(s_dns.stats));
+    memset(&s_dns.config, 0, sizeof(s_dns.config));
+    xSemaphoreGive(s_dns.lock);
+    xSemaphoreGive(s_dns.query_lock);
+}
+
+void sip_dns_get_stats(sip_dns_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    if (s_dns.lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_dns.lock, portMAX_DELAY);
+    *stats = s_dns.stats;
+    xSemaphoreGive(s_dns.lock);
+}
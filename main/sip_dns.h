@@ -0,0 +1,134 @@
+#ifndef SIP_DNS_H
+#define SIP_DNS_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Servers kept per domain
+ */
+#define SIP_DNS_MAX_TARGETS     4
+
+/**
+ * @brief Domains kept in the cache
+ */
+#define SIP_DNS_CACHE_SIZE      4
+
+/**
+ * @brief Transport the SIP server is looked up for (RFC 3263 section 4.1)
+ */
+typedef enum {
+    SIP_DNS_TRANSPORT_UDP,      ///< SIP+D2U, _sip._udp
+    SIP_DNS_TRANSPORT_TCP,      ///< SIP+D2T, _sip._tcp
+    SIP_DNS_TRANSPORT_TLS       ///< SIPS+D2T, _sips._tcp
+} sip_dns_transport_t;
+
+/**
+ * @brief One server to try
+ */
+typedef struct {
+    uint32_t addr;              ///< IPv4 address (network order)
+    uint16_t port;
+    uint16_t priority;          ///< SRV priority, 0 without SRV
+    uint16_t weight;            ///< SRV weight, 0 without SRV
+} sip_dns_target_t;
+
+/**
+ * @brief Servers for a domain, in the order they should be tried
+ */
+typedef struct {
+    uint8_t count;
+    bool from_srv;              ///< Targets came from SRV records
+    uint32_t ttl_sec;           ///< TTL the result was cached with
+    sip_dns_target_t targets[SIP_DNS_MAX_TARGETS];
+} sip_dns_result_t;
+
+/**
+ * @brief Resolver settings
+ */
+typedef struct {
+    uint32_t server_addr;       ///< DNS server (network order), 0 for the one lwIP got via DHCP
+    uint16_t server_port;       ///< 0 for 53
+    uint32_t timeout_ms;        ///< Per query, 0 for the default
+    uint32_t min_ttl_sec;       ///< Shorter TTLs are raised to this, 0 for the default
+} sip_dns_config_t;
+
+/**
+ * @brief Resolver counters
+ */
+typedef struct {
+    uint32_t queries;           ///< DNS queries sent
+    uint32_t cache_hits;        ///< Lookups answered from the cache
+    uint32_t stale_hits;        ///< Hits on entries past their TTL
+    uint32_t refreshes;         ///< Background refreshes that succeeded
+    uint32_t failures;          ///< Resolutions that failed
+} sip_dns_stats_t;
+
+/**
+ * @brief Start the resolver and its background refresh task
+ *
+ * Calling it again while running only updates the settings.
+ *
+ * @param config Settings, NULL for defaults
+ */
+esp_err_t sip_dns_init(const sip_dns_config_t *config);
+
+/**
+ * @brief Stop the refresh task and drop the cache
+ */
+void sip_dns_deinit(void);
+
+/**
+ * @brief Resolve the SIP servers for a domain
+ *
+ * NAPTR first, then SRV, then a plain A lookup on the domain with
+ * default_port. IPv4 literals are returned as-is. Cached entries are
+ * returned without any network traffic, even past their TTL while the
+ * refresh task works on them. Only a cache miss blocks on DNS.
+ *
+ * @param domain SIP domain
+ * @param default_port Port used when no SRV record exists
+ * @param transport Transport to look up
+ * @param result Filled with the targets
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if the domain does not resolve,
+ *         ESP_ERR_TIMEOUT if the DNS server did not answer
+ */
+esp_err_t sip_dns_resolve(const char *domain, uint16_t default_port,
+                          sip_dns_transport_t transport, sip_dns_result_t *result);
+
+/**
+ * @brief Look up a domain in the cache only, never blocks
+ *
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if the domain is not cached
+ */
+esp_err_t sip_dns_lookup_cached(const char *domain, uint16_t default_port,
+                                sip_dns_transport_t transport, sip_dns_result_t *result);
+
+/**
+ * @brief Refresh every cache entry that is due (run by the refresh task)
+ */
+void sip_dns_refresh_due(void);
+
+/**
+ * @brief Get resolver counters
+ */
+void sip_dns_get_stats(sip_dns_stats_t *stats);
+
+/**
+ * @brief Order targets per RFC 2782 (exposed for tests)
+ *
+ * Lowest priority first; within a priority a weighted random order.
+ */
+void sip_dns_order_targets(sip_dns_target_t *targets, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIP_DNS_H
@@ -0,0 +1,99 @@
+#include "sip_event_queue.h"
+#include <string.h>
+
+#define SIP_EVENT_QUEUE_MASK    (SIP_EVENT_QUEUE_SIZE - 1)
+
+_Static_assert((SIP_EVENT_QUEUE_SIZE & SIP_EVENT_QUEUE_MASK) == 0, "queue size must be a power of two");
+_Static_assert(SIP_EVENT_QUEUE_DTMF_RESERVE < SIP_EVENT_QUEUE_SIZE, "state events need room in the ring");
+
+// Mailbox word: event type + 1 in the low byte, error code in the upper 24 bits
+#define MAILBOX_CODE_MAX        ((1 << 23) - 1)
+#define MAILBOX_CODE_MIN        (-(1 << 23))
+
+void sip_event_queue_init(sip_event_queue_t *queue)
+{
+    memset(queue, 0, sizeof(*queue));
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->mailbox, 0);
+}
+
+static uint32_t mailbox_pack(const sip_event_data_t *event)
+{
+    int code = 0;
+    if (event->event_type == SIP_EVENT_REGISTRATION_FAILED || event->event_type == SIP_EVENT_CALL_FAILED) {
+        code = event->data.error.error_code;
+        if (code > MAILBOX_CODE_MAX) {
+            code = MAILBOX_CODE_MAX;
+        } else if (code < MAILBOX_CODE_MIN) {
+            code = MAILBOX_CODE_MIN;
+        }
+    }
+    return ((uint32_t)code << 8) | (uint32_t)(event->event_type + 1);
+}
+
+static void mailbox_unpack(uint32_t word, sip_event_data_t *event)
+{
+    memset(event, 0, sizeof(*event));
+    event->event_type = (sip_event_type_t)((word & 0xff) - 1);
+    if (event->event_type == SIP_EVENT_REGISTRATION_FAILED || event->event_type == SIP_EVENT_CALL_FAILED) {
+        event->data.error.error_code = (int32_t)word >> 8;
+    }
+}
+
+bool sip_event_queue_push(sip_event_queue_t *queue, const sip_event_data_t *event)
+{
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    unsigned used = head - tail;
+
+    queue->stats.posted++;
+
+    if (event->event_type != SIP_EVENT_DTMF_RECEIVED) {
+        // Once one state event waits in the mailbox, later ones follow it
+        // there so the consumer still sees the latest state last
+        if (used >= SIP_EVENT_QUEUE_SIZE - SIP_EVENT_QUEUE_DTMF_RESERVE ||
+            atomic_load_explicit(&queue->mailbox, memory_order_relaxed) != 0) {
+            if (atomic_exchange_explicit(&queue->mailbox, mailbox_pack(event), memory_order_release) != 0) {
+                queue->stats.coalesced++;
+            }
+            return true;
+        }
+    } else if (used >= SIP_EVENT_QUEUE_SIZE) {
+        queue->stats.dropped++;
+        return false;
+    }
+
+    queue->slots[head & SIP_EVENT_QUEUE_MASK] = *event;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    if (used + 1 > queue->stats.high_water) {
+        queue->stats.high_water = used + 1;
+    }
+    return true;
+}
+
+bool sip_event_queue_pop(sip_event_queue_t *queue, sip_event_data_t *event)
+{
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    if (head != tail) {
+        *event = queue->slots[tail & SIP_EVENT_QUEUE_MASK];
+        atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+        queue->stats.delivered++;
+        return true;
+    }
+
+    uint32_t word = atomic_exchange_explicit(&queue->mailbox, 0, memory_order_acquire);
+    if (word == 0) {
+        return false;
+    }
+    mailbox_unpack(word, event);
+    queue->stats.delivered++;
+    return true;
+}
+
+void sip_event_queue_get_stats(const sip_event_queue_t *queue, sip_event_queue_stats_t *stats)
+{
+    *stats = queue->stats;
+}
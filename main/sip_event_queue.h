@@ -0,0 +1,115 @@
+#ifndef SIP_EVENT_QUEUE_H
+#define SIP_EVENT_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Events the queue holds, a power of two
+ */
+#define SIP_EVENT_QUEUE_SIZE            16
+
+/**
+ * @brief Slots only DTMF events may use, so state changes cannot crowd out key presses
+ */
+#define SIP_EVENT_QUEUE_DTMF_RESERVE    6
+
+/**
+ * @brief SIP event types
+ */
+typedef enum {
+    SIP_EVENT_REGISTERED,      ///< SIP client successfully registered
+    SIP_EVENT_REGISTRATION_FAILED, ///< SIP registration failed
+    SIP_EVENT_CALL_STARTED,    ///< Outgoing call initiated
+    SIP_EVENT_CALL_CONNECTED,  ///< Call answered by remote party
+    SIP_EVENT_CALL_ENDED,      ///< Call terminated
+    SIP_EVENT_CALL_FAILED,     ///< Call failed to connect
+    SIP_EVENT_DTMF_RECEIVED    ///< DTMF tone received
+} sip_event_type_t;
+
+/**
+ * @brief SIP event data structure
+ */
+typedef struct {
+    sip_event_type_t event_type;
+    union {
+        struct {
+            char digit;
+            uint32_t timestamp;
+        } dtmf;
+        struct {
+            int error_code;
+            char error_message[128];
+        } error;
+    } data;
+} sip_event_data_t;
+
+/**
+ * @brief Queue counters
+ */
+typedef struct {
+    uint32_t posted;            ///< Events offered to the queue
+    uint32_t delivered;         ///< Events taken by the consumer
+    uint32_t coalesced;         ///< State events replaced by a later one before delivery
+    uint32_t dropped;           ///< Events lost to a full queue
+    uint32_t high_water;        ///< Most events waiting at once
+} sip_event_queue_stats_t;
+
+/**
+ * @brief Bounded single-producer single-consumer event queue
+ *
+ * Neither side ever waits for the other. DTMF events go into the ring and
+ * are dropped only when all of it is full. State events leave the last
+ * SIP_EVENT_QUEUE_DTMF_RESERVE slots free: beyond that they are kept in a
+ * one-event mailbox where a newer state event replaces an undelivered one,
+ * since only the latest state matters to the consumer. A coalesced state
+ * event keeps its type and error code but not its error message.
+ *
+ * The consumer takes the ring before the mailbox, so under overload a
+ * DTMF event may be delivered ahead of an older coalesced state event.
+ * Producers on several tasks must serialize among themselves.
+ *
+ * A zeroed queue is empty.
+ */
+typedef struct {
+    sip_event_data_t slots[SIP_EVENT_QUEUE_SIZE];
+    atomic_uint head;           ///< Next slot to write, advanced by the producer
+    atomic_uint tail;           ///< Next slot to read, advanced by the consumer
+    atomic_uint mailbox;        ///< Coalesced state event, 0 when empty
+    sip_event_queue_stats_t stats;
+} sip_event_queue_t;
+
+/**
+ * @brief Empty the queue and clear its counters, while neither side uses it
+ */
+void sip_event_queue_init(sip_event_queue_t *queue);
+
+/**
+ * @brief Add an event, producer side
+ *
+ * @return false if the event was dropped
+ */
+bool sip_event_queue_push(sip_event_queue_t *queue, const sip_event_data_t *event);
+
+/**
+ * @brief Take the oldest event, consumer side
+ *
+ * @return false if the queue is empty
+ */
+bool sip_event_queue_pop(sip_event_queue_t *queue, sip_event_data_t *event);
+
+/**
+ * @brief Copy the counters
+ */
+void sip_event_queue_get_stats(const sip_event_queue_t *queue, sip_event_queue_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIP_EVENT_QUEUE_H
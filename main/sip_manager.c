@@ -1,8 +1,12 @@
 #include "sip_manager.h"
 #include "esp_sip.h"
+#include "call_latency.h"
+#include "rtp_engine.h"
+#include "dtmf_trie.h"
+#include "sdp.h"
 #include "esp_log.h"
 #include "esp_timer.h"
-#include "esp_event.h"
+#include "esp_random.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
@@ -11,6 +15,20 @@
 
 static const char *TAG = "sip_manager";
 
+// Registration refresh scheduling
+#define SIP_REG_DEFAULT_REFRESH_PERCENT 75
+#define SIP_REG_DEFAULT_JITTER_PERCENT  10
+#define SIP_REG_DEFAULT_EXPIRES_SEC     3600        // esp_sip default when registration_timeout is 0
+#define SIP_REG_MAX_EXPIRES_SEC         86400
+#define SIP_REG_REFRESH_MARGIN_SEC      32          // Timer F, a refresh needing every retransmission still lands
+#define SIP_REG_MIN_DELAY_MS            1000
+#define SIP_REG_BACKOFF_BASE_MS         1000
+#define SIP_REG_BACKOFF_MAX_MS          (300 * 1000)
+
+_Static_assert(SIP_MAX_CALLEES == ESP_SIP_MAX_CALL_LEGS, "callee list and esp_sip legs must match");
+_Static_assert(SIP_MAX_DTMF_COMMANDS <= DTMF_TRIE_MAX_ENTRIES, "every DTMF mapping needs a trie entry");
+_Static_assert(SIP_DTMF_MAX_SEQUENCE_LEN <= DTMF_TRIE_MAX_SEQUENCE, "DTMF sequences must fit the trie");
+
 // SIP manager state
 static struct {
     sip_config_t config;
@@ -24,28 +42,55 @@ static struct {
     esp_sip_client_handle_t sip_client;
     TimerHandle_t call_timeout_timer;
     
+    // Registration refresh
+    TimerHandle_t registration_timer;
+    sip_registration_info_t registration;
+    int64_t registration_expiry_us;     // When the current binding lapses, 0 if none
+    
     // Call statistics
     sip_call_stats_t call_stats;
+    esp_sip_stats_t sip_stats_seen;     // esp_sip counters already folded into call_stats
+    sip_call_quality_t call_history[SIP_CALL_HISTORY_SIZE];    // Ring, oldest at call_history_next once full
+    uint8_t call_history_next;
+    uint8_t call_history_count;
     
     // DTMF command processing
-    dtmf_command_mapping_t dtmf_mappings[12]; // Max 12 DTMF digits
+    dtmf_command_mapping_t dtmf_mappings[SIP_MAX_DTMF_COMMANDS];
     size_t dtmf_mapping_count;
+    dtmf_trie_t dtmf_trie;              // Enabled mappings, entries index dtmf_mappings
+    dtmf_trie_cursor_t dtmf_input;      // Digits typed in the current call
+    uint32_t dtmf_interdigit_ms;
+    TimerHandle_t dtmf_timer;           // Completes a pending sequence after the inter-digit timeout
     dtmf_command_callback_t dtmf_command_callback;
     void *dtmf_command_user_data;
     bool dtmf_processing_enabled;
 } sip_manager = {0};
 
-// Event declarations
-ESP_EVENT_DECLARE_BASE(SIP_EVENTS);
-ESP_EVENT_DEFINE_BASE(SIP_EVENTS);
+// Guards the DTMF trie and input, fed from the SIP task, the consumer task and the timer task
+static portMUX_TYPE dtmf_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Events for the application, kept outside sip_manager so init never races the consumer
+static sip_event_queue_t event_queue;
+static sip_event_notify_t event_notify;
+static void *event_notify_user_data;
+
+// Serializes the posting tasks: SIP, consumer, timer and API callers
+static portMUX_TYPE event_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Key presses from the RTP stream, only ever pushed by the RTP task
+static sip_event_queue_t media_dtmf_queue;
 
 // Forward declarations
 static void sip_event_callback(esp_sip_event_data_t *event_data, void *user_data);
+static void call_finished(void);
 static void call_timeout_callback(TimerHandle_t xTimer);
+static void registration_timer_callback(TimerHandle_t xTimer);
 static esp_err_t sip_manager_set_state(sip_state_t new_state);
 static esp_err_t sip_manager_post_event(sip_event_type_t event_type, const void *event_data);
 static void process_dtmf_digit(char digit);
-static dtmf_command_t map_dtmf_to_command(char digit, uint32_t *param);
+static void handle_dtmf(char digit, void *ctx);
+static void handle_media_dtmf(char digit, void *ctx);
+static void sip_manager_sync_sip_stats(void);
 
 /**
  * @brief Validate SIP configuration
@@ -80,6 +125,19 @@ static esp_err_t validate_sip_config(const sip_config_t *config) {
         return ESP_ERR_INVALID_ARG;
     }
     
+    if (config->registration_refresh_percent > 100 || config->registration_jitter_percent > 50) {
+        ESP_LOGE(TAG, "Invalid registration refresh settings");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sdp_codec_list_t codecs;
+    if (config->codecs[0] != '\0' &&
+        (memchr(config->codecs, '\0', sizeof(config->codecs)) == NULL ||
+         !sdp_parse_codec_list(config->codecs, &codecs))) {
+        ESP_LOGE(TAG, "Invalid codec list");
+        return ESP_ERR_INVALID_ARG;
+    }
+    
     return ESP_OK;
 }
 
@@ -96,6 +154,10 @@ static esp_err_t sip_manager_set_state(sip_state_t new_state) {
         // Post appropriate events based on state change
         switch (new_state) {
             case SIP_STATE_REGISTERED:
+                // A call ends by going back to registered
+                if (old_state == SIP_STATE_CONNECTED || old_state == SIP_STATE_CALLING) {
+                    sip_manager_post_event(SIP_EVENT_CALL_ENDED, NULL);
+                }
                 sip_manager_post_event(SIP_EVENT_REGISTERED, NULL);
                 break;
             case SIP_STATE_CALLING:
@@ -124,7 +186,7 @@ static esp_err_t sip_manager_set_state(sip_state_t new_state) {
 }
 
 /**
- * @brief Post SIP event to event loop
+ * @brief Queue SIP event for the application, never blocks
  */
 static esp_err_t sip_manager_post_event(sip_event_type_t event_type, const void *event_data) {
     sip_event_data_t sip_event = {
@@ -135,51 +197,252 @@ static esp_err_t sip_manager_post_event(sip_event_type_t event_type, const void
         memcpy(&sip_event.data, event_data, sizeof(sip_event.data));
     }
     
-    return esp_event_post(SIP_EVENTS, event_type, &sip_event, sizeof(sip_event), portMAX_DELAY);
+    portENTER_CRITICAL(&event_lock);
+    bool queued = sip_event_queue_push(&event_queue, &sip_event);
+    portEXIT_CRITICAL(&event_lock);
+    
+    if (!queued) {
+        ESP_LOGW(TAG, "Event queue full, dropped event %d", event_type);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    sip_event_notify_t notify = event_notify;
+    if (notify != NULL) {
+        notify(event_notify_user_data);
+    }
+    return ESP_OK;
 }
 
 /**
- * @brief Map DTMF digit to command
+ * @brief Digits a mapping is typed with
+ *
+ * @param single Holds a single-digit sequence
  */
-static dtmf_command_t map_dtmf_to_command(char digit, uint32_t *param) {
-    if (!sip_manager.dtmf_processing_enabled) {
-        return DTMF_CMD_NONE;
+static const char *dtmf_mapping_sequence(const dtmf_command_mapping_t *mapping, char single[2]) {
+    if (mapping->sequence[0] != '\0') {
+        return mapping->sequence;
     }
-    
+    single[0] = mapping->digit;
+    single[1] = '\0';
+    return single;
+}
+
+/**
+ * @brief Compile the enabled mappings into the trie and drop any typed digits
+ */
+static void dtmf_compile_mappings(void) {
+    portENTER_CRITICAL(&dtmf_lock);
+    dtmf_trie_clear(&sip_manager.dtmf_trie);
     for (size_t i = 0; i < sip_manager.dtmf_mapping_count; i++) {
-        if (sip_manager.dtmf_mappings[i].digit == digit && sip_manager.dtmf_mappings[i].enabled) {
-            if (param != NULL) {
-                *param = sip_manager.dtmf_mappings[i].param;
-            }
-            return sip_manager.dtmf_mappings[i].command;
+        char single[2];
+        if (sip_manager.dtmf_mappings[i].enabled) {
+            // Cannot fail: mappings are validated and the pool fits them all
+            dtmf_trie_add(&sip_manager.dtmf_trie,
+                          dtmf_mapping_sequence(&sip_manager.dtmf_mappings[i], single), (int)i);
         }
     }
+    dtmf_trie_cursor_reset(&sip_manager.dtmf_input);
+    portEXIT_CRITICAL(&dtmf_lock);
+}
+
+/**
+ * @brief Forget the digits typed so far, at the start and end of a call
+ */
+static void dtmf_reset_input(void) {
+    portENTER_CRITICAL(&dtmf_lock);
+    dtmf_trie_cursor_reset(&sip_manager.dtmf_input);
+    portEXIT_CRITICAL(&dtmf_lock);
+    if (sip_manager.dtmf_timer != NULL) {
+        xTimerStop(sip_manager.dtmf_timer, 0);
+    }
+}
+
+/**
+ * @brief Run the command of a completed sequence
+ */
+static void run_dtmf_command(int entry) {
+    if (entry < 0 || (size_t)entry >= sip_manager.dtmf_mapping_count) {
+        return;
+    }
+    dtmf_command_t command = sip_manager.dtmf_mappings[entry].command;
+    uint32_t param = sip_manager.dtmf_mappings[entry].param;
+    
+    ESP_LOGI(TAG, "DTMF mapping %d matched, command %d with param %lu", entry, command, param);
     
-    return DTMF_CMD_NONE;
+    // Call command callback if registered
+    if (sip_manager.dtmf_command_callback != NULL) {
+        sip_manager.dtmf_command_callback(command, param, sip_manager.dtmf_command_user_data);
+    }
+}
+
+/**
+ * @brief Inter-digit timeout: complete a sequence that is also a prefix
+ */
+static void dtmf_timer_callback(TimerHandle_t xTimer) {
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    
+    portENTER_CRITICAL(&dtmf_lock);
+    int entry = dtmf_trie_expire(&sip_manager.dtmf_trie, &sip_manager.dtmf_input, now_ms,
+                                 sip_manager.dtmf_interdigit_ms);
+    portEXIT_CRITICAL(&dtmf_lock);
+    
+    run_dtmf_command(entry);
 }
 
 /**
  * @brief Process received DTMF digit
+ *
+ * Advances the typed input by one trie node. Digits are logged at debug
+ * level only, since sequences may be PINs.
  */
 static void process_dtmf_digit(char digit) {
-    ESP_LOGI(TAG, "Processing DTMF digit: %c", digit);
+    ESP_LOGD(TAG, "Processing DTMF digit: %c", digit);
     
-    // Map digit to command
-    uint32_t param = 0;
-    dtmf_command_t command = map_dtmf_to_command(digit, &param);
+    if (!sip_manager.dtmf_processing_enabled) {
+        return;
+    }
     
-    if (command != DTMF_CMD_NONE) {
-        ESP_LOGI(TAG, "DTMF digit %c mapped to command %d with param %lu", digit, command, param);
-        
-        // Call command callback if registered
-        if (sip_manager.dtmf_command_callback != NULL) {
-            sip_manager.dtmf_command_callback(command, param, sip_manager.dtmf_command_user_data);
-        }
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    portENTER_CRITICAL(&dtmf_lock);
+    int entry = dtmf_trie_feed(&sip_manager.dtmf_trie, &sip_manager.dtmf_input, digit, now_ms,
+                               sip_manager.dtmf_interdigit_ms);
+    bool pending = dtmf_trie_pending(&sip_manager.dtmf_input);
+    portEXIT_CRITICAL(&dtmf_lock);
+    
+    // Restarts the timeout with every digit of an unfinished sequence
+    if (pending) {
+        xTimerChangePeriod(sip_manager.dtmf_timer, pdMS_TO_TICKS(sip_manager.dtmf_interdigit_ms), 0);
     } else {
+        xTimerStop(sip_manager.dtmf_timer, 0);
+    }
+    
+    if (entry >= 0) {
+        run_dtmf_command(entry);
+    } else if (!pending) {
         ESP_LOGD(TAG, "DTMF digit %c not mapped to any command", digit);
     }
 }
 
+/**
+ * @brief Check whether the last granted binding is still valid at the registrar
+ */
+static bool registration_binding_valid(void) {
+    return sip_manager.registration_expiry_us != 0 &&
+           esp_timer_get_time() < sip_manager.registration_expiry_us;
+}
+
+/**
+ * @brief (Re)arm the registration timer
+ */
+static void registration_schedule(uint32_t delay_ms) {
+    if (delay_ms < SIP_REG_MIN_DELAY_MS) {
+        delay_ms = SIP_REG_MIN_DELAY_MS;
+    }
+    sip_manager.registration.next_attempt_ms = delay_ms;
+    
+    // Changing the period also starts a dormant timer
+    if (xTimerChangePeriod(sip_manager.registration_timer, pdMS_TO_TICKS(delay_ms), 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to schedule registration");
+    }
+}
+
+/**
+ * @brief Refresh delay for a binding granted for the given number of seconds
+ *
+ * Refreshes at the configured share of the lifetime, minus a random amount
+ * so stations that registered together (e.g. after a power outage) drift
+ * apart instead of hitting the registrar in lockstep forever.
+ */
+static uint32_t registration_refresh_delay_ms(uint32_t expires) {
+    uint32_t percent = sip_manager.config.registration_refresh_percent ?
+                       sip_manager.config.registration_refresh_percent : SIP_REG_DEFAULT_REFRESH_PERCENT;
+    uint32_t jitter_percent = sip_manager.config.registration_jitter_percent ?
+                              sip_manager.config.registration_jitter_percent : SIP_REG_DEFAULT_JITTER_PERCENT;
+    
+    if (expires > SIP_REG_MAX_EXPIRES_SEC) {
+        expires = SIP_REG_MAX_EXPIRES_SEC;
+    }
+    
+    uint32_t delay = (uint32_t)((uint64_t)expires * 1000 * percent / 100);
+    uint32_t jitter = (uint32_t)((uint64_t)expires * 1000 * jitter_percent / 100);
+    uint32_t early = esp_random() % (jitter + 1);
+    delay = early < delay ? delay - early : 0;
+    
+    // Leave room for a refresh that needs all its retransmissions
+    if (expires > 2 * SIP_REG_REFRESH_MARGIN_SEC &&
+        delay > (expires - SIP_REG_REFRESH_MARGIN_SEC) * 1000) {
+        delay = (expires - SIP_REG_REFRESH_MARGIN_SEC) * 1000;
+    }
+    
+    return delay;
+}
+
+/**
+ * @brief Exponential backoff with equal jitter for a registration retry
+ *
+ * Half the backoff is kept, the other half is random, so a fleet that lost
+ * the registrar at the same moment does not retry in waves.
+ */
+static uint32_t registration_backoff_delay_ms(uint32_t failures) {
+    uint32_t shift = failures > 0 ? failures - 1 : 0;
+    uint32_t delay = SIP_REG_BACKOFF_MAX_MS;
+    
+    if (shift < 16 && ((uint32_t)SIP_REG_BACKOFF_BASE_MS << shift) < SIP_REG_BACKOFF_MAX_MS) {
+        delay = (uint32_t)SIP_REG_BACKOFF_BASE_MS << shift;
+    }
+    
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
+
+/**
+ * @brief Record a granted binding and schedule its refresh
+ */
+static void registration_succeeded(void) {
+    uint32_t expires = 0;
+    
+    if (esp_sip_get_registration_expires(sip_manager.sip_client, &expires) != ESP_OK || expires == 0) {
+        expires = sip_manager.config.registration_timeout ?
+                  sip_manager.config.registration_timeout : SIP_REG_DEFAULT_EXPIRES_SEC;
+    }
+    
+    sip_manager.registration.granted_expires = expires;
+    sip_manager.registration.consecutive_failures = 0;
+    sip_manager.registration.refreshes++;
+    sip_manager.registration_expiry_us = esp_timer_get_time() + (int64_t)expires * 1000000;
+    
+    uint32_t delay = registration_refresh_delay_ms(expires);
+    ESP_LOGI(TAG, "Registered for %lu s, refreshing in %lu ms", expires, delay);
+    registration_schedule(delay);
+}
+
+/**
+ * @brief Schedule the next registration attempt after a failure
+ */
+static void registration_schedule_retry(void) {
+    uint32_t delay = registration_backoff_delay_ms(sip_manager.registration.consecutive_failures);
+    
+    ESP_LOGW(TAG, "Retrying registration in %lu ms (%lu consecutive failures)",
+             delay, sip_manager.registration.consecutive_failures);
+    registration_schedule(delay);
+}
+
+/**
+ * @brief Registration timer callback - sends the refresh or retry REGISTER
+ */
+static void registration_timer_callback(TimerHandle_t xTimer) {
+    if (!sip_manager.initialized || sip_manager.state == SIP_STATE_IDLE) {
+        return;
+    }
+    
+    sip_manager.registration.next_attempt_ms = 0;
+    esp_err_t ret = esp_sip_register(sip_manager.sip_client);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send REGISTER: %s", esp_err_to_name(ret));
+        sip_manager.registration.consecutive_failures++;
+        registration_schedule_retry();
+    }
+}
+
 /**
  * @brief SIP event callback - handles events from esp_sip library
  */
@@ -192,11 +455,20 @@ static void sip_event_callback(esp_sip_event_data_t *event_data, void *user_data
     
     switch (event_data->event) {
         case ESP_SIP_EVENT_REGISTERED:
-            sip_manager_set_state(SIP_STATE_REGISTERED);
+            registration_succeeded();
+            
+            // A refresh completing during a call must not disturb the call state
+            if (sip_manager.state == SIP_STATE_REGISTERING || sip_manager.state == SIP_STATE_ERROR) {
+                sip_manager_set_state(SIP_STATE_REGISTERED);
+            }
             break;
             
         case ESP_SIP_EVENT_REGISTRATION_FAILED:
-            sip_manager_set_state(SIP_STATE_ERROR);
+            sip_manager.registration.consecutive_failures++;
+            if (sip_manager.state != SIP_STATE_CALLING && sip_manager.state != SIP_STATE_CONNECTED) {
+                sip_manager_set_state(SIP_STATE_ERROR);
+            }
+            registration_schedule_retry();
             break;
             
         case ESP_SIP_EVENT_CALL_STARTED:
@@ -207,21 +479,18 @@ static void sip_event_callback(esp_sip_event_data_t *event_data, void *user_data
         case ESP_SIP_EVENT_CALL_CONNECTED:
             sip_manager.call_start_time = esp_timer_get_time() / 1000000;
             sip_manager.call_active = true;
+            dtmf_reset_input();
             sip_manager_set_state(SIP_STATE_CONNECTED);
             break;
             
         case ESP_SIP_EVENT_CALL_ENDED:
-            // Update call statistics
-            if (sip_manager.call_active && sip_manager.call_start_time > 0) {
-                uint32_t call_duration = sip_manager_get_call_duration();
-                sip_manager.call_stats.total_call_duration += call_duration;
-                sip_manager.call_stats.successful_calls++;
-                sip_manager.call_stats.last_call_end_reason = 0; // Normal end
-                ESP_LOGI(TAG, "Call ended normally, duration: %lu seconds", call_duration);
-            }
+            // Update call statistics, unless sip_manager_end_call() already did
+            call_finished();
             
             sip_manager.call_active = false;
             sip_manager.call_start_time = 0;
+            dtmf_reset_input();
+            call_latency_end_attempt();
             sip_manager_set_state(SIP_STATE_REGISTERED);
             break;
             
@@ -233,29 +502,15 @@ static void sip_event_callback(esp_sip_event_data_t *event_data, void *user_data
             
             sip_manager.call_active = false;
             sip_manager.call_start_time = 0;
+            call_latency_end_attempt();
             sip_manager_set_state(SIP_STATE_ERROR);
+            
+            // Re-validate the binding so the station returns to REGISTERED
+            registration_schedule_retry();
             break;
             
         case ESP_SIP_EVENT_DTMF_RECEIVED:
-            sip_manager.last_dtmf_time = esp_timer_get_time() / 1000000;
-            
-            // Process DTMF digit for command mapping
-            process_dtmf_digit(event_data->data.dtmf.digit);
-            
-            // Call registered raw DTMF callback
-            if (sip_manager.dtmf_callback != NULL) {
-                sip_manager.dtmf_callback(event_data->data.dtmf.digit, sip_manager.dtmf_user_data);
-            }
-            
-            // Post DTMF event
-            sip_event_data_t sip_event = {
-                .event_type = SIP_EVENT_DTMF_RECEIVED,
-                .data.dtmf = {
-                    .digit = event_data->data.dtmf.digit,
-                    .timestamp = sip_manager.last_dtmf_time
-                }
-            };
-            sip_manager_post_event(SIP_EVENT_DTMF_RECEIVED, &sip_event.data);
+            handle_dtmf(event_data->data.dtmf.digit, NULL);
             break;
             
         default:
@@ -264,6 +519,58 @@ static void sip_event_callback(esp_sip_event_data_t *event_data, void *user_data
     }
 }
 
+/**
+ * @brief Handle a key press, from a SIP INFO or an RFC 4733 event in the RTP stream
+ *
+ * Runs on the SIP task for INFO, on the consumer task for the RTP stream.
+ */
+static void handle_dtmf(char digit, void *ctx) {
+    sip_manager.last_dtmf_time = esp_timer_get_time() / 1000000;
+    
+    // Process DTMF digit for command mapping
+    process_dtmf_digit(digit);
+    
+    // Call registered raw DTMF callback
+    if (sip_manager.dtmf_callback != NULL) {
+        sip_manager.dtmf_callback(digit, sip_manager.dtmf_user_data);
+    }
+    
+    // Post DTMF event
+    sip_event_data_t sip_event = {
+        .event_type = SIP_EVENT_DTMF_RECEIVED,
+        .data.dtmf = {
+            .digit = digit,
+            .timestamp = sip_manager.last_dtmf_time
+        }
+    };
+    sip_manager_post_event(SIP_EVENT_DTMF_RECEIVED, &sip_event.data);
+}
+
+/**
+ * @brief Queue a key press from the RTP stream for the consumer task
+ *
+ * Runs on the RTP task, which must not run a command: hanging up stops
+ * the media engine the task belongs to.
+ */
+static void handle_media_dtmf(char digit, void *ctx) {
+    sip_event_data_t sip_event = {
+        .event_type = SIP_EVENT_DTMF_RECEIVED,
+        .data.dtmf = {
+            .digit = digit,
+            .timestamp = (uint32_t)(esp_timer_get_time() / 1000000)
+        }
+    };
+    if (!sip_event_queue_push(&media_dtmf_queue, &sip_event)) {
+        ESP_LOGW(TAG, "DTMF queue full, dropped digit");
+        return;
+    }
+    
+    sip_event_notify_t notify = event_notify;
+    if (notify != NULL) {
+        notify(event_notify_user_data);
+    }
+}
+
 /**
  * @brief Call timeout callback - ends call if timeout reached
  */
@@ -289,6 +596,61 @@ static void call_timeout_callback(TimerHandle_t xTimer) {
 
 
 
+/**
+ * @brief esp_sip transport for the configured protocol
+ */
+static esp_sip_transport_t sip_manager_transport(void) {
+    if (sip_manager.config.use_tls) {
+        return ESP_SIP_TRANSPORT_TLS;
+    }
+    return sip_manager.config.use_tcp ? ESP_SIP_TRANSPORT_TCP : ESP_SIP_TRANSPORT_UDP;
+}
+
+/**
+ * @brief Fold new esp_sip counters into the call statistics
+ *
+ * esp_sip counters restart with every client, so only the delta since the
+ * last sync is added. Per-leg timings of the last call are copied when
+ * esp_sip reports a different call than last time.
+ */
+static void sip_manager_sync_sip_stats(void) {
+    esp_sip_stats_t stats;
+
+    if (sip_manager.sip_client == NULL || esp_sip_get_stats(sip_manager.sip_client, &stats) != ESP_OK) {
+        return;
+    }
+    sip_manager.call_stats.auth_challenges_avoided +=
+        stats.auth_challenges_avoided - sip_manager.sip_stats_seen.auth_challenges_avoided;
+    sip_manager.call_stats.connection_reconnects +=
+        stats.reconnects - sip_manager.sip_stats_seen.reconnects;
+    sip_manager.call_stats.tls_full_handshakes +=
+        stats.tls_full_handshakes - sip_manager.sip_stats_seen.tls_full_handshakes;
+    sip_manager.call_stats.tls_resumed_handshakes +=
+        stats.tls_resumed_handshakes - sip_manager.sip_stats_seen.tls_resumed_handshakes;
+    if (stats.tls_full_handshakes != sip_manager.sip_stats_seen.tls_full_handshakes) {
+        sip_manager.call_stats.tls_full_handshake_ms = stats.tls_full_handshake_ms;
+    }
+    if (stats.tls_resumed_handshakes != sip_manager.sip_stats_seen.tls_resumed_handshakes) {
+        sip_manager.call_stats.tls_resumed_handshake_ms = stats.tls_resumed_handshake_ms;
+    }
+    
+    if (stats.last_call_legs != sip_manager.sip_stats_seen.last_call_legs ||
+        stats.last_call_answered_leg != sip_manager.sip_stats_seen.last_call_answered_leg ||
+        memcmp(stats.last_call_leg, sip_manager.sip_stats_seen.last_call_leg, sizeof(stats.last_call_leg)) != 0) {
+        sip_manager.call_stats.last_call_leg_count = stats.last_call_legs;
+        sip_manager.call_stats.last_call_answered_leg = stats.last_call_answered_leg;
+        for (int i = 0; i < SIP_MAX_CALLEES; i++) {
+            sip_manager.call_stats.last_call_legs[i].final_status = stats.last_call_leg[i].status;
+            sip_manager.call_stats.last_call_legs[i].ringing_ms = stats.last_call_leg[i].provisional_ms;
+            sip_manager.call_stats.last_call_legs[i].final_ms = stats.last_call_leg[i].final_ms;
+        }
+    }
+    sip_manager.call_stats.sip_transaction_arena_peak = stats.transaction_arena_peak;
+    sip_manager.call_stats.sip_dialog_arena_peak = stats.dialog_arena_peak;
+    sip_manager.call_stats.sip_arena_failures = stats.arena_failures;
+    sip_manager.sip_stats_seen = stats;
+}
+
 esp_err_t sip_manager_init(const sip_config_t *config) {
     if (sip_manager.initialized) {
         ESP_LOGW(TAG, "SIP manager already initialized");
@@ -312,12 +674,18 @@ esp_err_t sip_manager_init(const sip_config_t *config) {
     sip_manager.call_active = false;
     sip_manager.call_start_time = 0;
     sip_manager.last_dtmf_time = 0;
+    memset(&sip_manager.sip_stats_seen, 0, sizeof(sip_manager.sip_stats_seen));
+    sip_manager.sip_stats_seen.last_call_answered_leg = -1;
+    sip_manager.call_stats.last_call_answered_leg = -1;
+    memset(&sip_manager.registration, 0, sizeof(sip_manager.registration));
+    sip_manager.registration_expiry_us = 0;
     
     // Initialize DTMF command processing with default mappings
     sip_manager.dtmf_processing_enabled = true;
     sip_manager.dtmf_command_callback = NULL;
     sip_manager.dtmf_command_user_data = NULL;
     sip_manager.dtmf_mapping_count = 0;
+    sip_manager.dtmf_interdigit_ms = SIP_DTMF_DEFAULT_INTERDIGIT_MS;
     
     // Set up default DTMF command mappings
     dtmf_command_mapping_t default_mappings[] = {
@@ -332,6 +700,7 @@ esp_err_t sip_manager_init(const sip_config_t *config) {
         sip_manager.dtmf_mapping_count = default_count;
         ESP_LOGI(TAG, "Initialized %zu default DTMF command mappings", default_count);
     }
+    dtmf_compile_mappings();
     
     // Create call timeout timer
     sip_manager.call_timeout_timer = xTimerCreate(
@@ -347,14 +716,53 @@ esp_err_t sip_manager_init(const sip_config_t *config) {
         return ESP_ERR_NO_MEM;
     }
     
+    // Create registration refresh timer, period is set whenever it is armed
+    if (sip_manager.registration_timer == NULL) {
+        sip_manager.registration_timer = xTimerCreate(
+            "sip_reg_timer",
+            pdMS_TO_TICKS(SIP_REG_MIN_DELAY_MS),
+            pdFALSE,  // One-shot timer
+            NULL,
+            registration_timer_callback
+        );
+    }
+    
+    if (sip_manager.registration_timer == NULL) {
+        ESP_LOGE(TAG, "Failed to create registration timer");
+        xTimerDelete(sip_manager.call_timeout_timer, 0);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Create inter-digit timer, period is set whenever it is armed
+    if (sip_manager.dtmf_timer == NULL) {
+        sip_manager.dtmf_timer = xTimerCreate(
+            "sip_dtmf_timer",
+            pdMS_TO_TICKS(SIP_DTMF_DEFAULT_INTERDIGIT_MS),
+            pdFALSE,  // One-shot timer
+            NULL,
+            dtmf_timer_callback
+        );
+    }
+    
+    if (sip_manager.dtmf_timer == NULL) {
+        ESP_LOGE(TAG, "Failed to create DTMF timer");
+        xTimerDelete(sip_manager.call_timeout_timer, 0);
+        return ESP_ERR_NO_MEM;
+    }
+    
     // Initialize esp_sip client
     esp_sip_config_t esp_sip_config = {
         .username = sip_manager.config.user,
         .password = sip_manager.config.password,
         .server_uri = sip_manager.config.domain,
+        .uri = sip_manager.config.callee,
         .port = sip_manager.config.port,
         .registration_timeout_sec = sip_manager.config.registration_timeout,
-        .call_timeout_sec = sip_manager.config.call_timeout
+        .call_timeout_sec = sip_manager.config.call_timeout,
+        .transport = sip_manager_transport(),
+        .keepalive_interval_sec = sip_manager.config.keepalive_interval,
+        .tls_ca_pem = sip_manager.config.tls_ca_pem,
+        .codecs = sip_manager.config.codecs
     };
     
     esp_err_t sip_ret = esp_sip_init(&esp_sip_config, sip_event_callback, NULL, &sip_manager.sip_client);
@@ -363,6 +771,7 @@ esp_err_t sip_manager_init(const sip_config_t *config) {
         xTimerDelete(sip_manager.call_timeout_timer, 0);
         return sip_ret;
     }
+    rtp_engine_set_dtmf_handler(handle_media_dtmf, NULL);
     
     sip_manager.initialized = true;
     
@@ -416,6 +825,12 @@ esp_err_t sip_manager_stop(void) {
     // Stop call timeout timer
     xTimerStop(sip_manager.call_timeout_timer, 0);
     
+    // Stop registration refresh, the binding is removed with the client
+    xTimerStop(sip_manager.registration_timer, 0);
+    sip_manager.registration.granted_expires = 0;
+    sip_manager.registration.next_attempt_ms = 0;
+    sip_manager.registration_expiry_us = 0;
+    
     // Stop esp_sip client
     if (sip_manager.sip_client != NULL) {
         esp_sip_stop(sip_manager.sip_client);
@@ -437,7 +852,10 @@ esp_err_t sip_manager_start_call(const char *uri) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    if (sip_manager.state != SIP_STATE_REGISTERED) {
+    // After a failed refresh or call the registrar still routes to the last
+    // binding until it lapses, so the button keeps working meanwhile
+    if (sip_manager.state != SIP_STATE_REGISTERED &&
+        !(sip_manager.state == SIP_STATE_ERROR && registration_binding_valid())) {
         ESP_LOGE(TAG, "SIP not registered, cannot start call");
         return ESP_ERR_INVALID_STATE;
     }
@@ -490,16 +908,17 @@ esp_err_t sip_manager_end_call(void) {
     // Stop call timeout timer
     xTimerStop(sip_manager.call_timeout_timer, 0);
     
-    // Reset call state
-    sip_manager.call_active = false;
-    sip_manager.call_start_time = 0;
-    
-    // Terminate call via esp_sip library
+    // Terminate call via esp_sip library, which also stops the media
     esp_err_t ret = esp_sip_hangup(sip_manager.sip_client);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to hangup call");
     }
     
+    // The CALL_ENDED event may only follow later, and then finds no call
+    call_finished();
+    sip_manager.call_active = false;
+    sip_manager.call_start_time = 0;
+    
     // Set state back to registered (will be updated by callback)
     sip_manager_set_state(SIP_STATE_REGISTERED);
     
@@ -523,6 +942,35 @@ esp_err_t sip_manager_register_dtmf_callback(dtmf_callback_t callback, void *use
     return ESP_OK;
 }
 
+esp_err_t sip_manager_register_event_notify(sip_event_notify_t notify, void *user_data) {
+    event_notify_user_data = user_data;
+    event_notify = notify;
+    return ESP_OK;
+}
+
+bool sip_manager_poll_event(sip_event_data_t *event) {
+    if (event == NULL) {
+        return false;
+    }
+    
+    // Key presses from the RTP stream run their commands here, then come back as events
+    sip_event_data_t media_event;
+    while (sip_event_queue_pop(&media_dtmf_queue, &media_event)) {
+        handle_dtmf(media_event.data.dtmf.digit, NULL);
+    }
+    return sip_event_queue_pop(&event_queue, event);
+}
+
+esp_err_t sip_manager_get_event_stats(sip_event_queue_stats_t *stats) {
+    if (stats == NULL) {
+        ESP_LOGE(TAG, "Stats pointer is NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    sip_event_queue_get_stats(&event_queue, stats);
+    return ESP_OK;
+}
+
 bool sip_manager_is_call_active(void) {
     return sip_manager.call_active;
 }
@@ -557,9 +1005,16 @@ esp_err_t sip_manager_update_config(const sip_config_t *config) {
     
     // Destroy old esp_sip client
     if (sip_manager.sip_client != NULL) {
-        esp_sip_destroy(sip_manager.sip_client);
+        sip_manager_sync_sip_stats();
+        ret = esp_sip_destroy(sip_manager.sip_client);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to destroy esp_sip client: %s", esp_err_to_name(ret));
+            return ret;
+        }
         sip_manager.sip_client = NULL;
     }
+    memset(&sip_manager.sip_stats_seen, 0, sizeof(sip_manager.sip_stats_seen));
+    sip_manager.sip_stats_seen.last_call_answered_leg = -1;
     
     // Update configuration
     memcpy(&sip_manager.config, config, sizeof(sip_config_t));
@@ -569,9 +1024,14 @@ esp_err_t sip_manager_update_config(const sip_config_t *config) {
         .username = sip_manager.config.user,
         .password = sip_manager.config.password,
         .server_uri = sip_manager.config.domain,
+        .uri = sip_manager.config.callee,
         .port = sip_manager.config.port,
         .registration_timeout_sec = sip_manager.config.registration_timeout,
-        .call_timeout_sec = sip_manager.config.call_timeout
+        .call_timeout_sec = sip_manager.config.call_timeout,
+        .transport = sip_manager_transport(),
+        .keepalive_interval_sec = sip_manager.config.keepalive_interval,
+        .tls_ca_pem = sip_manager.config.tls_ca_pem,
+        .codecs = sip_manager.config.codecs
     };
     
     ret = esp_sip_init(&esp_sip_config, sip_event_callback, NULL, &sip_manager.sip_client);
@@ -600,7 +1060,24 @@ esp_err_t sip_manager_get_call_stats(sip_call_stats_t *stats) {
     }
     
     // Copy current statistics
+    sip_manager_sync_sip_stats();
     memcpy(stats, &sip_manager.call_stats, sizeof(sip_call_stats_t));
+
+    rtp_engine_stats_t media;
+    rtp_engine_get_stats(&media);
+    stats->jitter_buffer_depth_ms = media.jitter_buffer_depth_ms;
+    stats->jitter_buffer_delay_ms = media.jitter_buffer_delay_ms;
+    stats->jitter_late_drops = media.jitter_late_drops;
+    stats->jitter_underruns = media.jitter_underruns;
+    stats->packets_saved = media.packets_saved;
+    stats->cn_packets_sent = media.cn_sent;
+    stats->packets_lost = media.packets_lost;
+    stats->jitter_ms = media.jitter_ms;
+    stats->remote_packets_lost = media.remote_packets_lost;
+    stats->remote_jitter_ms = media.remote_jitter_ms;
+    stats->rtt_ms = media.rtt_ms;
+    stats->mos_x10 = media.mos_x10;
+    stats->remote_mos_x10 = media.remote_mos_x10;
     
     // Update current call duration if call is active
     if (sip_manager.call_active) {
@@ -626,6 +1103,122 @@ esp_err_t sip_manager_reset_call_stats(void) {
     sip_manager.call_stats.failed_calls = 0;
     sip_manager.call_stats.total_call_duration = 0;
     sip_manager.call_stats.last_call_end_reason = 0;
+    sip_manager_sync_sip_stats();
+    sip_manager.call_stats.auth_challenges_avoided = 0;
+    sip_manager.call_stats.last_call_leg_count = 0;
+    sip_manager.call_stats.last_call_answered_leg = -1;
+    memset(sip_manager.call_stats.last_call_legs, 0, sizeof(sip_manager.call_stats.last_call_legs));
+    sip_manager.call_history_next = 0;
+    sip_manager.call_history_count = 0;
+    call_latency_reset();
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Keep the media quality of a call that just ended
+ *
+ * The media engine keeps its counters after it stops, so they still
+ * describe this call.
+ */
+static void record_call_quality(uint32_t duration) {
+    rtp_engine_stats_t media;
+    rtp_engine_get_stats(&media);
+    
+    sip_call_quality_t *entry = &sip_manager.call_history[sip_manager.call_history_next];
+    entry->duration = duration;
+    entry->packets_sent = media.packets_sent;
+    entry->packets_received = media.packets_received;
+    entry->packets_lost = media.packets_lost;
+    entry->late_drops = media.jitter_late_drops;
+    entry->jitter_ms = media.jitter_ms;
+    entry->jitter_max_ms = media.jitter_max_ms;
+    entry->remote_packets_lost = media.remote_packets_lost;
+    entry->remote_jitter_ms = media.remote_jitter_ms;
+    entry->rtt_ms = media.rtt_ms;
+    entry->mos_x10 = media.mos_x10;
+    entry->remote_mos_x10 = media.remote_mos_x10;
+    
+    sip_manager.call_history_next = (sip_manager.call_history_next + 1) % SIP_CALL_HISTORY_SIZE;
+    if (sip_manager.call_history_count < SIP_CALL_HISTORY_SIZE) {
+        sip_manager.call_history_count++;
+    }
+    ESP_LOGI(TAG, "Call quality: MOS %lu.%lu at the door, %lu.%lu at the far end, RTT %lu ms",
+             entry->mos_x10 / 10, entry->mos_x10 % 10, entry->remote_mos_x10 / 10,
+             entry->remote_mos_x10 % 10, entry->rtt_ms);
+}
+
+/**
+ * @brief Account for an answered call that ended, once, whichever side hung up
+ */
+static void call_finished(void) {
+    if (!sip_manager.call_active || sip_manager.call_start_time == 0) {
+        return;
+    }
+    uint32_t call_duration = sip_manager_get_call_duration();
+    sip_manager.call_stats.total_call_duration += call_duration;
+    sip_manager.call_stats.successful_calls++;
+    sip_manager.call_stats.last_call_end_reason = 0; // Normal end
+    record_call_quality(call_duration);
+    ESP_LOGI(TAG, "Call ended normally, duration: %lu seconds", call_duration);
+    
+    sip_manager.call_active = false;
+    sip_manager.call_start_time = 0;
+}
+
+esp_err_t sip_manager_get_call_history(sip_call_quality_t *history, size_t max, size_t *count) {
+    if (!sip_manager.initialized) {
+        ESP_LOGE(TAG, "SIP manager not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (history == NULL || count == NULL) {
+        ESP_LOGE(TAG, "History or count pointer is NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // Newest first, walking the ring backwards from the last entry written
+    size_t n = sip_manager.call_history_count < max ? sip_manager.call_history_count : max;
+    for (size_t i = 0; i < n; i++) {
+        size_t slot = (sip_manager.call_history_next + SIP_CALL_HISTORY_SIZE - 1 - i) % SIP_CALL_HISTORY_SIZE;
+        history[i] = sip_manager.call_history[slot];
+    }
+    *count = n;
+    
+    return ESP_OK;
+}
+
+esp_err_t sip_manager_get_latency_histograms(call_latency_histograms_t *histograms) {
+    if (!sip_manager.initialized) {
+        ESP_LOGE(TAG, "SIP manager not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (histograms == NULL) {
+        ESP_LOGE(TAG, "Histograms pointer is NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    call_latency_get(histograms);
+    return ESP_OK;
+}
+
+esp_err_t sip_manager_get_registration_info(sip_registration_info_t *info) {
+    if (!sip_manager.initialized) {
+        ESP_LOGE(TAG, "SIP manager not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (info == NULL) {
+        ESP_LOGE(TAG, "Info pointer is NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    memcpy(info, &sip_manager.registration, sizeof(sip_registration_info_t));
+    info->binding_remaining = 0;
+    if (registration_binding_valid()) {
+        info->binding_remaining = (uint32_t)((sip_manager.registration_expiry_us - esp_timer_get_time()) / 1000000);
+    }
     
     return ESP_OK;
 }
@@ -652,10 +1245,34 @@ esp_err_t sip_manager_configure_dtmf_commands(const dtmf_command_mapping_t *mapp
     // Validate all mappings first
     for (size_t i = 0; i < count; i++) {
         char digit = mappings[i].digit;
-        if ((digit < '0' || digit > '9') && digit != '*' && digit != '#') {
+        if (mappings[i].sequence[0] != '\0') {
+            size_t len = strnlen(mappings[i].sequence, sizeof(mappings[i].sequence));
+            if (len == sizeof(mappings[i].sequence)) {
+                ESP_LOGE(TAG, "DTMF sequence %zu is not terminated", i);
+                return ESP_ERR_INVALID_ARG;
+            }
+            for (size_t j = 0; j < len; j++) {
+                if (!dtmf_trie_valid_digit(mappings[i].sequence[j])) {
+                    ESP_LOGE(TAG, "Invalid digit in DTMF sequence %zu", i);
+                    return ESP_ERR_INVALID_ARG;
+                }
+            }
+        } else if ((digit < '0' || digit > '9') && digit != '*' && digit != '#') {
             ESP_LOGE(TAG, "Invalid DTMF digit: %c", digit);
             return ESP_ERR_INVALID_ARG;
         }
+        
+        // The trie holds each sequence once
+        char single[2];
+        char other_single[2];
+        const char *sequence = dtmf_mapping_sequence(&mappings[i], single);
+        for (size_t j = 0; j < i; j++) {
+            if (mappings[j].enabled && mappings[i].enabled &&
+                strcmp(sequence, dtmf_mapping_sequence(&mappings[j], other_single)) == 0) {
+                ESP_LOGE(TAG, "DTMF mappings %zu and %zu have the same digits", j, i);
+                return ESP_ERR_INVALID_ARG;
+            }
+        }
     }
     
     // Copy mappings
@@ -663,6 +1280,10 @@ esp_err_t sip_manager_configure_dtmf_commands(const dtmf_command_mapping_t *mapp
         memcpy(sip_manager.dtmf_mappings, mappings, count * sizeof(dtmf_command_mapping_t));
     }
     sip_manager.dtmf_mapping_count = count;
+    dtmf_compile_mappings();
+    if (sip_manager.dtmf_timer != NULL) {
+        xTimerStop(sip_manager.dtmf_timer, 0);
+    }
     
     ESP_LOGI(TAG, "DTMF command mappings configured successfully");
     return ESP_OK;
@@ -702,6 +1323,23 @@ esp_err_t sip_manager_get_dtmf_commands(dtmf_command_mapping_t *mappings, size_t
     return ESP_OK;
 }
 
+esp_err_t sip_manager_set_dtmf_interdigit_timeout(uint32_t timeout_ms) {
+    if (!sip_manager.initialized) {
+        ESP_LOGE(TAG, "SIP manager not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (timeout_ms == 0) {
+        ESP_LOGE(TAG, "Invalid DTMF inter-digit timeout");
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    sip_manager.dtmf_interdigit_ms = timeout_ms;
+    ESP_LOGI(TAG, "DTMF inter-digit timeout set to %lu ms", timeout_ms);
+    
+    return ESP_OK;
+}
+
 esp_err_t sip_manager_set_dtmf_processing_enabled(bool enabled) {
     if (!sip_manager.initialized) {
         ESP_LOGE(TAG, "SIP manager not initialized");
@@ -3,6 +3,8 @@
 
 #include "esp_err.h"
 #include "esp_event.h"
+#include "call_latency.h"
+#include "sip_event_queue.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -22,6 +24,11 @@ typedef enum {
     SIP_STATE_ERROR          ///< Error state
 } sip_state_t;
 
+/**
+ * @brief Maximum number of callees rung in parallel by one call
+ */
+#define SIP_MAX_CALLEES 4
+
 /**
  * @brief SIP configuration structure
  */
@@ -29,10 +36,17 @@ typedef struct {
     char user[32];           ///< SIP username
     char domain[64];         ///< SIP domain/server
     char password[64];       ///< SIP password
-    char callee[64];         ///< Default callee URI
+    char callee[160];        ///< Default callee URI, or a comma-separated list rung in parallel
     uint16_t port;           ///< SIP server port (default 5060)
     uint32_t registration_timeout; ///< Registration timeout in seconds
     uint32_t call_timeout;   ///< Call timeout in seconds
+    uint8_t registration_refresh_percent; ///< Refresh at this share of the granted Expires (0 = default)
+    uint8_t registration_jitter_percent;  ///< Random early refresh as share of the granted Expires (0 = default)
+    bool use_tcp;            ///< Keep one TCP connection to the server instead of using UDP
+    uint16_t keepalive_interval; ///< TCP/TLS keepalive ping period in seconds (0 = default)
+    bool use_tls;            ///< Like use_tcp inside TLS, default port 5061; takes precedence over use_tcp
+    const char *tls_ca_pem;  ///< CA of the server certificate in PEM, NULL for the bundle; must outlive the manager
+    char codecs[40];         ///< Offered codecs by preference, e.g. "G722,PCMU,PCMA,telephone-event,CN"; empty for that default
 } sip_config_t;
 
 /**
@@ -44,34 +58,11 @@ typedef struct {
 typedef void (*dtmf_callback_t)(char digit, void *user_data);
 
 /**
- * @brief SIP event types
+ * @brief Called after an event is queued, must not block
+ *
+ * The consumer then takes events with sip_manager_poll_event().
  */
-typedef enum {
-    SIP_EVENT_REGISTERED,      ///< SIP client successfully registered
-    SIP_EVENT_REGISTRATION_FAILED, ///< SIP registration failed
-    SIP_EVENT_CALL_STARTED,    ///< Outgoing call initiated
-    SIP_EVENT_CALL_CONNECTED,  ///< Call answered by remote party
-    SIP_EVENT_CALL_ENDED,      ///< Call terminated
-    SIP_EVENT_CALL_FAILED,     ///< Call failed to connect
-    SIP_EVENT_DTMF_RECEIVED    ///< DTMF tone received
-} sip_event_type_t;
-
-/**
- * @brief SIP event data structure
- */
-typedef struct {
-    sip_event_type_t event_type;
-    union {
-        struct {
-            char digit;
-            uint32_t timestamp;
-        } dtmf;
-        struct {
-            int error_code;
-            char error_message[128];
-        } error;
-    } data;
-} sip_event_data_t;
+typedef void (*sip_event_notify_t)(void *user_data);
 
 /**
  * @brief Initialize SIP manager
@@ -98,7 +89,10 @@ esp_err_t sip_manager_stop(void);
 /**
  * @brief Start an outgoing call
  * 
- * @param uri SIP URI to call (if NULL, uses configured callee)
+ * All callees of a comma-separated list are rung at once; the first to
+ * answer gets the call and the others are cancelled.
+ * 
+ * @param uri SIP URI or URI list to call (if NULL, uses configured callee)
  * @return ESP_OK on success, error code otherwise
  */
 esp_err_t sip_manager_start_call(const char *uri);
@@ -126,6 +120,38 @@ sip_state_t sip_manager_get_state(void);
  */
 esp_err_t sip_manager_register_dtmf_callback(dtmf_callback_t callback, void *user_data);
 
+/**
+ * @brief Register the consumer of SIP events
+ *
+ * Events are queued without ever blocking the SIP stack. The notify
+ * callback runs on the posting task after each event and should only
+ * wake the consumer, e.g. with xTaskNotifyGive(). Works before init.
+ *
+ * @param notify Callback, NULL to poll without notification
+ * @param user_data User data to pass to callback
+ * @return ESP_OK on success
+ */
+esp_err_t sip_manager_register_event_notify(sip_event_notify_t notify, void *user_data);
+
+/**
+ * @brief Take the oldest queued SIP event, from the single consumer task
+ *
+ * Key presses from the RTP stream are mapped to DTMF commands here, so
+ * their command callbacks run on the consumer task.
+ *
+ * @param event Receives the event
+ * @return true if an event was taken, false if none is queued
+ */
+bool sip_manager_poll_event(sip_event_data_t *event);
+
+/**
+ * @brief Get SIP event queue counters: high-water mark, drops and coalesced state events
+ *
+ * @param stats Receives the counters
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t sip_manager_get_event_stats(sip_event_queue_stats_t *stats);
+
 /**
  * @brief Check if a call is currently active
  * 
@@ -148,6 +174,15 @@ uint32_t sip_manager_get_call_duration(void);
  */
 esp_err_t sip_manager_update_config(const sip_config_t *config);
 
+/**
+ * @brief Timing of one callee of the last call
+ */
+typedef struct {
+    uint16_t final_status;      ///< Final response of this leg, 0 if none arrived
+    uint32_t ringing_ms;        ///< INVITE to first 18x, 0 if the leg never rang
+    uint32_t final_ms;          ///< INVITE to final response
+} sip_call_leg_stats_t;
+
 /**
  * @brief Get call statistics
  * 
@@ -161,17 +196,117 @@ typedef struct {
     uint32_t total_call_duration;
     uint32_t current_call_duration;
     uint32_t last_call_end_reason;
+    uint32_t auth_challenges_avoided;   ///< Requests accepted without a 401/407 round trip
+    uint8_t last_call_leg_count;        ///< Callees rung in parallel by the last call
+    int8_t last_call_answered_leg;      ///< Callee that answered the last call, -1 if none
+    sip_call_leg_stats_t last_call_legs[SIP_MAX_CALLEES];
+    uint32_t connection_reconnects;     ///< TCP connections to the server re-established
+    uint32_t tls_full_handshakes;       ///< TLS handshakes with a full key exchange
+    uint32_t tls_resumed_handshakes;    ///< TLS handshakes that resumed the cached session
+    uint32_t tls_full_handshake_ms;     ///< Duration of the last full handshake
+    uint32_t tls_resumed_handshake_ms;  ///< Duration of the last resumed handshake
+    uint32_t jitter_buffer_depth_ms;    ///< Audio buffered ahead of the speaker in the current or last call
+    uint32_t jitter_buffer_delay_ms;    ///< Playout delay the jitter buffer aims for
+    uint32_t jitter_late_drops;         ///< Audio frames of the current or last call that came too late
+    uint32_t jitter_underruns;          ///< Times the jitter buffer of the current or last call ran dry
+    uint32_t packets_saved;             ///< Audio packets silence suppression left out in the current or last call
+    uint32_t cn_packets_sent;           ///< Comfort noise packets sent in their place
+    uint32_t packets_lost;              ///< Far-end audio lost on the way in the current or last call
+    uint32_t jitter_ms;                 ///< Interarrival jitter of the far end's audio
+    uint32_t remote_packets_lost;       ///< Our audio the far end reports lost over RTCP
+    uint32_t remote_jitter_ms;          ///< Jitter the far end reports on our audio
+    uint32_t rtt_ms;                    ///< Network round trip measured over RTCP, 0 until known
+    uint32_t mos_x10;                   ///< Estimated MOS of the audio played at the door, times 10; 0 until known
+    uint32_t remote_mos_x10;            ///< MOS of our audio at the far end, times 10; 0 until it reports
+    uint32_t sip_transaction_arena_peak; ///< Most bytes SIP transactions held at once
+    uint32_t sip_dialog_arena_peak;     ///< Most bytes SIP call legs held at once
+    uint32_t sip_arena_failures;        ///< SIP allocations the static pools had no room for
 } sip_call_stats_t;
 
 esp_err_t sip_manager_get_call_stats(sip_call_stats_t *stats);
 
+/**
+ * @brief Answered calls whose media quality is kept
+ */
+#ifndef SIP_CALL_HISTORY_SIZE
+#define SIP_CALL_HISTORY_SIZE 8
+#endif
+
+/**
+ * @brief Media quality of one answered call, as it stood at hangup
+ *
+ * Loss and jitter measured here are on the way from the far end to the
+ * door, whose last hop is usually the Wi-Fi; the remote values are what
+ * the far end reports on our audio over RTCP. Loss and jitter at the door
+ * alone point at the radio, loss in both directions or a long round trip
+ * at the network behind it or the PBX.
+ */
+typedef struct {
+    uint32_t duration;              ///< Seconds from answer to hangup
+    uint32_t packets_sent;
+    uint32_t packets_received;
+    uint32_t packets_lost;          ///< Far-end audio lost on the way
+    uint32_t late_drops;            ///< Far-end audio that came too late to play
+    uint32_t jitter_ms;             ///< Interarrival jitter of the far end's audio at hangup
+    uint32_t jitter_max_ms;         ///< Highest during the call
+    uint32_t remote_packets_lost;   ///< Our audio the far end reported lost
+    uint32_t remote_jitter_ms;      ///< Jitter the far end last reported on our audio
+    uint32_t rtt_ms;                ///< Last round trip measured over RTCP, 0 if none
+    uint32_t mos_x10;               ///< Estimated MOS at the door, times 10
+    uint32_t remote_mos_x10;        ///< MOS at the far end, times 10; 0 if it never reported
+} sip_call_quality_t;
+
+/**
+ * @brief Get the media quality of the last answered calls
+ *
+ * Cleared by sip_manager_reset_call_stats().
+ *
+ * @param history Filled newest first
+ * @param max Entries history has room for
+ * @param count Set to the entries filled, at most SIP_CALL_HISTORY_SIZE
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t sip_manager_get_call_history(sip_call_quality_t *history, size_t max, size_t *count);
+
 /**
  * @brief Reset call statistics
  * 
+ * Also clears the latency histograms and the call history.
+ * 
  * @return ESP_OK on success, error code otherwise
  */
 esp_err_t sip_manager_reset_call_stats(void);
 
+/**
+ * @brief Get call setup latency histograms
+ * 
+ * One log-scale histogram per phase, measured from the button edge.
+ * Use call_latency_percentile_us() for p50/p99.
+ * 
+ * @param histograms Pointer to structure to fill
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t sip_manager_get_latency_histograms(call_latency_histograms_t *histograms);
+
+/**
+ * @brief Registration refresh scheduler status
+ */
+typedef struct {
+    uint32_t granted_expires;       ///< Expires granted for the current binding in seconds, 0 if none
+    uint32_t binding_remaining;     ///< Seconds until the current binding lapses
+    uint32_t next_attempt_ms;       ///< Delay the next REGISTER was scheduled with, 0 if none
+    uint32_t consecutive_failures;  ///< Failed registrations since the last success
+    uint32_t refreshes;             ///< Successful registrations since init
+} sip_registration_info_t;
+
+/**
+ * @brief Get the registration refresh scheduler status
+ * 
+ * @param info Pointer to structure to fill
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t sip_manager_get_registration_info(sip_registration_info_t *info);
+
 /**
  * @brief DTMF command types
  */
@@ -184,14 +319,30 @@ typedef enum {
     DTMF_CMD_CUSTOM             ///< Custom user-defined command
 } dtmf_command_t;
 
+/**
+ * @brief Most DTMF command mappings
+ */
+#define SIP_MAX_DTMF_COMMANDS           16
+
+/**
+ * @brief Longest digit sequence of a DTMF command, e.g. a PIN
+ */
+#define SIP_DTMF_MAX_SEQUENCE_LEN       8
+
+/**
+ * @brief Default time allowed between two digits of a sequence
+ */
+#define SIP_DTMF_DEFAULT_INTERDIGIT_MS  3000
+
 /**
  * @brief DTMF command mapping structure
  */
 typedef struct {
-    char digit;                  ///< DTMF digit ('0'-'9', '*', '#')
+    char digit;                  ///< DTMF digit ('0'-'9', '*', '#'), used when sequence is empty
     dtmf_command_t command;      ///< Command to execute
     uint32_t param;              ///< Optional parameter for command
     bool enabled;                ///< Whether this mapping is enabled
+    char sequence[SIP_DTMF_MAX_SEQUENCE_LEN + 1]; ///< Digits to type, e.g. "*1234#"; empty for the single digit
 } dtmf_command_mapping_t;
 
 /**
@@ -206,9 +357,16 @@ typedef void (*dtmf_command_callback_t)(dtmf_command_t command, uint32_t param,
 /**
  * @brief Configure DTMF command mappings
  * 
+ * Each mapping is either a single digit or a sequence of up to
+ * SIP_DTMF_MAX_SEQUENCE_LEN digits (0-9, *, #, A-D). A command runs as
+ * soon as its sequence is typed. A sequence that is also the start of a
+ * longer one runs when the inter-digit timeout passes without another
+ * digit. Typed digits are kept per call.
+ * 
  * @param mappings Array of command mappings
- * @param count Number of mappings in array
- * @return ESP_OK on success, error code otherwise
+ * @param count Number of mappings in array, at most SIP_MAX_DTMF_COMMANDS
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an invalid digit or
+ *         a sequence given twice, error code otherwise
  */
 esp_err_t sip_manager_configure_dtmf_commands(const dtmf_command_mapping_t *mappings, size_t count);
 
@@ -231,6 +389,16 @@ esp_err_t sip_manager_register_dtmf_command_callback(dtmf_command_callback_t cal
  */
 esp_err_t sip_manager_get_dtmf_commands(dtmf_command_mapping_t *mappings, size_t max_count, size_t *actual_count);
 
+/**
+ * @brief Set the time allowed between two digits of a sequence
+ * 
+ * Digits typed before a longer pause are discarded.
+ * 
+ * @param timeout_ms Timeout, SIP_DTMF_DEFAULT_INTERDIGIT_MS by default
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t sip_manager_set_dtmf_interdigit_timeout(uint32_t timeout_ms);
+
 /**
  * @brief Enable or disable DTMF command processing
  * 
@@ -0,0 +1,408 @@
+#include "sip_message.h"
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+// Header name table, long and compact forms (RFC 3261 section 7.3.3)
+static const struct {
+    const char *name;
+    const char *compact;
+    sip_header_id_t id;
+} s_header_names[] = {
+    {"Via",                "v",  SIP_HDR_VIA},
+    {"From",               "f",  SIP_HDR_FROM},
+    {"To",                 "t",  SIP_HDR_TO},
+    {"Call-ID",            "i",  SIP_HDR_CALL_ID},
+    {"CSeq",               NULL, SIP_HDR_CSEQ},
+    {"Contact",            "m",  SIP_HDR_CONTACT},
+    {"Content-Length",     "l",  SIP_HDR_CONTENT_LENGTH},
+    {"Content-Type",       "c",  SIP_HDR_CONTENT_TYPE},
+    {"Expires",            NULL, SIP_HDR_EXPIRES},
+    {"WWW-Authenticate",   NULL, SIP_HDR_WWW_AUTHENTICATE},
+    {"Proxy-Authenticate", NULL, SIP_HDR_PROXY_AUTHENTICATE},
+};
+
+static const char *s_method_names[] = {
+    [SIP_METHOD_UNKNOWN]  = "UNKNOWN",
+    [SIP_METHOD_REGISTER] = "REGISTER",
+    [SIP_METHOD_INVITE]   = "INVITE",
+    [SIP_METHOD_ACK]      = "ACK",
+    [SIP_METHOD_BYE]      = "BYE",
+    [SIP_METHOD_CANCEL]   = "CANCEL",
+    [SIP_METHOD_OPTIONS]  = "OPTIONS",
+    [SIP_METHOD_INFO]     = "INFO",
+};
+
+static inline bool is_ws(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static inline sip_span_t make_span(size_t start, size_t end)
+{
+    sip_span_t span = {
+        .off = (uint16_t)start,
+        .len = (uint16_t)(end - start)
+    };
+    return span;
+}
+
+/**
+ * @brief Trim whitespace from both ends of [start, end)
+ */
+static sip_span_t trimmed_span(const char *buf, size_t start, size_t end)
+{
+    while (start < end && is_ws(buf[start])) {
+        start++;
+    }
+    while (end > start && is_ws(buf[end - 1])) {
+        end--;
+    }
+    return make_span(start, end);
+}
+
+/**
+ * @brief Find end of line starting at pos
+ *
+ * @param eol Set to index of first line terminator character
+ * @return Index of first character of the next line, or 0 if no terminator
+ */
+static size_t find_line_end(const char *buf, size_t len, size_t pos, size_t *eol)
+{
+    for (size_t i = pos; i < len; i++) {
+        if (buf[i] == '\n') {
+            *eol = (i > pos && buf[i - 1] == '\r') ? i - 1 : i;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static sip_header_id_t lookup_header_id(const char *name, size_t len)
+{
+    for (size_t i = 0; i < sizeof(s_header_names) / sizeof(s_header_names[0]); i++) {
+        if (strlen(s_header_names[i].name) == len &&
+            strncasecmp(s_header_names[i].name, name, len) == 0) {
+            return s_header_names[i].id;
+        }
+        if (s_header_names[i].compact != NULL && len == 1 &&
+            tolower((unsigned char)name[0]) == s_header_names[i].compact[0]) {
+            return s_header_names[i].id;
+        }
+    }
+    return SIP_HDR_OTHER;
+}
+
+static esp_err_t parse_start_line(sip_message_t *msg, size_t start, size_t end)
+{
+    const char *buf = msg->buf;
+    static const char version[] = "SIP/2.0";
+    const size_t version_len = sizeof(version) - 1;
+
+    if (end - start > version_len && memcmp(buf + start, version, version_len) == 0 &&
+        buf[start + version_len] == ' ') {
+        // Status-Line = SIP-Version SP Status-Code SP Reason-Phrase
+        size_t pos = start + version_len + 1;
+        if (end - pos < 3) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        uint16_t code = 0;
+        for (int i = 0; i < 3; i++) {
+            char c = buf[pos + i];
+            if (!isdigit((unsigned char)c)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            code = code * 10 + (c - '0');
+        }
+        if (code < 100 || code > 699) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        msg->is_request = false;
+        msg->status_code = code;
+        msg->reason = trimmed_span(buf, pos + 3, end);
+        return ESP_OK;
+    }
+
+    // Request-Line = Method SP Request-URI SP SIP-Version
+    const char *sp1 = memchr(buf + start, ' ', end - start);
+    if (sp1 == NULL || sp1 == buf + start) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t uri_start = (size_t)(sp1 - buf) + 1;
+    const char *sp2 = memchr(buf + uri_start, ' ', end - uri_start);
+    if (sp2 == NULL || sp2 == buf + uri_start) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t ver_start = (size_t)(sp2 - buf) + 1;
+    if (end - ver_start != version_len || memcmp(buf + ver_start, version, version_len) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    msg->is_request = true;
+    msg->method_name = make_span(start, (size_t)(sp1 - buf));
+    msg->method = sip_method_from_string(buf + start, msg->method_name.len);
+    msg->request_uri = make_span(uri_start, (size_t)(sp2 - buf));
+    return ESP_OK;
+}
+
+static esp_err_t parse_cseq(sip_message_t *msg, sip_span_t value)
+{
+    const char *p = sip_span_ptr(msg, value);
+    size_t i = 0;
+    uint32_t num = 0;
+
+    if (value.len == 0 || !isdigit((unsigned char)p[0])) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (i < value.len && isdigit((unsigned char)p[i])) {
+        num = num * 10 + (uint32_t)(p[i] - '0');
+        i++;
+    }
+    while (i < value.len && is_ws(p[i])) {
+        i++;
+    }
+    msg->cseq = num;
+    msg->cseq_method = sip_method_from_string(p + i, value.len - i);
+    return ESP_OK;
+}
+
+esp_err_t sip_message_parse(const char *buf, size_t len, sip_message_t *msg)
+{
+    if (buf == NULL || msg == NULL || len == 0 || len > UINT16_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(msg, 0, sizeof(*msg));
+    memset(msg->first, -1, sizeof(msg->first));
+    msg->buf = buf;
+    msg->len = len;
+
+    // Tolerate leading CRLFs (keepalives prepended to a message)
+    size_t pos = 0;
+    while (pos < len && (buf[pos] == '\r' || buf[pos] == '\n')) {
+        pos++;
+    }
+
+    size_t eol = 0;
+    size_t next = find_line_end(buf, len, pos, &eol);
+    if (next == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = parse_start_line(msg, pos, eol);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    pos = next;
+
+    // Header lines up to the empty line
+    bool headers_done = false;
+    while (pos < len) {
+        next = find_line_end(buf, len, pos, &eol);
+        if (next == 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (eol == pos) {
+            pos = next;
+            headers_done = true;
+            break;
+        }
+
+        if (is_ws(buf[pos])) {
+            // Folded continuation of the previous header value
+            if (msg->header_count == 0) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            sip_header_t *prev = &msg->headers[msg->header_count - 1];
+            sip_span_t extended = trimmed_span(buf, prev->value.off, eol);
+            prev->value = extended;
+            pos = next;
+            continue;
+        }
+
+        const char *colon = memchr(buf + pos, ':', eol - pos);
+        if (colon == NULL) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (msg->header_count >= SIP_MESSAGE_MAX_HEADERS) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        sip_header_t *hdr = &msg->headers[msg->header_count];
+        hdr->name = trimmed_span(buf, pos, (size_t)(colon - buf));
+        hdr->value = trimmed_span(buf, (size_t)(colon - buf) + 1, eol);
+        hdr->id = lookup_header_id(buf + hdr->name.off, hdr->name.len);
+        if (hdr->id != SIP_HDR_OTHER && msg->first[hdr->id] < 0) {
+            msg->first[hdr->id] = (int8_t)msg->header_count;
+        }
+        msg->header_count++;
+        pos = next;
+    }
+
+    if (!headers_done) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Body, bounded by Content-Length when present
+    size_t body_len = len - pos;
+    const sip_header_t *cl = sip_message_get_header(msg, SIP_HDR_CONTENT_LENGTH);
+    if (cl != NULL) {
+        uint32_t declared = 0;
+        if (sip_span_to_u32(msg, cl->value, &declared) != ESP_OK) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (declared > body_len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        body_len = declared;
+    }
+    msg->body = make_span(pos, pos + body_len);
+
+    const sip_header_t *cseq = sip_message_get_header(msg, SIP_HDR_CSEQ);
+    if (cseq != NULL) {
+        ret = parse_cseq(msg, cseq->value);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    return ESP_OK;
+}
+
+const sip_header_t *sip_message_get_header(const sip_message_t *msg, sip_header_id_t id)
+{
+    if (msg == NULL || id <= SIP_HDR_OTHER || id >= SIP_HDR_COUNT || msg->first[id] < 0) {
+        return NULL;
+    }
+    return &msg->headers[msg->first[id]];
+}
+
+bool sip_span_equals(const sip_message_t *msg, sip_span_t span, const char *str)
+{
+    size_t len = strlen(str);
+    return span.len == len && memcmp(sip_span_ptr(msg, span), str, len) == 0;
+}
+
+bool sip_span_equals_nocase(const sip_message_t *msg, sip_span_t span, const char *str)
+{
+    size_t len = strlen(str);
+    return span.len == len && strncasecmp(sip_span_ptr(msg, span), str, len) == 0;
+}
+
+esp_err_t sip_span_to_u32(const sip_message_t *msg, sip_span_t span, uint32_t *out)
+{
+    const char *p = sip_span_ptr(msg, span);
+    uint32_t value = 0;
+
+    if (span.len == 0 || span.len > 10) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < span.len; i++) {
+        if (!isdigit((unsigned char)p[i])) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        value = value * 10 + (uint32_t)(p[i] - '0');
+    }
+    *out = value;
+    return ESP_OK;
+}
+
+esp_err_t sip_span_copy(const sip_message_t *msg, sip_span_t span, char *dst, size_t dst_size)
+{
+    if (dst == NULL || dst_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((size_t)span.len + 1 > dst_size) {
+        dst[0] = '\0';
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, sip_span_ptr(msg, span), span.len);
+    dst[span.len] = '\0';
+    return ESP_OK;
+}
+
+esp_err_t sip_message_get_param(const sip_message_t *msg, sip_span_t value,
+                                const char *name, sip_span_t *out)
+{
+    const char *p = sip_span_ptr(msg, value);
+    size_t name_len = strlen(name);
+    bool in_angle = false;
+    bool in_quote = false;
+
+    for (size_t i = 0; i < value.len; i++) {
+        char c = p[i];
+        if (in_quote) {
+            if (c == '"') {
+                in_quote = false;
+            }
+            continue;
+        }
+        if (c == '"') {
+            in_quote = true;
+        } else if (c == '<') {
+            in_angle = true;
+        } else if (c == '>') {
+            in_angle = false;
+        } else if (c == ';' && !in_angle) {
+            size_t start = i + 1;
+            while (start < value.len && is_ws(p[start])) {
+                start++;
+            }
+            if (value.len - start < name_len || strncasecmp(p + start, name, name_len) != 0) {
+                continue;
+            }
+            size_t after = start + name_len;
+            if (after < value.len && p[after] != '=' && p[after] != ';' && !is_ws(p[after])) {
+                continue;  // Longer parameter name with the same prefix
+            }
+            size_t val_start = after;
+            if (val_start < value.len && p[val_start] == '=') {
+                val_start++;
+            }
+            size_t val_end = val_start;
+            while (val_end < value.len && p[val_end] != ';' && p[val_end] != ',' && !is_ws(p[val_end])) {
+                val_end++;
+            }
+            *out = make_span(value.off + val_start, value.off + val_end);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+sip_span_t sip_message_get_uri(const sip_message_t *msg, sip_span_t value)
+{
+    const char *p = sip_span_ptr(msg, value);
+    const char *lt = memchr(p, '<', value.len);
+
+    if (lt != NULL) {
+        size_t start = (size_t)(lt - p) + 1;
+        const char *gt = memchr(p + start, '>', value.len - start);
+        size_t end = gt ? (size_t)(gt - p) : value.len;
+        return make_span(value.off + start, value.off + end);
+    }
+
+    // addr-spec form: URI parameters belong to the header, stop at ';'
+    size_t end = 0;
+    while (end < value.len && p[end] != ';' && !is_ws(p[end])) {
+        end++;
+    }
+    return make_span(value.off, value.off + end);
+}
+
+sip_method_t sip_method_from_string(const char *str, size_t len)
+{
+    for (size_t m = SIP_METHOD_REGISTER; m < sizeof(s_method_names) / sizeof(s_method_names[0]); m++) {
+        if (strlen(s_method_names[m]) == len && memcmp(s_method_names[m], str, len) == 0) {
+            return (sip_method_t)m;
+        }
+    }
+    return SIP_METHOD_UNKNOWN;
+}
+
+const char *sip_method_name(sip_method_t method)
+{
+    if ((size_t)method >= sizeof(s_method_names) / sizeof(s_method_names[0])) {
+        return s_method_names[SIP_METHOD_UNKNOWN];
+    }
+    return s_method_names[method];
+}
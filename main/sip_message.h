@@ -0,0 +1,176 @@
+#ifndef SIP_MESSAGE_H
+#define SIP_MESSAGE_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Maximum number of header lines tracked per message
+ */
+#define SIP_MESSAGE_MAX_HEADERS 32
+
+/**
+ * @brief Region of the receive buffer, stored as offset and length
+ *
+ * Spans never own memory: they are only valid while the buffer that was
+ * handed to sip_message_parse() is left untouched.
+ */
+typedef struct {
+    uint16_t off;
+    uint16_t len;
+} sip_span_t;
+
+/**
+ * @brief SIP request methods understood by the user agent
+ */
+typedef enum {
+    SIP_METHOD_UNKNOWN = 0,
+    SIP_METHOD_REGISTER,
+    SIP_METHOD_INVITE,
+    SIP_METHOD_ACK,
+    SIP_METHOD_BYE,
+    SIP_METHOD_CANCEL,
+    SIP_METHOD_OPTIONS,
+    SIP_METHOD_INFO
+} sip_method_t;
+
+/**
+ * @brief Well-known header identifiers (compact forms are mapped too)
+ */
+typedef enum {
+    SIP_HDR_OTHER = 0,
+    SIP_HDR_VIA,
+    SIP_HDR_FROM,
+    SIP_HDR_TO,
+    SIP_HDR_CALL_ID,
+    SIP_HDR_CSEQ,
+    SIP_HDR_CONTACT,
+    SIP_HDR_CONTENT_LENGTH,
+    SIP_HDR_CONTENT_TYPE,
+    SIP_HDR_EXPIRES,
+    SIP_HDR_WWW_AUTHENTICATE,
+    SIP_HDR_PROXY_AUTHENTICATE,
+    SIP_HDR_COUNT
+} sip_header_id_t;
+
+/**
+ * @brief One header line, tokenized in place
+ */
+typedef struct {
+    sip_header_id_t id;
+    sip_span_t name;
+    sip_span_t value;        ///< Value with surrounding whitespace trimmed
+} sip_header_t;
+
+/**
+ * @brief Parsed SIP message
+ *
+ * All textual fields are spans into the caller's buffer, so parsing a
+ * packet performs no heap allocation and copies nothing.
+ */
+typedef struct {
+    const char *buf;                        ///< Buffer the spans refer to
+    size_t len;                             ///< Length of the buffer
+    bool is_request;                        ///< true for requests, false for responses
+    sip_method_t method;                    ///< Request method (requests only)
+    sip_span_t method_name;                 ///< Raw method token (requests only)
+    sip_span_t request_uri;                 ///< Request-URI (requests only)
+    uint16_t status_code;                   ///< Status code (responses only)
+    sip_span_t reason;                      ///< Reason phrase (responses only)
+    uint32_t cseq;                          ///< CSeq sequence number
+    sip_method_t cseq_method;               ///< CSeq method
+    sip_header_t headers[SIP_MESSAGE_MAX_HEADERS];
+    uint8_t header_count;
+    int8_t first[SIP_HDR_COUNT];            ///< Index of first header per id, -1 if absent
+    sip_span_t body;                        ///< Message body (may be empty)
+} sip_message_t;
+
+/**
+ * @brief Parse a SIP message in place
+ *
+ * @param buf Buffer holding one complete datagram
+ * @param len Number of valid bytes in buf
+ * @param msg Message structure to fill
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for malformed input,
+ *         ESP_ERR_INVALID_SIZE if the body is truncated or too many headers
+ */
+esp_err_t sip_message_parse(const char *buf, size_t len, sip_message_t *msg);
+
+/**
+ * @brief Get first header with the given id
+ *
+ * @return Header or NULL if not present
+ */
+const sip_header_t *sip_message_get_header(const sip_message_t *msg, sip_header_id_t id);
+
+/**
+ * @brief Get pointer to the first byte of a span
+ */
+static inline const char *sip_span_ptr(const sip_message_t *msg, sip_span_t span)
+{
+    return msg->buf + span.off;
+}
+
+/**
+ * @brief Compare span with a NUL-terminated string (case sensitive)
+ */
+bool sip_span_equals(const sip_message_t *msg, sip_span_t span, const char *str);
+
+/**
+ * @brief Compare span with a NUL-terminated string (case insensitive)
+ */
+bool sip_span_equals_nocase(const sip_message_t *msg, sip_span_t span, const char *str);
+
+/**
+ * @brief Parse a span as an unsigned decimal number
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if span is not a number
+ */
+esp_err_t sip_span_to_u32(const sip_message_t *msg, sip_span_t span, uint32_t *out);
+
+/**
+ * @brief Copy span into a NUL-terminated string
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if dst is too small
+ */
+esp_err_t sip_span_copy(const sip_message_t *msg, sip_span_t span, char *dst, size_t dst_size);
+
+/**
+ * @brief Find a ";name=value" parameter in a header value
+ *
+ * Parameters inside a <...> name-addr are ignored, so the tag of a From/To
+ * header is found even when the URI carries parameters of its own.
+ *
+ * @return ESP_OK if found, ESP_ERR_NOT_FOUND otherwise
+ */
+esp_err_t sip_message_get_param(const sip_message_t *msg, sip_span_t value,
+                                const char *name, sip_span_t *out);
+
+/**
+ * @brief Extract the URI from a name-addr or addr-spec header value
+ *
+ * "Alice" <sip:alice@host>;tag=1 yields sip:alice@host.
+ */
+sip_span_t sip_message_get_uri(const sip_message_t *msg, sip_span_t value);
+
+/**
+ * @brief Map a method token to sip_method_t
+ */
+sip_method_t sip_method_from_string(const char *str, size_t len);
+
+/**
+ * @brief Get the canonical name of a method
+ */
+const char *sip_method_name(sip_method_t method);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIP_MESSAGE_H
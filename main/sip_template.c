@@ -0,0 +1,163 @@
+#include "sip_template.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NO_FIELD    UINT16_MAX
+
+void sip_template_begin(sip_template_t *tpl)
+{
+    tpl->len = 0;
+    tpl->auth_off = 0;
+    tpl->complete = false;
+    tpl->overflow = false;
+    for (int i = 0; i < SIP_TEMPLATE_FIELD_COUNT; i++) {
+        tpl->field_off[i] = NO_FIELD;
+        tpl->field_width[i] = 0;
+    }
+    tpl->text[0] = '\0';
+}
+
+void sip_template_append(sip_template_t *tpl, const char *fmt, ...)
+{
+    if (tpl->overflow) {
+        return;
+    }
+    size_t room = sizeof(tpl->text) - tpl->len;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(tpl->text + tpl->len, room, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= room) {
+        tpl->overflow = true;
+        return;
+    }
+    tpl->len += (uint16_t)n;
+}
+
+void sip_template_field(sip_template_t *tpl, sip_template_field_t field, uint8_t width)
+{
+    if (tpl->overflow || field >= SIP_TEMPLATE_FIELD_COUNT) {
+        return;
+    }
+    if ((size_t)tpl->len + width >= sizeof(tpl->text)) {
+        tpl->overflow = true;
+        return;
+    }
+    // Placeholder is only visible if a slot is never patched
+    memset(tpl->text + tpl->len, '-', width);
+    tpl->field_off[field] = tpl->len;
+    tpl->field_width[field] = width;
+    tpl->len += width;
+    tpl->text[tpl->len] = '\0';
+}
+
+esp_err_t sip_template_end(sip_template_t *tpl)
+{
+    tpl->auth_off = tpl->len;
+    sip_template_append(tpl, "Content-Length: ");
+    sip_template_field(tpl, SIP_TEMPLATE_FIELD_CONTENT_LENGTH, SIP_TEMPLATE_LENGTH_WIDTH);
+    sip_template_append(tpl, "\r\n\r\n");
+
+    if (tpl->overflow) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    tpl->complete = true;
+    return ESP_OK;
+}
+
+static esp_err_t write_string(char *slot, uint8_t width, const char *value)
+{
+    if (value == NULL || strlen(value) != width) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(slot, value, width);
+    return ESP_OK;
+}
+
+/**
+ * @brief Write a number right-aligned in its slot
+ */
+static esp_err_t write_number(char *slot, uint8_t width, uint32_t value)
+{
+    int pos = width;
+
+    do {
+        if (pos == 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        slot[--pos] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    memset(slot, ' ', (size_t)pos);
+    return ESP_OK;
+}
+
+esp_err_t sip_template_render(const sip_template_t *tpl, const sip_template_values_t *values,
+                              char *out, size_t size, size_t *out_len)
+{
+    if (tpl == NULL || values == NULL || out == NULL || !tpl->complete) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t auth_len = values->auth ? strlen(values->auth) : 0;
+    size_t body_len = values->body ? values->body_len : 0;
+    size_t total = tpl->len + auth_len + body_len;
+    if (total > size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(out, tpl->text, tpl->auth_off);
+    if (auth_len > 0) {
+        memcpy(out + tpl->auth_off, values->auth, auth_len);
+    }
+    memcpy(out + tpl->auth_off + auth_len, tpl->text + tpl->auth_off, tpl->len - tpl->auth_off);
+    if (body_len > 0) {
+        memcpy(out + tpl->len + auth_len, values->body, body_len);
+    }
+
+    esp_err_t ret = ESP_OK;
+    for (int i = 0; i < SIP_TEMPLATE_FIELD_COUNT && ret == ESP_OK; i++) {
+        if (tpl->field_off[i] == NO_FIELD) {
+            continue;
+        }
+        size_t off = tpl->field_off[i];
+        if (off >= tpl->auth_off) {
+            off += auth_len;
+        }
+        char *slot = out + off;
+        uint8_t width = tpl->field_width[i];
+
+        switch ((sip_template_field_t)i) {
+            case SIP_TEMPLATE_FIELD_BRANCH:
+                ret = write_string(slot, width, values->branch);
+                break;
+            case SIP_TEMPLATE_FIELD_TAG:
+                ret = write_string(slot, width, values->tag);
+                break;
+            case SIP_TEMPLATE_FIELD_CALL_ID:
+                ret = write_string(slot, width, values->call_id);
+                break;
+            case SIP_TEMPLATE_FIELD_CSEQ:
+                ret = write_number(slot, width, values->cseq);
+                break;
+            case SIP_TEMPLATE_FIELD_EXPIRES:
+                ret = write_number(slot, width, values->expires);
+                break;
+            case SIP_TEMPLATE_FIELD_CONTENT_LENGTH:
+                ret = write_number(slot, width, (uint32_t)body_len);
+                break;
+            default:
+                break;
+        }
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (out_len != NULL) {
+        *out_len = total;
+    }
+    return ESP_OK;
+}
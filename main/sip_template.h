@@ -0,0 +1,117 @@
+#ifndef SIP_TEMPLATE_H
+#define SIP_TEMPLATE_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Largest pre-rendered request (headers only, body is appended)
+ */
+#define SIP_TEMPLATE_MAX_SIZE       768
+
+/**
+ * @brief Slot widths for the numeric fields
+ *
+ * Numbers are right-aligned and padded with spaces, which the SIP grammar
+ * allows as linear whitespace after the header colon.
+ */
+#define SIP_TEMPLATE_CSEQ_WIDTH     10
+#define SIP_TEMPLATE_EXPIRES_WIDTH  10
+#define SIP_TEMPLATE_LENGTH_WIDTH   5
+
+/**
+ * @brief Per-message fields patched into a template
+ */
+typedef enum {
+    SIP_TEMPLATE_FIELD_BRANCH,
+    SIP_TEMPLATE_FIELD_TAG,
+    SIP_TEMPLATE_FIELD_CALL_ID,
+    SIP_TEMPLATE_FIELD_CSEQ,
+    SIP_TEMPLATE_FIELD_EXPIRES,
+    SIP_TEMPLATE_FIELD_CONTENT_LENGTH,
+    SIP_TEMPLATE_FIELD_COUNT
+} sip_template_field_t;
+
+/**
+ * @brief Request rendered once with fixed-width slots for its variable fields
+ *
+ * Authorization headers are inserted right before Content-Length, which is
+ * always the last header; slots behind the insertion point shift by its length.
+ */
+typedef struct {
+    uint16_t len;
+    uint16_t auth_off;                              ///< Insertion point for auth headers
+    uint16_t field_off[SIP_TEMPLATE_FIELD_COUNT];   ///< UINT16_MAX when the field is absent
+    uint8_t field_width[SIP_TEMPLATE_FIELD_COUNT];
+    bool complete;
+    bool overflow;
+    char text[SIP_TEMPLATE_MAX_SIZE];
+} sip_template_t;
+
+/**
+ * @brief Values for one rendering
+ *
+ * String fields must be exactly as long as their slot.
+ */
+typedef struct {
+    const char *branch;
+    const char *tag;
+    const char *call_id;
+    uint32_t cseq;
+    uint32_t expires;
+    const char *auth;           ///< Complete header line(s) with CRLF, or NULL
+    const char *body;
+    size_t body_len;
+} sip_template_values_t;
+
+/**
+ * @brief Start compiling a template
+ */
+void sip_template_begin(sip_template_t *tpl);
+
+/**
+ * @brief Append constant text, formatted once at compile time
+ */
+void sip_template_append(sip_template_t *tpl, const char *fmt, ...);
+
+/**
+ * @brief Reserve a slot for a per-message field
+ *
+ * @param tpl Template being compiled
+ * @param field Field to reserve
+ * @param width Slot width in characters
+ */
+void sip_template_field(sip_template_t *tpl, sip_template_field_t field, uint8_t width);
+
+/**
+ * @brief Finish the template with the Content-Length header and blank line
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_SIZE if the text did not fit
+ */
+esp_err_t sip_template_end(sip_template_t *tpl);
+
+/**
+ * @brief Render a message: one copy of the template plus the slot writes
+ *
+ * @param tpl Compiled template
+ * @param values Field values, auth header and body
+ * @param out Output buffer
+ * @param size Size of out
+ * @param out_len Length of the rendered message
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if a value does not fit its slot,
+ *         ESP_ERR_INVALID_SIZE if out is too small
+ */
+esp_err_t sip_template_render(const sip_template_t *tpl, const sip_template_values_t *values,
+                              char *out, size_t size, size_t *out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIP_TEMPLATE_H
@@ -0,0 +1,135 @@
+#include "sip_timer_wheel.h"
+#include <string.h>
+
+#define SLOT_MASK           (SIP_TIMER_SLOTS - 1)
+#define LEVEL_SHIFT(level)  ((level) * SIP_TIMER_SLOT_BITS)
+#define MAX_DELAY           ((1u << (SIP_TIMER_LEVELS * SIP_TIMER_SLOT_BITS)) - 1)
+
+static void link_timer(sip_timer_t **head, sip_timer_t *timer)
+{
+    timer->next = *head;
+    if (*head != NULL) {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+static void unlink_timer(sip_timer_t *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/**
+ * @brief Put a timer in the slot matching its distance from now
+ */
+static void enqueue(sip_timer_wheel_t *wheel, sip_timer_t *timer)
+{
+    uint32_t delta = timer->expires - wheel->now;
+
+    if ((int32_t)delta < 0) {
+        // Already due: fire on the next tick
+        link_timer(&wheel->slots[0][(wheel->now + 1) & SLOT_MASK], timer);
+        return;
+    }
+
+    for (int level = 0; level < SIP_TIMER_LEVELS; level++) {
+        if (delta < (1u << LEVEL_SHIFT(level + 1))) {
+            uint32_t slot = (timer->expires >> LEVEL_SHIFT(level)) & SLOT_MASK;
+            link_timer(&wheel->slots[level][slot], timer);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Redistribute one slot of a higher level into the levels below
+ *
+ * @return Slot index that was cascaded (0 means the next level is due too)
+ */
+static uint32_t cascade(sip_timer_wheel_t *wheel, int level)
+{
+    uint32_t slot = (wheel->now >> LEVEL_SHIFT(level)) & SLOT_MASK;
+    sip_timer_t *list = wheel->slots[level][slot];
+
+    wheel->slots[level][slot] = NULL;
+    while (list != NULL) {
+        sip_timer_t *timer = list;
+        list = timer->next;
+        timer->next = NULL;
+        timer->pprev = NULL;
+        enqueue(wheel, timer);
+    }
+    return slot;
+}
+
+void sip_timer_wheel_init(sip_timer_wheel_t *wheel, uint32_t now_tick)
+{
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->now = now_tick;
+}
+
+void sip_timer_wheel_advance(sip_timer_wheel_t *wheel, uint32_t now_tick)
+{
+    while ((int32_t)(now_tick - wheel->now) > 0) {
+        wheel->now++;
+        uint32_t index = wheel->now & SLOT_MASK;
+
+        if (index == 0) {
+            for (int level = 1; level < SIP_TIMER_LEVELS; level++) {
+                if (cascade(wheel, level) != 0) {
+                    break;
+                }
+            }
+        }
+
+        // Detach the slot so callbacks can re-arm timers into it safely
+        sip_timer_t *expired = wheel->slots[0][index];
+        wheel->slots[0][index] = NULL;
+        if (expired != NULL) {
+            expired->pprev = &expired;
+        }
+
+        while (expired != NULL) {
+            sip_timer_t *timer = expired;
+            unlink_timer(timer);
+            timer->callback(timer, timer->arg);
+        }
+    }
+}
+
+void sip_timer_init(sip_timer_t *timer, sip_timer_callback_t callback, void *arg)
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires = 0;
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+void sip_timer_start(sip_timer_wheel_t *wheel, sip_timer_t *timer, uint32_t delay_ticks)
+{
+    if (sip_timer_is_active(timer)) {
+        unlink_timer(timer);
+    }
+    // A zero delay would land in the current slot and wait a full turn
+    if (delay_ticks == 0) {
+        delay_ticks = 1;
+    } else if (delay_ticks > MAX_DELAY) {
+        delay_ticks = MAX_DELAY;
+    }
+    timer->expires = wheel->now + delay_ticks;
+    enqueue(wheel, timer);
+}
+
+void sip_timer_stop(sip_timer_t *timer)
+{
+    if (sip_timer_is_active(timer)) {
+        unlink_timer(timer);
+    }
+}
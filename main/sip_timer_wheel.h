@@ -0,0 +1,97 @@
+#ifndef SIP_TIMER_WHEEL_H
+#define SIP_TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Wheel geometry: 3 levels of 64 slots at 10 ms per tick
+ *
+ * Level 0 covers 640 ms, level 1 about 41 s and level 2 about 43 min.
+ * Longer delays are clamped to the wheel span.
+ */
+#define SIP_TIMER_TICK_MS       10
+#define SIP_TIMER_SLOT_BITS     6
+#define SIP_TIMER_SLOTS         (1u << SIP_TIMER_SLOT_BITS)
+#define SIP_TIMER_LEVELS        3
+
+typedef struct sip_timer sip_timer_t;
+
+/**
+ * @brief Timer expiry callback, runs from sip_timer_wheel_advance()
+ */
+typedef void (*sip_timer_callback_t)(sip_timer_t *timer, void *arg);
+
+/**
+ * @brief Timer node, embedded by its owner (no allocation)
+ */
+struct sip_timer {
+    sip_timer_t *next;
+    sip_timer_t **pprev;         ///< Link pointing at this node, NULL when idle
+    uint32_t expires;            ///< Absolute expiry tick
+    sip_timer_callback_t callback;
+    void *arg;
+};
+
+/**
+ * @brief Hierarchical timer wheel
+ *
+ * Start and stop are O(1); advancing costs one slot per elapsed tick plus
+ * an occasional cascade of a higher level slot.
+ */
+typedef struct {
+    uint32_t now;                ///< Last tick processed
+    sip_timer_t *slots[SIP_TIMER_LEVELS][SIP_TIMER_SLOTS];
+} sip_timer_wheel_t;
+
+/**
+ * @brief Initialize wheel at the given tick
+ */
+void sip_timer_wheel_init(sip_timer_wheel_t *wheel, uint32_t now_tick);
+
+/**
+ * @brief Run every timer that expired up to and including now_tick
+ */
+void sip_timer_wheel_advance(sip_timer_wheel_t *wheel, uint32_t now_tick);
+
+/**
+ * @brief Convert milliseconds to wheel ticks, rounding up
+ */
+static inline uint32_t sip_timer_ms_to_ticks(uint32_t ms)
+{
+    return (ms + SIP_TIMER_TICK_MS - 1) / SIP_TIMER_TICK_MS;
+}
+
+/**
+ * @brief Prepare a timer node before first use
+ */
+void sip_timer_init(sip_timer_t *timer, sip_timer_callback_t callback, void *arg);
+
+/**
+ * @brief Arm (or re-arm) a timer to fire after delay_ticks
+ */
+void sip_timer_start(sip_timer_wheel_t *wheel, sip_timer_t *timer, uint32_t delay_ticks);
+
+/**
+ * @brief Disarm a timer, harmless if it is not armed
+ */
+void sip_timer_stop(sip_timer_t *timer);
+
+/**
+ * @brief Check whether a timer is armed
+ */
+static inline bool sip_timer_is_active(const sip_timer_t *timer)
+{
+    return timer->pprev != NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIP_TIMER_WHEEL_H
@@ -0,0 +1,397 @@
+#include "sip_tls.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/platform_util.h"
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "sip_tls";
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define SIP_TLS_MASTER_SECRET_LEN 48
+
+struct sip_tls {
+    mbedtls_ssl_config conf;
+    mbedtls_x509_crt ca;
+    bool bundle_attached;
+    char server_name[64];
+
+    // Session offered on the next handshake and the master secret it carries.
+    // A handshake that ends up with the same secret was resumed.
+    mbedtls_ssl_session session;
+    bool has_session;
+    unsigned char session_master[SIP_TLS_MASTER_SECRET_LEN];
+
+    portMUX_TYPE stats_lock;
+    sip_tls_stats_t stats;
+};
+
+struct sip_tls_conn {
+    mbedtls_ssl_context ssl;
+    int sock;
+    SemaphoreHandle_t lock;     ///< mbedTLS contexts are not safe for concurrent read and write
+    unsigned char master[SIP_TLS_MASTER_SECRET_LEN];
+    bool has_master;
+};
+
+// The hardware RNG is a CSPRNG while the radio is on, which it is whenever SIP runs
+static int tls_random(void *ctx, unsigned char *buf, size_t len)
+{
+    esp_fill_random(buf, len);
+    return 0;
+}
+
+static int bio_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    sip_tls_conn_t *conn = (sip_tls_conn_t *)ctx;
+
+    int sent = send(conn->sock, buf, len, MSG_NOSIGNAL);
+    if (sent < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? MBEDTLS_ERR_SSL_WANT_WRITE :
+               MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+    return sent;
+}
+
+static int bio_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    sip_tls_conn_t *conn = (sip_tls_conn_t *)ctx;
+
+    int received = recv(conn->sock, buf, len, 0);
+    if (received < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? MBEDTLS_ERR_SSL_WANT_READ :
+               MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+    return received;    // 0 is end of stream to mbedTLS
+}
+
+/**
+ * @brief Keep the TLS 1.2 master secret to tell a resumed handshake from a full one
+ */
+static void export_keys(void *ctx, mbedtls_ssl_key_export_type type,
+                        const unsigned char *secret, size_t secret_len,
+                        const unsigned char client_random[32],
+                        const unsigned char server_random[32],
+                        mbedtls_tls_prf_types tls_prf_type)
+{
+    sip_tls_conn_t *conn = (sip_tls_conn_t *)ctx;
+
+    if (type == MBEDTLS_SSL_KEY_EXPORT_TLS12_MASTER_SECRET && secret_len == sizeof(conn->master)) {
+        memcpy(conn->master, secret, secret_len);
+        conn->has_master = true;
+    }
+}
+
+/**
+ * @brief Wait until the socket can be read or written
+ */
+static void wait_socket(int sock, bool for_write, uint32_t timeout_ms)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000
+    };
+    select(sock + 1, for_write ? NULL : &fds, for_write ? &fds : NULL, NULL, &tv);
+}
+
+static uint32_t elapsed_ms(int64_t start_us)
+{
+    return (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+}
+
+static int configure_trust(sip_tls_t *tls, const char *ca_pem)
+{
+    if (ca_pem != NULL) {
+        int ret = mbedtls_x509_crt_parse(&tls->ca, (const unsigned char *)ca_pem, strlen(ca_pem) + 1);
+        if (ret < 0) {
+            return ret;
+        }
+        mbedtls_ssl_conf_ca_chain(&tls->conf, &tls->ca, NULL);
+        mbedtls_ssl_conf_authmode(&tls->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        return 0;
+    }
+
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    if (esp_crt_bundle_attach(&tls->conf) == ESP_OK) {
+        tls->bundle_attached = true;
+        mbedtls_ssl_conf_authmode(&tls->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        return 0;
+    }
+#endif
+
+    ESP_LOGW(TAG, "No CA configured, the certificate of %s is not verified", tls->server_name);
+    mbedtls_ssl_conf_authmode(&tls->conf, MBEDTLS_SSL_VERIFY_NONE);
+    return 0;
+}
+
+static void forget_session(sip_tls_t *tls)
+{
+    mbedtls_ssl_session_free(&tls->session);
+    mbedtls_ssl_session_init(&tls->session);
+    mbedtls_platform_zeroize(tls->session_master, sizeof(tls->session_master));
+    tls->has_session = false;
+}
+
+static void save_session(sip_tls_t *tls, sip_tls_conn_t *conn)
+{
+    forget_session(tls);
+    if (conn->has_master && mbedtls_ssl_get_session(&conn->ssl, &tls->session) == 0) {
+        memcpy(tls->session_master, conn->master, sizeof(tls->session_master));
+        tls->has_session = true;
+    }
+}
+
+esp_err_t sip_tls_create(const char *server_name, const char *ca_pem, sip_tls_t **out)
+{
+    if (server_name == NULL || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sip_tls_t *tls = calloc(1, sizeof(*tls));
+    if (tls == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    mbedtls_ssl_config_init(&tls->conf);
+    mbedtls_x509_crt_init(&tls->ca);
+    mbedtls_ssl_session_init(&tls->session);
+    portMUX_INITIALIZE(&tls->stats_lock);
+    strncpy(tls->server_name, server_name, sizeof(tls->server_name) - 1);
+
+    int ret = mbedtls_ssl_config_defaults(&tls->conf, MBEDTLS_SSL_IS_CLIENT,
+                                          MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret == 0) {
+        // TLS 1.2 resumes from both session IDs and RFC 5077 tickets inside the handshake;
+        // TLS 1.3 tickets only arrive after it and are not offered by many SIP servers
+        mbedtls_ssl_conf_max_tls_version(&tls->conf, MBEDTLS_SSL_VERSION_TLS1_2);
+        mbedtls_ssl_conf_rng(&tls->conf, tls_random, NULL);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_conf_session_tickets(&tls->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+        ret = configure_trust(tls, ca_pem);
+    }
+    if (ret != 0) {
+        ESP_LOGE(TAG, "TLS setup failed: -0x%04x", (unsigned)-ret);
+        sip_tls_destroy(tls);
+        return ESP_FAIL;
+    }
+
+    *out = tls;
+    return ESP_OK;
+}
+
+void sip_tls_destroy(sip_tls_t *tls)
+{
+    if (tls == NULL) {
+        return;
+    }
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    if (tls->bundle_attached) {
+        esp_crt_bundle_detach(&tls->conf);
+    }
+#endif
+    forget_session(tls);
+    mbedtls_x509_crt_free(&tls->ca);
+    mbedtls_ssl_config_free(&tls->conf);
+    free(tls);
+}
+
+static void free_conn(sip_tls_conn_t *conn)
+{
+    mbedtls_ssl_free(&conn->ssl);
+    if (conn->lock != NULL) {
+        vSemaphoreDelete(conn->lock);
+    }
+    mbedtls_platform_zeroize(conn->master, sizeof(conn->master));
+    free(conn);
+}
+
+static int run_handshake(sip_tls_conn_t *conn, int64_t start_us)
+{
+    int ret;
+
+    while ((ret = mbedtls_ssl_handshake(&conn->ssl)) != 0) {
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return ret;
+        }
+        uint32_t elapsed = elapsed_ms(start_us);
+        if (elapsed >= SIP_TLS_HANDSHAKE_TIMEOUT_MS) {
+            return MBEDTLS_ERR_SSL_TIMEOUT;
+        }
+        wait_socket(conn->sock, ret == MBEDTLS_ERR_SSL_WANT_WRITE, SIP_TLS_HANDSHAKE_TIMEOUT_MS - elapsed);
+    }
+    return 0;
+}
+
+esp_err_t sip_tls_handshake(sip_tls_t *tls, int sock, sip_tls_conn_t **out)
+{
+    if (tls == NULL || sock < 0 || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sip_tls_conn_t *conn = calloc(1, sizeof(*conn));
+    if (conn == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    mbedtls_ssl_init(&conn->ssl);
+    conn->sock = sock;
+    conn->lock = xSemaphoreCreateMutex();
+    if (conn->lock == NULL) {
+        free_conn(conn);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Reads must not stall the SIP task and the handshake needs a deadline
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+    int64_t start_us = esp_timer_get_time();
+    bool offered = false;
+    int ret = mbedtls_ssl_setup(&conn->ssl, &tls->conf);
+    if (ret == 0) {
+        ret = mbedtls_ssl_set_hostname(&conn->ssl, tls->server_name);
+    }
+    if (ret == 0) {
+        mbedtls_ssl_set_bio(&conn->ssl, conn, bio_send, bio_recv, NULL);
+        mbedtls_ssl_set_export_keys_cb(&conn->ssl, export_keys, conn);
+        offered = tls->has_session && mbedtls_ssl_set_session(&conn->ssl, &tls->session) == 0;
+        ret = run_handshake(conn, start_us);
+    }
+    uint32_t duration_ms = elapsed_ms(start_us);
+
+    if (ret != 0) {
+        ESP_LOGW(TAG, "TLS handshake with %s failed after %lu ms: -0x%04x",
+                 tls->server_name, (unsigned long)duration_ms, (unsigned)-ret);
+        // A session the server chokes on must not spoil the next attempt
+        if (offered) {
+            forget_session(tls);
+        }
+        portENTER_CRITICAL(&tls->stats_lock);
+        tls->stats.failed_handshakes++;
+        portEXIT_CRITICAL(&tls->stats_lock);
+        free_conn(conn);
+        return ret == MBEDTLS_ERR_SSL_TIMEOUT ? ESP_ERR_TIMEOUT : ESP_FAIL;
+    }
+
+    bool resumed = offered && conn->has_master &&
+                   memcmp(conn->master, tls->session_master, sizeof(conn->master)) == 0;
+    save_session(tls, conn);
+
+    portENTER_CRITICAL(&tls->stats_lock);
+    if (resumed) {
+        tls->stats.resumed_handshakes++;
+        tls->stats.resumed_handshake_ms = duration_ms;
+    } else {
+        tls->stats.full_handshakes++;
+        tls->stats.full_handshake_ms = duration_ms;
+    }
+    portEXIT_CRITICAL(&tls->stats_lock);
+
+    ESP_LOGI(TAG, "TLS %s handshake with %s in %lu ms, %s", resumed ? "resumed" : "full",
+             tls->server_name, (unsigned long)duration_ms, mbedtls_ssl_get_ciphersuite(&conn->ssl));
+    *out = conn;
+    return ESP_OK;
+}
+
+esp_err_t sip_tls_read(sip_tls_conn_t *conn, char *buf, size_t size, size_t *out_len)
+{
+    if (conn == NULL || buf == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(conn->lock, portMAX_DELAY);
+    int ret = mbedtls_ssl_read(&conn->ssl, (unsigned char *)buf, size);
+    xSemaphoreGive(conn->lock);
+
+    if (ret > 0) {
+        *out_len = (size_t)ret;
+        return ESP_OK;
+    }
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (ret == 0 || ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+        ESP_LOGW(TAG, "Server closed the TLS session");
+    } else {
+        ESP_LOGW(TAG, "TLS read failed: -0x%04x", (unsigned)-ret);
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t sip_tls_write(sip_tls_conn_t *conn, const char *data, size_t len)
+{
+    if (conn == NULL || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    size_t offset = 0;
+
+    while (offset < len) {
+        xSemaphoreTake(conn->lock, portMAX_DELAY);
+        int ret = mbedtls_ssl_write(&conn->ssl, (const unsigned char *)data + offset, len - offset);
+        xSemaphoreGive(conn->lock);
+
+        if (ret > 0) {
+            offset += (size_t)ret;
+            continue;
+        }
+        uint32_t elapsed = elapsed_ms(start_us);
+        if ((ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_WANT_READ) ||
+            elapsed >= SIP_TLS_WRITE_TIMEOUT_MS) {
+            ESP_LOGW(TAG, "TLS write failed: -0x%04x", (unsigned)-ret);
+            return ESP_FAIL;
+        }
+        // mbedTLS keeps the pending record; the retry with the same data flushes it
+        wait_socket(conn->sock, ret == MBEDTLS_ERR_SSL_WANT_WRITE, SIP_TLS_WRITE_TIMEOUT_MS - elapsed);
+    }
+    return ESP_OK;
+}
+
+size_t sip_tls_pending(sip_tls_conn_t *conn)
+{
+    if (conn == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(conn->lock, portMAX_DELAY);
+    size_t pending = mbedtls_ssl_get_bytes_avail(&conn->ssl);
+    xSemaphoreGive(conn->lock);
+    return pending;
+}
+
+void sip_tls_close(sip_tls_conn_t *conn)
+{
+    if (conn == NULL) {
+        return;
+    }
+    // Best effort on a non-blocking socket
+    mbedtls_ssl_close_notify(&conn->ssl);
+    free_conn(conn);
+}
+
+void sip_tls_get_stats(sip_tls_t *tls, sip_tls_stats_t *stats)
+{
+    if (tls == NULL || stats == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&tls->stats_lock);
+    *stats = tls->stats;
+    portEXIT_CRITICAL(&tls->stats_lock);
+}
@@ -0,0 +1,117 @@
+#ifndef SIP_TLS_H
+#define SIP_TLS_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Time allowed for a TLS handshake, on top of the TCP connect
+ */
+#define SIP_TLS_HANDSHAKE_TIMEOUT_MS 10000
+
+/**
+ * @brief Time a write may wait for the socket to drain
+ */
+#define SIP_TLS_WRITE_TIMEOUT_MS 3000
+
+/**
+ * @brief TLS client for one server
+ *
+ * Lives as long as the transport: holds the configuration, the trust
+ * anchors and the session of the last connection, which the next
+ * handshake offers for resumption.
+ */
+typedef struct sip_tls sip_tls_t;
+
+/**
+ * @brief One TLS session over a connected socket
+ */
+typedef struct sip_tls_conn sip_tls_conn_t;
+
+/**
+ * @brief Handshake counters
+ */
+typedef struct {
+    uint32_t full_handshakes;           ///< Handshakes with a full key exchange
+    uint32_t resumed_handshakes;        ///< Handshakes that resumed the cached session
+    uint32_t failed_handshakes;
+    uint32_t full_handshake_ms;         ///< Duration of the last full handshake
+    uint32_t resumed_handshake_ms;      ///< Duration of the last resumed handshake
+} sip_tls_stats_t;
+
+/**
+ * @brief Create a TLS client
+ *
+ * The server certificate is checked against ca_pem, or against the
+ * certificate bundle when ca_pem is NULL and the bundle is enabled in
+ * menuconfig. Without either it is not verified.
+ *
+ * @param server_name Name sent as SNI and matched against the certificate
+ * @param ca_pem CA certificate(s) in PEM, NULL for the bundle
+ * @param tls Created client
+ * @return ESP_OK, ESP_ERR_NO_MEM, ESP_FAIL if ca_pem does not parse
+ */
+esp_err_t sip_tls_create(const char *server_name, const char *ca_pem, sip_tls_t **tls);
+
+/**
+ * @brief Free a TLS client and its cached session
+ */
+void sip_tls_destroy(sip_tls_t *tls);
+
+/**
+ * @brief Run a handshake on a connected TCP socket
+ *
+ * Offers the cached session (ID or ticket) so a reconnect skips the key
+ * exchange, and caches the resulting session for the next one. A failed
+ * handshake drops the cached session. The socket is switched to
+ * non-blocking mode and stays owned by the caller.
+ *
+ * @param tls TLS client
+ * @param sock Connected socket
+ * @param conn TLS session on the socket
+ * @return ESP_OK, ESP_ERR_TIMEOUT after SIP_TLS_HANDSHAKE_TIMEOUT_MS,
+ *         ESP_FAIL if the handshake or the certificate check failed
+ */
+esp_err_t sip_tls_handshake(sip_tls_t *tls, int sock, sip_tls_conn_t **conn);
+
+/**
+ * @brief Read decrypted bytes, never blocks
+ *
+ * @return ESP_OK with data, ESP_ERR_TIMEOUT if no whole record is
+ *         available yet, ESP_FAIL if the session was closed or broke
+ */
+esp_err_t sip_tls_read(sip_tls_conn_t *conn, char *buf, size_t size, size_t *out_len);
+
+/**
+ * @brief Write all of data, waiting up to SIP_TLS_WRITE_TIMEOUT_MS for the socket
+ *
+ * Safe to call while another task reads the same session.
+ */
+esp_err_t sip_tls_write(sip_tls_conn_t *conn, const char *data, size_t len);
+
+/**
+ * @brief Decrypted bytes buffered in the session, which select() does not see
+ */
+size_t sip_tls_pending(sip_tls_conn_t *conn);
+
+/**
+ * @brief Send close_notify and free the session; the socket is left open
+ */
+void sip_tls_close(sip_tls_conn_t *conn);
+
+/**
+ * @brief Get handshake counters
+ */
+void sip_tls_get_stats(sip_tls_t *tls, sip_tls_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIP_TLS_H
@@ -0,0 +1,477 @@
+#include "sip_transaction.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "sip_transaction";
+
+#define TICKS(ms)               sip_timer_ms_to_ticks(ms)
+#define TIMER_64_T1_TICKS       TICKS(64 * SIP_TIMER_T1_MS)
+#define TIMER_D_MS              32000
+
+static inline uint32_t ms_to_wheel_tick(int64_t now_ms)
+{
+    return (uint32_t)(now_ms / SIP_TIMER_TICK_MS);
+}
+
+static void terminate(sip_transaction_t *tx)
+{
+    sip_timer_stop(&tx->retransmit_timer);
+    sip_timer_stop(&tx->timeout_timer);
+    tx->state = SIP_TRANSACTION_STATE_TERMINATED;
+    tx->in_use = false;
+    sip_arena_release(&tx->arena);
+    tx->msg = NULL;
+    tx->msg_len = 0;
+    ESP_LOGD(TAG, "%s transaction %s terminated", sip_method_name(tx->method), tx->branch);
+}
+
+static void resend(sip_transaction_t *tx)
+{
+    if (tx->msg_len > 0) {
+        tx->layer->user.send(tx->layer->user.ctx, tx->msg, tx->msg_len);
+    }
+}
+
+/**
+ * @brief Arm a wait timer, or terminate at once when its value is zero
+ *
+ * Timers D, I, J and K collapse to zero on reliable transports.
+ */
+static void wait_or_terminate(sip_transaction_t *tx, uint32_t ticks)
+{
+    if (tx->layer->reliable || ticks == 0) {
+        terminate(tx);
+        return;
+    }
+    sip_timer_start(&tx->layer->wheel, &tx->timeout_timer, ticks);
+}
+
+static void start_retransmit(sip_transaction_t *tx, uint32_t ticks)
+{
+    if (tx->layer->reliable) {
+        return;
+    }
+    tx->retransmit_ticks = ticks;
+    sip_timer_start(&tx->layer->wheel, &tx->retransmit_timer, ticks);
+}
+
+/**
+ * @brief Timer A (ICT), Timer E (NICT) and Timer G (IST)
+ */
+static void retransmit_timer_callback(sip_timer_t *timer, void *arg)
+{
+    sip_transaction_t *tx = (sip_transaction_t *)arg;
+    uint32_t next = tx->retransmit_ticks * 2;
+    const uint32_t t2 = TICKS(SIP_TIMER_T2_MS);
+
+    switch (tx->kind) {
+        case SIP_TRANSACTION_INVITE_CLIENT:
+            if (tx->state != SIP_TRANSACTION_STATE_CALLING) {
+                return;
+            }
+            break;
+        case SIP_TRANSACTION_NON_INVITE_CLIENT:
+            if (tx->state == SIP_TRANSACTION_STATE_PROCEEDING) {
+                next = t2;
+            } else if (next > t2) {
+                next = t2;
+            }
+            break;
+        case SIP_TRANSACTION_INVITE_SERVER:
+            if (tx->state != SIP_TRANSACTION_STATE_COMPLETED) {
+                return;
+            }
+            if (next > t2) {
+                next = t2;
+            }
+            break;
+        default:
+            return;
+    }
+
+    ESP_LOGD(TAG, "Retransmitting %s (%s)", sip_method_name(tx->method), tx->branch);
+    resend(tx);
+    tx->retransmit_ticks = next;
+    sip_timer_start(&tx->layer->wheel, timer, next);
+}
+
+/**
+ * @brief Timers B/F (give up) and D/H/I/J/K (linger then terminate)
+ */
+static void timeout_timer_callback(sip_timer_t *timer, void *arg)
+{
+    (void)timer;
+    sip_transaction_t *tx = (sip_transaction_t *)arg;
+    sip_transaction_layer_t *layer = tx->layer;
+
+    bool gave_up = (tx->kind == SIP_TRANSACTION_INVITE_CLIENT &&
+                    tx->state == SIP_TRANSACTION_STATE_CALLING) ||
+                   (tx->kind == SIP_TRANSACTION_NON_INVITE_CLIENT &&
+                    (tx->state == SIP_TRANSACTION_STATE_TRYING ||
+                     tx->state == SIP_TRANSACTION_STATE_PROCEEDING));
+
+    if (gave_up) {
+        ESP_LOGW(TAG, "%s transaction timed out", sip_method_name(tx->method));
+        terminate(tx);
+        if (layer->user.on_timeout != NULL) {
+            layer->user.on_timeout(layer->user.ctx, tx);
+        }
+        return;
+    }
+
+    terminate(tx);
+}
+
+static sip_transaction_t *allocate(sip_transaction_layer_t *layer)
+{
+    for (size_t i = 0; i < SIP_TRANSACTION_MAX; i++) {
+        sip_transaction_t *tx = &layer->pool[i];
+        if (!tx->in_use) {
+            memset(tx, 0, sizeof(*tx));
+            tx->in_use = true;
+            tx->layer = layer;
+            sip_arena_init(&tx->arena, &layer->arena_pool);
+            sip_timer_init(&tx->retransmit_timer, retransmit_timer_callback, tx);
+            sip_timer_init(&tx->timeout_timer, timeout_timer_callback, tx);
+            return tx;
+        }
+    }
+    ESP_LOGE(TAG, "Transaction pool exhausted (%d)", SIP_TRANSACTION_MAX);
+    return NULL;
+}
+
+/**
+ * @brief Keep a message for retransmission, replacing the previous one
+ */
+static esp_err_t store_message(sip_transaction_t *tx, const char *data, size_t len)
+{
+    if (len > SIP_TRANSPORT_MAX_MSG_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // The stored message is all the arena holds, so the old one goes at once
+    sip_arena_release(&tx->arena);
+    tx->msg = NULL;
+    tx->msg_len = 0;
+    char *copy = sip_arena_alloc(&tx->arena, len);
+    if (copy == NULL) {
+        ESP_LOGE(TAG, "No room to keep %s (%u bytes)", sip_method_name(tx->method), (unsigned)len);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, data, len);
+    tx->msg = copy;
+    tx->msg_len = (uint16_t)len;
+    return ESP_OK;
+}
+
+/**
+ * @brief Get the branch parameter of the topmost Via
+ */
+static bool top_via_branch(const sip_message_t *msg, sip_span_t *branch)
+{
+    const sip_header_t *via = sip_message_get_header(msg, SIP_HDR_VIA);
+    return via != NULL && sip_message_get_param(msg, via->value, "branch", branch) == ESP_OK;
+}
+
+static sip_transaction_t *find(sip_transaction_layer_t *layer, const sip_message_t *msg,
+                               sip_span_t branch, sip_method_t method, bool server)
+{
+    for (size_t i = 0; i < SIP_TRANSACTION_MAX; i++) {
+        sip_transaction_t *tx = &layer->pool[i];
+        bool is_server = tx->kind == SIP_TRANSACTION_INVITE_SERVER ||
+                         tx->kind == SIP_TRANSACTION_NON_INVITE_SERVER;
+        if (tx->in_use && is_server == server && tx->method == method &&
+            sip_span_equals(msg, branch, tx->branch)) {
+            return tx;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t sip_transaction_layer_init(sip_transaction_layer_t *layer,
+                                     const sip_transaction_user_t *user, int64_t now_ms)
+{
+    if (layer == NULL || user == NULL || user->send == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t i = 0; i < SIP_TRANSACTION_MAX; i++) {
+        layer->pool[i].in_use = false;
+        layer->pool[i].msg = NULL;
+        layer->pool[i].msg_len = 0;
+    }
+    sip_arena_pool_init(&layer->arena_pool, layer->arena_storage, sizeof(layer->arena_storage));
+    sip_timer_wheel_init(&layer->wheel, ms_to_wheel_tick(now_ms));
+    layer->user = *user;
+    layer->reliable = false;
+    return ESP_OK;
+}
+
+void sip_transaction_layer_tick(sip_transaction_layer_t *layer, int64_t now_ms)
+{
+    sip_timer_wheel_advance(&layer->wheel, ms_to_wheel_tick(now_ms));
+}
+
+void sip_transaction_layer_reset(sip_transaction_layer_t *layer)
+{
+    for (size_t i = 0; i < SIP_TRANSACTION_MAX; i++) {
+        if (layer->pool[i].in_use) {
+            terminate(&layer->pool[i]);
+        }
+    }
+}
+
+esp_err_t sip_transaction_client_start(sip_transaction_layer_t *layer, sip_method_t method,
+                                       const char *branch, uint32_t cseq,
+                                       const char *data, size_t len,
+                                       sip_transaction_t **out)
+{
+    if (layer == NULL || branch == NULL || data == NULL || method == SIP_METHOD_ACK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (strlen(branch) >= sizeof(layer->pool[0].branch)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sip_transaction_t *tx = allocate(layer);
+    if (tx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    strcpy(tx->branch, branch);
+    tx->method = method;
+    tx->cseq = cseq;
+
+    esp_err_t ret = store_message(tx, data, len);
+    if (ret != ESP_OK) {
+        terminate(tx);
+        return ret;
+    }
+
+    if (method == SIP_METHOD_INVITE) {
+        tx->kind = SIP_TRANSACTION_INVITE_CLIENT;
+        tx->state = SIP_TRANSACTION_STATE_CALLING;
+    } else {
+        tx->kind = SIP_TRANSACTION_NON_INVITE_CLIENT;
+        tx->state = SIP_TRANSACTION_STATE_TRYING;
+    }
+
+    ret = layer->user.send(layer->user.ctx, tx->msg, tx->msg_len);
+    if (ret != ESP_OK) {
+        // Transport errors are retried by Timer A/E like a lost datagram
+        ESP_LOGW(TAG, "Initial send of %s failed", sip_method_name(method));
+    }
+
+    start_retransmit(tx, TICKS(SIP_TIMER_T1_MS));
+    sip_timer_start(&layer->wheel, &tx->timeout_timer, TIMER_64_T1_TICKS);
+
+    if (out != NULL) {
+        *out = tx;
+    }
+    return ESP_OK;
+}
+
+sip_transaction_result_t sip_transaction_client_receive(sip_transaction_layer_t *layer,
+                                                        const sip_message_t *msg,
+                                                        sip_transaction_t **out)
+{
+    sip_span_t branch;
+
+    if (layer == NULL || msg == NULL || msg->is_request || !top_via_branch(msg, &branch)) {
+        return SIP_TRANSACTION_NO_MATCH;
+    }
+
+    sip_transaction_t *tx = find(layer, msg, branch, msg->cseq_method, false);
+    if (tx == NULL) {
+        return SIP_TRANSACTION_NO_MATCH;
+    }
+    if (out != NULL) {
+        *out = tx;
+    }
+
+    bool provisional = msg->status_code < 200;
+    bool success = msg->status_code >= 200 && msg->status_code < 300;
+
+    if (tx->kind == SIP_TRANSACTION_INVITE_CLIENT) {
+        switch (tx->state) {
+            case SIP_TRANSACTION_STATE_CALLING:
+            case SIP_TRANSACTION_STATE_PROCEEDING:
+                sip_timer_stop(&tx->retransmit_timer);
+                sip_timer_stop(&tx->timeout_timer);
+                if (provisional) {
+                    tx->state = SIP_TRANSACTION_STATE_PROCEEDING;
+                } else if (success) {
+                    // 2xx retransmissions are the dialog's business (RFC 3261 17.1.1.2)
+                    terminate(tx);
+                } else {
+                    tx->state = SIP_TRANSACTION_STATE_COMPLETED;
+                    sip_arena_release(&tx->arena);
+                    tx->msg = NULL;
+                    tx->msg_len = 0;
+                    sip_timer_start(&layer->wheel, &tx->timeout_timer,
+                                    layer->reliable ? 1 : TICKS(TIMER_D_MS));
+                }
+                return SIP_TRANSACTION_DELIVER;
+
+            case SIP_TRANSACTION_STATE_COMPLETED:
+                if (!provisional && !success) {
+                    resend(tx);  // Stored ACK
+                }
+                return SIP_TRANSACTION_ABSORBED;
+
+            default:
+                return SIP_TRANSACTION_ABSORBED;
+        }
+    }
+
+    switch (tx->state) {
+        case SIP_TRANSACTION_STATE_TRYING:
+        case SIP_TRANSACTION_STATE_PROCEEDING:
+            if (provisional) {
+                tx->state = SIP_TRANSACTION_STATE_PROCEEDING;
+            } else {
+                tx->state = SIP_TRANSACTION_STATE_COMPLETED;
+                sip_timer_stop(&tx->retransmit_timer);
+                wait_or_terminate(tx, TICKS(SIP_TIMER_T4_MS));
+            }
+            return SIP_TRANSACTION_DELIVER;
+
+        default:
+            return SIP_TRANSACTION_ABSORBED;
+    }
+}
+
+esp_err_t sip_transaction_client_ack(sip_transaction_layer_t *layer, sip_transaction_t *transaction,
+                                     const char *data, size_t len)
+{
+    if (layer == NULL || transaction == NULL || !transaction->in_use ||
+        transaction->kind != SIP_TRANSACTION_INVITE_CLIENT ||
+        transaction->state != SIP_TRANSACTION_STATE_COMPLETED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = store_message(transaction, data, len);
+    if (ret == ESP_ERR_INVALID_SIZE) {
+        return ret;
+    }
+    // Without room to keep it the message still goes out once
+    ret = layer->user.send(layer->user.ctx, data, len);
+
+    if (layer->reliable) {
+        terminate(transaction);
+    }
+    return ret;
+}
+
+esp_err_t sip_transaction_server_receive(sip_transaction_layer_t *layer, const sip_message_t *msg,
+                                         sip_transaction_t **out)
+{
+    sip_span_t branch = {0};
+
+    if (layer == NULL || msg == NULL || out == NULL || !msg->is_request) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out = NULL;
+
+    bool has_branch = top_via_branch(msg, &branch);
+
+    if (msg->method == SIP_METHOD_ACK) {
+        // ACK for a non-2xx answer belongs to the INVITE server transaction
+        sip_transaction_t *tx = has_branch ?
+                                find(layer, msg, branch, SIP_METHOD_INVITE, true) : NULL;
+        if (tx != NULL && tx->state == SIP_TRANSACTION_STATE_COMPLETED) {
+            tx->state = SIP_TRANSACTION_STATE_CONFIRMED;
+            sip_timer_stop(&tx->retransmit_timer);
+            wait_or_terminate(tx, TICKS(SIP_TIMER_T4_MS));
+        }
+        return ESP_OK;
+    }
+
+    if (has_branch) {
+        sip_transaction_t *tx = find(layer, msg, branch, msg->method, true);
+        if (tx != NULL) {
+            if (tx->state == SIP_TRANSACTION_STATE_PROCEEDING ||
+                tx->state == SIP_TRANSACTION_STATE_COMPLETED) {
+                resend(tx);
+            }
+            return ESP_OK;
+        }
+    }
+
+    if (branch.len >= sizeof(layer->pool[0].branch)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sip_transaction_t *tx = allocate(layer);
+    if (tx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    sip_span_copy(msg, branch, tx->branch, sizeof(tx->branch));
+    tx->method = msg->method;
+    tx->cseq = msg->cseq;
+    tx->msg_len = 0;
+    if (msg->method == SIP_METHOD_INVITE) {
+        tx->kind = SIP_TRANSACTION_INVITE_SERVER;
+        tx->state = SIP_TRANSACTION_STATE_PROCEEDING;
+    } else {
+        tx->kind = SIP_TRANSACTION_NON_INVITE_SERVER;
+        tx->state = SIP_TRANSACTION_STATE_TRYING;
+    }
+
+    *out = tx;
+    return ESP_OK;
+}
+
+esp_err_t sip_transaction_server_respond(sip_transaction_layer_t *layer, sip_transaction_t *transaction,
+                                         uint16_t status_code, const char *data, size_t len)
+{
+    if (layer == NULL || transaction == NULL || !transaction->in_use || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (transaction->state == SIP_TRANSACTION_STATE_COMPLETED ||
+        transaction->state == SIP_TRANSACTION_STATE_CONFIRMED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = store_message(transaction, data, len);
+    if (ret == ESP_ERR_INVALID_SIZE) {
+        return ret;
+    }
+    // Without room to keep it the message still goes out once
+    ret = layer->user.send(layer->user.ctx, data, len);
+
+    if (status_code < 200) {
+        transaction->state = SIP_TRANSACTION_STATE_PROCEEDING;
+        return ret;
+    }
+
+    if (transaction->kind == SIP_TRANSACTION_INVITE_SERVER) {
+        if (status_code < 300) {
+            terminate(transaction);
+        } else {
+            transaction->state = SIP_TRANSACTION_STATE_COMPLETED;
+            start_retransmit(transaction, TICKS(SIP_TIMER_T1_MS));
+            sip_timer_start(&layer->wheel, &transaction->timeout_timer, TIMER_64_T1_TICKS);
+        }
+    } else {
+        transaction->state = SIP_TRANSACTION_STATE_COMPLETED;
+        wait_or_terminate(transaction, TIMER_64_T1_TICKS);
+    }
+    return ret;
+}
+
+size_t sip_transaction_active_count(const sip_transaction_layer_t *layer)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < SIP_TRANSACTION_MAX; i++) {
+        if (layer->pool[i].in_use) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void sip_transaction_get_arena_stats(const sip_transaction_layer_t *layer, sip_arena_pool_stats_t *stats)
+{
+    sip_arena_pool_get_stats(&layer->arena_pool, stats);
+}
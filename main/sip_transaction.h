@@ -0,0 +1,208 @@
+#ifndef SIP_TRANSACTION_H
+#define SIP_TRANSACTION_H
+
+#include "esp_err.h"
+#include "sip_message.h"
+#include "sip_timer_wheel.h"
+#include "sip_transport.h"
+#include "sip_arena.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Number of transactions that can be in flight at once
+ *
+ * Sized for a call forked to four callees: their INVITEs, the CANCELs
+ * sent when one answers, plus REGISTER and in-dialog requests.
+ */
+#ifndef SIP_TRANSACTION_MAX
+#define SIP_TRANSACTION_MAX 12
+#endif
+
+/**
+ * @brief Static pool behind the transactions' stored messages
+ *
+ * Holds the messages of a call forked to four callees with their
+ * CANCELs and a REGISTER, in place of a full-size buffer per
+ * transaction.
+ */
+#ifndef SIP_TRANSACTION_ARENA_SIZE
+#define SIP_TRANSACTION_ARENA_SIZE 10240
+#endif
+
+/**
+ * @brief RFC 3261 timer base values (section 17, table 4)
+ */
+#define SIP_TIMER_T1_MS     500
+#define SIP_TIMER_T2_MS     4000
+#define SIP_TIMER_T4_MS     5000
+
+/**
+ * @brief Transaction kinds
+ */
+typedef enum {
+    SIP_TRANSACTION_INVITE_CLIENT,      ///< ICT, timers A/B/D
+    SIP_TRANSACTION_NON_INVITE_CLIENT,  ///< NICT, timers E/F/K
+    SIP_TRANSACTION_INVITE_SERVER,      ///< IST, timers G/H/I
+    SIP_TRANSACTION_NON_INVITE_SERVER   ///< NIST, timer J
+} sip_transaction_kind_t;
+
+/**
+ * @brief Transaction states
+ */
+typedef enum {
+    SIP_TRANSACTION_STATE_CALLING,
+    SIP_TRANSACTION_STATE_TRYING,
+    SIP_TRANSACTION_STATE_PROCEEDING,
+    SIP_TRANSACTION_STATE_COMPLETED,
+    SIP_TRANSACTION_STATE_CONFIRMED,
+    SIP_TRANSACTION_STATE_TERMINATED
+} sip_transaction_state_t;
+
+/**
+ * @brief Result of offering a response to the client transactions
+ */
+typedef enum {
+    SIP_TRANSACTION_NO_MATCH,           ///< No transaction, handle statelessly
+    SIP_TRANSACTION_DELIVER,            ///< Matched, pass the response to the user
+    SIP_TRANSACTION_ABSORBED            ///< Matched retransmission, already handled
+} sip_transaction_result_t;
+
+typedef struct sip_transaction_layer sip_transaction_layer_t;
+
+/**
+ * @brief One transaction, lives in the layer's static pool
+ */
+typedef struct {
+    bool in_use;
+    sip_transaction_kind_t kind;
+    sip_transaction_state_t state;
+    sip_method_t method;
+    uint32_t cseq;
+    char branch[40];
+    uint32_t retransmit_ticks;          ///< Current Timer A/E/G interval
+    sip_timer_t retransmit_timer;       ///< Timer A, E or G
+    sip_timer_t timeout_timer;          ///< Timer B, D, F, H, I, J or K
+    sip_transaction_layer_t *layer;
+    sip_arena_t arena;                  ///< Everything the transaction holds, released when it terminates
+    const char *msg;                    ///< Request (client) or last response (server), in the arena
+    uint16_t msg_len;
+} sip_transaction_t;
+
+/**
+ * @brief Hooks from the transaction layer to its user (the SIP UA)
+ */
+typedef struct {
+    esp_err_t (*send)(void *ctx, const char *data, size_t len);
+    void (*on_timeout)(void *ctx, const sip_transaction_t *transaction);
+    void *ctx;
+} sip_transaction_user_t;
+
+/**
+ * @brief Transaction layer: transaction pool plus the wheel driving its timers
+ */
+struct sip_transaction_layer {
+    sip_timer_wheel_t wheel;
+    sip_transaction_user_t user;
+    bool reliable;                      ///< Transport is reliable (no retransmissions)
+    sip_transaction_t pool[SIP_TRANSACTION_MAX];
+    sip_arena_pool_t arena_pool;
+    SIP_ARENA_POOL_STORAGE(arena_storage, SIP_TRANSACTION_ARENA_SIZE);
+};
+
+/**
+ * @brief Initialize the layer
+ *
+ * @param layer Layer to initialize
+ * @param user Send and timeout hooks
+ * @param now_ms Current monotonic time in milliseconds
+ */
+esp_err_t sip_transaction_layer_init(sip_transaction_layer_t *layer,
+                                     const sip_transaction_user_t *user, int64_t now_ms);
+
+/**
+ * @brief Drive all transaction timers, called from the SIP task
+ */
+void sip_transaction_layer_tick(sip_transaction_layer_t *layer, int64_t now_ms);
+
+/**
+ * @brief Terminate every transaction (client stop)
+ */
+void sip_transaction_layer_reset(sip_transaction_layer_t *layer);
+
+/**
+ * @brief Send a request inside a new client transaction
+ *
+ * @param layer Transaction layer
+ * @param method Request method (ACK is not allowed)
+ * @param branch Via branch of the request
+ * @param cseq CSeq number of the request
+ * @param data Encoded request
+ * @param len Length of data
+ * @param out Created transaction (optional)
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the pool is exhausted
+ */
+esp_err_t sip_transaction_client_start(sip_transaction_layer_t *layer, sip_method_t method,
+                                       const char *branch, uint32_t cseq,
+                                       const char *data, size_t len,
+                                       sip_transaction_t **out);
+
+/**
+ * @brief Offer a received response to the client transactions
+ *
+ * @param layer Transaction layer
+ * @param msg Parsed response
+ * @param out Matching transaction (optional)
+ */
+sip_transaction_result_t sip_transaction_client_receive(sip_transaction_layer_t *layer,
+                                                        const sip_message_t *msg,
+                                                        sip_transaction_t **out);
+
+/**
+ * @brief Send the ACK for a non-2xx final response of an INVITE transaction
+ *
+ * The ACK is kept and re-sent if the final response is retransmitted.
+ */
+esp_err_t sip_transaction_client_ack(sip_transaction_layer_t *layer, sip_transaction_t *transaction,
+                                     const char *data, size_t len);
+
+/**
+ * @brief Offer a received request to the server transactions
+ *
+ * Retransmitted requests are answered with the last response and ACKs
+ * for non-2xx responses are consumed; both return NULL.
+ *
+ * @param layer Transaction layer
+ * @param msg Parsed request
+ * @param out New server transaction, NULL if the request needs no answer
+ * @return ESP_OK, or ESP_ERR_NO_MEM if no transaction could be created
+ */
+esp_err_t sip_transaction_server_receive(sip_transaction_layer_t *layer, const sip_message_t *msg,
+                                         sip_transaction_t **out);
+
+/**
+ * @brief Send a response inside a server transaction
+ */
+esp_err_t sip_transaction_server_respond(sip_transaction_layer_t *layer, sip_transaction_t *transaction,
+                                         uint16_t status_code, const char *data, size_t len);
+
+/**
+ * @brief Number of transactions currently in use
+ */
+size_t sip_transaction_active_count(const sip_transaction_layer_t *layer);
+
+/**
+ * @brief Usage of the pool behind the stored messages
+ */
+void sip_transaction_get_arena_stats(const sip_transaction_layer_t *layer, sip_arena_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIP_TRANSACTION_H
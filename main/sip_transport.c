@@ -0,0 +1,588 @@
+#include "sip_transport.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+static const char *TAG = "sip_transport";
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Bodies larger than this are treated as a broken stream, not skipped
+#define SIP_TRANSPORT_MAX_BODY_SIZE 65536
+
+/**
+ * @brief Resolve host to an IPv4 address
+ */
+static esp_err_t resolve_host(const char *host, uint32_t *addr)
+{
+    struct in_addr in;
+    if (inet_aton(host, &in)) {
+        *addr = in.s_addr;
+        return ESP_OK;
+    }
+
+    struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_DGRAM
+    };
+    struct addrinfo *res = NULL;
+    int err = getaddrinfo(host, NULL, &hints, &res);
+    if (err != 0 || res == NULL) {
+        ESP_LOGE(TAG, "DNS lookup failed for %s: %d", host, err);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    *addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo(res);
+    return ESP_OK;
+}
+
+esp_err_t sip_transport_open(sip_transport_t *transport, uint16_t local_port)
+{
+    if (transport == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(transport, 0, sizeof(*transport));
+    transport->sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (transport->sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        return ESP_FAIL;
+    }
+
+    int reuse = 1;
+    setsockopt(transport->sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_port = htons(local_port),
+        .sin_addr.s_addr = htonl(INADDR_ANY)
+    };
+    if (bind(transport->sock, (struct sockaddr *)&local, sizeof(local)) != 0) {
+        ESP_LOGE(TAG, "Failed to bind port %u: errno %d", local_port, errno);
+        sip_transport_close(transport);
+        return ESP_FAIL;
+    }
+
+    socklen_t addr_len = sizeof(local);
+    getsockname(transport->sock, (struct sockaddr *)&local, &addr_len);
+    transport->local_port = ntohs(local.sin_port);
+
+    ESP_LOGI(TAG, "UDP transport bound to port %u", transport->local_port);
+    return ESP_OK;
+}
+
+esp_err_t sip_transport_open_tcp(sip_transport_t *transport)
+{
+    if (transport == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(transport, 0, sizeof(*transport));
+    transport->sock = -1;
+    transport->protocol = SIP_TRANSPORT_PROTO_TCP;
+    return ESP_OK;
+}
+
+esp_err_t sip_transport_open_tls(sip_transport_t *transport, sip_tls_t *tls)
+{
+    if (transport == NULL || tls == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(transport, 0, sizeof(*transport));
+    transport->sock = -1;
+    transport->protocol = SIP_TRANSPORT_PROTO_TLS;
+    transport->tls = tls;
+    return ESP_OK;
+}
+
+/**
+ * @brief Whether the transport is connection oriented (TCP or TLS)
+ */
+static bool is_stream(const sip_transport_t *transport)
+{
+    return transport->protocol != SIP_TRANSPORT_PROTO_UDP;
+}
+
+/**
+ * @brief Whether the transport can be connected; stream sockets are created when dialling
+ */
+static bool transport_open(const sip_transport_t *transport)
+{
+    return transport->sock >= 0 || is_stream(transport);
+}
+
+/**
+ * @brief Learn the local address (and for TCP and TLS the port) of a connected socket
+ */
+static void learn_local_address(sip_transport_t *transport)
+{
+    struct sockaddr_in local;
+    socklen_t addr_len = sizeof(local);
+    if (getsockname(transport->sock, (struct sockaddr *)&local, &addr_len) == 0) {
+        inet_ntoa_r(local.sin_addr, transport->local_ip, sizeof(transport->local_ip));
+        if (is_stream(transport)) {
+            transport->local_port = ntohs(local.sin_port);
+        }
+    }
+}
+
+esp_err_t sip_transport_connect(sip_transport_t *transport, const char *host, uint16_t port)
+{
+    if (transport == NULL || !transport_open(transport) || host == NULL || port == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t addr = 0;
+    esp_err_t ret = resolve_host(host, &addr);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return sip_transport_connect_addr(transport, addr, port);
+}
+
+esp_err_t sip_transport_connect_addr(sip_transport_t *transport, uint32_t addr, uint16_t port)
+{
+    if (transport == NULL || !transport_open(transport) || addr == 0 || port == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (is_stream(transport)) {
+        sip_transport_conn_t conn;
+        esp_err_t ret = sip_transport_dial(transport, addr, port, &conn);
+        if (ret != ESP_OK) {
+            // Remember the server for the next dial
+            sip_transport_close(transport);
+            transport->remote_addr = addr;
+            transport->remote_port = port;
+            return ret;
+        }
+        return sip_transport_adopt(transport, &conn, addr, port);
+    }
+
+    struct sockaddr_in remote = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = addr
+    };
+    char host[16];
+    inet_ntoa_r(remote.sin_addr, host, sizeof(host));
+
+    if (connect(transport->sock, (struct sockaddr *)&remote, sizeof(remote)) != 0) {
+        ESP_LOGE(TAG, "Failed to connect to %s:%u: errno %d", host, port, errno);
+        return ESP_FAIL;
+    }
+
+    // The local address of a connected datagram socket is the one routed to the server
+    learn_local_address(transport);
+
+    transport->remote_addr = addr;
+    transport->remote_port = port;
+
+    ESP_LOGI(TAG, "Transport connected to %s:%u via %s", host, port, transport->local_ip);
+    return ESP_OK;
+}
+
+/**
+ * @brief Open a TCP connection with a bounded wait
+ */
+static esp_err_t tcp_dial(uint32_t addr, uint16_t port, int *sock)
+{
+    int s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        return ESP_FAIL;
+    }
+
+    struct sockaddr_in remote = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = addr
+    };
+    char host[16];
+    inet_ntoa_r(remote.sin_addr, host, sizeof(host));
+
+    // Connect non-blocking so an unreachable server costs a bounded wait
+    int flags = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, flags | O_NONBLOCK);
+
+    esp_err_t ret = ESP_OK;
+    if (connect(s, (struct sockaddr *)&remote, sizeof(remote)) != 0) {
+        if (errno != EINPROGRESS) {
+            ret = ESP_FAIL;
+        } else {
+            fd_set writefds;
+            FD_ZERO(&writefds);
+            FD_SET(s, &writefds);
+            struct timeval tv = {
+                .tv_sec = SIP_TRANSPORT_CONNECT_TIMEOUT_MS / 1000,
+                .tv_usec = (SIP_TRANSPORT_CONNECT_TIMEOUT_MS % 1000) * 1000
+            };
+            int error = 0;
+            socklen_t error_len = sizeof(error);
+            int ready = select(s + 1, NULL, &writefds, NULL, &tv);
+            if (ready == 0) {
+                ret = ESP_ERR_TIMEOUT;
+            } else if (ready < 0 || getsockopt(s, SOL_SOCKET, SO_ERROR, &error, &error_len) != 0 ||
+                       error != 0) {
+                ret = ESP_FAIL;
+            }
+        }
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "TCP connect to %s:%u failed: %s", host, port, esp_err_to_name(ret));
+        close(s);
+        return ret;
+    }
+
+    fcntl(s, F_SETFL, flags);
+
+    // Requests are written in one piece; a stalled peer must not block the sender forever
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval send_timeout = {
+        .tv_sec = SIP_TRANSPORT_CONNECT_TIMEOUT_MS / 1000,
+        .tv_usec = (SIP_TRANSPORT_CONNECT_TIMEOUT_MS % 1000) * 1000
+    };
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
+    *sock = s;
+    return ESP_OK;
+}
+
+esp_err_t sip_transport_dial(const sip_transport_t *transport, uint32_t addr, uint16_t port,
+                             sip_transport_conn_t *conn)
+{
+    if (transport == NULL || !is_stream(transport) || addr == 0 || port == 0 || conn == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    conn->sock = -1;
+    conn->tls = NULL;
+    esp_err_t ret = tcp_dial(addr, port, &conn->sock);
+    if (ret != ESP_OK || transport->protocol != SIP_TRANSPORT_PROTO_TLS) {
+        return ret;
+    }
+
+    ret = sip_tls_handshake(transport->tls, conn->sock, &conn->tls);
+    if (ret != ESP_OK) {
+        close(conn->sock);
+        conn->sock = -1;
+    }
+    return ret;
+}
+
+esp_err_t sip_transport_adopt(sip_transport_t *transport, const sip_transport_conn_t *conn,
+                              uint32_t addr, uint16_t port)
+{
+    if (transport == NULL || !is_stream(transport) || conn == NULL || conn->sock < 0 ||
+        (transport->protocol == SIP_TRANSPORT_PROTO_TLS) != (conn->tls != NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sip_transport_close(transport);
+    transport->sock = conn->sock;
+    transport->tls_conn = conn->tls;
+    transport->remote_addr = addr;
+    transport->remote_port = port;
+    learn_local_address(transport);
+
+    char host[16];
+    struct in_addr in = { .s_addr = addr };
+    inet_ntoa_r(in, host, sizeof(host));
+    ESP_LOGI(TAG, "%s connection to %s:%u from %s:%u",
+             transport->tls_conn != NULL ? "TLS" : "TCP", host, port,
+             transport->local_ip, transport->local_port);
+    return ESP_OK;
+}
+
+esp_err_t sip_transport_send_keepalive(sip_transport_t *transport)
+{
+    if (transport == NULL || !is_stream(transport)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return sip_transport_send(transport, "\r\n\r\n", 4);
+}
+
+esp_err_t sip_transport_send(sip_transport_t *transport, const char *data, size_t len)
+{
+    if (transport == NULL || transport->sock < 0 || data == NULL || len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (transport->tls_conn != NULL) {
+        return sip_tls_write(transport->tls_conn, data, len);
+    }
+    if (transport->protocol == SIP_TRANSPORT_PROTO_TCP) {
+        for (size_t offset = 0; offset < len; ) {
+            int sent = send(transport->sock, data + offset, len - offset, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                ESP_LOGW(TAG, "TCP send failed: errno %d", errno);
+                return ESP_FAIL;
+            }
+            offset += (size_t)sent;
+        }
+        return ESP_OK;
+    }
+
+    int sent = send(transport->sock, data, len, 0);
+    if (sent != (int)len) {
+        ESP_LOGW(TAG, "Send failed: errno %d", errno);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Wait until the socket has data
+ */
+static esp_err_t wait_readable(sip_transport_t *transport, uint32_t timeout_ms)
+{
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(transport->sock, &readfds);
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000
+    };
+
+    int ready = select(transport->sock + 1, &readfds, NULL, NULL, &tv);
+    if (ready < 0) {
+        return ESP_FAIL;
+    }
+    if (ready == 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Drop bytes from the front of the stream buffer
+ */
+static void stream_consume(sip_transport_t *transport, size_t count)
+{
+    transport->stream_len -= count;
+    memmove(transport->stream_buf, transport->stream_buf + count, transport->stream_len);
+}
+
+/**
+ * @brief Find the Content-Length value in a header block
+ *
+ * RFC 3261 section 18.3 requires it on stream transports; a message
+ * without one is taken to have no body.
+ */
+static uint32_t stream_content_length(const char *headers, size_t len)
+{
+    const char *end = headers + len;
+    const char *line = memchr(headers, '\n', len);
+
+    while (line != NULL && ++line < end) {
+        size_t name_len = 0;
+        if (end - line > 14 && strncasecmp(line, "Content-Length", 14) == 0) {
+            name_len = 14;
+        } else if (end - line > 1 && (line[0] == 'l' || line[0] == 'L')) {
+            name_len = 1;   // Compact form
+        }
+        if (name_len > 0) {
+            const char *p = line + name_len;
+            while (p < end && (*p == ' ' || *p == '\t')) {
+                p++;
+            }
+            if (p < end && *p == ':') {
+                uint32_t value = 0;
+                for (p++; p < end && (*p == ' ' || *p == '\t'); p++) {
+                }
+                for (; p < end && *p >= '0' && *p <= '9' && value <= SIP_TRANSPORT_MAX_BODY_SIZE; p++) {
+                    value = value * 10 + (uint32_t)(*p - '0');
+                }
+                return value;
+            }
+        }
+        line = memchr(line, '\n', (size_t)(end - line));
+    }
+    return 0;
+}
+
+/**
+ * @brief Take one complete message off the front of the stream buffer
+ *
+ * @return ESP_OK with a message in buf, ESP_ERR_NOT_FOUND if more bytes
+ *         are needed, ESP_FAIL if the stream cannot be framed
+ */
+static esp_err_t stream_extract(sip_transport_t *transport, char *buf, size_t size, size_t *out_len)
+{
+    for (;;) {
+        // Rest of a message too large for the caller
+        if (transport->stream_discard > 0) {
+            size_t count = transport->stream_discard < transport->stream_len ?
+                           transport->stream_discard : transport->stream_len;
+            stream_consume(transport, count);
+            transport->stream_discard -= count;
+            if (transport->stream_discard > 0) {
+                return ESP_ERR_NOT_FOUND;
+            }
+        }
+
+        // CRLF between messages is a keepalive pong (RFC 5626 section 3.5.1)
+        size_t crlf = 0;
+        while (crlf + 2 <= transport->stream_len &&
+               transport->stream_buf[crlf] == '\r' && transport->stream_buf[crlf + 1] == '\n') {
+            crlf += 2;
+        }
+        if (crlf > 0) {
+            transport->pongs++;
+            stream_consume(transport, crlf);
+        }
+        if (transport->stream_len == 0 || (transport->stream_len == 1 && transport->stream_buf[0] == '\r')) {
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        size_t header_len = 0;
+        for (size_t i = 0; i + 4 <= transport->stream_len; i++) {
+            if (memcmp(transport->stream_buf + i, "\r\n\r\n", 4) == 0) {
+                header_len = i + 4;
+                break;
+            }
+        }
+        if (header_len == 0) {
+            if (transport->stream_len == sizeof(transport->stream_buf)) {
+                ESP_LOGW(TAG, "No end of headers in %d bytes of stream", (int)transport->stream_len);
+                return ESP_FAIL;
+            }
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        uint32_t body_len = stream_content_length(transport->stream_buf, header_len);
+        if (body_len > SIP_TRANSPORT_MAX_BODY_SIZE) {
+            ESP_LOGW(TAG, "Content-Length %lu out of range", (unsigned long)body_len);
+            return ESP_FAIL;
+        }
+
+        size_t total = header_len + body_len;
+        if (total > size) {
+            ESP_LOGW(TAG, "Skipping %d byte message", (int)total);
+            transport->stream_discard = total;
+            continue;
+        }
+        if (transport->stream_len < total) {
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        memcpy(buf, transport->stream_buf, total);
+        *out_len = total;
+        stream_consume(transport, total);
+        return ESP_OK;
+    }
+}
+
+/**
+ * @brief Feed the stream buffer from the TLS session instead of the socket
+ */
+static esp_err_t tls_stream_recv(sip_transport_t *transport, char *buf, size_t size,
+                                 uint32_t timeout_ms, size_t *out_len)
+{
+    // Records already decrypted do not show up in select()
+    if (sip_tls_pending(transport->tls_conn) == 0) {
+        esp_err_t ret = wait_readable(transport, timeout_ms);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    size_t received = 0;
+    esp_err_t ret = sip_tls_read(transport->tls_conn, transport->stream_buf + transport->stream_len,
+                                 sizeof(transport->stream_buf) - transport->stream_len, &received);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    transport->stream_len += received;
+
+    ret = stream_extract(transport, buf, size, out_len);
+    return ret == ESP_ERR_NOT_FOUND ? ESP_ERR_TIMEOUT : ret;
+}
+
+static esp_err_t stream_recv(sip_transport_t *transport, char *buf, size_t size,
+                             uint32_t timeout_ms, size_t *out_len)
+{
+    // A previous read may have brought in more than one message
+    esp_err_t ret = stream_extract(transport, buf, size, out_len);
+    if (ret != ESP_ERR_NOT_FOUND) {
+        return ret;
+    }
+
+    if (transport->tls_conn != NULL) {
+        return tls_stream_recv(transport, buf, size, timeout_ms, out_len);
+    }
+
+    ret = wait_readable(transport, timeout_ms);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    int received = recv(transport->sock, transport->stream_buf + transport->stream_len,
+                        sizeof(transport->stream_buf) - transport->stream_len, 0);
+    if (received == 0) {
+        ESP_LOGW(TAG, "Server closed the TCP connection");
+        return ESP_FAIL;
+    }
+    if (received < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return ESP_ERR_TIMEOUT;
+        }
+        ESP_LOGW(TAG, "TCP receive failed: errno %d", errno);
+        return ESP_FAIL;
+    }
+    transport->stream_len += (size_t)received;
+
+    ret = stream_extract(transport, buf, size, out_len);
+    return ret == ESP_ERR_NOT_FOUND ? ESP_ERR_TIMEOUT : ret;
+}
+
+esp_err_t sip_transport_recv(sip_transport_t *transport, char *buf, size_t size,
+                             uint32_t timeout_ms, size_t *out_len)
+{
+    if (transport == NULL || transport->sock < 0 || buf == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (is_stream(transport)) {
+        return stream_recv(transport, buf, size, timeout_ms, out_len);
+    }
+
+    esp_err_t ret = wait_readable(transport, timeout_ms);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    int received = recv(transport->sock, buf, size, 0);
+    if (received <= 0) {
+        // ICMP port unreachable surfaces here on connected sockets
+        return ESP_FAIL;
+    }
+
+    *out_len = (size_t)received;
+    return ESP_OK;
+}
+
+void sip_transport_close(sip_transport_t *transport)
+{
+    if (transport == NULL) {
+        return;
+    }
+    if (transport->tls_conn != NULL) {
+        sip_tls_close(transport->tls_conn);
+        transport->tls_conn = NULL;
+    }
+    if (transport->sock >= 0) {
+        close(transport->sock);
+    }
+    transport->sock = -1;
+    transport->stream_len = 0;
+    transport->stream_discard = 0;
+}
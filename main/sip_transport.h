@@ -0,0 +1,204 @@
+#ifndef SIP_TRANSPORT_H
+#define SIP_TRANSPORT_H
+
+#include "esp_err.h"
+#include "sip_tls.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Largest SIP datagram sent or received
+ */
+#define SIP_TRANSPORT_MAX_MSG_SIZE 1500
+
+/**
+ * @brief Bytes of a TCP or TLS stream buffered while a message is incomplete
+ */
+#define SIP_TRANSPORT_STREAM_BUF_SIZE (2 * SIP_TRANSPORT_MAX_MSG_SIZE)
+
+/**
+ * @brief Time allowed for a TCP handshake
+ */
+#define SIP_TRANSPORT_CONNECT_TIMEOUT_MS 3000
+
+/**
+ * @brief Transport protocol
+ */
+typedef enum {
+    SIP_TRANSPORT_PROTO_UDP,
+    SIP_TRANSPORT_PROTO_TCP,
+    SIP_TRANSPORT_PROTO_TLS          ///< TCP with a TLS session on top
+} sip_transport_protocol_t;
+
+/**
+ * @brief A dialled connection not yet installed in a transport
+ */
+typedef struct {
+    int sock;
+    sip_tls_conn_t *tls;         ///< TLS session on sock, NULL over TCP
+} sip_transport_conn_t;
+
+/**
+ * @brief SIP transport endpoint
+ *
+ * Holds one socket connected to the registrar/outbound proxy, so only
+ * messages from the server are seen. Over UDP the socket is bound to the
+ * local SIP port; over TCP and TLS it is one long-lived connection,
+ * re-dialled after a failure, and the byte stream is split back into
+ * messages.
+ */
+typedef struct {
+    int sock;                    ///< Socket descriptor, -1 when closed
+    sip_transport_protocol_t protocol;
+    uint32_t remote_addr;        ///< Remote IPv4 address (network order)
+    uint16_t remote_port;        ///< Remote port
+    uint16_t local_port;         ///< Bound local port
+    char local_ip[16];           ///< Local address used towards the remote
+
+    // TCP and TLS only
+    sip_tls_t *tls;              ///< TLS client, owned by the caller
+    sip_tls_conn_t *tls_conn;    ///< TLS session on sock
+    char stream_buf[SIP_TRANSPORT_STREAM_BUF_SIZE];
+    size_t stream_len;           ///< Bytes buffered in stream_buf
+    size_t stream_discard;       ///< Bytes of an oversized message still to skip
+    uint32_t pongs;              ///< RFC 5626 CRLF pongs received
+} sip_transport_t;
+
+/**
+ * @brief Open a UDP transport
+ *
+ * @param transport Transport to initialize
+ * @param local_port Local port to bind, 0 for an ephemeral port
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t sip_transport_open(sip_transport_t *transport, uint16_t local_port);
+
+/**
+ * @brief Prepare a TCP transport
+ *
+ * No socket exists until sip_transport_connect() or
+ * sip_transport_connect_addr() dials the server from an ephemeral port.
+ *
+ * @param transport Transport to initialize
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL
+ */
+esp_err_t sip_transport_open_tcp(sip_transport_t *transport);
+
+/**
+ * @brief Prepare a TLS transport
+ *
+ * Like a TCP transport, with a TLS handshake after every dial. The client
+ * outlives the connections, so each re-dial can resume the session of
+ * the previous one.
+ *
+ * @param transport Transport to initialize
+ * @param tls TLS client from sip_tls_create(), owned by the caller
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL
+ */
+esp_err_t sip_transport_open_tls(sip_transport_t *transport, sip_tls_t *tls);
+
+/**
+ * @brief Resolve and connect the transport to the SIP server
+ *
+ * Also learns the local address the stack picked for the route, which is
+ * what goes into Via and Contact.
+ *
+ * @param transport Open transport
+ * @param host Hostname or dotted IPv4 address
+ * @param port Server port
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if host does not resolve
+ */
+esp_err_t sip_transport_connect(sip_transport_t *transport, const char *host, uint16_t port);
+
+/**
+ * @brief Connect the transport to an already resolved server
+ *
+ * Can be called again to move to another server. A TCP transport
+ * closes its current connection and dials the new one, blocking for up
+ * to SIP_TRANSPORT_CONNECT_TIMEOUT_MS (plus SIP_TLS_HANDSHAKE_TIMEOUT_MS
+ * over TLS). When the dial fails the transport is left closed but keeps
+ * addr and port as its server.
+ *
+ * @param transport Open transport
+ * @param addr IPv4 address (network order)
+ * @param port Server port
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t sip_transport_connect_addr(sip_transport_t *transport, uint32_t addr, uint16_t port);
+
+/**
+ * @brief Dial a connection for a TCP or TLS transport without changing it
+ *
+ * Lets the caller wait for the handshakes without holding the lock that
+ * guards its transport; sip_transport_adopt() then installs the
+ * connection. Only reads the protocol and the TLS client, which do not
+ * change while the transport is open.
+ *
+ * @param transport Transport the connection is for
+ * @param addr IPv4 address (network order)
+ * @param port Server port
+ * @param conn Connected socket and TLS session
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if a handshake did not
+ *         finish in time, ESP_FAIL if the server refused
+ */
+esp_err_t sip_transport_dial(const sip_transport_t *transport, uint32_t addr, uint16_t port,
+                             sip_transport_conn_t *conn);
+
+/**
+ * @brief Make a dialled connection the one of a TCP or TLS transport
+ *
+ * Closes the previous connection and drops any partial message.
+ */
+esp_err_t sip_transport_adopt(sip_transport_t *transport, const sip_transport_conn_t *conn,
+                              uint32_t addr, uint16_t port);
+
+/**
+ * @brief Send an RFC 5626 keepalive ping (CRLFCRLF) on a TCP or TLS transport
+ *
+ * The server answers with a CRLF pong, counted in transport->pongs.
+ */
+esp_err_t sip_transport_send_keepalive(sip_transport_t *transport);
+
+/**
+ * @brief Send one message to the connected server
+ *
+ * @return ESP_OK on success, ESP_FAIL on socket error
+ */
+esp_err_t sip_transport_send(sip_transport_t *transport, const char *data, size_t len);
+
+/**
+ * @brief Receive one message
+ *
+ * Over TCP and TLS, returns whole messages framed by Content-Length and consumes
+ * keepalive pongs. Messages larger than size are skipped.
+ *
+ * @param transport Open transport
+ * @param buf Receive buffer
+ * @param size Size of buf
+ * @param timeout_ms Time to wait for data
+ * @param out_len Number of bytes received
+ * @return ESP_OK on data, ESP_ERR_TIMEOUT if nothing (complete) arrived,
+ *         ESP_FAIL on error; for TCP and TLS also when the connection was lost,
+ *         after which the transport must be closed and re-dialled
+ */
+esp_err_t sip_transport_recv(sip_transport_t *transport, char *buf, size_t size,
+                             uint32_t timeout_ms, size_t *out_len);
+
+/**
+ * @brief Close the transport
+ *
+ * A TLS client passed to sip_transport_open_tls() is not freed, only the
+ * session of the current connection.
+ */
+void sip_transport_close(sip_transport_t *transport);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIP_TRANSPORT_H
@@ -0,0 +1,129 @@
+#include "vad.h"
+#include <math.h>
+#include <string.h>
+
+#define FULL_SCALE_ENERGY       ((uint32_t)INT16_MAX * INT16_MAX)   // 0 dBov
+#define DB_POWER_UP_Q15         41252   // 10^(1/10) in Q15
+#define DB_POWER_DOWN_Q15       26029   // 10^(-1/10) in Q15
+#define NOISE_SHIFT             3       // Noise level and rate follow over 8 frames
+
+/**
+ * @brief Scale an energy by db whole decibels
+ */
+static uint32_t scale_db(uint32_t energy, int db)
+{
+    for (; db > 0; db--) {
+        energy = (uint32_t)(((uint64_t)energy * DB_POWER_UP_Q15 + (1 << 14)) >> 15);
+    }
+    for (; db < 0; db++) {
+        energy = (uint32_t)(((uint64_t)energy * DB_POWER_DOWN_Q15 + (1 << 14)) >> 15);
+    }
+    return energy;
+}
+
+bool vad_init(vad_t *vad, uint32_t sample_rate)
+{
+    if (sample_rate != 8000 && sample_rate != 16000) {
+        return false;
+    }
+    memset(vad, 0, sizeof(*vad));
+    vad->block_samples = VAD_BLOCK_MS * sample_rate / 1000;
+    vad->hangover_samples = VAD_HANGOVER_MS * sample_rate / 1000;
+    vad->speech_ratio = scale_db(1 << 8, VAD_SPEECH_DB);
+    vad->weak_ratio = scale_db(1 << 8, VAD_WEAK_SPEECH_DB);
+    vad->min_energy = scale_db(FULL_SCALE_ENERGY, VAD_MIN_DBOV);
+    return true;
+}
+
+/**
+ * @brief Track the quietest frame of the last VAD_BLOCKS blocks
+ */
+static void update_floor(vad_t *vad, uint32_t energy, size_t samples)
+{
+    if (!vad->started) {
+        for (int i = 0; i < VAD_BLOCKS; i++) {
+            vad->minima[i] = energy;
+        }
+        vad->block_min = energy;
+    }
+    vad->block_min = energy < vad->block_min ? energy : vad->block_min;
+    vad->block_done += (uint32_t)samples;
+    if (vad->block_done >= vad->block_samples) {
+        vad->minima[vad->block] = vad->block_min;
+        vad->block = (uint8_t)((vad->block + 1) % VAD_BLOCKS);
+        vad->block_done = 0;
+        vad->block_min = energy;
+    }
+
+    uint32_t floor = vad->block_min;
+    for (int i = 0; i < VAD_BLOCKS; i++) {
+        floor = vad->minima[i] < floor ? vad->minima[i] : floor;
+    }
+    // Digital silence must not make the faintest hiss look like speech
+    vad->floor = floor > vad->min_energy ? floor : vad->min_energy;
+}
+
+bool vad_process(vad_t *vad, const int16_t *pcm, size_t samples)
+{
+    if (samples == 0) {
+        return vad->speech;
+    }
+    uint64_t sum = 0;
+    uint32_t crossings = 0;
+    for (size_t i = 0; i < samples; i++) {
+        sum += (uint64_t)((int32_t)pcm[i] * pcm[i]);
+        if (i > 0 && (pcm[i] < 0) != (pcm[i - 1] < 0)) {
+            crossings++;
+        }
+    }
+    uint32_t energy = (uint32_t)(sum / samples);
+    uint32_t zcr = (uint32_t)(crossings * 1000 / samples);
+
+    update_floor(vad, energy, samples);
+    vad->started = true;
+    if (vad->learned < VAD_BLOCKS * vad->block_samples) {
+        // Too early to tell a talker from the noise: all is speech, the quietest frame is the noise
+        if (energy <= vad->floor) {
+            vad->noise_zcr = zcr;
+        }
+        vad->learned += (uint32_t)samples;
+        vad->noise = vad->floor;
+        vad->hangover = vad->hangover_samples;
+        vad->speech = true;
+        vad->frames++;
+        vad->speech_frames++;
+        return true;
+    }
+
+    // Steady noise is judged by its mean; noise that grew under a talkspurt by the floor
+    uint32_t reference = vad->noise > vad->floor ? vad->noise : vad->floor;
+    uint64_t scaled = (uint64_t)energy << 8;
+    uint32_t zcr_offset = zcr > vad->noise_zcr ? zcr - vad->noise_zcr : vad->noise_zcr - zcr;
+    bool speech = energy > vad->min_energy &&
+                  (scaled > (uint64_t)reference * vad->speech_ratio ||
+                   (scaled > (uint64_t)reference * vad->weak_ratio && zcr_offset > VAD_ZCR_MARGIN));
+
+    bool held = false;
+    if (speech) {
+        vad->hangover = vad->hangover_samples;
+    } else {
+        // Only frames without speech teach what the noise sounds like
+        vad->noise += (int32_t)(energy - vad->noise) >> NOISE_SHIFT;
+        vad->noise_zcr += (int32_t)(zcr - vad->noise_zcr) >> NOISE_SHIFT;
+        held = vad->hangover > 0;
+        vad->hangover = vad->hangover > samples ? vad->hangover - (uint32_t)samples : 0;
+    }
+    vad->speech = speech || held;
+    vad->frames++;
+    vad->speech_frames += vad->speech;
+    return vad->speech;
+}
+
+uint8_t vad_noise_level(const vad_t *vad)
+{
+    if (vad->noise == 0) {
+        return VAD_MAX_LEVEL;
+    }
+    float level = -10 * log10f((float)vad->noise / (float)FULL_SCALE_ENERGY);
+    return level < 0 ? 0 : level > VAD_MAX_LEVEL ? VAD_MAX_LEVEL : (uint8_t)(level + 0.5f);
+}
@@ -0,0 +1,127 @@
+#ifndef VAD_H
+#define VAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Level over the noise that is speech on its own
+ */
+#ifndef VAD_SPEECH_DB
+#define VAD_SPEECH_DB               9
+#endif
+
+/**
+ * @brief Level over the noise that is speech if the zero-crossing rate agrees
+ *
+ * Catches quiet fricatives and breathy onsets, which have far more
+ * zero crossings than traffic or wind noise.
+ */
+#ifndef VAD_WEAK_SPEECH_DB
+#define VAD_WEAK_SPEECH_DB          4
+#endif
+
+/**
+ * @brief Zero crossings per 1000 samples a frame must differ from the noise by
+ */
+#ifndef VAD_ZCR_MARGIN
+#define VAD_ZCR_MARGIN              150
+#endif
+
+/**
+ * @brief Time speech is held after the last speech frame
+ *
+ * Keeps word endings and short gaps between words in the talkspurt.
+ */
+#ifndef VAD_HANGOVER_MS
+#define VAD_HANGOVER_MS             200
+#endif
+
+/**
+ * @brief Level below which a frame is never speech
+ */
+#ifndef VAD_MIN_DBOV
+#define VAD_MIN_DBOV                (-70)
+#endif
+
+/**
+ * @brief Blocks of the noise floor search and their length
+ *
+ * The floor is the quietest frame of the last VAD_BLOCKS blocks, so it
+ * follows louder noise after at most VAD_BLOCKS * VAD_BLOCK_MS while
+ * the pauses between words keep it off the speech level.
+ */
+#define VAD_BLOCKS                  4
+#define VAD_BLOCK_MS                320
+
+/**
+ * @brief Quietest level reported, in -dBov (RFC 3389)
+ */
+#define VAD_MAX_LEVEL               127
+
+/**
+ * @brief Voice activity detector of the microphone
+ *
+ * Each frame's mean square energy and zero-crossing rate are compared
+ * with the noise. Frames without speech give the mean noise level and
+ * zero-crossing rate; a minimum search over the recent frames gives a
+ * floor, which takes over when the noise grows during a talkspurt and
+ * the mean is not updated. The first VAD_BLOCKS * VAD_BLOCK_MS count
+ * as speech while the noise is learned, so a visitor who talks at once
+ * is not taken for the noise. All integer; levels are relative to a
+ * full-scale square wave, 0 dBov.
+ */
+typedef struct {
+    uint32_t block_samples;         ///< Samples per floor search block
+    uint32_t hangover_samples;
+    uint32_t speech_ratio;          ///< VAD_SPEECH_DB as energy ratio, Q8
+    uint32_t weak_ratio;            ///< VAD_WEAK_SPEECH_DB as energy ratio, Q8
+    uint32_t min_energy;            ///< VAD_MIN_DBOV as mean square
+    uint32_t minima[VAD_BLOCKS];    ///< Quietest frame of each finished block
+    uint32_t block_min;             ///< Quietest frame of the block in progress
+    uint32_t block_done;            ///< Samples of the block in progress
+    uint8_t block;                  ///< Slot of the next finished block
+    bool started;                   ///< A frame has been seen
+    uint32_t learned;               ///< Samples seen while learning the noise
+    uint32_t floor;                 ///< Quietest frame of the search window
+    uint32_t noise;                 ///< Mean square of frames without speech
+    uint32_t noise_zcr;             ///< Zero crossings per 1000 samples of frames without speech
+    uint32_t hangover;              ///< Samples of hangover left
+    bool speech;                    ///< Decision for the last frame, hangover included
+    uint32_t frames;                ///< Frames seen since init
+    uint32_t speech_frames;         ///< Of those, frames with speech
+} vad_t;
+
+/**
+ * @brief Reset for a new call
+ *
+ * @param sample_rate 8000 or 16000
+ * @return false for an unsupported rate
+ */
+bool vad_init(vad_t *vad, uint32_t sample_rate);
+
+/**
+ * @brief Classify one frame and learn the noise from it
+ *
+ * @param samples 10 to 30 ms, e.g. a 20 ms frame
+ * @return true while there is speech, up to VAD_HANGOVER_MS after it
+ */
+bool vad_process(vad_t *vad, const int16_t *pcm, size_t samples);
+
+/**
+ * @brief Background noise level as carried in RFC 3389 comfort noise
+ *
+ * @return Level in -dBov, 0 to VAD_MAX_LEVEL
+ */
+uint8_t vad_noise_level(const vad_t *vad);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VAD_H
@@ -10,6 +10,7 @@ mock_esp_sip_control_t* mock_esp_sip_get_control(void) {
 
 void mock_esp_sip_reset(void) {
     memset(&mock_control, 0, sizeof(mock_control));
+    mock_control.stats.last_call_answered_leg = -1;
 }
 
 void mock_esp_sip_simulate_event(esp_sip_event_t event, void *event_data) {
@@ -45,6 +46,7 @@ esp_err_t esp_sip_init(esp_sip_config_t *config, esp_sip_event_callback_t callba
     
     mock_control.registered_callback = callback;
     mock_control.callback_user_data = user_data;
+    mock_control.last_config = *config;
     
     // Create a dummy client handle
     static int dummy_client = 1;
@@ -102,6 +104,35 @@ esp_err_t esp_sip_hangup(esp_sip_client_handle_t client) {
     return ESP_OK;
 }
 
+esp_err_t esp_sip_register(esp_sip_client_handle_t client) {
+    mock_control.register_call_count++;
+    
+    if (mock_control.register_should_fail) {
+        return ESP_FAIL;
+    }
+    
+    // Simulate successful refresh
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_REGISTERED, NULL);
+    
+    return ESP_OK;
+}
+
+esp_err_t esp_sip_get_registration_expires(esp_sip_client_handle_t client, uint32_t *expires_sec) {
+    if (expires_sec == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *expires_sec = mock_control.granted_expires;
+    return ESP_OK;
+}
+
+esp_err_t esp_sip_get_stats(esp_sip_client_handle_t client, esp_sip_stats_t *stats) {
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *stats = mock_control.stats;
+    return ESP_OK;
+}
+
 esp_err_t esp_sip_destroy(esp_sip_client_handle_t client) {
     mock_control.destroy_call_count++;
     return ESP_OK;
@@ -16,15 +16,20 @@ typedef struct {
     bool start_should_fail;
     bool call_should_fail;
     bool hangup_should_fail;
+    bool register_should_fail;
     esp_sip_event_callback_t registered_callback;
     void *callback_user_data;
     esp_sip_client_handle_t last_client;
-    char last_call_uri[128];
+    char last_call_uri[256];
+    esp_sip_config_t last_config;
     int init_call_count;
     int start_call_count;
     int call_call_count;
     int hangup_call_count;
     int destroy_call_count;
+    int register_call_count;
+    uint32_t granted_expires;
+    esp_sip_stats_t stats;
 } mock_esp_sip_control_t;
 
 /**
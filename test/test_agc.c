@@ -0,0 +1,113 @@
+#include "unity.h"
+#include "agc.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AGC_TEST_RATE       8000
+#define AGC_TEST_FRAME      160
+#define AGC_TEST_TARGET     (-18)
+#define AGC_TEST_MAX_GAIN   24
+#define AGC_TEST_SECONDS    6
+#define AGC_TEST_SAMPLES    (AGC_TEST_RATE * AGC_TEST_SECONDS)
+
+static agc_t agc;
+static int16_t in[AGC_TEST_SAMPLES];
+static int16_t out[AGC_TEST_SAMPLES];
+
+void setUp(void)
+{
+    srand(5);
+    TEST_ASSERT_TRUE(agc_init(&agc, AGC_TEST_RATE, AGC_TEST_TARGET, AGC_TEST_MAX_GAIN));
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Voiced speech at a given RMS level: a gliding pitch with harmonics, in syllables
+ */
+static void make_talker(int from, int to, double rms_dbfs)
+{
+    double amplitude = 32767 * pow(10, rms_dbfs / 20) * 1.8;
+    for (int i = from; i < to; i++) {
+        double t = (double)i / AGC_TEST_RATE;
+        double pitch = 120 + 30 * sin(2 * M_PI * 0.7 * t);
+        double syllable = 0.6 + 0.4 * sin(2 * M_PI * 3 * t);
+        double voice = sin(2 * M_PI * pitch * t) + 0.5 * sin(4 * M_PI * pitch * t) +
+                       0.25 * sin(6 * M_PI * pitch * t);
+        in[i] = (int16_t)(amplitude * syllable * voice / 1.15);
+    }
+}
+
+static void run_frames(int from, int to)
+{
+    memcpy(out + from, in + from, (to - from) * sizeof(int16_t));
+    for (int i = from; i < to; i += AGC_TEST_FRAME) {
+        agc_process(&agc, out + i, AGC_TEST_FRAME);
+    }
+}
+
+static double rms_dbfs(const int16_t *pcm, int from, int to)
+{
+    double energy = 0;
+    for (int i = from; i < to; i++) {
+        energy += (double)pcm[i] * pcm[i];
+    }
+    return 10 * log10(energy / (to - from) / (32767.0 * 32767.0) + 1e-12);
+}
+
+void test_agc_rejects_bad_settings(void)
+{
+    TEST_ASSERT_FALSE(agc_init(&agc, 44100, AGC_TEST_TARGET, AGC_TEST_MAX_GAIN));
+    TEST_ASSERT_FALSE(agc_init(&agc, AGC_TEST_RATE, 3, AGC_TEST_MAX_GAIN));
+    TEST_ASSERT_FALSE(agc_init(&agc, AGC_TEST_RATE, AGC_TEST_TARGET, AGC_MAX_GAIN_DB + 1));
+    TEST_ASSERT_TRUE(agc_init(&agc, 16000, AGC_TEST_TARGET, AGC_MAX_GAIN_DB));
+    TEST_ASSERT_EQUAL_INT(0, agc_gain_db(&agc));
+}
+
+void test_agc_brings_distant_and_close_talkers_to_target(void)
+{
+    // A visitor two metres away, then one leaning into the panel
+    make_talker(0, AGC_TEST_SAMPLES / 2, -40);
+    make_talker(AGC_TEST_SAMPLES / 2, AGC_TEST_SAMPLES, -10);
+    run_frames(0, AGC_TEST_SAMPLES);
+
+    double distant = rms_dbfs(out, AGC_TEST_SAMPLES / 2 - AGC_TEST_RATE, AGC_TEST_SAMPLES / 2);
+    double close = rms_dbfs(out, AGC_TEST_SAMPLES - AGC_TEST_RATE, AGC_TEST_SAMPLES);
+    // 30 dB apart at the microphone, within 2 dB of each other after it
+    TEST_ASSERT_TRUE(fabs(distant - close) < 2.0);
+    // The level follows the louder syllables, so the RMS sits a few dB under the target
+    TEST_ASSERT_TRUE(distant > AGC_TEST_TARGET - 5 && distant < AGC_TEST_TARGET + 1);
+    TEST_ASSERT_TRUE(close > AGC_TEST_TARGET - 5 && close < AGC_TEST_TARGET + 1);
+    TEST_ASSERT_INT_WITHIN(2, AGC_TEST_TARGET + 10, agc_gain_db(&agc));
+}
+
+void test_agc_limiter_catches_sudden_peaks(void)
+{
+    // Quiet talker with the gain up, then a shout at full scale
+    make_talker(0, 2 * AGC_TEST_RATE, -40);
+    for (int i = 2 * AGC_TEST_RATE; i < AGC_TEST_SAMPLES; i++) {
+        in[i] = (int16_t)(32000 * sin(2 * M_PI * 400 * i / AGC_TEST_RATE));
+    }
+    run_frames(0, AGC_TEST_SAMPLES);
+
+    int32_t ceiling = (int32_t)(32767 * pow(10, AGC_CEILING_DBFS / 20.0)) + 1;
+    for (int i = 0; i < AGC_TEST_SAMPLES; i++) {
+        TEST_ASSERT_TRUE(out[i] <= ceiling && out[i] >= -ceiling);
+    }
+    TEST_ASSERT_TRUE(agc.limited > 0);
+}
+
+void test_agc_holds_gain_over_background_noise(void)
+{
+    for (int i = 0; i < AGC_TEST_SAMPLES; i++) {
+        in[i] = (int16_t)(rand() % 81 - 40);     // About -60 dBFS
+    }
+    run_frames(0, AGC_TEST_SAMPLES);
+
+    TEST_ASSERT_EQUAL_INT(0, agc_gain_db(&agc));
+    double change = rms_dbfs(out, AGC_TEST_RATE, AGC_TEST_SAMPLES) - rms_dbfs(in, AGC_TEST_RATE, AGC_TEST_SAMPLES);
+    TEST_ASSERT_TRUE(fabs(change) < 0.5);
+}
@@ -1,5 +1,7 @@
 #include "unity.h"
 #include "app_controller.h"
+#include "sip_manager.h"
+#include "mock_esp_sip.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
@@ -8,6 +10,32 @@
 
 static const char *TAG = "test_app_controller";
 
+/**
+ * @brief Bring up the SIP manager on the mock client, its events not yet handled
+ */
+static void start_sip_manager(bool registers)
+{
+    sip_event_data_t event;
+    sip_config_t config = {
+        .user = "testuser",
+        .domain = "test.domain.com",
+        .password = "testpass",
+        .callee = "sip:callee@test.domain.com",
+        .port = 5060,
+        .registration_timeout = 30,
+        .call_timeout = 60
+    };
+
+    sip_manager_stop();
+    while (sip_manager_poll_event(&event)) {
+    }
+    mock_esp_sip_reset();
+    // The mock registers as it starts, unless starting fails
+    mock_esp_sip_get_control()->start_should_fail = !registers;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&config));
+    sip_manager_start();
+}
+
 void setUp(void)
 {
     // Reset any global state before each test
@@ -141,6 +169,48 @@ void test_app_controller_button_press_handling(void)
     TEST_ASSERT_EQUAL(APP_STATE_IDLE, state.app_state); // Should end call and go to idle
 }
 
+void test_app_controller_button_press_drives_call(void)
+{
+    ESP_LOGI(TAG, "Testing button press reaching the SIP manager");
+    
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_init());
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_set_app_state(APP_STATE_INITIALIZING));
+    start_sip_manager(true);
+    app_controller_process_sip_events();
+    
+    system_state_t state;
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_get_system_state(&state));
+    TEST_ASSERT_EQUAL(APP_STATE_IDLE, state.app_state);
+    
+    // One press places the call
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_handle_button_press());
+    TEST_ASSERT_EQUAL(1, mock_esp_sip_get_control()->call_call_count);
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_get_system_state(&state));
+    TEST_ASSERT_EQUAL(APP_STATE_CALLING, state.app_state);
+    
+    app_controller_process_sip_events();
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_get_system_state(&state));
+    TEST_ASSERT_EQUAL(APP_STATE_CALLING, state.app_state);
+    
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_CALL_CONNECTED, NULL);
+    app_controller_process_sip_events();
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_get_system_state(&state));
+    TEST_ASSERT_EQUAL(APP_STATE_CONNECTED, state.app_state);
+    
+    // A second press during the call hangs up
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_handle_button_press());
+    TEST_ASSERT_EQUAL(1, mock_esp_sip_get_control()->hangup_call_count);
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_get_system_state(&state));
+    TEST_ASSERT_EQUAL(APP_STATE_IDLE, state.app_state);
+    
+    app_controller_process_sip_events();
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_get_system_state(&state));
+    TEST_ASSERT_EQUAL(APP_STATE_IDLE, state.app_state);
+    TEST_ASSERT_EQUAL(SIP_STATE_REGISTERED, state.sip_state);
+    
+    sip_manager_stop();
+}
+
 void test_app_controller_dtmf_handling(void)
 {
     ESP_LOGI(TAG, "Testing DTMF handling");
@@ -245,6 +315,48 @@ void test_app_controller_sip_state_handling(void)
     TEST_ASSERT_EQUAL(1, state.error_count);
 }
 
+void test_app_controller_sip_event_pump(void)
+{
+    ESP_LOGI(TAG, "Testing the SIP event pump");
+    
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_init());
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_set_app_state(APP_STATE_INITIALIZING));
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_reset_error_count());
+    start_sip_manager(false);
+    
+    // A failed registration is a warning, not a reason to stay in error
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_REGISTRATION_FAILED, NULL);
+    app_controller_process_sip_events();
+    
+    system_state_t state;
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_get_system_state(&state));
+    TEST_ASSERT_EQUAL(APP_STATE_ERROR, state.app_state);
+    TEST_ASSERT_FALSE(state.sip_registered);
+    TEST_ASSERT_EQUAL(1, state.error_count);
+    
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_REGISTERED, NULL);
+    app_controller_process_sip_events();
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_get_system_state(&state));
+    TEST_ASSERT_EQUAL(APP_STATE_IDLE, state.app_state);
+    TEST_ASSERT_TRUE(state.sip_registered);
+    
+    // A call the far end answers and hangs up
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start_call(NULL));
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_CALL_CONNECTED, NULL);
+    app_controller_process_sip_events();
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_get_system_state(&state));
+    TEST_ASSERT_EQUAL(APP_STATE_CONNECTED, state.app_state);
+    
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_CALL_ENDED, NULL);
+    app_controller_process_sip_events();
+    TEST_ASSERT_EQUAL(ESP_OK, app_controller_get_system_state(&state));
+    TEST_ASSERT_EQUAL(APP_STATE_IDLE, state.app_state);
+    TEST_ASSERT_EQUAL(SIP_STATE_REGISTERED, state.sip_state);
+    TEST_ASSERT_TRUE(state.sip_registered);
+    
+    sip_manager_stop();
+}
+
 void test_app_controller_relay_state_handling(void)
 {
     ESP_LOGI(TAG, "Testing relay state change handling");
@@ -409,8 +521,10 @@ void app_main(void)
     RUN_TEST(test_app_controller_get_system_state);
     RUN_TEST(test_app_controller_state_transitions);
     RUN_TEST(test_app_controller_button_press_handling);
+    RUN_TEST(test_app_controller_button_press_drives_call);
     RUN_TEST(test_app_controller_dtmf_handling);
     RUN_TEST(test_app_controller_sip_state_handling);
+    RUN_TEST(test_app_controller_sip_event_pump);
     RUN_TEST(test_app_controller_relay_state_handling);
     RUN_TEST(test_app_controller_error_handling);
     RUN_TEST(test_app_controller_utility_functions);
@@ -0,0 +1,89 @@
+#include "unity.h"
+#include "audio_ring.h"
+#include <string.h>
+
+#define RING_TEST_FRAME     160
+
+static audio_ring_t ring;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(audio_ring_init(&ring, RING_TEST_FRAME));
+}
+
+void tearDown(void)
+{
+}
+
+void test_audio_ring_rejects_bad_frame_sizes(void)
+{
+    TEST_ASSERT_FALSE(audio_ring_init(&ring, 0));
+    TEST_ASSERT_FALSE(audio_ring_init(&ring, AUDIO_RING_MAX_FRAME_SAMPLES + 1));
+    TEST_ASSERT_TRUE(audio_ring_init(&ring, AUDIO_RING_MAX_FRAME_SAMPLES));
+}
+
+void test_audio_ring_hands_over_the_slot_in_place(void)
+{
+    int16_t *slot = audio_ring_write_begin(&ring);
+    TEST_ASSERT_NOT_NULL(slot);
+    TEST_ASSERT_EQUAL_PTR(slot, audio_ring_write_begin(&ring));
+    for (int i = 0; i < RING_TEST_FRAME; i++) {
+        slot[i] = (int16_t)i;
+    }
+    audio_ring_write_end(&ring, 123456);
+    TEST_ASSERT_EQUAL(1, audio_ring_count(&ring));
+
+    int64_t stamp_us = 0;
+    int16_t *frame = audio_ring_read_begin(&ring, &stamp_us);
+    // The consumer works on the very memory the producer filled
+    TEST_ASSERT_EQUAL_PTR(slot, frame);
+    TEST_ASSERT_EQUAL(123456, (int32_t)stamp_us);
+    TEST_ASSERT_EQUAL(RING_TEST_FRAME - 1, frame[RING_TEST_FRAME - 1]);
+    audio_ring_read_end(&ring);
+    TEST_ASSERT_EQUAL(0, audio_ring_count(&ring));
+    TEST_ASSERT_EQUAL(1, ring.stats.frames_written);
+    TEST_ASSERT_EQUAL(1, ring.stats.frames_read);
+}
+
+void test_audio_ring_counts_overruns_and_underruns(void)
+{
+    TEST_ASSERT_NULL(audio_ring_read_begin(&ring, NULL));
+    TEST_ASSERT_EQUAL(1, ring.stats.underruns);
+
+    for (int i = 0; i < AUDIO_RING_FRAMES; i++) {
+        TEST_ASSERT_NOT_NULL(audio_ring_write_begin(&ring));
+        audio_ring_write_end(&ring, i);
+    }
+    TEST_ASSERT_NULL(audio_ring_write_begin(&ring));
+    TEST_ASSERT_EQUAL(1, ring.stats.overruns);
+    TEST_ASSERT_EQUAL(AUDIO_RING_FRAMES, ring.stats.high_water);
+
+    // A released slot can be filled again
+    TEST_ASSERT_NOT_NULL(audio_ring_read_begin(&ring, NULL));
+    audio_ring_read_end(&ring);
+    TEST_ASSERT_NOT_NULL(audio_ring_write_begin(&ring));
+    TEST_ASSERT_EQUAL(1, ring.stats.overruns);
+}
+
+void test_audio_ring_keeps_order_across_wraparound(void)
+{
+    for (int i = 0; i < 5 * AUDIO_RING_FRAMES; i++) {
+        int16_t *slot = audio_ring_write_begin(&ring);
+        TEST_ASSERT_NOT_NULL(slot);
+        slot[0] = (int16_t)i;
+        audio_ring_write_end(&ring, 1000 * i);
+        if (i % 3 != 2) {
+            continue;
+        }
+        // The consumer lags behind and catches up every third frame
+        while (audio_ring_count(&ring) > 0) {
+            int64_t stamp_us;
+            int16_t *frame = audio_ring_read_begin(&ring, &stamp_us);
+            TEST_ASSERT_EQUAL((int32_t)stamp_us / 1000, frame[0]);
+            audio_ring_read_end(&ring);
+        }
+    }
+    TEST_ASSERT_EQUAL(0, ring.stats.overruns);
+    TEST_ASSERT_EQUAL(ring.stats.frames_written - audio_ring_count(&ring), ring.stats.frames_read);
+    TEST_ASSERT_EQUAL(3, ring.stats.high_water);
+}
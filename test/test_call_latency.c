@@ -0,0 +1,119 @@
+#include "unity.h"
+#include "call_latency.h"
+#include <string.h>
+
+static call_latency_histograms_t hist;
+
+void setUp(void)
+{
+    call_latency_reset();
+    memset(&hist, 0, sizeof(hist));
+}
+
+void tearDown(void)
+{
+}
+
+void test_call_latency_bucket_layout(void)
+{
+    TEST_ASSERT_EQUAL(0, call_latency_bucket_index(0));
+    TEST_ASSERT_EQUAL(0, call_latency_bucket_index(1023));
+    TEST_ASSERT_EQUAL(1, call_latency_bucket_index(1024));
+    TEST_ASSERT_EQUAL(2, call_latency_bucket_index(1280));
+    TEST_ASSERT_EQUAL(5, call_latency_bucket_index(2048));
+    TEST_ASSERT_EQUAL(CALL_LATENCY_BUCKETS - 1, call_latency_bucket_index(UINT32_MAX));
+
+    // Every value lies below the upper bound of its bucket and at or above the previous one
+    for (uint32_t v = 1000; v < 60000000; v += v / 7) {
+        uint32_t i = call_latency_bucket_index(v);
+        TEST_ASSERT_TRUE(v < call_latency_bucket_upper_us(i));
+        if (i > 0) {
+            TEST_ASSERT_TRUE(v >= call_latency_bucket_upper_us(i - 1));
+        }
+    }
+}
+
+void test_call_latency_percentiles(void)
+{
+    call_latency_histogram_t h;
+    memset(&h, 0, sizeof(h));
+
+    TEST_ASSERT_EQUAL(0, call_latency_percentile_us(&h, 50));
+
+    // 98 samples around 100 ms, two outliers around 2 s
+    for (int i = 0; i < 98; i++) {
+        h.buckets[call_latency_bucket_index(100000)]++;
+    }
+    h.buckets[call_latency_bucket_index(2000000)] += 2;
+    h.count = 100;
+    h.min_us = 100000;
+    h.max_us = 2000000;
+
+    uint32_t p50 = call_latency_percentile_us(&h, 50);
+    uint32_t p99 = call_latency_percentile_us(&h, 99);
+    TEST_ASSERT_TRUE(p50 >= 100000 && p50 <= 125000);
+    TEST_ASSERT_TRUE(p99 >= 1500000 && p99 <= 2000000);
+    TEST_ASSERT_EQUAL(2000000, call_latency_percentile_us(&h, 100));
+}
+
+void test_call_latency_phases_from_button_edge(void)
+{
+    const int64_t t0 = 5000000;
+
+    call_latency_mark_at(CALL_LATENCY_BUTTON_EDGE, t0);
+    call_latency_mark_at(CALL_LATENCY_BUTTON_HANDLED, t0 + 2000);
+    call_latency_mark_at(CALL_LATENCY_INVITE_SENT, t0 + 9000);
+    call_latency_mark_at(CALL_LATENCY_TRYING, t0 + 30000);
+    call_latency_mark_at(CALL_LATENCY_RINGING, t0 + 80000);
+    call_latency_mark_at(CALL_LATENCY_RINGING, t0 + 95000);     // second leg, ignored
+    call_latency_mark_at(CALL_LATENCY_ANSWERED, t0 + 4000000);
+    call_latency_mark_at(CALL_LATENCY_ACK_SENT, t0 + 4001000);
+    call_latency_mark_at(CALL_LATENCY_FIRST_RTP, t0 + 4050000);
+    call_latency_end_attempt();
+
+    call_latency_get(&hist);
+    TEST_ASSERT_EQUAL(1, hist.attempts);
+    TEST_ASSERT_EQUAL(0, hist.abandoned);
+    TEST_ASSERT_EQUAL(0, hist.phase[CALL_LATENCY_BUTTON_EDGE].count);
+    TEST_ASSERT_EQUAL(1, hist.phase[CALL_LATENCY_RINGING].count);
+    TEST_ASSERT_EQUAL(80000, hist.phase[CALL_LATENCY_RINGING].max_us);
+    TEST_ASSERT_EQUAL(9000, hist.phase[CALL_LATENCY_INVITE_SENT].min_us);
+    TEST_ASSERT_EQUAL(4050000, hist.phase[CALL_LATENCY_FIRST_RTP].sum_us);
+
+    // Marks after the attempt closed belong to nothing
+    call_latency_mark_at(CALL_LATENCY_FIRST_RTP, t0 + 6000000);
+    call_latency_get(&hist);
+    TEST_ASSERT_EQUAL(1, hist.phase[CALL_LATENCY_FIRST_RTP].count);
+}
+
+void test_call_latency_attempt_boundaries(void)
+{
+    // A call started without the button is timed from its INVITE
+    call_latency_mark_at(CALL_LATENCY_INVITE_SENT, 1000000);
+    call_latency_mark_at(CALL_LATENCY_RINGING, 1100000);
+
+    // The next INVITE starts a new attempt; the last one was never answered
+    call_latency_mark_at(CALL_LATENCY_INVITE_SENT, 9000000);
+    call_latency_mark_at(CALL_LATENCY_RINGING, 9300000);
+    call_latency_mark_at(CALL_LATENCY_ANSWERED, 9500000);
+
+    call_latency_get(&hist);
+    TEST_ASSERT_EQUAL(2, hist.attempts);
+    TEST_ASSERT_EQUAL(1, hist.abandoned);
+    TEST_ASSERT_EQUAL(0, hist.phase[CALL_LATENCY_INVITE_SENT].count);
+    TEST_ASSERT_EQUAL(2, hist.phase[CALL_LATENCY_RINGING].count);
+    TEST_ASSERT_EQUAL(100000, hist.phase[CALL_LATENCY_RINGING].min_us);
+    TEST_ASSERT_EQUAL(300000, hist.phase[CALL_LATENCY_RINGING].max_us);
+
+    // A stale attempt is dropped instead of producing a huge sample
+    call_latency_mark_at(CALL_LATENCY_BUTTON_EDGE, 20000000);
+    call_latency_mark_at(CALL_LATENCY_BUTTON_HANDLED, 20000000 + CALL_LATENCY_ATTEMPT_MAX_US + 1);
+    call_latency_get(&hist);
+    TEST_ASSERT_EQUAL(0, hist.phase[CALL_LATENCY_BUTTON_HANDLED].count);
+    TEST_ASSERT_EQUAL(2, hist.abandoned);
+
+    call_latency_reset();
+    call_latency_get(&hist);
+    TEST_ASSERT_EQUAL(0, hist.attempts);
+    TEST_ASSERT_EQUAL(0, hist.phase[CALL_LATENCY_RINGING].count);
+}
@@ -0,0 +1,76 @@
+#include "unity.h"
+#include "comfort_noise.h"
+#include <math.h>
+#include <string.h>
+
+#define CN_TEST_SAMPLES     8000    // 1 s at 8 kHz
+
+static comfort_noise_t cn;
+static int16_t pcm[CN_TEST_SAMPLES];
+
+void setUp(void)
+{
+    comfort_noise_init(&cn, 1);
+}
+
+void tearDown(void)
+{
+}
+
+static double level_dbov(const int16_t *samples, size_t count)
+{
+    double energy = 0;
+    for (size_t i = 0; i < count; i++) {
+        energy += (double)samples[i] * samples[i];
+    }
+    return 10 * log10(energy / count / (32767.0 * 32767.0));
+}
+
+void test_comfort_noise_payload(void)
+{
+    uint8_t payload[4];
+
+    TEST_ASSERT_EQUAL(COMFORT_NOISE_PAYLOAD_SIZE, comfort_noise_write(52, payload));
+    TEST_ASSERT_EQUAL(52, payload[0]);
+    comfort_noise_write(200, payload);
+    TEST_ASSERT_EQUAL(COMFORT_NOISE_MAX_LEVEL, payload[0]);
+
+    TEST_ASSERT_TRUE(comfort_noise_receive(&cn, payload, 1));
+    TEST_ASSERT_EQUAL(COMFORT_NOISE_MAX_LEVEL, cn.level);
+    // Spectral information after the level is accepted and ignored
+    const uint8_t shaped[] = { 60, 130, 120, 127 };
+    TEST_ASSERT_TRUE(comfort_noise_receive(&cn, shaped, sizeof(shaped)));
+    TEST_ASSERT_EQUAL(60, cn.level);
+
+    const uint8_t bad[] = { 128 };
+    TEST_ASSERT_FALSE(comfort_noise_receive(&cn, bad, sizeof(bad)));
+    TEST_ASSERT_FALSE(comfort_noise_receive(&cn, shaped, 0));
+    TEST_ASSERT_EQUAL(60, cn.level);
+}
+
+void test_comfort_noise_plays_at_received_level(void)
+{
+    // Silent until the first comfort noise packet
+    comfort_noise_generate(&cn, pcm, CN_TEST_SAMPLES);
+    for (int i = 0; i < CN_TEST_SAMPLES; i++) {
+        TEST_ASSERT_EQUAL(0, pcm[i]);
+    }
+
+    static const uint8_t levels[] = { 30, 50, 70 };
+    for (size_t l = 0; l < sizeof(levels); l++) {
+        TEST_ASSERT_TRUE(comfort_noise_receive(&cn, &levels[l], 1));
+        comfort_noise_generate(&cn, pcm, CN_TEST_SAMPLES);
+        TEST_ASSERT_TRUE(fabs(level_dbov(pcm, CN_TEST_SAMPLES) + levels[l]) < 0.5);
+    }
+
+    // White: neighbouring samples are uncorrelated
+    double corr = 0;
+    double energy = 0;
+    TEST_ASSERT_TRUE(comfort_noise_receive(&cn, levels, 1));
+    comfort_noise_generate(&cn, pcm, CN_TEST_SAMPLES);
+    for (int i = 1; i < CN_TEST_SAMPLES; i++) {
+        corr += (double)pcm[i] * pcm[i - 1];
+        energy += (double)pcm[i] * pcm[i];
+    }
+    TEST_ASSERT_TRUE(fabs(corr / energy) < 0.05);
+}
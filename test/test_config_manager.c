@@ -163,6 +163,23 @@ void test_config_validation_sip_callee_invalid_no_at(void) {
     TEST_ASSERT_EQUAL(CONFIG_VALIDATION_SIP_CALLEE_INVALID, result);
 }
 
+void test_config_validation_sip_callee_list(void) {
+    door_station_config_t config;
+    config_manager_get_defaults(&config);
+    
+    // Several callees are rung in parallel
+    strcpy(config.sip_callee, "flat1@pbx.local, sip:flat1_mobile@pbx.local");
+    TEST_ASSERT_EQUAL(CONFIG_VALIDATION_OK, config_manager_validate(&config));
+    
+    // Every entry must be a valid URI
+    strcpy(config.sip_callee, "flat1@pbx.local,invaliduri");
+    TEST_ASSERT_EQUAL(CONFIG_VALIDATION_SIP_CALLEE_INVALID, config_manager_validate(&config));
+    
+    // No more than CONFIG_MAX_SIP_CALLEES entries
+    strcpy(config.sip_callee, "aaa@x.com,bbb@x.com,ccc@x.com,ddd@x.com,eee@x.com");
+    TEST_ASSERT_EQUAL(CONFIG_VALIDATION_SIP_CALLEE_INVALID, config_manager_validate(&config));
+}
+
 void test_config_validation_web_port_too_low(void) {
     door_station_config_t config;
     config_manager_get_defaults(&config);
@@ -0,0 +1,186 @@
+#include "unity.h"
+#include "dtmf_detect.h"
+#include <math.h>
+#include <string.h>
+
+#define FRAME_SAMPLES   160
+#define TONE_AMPLITUDE  7200        // About -10 dBm0 per tone
+
+static const float row_hz[4] = { 697, 770, 852, 941 };
+static const float col_hz[4] = { 1209, 1336, 1477, 1633 };
+static const char keypad[] = "123A456B789C*0#D";
+
+static dtmf_detector_t detector;
+static int16_t signal_buf[8000];
+
+void setUp(void)
+{
+    dtmf_detector_init(&detector);
+    memset(signal_buf, 0, sizeof(signal_buf));
+}
+
+void tearDown(void)
+{
+}
+
+static void add_tone(int16_t *pcm, size_t samples, float hz, float amplitude)
+{
+    for (size_t i = 0; i < samples; i++) {
+        pcm[i] += (int16_t)(amplitude * sinf(2.0f * (float)M_PI * hz * (float)i / DTMF_DETECT_SAMPLE_RATE));
+    }
+}
+
+static void add_key(int16_t *pcm, size_t samples, char key, float row_amplitude, float col_amplitude)
+{
+    int index = (int)(strchr(keypad, key) - keypad);
+    add_tone(pcm, samples, row_hz[index / 4], row_amplitude);
+    add_tone(pcm, samples, col_hz[index % 4], col_amplitude);
+}
+
+/**
+ * @brief Run a signal through the detector frame by frame, collecting the digits
+ */
+static size_t detect(const int16_t *pcm, size_t samples, char *digits, size_t max_digits)
+{
+    size_t count = 0;
+    for (size_t i = 0; i + FRAME_SAMPLES <= samples; i += FRAME_SAMPLES) {
+        char digit = dtmf_detector_process(&detector, pcm + i, FRAME_SAMPLES);
+        if (digit != '\0' && count < max_digits) {
+            digits[count++] = digit;
+        }
+    }
+    return count;
+}
+
+void test_dtmf_detect_all_digits(void)
+{
+    char digits[4];
+
+    for (int k = 0; k < 16; k++) {
+        setUp();
+        // 100 ms of tone starting mid-frame, then silence
+        add_key(signal_buf + 37, 800, keypad[k], TONE_AMPLITUDE, TONE_AMPLITUDE);
+        TEST_ASSERT_EQUAL(1, detect(signal_buf, 1600, digits, sizeof(digits)));
+        TEST_ASSERT_EQUAL_CHAR(keypad[k], digits[0]);
+    }
+}
+
+void test_dtmf_detect_level_and_twist(void)
+{
+    int16_t block[FRAME_SAMPLES];
+
+    // Column tone 3 dB above the row tone passes, 6 dB does not
+    memset(block, 0, sizeof(block));
+    add_key(block, FRAME_SAMPLES, '5', 5000, 5000 * 1.41f);
+    TEST_ASSERT_EQUAL_CHAR('5', dtmf_detect_block(block, FRAME_SAMPLES));
+    memset(block, 0, sizeof(block));
+    add_key(block, FRAME_SAMPLES, '5', 5000, 5000 * 2.0f);
+    TEST_ASSERT_EQUAL_CHAR('\0', dtmf_detect_block(block, FRAME_SAMPLES));
+
+    // Row tone 7 dB above the column tone passes, 10 dB does not
+    memset(block, 0, sizeof(block));
+    add_key(block, FRAME_SAMPLES, '9', 8000, 8000 / 2.24f);
+    TEST_ASSERT_EQUAL_CHAR('9', dtmf_detect_block(block, FRAME_SAMPLES));
+    memset(block, 0, sizeof(block));
+    add_key(block, FRAME_SAMPLES, '9', 8000, 8000 / 3.16f);
+    TEST_ASSERT_EQUAL_CHAR('\0', dtmf_detect_block(block, FRAME_SAMPLES));
+
+    // Too quiet, and a single tone
+    memset(block, 0, sizeof(block));
+    add_key(block, FRAME_SAMPLES, '#', 500, 500);
+    TEST_ASSERT_EQUAL_CHAR('\0', dtmf_detect_block(block, FRAME_SAMPLES));
+    memset(block, 0, sizeof(block));
+    add_tone(block, FRAME_SAMPLES, 1336, TONE_AMPLITUDE);
+    TEST_ASSERT_EQUAL_CHAR('\0', dtmf_detect_block(block, FRAME_SAMPLES));
+}
+
+void test_dtmf_detect_duration(void)
+{
+    char digits[4];
+
+    // 30 ms is too short wherever it falls
+    add_key(signal_buf + 90, 240, '1', TONE_AMPLITUDE, TONE_AMPLITUDE);
+    TEST_ASSERT_EQUAL(0, detect(signal_buf, 960, digits, sizeof(digits)));
+
+    // 50 ms is long enough at the worst alignment
+    setUp();
+    add_key(signal_buf + 120, 400, '1', TONE_AMPLITUDE, TONE_AMPLITUDE);
+    TEST_ASSERT_EQUAL(1, detect(signal_buf, 960, digits, sizeof(digits)));
+
+    // A 20 ms dropout inside a long tone is still one key press
+    setUp();
+    add_key(signal_buf, 800, '7', TONE_AMPLITUDE, TONE_AMPLITUDE);
+    add_key(signal_buf + 960, 800, '7', TONE_AMPLITUDE, TONE_AMPLITUDE);
+    TEST_ASSERT_EQUAL(1, detect(signal_buf, 2400, digits, sizeof(digits)));
+
+    // The same key twice with a 60 ms pause is two presses
+    setUp();
+    add_key(signal_buf, 800, '7', TONE_AMPLITUDE, TONE_AMPLITUDE);
+    add_key(signal_buf + 1280, 800, '7', TONE_AMPLITUDE, TONE_AMPLITUDE);
+    TEST_ASSERT_EQUAL(2, detect(signal_buf, 2400, digits, sizeof(digits)));
+    TEST_ASSERT_EQUAL(2, detector.digits);
+}
+
+/**
+ * @brief Synthesize a vowel: a glottal pulse train with a gliding pitch
+ *        through three formant resonators
+ */
+static void add_vowel(int16_t *pcm, size_t samples, float f0_start, float f0_end,
+                      const float formants[3], float peak)
+{
+    float y1[3] = { 0 };
+    float y2[3] = { 0 };
+    float phase = 1.0f;
+    float out[1600];
+
+    TEST_ASSERT_TRUE(samples <= sizeof(out) / sizeof(out[0]));
+    float max = 0;
+    for (size_t i = 0; i < samples; i++) {
+        float f0 = f0_start + (f0_end - f0_start) * (float)i / (float)samples;
+        phase += f0 / DTMF_DETECT_SAMPLE_RATE;
+        float x = 0;
+        if (phase >= 1.0f) {
+            phase -= 1.0f;
+            x = 1.0f;
+        }
+        for (int f = 0; f < 3; f++) {
+            float r = expf(-(float)M_PI * (60.0f + 20.0f * f) / DTMF_DETECT_SAMPLE_RATE);
+            float c = 2.0f * r * cosf(2.0f * (float)M_PI * formants[f] / DTMF_DETECT_SAMPLE_RATE);
+            float y = x + c * y1[f] - r * r * y2[f];
+            y2[f] = y1[f];
+            y1[f] = y;
+            x = y;
+        }
+        out[i] = x;
+        if (fabsf(x) > max) {
+            max = fabsf(x);
+        }
+    }
+    for (size_t i = 0; i < samples; i++) {
+        pcm[i] += (int16_t)(out[i] / max * peak);
+    }
+}
+
+void test_dtmf_detect_rejects_speech(void)
+{
+    // Formants of /a/, /i/, /u/, /e/, /o/ and /ae/, several close to DTMF tones
+    static const float vowels[6][3] = {
+        { 730, 1090, 2440 }, { 270, 2290, 3010 }, { 300, 870, 2240 },
+        { 530, 1840, 2480 }, { 570, 840, 2410 }, { 660, 1720, 2410 }
+    };
+    char digits[8];
+    size_t detected = 0;
+
+    // Male and female pitch ranges, rising and falling, loud and soft
+    for (int speaker = 0; speaker < 4; speaker++) {
+        float f0 = speaker < 2 ? 95.0f : 190.0f;
+        float peak = speaker % 2 ? 24000.0f : 6000.0f;
+        for (int v = 0; v < 6; v++) {
+            setUp();
+            add_vowel(signal_buf, 1600, f0, f0 * (v % 2 ? 1.3f : 0.8f), vowels[v], peak);
+            add_vowel(signal_buf + 1600, 1600, f0 * 1.1f, f0 * 1.1f, vowels[(v + 1) % 6], peak);
+            detected += detect(signal_buf, 3200, digits, sizeof(digits));
+        }
+    }
+    TEST_ASSERT_EQUAL(0, detected);
+}
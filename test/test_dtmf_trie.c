@@ -0,0 +1,139 @@
+#include "unity.h"
+#include "dtmf_trie.h"
+#include <string.h>
+
+#define TIMEOUT_MS  3000
+
+static dtmf_trie_t trie;
+static dtmf_trie_cursor_t cursor;
+
+void setUp(void)
+{
+    dtmf_trie_clear(&trie);
+    dtmf_trie_cursor_reset(&cursor);
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Type digits 100 ms apart, returning the last entry reported
+ */
+static int type(const char *digits, uint32_t *now_ms)
+{
+    int entry = -1;
+    for (const char *d = digits; *d != '\0'; d++) {
+        *now_ms += 100;
+        int result = dtmf_trie_feed(&trie, &cursor, *d, *now_ms, TIMEOUT_MS);
+        if (result >= 0) {
+            entry = result;
+        }
+    }
+    return entry;
+}
+
+void test_dtmf_trie_sequences(void)
+{
+    uint32_t now = 0;
+
+    TEST_ASSERT_TRUE(dtmf_trie_add(&trie, "*1234#", 0));
+    TEST_ASSERT_TRUE(dtmf_trie_add(&trie, "*1299#", 1));
+    TEST_ASSERT_TRUE(dtmf_trie_add(&trie, "0", 2));
+    TEST_ASSERT_TRUE(dtmf_trie_add(&trie, "a5", 3));
+
+    // Each digit of a sequence is one step, the entry comes with the last
+    TEST_ASSERT_EQUAL(-1, type("*1234", &now));
+    TEST_ASSERT_TRUE(dtmf_trie_pending(&cursor));
+    TEST_ASSERT_EQUAL(0, type("#", &now));
+    TEST_ASSERT_FALSE(dtmf_trie_pending(&cursor));
+
+    TEST_ASSERT_EQUAL(1, type("*1299#", &now));
+    TEST_ASSERT_EQUAL(2, type("0", &now));
+    TEST_ASSERT_EQUAL(3, type("A5", &now));
+
+    // A wrong digit drops the input, and may itself start a sequence
+    TEST_ASSERT_EQUAL(-1, type("*125", &now));
+    TEST_ASSERT_FALSE(dtmf_trie_pending(&cursor));
+    TEST_ASSERT_EQUAL(2, type("*120", &now));
+    TEST_ASSERT_EQUAL(0, type("*12*1234#", &now));
+
+    // Unknown characters reset the input
+    TEST_ASSERT_EQUAL(-1, type("*12x34#", &now));
+}
+
+void test_dtmf_trie_prefix_timeout(void)
+{
+    uint32_t now = 0;
+
+    TEST_ASSERT_TRUE(dtmf_trie_add(&trie, "*", 0));
+    TEST_ASSERT_TRUE(dtmf_trie_add(&trie, "*1234#", 1));
+
+    // '*' alone waits for the timeout, since more digits may follow
+    TEST_ASSERT_EQUAL(-1, type("*", &now));
+    TEST_ASSERT_TRUE(dtmf_trie_pending(&cursor));
+    TEST_ASSERT_EQUAL(-1, dtmf_trie_expire(&trie, &cursor, now + TIMEOUT_MS - 1, TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(0, dtmf_trie_expire(&trie, &cursor, now + TIMEOUT_MS, TIMEOUT_MS));
+    TEST_ASSERT_FALSE(dtmf_trie_pending(&cursor));
+
+    // The longer sequence completes without waiting
+    TEST_ASSERT_EQUAL(1, type("*1234#", &now));
+
+    // An unfinished sequence reports nothing when it expires
+    TEST_ASSERT_EQUAL(-1, type("*12", &now));
+    TEST_ASSERT_EQUAL(-1, dtmf_trie_expire(&trie, &cursor, now + TIMEOUT_MS, TIMEOUT_MS));
+    TEST_ASSERT_FALSE(dtmf_trie_pending(&cursor));
+}
+
+void test_dtmf_trie_interdigit_timeout(void)
+{
+    uint32_t now = 0;
+
+    TEST_ASSERT_TRUE(dtmf_trie_add(&trie, "1234", 0));
+
+    // Digits typed too slowly are discarded, the late digit starts over
+    TEST_ASSERT_EQUAL(-1, type("12", &now));
+    now += TIMEOUT_MS + 1;
+    TEST_ASSERT_EQUAL(-1, dtmf_trie_feed(&trie, &cursor, '3', now, TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(-1, type("4", &now));
+    TEST_ASSERT_FALSE(dtmf_trie_pending(&cursor));
+
+    // Exactly at the timeout still counts
+    TEST_ASSERT_EQUAL(-1, type("123", &now));
+    now += TIMEOUT_MS;
+    TEST_ASSERT_EQUAL(0, dtmf_trie_feed(&trie, &cursor, '4', now, TIMEOUT_MS));
+
+    // Across the wrap of the millisecond clock
+    now = UINT32_MAX - 150;
+    TEST_ASSERT_EQUAL(0, type("1234", &now));
+}
+
+void test_dtmf_trie_add_limits(void)
+{
+    char sequence[DTMF_TRIE_MAX_SEQUENCE + 2];
+
+    TEST_ASSERT_FALSE(dtmf_trie_add(&trie, "", 0));
+    TEST_ASSERT_FALSE(dtmf_trie_add(&trie, "12E", 0));
+    TEST_ASSERT_FALSE(dtmf_trie_add(&trie, "1", -1));
+    TEST_ASSERT_FALSE(dtmf_trie_add(&trie, "1", DTMF_TRIE_MAX_ENTRIES));
+    memset(sequence, '7', DTMF_TRIE_MAX_SEQUENCE + 1);
+    sequence[DTMF_TRIE_MAX_SEQUENCE + 1] = '\0';
+    TEST_ASSERT_FALSE(dtmf_trie_add(&trie, sequence, 0));
+
+    TEST_ASSERT_TRUE(dtmf_trie_add(&trie, "#9", 0));
+    TEST_ASSERT_FALSE(dtmf_trie_add(&trie, "#9", 1));
+
+    // The pool holds the longest sequences without shared prefixes
+    static const char keys[] = "0123456789*#ABCD";
+    setUp();
+    for (int i = 0; i < DTMF_TRIE_MAX_ENTRIES; i++) {
+        memset(sequence, keys[i], DTMF_TRIE_MAX_SEQUENCE);
+        sequence[DTMF_TRIE_MAX_SEQUENCE] = '\0';
+        TEST_ASSERT_TRUE(dtmf_trie_add(&trie, sequence, i));
+    }
+    TEST_ASSERT_EQUAL(DTMF_TRIE_MAX_NODES, trie.node_count);
+
+    uint32_t now = 0;
+    TEST_ASSERT_EQUAL(15, type("DDDDDDDD", &now));
+    TEST_ASSERT_EQUAL(10, type("********", &now));
+}
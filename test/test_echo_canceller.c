@@ -0,0 +1,124 @@
+#include "unity.h"
+#include "echo_canceller.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AEC_TEST_RATE       8000
+#define AEC_TEST_FRAME      160
+#define AEC_TEST_SECONDS    4
+#define AEC_TEST_SAMPLES    (AEC_TEST_RATE * AEC_TEST_SECONDS)
+#define AEC_PATH_LEN        120     // 15 ms: direct sound plus two reflections
+
+static echo_canceller_t aec;
+static int16_t far_end[AEC_TEST_SAMPLES];
+static int16_t mic[AEC_TEST_SAMPLES];
+static int16_t out[AEC_TEST_SAMPLES];
+static float echo_path[AEC_PATH_LEN];
+
+void setUp(void)
+{
+    srand(7);
+    memset(echo_path, 0, sizeof(echo_path));
+    echo_path[24] = 0.4f;
+    echo_path[25] = -0.2f;
+    echo_path[60] = 0.15f;
+    echo_path[110] = -0.05f;
+    TEST_ASSERT_TRUE(echo_canceller_init(&aec, AEC_TEST_RATE));
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Fill far_end with noise and mic with its echo, plus near_level of near-end noise
+ */
+static void make_echo(int near_level)
+{
+    for (int i = 0; i < AEC_TEST_SAMPLES; i++) {
+        far_end[i] = (int16_t)(rand() % 16001 - 8000);
+    }
+    for (int i = 0; i < AEC_TEST_SAMPLES; i++) {
+        float echo = 0;
+        for (int j = 0; j < AEC_PATH_LEN && j <= i; j++) {
+            echo += echo_path[j] * far_end[i - j];
+        }
+        int noise = near_level > 0 ? rand() % (2 * near_level + 1) - near_level : 0;
+        mic[i] = (int16_t)(echo + noise);
+    }
+}
+
+/**
+ * @brief Play and capture frame by frame, as the RTP task does
+ */
+static void run_frames(int from, int to)
+{
+    for (int i = from; i < to; i += AEC_TEST_FRAME) {
+        echo_canceller_far_end(&aec, far_end + i, AEC_TEST_FRAME);
+        echo_canceller_process(&aec, mic + i, out + i, AEC_TEST_FRAME);
+    }
+}
+
+static double erle_db(int from, int to)
+{
+    double in = 0;
+    double residual = 0;
+    for (int i = from; i < to; i++) {
+        in += (double)mic[i] * mic[i];
+        residual += (double)out[i] * out[i];
+    }
+    return 10 * log10(in / residual);
+}
+
+void test_echo_canceller_rejects_unknown_rate(void)
+{
+    TEST_ASSERT_FALSE(echo_canceller_init(&aec, 44100));
+    TEST_ASSERT_TRUE(echo_canceller_init(&aec, 16000));
+}
+
+void test_echo_canceller_passes_near_end_without_far_end(void)
+{
+    for (int i = 0; i < AEC_TEST_FRAME; i++) {
+        mic[i] = (int16_t)(10000 * sin(2 * M_PI * 440 * i / AEC_TEST_RATE));
+    }
+    echo_canceller_process(&aec, mic, out, AEC_TEST_FRAME);
+
+    TEST_ASSERT_EQUAL_INT16_ARRAY(mic, out, AEC_TEST_FRAME);
+    TEST_ASSERT_TRUE(echo_canceller_erle_db(&aec) == 0.0f);
+}
+
+void test_echo_canceller_converges(void)
+{
+    make_echo(0);
+    run_frames(0, AEC_TEST_SAMPLES);
+
+    // Converged within the first second, then far below the echo
+    TEST_ASSERT_TRUE(erle_db(AEC_TEST_RATE, 2 * AEC_TEST_RATE) > 25.0);
+    TEST_ASSERT_TRUE(erle_db(AEC_TEST_SAMPLES - AEC_TEST_RATE, AEC_TEST_SAMPLES) > 40.0);
+    TEST_ASSERT_TRUE(echo_canceller_erle_db(&aec) > 15.0f);
+}
+
+void test_echo_canceller_holds_during_double_talk(void)
+{
+    make_echo(0);
+    run_frames(0, 2 * AEC_TEST_RATE);
+
+    // One second of loud near-end speech over the echo
+    for (int i = 2 * AEC_TEST_RATE; i < 3 * AEC_TEST_RATE; i++) {
+        mic[i] = (int16_t)(mic[i] + 12000 * sin(2 * M_PI * 300 * i / AEC_TEST_RATE));
+    }
+    run_frames(2 * AEC_TEST_RATE, 3 * AEC_TEST_RATE);
+    TEST_ASSERT_TRUE(aec.double_talk > AEC_TEST_RATE / 2);
+
+    // The near-end speech came through and the echo is still cancelled after it
+    for (int i = 3 * AEC_TEST_RATE; i < AEC_TEST_SAMPLES; i++) {
+        float echo = 0;
+        for (int j = 0; j < AEC_PATH_LEN; j++) {
+            echo += echo_path[j] * far_end[i - j];
+        }
+        mic[i] = (int16_t)echo;
+    }
+    run_frames(3 * AEC_TEST_RATE, AEC_TEST_SAMPLES);
+    TEST_ASSERT_TRUE(erle_db(3 * AEC_TEST_RATE, 3 * AEC_TEST_RATE + AEC_TEST_RATE / 10) > 30.0);
+}
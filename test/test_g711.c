@@ -0,0 +1,76 @@
+#include "unity.h"
+#include "g711.h"
+#include <math.h>
+#include <string.h>
+
+#define G711_TEST_FRAME 160
+
+void setUp(void)
+{
+    g711_init();
+}
+
+void tearDown(void)
+{
+}
+
+void test_g711_tables_match_reference(void)
+{
+    int16_t pcm[1];
+    uint8_t code[1];
+
+    for (int32_t sample = INT16_MIN; sample <= INT16_MAX; sample++) {
+        pcm[0] = (int16_t)sample;
+        g711_encode(G711_ULAW, pcm, code, 1);
+        TEST_ASSERT_EQUAL_HEX8(g711_linear_to_ulaw(pcm[0]), code[0]);
+        g711_encode(G711_ALAW, pcm, code, 1);
+        TEST_ASSERT_EQUAL_HEX8(g711_linear_to_alaw(pcm[0]), code[0]);
+    }
+
+    for (int i = 0; i < 256; i++) {
+        code[0] = (uint8_t)i;
+        g711_decode(G711_ULAW, code, pcm, 1);
+        TEST_ASSERT_EQUAL_INT16(g711_ulaw_to_linear(code[0]), pcm[0]);
+        g711_decode(G711_ALAW, code, pcm, 1);
+        TEST_ASSERT_EQUAL_INT16(g711_alaw_to_linear(code[0]), pcm[0]);
+    }
+}
+
+void test_g711_known_codes(void)
+{
+    // Silence and full scale as in the G.711 tables
+    TEST_ASSERT_EQUAL_HEX8(0xff, g711_linear_to_ulaw(0));
+    TEST_ASSERT_EQUAL_HEX8(0xd5, g711_linear_to_alaw(0));
+    TEST_ASSERT_EQUAL_HEX8(0x80, g711_linear_to_ulaw(INT16_MAX));
+    TEST_ASSERT_EQUAL_HEX8(0x00, g711_linear_to_ulaw(INT16_MIN));
+    TEST_ASSERT_EQUAL_HEX8(0xaa, g711_linear_to_alaw(INT16_MAX));
+    TEST_ASSERT_EQUAL_HEX8(0x2a, g711_linear_to_alaw(INT16_MIN));
+    TEST_ASSERT_EQUAL_INT16(32124, g711_ulaw_to_linear(0x80));
+    TEST_ASSERT_EQUAL_INT16(32256, g711_alaw_to_linear(0xaa));
+}
+
+void test_g711_frame_round_trip(void)
+{
+    int16_t pcm[G711_TEST_FRAME];
+    int16_t decoded[G711_TEST_FRAME];
+    uint8_t encoded[G711_TEST_FRAME];
+
+    // 440 Hz at -6 dBFS
+    for (int i = 0; i < G711_TEST_FRAME; i++) {
+        pcm[i] = (int16_t)(16384 * sin(2 * M_PI * 440 * i / 8000.0));
+    }
+
+    for (int law = G711_ULAW; law <= G711_ALAW; law++) {
+        g711_encode((g711_law_t)law, pcm, encoded, G711_TEST_FRAME);
+        g711_decode((g711_law_t)law, encoded, decoded, G711_TEST_FRAME);
+
+        double signal = 0;
+        double noise = 0;
+        for (int i = 0; i < G711_TEST_FRAME; i++) {
+            signal += (double)pcm[i] * pcm[i];
+            noise += (double)(pcm[i] - decoded[i]) * (pcm[i] - decoded[i]);
+        }
+        // G.711 gives 36-38 dB SNR over most of its range
+        TEST_ASSERT_TRUE(10 * log10(signal / noise) > 35.0);
+    }
+}
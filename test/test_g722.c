@@ -0,0 +1,138 @@
+#include "unity.h"
+#include "g722.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define G722_TEST_FRAME     320     // 20 ms at 16 kHz
+#define G722_TEST_FRAMES    50
+#define G722_TEST_SAMPLES   (G722_TEST_FRAME * G722_TEST_FRAMES)
+#define G722_QMF_DELAY      22      // Samples the analysis and synthesis filters add
+
+static int16_t pcm[G722_TEST_SAMPLES];
+static int16_t decoded[G722_TEST_SAMPLES];
+static uint8_t encoded[G722_TEST_SAMPLES / 2];
+
+void setUp(void)
+{
+    memset(decoded, 0, sizeof(decoded));
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Run the signal through encoder and decoder, frame by frame
+ */
+static void round_trip(void)
+{
+    g722_state_t encoder;
+    g722_state_t decoder;
+    g722_init(&encoder);
+    g722_init(&decoder);
+
+    for (int i = 0; i < G722_TEST_SAMPLES; i += G722_TEST_FRAME) {
+        TEST_ASSERT_EQUAL(G722_TEST_FRAME / 2, g722_encode(&encoder, pcm + i, encoded + i / 2, G722_TEST_FRAME));
+        TEST_ASSERT_EQUAL(G722_TEST_FRAME, g722_decode(&decoder, encoded + i / 2, decoded + i, G722_TEST_FRAME / 2));
+    }
+}
+
+/**
+ * @brief SNR in dB after the first 200 ms, where both ADPCM loops have converged
+ */
+static double round_trip_snr(double hz)
+{
+    for (int i = 0; i < G722_TEST_SAMPLES; i++) {
+        pcm[i] = (int16_t)(10000 * sin(2 * M_PI * hz * i / G722_SAMPLE_RATE));
+    }
+    round_trip();
+
+    double signal = 0;
+    double noise = 0;
+    for (int i = G722_SAMPLE_RATE / 5; i < G722_TEST_SAMPLES - G722_QMF_DELAY; i++) {
+        double error = decoded[i + G722_QMF_DELAY] - pcm[i];
+        signal += (double)pcm[i] * pcm[i];
+        noise += error * error;
+    }
+    return 10 * log10(signal / noise);
+}
+
+void test_g722_silence_stays_quiet(void)
+{
+    memset(pcm, 0, sizeof(pcm));
+    round_trip();
+
+    for (int i = 0; i < G722_TEST_SAMPLES; i++) {
+        TEST_ASSERT_TRUE(abs(decoded[i]) <= 8);
+    }
+}
+
+void test_g722_lower_band_tone(void)
+{
+    // The 6-bit lower band carries speech well above G.711 quality
+    TEST_ASSERT_TRUE(round_trip_snr(300) > 45.0);
+    TEST_ASSERT_TRUE(round_trip_snr(1000) > 40.0);
+}
+
+void test_g722_upper_band_tone(void)
+{
+    // 6.5 kHz does not exist in G.711 at all; the 2-bit upper band is coarse but keeps it
+    TEST_ASSERT_TRUE(round_trip_snr(6500) > 20.0);
+}
+
+void test_g722_codes_are_deterministic(void)
+{
+    uint8_t first[G722_TEST_FRAME / 2];
+    g722_state_t state;
+
+    for (int i = 0; i < G722_TEST_FRAME; i++) {
+        pcm[i] = (int16_t)(rand() % 20001 - 10000);
+    }
+    g722_init(&state);
+    g722_encode(&state, pcm, first, G722_TEST_FRAME);
+
+    // A reset encoder produces the same codes, a running one does not
+    g722_init(&state);
+    g722_encode(&state, pcm, encoded, G722_TEST_FRAME);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(first, encoded, G722_TEST_FRAME / 2);
+    g722_encode(&state, pcm, encoded, G722_TEST_FRAME);
+    TEST_ASSERT_TRUE(memcmp(first, encoded, G722_TEST_FRAME / 2) != 0);
+}
+
+void test_g722_conceal_keeps_decoder_in_step(void)
+{
+    // A tone that swells, so a decoder left behind by a lost packet is off in level and phase
+    for (int i = 0; i < G722_TEST_SAMPLES; i++) {
+        double level = 2000 + 8000.0 * i / G722_TEST_SAMPLES;
+        pcm[i] = (int16_t)(level * sin(2 * M_PI * 440 * i / G722_SAMPLE_RATE));
+    }
+    round_trip();
+
+    const int lost = 20 * G722_TEST_FRAME;
+    const int next = lost + G722_TEST_FRAME;
+    int16_t after[2][G722_TEST_FRAME];
+    for (int conceal = 0; conceal < 2; conceal++) {
+        g722_state_t decoder;
+        int16_t scratch[G722_TEST_FRAME];
+        g722_init(&decoder);
+        for (int i = 0; i < lost; i += G722_TEST_FRAME) {
+            g722_decode(&decoder, encoded + i / 2, scratch, G722_TEST_FRAME / 2);
+        }
+        if (conceal) {
+            // Perfect concealment: exactly what the lost packet would have decoded to, and what followed
+            g722_conceal(&decoder, decoded + lost, G722_TEST_FRAME);
+        }
+        g722_decode(&decoder, encoded + next / 2, after[conceal], G722_TEST_FRAME / 2);
+    }
+
+    double error[2] = { 0, 0 };
+    for (int conceal = 0; conceal < 2; conceal++) {
+        for (int i = 0; i < G722_TEST_FRAME; i++) {
+            double difference = after[conceal][i] - decoded[next + i];
+            error[conceal] += difference * difference;
+        }
+    }
+    // At least 20 dB closer to the decoder that lost nothing
+    TEST_ASSERT_TRUE(error[1] * 100 < error[0]);
+}
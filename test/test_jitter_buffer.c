@@ -0,0 +1,242 @@
+#include "unity.h"
+#include "jitter_buffer.h"
+#include <string.h>
+
+#define FRAME_TICKS     160         // 20 ms at 8 kHz
+#define FRAME_MS        20
+#define MIN_FRAMES      2
+#define MAX_FRAMES      10
+#define TS_BASE         0xfffff000u // Wraps a few packets into the stream
+
+/**
+ * @brief One packet of a recorded arrival trace
+ */
+typedef struct {
+    uint16_t seq;               ///< Frame number, the timestamp is TS_BASE + seq * FRAME_TICKS
+    uint16_t arrival_ms;
+} trace_entry_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t missing;
+    uint32_t buffering;
+    int32_t last_seq;           ///< Frame number of the last frame played
+    bool in_order;              ///< Frames came out in timestamp order
+} replay_result_t;
+
+static jitter_buffer_t jb;
+
+void setUp(void)
+{
+    jitter_buffer_init(&jb, FRAME_TICKS, MIN_FRAMES, MAX_FRAMES);
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Replay a trace against a 20 ms playout clock started at the first arrival
+ *
+ * Every frame carries its frame number in the payload, so the order of
+ * playout can be checked.
+ */
+static void replay(const trace_entry_t *trace, size_t count, uint32_t ticks, replay_result_t *result)
+{
+    uint8_t frame[JITTER_BUFFER_FRAME_BYTES];
+    size_t next = 0;
+
+    memset(result, 0, sizeof(*result));
+    result->last_seq = -1;
+    result->in_order = true;
+
+    for (uint32_t tick = 0; tick < ticks; tick++) {
+        uint32_t now_ms = trace[0].arrival_ms + tick * FRAME_MS;
+
+        while (next < count && trace[next].arrival_ms <= now_ms) {
+            memset(frame, trace[next].seq, sizeof(frame));
+            jitter_buffer_put(&jb, TS_BASE + trace[next].seq * FRAME_TICKS, frame, sizeof(frame),
+                              trace[next].arrival_ms * 8);
+            next++;
+        }
+
+        size_t len = 0;
+        switch (jitter_buffer_get(&jb, frame, &len)) {
+        case JITTER_BUFFER_FRAME:
+            TEST_ASSERT_EQUAL(JITTER_BUFFER_FRAME_BYTES, len);
+            if (frame[0] <= result->last_seq) {
+                result->in_order = false;
+            }
+            result->last_seq = frame[0];
+            result->frames++;
+            break;
+        case JITTER_BUFFER_MISSING:
+            result->missing++;
+            break;
+        case JITTER_BUFFER_BUFFERING:
+            result->buffering++;
+            break;
+        }
+    }
+}
+
+void test_jitter_buffer_steady_stream(void)
+{
+    trace_entry_t trace[40];
+    for (int i = 0; i < 40; i++) {
+        trace[i].seq = i;
+        trace[i].arrival_ms = 500 + i * FRAME_MS + (i % 3);
+    }
+
+    replay_result_t result;
+    replay(trace, 40, 42, &result);
+
+    TEST_ASSERT_EQUAL(40, result.frames);
+    TEST_ASSERT_EQUAL(0, result.missing);
+    TEST_ASSERT_TRUE(result.in_order);
+    TEST_ASSERT_EQUAL(MIN_FRAMES * FRAME_TICKS, jb.target_delay);
+    TEST_ASSERT_EQUAL(0, jb.stats.underruns);
+    TEST_ASSERT_EQUAL(0, jb.stats.late_drops);
+    TEST_ASSERT_EQUAL(0, jitter_buffer_depth(&jb));
+}
+
+void test_jitter_buffer_reorder_duplicate_and_late(void)
+{
+    static const trace_entry_t trace[] = {
+        { 1, 100 }, { 0, 105 },                 // Overtaken before playout began
+        { 2, 140 }, { 4, 180 }, { 3, 185 },     // Reordered while playing
+        { 4, 190 },                             // Duplicate
+        { 5, 200 }, { 7, 240 }, { 8, 260 },
+        { 6, 290 },                             // After its playout time
+        { 9, 280 }, { 10, 300 }, { 11, 320 }
+    };
+
+    replay_result_t result;
+    replay(trace, sizeof(trace) / sizeof(trace[0]), 14, &result);
+
+    TEST_ASSERT_TRUE(result.in_order);
+    TEST_ASSERT_EQUAL(11, result.frames);
+    TEST_ASSERT_EQUAL(1, result.missing);
+    TEST_ASSERT_EQUAL(1, jb.stats.duplicates);
+    TEST_ASSERT_EQUAL(1, jb.stats.late_drops);
+    TEST_ASSERT_EQUAL(0, jb.stats.underruns);
+}
+
+/**
+ * @brief Entrance access point: steady 20 ms packets with a few ms of
+ *        jitter and two stalls of about 100 ms that release a burst
+ */
+static const trace_entry_t wifi_trace[] = {
+    { 0, 1000 }, { 1, 1022 }, { 2, 1041 }, { 3, 1063 }, { 4, 1080 }, { 5, 1101 },
+    { 6, 1124 }, { 7, 1140 }, { 8, 1162 }, { 9, 1181 }, { 10, 1200 }, { 11, 1222 },
+    { 12, 1241 }, { 13, 1263 }, { 14, 1280 }, { 15, 1301 }, { 16, 1324 }, { 17, 1340 },
+    { 18, 1362 }, { 19, 1381 }, { 20, 1400 }, { 21, 1422 }, { 22, 1441 }, { 23, 1463 },
+    { 24, 1480 }, { 25, 1501 }, { 26, 1524 }, { 27, 1540 }, { 28, 1562 }, { 29, 1581 },
+    { 30, 1705 }, { 31, 1705 }, { 32, 1705 }, { 33, 1705 }, { 34, 1705 }, { 35, 1705 },
+    { 36, 1724 }, { 37, 1740 }, { 38, 1762 }, { 39, 1781 }, { 40, 1800 }, { 41, 1822 },
+    { 42, 1841 }, { 43, 1863 }, { 44, 1880 }, { 45, 1901 }, { 46, 1924 }, { 47, 1940 },
+    { 48, 1962 }, { 49, 1981 }, { 50, 2000 }, { 51, 2022 }, { 52, 2041 }, { 53, 2063 },
+    { 54, 2080 }, { 55, 2101 }, { 56, 2124 }, { 57, 2140 }, { 58, 2162 }, { 59, 2181 },
+    { 60, 2200 }, { 61, 2222 }, { 62, 2241 }, { 63, 2263 }, { 64, 2280 }, { 65, 2301 },
+    { 66, 2324 }, { 67, 2340 }, { 68, 2362 }, { 69, 2381 }, { 70, 2504 }, { 71, 2504 },
+    { 72, 2504 }, { 73, 2504 }, { 74, 2504 }, { 75, 2504 }, { 76, 2524 }, { 77, 2540 },
+    { 78, 2562 }, { 79, 2581 }, { 80, 2600 }, { 81, 2622 }, { 82, 2641 }, { 83, 2663 },
+    { 84, 2680 }, { 85, 2701 }, { 86, 2724 }, { 87, 2740 }, { 88, 2762 }, { 89, 2781 },
+    { 90, 2800 }, { 91, 2822 }, { 92, 2841 }, { 93, 2863 }, { 94, 2880 }, { 95, 2901 },
+    { 96, 2924 }, { 97, 2940 }, { 98, 2962 }, { 99, 2981 }
+};
+
+void test_jitter_buffer_adapts_to_wifi_bursts(void)
+{
+    const size_t count = sizeof(wifi_trace) / sizeof(wifi_trace[0]);
+    replay_result_t result;
+
+    // Up to just before the second stall
+    replay(wifi_trace, 70, 70, &result);
+    TEST_ASSERT_EQUAL(1, jb.stats.underruns);
+    TEST_ASSERT_GREATER_OR_EQUAL(5 * FRAME_TICKS, jb.target_delay);
+
+    // The whole call: the grown delay rides out the second stall
+    setUp();
+    replay(wifi_trace, count, count + 1, &result);
+    TEST_ASSERT_TRUE(result.in_order);
+    TEST_ASSERT_EQUAL(count, result.frames + jb.stats.discarded + jitter_buffer_depth(&jb));
+    TEST_ASSERT_EQUAL(0, result.missing);
+    TEST_ASSERT_EQUAL(0, jb.stats.late_drops);
+    TEST_ASSERT_EQUAL(1, jb.stats.underruns);
+}
+
+void test_jitter_buffer_delay_decays_and_resyncs(void)
+{
+    uint8_t frame[JITTER_BUFFER_FRAME_BYTES] = { 0 };
+    size_t len;
+
+    // One packet 120 ms late raises the delay at once
+    jitter_buffer_put(&jb, 0, frame, sizeof(frame), 0);
+    jitter_buffer_put(&jb, FRAME_TICKS, frame, sizeof(frame), FRAME_TICKS + 960);
+    TEST_ASSERT_EQUAL(7 * FRAME_TICKS, jb.target_delay);
+
+    // Seconds of steady packets bring it back down to the minimum
+    for (uint32_t i = 2; i < 1000; i++) {
+        jitter_buffer_put(&jb, i * FRAME_TICKS, frame, sizeof(frame), i * FRAME_TICKS);
+        jitter_buffer_get(&jb, frame, &len);
+    }
+    TEST_ASSERT_EQUAL(MIN_FRAMES * FRAME_TICKS, jb.target_delay);
+    TEST_ASSERT_LESS_OR_EQUAL(MIN_FRAMES + 2, jitter_buffer_depth(&jb));
+
+    // A packet carrying two frames is split
+    uint8_t double_frame[2 * JITTER_BUFFER_FRAME_BYTES] = { 0 };
+    uint32_t depth = jitter_buffer_depth(&jb);
+    jitter_buffer_put(&jb, 1000 * FRAME_TICKS, double_frame, sizeof(double_frame), 1000 * FRAME_TICKS);
+    TEST_ASSERT_EQUAL(depth + 2, jitter_buffer_depth(&jb));
+
+    // A timestamp far away is a new stream, not a burst to wait for
+    jitter_buffer_put(&jb, 0x80000000u, frame, sizeof(frame), 1010 * FRAME_TICKS);
+    TEST_ASSERT_EQUAL(1, jb.stats.resyncs);
+    TEST_ASSERT_EQUAL(1, jitter_buffer_depth(&jb));
+    TEST_ASSERT_EQUAL(JITTER_BUFFER_BUFFERING, jitter_buffer_get(&jb, frame, &len));
+}
+
+void test_jitter_buffer_resumes_after_silence(void)
+{
+    uint8_t frame[JITTER_BUFFER_FRAME_BYTES];
+    size_t len;
+    uint32_t played = 0;
+    uint32_t missing = 0;
+    int32_t resumed_tick = -1;
+
+    // Two talkspurts with 600 ms of silence between, the sender sends nothing in it
+    for (uint32_t tick = 0; tick < 130; tick++) {
+        if (tick < 50 || tick >= 80) {
+            memset(frame, (uint8_t)tick, sizeof(frame));
+            jitter_buffer_put(&jb, TS_BASE + tick * FRAME_TICKS, frame, sizeof(frame),
+                              tick * FRAME_TICKS + (tick % 3) * 8);
+        } else if (tick == 50) {
+            // Comfort noise marks the pause
+            jitter_buffer_pause(&jb);
+        }
+
+        jitter_buffer_result_t result = jitter_buffer_get(&jb, frame, &len);
+        if (result == JITTER_BUFFER_FRAME) {
+            played++;
+            if (frame[0] == 80) {
+                resumed_tick = (int32_t)tick;
+            }
+        }
+        missing += result == JITTER_BUFFER_MISSING;
+    }
+
+    // The pause is neither a loss nor an underrun, and the second talkspurt
+    // starts after a fresh prebuffer, not 600 ms late
+    TEST_ASSERT_EQUAL(0, missing);
+    TEST_ASSERT_EQUAL(100, played + jitter_buffer_depth(&jb));
+    TEST_ASSERT_EQUAL(0, jb.stats.underruns);
+    TEST_ASSERT_EQUAL(0, jb.stats.resyncs);
+    TEST_ASSERT_TRUE(resumed_tick >= 80 + MIN_FRAMES - 1 && resumed_tick <= 80 + MIN_FRAMES);
+
+    // Without the pause note, running dry is an underrun
+    for (int i = 0; i < MAX_FRAMES; i++) {
+        jitter_buffer_get(&jb, frame, &len);
+    }
+    TEST_ASSERT_EQUAL(1, jb.stats.underruns);
+}
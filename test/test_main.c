@@ -18,6 +18,7 @@ extern void test_config_validation_sip_domain_invalid(void);
 extern void test_config_validation_sip_callee_valid_simple(void);
 extern void test_config_validation_sip_callee_valid_with_sip_prefix(void);
 extern void test_config_validation_sip_callee_invalid_no_at(void);
+extern void test_config_validation_sip_callee_list(void);
 extern void test_config_validation_web_port_too_low(void);
 extern void test_config_validation_web_port_too_high(void);
 extern void test_config_validation_web_port_valid_range(void);
@@ -67,12 +68,24 @@ extern void test_sip_manager_registration_failure(void);
 extern void test_sip_manager_call_failure(void);
 extern void test_sip_manager_call_statistics_tracking(void);
 extern void test_sip_manager_call_failure_statistics(void);
+extern void test_sip_manager_auth_challenges_avoided_stats(void);
+extern void test_sip_manager_forked_call_leg_stats(void);
+extern void test_sip_manager_latency_histograms(void);
+extern void test_sip_manager_tcp_transport(void);
+extern void test_sip_manager_tls_transport(void);
+extern void test_sip_manager_registration_refresh_scheduled(void);
+extern void test_sip_manager_registration_refresh_config(void);
+extern void test_sip_manager_registration_backoff(void);
+extern void test_sip_manager_call_allowed_while_binding_valid(void);
 extern void test_sip_manager_reset_call_statistics(void);
+extern void test_sip_manager_call_quality_history(void);
 extern void test_sip_manager_call_timeout_handling(void);
 extern void test_sip_manager_get_call_stats_invalid_args(void);
 extern void test_sip_manager_reset_call_stats_not_initialized(void);
 extern void test_sip_manager_dtmf_command_mapping_default(void);
 extern void test_sip_manager_dtmf_command_mapping_custom(void);
+extern void test_sip_manager_dtmf_command_sequence(void);
+extern void test_sip_manager_event_queue(void);
 extern void test_sip_manager_dtmf_processing_disabled(void);
 extern void test_sip_manager_get_dtmf_commands(void);
 extern void test_sip_manager_configure_dtmf_commands_invalid_args(void);
@@ -207,6 +220,186 @@ extern void test_performance_sip_call_setup_timing(void);
 extern void test_performance_relay_operation_timing(void);
 extern void test_performance_system_responsiveness(void);
 
+// SIP message parser test function declarations
+extern void test_sip_message_parse_response(void);
+extern void test_sip_message_spans_point_into_buffer(void);
+extern void test_sip_message_parse_request_compact_headers(void);
+extern void test_sip_message_header_params_and_uri(void);
+extern void test_sip_message_folded_header(void);
+extern void test_sip_message_rejects_malformed(void);
+extern void test_sip_message_method_names(void);
+
+// SIP transport test function declarations
+extern void test_sip_transport_open_ephemeral_port(void);
+extern void test_sip_transport_connect_learns_local_address(void);
+extern void test_sip_transport_invalid_args(void);
+extern void test_sip_transport_recv_timeout(void);
+extern void test_sip_transport_register_exchange_with_standin(void);
+extern void test_sip_transport_tcp_frames_stream(void);
+extern void test_sip_transport_tcp_keepalive_and_close(void);
+
+// SIP timer wheel test function declarations
+extern void test_sip_timer_wheel_fires_on_expiry_tick(void);
+extern void test_sip_timer_wheel_cascades_long_delays(void);
+extern void test_sip_timer_wheel_stop_and_restart(void);
+extern void test_sip_timer_wheel_callback_can_rearm(void);
+extern void test_sip_timer_wheel_zero_delay_fires_next_tick(void);
+
+// SIP transaction test function declarations
+extern void test_sip_transaction_invite_timer_a_doubles_until_timer_b(void);
+extern void test_sip_transaction_provisional_stops_invite_retransmissions(void);
+extern void test_sip_transaction_invite_failure_resends_ack_until_timer_d(void);
+extern void test_sip_transaction_non_invite_timer_e_caps_at_t2(void);
+extern void test_sip_transaction_non_invite_final_lingers_for_timer_k(void);
+extern void test_sip_transaction_response_matches_method_and_branch(void);
+extern void test_sip_transaction_server_absorbs_retransmitted_request(void);
+extern void test_sip_transaction_server_invite_failure_waits_for_ack(void);
+extern void test_sip_transaction_pool_exhaustion(void);
+
+// SIP template test function declarations
+extern void test_sip_template_render_patches_fields(void);
+extern void test_sip_template_rerender_overwrites_whole_slot(void);
+extern void test_sip_template_auth_and_body(void);
+extern void test_sip_template_rejects_values_that_do_not_fit(void);
+extern void test_sip_template_overflow_and_incomplete(void);
+
+// SIP digest test function declarations
+extern void test_sip_digest_rfc_vectors(void);
+extern void test_sip_digest_parses_challenge(void);
+extern void test_sip_digest_prefers_sha256(void);
+extern void test_sip_digest_rejects_unusable_challenge(void);
+extern void test_sip_digest_reuses_nonce_and_ha1(void);
+
+// Call latency test function declarations
+extern void test_call_latency_bucket_layout(void);
+extern void test_call_latency_percentiles(void);
+extern void test_call_latency_phases_from_button_edge(void);
+extern void test_call_latency_attempt_boundaries(void);
+
+// SIP DNS test function declarations
+extern void test_sip_dns_srv_priority_and_cache(void);
+extern void test_sip_dns_naptr_selects_transport(void);
+extern void test_sip_dns_fallbacks(void);
+extern void test_sip_dns_background_refresh(void);
+extern void test_sip_dns_weighted_order(void);
+
+// SIP TLS test function declarations
+extern void test_sip_tls_create_invalid_args(void);
+extern void test_sip_tls_create_without_ca(void);
+extern void test_sip_tls_handshake_fails_on_closed_peer(void);
+extern void test_sip_tls_transport_rejects_mismatched_connection(void);
+
+// G.711 test function declarations
+extern void test_g711_tables_match_reference(void);
+extern void test_g711_known_codes(void);
+extern void test_g711_frame_round_trip(void);
+
+// RTP packet test function declarations
+extern void test_rtp_sender_header_and_parse(void);
+extern void test_rtp_packet_parse_optional_fields(void);
+extern void test_rtp_receiver_counts_loss_across_wrap(void);
+extern void test_rtp_receiver_source_change_and_jump(void);
+
+// Jitter buffer test function declarations
+extern void test_jitter_buffer_steady_stream(void);
+extern void test_jitter_buffer_reorder_duplicate_and_late(void);
+extern void test_jitter_buffer_adapts_to_wifi_bursts(void);
+extern void test_jitter_buffer_delay_decays_and_resyncs(void);
+extern void test_jitter_buffer_resumes_after_silence(void);
+
+// RTP DTMF test function declarations
+extern void test_rtp_dtmf_reports_on_first_event_packet(void);
+extern void test_rtp_dtmf_lost_start_reported_once(void);
+extern void test_rtp_dtmf_repeated_key_and_stale_packets(void);
+extern void test_rtp_dtmf_ignores_other_events(void);
+
+// DTMF detector test function declarations
+extern void test_dtmf_detect_all_digits(void);
+extern void test_dtmf_detect_level_and_twist(void);
+extern void test_dtmf_detect_duration(void);
+extern void test_dtmf_detect_rejects_speech(void);
+
+// DTMF trie test function declarations
+extern void test_dtmf_trie_sequences(void);
+extern void test_dtmf_trie_prefix_timeout(void);
+extern void test_dtmf_trie_interdigit_timeout(void);
+extern void test_dtmf_trie_add_limits(void);
+
+// SIP event queue test function declarations
+extern void test_sip_event_queue_order(void);
+extern void test_sip_event_queue_coalesces_state(void);
+extern void test_sip_event_queue_state_follows_mailbox(void);
+extern void test_sip_event_queue_dtmf_overflow(void);
+
+// SIP arena test function declarations
+extern void test_sip_arena_bump_and_release(void);
+extern void test_sip_arena_grows_across_blocks(void);
+extern void test_sip_arena_exhaustion(void);
+extern void test_sip_arena_churn_stays_flat(void);
+
+// G.722 test function declarations
+extern void test_g722_silence_stays_quiet(void);
+extern void test_g722_lower_band_tone(void);
+extern void test_g722_upper_band_tone(void);
+extern void test_g722_codes_are_deterministic(void);
+extern void test_g722_conceal_keeps_decoder_in_step(void);
+
+// SDP test function declarations
+extern void test_sdp_codec_list(void);
+extern void test_sdp_offer_follows_preference(void);
+extern void test_sdp_answer_picks_first_offered_codec(void);
+extern void test_sdp_answer_maps_dynamic_payload_types(void);
+extern void test_sdp_answer_comfort_noise(void);
+extern void test_sdp_answer_without_usable_audio(void);
+extern void test_sdp_reinvite_answer_keeps_agreed_stream(void);
+
+// Echo Canceller test function declarations
+extern void test_echo_canceller_rejects_unknown_rate(void);
+extern void test_echo_canceller_passes_near_end_without_far_end(void);
+extern void test_echo_canceller_converges(void);
+extern void test_echo_canceller_holds_during_double_talk(void);
+
+// Noise Suppressor test function declarations
+extern void test_noise_suppressor_rejects_bad_settings(void);
+extern void test_noise_suppressor_level_zero_only_delays(void);
+extern void test_noise_suppressor_attenuates_steady_noise(void);
+extern void test_noise_suppressor_keeps_speech_over_noise(void);
+
+// AGC test function declarations
+extern void test_agc_rejects_bad_settings(void);
+extern void test_agc_brings_distant_and_close_talkers_to_target(void);
+extern void test_agc_limiter_catches_sudden_peaks(void);
+extern void test_agc_holds_gain_over_background_noise(void);
+
+// Audio Ring test function declarations
+extern void test_audio_ring_rejects_bad_frame_sizes(void);
+extern void test_audio_ring_hands_over_the_slot_in_place(void);
+extern void test_audio_ring_counts_overruns_and_underruns(void);
+extern void test_audio_ring_keeps_order_across_wraparound(void);
+
+// Packet Loss Concealment test function declarations
+extern void test_plc_rejects_bad_rate(void);
+extern void test_plc_delays_received_audio_untouched(void);
+extern void test_plc_loss_replay_beats_silence(void);
+extern void test_plc_long_loss_fades_to_silence(void);
+
+// VAD test function declarations
+extern void test_vad_rejects_bad_rate(void);
+extern void test_vad_steady_noise_is_silence(void);
+extern void test_vad_talkspurt_with_hangover(void);
+extern void test_vad_quiet_hiss_found_by_zero_crossings(void);
+
+// Comfort Noise test function declarations
+extern void test_comfort_noise_payload(void);
+extern void test_comfort_noise_plays_at_received_level(void);
+
+// RTCP test function declarations
+extern void test_rtcp_compound_report_round_trip(void);
+extern void test_rtcp_fraction_lost_per_interval(void);
+extern void test_rtcp_round_trip_from_echoed_report(void);
+extern void test_rtcp_rejects_malformed(void);
+extern void test_rtcp_mos_estimate(void);
+
 void setUp(void) {
     // Set up code for each test
 }
@@ -242,6 +435,7 @@ void app_main_tests(void) {
     RUN_TEST(test_config_validation_sip_callee_valid_simple);
     RUN_TEST(test_config_validation_sip_callee_valid_with_sip_prefix);
     RUN_TEST(test_config_validation_sip_callee_invalid_no_at);
+    RUN_TEST(test_config_validation_sip_callee_list);
     RUN_TEST(test_config_validation_web_port_too_low);
     RUN_TEST(test_config_validation_web_port_too_high);
     RUN_TEST(test_config_validation_web_port_valid_range);
@@ -291,12 +485,24 @@ void app_main_tests(void) {
     RUN_TEST(test_sip_manager_call_failure);
     RUN_TEST(test_sip_manager_call_statistics_tracking);
     RUN_TEST(test_sip_manager_call_failure_statistics);
+    RUN_TEST(test_sip_manager_auth_challenges_avoided_stats);
+    RUN_TEST(test_sip_manager_forked_call_leg_stats);
+    RUN_TEST(test_sip_manager_latency_histograms);
+    RUN_TEST(test_sip_manager_tcp_transport);
+    RUN_TEST(test_sip_manager_tls_transport);
+    RUN_TEST(test_sip_manager_registration_refresh_scheduled);
+    RUN_TEST(test_sip_manager_registration_refresh_config);
+    RUN_TEST(test_sip_manager_registration_backoff);
+    RUN_TEST(test_sip_manager_call_allowed_while_binding_valid);
     RUN_TEST(test_sip_manager_reset_call_statistics);
+    RUN_TEST(test_sip_manager_call_quality_history);
     RUN_TEST(test_sip_manager_call_timeout_handling);
     RUN_TEST(test_sip_manager_get_call_stats_invalid_args);
     RUN_TEST(test_sip_manager_reset_call_stats_not_initialized);
     RUN_TEST(test_sip_manager_dtmf_command_mapping_default);
     RUN_TEST(test_sip_manager_dtmf_command_mapping_custom);
+    RUN_TEST(test_sip_manager_dtmf_command_sequence);
+    RUN_TEST(test_sip_manager_event_queue);
     RUN_TEST(test_sip_manager_dtmf_processing_disabled);
     RUN_TEST(test_sip_manager_get_dtmf_commands);
     RUN_TEST(test_sip_manager_configure_dtmf_commands_invalid_args);
@@ -431,5 +637,185 @@ void app_main_tests(void) {
     RUN_TEST(test_performance_relay_operation_timing);
     RUN_TEST(test_performance_system_responsiveness);
     
+    // SIP message parser tests
+    RUN_TEST(test_sip_message_parse_response);
+    RUN_TEST(test_sip_message_spans_point_into_buffer);
+    RUN_TEST(test_sip_message_parse_request_compact_headers);
+    RUN_TEST(test_sip_message_header_params_and_uri);
+    RUN_TEST(test_sip_message_folded_header);
+    RUN_TEST(test_sip_message_rejects_malformed);
+    RUN_TEST(test_sip_message_method_names);
+    
+    // SIP transport tests
+    RUN_TEST(test_sip_transport_open_ephemeral_port);
+    RUN_TEST(test_sip_transport_connect_learns_local_address);
+    RUN_TEST(test_sip_transport_invalid_args);
+    RUN_TEST(test_sip_transport_recv_timeout);
+    RUN_TEST(test_sip_transport_register_exchange_with_standin);
+    RUN_TEST(test_sip_transport_tcp_frames_stream);
+    RUN_TEST(test_sip_transport_tcp_keepalive_and_close);
+    
+    // SIP timer wheel tests
+    RUN_TEST(test_sip_timer_wheel_fires_on_expiry_tick);
+    RUN_TEST(test_sip_timer_wheel_cascades_long_delays);
+    RUN_TEST(test_sip_timer_wheel_stop_and_restart);
+    RUN_TEST(test_sip_timer_wheel_callback_can_rearm);
+    RUN_TEST(test_sip_timer_wheel_zero_delay_fires_next_tick);
+    
+    // SIP transaction tests
+    RUN_TEST(test_sip_transaction_invite_timer_a_doubles_until_timer_b);
+    RUN_TEST(test_sip_transaction_provisional_stops_invite_retransmissions);
+    RUN_TEST(test_sip_transaction_invite_failure_resends_ack_until_timer_d);
+    RUN_TEST(test_sip_transaction_non_invite_timer_e_caps_at_t2);
+    RUN_TEST(test_sip_transaction_non_invite_final_lingers_for_timer_k);
+    RUN_TEST(test_sip_transaction_response_matches_method_and_branch);
+    RUN_TEST(test_sip_transaction_server_absorbs_retransmitted_request);
+    RUN_TEST(test_sip_transaction_server_invite_failure_waits_for_ack);
+    RUN_TEST(test_sip_transaction_pool_exhaustion);
+    
+    // SIP template tests
+    RUN_TEST(test_sip_template_render_patches_fields);
+    RUN_TEST(test_sip_template_rerender_overwrites_whole_slot);
+    RUN_TEST(test_sip_template_auth_and_body);
+    RUN_TEST(test_sip_template_rejects_values_that_do_not_fit);
+    RUN_TEST(test_sip_template_overflow_and_incomplete);
+    
+    // SIP digest tests
+    RUN_TEST(test_sip_digest_rfc_vectors);
+    RUN_TEST(test_sip_digest_parses_challenge);
+    RUN_TEST(test_sip_digest_prefers_sha256);
+    RUN_TEST(test_sip_digest_rejects_unusable_challenge);
+    RUN_TEST(test_sip_digest_reuses_nonce_and_ha1);
+    
+    // Call latency tests
+    RUN_TEST(test_call_latency_bucket_layout);
+    RUN_TEST(test_call_latency_percentiles);
+    RUN_TEST(test_call_latency_phases_from_button_edge);
+    RUN_TEST(test_call_latency_attempt_boundaries);
+    
+    // SIP DNS tests
+    RUN_TEST(test_sip_dns_srv_priority_and_cache);
+    RUN_TEST(test_sip_dns_naptr_selects_transport);
+    RUN_TEST(test_sip_dns_fallbacks);
+    RUN_TEST(test_sip_dns_background_refresh);
+    RUN_TEST(test_sip_dns_weighted_order);
+    
+    // SIP TLS tests
+    RUN_TEST(test_sip_tls_create_invalid_args);
+    RUN_TEST(test_sip_tls_create_without_ca);
+    RUN_TEST(test_sip_tls_handshake_fails_on_closed_peer);
+    RUN_TEST(test_sip_tls_transport_rejects_mismatched_connection);
+    
+    // G.711 tests
+    RUN_TEST(test_g711_tables_match_reference);
+    RUN_TEST(test_g711_known_codes);
+    RUN_TEST(test_g711_frame_round_trip);
+    
+    // RTP packet tests
+    RUN_TEST(test_rtp_sender_header_and_parse);
+    RUN_TEST(test_rtp_packet_parse_optional_fields);
+    RUN_TEST(test_rtp_receiver_counts_loss_across_wrap);
+    RUN_TEST(test_rtp_receiver_source_change_and_jump);
+    
+    // Jitter buffer tests
+    RUN_TEST(test_jitter_buffer_steady_stream);
+    RUN_TEST(test_jitter_buffer_reorder_duplicate_and_late);
+    RUN_TEST(test_jitter_buffer_adapts_to_wifi_bursts);
+    RUN_TEST(test_jitter_buffer_delay_decays_and_resyncs);
+    RUN_TEST(test_jitter_buffer_resumes_after_silence);
+    
+    // RTP DTMF tests
+    RUN_TEST(test_rtp_dtmf_reports_on_first_event_packet);
+    RUN_TEST(test_rtp_dtmf_lost_start_reported_once);
+    RUN_TEST(test_rtp_dtmf_repeated_key_and_stale_packets);
+    RUN_TEST(test_rtp_dtmf_ignores_other_events);
+    
+    // DTMF detector tests
+    RUN_TEST(test_dtmf_detect_all_digits);
+    RUN_TEST(test_dtmf_detect_level_and_twist);
+    RUN_TEST(test_dtmf_detect_duration);
+    RUN_TEST(test_dtmf_detect_rejects_speech);
+    
+    // DTMF trie tests
+    RUN_TEST(test_dtmf_trie_sequences);
+    RUN_TEST(test_dtmf_trie_prefix_timeout);
+    RUN_TEST(test_dtmf_trie_interdigit_timeout);
+    RUN_TEST(test_dtmf_trie_add_limits);
+    
+    // SIP event queue tests
+    RUN_TEST(test_sip_event_queue_order);
+    RUN_TEST(test_sip_event_queue_coalesces_state);
+    RUN_TEST(test_sip_event_queue_state_follows_mailbox);
+    RUN_TEST(test_sip_event_queue_dtmf_overflow);
+    
+    // SIP arena tests
+    RUN_TEST(test_sip_arena_bump_and_release);
+    RUN_TEST(test_sip_arena_grows_across_blocks);
+    RUN_TEST(test_sip_arena_exhaustion);
+    RUN_TEST(test_sip_arena_churn_stays_flat);
+    
+    // G.722 tests
+    RUN_TEST(test_g722_silence_stays_quiet);
+    RUN_TEST(test_g722_lower_band_tone);
+    RUN_TEST(test_g722_upper_band_tone);
+    RUN_TEST(test_g722_codes_are_deterministic);
+    RUN_TEST(test_g722_conceal_keeps_decoder_in_step);
+    
+    // SDP tests
+    RUN_TEST(test_sdp_codec_list);
+    RUN_TEST(test_sdp_offer_follows_preference);
+    RUN_TEST(test_sdp_answer_picks_first_offered_codec);
+    RUN_TEST(test_sdp_answer_maps_dynamic_payload_types);
+    RUN_TEST(test_sdp_answer_comfort_noise);
+    RUN_TEST(test_sdp_answer_without_usable_audio);
+    RUN_TEST(test_sdp_reinvite_answer_keeps_agreed_stream);
+    
+    // Echo Canceller tests
+    RUN_TEST(test_echo_canceller_rejects_unknown_rate);
+    RUN_TEST(test_echo_canceller_passes_near_end_without_far_end);
+    RUN_TEST(test_echo_canceller_converges);
+    RUN_TEST(test_echo_canceller_holds_during_double_talk);
+    
+    // Noise Suppressor tests
+    RUN_TEST(test_noise_suppressor_rejects_bad_settings);
+    RUN_TEST(test_noise_suppressor_level_zero_only_delays);
+    RUN_TEST(test_noise_suppressor_attenuates_steady_noise);
+    RUN_TEST(test_noise_suppressor_keeps_speech_over_noise);
+    
+    // AGC tests
+    RUN_TEST(test_agc_rejects_bad_settings);
+    RUN_TEST(test_agc_brings_distant_and_close_talkers_to_target);
+    RUN_TEST(test_agc_limiter_catches_sudden_peaks);
+    RUN_TEST(test_agc_holds_gain_over_background_noise);
+    
+    // Audio Ring tests
+    RUN_TEST(test_audio_ring_rejects_bad_frame_sizes);
+    RUN_TEST(test_audio_ring_hands_over_the_slot_in_place);
+    RUN_TEST(test_audio_ring_counts_overruns_and_underruns);
+    RUN_TEST(test_audio_ring_keeps_order_across_wraparound);
+    
+    // Packet Loss Concealment tests
+    RUN_TEST(test_plc_rejects_bad_rate);
+    RUN_TEST(test_plc_delays_received_audio_untouched);
+    RUN_TEST(test_plc_loss_replay_beats_silence);
+    RUN_TEST(test_plc_long_loss_fades_to_silence);
+    
+    // VAD tests
+    RUN_TEST(test_vad_rejects_bad_rate);
+    RUN_TEST(test_vad_steady_noise_is_silence);
+    RUN_TEST(test_vad_talkspurt_with_hangover);
+    RUN_TEST(test_vad_quiet_hiss_found_by_zero_crossings);
+    
+    // Comfort Noise tests
+    RUN_TEST(test_comfort_noise_payload);
+    RUN_TEST(test_comfort_noise_plays_at_received_level);
+    
+    // RTCP tests
+    RUN_TEST(test_rtcp_compound_report_round_trip);
+    RUN_TEST(test_rtcp_fraction_lost_per_interval);
+    RUN_TEST(test_rtcp_round_trip_from_echoed_report);
+    RUN_TEST(test_rtcp_rejects_malformed);
+    RUN_TEST(test_rtcp_mos_estimate);
+    
     UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "unity.h"
+#include "noise_suppressor.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NS_TEST_RATE        8000
+#define NS_TEST_FRAME       160
+#define NS_TEST_DELAY       (NS_TEST_RATE * NOISE_SUPPRESSOR_DELAY_MS / 1000)
+#define NS_TEST_SECONDS     3
+#define NS_TEST_SAMPLES     (NS_TEST_RATE * NS_TEST_SECONDS)
+
+static noise_suppressor_t ns;
+static int16_t speech[NS_TEST_SAMPLES];
+static int16_t noise[NS_TEST_SAMPLES];
+static int16_t in[NS_TEST_SAMPLES];
+static int16_t out[NS_TEST_SAMPLES];
+
+void setUp(void)
+{
+    srand(11);
+    memset(speech, 0, sizeof(speech));
+    memset(noise, 0, sizeof(noise));
+    TEST_ASSERT_TRUE(noise_suppressor_init(&ns, NS_TEST_RATE, NOISE_SUPPRESSOR_LEVEL_DB));
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Mix speech and noise into in and run it through frame by frame
+ */
+static void run_frames(void)
+{
+    for (int i = 0; i < NS_TEST_SAMPLES; i++) {
+        in[i] = (int16_t)(speech[i] + noise[i]);
+    }
+    for (int i = 0; i < NS_TEST_SAMPLES; i += NS_TEST_FRAME) {
+        noise_suppressor_process(&ns, in + i, out + i, NS_TEST_FRAME);
+    }
+}
+
+/**
+ * @brief Energy of a signal over the last second, in dB
+ */
+static double last_second_db(const int16_t *pcm, int delay)
+{
+    double energy = 1;
+    for (int i = NS_TEST_SAMPLES - NS_TEST_RATE; i < NS_TEST_SAMPLES; i++) {
+        energy += (double)pcm[i - delay] * pcm[i - delay];
+    }
+    return 10 * log10(energy);
+}
+
+void test_noise_suppressor_rejects_bad_settings(void)
+{
+    TEST_ASSERT_FALSE(noise_suppressor_init(&ns, 44100, NOISE_SUPPRESSOR_LEVEL_DB));
+    TEST_ASSERT_FALSE(noise_suppressor_init(&ns, NS_TEST_RATE, NOISE_SUPPRESSOR_MAX_LEVEL_DB + 1));
+    TEST_ASSERT_TRUE(noise_suppressor_init(&ns, 16000, NOISE_SUPPRESSOR_MAX_LEVEL_DB));
+    TEST_ASSERT_FALSE(noise_suppressor_set_level(&ns, NOISE_SUPPRESSOR_MAX_LEVEL_DB + 1));
+}
+
+void test_noise_suppressor_level_zero_only_delays(void)
+{
+    TEST_ASSERT_TRUE(noise_suppressor_init(&ns, NS_TEST_RATE, 0));
+    for (int i = 0; i < NS_TEST_SAMPLES; i++) {
+        speech[i] = (int16_t)(10000 * sin(2 * M_PI * 440 * i / NS_TEST_RATE));
+        noise[i] = (int16_t)(rand() % 2001 - 1000);
+    }
+    run_frames();
+
+    for (int i = 0; i < NS_TEST_DELAY; i++) {
+        TEST_ASSERT_EQUAL_INT16(0, out[i]);
+    }
+    for (int i = NS_TEST_DELAY; i < NS_TEST_SAMPLES; i++) {
+        TEST_ASSERT_INT_WITHIN(1, in[i - NS_TEST_DELAY], out[i]);
+    }
+}
+
+void test_noise_suppressor_attenuates_steady_noise(void)
+{
+    for (int i = 0; i < NS_TEST_SAMPLES; i++) {
+        noise[i] = (int16_t)(rand() % 4001 - 2000);
+    }
+    run_frames();
+
+    // Within 3 dB of the configured level once the floor is known
+    double reduction = last_second_db(in, 0) - last_second_db(out, 0);
+    TEST_ASSERT_TRUE(reduction > NOISE_SUPPRESSOR_LEVEL_DB - 3);
+    TEST_ASSERT_TRUE(reduction < NOISE_SUPPRESSOR_LEVEL_DB + 1);
+    TEST_ASSERT_TRUE(noise_suppressor_reduction_db(&ns) > NOISE_SUPPRESSOR_LEVEL_DB - 4);
+}
+
+void test_noise_suppressor_keeps_speech_over_noise(void)
+{
+    // Noise alone for the first second, then a vowel-like tone pair over it
+    for (int i = 0; i < NS_TEST_SAMPLES; i++) {
+        noise[i] = (int16_t)(rand() % 4001 - 2000);
+        if (i >= NS_TEST_RATE) {
+            speech[i] = (int16_t)(5000 * sin(2 * M_PI * 500 * i / NS_TEST_RATE) +
+                                  3000 * sin(2 * M_PI * 1500 * i / NS_TEST_RATE));
+        }
+    }
+    run_frames();
+
+    // Residual against the speech, delayed like the output
+    static int16_t residual[NS_TEST_SAMPLES];
+    for (int i = NS_TEST_DELAY; i < NS_TEST_SAMPLES; i++) {
+        residual[i] = (int16_t)(out[i] - speech[i - NS_TEST_DELAY]);
+    }
+    double snr_in = last_second_db(speech, 0) - last_second_db(noise, 0);
+    double snr_out = last_second_db(speech, NS_TEST_DELAY) - last_second_db(residual, 0);
+    TEST_ASSERT_TRUE(snr_out - snr_in > 6.0);
+
+    // The speech itself is not turned down
+    double speech_loss = last_second_db(speech, NS_TEST_DELAY) - last_second_db(out, 0);
+    TEST_ASSERT_TRUE(speech_loss < 1.0 && speech_loss > -1.0);
+}
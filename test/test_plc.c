@@ -0,0 +1,198 @@
+#include "unity.h"
+#include "plc.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PLC_TEST_RATE       8000
+#define PLC_TEST_FRAME      160     // 20 ms, one packet
+#define PLC_TEST_FRAMES     100
+#define PLC_TEST_SAMPLES    (PLC_TEST_FRAME * PLC_TEST_FRAMES)
+#define PLC_TEST_DELAY      PLC_DELAY_8K
+
+// One character per packet, X lost: single losses, pairs and a 60 ms burst
+static const char loss_pattern[PLC_TEST_FRAMES + 1] =
+    "........X.........X.......XX..........X......XXX.........X........X.........XX.......X.....X........";
+
+static plc_t plc;
+static int16_t speech[PLC_TEST_SAMPLES];
+static int16_t concealed[PLC_TEST_SAMPLES];
+static int16_t zero_filled[PLC_TEST_SAMPLES];
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(plc_init(&plc, PLC_TEST_RATE));
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Sustained voiced speech: a gliding pitch with falling harmonics
+ */
+static void make_speech(void)
+{
+    for (int i = 0; i < PLC_TEST_SAMPLES; i++) {
+        double t = (double)i / PLC_TEST_RATE;
+        double phase = 2 * M_PI * (130 * t - 20 / (2 * M_PI * 0.7) * cos(2 * M_PI * 0.7 * t));
+        double voice = sin(phase) + 0.6 * sin(2 * phase) + 0.3 * sin(3 * phase) + 0.15 * sin(4 * phase);
+        speech[i] = (int16_t)(6000 * (0.8 + 0.2 * sin(2 * M_PI * 2 * t)) * voice);
+    }
+}
+
+/**
+ * @brief Replay the loss pattern; lost packets concealed or left silent
+ */
+static void replay(bool conceal, int16_t *out)
+{
+    for (int f = 0; f < PLC_TEST_FRAMES; f++) {
+        int16_t *pcm = out + f * PLC_TEST_FRAME;
+        if (loss_pattern[f] == 'X') {
+            if (conceal) {
+                plc_conceal_frame(&plc, pcm, PLC_TEST_FRAME);
+            } else {
+                memset(pcm, 0, PLC_TEST_FRAME * sizeof(int16_t));
+                plc_add_frame(&plc, pcm, PLC_TEST_FRAME);
+            }
+        } else {
+            memcpy(pcm, speech + f * PLC_TEST_FRAME, PLC_TEST_FRAME * sizeof(int16_t));
+            plc_add_frame(&plc, pcm, PLC_TEST_FRAME);
+        }
+    }
+}
+
+/**
+ * @brief Log-spectral distance in dB between a lost frame and the original, over 0-4 kHz
+ */
+static double spectral_distance(const int16_t *out, int frame)
+{
+    const int16_t *ref = speech + frame * PLC_TEST_FRAME;
+    const int16_t *test = out + frame * PLC_TEST_FRAME + PLC_TEST_DELAY;
+    double sum = 0;
+    int bins = 0;
+
+    for (int k = 2; k < PLC_TEST_FRAME / 2; k += 2) {
+        double re[2] = { 0, 0 };
+        double im[2] = { 0, 0 };
+        for (int n = 0; n < PLC_TEST_FRAME; n++) {
+            double window = 0.5 - 0.5 * cos(2 * M_PI * n / PLC_TEST_FRAME);
+            double angle = 2 * M_PI * k * n / PLC_TEST_FRAME;
+            re[0] += window * ref[n] * cos(angle);
+            im[0] -= window * ref[n] * sin(angle);
+            re[1] += window * test[n] * cos(angle);
+            im[1] -= window * test[n] * sin(angle);
+        }
+        // Floor at -60 dB below full scale per bin, so silence scores as a bounded miss
+        double floor = 1e-6 * 32768.0 * 32768.0 * PLC_TEST_FRAME;
+        double ref_db = 10 * log10(re[0] * re[0] + im[0] * im[0] + floor);
+        double test_db = 10 * log10(re[1] * re[1] + im[1] * im[1] + floor);
+        sum += (ref_db - test_db) * (ref_db - test_db);
+        bins++;
+    }
+    return sqrt(sum / bins);
+}
+
+/**
+ * @brief Largest step between samples around the start and end of each loss
+ */
+static int largest_step_at_edges(const int16_t *out)
+{
+    int largest = 0;
+    for (int f = 1; f < PLC_TEST_FRAMES; f++) {
+        if ((loss_pattern[f] == 'X') == (loss_pattern[f - 1] == 'X')) {
+            continue;
+        }
+        int edge = f * PLC_TEST_FRAME + PLC_TEST_DELAY;
+        for (int i = edge - 20; i < edge + 20 && i < PLC_TEST_SAMPLES; i++) {
+            int step = abs(out[i] - out[i - 1]);
+            largest = step > largest ? step : largest;
+        }
+    }
+    return largest;
+}
+
+void test_plc_rejects_bad_rate(void)
+{
+    TEST_ASSERT_FALSE(plc_init(&plc, 11025));
+    TEST_ASSERT_FALSE(plc_init(&plc, 48000));
+    TEST_ASSERT_TRUE(plc_init(&plc, 16000));
+    TEST_ASSERT_EQUAL(2 * PLC_DELAY_8K, plc.overlap_max);
+}
+
+void test_plc_delays_received_audio_untouched(void)
+{
+    make_speech();
+    memcpy(concealed, speech, sizeof(speech));
+    plc_add_frame(&plc, concealed, PLC_TEST_SAMPLES);
+
+    for (int i = 0; i < PLC_TEST_DELAY; i++) {
+        TEST_ASSERT_EQUAL(0, concealed[i]);
+    }
+    TEST_ASSERT_EQUAL_MEMORY(speech, concealed + PLC_TEST_DELAY,
+                             (PLC_TEST_SAMPLES - PLC_TEST_DELAY) * sizeof(int16_t));
+    TEST_ASSERT_EQUAL(0, plc.concealed);
+}
+
+void test_plc_loss_replay_beats_silence(void)
+{
+    make_speech();
+    replay(true, concealed);
+    uint32_t concealed_subframes = plc.concealed;
+    TEST_ASSERT_TRUE(plc_init(&plc, PLC_TEST_RATE));
+    replay(false, zero_filled);
+
+    double plc_distance = 0;
+    double silence_distance = 0;
+    int lost = 0;
+    for (int f = 0; f < PLC_TEST_FRAMES - 1; f++) {
+        if (loss_pattern[f] == 'X') {
+            plc_distance += spectral_distance(concealed, f);
+            silence_distance += spectral_distance(zero_filled, f);
+            lost++;
+        }
+    }
+    plc_distance /= lost;
+    silence_distance /= lost;
+    TEST_ASSERT_EQUAL(2 * lost, concealed_subframes);
+    // Concealment keeps the spectrum of the talker, silence misses all of it
+    TEST_ASSERT_TRUE(plc_distance < 4);
+    TEST_ASSERT_TRUE(silence_distance > 3 * plc_distance);
+
+    // No clicks: the edges of each loss are no steeper than the speech itself
+    int speech_step = 0;
+    for (int i = 1; i < PLC_TEST_SAMPLES; i++) {
+        int step = abs(speech[i] - speech[i - 1]);
+        speech_step = step > speech_step ? step : speech_step;
+    }
+    TEST_ASSERT_TRUE(largest_step_at_edges(concealed) <= speech_step * 5 / 4);
+    TEST_ASSERT_TRUE(largest_step_at_edges(zero_filled) > 2 * speech_step);
+}
+
+void test_plc_long_loss_fades_to_silence(void)
+{
+    make_speech();
+    memcpy(concealed, speech, 10 * PLC_TEST_FRAME * sizeof(int16_t));
+    plc_add_frame(&plc, concealed, 10 * PLC_TEST_FRAME);
+
+    // 100 ms lost: full level first, fading from 10 ms on, silent from 60 ms
+    int16_t *lost = concealed + 10 * PLC_TEST_FRAME;
+    plc_conceal_frame(&plc, lost, 5 * PLC_TEST_FRAME);
+    int first_peak = 0;
+    for (int i = PLC_TEST_DELAY; i < PLC_TEST_FRAME / 2; i++) {
+        first_peak = abs(lost[i]) > first_peak ? abs(lost[i]) : first_peak;
+    }
+    TEST_ASSERT_TRUE(first_peak > 4000);
+    for (int i = PLC_TEST_DELAY + 3 * PLC_TEST_FRAME; i < 5 * PLC_TEST_FRAME; i++) {
+        TEST_ASSERT_EQUAL(0, lost[i]);
+    }
+
+    // Speech comes back faded in, not with a jump
+    int16_t *back = concealed + 15 * PLC_TEST_FRAME;
+    memcpy(back, speech + 15 * PLC_TEST_FRAME, PLC_TEST_FRAME * sizeof(int16_t));
+    plc_add_frame(&plc, back, PLC_TEST_FRAME);
+    TEST_ASSERT_TRUE(abs(back[PLC_TEST_DELAY]) < 1000);
+    TEST_ASSERT_EQUAL_MEMORY(speech + 15 * PLC_TEST_FRAME + PLC_TEST_FRAME / 2,
+                             back + PLC_TEST_FRAME / 2 + PLC_TEST_DELAY,
+                             (PLC_TEST_FRAME / 2 - PLC_TEST_DELAY) * sizeof(int16_t));
+}
@@ -0,0 +1,240 @@
+#include "unity.h"
+#include "rtcp.h"
+#include <string.h>
+
+#define LOCAL_SSRC      0x11223344
+#define REMOTE_SSRC     0xa1b2c3d4
+
+static rtp_sender_t sender;
+static rtp_receiver_t receiver;
+static rtcp_session_t session;
+static uint8_t packet_buf[RTCP_MAX_PACKET_SIZE];
+
+void setUp(void)
+{
+    rtp_sender_init(&sender, LOCAL_SSRC, 100, 8000);
+    rtp_receiver_init(&receiver);
+    rtcp_session_init(&session);
+    memset(packet_buf, 0, sizeof(packet_buf));
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Feed the receiver packets first to last of the remote source, skipping those in lost
+ */
+static void receive_range(uint16_t first, uint16_t last, const uint16_t *lost, size_t lost_count)
+{
+    for (uint16_t seq = first; seq != (uint16_t)(last + 1); seq++) {
+        bool skip = false;
+        for (size_t i = 0; i < lost_count; i++) {
+            skip |= lost[i] == seq;
+        }
+        if (!skip) {
+            rtp_packet_t packet = { .seq = seq, .timestamp = seq * 160u, .ssrc = REMOTE_SSRC };
+            rtp_receiver_update(&receiver, &packet, seq * 160u);
+        }
+    }
+}
+
+void test_rtcp_compound_report_round_trip(void)
+{
+    for (int i = 0; i < 50; i++) {
+        rtp_sender_finish(&sender, packet_buf, 0, false, 160, 160);
+    }
+    static const uint16_t lost[] = { 5, 6 };
+    receive_range(0, 99, lost, 2);
+
+    rtcp_report_block_t block;
+    rtcp_session_report_block(&session, &receiver, 0, &block);
+    rtcp_voip_metrics_t metrics = {
+        .ssrc = REMOTE_SSRC, .loss_rate = 5, .discard_rate = 2, .round_trip_ms = 120, .end_system_ms = 60,
+        .noise_level_dbm = -62, .r_factor = 88, .mos_lq = 42, .mos_cq = 41, .jb_nominal_ms = 40, .jb_max_ms = 200
+    };
+    rtcp_report_t report = {
+        .sender = &sender,
+        .ntp = 0x0000123456789abcull,
+        .report = &block,
+        .cname = "2f4c1e0b9a7d3c58e6a1b2c3",
+        .metrics = &metrics,
+        .bye = true
+    };
+    size_t len = rtcp_write(packet_buf, sizeof(packet_buf), &report);
+    TEST_ASSERT_TRUE(len > 0 && len <= RTCP_MAX_PACKET_SIZE);
+    TEST_ASSERT_EQUAL(0, len % 4);
+    // SR with one report block comes first
+    TEST_ASSERT_EQUAL_HEX8(0x81, packet_buf[0]);
+    TEST_ASSERT_EQUAL(RTCP_PT_SR, packet_buf[1]);
+
+    // The far end finds its block, our sender information, the metrics and the BYE
+    rtcp_packet_t parsed;
+    TEST_ASSERT_TRUE(rtcp_parse(packet_buf, len, REMOTE_SSRC, &parsed));
+    TEST_ASSERT_EQUAL_HEX32(LOCAL_SSRC, parsed.ssrc);
+    TEST_ASSERT_TRUE(parsed.has_sr);
+    TEST_ASSERT_EQUAL_HEX32(0x12345678, parsed.sr_ntp);
+    TEST_ASSERT_EQUAL(50, parsed.sender_packets);
+    TEST_ASSERT_EQUAL(50 * 160, parsed.sender_octets);
+    TEST_ASSERT_TRUE(parsed.has_report);
+    TEST_ASSERT_EQUAL(2 * 256 / 100, parsed.report.fraction_lost);
+    TEST_ASSERT_EQUAL(2, parsed.report.cumulative_lost);
+    TEST_ASSERT_EQUAL(99, parsed.report.extended_max_seq);
+    TEST_ASSERT_TRUE(parsed.has_metrics);
+    TEST_ASSERT_EQUAL(120, parsed.metrics.round_trip_ms);
+    TEST_ASSERT_EQUAL(-62, parsed.metrics.noise_level_dbm);
+    TEST_ASSERT_EQUAL(41, parsed.metrics.mos_cq);
+    TEST_ASSERT_EQUAL(200, parsed.metrics.jb_max_ms);
+    TEST_ASSERT_TRUE(parsed.bye);
+
+    // Blocks about another source are not ours
+    TEST_ASSERT_TRUE(rtcp_parse(packet_buf, len, LOCAL_SSRC, &parsed));
+    TEST_ASSERT_FALSE(parsed.has_report);
+    TEST_ASSERT_FALSE(parsed.has_metrics);
+
+    // Before sending anything we report as a receiver only, before hearing anything without a block
+    rtp_sender_init(&sender, LOCAL_SSRC, 100, 8000);
+    rtcp_report_t empty = { .sender = &sender, .cname = "x" };
+    len = rtcp_write(packet_buf, sizeof(packet_buf), &empty);
+    TEST_ASSERT_EQUAL(8 + 12, len);
+    TEST_ASSERT_EQUAL_HEX8(0x80, packet_buf[0]);
+    TEST_ASSERT_EQUAL(RTCP_PT_RR, packet_buf[1]);
+    TEST_ASSERT_EQUAL(RTCP_PT_SDES, packet_buf[9]);
+    TEST_ASSERT_EQUAL(0, rtcp_write(packet_buf, RTCP_MAX_PACKET_SIZE - 1, &empty));
+}
+
+void test_rtcp_fraction_lost_per_interval(void)
+{
+    rtcp_report_block_t block;
+
+    // A quarter of the first interval is lost
+    static const uint16_t first_lost[] = { 1, 2, 3, 4, 5 };
+    receive_range(0, 19, first_lost, 5);
+    rtcp_session_report_block(&session, &receiver, 0, &block);
+    TEST_ASSERT_EQUAL(64, block.fraction_lost);
+    TEST_ASSERT_EQUAL(5, block.cumulative_lost);
+
+    // None of the next, while the total stays
+    receive_range(20, 59, NULL, 0);
+    rtcp_session_report_block(&session, &receiver, 0, &block);
+    TEST_ASSERT_EQUAL(0, block.fraction_lost);
+    TEST_ASSERT_EQUAL(5, block.cumulative_lost);
+
+    // A gap of 20 with a single packet after it
+    rtp_packet_t packet = { .seq = 80, .timestamp = 80 * 160, .ssrc = REMOTE_SSRC };
+    rtp_receiver_update(&receiver, &packet, 80 * 160);
+    rtcp_session_report_block(&session, &receiver, 0, &block);
+    TEST_ASSERT_EQUAL(243, block.fraction_lost);    // 20 of 21
+
+    // A new source starts a new count
+    packet.ssrc = REMOTE_SSRC + 1;
+    for (uint16_t seq = 1000; seq < 1010; seq++) {
+        packet.seq = seq;
+        rtp_receiver_update(&receiver, &packet, seq * 160u);
+    }
+    rtcp_session_report_block(&session, &receiver, 0, &block);
+    TEST_ASSERT_EQUAL_HEX32(REMOTE_SSRC + 1, block.ssrc);
+    TEST_ASSERT_EQUAL(0, block.fraction_lost);
+    TEST_ASSERT_EQUAL(0, block.cumulative_lost);
+}
+
+void test_rtcp_round_trip_from_echoed_report(void)
+{
+    rtcp_session_t far_end;
+    rtcp_session_init(&far_end);
+    rtp_sender_finish(&sender, packet_buf, 0, false, 160, 160);
+    receive_range(0, 9, NULL, 0);
+    TEST_ASSERT_EQUAL(0, rtcp_session_rtt_ms(&session));
+
+    // Our SR leaves at 10 s; the far end holds it 1.5 s and its report arrives after 80 ms more in transit
+    uint64_t sent = rtcp_ntp_from_us(10000000);
+    rtcp_report_t report = { .sender = &sender, .ntp = sent, .cname = "door" };
+    size_t len = rtcp_write(packet_buf, sizeof(packet_buf), &report);
+    rtcp_packet_t parsed;
+    TEST_ASSERT_TRUE(rtcp_parse(packet_buf, len, REMOTE_SSRC, &parsed));
+    // The far end's clock is unrelated to ours
+    uint64_t far_arrival = rtcp_ntp_from_us(777000000);
+    rtcp_session_receive(&far_end, &parsed, rtcp_ntp_middle(far_arrival));
+
+    rtp_receiver_t far_receiver;
+    rtp_receiver_init(&far_receiver);
+    rtp_packet_t packet = { .seq = 100, .timestamp = 8000, .ssrc = LOCAL_SSRC };
+    rtp_receiver_update(&far_receiver, &packet, 8000);
+    rtp_sender_t far_sender;
+    rtp_sender_init(&far_sender, REMOTE_SSRC, 0, 0);
+    rtcp_report_block_t block;
+    rtcp_session_report_block(&far_end, &far_receiver, rtcp_ntp_middle(rtcp_ntp_from_us(778500000)), &block);
+    TEST_ASSERT_EQUAL_HEX32(rtcp_ntp_middle(sent), block.lsr);
+    TEST_ASSERT_EQUAL(3 * 65536 / 2, block.dlsr);
+    rtcp_report_t answer = { .sender = &far_sender, .report = &block, .cname = "pbx" };
+    len = rtcp_write(packet_buf, sizeof(packet_buf), &answer);
+
+    TEST_ASSERT_TRUE(rtcp_parse(packet_buf, len, LOCAL_SSRC, &parsed));
+    TEST_ASSERT_FALSE(parsed.has_sr);
+    TEST_ASSERT_TRUE(parsed.has_report);
+    rtcp_session_receive(&session, &parsed, rtcp_ntp_middle(rtcp_ntp_from_us(11580000)));
+    TEST_ASSERT_TRUE(session.rtt_valid);
+    TEST_ASSERT_INT_WITHIN(1, 80, rtcp_session_rtt_ms(&session));
+
+    // A report that echoes no SR leaves the round trip alone
+    parsed.report.lsr = 0;
+    rtcp_session_receive(&session, &parsed, rtcp_ntp_middle(rtcp_ntp_from_us(20000000)));
+    TEST_ASSERT_INT_WITHIN(1, 80, rtcp_session_rtt_ms(&session));
+}
+
+void test_rtcp_rejects_malformed(void)
+{
+    rtcp_packet_t parsed;
+    rtcp_report_block_t block = { .ssrc = REMOTE_SSRC };
+    rtp_sender_finish(&sender, packet_buf, 0, false, 160, 160);
+    rtcp_report_t report = { .sender = &sender, .report = &block, .cname = "door" };
+    size_t len = rtcp_write(packet_buf, sizeof(packet_buf), &report);
+    TEST_ASSERT_TRUE(rtcp_parse(packet_buf, len, REMOTE_SSRC, &parsed));
+
+    // Cut short, in the middle of the SDES and of the SR
+    TEST_ASSERT_FALSE(rtcp_parse(packet_buf, len - 4, REMOTE_SSRC, &parsed));
+    TEST_ASSERT_FALSE(rtcp_parse(packet_buf, 40, REMOTE_SSRC, &parsed));
+    TEST_ASSERT_FALSE(rtcp_parse(packet_buf, 2, REMOTE_SSRC, &parsed));
+    TEST_ASSERT_FALSE(rtcp_parse(NULL, len, REMOTE_SSRC, &parsed));
+
+    // An SR claiming more report blocks than it holds
+    packet_buf[0] = 0x82;
+    TEST_ASSERT_FALSE(rtcp_parse(packet_buf, len, REMOTE_SSRC, &parsed));
+    packet_buf[0] = 0x81;
+
+    // Not version 2, e.g. an RTP packet of another version
+    packet_buf[0] = 0x41;
+    TEST_ASSERT_FALSE(rtcp_parse(packet_buf, len, REMOTE_SSRC, &parsed));
+
+    // Unknown packet types such as APP are skipped
+    static const uint8_t app[] = {
+        0x80, 204, 0x00, 0x02, 0xa1, 0xb2, 0xc3, 0xd4, 'T', 'E', 'S', 'T',
+        0x80, RTCP_PT_BYE, 0x00, 0x01, 0xa1, 0xb2, 0xc3, 0xd4
+    };
+    TEST_ASSERT_TRUE(rtcp_parse(app, sizeof(app), LOCAL_SSRC, &parsed));
+    TEST_ASSERT_FALSE(parsed.has_sr);
+    TEST_ASSERT_TRUE(parsed.bye);
+}
+
+void test_rtcp_mos_estimate(void)
+{
+    // A clean G.711 call
+    TEST_ASSERT_EQUAL(93, rtcp_r_factor(0, 0));
+    TEST_ASSERT_EQUAL(44, rtcp_mos(rtcp_r_factor(0, 0)));
+
+    // Loss costs more than delay until the delay gets long
+    TEST_ASSERT_EQUAL(90, rtcp_r_factor(10, 0));
+    TEST_ASSERT_EQUAL(77, rtcp_r_factor(50, 0));
+    TEST_ASSERT_EQUAL(91, rtcp_r_factor(0, 100));
+    TEST_ASSERT_EQUAL(73, rtcp_r_factor(0, 300));
+    TEST_ASSERT_EQUAL(0, rtcp_r_factor(1000, 1000));
+
+    TEST_ASSERT_EQUAL(10, rtcp_mos(0));
+    TEST_ASSERT_EQUAL(39, rtcp_mos(77));
+    TEST_ASSERT_EQUAL(45, rtcp_mos(100));
+    uint8_t previous = 0;
+    for (int r = 0; r <= 100; r++) {
+        TEST_ASSERT_TRUE(rtcp_mos((uint8_t)r) >= previous);
+        previous = rtcp_mos((uint8_t)r);
+    }
+}
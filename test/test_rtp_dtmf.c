@@ -0,0 +1,162 @@
+#include "unity.h"
+#include "rtp_dtmf.h"
+#include <string.h>
+
+#define DTMF_PT         101
+#define PACKET_TIME_MS  20
+
+/**
+ * @brief One datagram of a capture, with its arrival time
+ */
+typedef struct {
+    uint16_t arrival_ms;
+    uint8_t data[16];
+} captured_packet_t;
+
+/**
+ * @brief Softphone pressing 1 and then #, PCMA audio in between
+ *
+ * Each event starts with the marker bit, repeats its timestamp with a
+ * growing duration and ends with three packets carrying the end bit.
+ */
+static const captured_packet_t capture[] = {
+    // Audio
+    {   0, { 0x80, 0x88, 0x1f, 0x40, 0x00, 0xa0, 0xb0, 0x00, 0x3b, 0x2f, 0x1a, 0x09, 0xd5, 0xd5, 0xd5, 0xd5 } },
+    {  20, { 0x80, 0x08, 0x1f, 0x41, 0x00, 0xa0, 0xb0, 0xa0, 0x3b, 0x2f, 0x1a, 0x09, 0xd5, 0xd5, 0xd5, 0xd5 } },
+    // Key 1 pressed
+    {  40, { 0x80, 0xe5, 0x1f, 0x42, 0x00, 0xa0, 0xb1, 0x40, 0x3b, 0x2f, 0x1a, 0x09, 0x01, 0x0a, 0x00, 0xa0 } },
+    {  60, { 0x80, 0x65, 0x1f, 0x43, 0x00, 0xa0, 0xb1, 0x40, 0x3b, 0x2f, 0x1a, 0x09, 0x01, 0x0a, 0x01, 0x40 } },
+    {  80, { 0x80, 0x65, 0x1f, 0x44, 0x00, 0xa0, 0xb1, 0x40, 0x3b, 0x2f, 0x1a, 0x09, 0x01, 0x0a, 0x01, 0xe0 } },
+    { 100, { 0x80, 0x65, 0x1f, 0x45, 0x00, 0xa0, 0xb1, 0x40, 0x3b, 0x2f, 0x1a, 0x09, 0x01, 0x0a, 0x02, 0x80 } },
+    { 120, { 0x80, 0x65, 0x1f, 0x46, 0x00, 0xa0, 0xb1, 0x40, 0x3b, 0x2f, 0x1a, 0x09, 0x01, 0x0a, 0x03, 0x20 } },
+    // End, sent three times
+    { 140, { 0x80, 0x65, 0x1f, 0x47, 0x00, 0xa0, 0xb1, 0x40, 0x3b, 0x2f, 0x1a, 0x09, 0x01, 0x8a, 0x03, 0x20 } },
+    { 140, { 0x80, 0x65, 0x1f, 0x48, 0x00, 0xa0, 0xb1, 0x40, 0x3b, 0x2f, 0x1a, 0x09, 0x01, 0x8a, 0x03, 0x20 } },
+    { 140, { 0x80, 0x65, 0x1f, 0x49, 0x00, 0xa0, 0xb1, 0x40, 0x3b, 0x2f, 0x1a, 0x09, 0x01, 0x8a, 0x03, 0x20 } },
+    // Audio
+    { 160, { 0x80, 0x08, 0x1f, 0x4a, 0x00, 0xa0, 0xb5, 0x00, 0x3b, 0x2f, 0x1a, 0x09, 0xd5, 0xd5, 0xd5, 0xd5 } },
+    // Key # pressed
+    { 180, { 0x80, 0xe5, 0x1f, 0x4b, 0x00, 0xa0, 0xb5, 0xa0, 0x3b, 0x2f, 0x1a, 0x09, 0x0b, 0x0a, 0x00, 0xa0 } },
+    { 200, { 0x80, 0x65, 0x1f, 0x4c, 0x00, 0xa0, 0xb5, 0xa0, 0x3b, 0x2f, 0x1a, 0x09, 0x0b, 0x0a, 0x01, 0x40 } },
+    { 220, { 0x80, 0x65, 0x1f, 0x4d, 0x00, 0xa0, 0xb5, 0xa0, 0x3b, 0x2f, 0x1a, 0x09, 0x0b, 0x0a, 0x01, 0xe0 } },
+    // End
+    { 240, { 0x80, 0x65, 0x1f, 0x4e, 0x00, 0xa0, 0xb5, 0xa0, 0x3b, 0x2f, 0x1a, 0x09, 0x0b, 0x8a, 0x01, 0xe0 } },
+    { 240, { 0x80, 0x65, 0x1f, 0x4f, 0x00, 0xa0, 0xb5, 0xa0, 0x3b, 0x2f, 0x1a, 0x09, 0x0b, 0x8a, 0x01, 0xe0 } },
+    { 240, { 0x80, 0x65, 0x1f, 0x50, 0x00, 0xa0, 0xb5, 0xa0, 0x3b, 0x2f, 0x1a, 0x09, 0x0b, 0x8a, 0x01, 0xe0 } },
+};
+
+#define CAPTURE_LEN (sizeof(capture) / sizeof(capture[0]))
+
+static rtp_dtmf_receiver_t receiver;
+static char digits[8];
+static uint16_t digit_ms[8];
+static size_t digit_count;
+
+void setUp(void)
+{
+    rtp_dtmf_init(&receiver);
+    memset(digits, 0, sizeof(digits));
+    digit_count = 0;
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Feed packets of the capture selected by mask, noting when digits come out
+ */
+static void replay(uint32_t skip_mask)
+{
+    for (size_t i = 0; i < CAPTURE_LEN; i++) {
+        if (skip_mask & (1u << i)) {
+            continue;
+        }
+        rtp_packet_t packet;
+        TEST_ASSERT_TRUE(rtp_packet_parse(capture[i].data, sizeof(capture[i].data), &packet));
+        if (packet.payload_type != DTMF_PT) {
+            continue;
+        }
+        char digit = rtp_dtmf_receive(&receiver, &packet);
+        if (digit != '\0' && digit_count < sizeof(digits)) {
+            digits[digit_count] = digit;
+            digit_ms[digit_count] = capture[i].arrival_ms;
+            digit_count++;
+        }
+    }
+}
+
+void test_rtp_dtmf_reports_on_first_event_packet(void)
+{
+    replay(0);
+
+    TEST_ASSERT_EQUAL(2, digit_count);
+    TEST_ASSERT_EQUAL_CHAR('1', digits[0]);
+    TEST_ASSERT_EQUAL_CHAR('#', digits[1]);
+
+    // Reported as the key goes down, not when it is released
+    TEST_ASSERT_EQUAL(40, digit_ms[0]);
+    TEST_ASSERT_EQUAL(180, digit_ms[1]);
+    TEST_ASSERT_LESS_THAN(PACKET_TIME_MS, digit_ms[0] - capture[2].arrival_ms);
+
+    TEST_ASSERT_EQUAL(2, receiver.events);
+    TEST_ASSERT_EQUAL(12, receiver.duplicates);
+}
+
+void test_rtp_dtmf_lost_start_reported_once(void)
+{
+    // The key-down packets of 1 and every updated packet of # are lost
+    replay((1u << 2) | (1u << 3) | (1u << 4) | (1u << 5) | (1u << 6) | (1u << 11));
+
+    TEST_ASSERT_EQUAL(2, digit_count);
+    TEST_ASSERT_EQUAL_CHAR('1', digits[0]);
+    TEST_ASSERT_EQUAL(140, digit_ms[0]);
+    TEST_ASSERT_EQUAL_CHAR('#', digits[1]);
+    TEST_ASSERT_EQUAL(200, digit_ms[1]);
+}
+
+void test_rtp_dtmf_repeated_key_and_stale_packets(void)
+{
+    rtp_packet_t packet;
+
+    // The end of 1 arriving after # has started belongs to the old event
+    TEST_ASSERT_TRUE(rtp_packet_parse(capture[2].data, sizeof(capture[2].data), &packet));
+    TEST_ASSERT_EQUAL_CHAR('1', rtp_dtmf_receive(&receiver, &packet));
+    TEST_ASSERT_TRUE(rtp_packet_parse(capture[11].data, sizeof(capture[11].data), &packet));
+    TEST_ASSERT_EQUAL_CHAR('#', rtp_dtmf_receive(&receiver, &packet));
+    TEST_ASSERT_TRUE(rtp_packet_parse(capture[7].data, sizeof(capture[7].data), &packet));
+    TEST_ASSERT_EQUAL_CHAR('\0', rtp_dtmf_receive(&receiver, &packet));
+
+    // Pressing # again is a new event with a new timestamp
+    uint8_t again[16];
+    memcpy(again, capture[11].data, sizeof(again));
+    again[7] += 0x40;
+    TEST_ASSERT_TRUE(rtp_packet_parse(again, sizeof(again), &packet));
+    TEST_ASSERT_EQUAL_CHAR('#', rtp_dtmf_receive(&receiver, &packet));
+
+    // A new source restarts the deduplication
+    again[11] ^= 0xff;
+    TEST_ASSERT_TRUE(rtp_packet_parse(again, sizeof(again), &packet));
+    TEST_ASSERT_EQUAL_CHAR('#', rtp_dtmf_receive(&receiver, &packet));
+    TEST_ASSERT_EQUAL(4, receiver.events);
+}
+
+void test_rtp_dtmf_ignores_other_events(void)
+{
+    rtp_packet_t packet;
+    uint8_t data[16];
+
+    // Flash (event 16) is not a digit
+    memcpy(data, capture[2].data, sizeof(data));
+    data[12] = 16;
+    TEST_ASSERT_TRUE(rtp_packet_parse(data, sizeof(data), &packet));
+    TEST_ASSERT_EQUAL_CHAR('\0', rtp_dtmf_receive(&receiver, &packet));
+
+    // Truncated report
+    TEST_ASSERT_TRUE(rtp_packet_parse(capture[2].data, RTP_HEADER_SIZE + 3, &packet));
+    TEST_ASSERT_EQUAL_CHAR('\0', rtp_dtmf_receive(&receiver, &packet));
+
+    TEST_ASSERT_EQUAL_CHAR('D', rtp_dtmf_event_digit(15));
+    TEST_ASSERT_EQUAL_CHAR('*', rtp_dtmf_event_digit(10));
+    TEST_ASSERT_EQUAL(0, receiver.events);
+}
@@ -0,0 +1,149 @@
+#include "unity.h"
+#include "rtp_packet.h"
+#include <string.h>
+
+static rtp_sender_t sender;
+static rtp_receiver_t receiver;
+static uint8_t packet_buf[RTP_HEADER_SIZE + 160];
+
+void setUp(void)
+{
+    rtp_sender_init(&sender, 0x11223344, 65534, 1000);
+    rtp_receiver_init(&receiver);
+    memset(packet_buf, 0, sizeof(packet_buf));
+}
+
+void tearDown(void)
+{
+}
+
+static rtp_packet_t packet_with_seq(uint32_t ssrc, uint16_t seq, uint32_t timestamp)
+{
+    rtp_packet_t packet = {
+        .payload_type = RTP_PT_PCMU,
+        .seq = seq,
+        .timestamp = timestamp,
+        .ssrc = ssrc
+    };
+    return packet;
+}
+
+void test_rtp_sender_header_and_parse(void)
+{
+    memset(packet_buf + RTP_HEADER_SIZE, 0x55, 160);
+    size_t len = rtp_sender_finish(&sender, packet_buf, RTP_PT_PCMA, true, 160, 160);
+    TEST_ASSERT_EQUAL(RTP_HEADER_SIZE + 160, len);
+
+    static const uint8_t header[RTP_HEADER_SIZE] = {
+        0x80, 0x88, 0xff, 0xfe, 0x00, 0x00, 0x03, 0xe8, 0x11, 0x22, 0x33, 0x44
+    };
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(header, packet_buf, RTP_HEADER_SIZE);
+
+    rtp_packet_t packet;
+    TEST_ASSERT_TRUE(rtp_packet_parse(packet_buf, len, &packet));
+    TEST_ASSERT_TRUE(packet.marker);
+    TEST_ASSERT_EQUAL(RTP_PT_PCMA, packet.payload_type);
+    TEST_ASSERT_EQUAL(65534, packet.seq);
+    TEST_ASSERT_EQUAL(1000, packet.timestamp);
+    TEST_ASSERT_EQUAL_HEX32(0x11223344, packet.ssrc);
+    TEST_ASSERT_EQUAL_PTR(packet_buf + RTP_HEADER_SIZE, packet.payload);
+    TEST_ASSERT_EQUAL(160, packet.payload_len);
+
+    // Sequence number wraps, timestamp advances by the frame
+    rtp_sender_finish(&sender, packet_buf, RTP_PT_PCMA, false, 160, 160);
+    len = rtp_sender_finish(&sender, packet_buf, RTP_PT_PCMA, false, 160, 160);
+    TEST_ASSERT_TRUE(rtp_packet_parse(packet_buf, len, &packet));
+    TEST_ASSERT_FALSE(packet.marker);
+    TEST_ASSERT_EQUAL(0, packet.seq);
+    TEST_ASSERT_EQUAL(1320, packet.timestamp);
+    TEST_ASSERT_EQUAL(3, sender.packets);
+    TEST_ASSERT_EQUAL(480, sender.octets);
+
+    // Frames left out during silence move the timestamp on, not the sequence number
+    rtp_sender_skip(&sender, 320);
+    len = rtp_sender_finish(&sender, packet_buf, RTP_PT_CN, true, 1, 160);
+    TEST_ASSERT_TRUE(rtp_packet_parse(packet_buf, len, &packet));
+    TEST_ASSERT_EQUAL(RTP_PT_CN, packet.payload_type);
+    TEST_ASSERT_EQUAL(1, packet.seq);
+    TEST_ASSERT_EQUAL(1800, packet.timestamp);
+    TEST_ASSERT_EQUAL(4, sender.packets);
+}
+
+void test_rtp_packet_parse_optional_fields(void)
+{
+    // One CSRC, a one-word extension, 4 payload octets and 3 octets of padding
+    static const uint8_t data[] = {
+        0xb1, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03,
+        0xaa, 0xaa, 0xaa, 0xaa,
+        0xbe, 0xde, 0x00, 0x01, 0x01, 0x02, 0x03, 0x04,
+        0x10, 0x20, 0x30, 0x40,
+        0x00, 0x00, 0x03
+    };
+    rtp_packet_t packet;
+
+    TEST_ASSERT_TRUE(rtp_packet_parse(data, sizeof(data), &packet));
+    TEST_ASSERT_EQUAL(4, packet.payload_len);
+    TEST_ASSERT_EQUAL_HEX8(0x10, packet.payload[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x40, packet.payload[3]);
+
+    // Truncated, wrong version, padding longer than the packet
+    TEST_ASSERT_FALSE(rtp_packet_parse(data, RTP_HEADER_SIZE - 1, &packet));
+    TEST_ASSERT_FALSE(rtp_packet_parse(data, 20, &packet));
+    uint8_t bad[sizeof(data)];
+    memcpy(bad, data, sizeof(data));
+    bad[0] = 0x40;
+    TEST_ASSERT_FALSE(rtp_packet_parse(bad, sizeof(bad), &packet));
+    memcpy(bad, data, sizeof(data));
+    bad[sizeof(bad) - 1] = 0xff;
+    TEST_ASSERT_FALSE(rtp_packet_parse(bad, sizeof(bad), &packet));
+}
+
+void test_rtp_receiver_counts_loss_across_wrap(void)
+{
+    uint16_t seq = 65530;
+    uint32_t timestamp = 0;
+
+    for (int i = 0; i < 12; i++, seq++, timestamp += 160) {
+        if (i == 3 || i == 8) {
+            continue;   // Lost
+        }
+        rtp_packet_t packet = packet_with_seq(0xabc, seq, timestamp);
+        TEST_ASSERT_TRUE(rtp_receiver_update(&receiver, &packet, timestamp + 500));
+    }
+
+    TEST_ASSERT_EQUAL(10, receiver.received);
+    TEST_ASSERT_EQUAL(2, rtp_receiver_lost(&receiver));
+    TEST_ASSERT_EQUAL(65536 + 5, rtp_receiver_extended_max(&receiver));
+    // Perfectly paced arrivals
+    TEST_ASSERT_EQUAL(0, receiver.jitter);
+
+    // A late packet is accepted and no longer counts as lost
+    rtp_packet_t late = packet_with_seq(0xabc, 65533, 480);
+    TEST_ASSERT_TRUE(rtp_receiver_update(&receiver, &late, 2000));
+    TEST_ASSERT_EQUAL(1, rtp_receiver_lost(&receiver));
+    TEST_ASSERT_TRUE(receiver.jitter > 0);
+}
+
+void test_rtp_receiver_source_change_and_jump(void)
+{
+    rtp_packet_t packet = packet_with_seq(1, 100, 0);
+    TEST_ASSERT_TRUE(rtp_receiver_update(&receiver, &packet, 0));
+    packet = packet_with_seq(1, 101, 160);
+    TEST_ASSERT_TRUE(rtp_receiver_update(&receiver, &packet, 160));
+
+    // New SSRC: tracking restarts at its sequence number
+    packet = packet_with_seq(2, 40000, 0);
+    TEST_ASSERT_TRUE(rtp_receiver_update(&receiver, &packet, 320));
+    TEST_ASSERT_EQUAL(1, receiver.source_changes);
+    TEST_ASSERT_EQUAL(40000, receiver.base_seq);
+    TEST_ASSERT_EQUAL(1, receiver.received);
+
+    // A jump is only believed when the next packet follows it
+    packet = packet_with_seq(2, 10000, 160);
+    TEST_ASSERT_FALSE(rtp_receiver_update(&receiver, &packet, 480));
+    packet = packet_with_seq(2, 10001, 320);
+    TEST_ASSERT_TRUE(rtp_receiver_update(&receiver, &packet, 640));
+    TEST_ASSERT_EQUAL(10001, receiver.base_seq);
+    TEST_ASSERT_EQUAL(0, rtp_receiver_lost(&receiver));
+    TEST_ASSERT_EQUAL(1, receiver.source_changes);
+}
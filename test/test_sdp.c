@@ -0,0 +1,203 @@
+#include "unity.h"
+#include "sdp.h"
+#include <string.h>
+
+static sdp_codec_list_t offered;
+static sdp_media_t media;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(sdp_parse_codec_list(SDP_DEFAULT_CODECS, &offered));
+    memset(&media, 0, sizeof(media));
+}
+
+void tearDown(void)
+{
+}
+
+static bool parse(const char *answer)
+{
+    return sdp_parse_answer(answer, strlen(answer), &offered, &media);
+}
+
+void test_sdp_codec_list(void)
+{
+    sdp_codec_list_t list;
+
+    TEST_ASSERT_TRUE(sdp_parse_codec_list(" pcma , G722,Telephone-Event", &list));
+    TEST_ASSERT_EQUAL(3, list.count);
+    TEST_ASSERT_EQUAL(SDP_CODEC_PCMA, list.codecs[0]);
+    TEST_ASSERT_EQUAL(SDP_CODEC_G722, list.codecs[1]);
+    TEST_ASSERT_EQUAL(SDP_CODEC_TELEPHONE_EVENT, list.codecs[2]);
+
+    TEST_ASSERT_FALSE(sdp_parse_codec_list("PCMU,opus", &list));
+    TEST_ASSERT_FALSE(sdp_parse_codec_list("PCMU,PCMU", &list));
+    TEST_ASSERT_FALSE(sdp_parse_codec_list("telephone-event", &list));
+    TEST_ASSERT_FALSE(sdp_parse_codec_list("", &list));
+    TEST_ASSERT_FALSE(sdp_parse_codec_list("PCMU,", &list));
+}
+
+void test_sdp_offer_follows_preference(void)
+{
+    sdp_codec_list_t list;
+    char sdp[384];
+    TEST_ASSERT_TRUE(sdp_parse_codec_list("PCMA,G722,telephone-event", &list));
+    sdp_offer_t offer = {
+        .username = "door",
+        .session_id = 42,
+        .session_name = "OpenDoorStation",
+        .address = "192.168.1.50",
+        .port = 4000,
+        .codecs = &list
+    };
+
+    int len = sdp_write_offer(sdp, sizeof(sdp), &offer);
+    TEST_ASSERT_TRUE(len > 0 && (size_t)len < sizeof(sdp));
+    TEST_ASSERT_NOT_NULL(strstr(sdp, "o=door 42 42 IN IP4 192.168.1.50\r\n"));
+    TEST_ASSERT_NOT_NULL(strstr(sdp, "c=IN IP4 192.168.1.50\r\n"));
+    TEST_ASSERT_NOT_NULL(strstr(sdp, "m=audio 4000 RTP/AVP 8 9 101\r\n"));
+    TEST_ASSERT_NOT_NULL(strstr(sdp, "a=rtpmap:8 PCMA/8000\r\n"));
+    // RFC 3551: G.722 keeps the 8000 Hz RTP clock
+    TEST_ASSERT_NOT_NULL(strstr(sdp, "a=rtpmap:9 G722/8000\r\n"));
+    TEST_ASSERT_NOT_NULL(strstr(sdp, "a=rtpmap:101 telephone-event/8000\r\na=fmtp:101 0-15\r\n"));
+    TEST_ASSERT_NULL(strstr(sdp, "PCMU"));
+
+    // Fits the buffer esp_sip keeps for it with every codec offered
+    TEST_ASSERT_TRUE(sdp_parse_codec_list("G722,PCMU,PCMA,telephone-event,CN", &list));
+    offer.address = "255.255.255.255";
+    offer.session_id = 0x7fffffff;
+    len = sdp_write_offer(sdp, sizeof(sdp), &offer);
+    TEST_ASSERT_TRUE(len > 0 && (size_t)len < sizeof(sdp));
+}
+
+void test_sdp_answer_picks_first_offered_codec(void)
+{
+    const uint8_t expected[4] = { 10, 0, 0, 9 };
+
+    // Answerer prefers a codec we did not offer, then G.722
+    TEST_ASSERT_TRUE(parse("v=0\r\n"
+                           "o=- 1 1 IN IP4 10.0.0.9\r\n"
+                           "s=-\r\n"
+                           "c=IN IP4 10.0.0.9\r\n"
+                           "t=0 0\r\n"
+                           "m=audio 30000 RTP/AVP 18 9 0 101\r\n"
+                           "a=rtpmap:18 G729/8000\r\n"
+                           "a=rtpmap:9 G722/8000\r\n"
+                           "a=rtpmap:101 telephone-event/8000\r\n"));
+    TEST_ASSERT_EQUAL(SDP_CODEC_G722, media.codec);
+    TEST_ASSERT_EQUAL(9, media.payload_type);
+    TEST_ASSERT_EQUAL(101, media.dtmf_payload_type);
+    TEST_ASSERT_EQUAL(30000, media.remote_port);
+    TEST_ASSERT_EQUAL_MEMORY(expected, &media.remote_addr, 4);
+
+    // Static types without rtpmap, no telephone-event
+    TEST_ASSERT_TRUE(parse("v=0\nc=IN IP4 10.0.0.9\nm=audio 30002 RTP/AVP 8 0\n"));
+    TEST_ASSERT_EQUAL(SDP_CODEC_PCMA, media.codec);
+    TEST_ASSERT_EQUAL(8, media.payload_type);
+    TEST_ASSERT_EQUAL(0, media.dtmf_payload_type);
+}
+
+void test_sdp_answer_maps_dynamic_payload_types(void)
+{
+    const uint8_t expected[4] = { 127, 0, 0, 1 };
+
+    // Dynamic numbers for known codecs; a media c= overrides the session one
+    TEST_ASSERT_TRUE(parse("v=0\r\n"
+                           "c=IN IP4 10.0.0.9\r\n"
+                           "m=audio 30004 RTP/AVP 96 112 97\r\n"
+                           "c=IN IP4 127.0.0.1\r\n"
+                           "a=rtpmap:96 opus/48000/2\r\n"
+                           "a=rtpmap:112 G722/8000\r\n"
+                           "a=rtpmap:97 telephone-event/8000\r\n"));
+    TEST_ASSERT_EQUAL(SDP_CODEC_G722, media.codec);
+    TEST_ASSERT_EQUAL(112, media.payload_type);
+    TEST_ASSERT_EQUAL(97, media.dtmf_payload_type);
+    TEST_ASSERT_EQUAL_MEMORY(expected, &media.remote_addr, 4);
+
+    // Wideband telephone-event is not what we offered
+    TEST_ASSERT_TRUE(parse("c=IN IP4 10.0.0.9\r\n"
+                           "m=audio 30006 RTP/AVP 0 100\r\n"
+                           "a=rtpmap:100 telephone-event/16000\r\n"));
+    TEST_ASSERT_EQUAL(SDP_CODEC_PCMU, media.codec);
+    TEST_ASSERT_EQUAL(0, media.dtmf_payload_type);
+}
+
+void test_sdp_answer_comfort_noise(void)
+{
+    sdp_codec_list_t list;
+
+    // Comfort noise alone is no audio codec
+    TEST_ASSERT_FALSE(sdp_parse_codec_list("CN,telephone-event", &list));
+    TEST_ASSERT_TRUE(sdp_parse_codec_list("PCMA,CN", &list));
+    TEST_ASSERT_EQUAL(SDP_CODEC_CN, list.codecs[1]);
+    TEST_ASSERT_EQUAL(13, sdp_codec_payload_type(SDP_CODEC_CN));
+
+    // Static type 13 without rtpmap, behind the audio
+    TEST_ASSERT_TRUE(parse("c=IN IP4 10.0.0.9\r\nm=audio 30014 RTP/AVP 13 9 101\r\n"
+                           "a=rtpmap:101 telephone-event/8000\r\n"));
+    TEST_ASSERT_EQUAL(SDP_CODEC_G722, media.codec);
+    TEST_ASSERT_EQUAL(13, media.cn_payload_type);
+    TEST_ASSERT_EQUAL(101, media.dtmf_payload_type);
+
+    // Wideband comfort noise does not fit the 8000 Hz clock we offered
+    TEST_ASSERT_TRUE(parse("c=IN IP4 10.0.0.9\r\nm=audio 30016 RTP/AVP 9 98\r\n"
+                           "a=rtpmap:98 CN/16000\r\n"));
+    TEST_ASSERT_EQUAL(0, media.cn_payload_type);
+
+    // Not offered, not used
+    const char *answer = "c=IN IP4 10.0.0.9\r\nm=audio 30018 RTP/AVP 0 13\r\n";
+    TEST_ASSERT_TRUE(sdp_parse_codec_list("PCMU", &list));
+    TEST_ASSERT_TRUE(sdp_parse_answer(answer, strlen(answer), &list, &media));
+    TEST_ASSERT_EQUAL(0, media.cn_payload_type);
+}
+
+void test_sdp_answer_without_usable_audio(void)
+{
+    sdp_codec_list_t narrowband;
+    TEST_ASSERT_TRUE(sdp_parse_codec_list("PCMU,telephone-event", &narrowband));
+
+    // Rejected stream, video only, no address
+    TEST_ASSERT_FALSE(parse("c=IN IP4 10.0.0.9\r\nm=audio 0 RTP/AVP 0\r\n"));
+    TEST_ASSERT_FALSE(parse("c=IN IP4 10.0.0.9\r\nm=video 30008 RTP/AVP 96\r\n"));
+    TEST_ASSERT_FALSE(parse("m=audio 30010 RTP/AVP 0\r\n"));
+
+    // G.722 answered to an offer without it
+    const char *answer = "c=IN IP4 10.0.0.9\r\nm=audio 30012 RTP/AVP 9 101\r\n";
+    TEST_ASSERT_FALSE(sdp_parse_answer(answer, strlen(answer), &narrowband, &media));
+
+    // A rejected first stream does not hide a usable second one
+    TEST_ASSERT_TRUE(parse("c=IN IP4 10.0.0.9\r\n"
+                           "m=audio 0 RTP/AVP 9\r\n"
+                           "m=audio 30014 RTP/AVP 8\r\n"));
+    TEST_ASSERT_EQUAL(30014, media.remote_port);
+    TEST_ASSERT_EQUAL(SDP_CODEC_PCMA, media.codec);
+}
+
+void test_sdp_reinvite_answer_keeps_agreed_stream(void)
+{
+    char sdp[384];
+    sdp_offer_t session = {
+        .username = "door",
+        .session_id = 42,
+        .session_name = "Door",
+        .address = "192.168.1.50",
+        .port = 4000
+    };
+
+    // The far end picked G.722 and numbers telephone-event 96
+    TEST_ASSERT_TRUE(parse("c=IN IP4 10.0.0.9\r\n"
+                           "m=audio 30016 RTP/AVP 9 96 13\r\n"
+                           "a=rtpmap:96 telephone-event/8000\r\n"));
+    int len = sdp_write_answer(sdp, sizeof(sdp), &session, &media);
+    TEST_ASSERT_TRUE(len > 0 && (size_t)len < sizeof(sdp));
+    TEST_ASSERT_NOT_NULL(strstr(sdp, "o=door 42 43 IN IP4 192.168.1.50\r\n"));
+    TEST_ASSERT_NOT_NULL(strstr(sdp, "m=audio 4000 RTP/AVP 9 96 13\r\n"));
+    TEST_ASSERT_NOT_NULL(strstr(sdp, "a=rtpmap:96 telephone-event/8000\r\na=fmtp:96 0-15\r\n"));
+    TEST_ASSERT_NULL(strstr(sdp, "PCMU"));
+    TEST_ASSERT_NULL(strstr(sdp, "101"));
+
+    // Only the codec when the far end has no events or comfort noise
+    TEST_ASSERT_TRUE(parse("c=IN IP4 10.0.0.9\r\nm=audio 30018 RTP/AVP 8\r\n"));
+    sdp_write_answer(sdp, sizeof(sdp), &session, &media);
+    TEST_ASSERT_NOT_NULL(strstr(sdp, "m=audio 4000 RTP/AVP 8\r\na=rtpmap:8 PCMA/8000\r\na=ptime:20\r\n"));
+}
@@ -0,0 +1,177 @@
+#include "unity.h"
+#include "sip_arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define POOL_BLOCKS 16
+
+static SIP_ARENA_POOL_STORAGE(storage, POOL_BLOCKS * SIP_ARENA_BLOCK_SIZE);
+static sip_arena_pool_t pool;
+
+void setUp(void)
+{
+    sip_arena_pool_init(&pool, storage, sizeof(storage));
+}
+
+void tearDown(void)
+{
+}
+
+void test_sip_arena_bump_and_release(void)
+{
+    sip_arena_t arena;
+    sip_arena_pool_stats_t stats;
+
+    sip_arena_init(&arena, &pool);
+    char *tag = sip_arena_strndup(&arena, "a84b4c76e66710", 6);
+    TEST_ASSERT_NOT_NULL(tag);
+    TEST_ASSERT_EQUAL_STRING("a84b4c", tag);
+    uint8_t *a = sip_arena_alloc(&arena, 1);
+    uint8_t *b = sip_arena_alloc(&arena, 5);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_EQUAL(0, (uintptr_t)a % SIP_ARENA_ALIGN);
+    TEST_ASSERT_EQUAL_PTR(a + SIP_ARENA_ALIGN, b);
+    TEST_ASSERT_EQUAL_PTR((uint8_t *)tag + 8, a);
+    TEST_ASSERT_NULL(sip_arena_alloc(&arena, 0));
+
+    sip_arena_pool_get_stats(&pool, &stats);
+    TEST_ASSERT_EQUAL(POOL_BLOCKS * SIP_ARENA_BLOCK_SIZE, stats.size);
+    TEST_ASSERT_EQUAL(SIP_ARENA_BLOCK_SIZE, stats.in_use);
+    TEST_ASSERT_EQUAL(20, stats.largest_arena);
+
+    // One call returns everything, the next owner starts at the same place
+    sip_arena_release(&arena);
+    sip_arena_pool_get_stats(&pool, &stats);
+    TEST_ASSERT_EQUAL(0, stats.in_use);
+    TEST_ASSERT_EQUAL(SIP_ARENA_BLOCK_SIZE, stats.peak);
+    TEST_ASSERT_EQUAL_PTR(tag, sip_arena_alloc(&arena, 100));
+    sip_arena_release(&arena);
+}
+
+void test_sip_arena_grows_across_blocks(void)
+{
+    sip_arena_t first;
+    sip_arena_t second;
+    sip_arena_pool_stats_t stats;
+
+    sip_arena_init(&first, &pool);
+    sip_arena_init(&second, &pool);
+
+    // A message larger than a block takes a contiguous run
+    uint8_t *msg = sip_arena_alloc(&first, 3 * SIP_ARENA_BLOCK_SIZE - 20);
+    TEST_ASSERT_NOT_NULL(msg);
+    memset(msg, 0x5a, 3 * SIP_ARENA_BLOCK_SIZE - 20);
+    TEST_ASSERT_EQUAL(1, first.runs);
+
+    // Free blocks after the run let it grow in place
+    uint8_t *more = sip_arena_alloc(&first, 40);
+    TEST_ASSERT_EQUAL_PTR(msg + 3 * SIP_ARENA_BLOCK_SIZE - 20, more);
+    TEST_ASSERT_EQUAL(1, first.runs);
+    TEST_ASSERT_EQUAL(4, first.run_blocks[0]);
+
+    // Otherwise a new run starts elsewhere
+    TEST_ASSERT_NOT_NULL(sip_arena_alloc(&second, 8));
+    TEST_ASSERT_NOT_NULL(sip_arena_alloc(&first, SIP_ARENA_BLOCK_SIZE));
+    TEST_ASSERT_EQUAL(2, first.runs);
+    TEST_ASSERT_EQUAL_HEX8(0x5a, msg[3 * SIP_ARENA_BLOCK_SIZE - 21]);
+
+    sip_arena_pool_get_stats(&pool, &stats);
+    TEST_ASSERT_EQUAL(6 * SIP_ARENA_BLOCK_SIZE, stats.in_use);
+    sip_arena_release(&first);
+    sip_arena_release(&second);
+    sip_arena_pool_get_stats(&pool, &stats);
+    TEST_ASSERT_EQUAL(0, stats.in_use);
+    TEST_ASSERT_EQUAL(6 * SIP_ARENA_BLOCK_SIZE, stats.peak);
+}
+
+void test_sip_arena_exhaustion(void)
+{
+    sip_arena_t arena;
+    sip_arena_t other;
+    sip_arena_pool_stats_t stats;
+
+    sip_arena_init(&arena, &pool);
+    sip_arena_init(&other, &pool);
+
+    TEST_ASSERT_NULL(sip_arena_alloc(&arena, POOL_BLOCKS * SIP_ARENA_BLOCK_SIZE + 1));
+    TEST_ASSERT_NOT_NULL(sip_arena_alloc(&arena, POOL_BLOCKS * SIP_ARENA_BLOCK_SIZE));
+    TEST_ASSERT_NULL(sip_arena_alloc(&other, 1));
+    sip_arena_release(&arena);
+
+    // Interleaved blocks: each arena ends up with its most runs
+    for (int i = 0; i < 2 * SIP_ARENA_MAX_RUNS; i++) {
+        TEST_ASSERT_NOT_NULL(sip_arena_alloc((i % 2) ? &other : &arena, SIP_ARENA_BLOCK_SIZE));
+    }
+    TEST_ASSERT_EQUAL(SIP_ARENA_MAX_RUNS, arena.runs);
+    TEST_ASSERT_EQUAL(SIP_ARENA_MAX_RUNS, other.runs);
+
+    // A fifth run is refused, growing the last run in place still works
+    TEST_ASSERT_NULL(sip_arena_alloc(&arena, 8));
+    TEST_ASSERT_NOT_NULL(sip_arena_alloc(&other, 2 * SIP_ARENA_BLOCK_SIZE));
+    TEST_ASSERT_EQUAL(SIP_ARENA_MAX_RUNS, other.runs);
+
+    sip_arena_pool_get_stats(&pool, &stats);
+    TEST_ASSERT_EQUAL(3, stats.failures);
+    TEST_ASSERT_EQUAL(POOL_BLOCKS * SIP_ARENA_BLOCK_SIZE, stats.peak);
+    TEST_ASSERT_EQUAL(10 * SIP_ARENA_BLOCK_SIZE, stats.in_use);
+    sip_arena_release(&arena);
+    sip_arena_release(&other);
+    TEST_ASSERT_EQUAL(0, pool.blocks_used);
+}
+
+/**
+ * @brief Weeks of doorbell calls: after any number of them the pool is
+ *        as empty and as unfragmented as at boot
+ */
+void test_sip_arena_churn_stays_flat(void)
+{
+    sip_arena_t legs[4];
+    sip_arena_t transactions[3];
+    sip_arena_pool_stats_t stats;
+
+    for (int i = 0; i < 4; i++) {
+        sip_arena_init(&legs[i], &pool);
+    }
+    for (int i = 0; i < 3; i++) {
+        sip_arena_init(&transactions[i], &pool);
+    }
+
+    srand(7);
+    uint32_t peak_after_first = 0;
+    for (int call = 0; call < 20000; call++) {
+        int leg_count = 1 + rand() % 4;
+        for (int i = 0; i < leg_count; i++) {
+            sip_arena_strndup(&legs[i], "sip:flat@pbx.example.com", 10 + rand() % 80);
+            sip_arena_strndup(&legs[i], "1928301774", 1 + rand() % 10);
+        }
+        // Transactions end in a different order than they began
+        for (int i = 0; i < 3; i++) {
+            sip_arena_alloc(&transactions[i], 100 + rand() % 400);
+        }
+        sip_arena_release(&transactions[2]);
+        sip_arena_release(&transactions[0]);
+        for (int i = 0; i < leg_count; i++) {
+            sip_arena_release(&legs[i]);
+        }
+        sip_arena_release(&transactions[1]);
+        TEST_ASSERT_EQUAL(0, pool.blocks_used);
+        if (call == 0) {
+            sip_arena_pool_get_stats(&pool, &stats);
+            peak_after_first = stats.peak;
+        }
+    }
+
+    sip_arena_pool_get_stats(&pool, &stats);
+    TEST_ASSERT_TRUE(stats.largest_arena <= 8 * SIP_ARENA_BLOCK_SIZE);
+    TEST_ASSERT_EQUAL(0, stats.failures);
+
+    // The whole pool is still one free run
+    sip_arena_t whole;
+    sip_arena_init(&whole, &pool);
+    TEST_ASSERT_NOT_NULL(sip_arena_alloc(&whole, POOL_BLOCKS * SIP_ARENA_BLOCK_SIZE));
+    sip_arena_release(&whole);
+
+    sip_arena_pool_get_stats(&pool, &stats);
+    TEST_ASSERT_EQUAL(0, stats.in_use);
+    TEST_ASSERT_TRUE(peak_after_first > 0);
+}
@@ -0,0 +1,157 @@
+#include "unity.h"
+#include "sip_digest.h"
+#include <stdio.h>
+#include <string.h>
+
+static sip_digest_t digest;
+static sip_message_t msg;
+static char rx_buf[768];
+static char header[512];
+
+static const sip_message_t *parse_challenge(int code, const char *challenges)
+{
+    int n = snprintf(rx_buf, sizeof(rx_buf),
+                     "SIP/2.0 %d Unauthorized\r\n"
+                     "Via: SIP/2.0/UDP 10.0.0.2:5060;branch=z9hG4bK1\r\n"
+                     "From: <sip:door@pbx.local>;tag=a\r\n"
+                     "To: <sip:door@pbx.local>;tag=b\r\n"
+                     "Call-ID: digest-test\r\n"
+                     "CSeq: 1 REGISTER\r\n"
+                     "%s"
+                     "Content-Length: 0\r\n\r\n",
+                     code, challenges);
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(rx_buf, (size_t)n, &msg));
+    return &msg;
+}
+
+void setUp(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, sip_digest_init(&digest, "door", "secret"));
+    memset(header, 0, sizeof(header));
+}
+
+void tearDown(void)
+{
+}
+
+void test_sip_digest_rfc_vectors(void)
+{
+    char ha1[65];
+    char response[65];
+
+    // RFC 2617 section 3.5
+    TEST_ASSERT_EQUAL(ESP_OK, sip_digest_init(&digest, "Mufasa", "Circle Of Life"));
+    strcpy(ha1, "939e7578ed9e3c518a452acee763bce9");
+    TEST_ASSERT_EQUAL(ESP_OK, sip_digest_compute(SIP_DIGEST_MD5, ha1,
+                                                 "dcd98b7102dd2f0e8b11d0f600bfb0c093", "00000001",
+                                                 "0a4f113b", "auth", "GET", "/dir/index.html",
+                                                 response, sizeof(response)));
+    TEST_ASSERT_EQUAL_STRING("6629fae49393a05397450978507c4ef1", response);
+
+    // RFC 7616 section 3.9.1, SHA-256
+    strcpy(ha1, "7987c64c30e25f1b74be53f966b49b90f2808aa92faf9a00262392d7b4794232");
+    TEST_ASSERT_EQUAL(ESP_OK, sip_digest_compute(SIP_DIGEST_SHA256, ha1,
+                                                 "7ypf/xlj9XXwfDPEoM4URrv/xwf94BcCAzFZH4GiTo0v",
+                                                 "00000001",
+                                                 "f2/wE4q74E6zIJEtWaHKaf5wv/H5QzzpXusqGemxURZJ",
+                                                 "auth", "GET", "/dir/index.html",
+                                                 response, sizeof(response)));
+    TEST_ASSERT_EQUAL_STRING("753927fa0e85d155564e2e272a28d1802ca10daf4496794697cf8db5856cb6c1", response);
+}
+
+void test_sip_digest_parses_challenge(void)
+{
+    bool stale = true;
+
+    parse_challenge(401, "WWW-Authenticate: Digest realm=\"pbx.local\", nonce=\"abc123\", "
+                         "qop=\"auth,auth-int\", opaque=\"op\", algorithm=MD5\r\n");
+    TEST_ASSERT_EQUAL(ESP_OK, sip_digest_handle_challenge(&digest, &msg, &stale));
+
+    TEST_ASSERT_FALSE(stale);
+    TEST_ASSERT_TRUE(digest.has_challenge);
+    TEST_ASSERT_FALSE(digest.proxy);
+    TEST_ASSERT_TRUE(digest.qop_auth);
+    TEST_ASSERT_EQUAL(SIP_DIGEST_MD5, digest.algorithm);
+    TEST_ASSERT_EQUAL_STRING("pbx.local", digest.realm);
+    TEST_ASSERT_EQUAL_STRING("abc123", digest.nonce);
+    TEST_ASSERT_EQUAL_STRING("op", digest.opaque);
+}
+
+void test_sip_digest_prefers_sha256(void)
+{
+    parse_challenge(407, "Proxy-Authenticate: Digest realm=\"r\", nonce=\"n1\", algorithm=MD5\r\n"
+                         "Proxy-Authenticate: Digest realm=\"r\", nonce=\"n2\", algorithm=SHA-256\r\n"
+                         "Proxy-Authenticate: Digest realm=\"r\", nonce=\"n3\", algorithm=MD5-sess\r\n");
+    TEST_ASSERT_EQUAL(ESP_OK, sip_digest_handle_challenge(&digest, &msg, NULL));
+
+    TEST_ASSERT_TRUE(digest.proxy);
+    TEST_ASSERT_EQUAL(SIP_DIGEST_SHA256, digest.algorithm);
+    TEST_ASSERT_EQUAL_STRING("n2", digest.nonce);
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_digest_authorize(&digest, SIP_METHOD_INVITE, "sip:res@r",
+                                                   header, sizeof(header)));
+    TEST_ASSERT_EQUAL(0, strncmp(header, "Proxy-Authorization: Digest ", 28));
+    TEST_ASSERT_NOT_NULL(strstr(header, "algorithm=SHA-256"));
+}
+
+void test_sip_digest_rejects_unusable_challenge(void)
+{
+    parse_challenge(401, "WWW-Authenticate: Basic realm=\"r\"\r\n"
+                         "WWW-Authenticate: Digest realm=\"r\", algorithm=MD5\r\n");
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, sip_digest_handle_challenge(&digest, &msg, NULL));
+    TEST_ASSERT_FALSE(digest.has_challenge);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, sip_digest_authorize(&digest, SIP_METHOD_REGISTER,
+                                                                  "sip:r", header, sizeof(header)));
+}
+
+void test_sip_digest_reuses_nonce_and_ha1(void)
+{
+    char response[65];
+    char expected[65];
+    char nc[9];
+    char cnonce[9];
+    char ha1[65];
+    const char *p;
+
+    parse_challenge(401, "WWW-Authenticate: Digest realm=\"pbx.local\", nonce=\"n1\", qop=auth\r\n");
+    sip_digest_handle_challenge(&digest, &msg, NULL);
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_digest_authorize(&digest, SIP_METHOD_REGISTER, "sip:pbx.local",
+                                                   header, sizeof(header)));
+    TEST_ASSERT_NOT_NULL(strstr(header, "nc=00000001"));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_digest_authorize(&digest, SIP_METHOD_INVITE, "sip:res@pbx.local",
+                                                   header, sizeof(header)));
+    TEST_ASSERT_NOT_NULL(strstr(header, "nc=00000002"));
+    TEST_ASSERT_EQUAL(1, digest.ha1_computations);
+
+    // The response in the header must verify against an independent computation
+    p = strstr(header, "cnonce=\"");
+    TEST_ASSERT_NOT_NULL(p);
+    memcpy(cnonce, p + 8, 8);
+    cnonce[8] = '\0';
+    strcpy(nc, "00000002");
+    strcpy(ha1, digest.ha1);
+    sip_digest_compute(SIP_DIGEST_MD5, ha1, "n1", nc, cnonce, "auth", "INVITE",
+                       "sip:res@pbx.local", expected, sizeof(expected));
+    p = strstr(header, "response=\"");
+    TEST_ASSERT_NOT_NULL(p);
+    memcpy(response, p + 10, 32);
+    response[32] = '\0';
+    TEST_ASSERT_EQUAL_STRING(expected, response);
+
+    // A new nonce for the same realm restarts nonce-count but keeps HA1
+    parse_challenge(401, "WWW-Authenticate: Digest realm=\"pbx.local\", nonce=\"n2\", stale=TRUE, qop=auth\r\n");
+    bool stale = false;
+    sip_digest_handle_challenge(&digest, &msg, &stale);
+    TEST_ASSERT_TRUE(stale);
+    sip_digest_authorize(&digest, SIP_METHOD_REGISTER, "sip:pbx.local", header, sizeof(header));
+    TEST_ASSERT_NOT_NULL(strstr(header, "nc=00000001"));
+    TEST_ASSERT_EQUAL(1, digest.ha1_computations);
+
+    // A different realm needs a new HA1
+    parse_challenge(401, "WWW-Authenticate: Digest realm=\"other\", nonce=\"n3\"\r\n");
+    sip_digest_handle_challenge(&digest, &msg, NULL);
+    sip_digest_authorize(&digest, SIP_METHOD_REGISTER, "sip:pbx.local", header, sizeof(header));
+    TEST_ASSERT_EQUAL(2, digest.ha1_computations);
+    TEST_ASSERT_NULL(strstr(header, "qop="));
+}
@@ -0,0 +1,376 @@
+#include "unity.h"
+#include "sip_dns.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include <string.h>
+#include <strings.h>
+
+/**
+ * @brief A record served by the stub DNS server
+ */
+typedef struct {
+    const char *name;
+    uint16_t type;
+    uint32_t ttl;
+    const char *addr;                   // A
+    uint16_t priority, weight, port;    // SRV
+    const char *target;                 // SRV target / NAPTR replacement
+    uint16_t order, preference;         // NAPTR
+    const char *services;               // NAPTR
+} stub_rr_t;
+
+#define STUB_A(n, ttl, a)                    { n, 1, ttl, a, 0, 0, 0, NULL, 0, 0, NULL }
+#define STUB_SRV(n, ttl, pr, w, p, t)        { n, 33, ttl, NULL, pr, w, p, t, 0, 0, NULL }
+#define STUB_NAPTR(n, ttl, o, pf, svc, repl) { n, 35, ttl, NULL, 0, 0, 0, repl, o, pf, svc }
+
+static stub_rr_t stub_zone[] = {
+    // SRV with glue for the first target only
+    STUB_SRV("_sip._udp.pbx.test", 300, 20, 0, 5080, "b.pbx.test"),
+    STUB_SRV("_sip._udp.pbx.test", 300, 10, 100, 5070, "a.pbx.test"),
+    STUB_A("a.pbx.test", 300, "10.1.0.1"),
+    STUB_A("b.pbx.test", 300, "10.1.0.2"),
+
+    // NAPTR picks a differently named SRV per transport
+    STUB_NAPTR("naptr.test", 300, 10, 10, "SIP+D2T", "_sip._tcp.edge.naptr.test"),
+    STUB_NAPTR("naptr.test", 300, 20, 10, "SIP+D2U", "_sip._udp.edge.naptr.test"),
+    STUB_SRV("_sip._udp.edge.naptr.test", 300, 0, 0, 5090, "edge.naptr.test"),
+    STUB_SRV("_sip._tcp.edge.naptr.test", 300, 0, 0, 5091, "edge.naptr.test"),
+    STUB_A("edge.naptr.test", 300, "10.2.0.1"),
+
+    // No NAPTR or SRV at all
+    STUB_A("plain.test", 300, "10.3.0.1"),
+
+    // Short TTL for the refresh test
+    STUB_SRV("_sip._udp.short.test", 1, 0, 0, 5060, "sip.short.test"),
+    STUB_A("sip.short.test", 1, "10.4.0.1"),
+};
+
+static struct {
+    int sock;
+    uint16_t port;
+    volatile bool running;
+    volatile bool stopped;
+    volatile uint32_t queries;
+} stub;
+
+static size_t put_name(uint8_t *p, size_t off, const char *name)
+{
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        size_t len = dot ? (size_t)(dot - name) : strlen(name);
+        p[off++] = (uint8_t)len;
+        memcpy(p + off, name, len);
+        off += len;
+        name += len + (dot ? 1 : 0);
+    }
+    p[off++] = 0;
+    return off;
+}
+
+static size_t put_string(uint8_t *p, size_t off, const char *s)
+{
+    p[off++] = (uint8_t)strlen(s);
+    memcpy(p + off, s, strlen(s));
+    return off + strlen(s);
+}
+
+static size_t put_rr(uint8_t *p, size_t off, const stub_rr_t *rr)
+{
+    off = put_name(p, off, rr->name);
+    p[off++] = 0;
+    p[off++] = (uint8_t)rr->type;
+    p[off++] = 0;
+    p[off++] = 1;
+    p[off++] = rr->ttl >> 24;
+    p[off++] = rr->ttl >> 16;
+    p[off++] = rr->ttl >> 8;
+    p[off++] = rr->ttl;
+    size_t rdlen_at = off;
+    off += 2;
+    if (rr->type == 1) {
+        struct in_addr in;
+        inet_aton(rr->addr, &in);
+        memcpy(p + off, &in.s_addr, 4);
+        off += 4;
+    } else if (rr->type == 33) {
+        uint16_t v[3] = { rr->priority, rr->weight, rr->port };
+        for (int i = 0; i < 3; i++) {
+            p[off++] = v[i] >> 8;
+            p[off++] = v[i] & 0xFF;
+        }
+        off = put_name(p, off, rr->target);
+    } else {
+        p[off++] = rr->order >> 8;
+        p[off++] = rr->order & 0xFF;
+        p[off++] = rr->preference >> 8;
+        p[off++] = rr->preference & 0xFF;
+        off = put_string(p, off, "s");
+        off = put_string(p, off, rr->services);
+        off = put_string(p, off, "");
+        off = put_name(p, off, rr->target);
+    }
+    p[rdlen_at] = (off - rdlen_at - 2) >> 8;
+    p[rdlen_at + 1] = (off - rdlen_at - 2) & 0xFF;
+    return off;
+}
+
+/**
+ * @brief Answer one query from stub_zone, with glue for SRV answers
+ */
+static size_t stub_answer(const uint8_t *q, size_t qlen, uint8_t *p)
+{
+    char name[128] = "";
+    size_t off = 12;
+    size_t used = 0;
+
+    while (off < qlen && q[off] != 0) {
+        if (used) {
+            name[used++] = '.';
+        }
+        memcpy(name + used, q + off + 1, q[off]);
+        used += q[off];
+        name[used] = '\0';
+        off += 1 + q[off];
+    }
+    uint16_t type = (q[off + 1] << 8) | q[off + 2];
+    size_t question_end = off + 5;
+
+    memcpy(p, q, question_end);
+    p[2] = 0x81;    // QR, RD
+    p[3] = 0x80;    // RA
+    off = question_end;
+
+    int answers = 0;
+    int additional = 0;
+    bool name_exists = false;
+    for (size_t i = 0; i < sizeof(stub_zone) / sizeof(stub_zone[0]); i++) {
+        if (strcasecmp(stub_zone[i].name, name) == 0) {
+            name_exists = true;
+            if (stub_zone[i].type == type) {
+                off = put_rr(p, off, &stub_zone[i]);
+                answers++;
+            }
+        }
+    }
+    if (type == 33 && strcmp(name, "_sip._udp.pbx.test") == 0) {
+        off = put_rr(p, off, &stub_zone[2]);
+        additional++;
+    }
+    if (!name_exists && strncmp(name, "_sip", 4) != 0 && strcasecmp(name, "naptr.test") != 0 &&
+        strcasecmp(name, "pbx.test") != 0 && strcasecmp(name, "short.test") != 0) {
+        p[3] |= 3;  // NXDOMAIN
+    }
+    p[6] = 0;
+    p[7] = answers;
+    p[8] = p[9] = 0;
+    p[10] = 0;
+    p[11] = additional;
+    return off;
+}
+
+static void stub_task(void *arg)
+{
+    uint8_t q[512];
+    uint8_t r[512];
+
+    while (stub.running) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(stub.sock, &fds);
+        struct timeval tv = { .tv_sec = 0, .tv_usec = 20000 };
+        if (select(stub.sock + 1, &fds, NULL, NULL, &tv) <= 0) {
+            continue;
+        }
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int n = recvfrom(stub.sock, q, sizeof(q), 0, (struct sockaddr *)&from, &from_len);
+        if (n < 17) {
+            continue;
+        }
+        stub.queries++;
+        size_t len = stub_answer(q, (size_t)n, r);
+        sendto(stub.sock, r, len, 0, (struct sockaddr *)&from, from_len);
+    }
+    stub.stopped = true;
+    vTaskDelete(NULL);
+}
+
+static void stub_stop(void)
+{
+    if (!stub.running) {
+        return;
+    }
+    stub.running = false;
+    while (!stub.stopped) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    close(stub.sock);
+}
+
+void setUp(void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+    socklen_t len = sizeof(addr);
+
+    memset(&stub, 0, sizeof(stub));
+    stub.sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    TEST_ASSERT_TRUE(stub.sock >= 0);
+    TEST_ASSERT_EQUAL(0, bind(stub.sock, (struct sockaddr *)&addr, sizeof(addr)));
+    getsockname(stub.sock, (struct sockaddr *)&addr, &len);
+    stub.port = ntohs(addr.sin_port);
+    stub.running = true;
+    xTaskCreate(stub_task, "dns_stub", 4096, NULL, 5, NULL);
+
+    sip_dns_config_t config = {
+        .server_addr = htonl(INADDR_LOOPBACK),
+        .server_port = stub.port,
+        .timeout_ms = 200,
+        .min_ttl_sec = 1
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, sip_dns_init(&config));
+}
+
+void tearDown(void)
+{
+    sip_dns_deinit();
+    stub_stop();
+}
+
+static uint32_t ip(const char *s)
+{
+    struct in_addr in;
+    inet_aton(s, &in);
+    return in.s_addr;
+}
+
+void test_sip_dns_srv_priority_and_cache(void)
+{
+    sip_dns_result_t result;
+    sip_dns_stats_t stats;
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_dns_resolve("pbx.test", 5060, SIP_DNS_TRANSPORT_UDP, &result));
+    TEST_ASSERT_TRUE(result.from_srv);
+    TEST_ASSERT_EQUAL(2, result.count);
+    TEST_ASSERT_EQUAL_UINT32(ip("10.1.0.1"), result.targets[0].addr);
+    TEST_ASSERT_EQUAL(5070, result.targets[0].port);
+    TEST_ASSERT_EQUAL_UINT32(ip("10.1.0.2"), result.targets[1].addr);
+    TEST_ASSERT_EQUAL(5080, result.targets[1].port);
+
+    // NAPTR, SRV and the A lookup for the target without glue
+    uint32_t queries = stub.queries;
+    TEST_ASSERT_EQUAL(3, queries);
+
+    // Cached from now on, including the non-blocking lookup
+    TEST_ASSERT_EQUAL(ESP_OK, sip_dns_resolve("PBX.test", 5060, SIP_DNS_TRANSPORT_UDP, &result));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_dns_lookup_cached("pbx.test", 5060, SIP_DNS_TRANSPORT_UDP, &result));
+    TEST_ASSERT_EQUAL(5070, result.targets[0].port);
+    TEST_ASSERT_EQUAL(queries, stub.queries);
+
+    sip_dns_get_stats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.cache_hits);
+    TEST_ASSERT_EQUAL(3, stats.queries);
+
+    // Other transports are separate entries
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND,
+                      sip_dns_lookup_cached("pbx.test", 5060, SIP_DNS_TRANSPORT_TCP, &result));
+}
+
+void test_sip_dns_naptr_selects_transport(void)
+{
+    sip_dns_result_t result;
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_dns_resolve("naptr.test", 5060, SIP_DNS_TRANSPORT_UDP, &result));
+    TEST_ASSERT_TRUE(result.from_srv);
+    TEST_ASSERT_EQUAL(1, result.count);
+    TEST_ASSERT_EQUAL(5090, result.targets[0].port);
+    TEST_ASSERT_EQUAL_UINT32(ip("10.2.0.1"), result.targets[0].addr);
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_dns_resolve("naptr.test", 5060, SIP_DNS_TRANSPORT_TCP, &result));
+    TEST_ASSERT_EQUAL(5091, result.targets[0].port);
+}
+
+void test_sip_dns_fallbacks(void)
+{
+    sip_dns_result_t result;
+
+    // No SRV: the domain itself on the default port
+    TEST_ASSERT_EQUAL(ESP_OK, sip_dns_resolve("plain.test", 5062, SIP_DNS_TRANSPORT_UDP, &result));
+    TEST_ASSERT_FALSE(result.from_srv);
+    TEST_ASSERT_EQUAL(1, result.count);
+    TEST_ASSERT_EQUAL_UINT32(ip("10.3.0.1"), result.targets[0].addr);
+    TEST_ASSERT_EQUAL(5062, result.targets[0].port);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND,
+                      sip_dns_resolve("missing.test", 5060, SIP_DNS_TRANSPORT_UDP, &result));
+
+    // Literals never touch DNS
+    uint32_t queries = stub.queries;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_dns_resolve("192.168.1.10", 5060, SIP_DNS_TRANSPORT_UDP, &result));
+    TEST_ASSERT_EQUAL_UINT32(ip("192.168.1.10"), result.targets[0].addr);
+    TEST_ASSERT_EQUAL(queries, stub.queries);
+
+    // A dead server times out instead of hanging
+    stub_stop();
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT,
+                      sip_dns_resolve("other.test", 5060, SIP_DNS_TRANSPORT_UDP, &result));
+}
+
+void test_sip_dns_background_refresh(void)
+{
+    sip_dns_result_t result;
+    sip_dns_stats_t stats;
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_dns_resolve("short.test", 5060, SIP_DNS_TRANSPORT_UDP, &result));
+    TEST_ASSERT_EQUAL_UINT32(ip("10.4.0.1"), result.targets[0].addr);
+    TEST_ASSERT_EQUAL(1, result.ttl_sec);
+
+    // The server moves; the refresh task picks it up before the TTL runs out
+    stub_zone[sizeof(stub_zone) / sizeof(stub_zone[0]) - 1].addr = "10.4.0.2";
+    for (int i = 0; i < 40; i++) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+        sip_dns_lookup_cached("short.test", 5060, SIP_DNS_TRANSPORT_UDP, &result);
+        if (result.targets[0].addr == ip("10.4.0.2")) {
+            break;
+        }
+    }
+    stub_zone[sizeof(stub_zone) / sizeof(stub_zone[0]) - 1].addr = "10.4.0.1";
+    TEST_ASSERT_EQUAL_UINT32(ip("10.4.0.2"), result.targets[0].addr);
+    sip_dns_get_stats(&stats);
+    TEST_ASSERT_GREATER_OR_EQUAL(1, stats.refreshes);
+
+    // With DNS gone the last answer keeps being served
+    stub_stop();
+    vTaskDelay(pdMS_TO_TICKS(1500));
+    sip_dns_refresh_due();
+    TEST_ASSERT_EQUAL(ESP_OK, sip_dns_lookup_cached("short.test", 5060, SIP_DNS_TRANSPORT_UDP, &result));
+    TEST_ASSERT_EQUAL_UINT32(ip("10.4.0.2"), result.targets[0].addr);
+    sip_dns_get_stats(&stats);
+    TEST_ASSERT_GREATER_OR_EQUAL(1, stats.stale_hits);
+    TEST_ASSERT_GREATER_OR_EQUAL(1, stats.failures);
+}
+
+void test_sip_dns_weighted_order(void)
+{
+    int heavy_first = 0;
+
+    for (int run = 0; run < 1000; run++) {
+        sip_dns_target_t targets[] = {
+            { .addr = 1, .priority = 20, .weight = 50 },
+            { .addr = 2, .priority = 10, .weight = 10 },
+            { .addr = 3, .priority = 10, .weight = 90 },
+            { .addr = 4, .priority = 10, .weight = 0 },
+        };
+        sip_dns_order_targets(targets, 4);
+
+        // Priority always wins over weight
+        TEST_ASSERT_EQUAL(1, targets[3].addr);
+        if (targets[0].addr == 3) {
+            heavy_first++;
+        }
+    }
+    TEST_ASSERT_TRUE(heavy_first > 800 && heavy_first < 960);
+}
@@ -0,0 +1,162 @@
+#include "unity.h"
+#include "sip_event_queue.h"
+#include <string.h>
+
+static sip_event_queue_t queue;
+
+void setUp(void)
+{
+    sip_event_queue_init(&queue);
+}
+
+void tearDown(void)
+{
+}
+
+static bool push_state(sip_event_type_t type, int error_code)
+{
+    sip_event_data_t event = { .event_type = type };
+    if (type == SIP_EVENT_CALL_FAILED || type == SIP_EVENT_REGISTRATION_FAILED) {
+        event.data.error.error_code = error_code;
+        strcpy(event.data.error.error_message, "Busy Here");
+    }
+    return sip_event_queue_push(&queue, &event);
+}
+
+static bool push_dtmf(char digit)
+{
+    sip_event_data_t event = {
+        .event_type = SIP_EVENT_DTMF_RECEIVED,
+        .data.dtmf = { .digit = digit, .timestamp = 42 }
+    };
+    return sip_event_queue_push(&queue, &event);
+}
+
+void test_sip_event_queue_order(void)
+{
+    sip_event_data_t event;
+    sip_event_queue_stats_t stats;
+
+    TEST_ASSERT_FALSE(sip_event_queue_pop(&queue, &event));
+
+    TEST_ASSERT_TRUE(push_state(SIP_EVENT_CALL_STARTED, 0));
+    TEST_ASSERT_TRUE(push_state(SIP_EVENT_CALL_CONNECTED, 0));
+    TEST_ASSERT_TRUE(push_dtmf('5'));
+    TEST_ASSERT_TRUE(push_state(SIP_EVENT_CALL_FAILED, 486));
+
+    TEST_ASSERT_TRUE(sip_event_queue_pop(&queue, &event));
+    TEST_ASSERT_EQUAL(SIP_EVENT_CALL_STARTED, event.event_type);
+    TEST_ASSERT_TRUE(sip_event_queue_pop(&queue, &event));
+    TEST_ASSERT_EQUAL(SIP_EVENT_CALL_CONNECTED, event.event_type);
+    TEST_ASSERT_TRUE(sip_event_queue_pop(&queue, &event));
+    TEST_ASSERT_EQUAL(SIP_EVENT_DTMF_RECEIVED, event.event_type);
+    TEST_ASSERT_EQUAL_CHAR('5', event.data.dtmf.digit);
+    TEST_ASSERT_EQUAL(42, event.data.dtmf.timestamp);
+    TEST_ASSERT_TRUE(sip_event_queue_pop(&queue, &event));
+    TEST_ASSERT_EQUAL(SIP_EVENT_CALL_FAILED, event.event_type);
+    TEST_ASSERT_EQUAL(486, event.data.error.error_code);
+    TEST_ASSERT_EQUAL_STRING("Busy Here", event.data.error.error_message);
+    TEST_ASSERT_FALSE(sip_event_queue_pop(&queue, &event));
+
+    sip_event_queue_get_stats(&queue, &stats);
+    TEST_ASSERT_EQUAL(4, stats.posted);
+    TEST_ASSERT_EQUAL(4, stats.delivered);
+    TEST_ASSERT_EQUAL(4, stats.high_water);
+    TEST_ASSERT_EQUAL(0, stats.coalesced);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+}
+
+void test_sip_event_queue_coalesces_state(void)
+{
+    sip_event_data_t event;
+    sip_event_queue_stats_t stats;
+    const int state_slots = SIP_EVENT_QUEUE_SIZE - SIP_EVENT_QUEUE_DTMF_RESERVE;
+
+    // A stalled consumer: state events fill the ring up to the DTMF reserve
+    for (int i = 0; i < state_slots; i++) {
+        TEST_ASSERT_TRUE(push_state(SIP_EVENT_REGISTERED, 0));
+    }
+    // Beyond it only the latest state is kept
+    TEST_ASSERT_TRUE(push_state(SIP_EVENT_CALL_STARTED, 0));
+    TEST_ASSERT_TRUE(push_state(SIP_EVENT_CALL_CONNECTED, 0));
+    TEST_ASSERT_TRUE(push_state(SIP_EVENT_CALL_FAILED, -1));
+
+    // The reserve is still free for key presses
+    for (int i = 0; i < SIP_EVENT_QUEUE_DTMF_RESERVE; i++) {
+        TEST_ASSERT_TRUE(push_dtmf('0' + i));
+    }
+
+    for (int i = 0; i < state_slots; i++) {
+        TEST_ASSERT_TRUE(sip_event_queue_pop(&queue, &event));
+        TEST_ASSERT_EQUAL(SIP_EVENT_REGISTERED, event.event_type);
+    }
+    for (int i = 0; i < SIP_EVENT_QUEUE_DTMF_RESERVE; i++) {
+        TEST_ASSERT_TRUE(sip_event_queue_pop(&queue, &event));
+        TEST_ASSERT_EQUAL(SIP_EVENT_DTMF_RECEIVED, event.event_type);
+        TEST_ASSERT_EQUAL_CHAR('0' + i, event.data.dtmf.digit);
+    }
+    // The coalesced state comes last, with its error code
+    TEST_ASSERT_TRUE(sip_event_queue_pop(&queue, &event));
+    TEST_ASSERT_EQUAL(SIP_EVENT_CALL_FAILED, event.event_type);
+    TEST_ASSERT_EQUAL(-1, event.data.error.error_code);
+    TEST_ASSERT_FALSE(sip_event_queue_pop(&queue, &event));
+
+    sip_event_queue_get_stats(&queue, &stats);
+    TEST_ASSERT_EQUAL(2, stats.coalesced);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+    TEST_ASSERT_EQUAL(SIP_EVENT_QUEUE_SIZE, stats.high_water);
+    TEST_ASSERT_EQUAL(stats.posted - stats.coalesced, stats.delivered);
+}
+
+void test_sip_event_queue_state_follows_mailbox(void)
+{
+    sip_event_data_t event;
+    const int state_slots = SIP_EVENT_QUEUE_SIZE - SIP_EVENT_QUEUE_DTMF_RESERVE;
+
+    for (int i = 0; i <= state_slots; i++) {
+        TEST_ASSERT_TRUE(push_state(SIP_EVENT_CALL_STARTED, 0));
+    }
+    // Room in the ring again, but a state event still waits in the mailbox:
+    // the newer one must not overtake it
+    TEST_ASSERT_TRUE(sip_event_queue_pop(&queue, &event));
+    TEST_ASSERT_TRUE(push_state(SIP_EVENT_CALL_ENDED, 0));
+
+    sip_event_type_t last = SIP_EVENT_DTMF_RECEIVED;
+    while (sip_event_queue_pop(&queue, &event)) {
+        last = event.event_type;
+    }
+    TEST_ASSERT_EQUAL(SIP_EVENT_CALL_ENDED, last);
+
+    // Once the mailbox is taken, state events use the ring again
+    TEST_ASSERT_TRUE(push_state(SIP_EVENT_REGISTERED, 0));
+    TEST_ASSERT_EQUAL(0, atomic_load(&queue.mailbox));
+}
+
+void test_sip_event_queue_dtmf_overflow(void)
+{
+    sip_event_data_t event;
+    sip_event_queue_stats_t stats;
+
+    for (int i = 0; i < SIP_EVENT_QUEUE_SIZE; i++) {
+        TEST_ASSERT_TRUE(push_dtmf('#'));
+    }
+    // Only a completely full ring loses a digit, and it is counted
+    TEST_ASSERT_FALSE(push_dtmf('1'));
+    sip_event_queue_get_stats(&queue, &stats);
+    TEST_ASSERT_EQUAL(1, stats.dropped);
+
+    // State events still get through while the ring is full
+    TEST_ASSERT_TRUE(push_state(SIP_EVENT_CALL_ENDED, 0));
+
+    // The ring keeps working across the wrap of its indices
+    for (int round = 0; round < 3 * SIP_EVENT_QUEUE_SIZE; round++) {
+        TEST_ASSERT_TRUE(sip_event_queue_pop(&queue, &event));
+        TEST_ASSERT_TRUE(push_dtmf('0' + round % 10));
+    }
+    int count = 0;
+    while (sip_event_queue_pop(&queue, &event)) {
+        count++;
+    }
+    TEST_ASSERT_EQUAL(SIP_EVENT_QUEUE_SIZE + 1, count);
+    TEST_ASSERT_EQUAL(SIP_EVENT_CALL_ENDED, event.event_type);
+}
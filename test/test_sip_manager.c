@@ -1,6 +1,7 @@
 #include "unity.h"
 #include "sip_manager.h"
 #include "mock_esp_sip.h"
+#include "mock_esp_timer.h"
 #include "esp_event.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -21,6 +22,8 @@ static void test_dtmf_callback(char digit, void *user_data) {
 void setUp(void) {
     // Reset mock state
     mock_esp_sip_reset();
+    mock_esp_timer_reset();
+    call_latency_reset();
     
     // Initialize test configuration
     test_config = (sip_config_t){
@@ -74,6 +77,12 @@ void test_sip_manager_init_invalid_config(void) {
     strcpy(invalid_config.domain, "");
     ret = sip_manager_init(&invalid_config);
     TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, ret);
+
+    // Test with an unknown codec
+    invalid_config = test_config;
+    strcpy(invalid_config.codecs, "G722,GSM");
+    ret = sip_manager_init(&invalid_config);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, ret);
 }
 
 void test_sip_manager_init_esp_sip_failure(void) {
@@ -308,6 +317,245 @@ void test_sip_manager_call_failure_statistics(void) {
     TEST_ASSERT_EQUAL(0, stats.total_call_duration);
 }
 
+void test_sip_manager_auth_challenges_avoided_stats(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    
+    // esp_sip counted two requests accepted on pre-sent credentials
+    mock_esp_sip_get_control()->stats.auth_challenges_avoided = 2;
+    
+    sip_call_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_stats(&stats));
+    TEST_ASSERT_EQUAL(2, stats.auth_challenges_avoided);
+    
+    // Reading again must not count the same requests twice
+    mock_esp_sip_get_control()->stats.auth_challenges_avoided = 3;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_stats(&stats));
+    TEST_ASSERT_EQUAL(3, stats.auth_challenges_avoided);
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_reset_call_stats());
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_stats(&stats));
+    TEST_ASSERT_EQUAL(0, stats.auth_challenges_avoided);
+}
+
+void test_sip_manager_forked_call_leg_stats(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    
+    sip_call_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_stats(&stats));
+    TEST_ASSERT_EQUAL(0, stats.last_call_leg_count);
+    TEST_ASSERT_EQUAL(-1, stats.last_call_answered_leg);
+    
+    // Two callees rung in parallel, the second one picked up
+    mock_esp_sip_control_t *mock = mock_esp_sip_get_control();
+    mock->stats.last_call_legs = 2;
+    mock->stats.last_call_answered_leg = 1;
+    mock->stats.last_call_leg[0] = (esp_sip_leg_timing_t){ .status = 487, .provisional_ms = 120, .final_ms = 2400 };
+    mock->stats.last_call_leg[1] = (esp_sip_leg_timing_t){ .status = 200, .provisional_ms = 95, .final_ms = 2350 };
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_stats(&stats));
+    TEST_ASSERT_EQUAL(2, stats.last_call_leg_count);
+    TEST_ASSERT_EQUAL(1, stats.last_call_answered_leg);
+    TEST_ASSERT_EQUAL(487, stats.last_call_legs[0].final_status);
+    TEST_ASSERT_EQUAL(120, stats.last_call_legs[0].ringing_ms);
+    TEST_ASSERT_EQUAL(200, stats.last_call_legs[1].final_status);
+    TEST_ASSERT_EQUAL(2350, stats.last_call_legs[1].final_ms);
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_reset_call_stats());
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_stats(&stats));
+    TEST_ASSERT_EQUAL(0, stats.last_call_leg_count);
+    TEST_ASSERT_EQUAL(-1, stats.last_call_answered_leg);
+}
+
+void test_sip_manager_latency_histograms(void) {
+    call_latency_histograms_t histograms;
+    
+    // Not available before init
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, sip_manager_get_latency_histograms(&histograms));
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_manager_get_latency_histograms(NULL));
+    
+    call_latency_mark_at(CALL_LATENCY_BUTTON_EDGE, 1000000);
+    call_latency_mark_at(CALL_LATENCY_RINGING, 1250000);
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_latency_histograms(&histograms));
+    TEST_ASSERT_EQUAL(1, histograms.phase[CALL_LATENCY_RINGING].count);
+    TEST_ASSERT_EQUAL(250000, call_latency_percentile_us(&histograms.phase[CALL_LATENCY_RINGING], 50));
+    
+    // Cleared together with the call statistics
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_reset_call_stats());
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_latency_histograms(&histograms));
+    TEST_ASSERT_EQUAL(0, histograms.phase[CALL_LATENCY_RINGING].count);
+}
+
+void test_sip_manager_tcp_transport(void) {
+    sip_config_t config = test_config;
+    config.use_tcp = true;
+    config.keepalive_interval = 90;
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&config));
+    
+    mock_esp_sip_control_t *mock = mock_esp_sip_get_control();
+    TEST_ASSERT_EQUAL(ESP_SIP_TRANSPORT_TCP, mock->last_config.transport);
+    TEST_ASSERT_EQUAL(90, mock->last_config.keepalive_interval_sec);
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    
+    // Re-dialled connections are folded into the call statistics
+    mock->stats.reconnects = 2;
+    sip_call_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_stats(&stats));
+    TEST_ASSERT_EQUAL(2, stats.connection_reconnects);
+    mock->stats.reconnects = 3;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_stats(&stats));
+    TEST_ASSERT_EQUAL(3, stats.connection_reconnects);
+}
+
+void test_sip_manager_tls_transport(void) {
+    static const char ca_pem[] = "-----BEGIN CERTIFICATE-----\n";
+    sip_config_t config = test_config;
+    config.use_tcp = true;
+    config.use_tls = true;
+    config.tls_ca_pem = ca_pem;
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&config));
+    
+    mock_esp_sip_control_t *mock = mock_esp_sip_get_control();
+    TEST_ASSERT_EQUAL(ESP_SIP_TRANSPORT_TLS, mock->last_config.transport);
+    TEST_ASSERT_EQUAL_PTR(ca_pem, mock->last_config.tls_ca_pem);
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    
+    // One full handshake, then reconnects that resumed the session
+    mock->stats.tls_full_handshakes = 1;
+    mock->stats.tls_full_handshake_ms = 450;
+    mock->stats.tls_resumed_handshakes = 2;
+    mock->stats.tls_resumed_handshake_ms = 60;
+    sip_call_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_stats(&stats));
+    TEST_ASSERT_EQUAL(1, stats.tls_full_handshakes);
+    TEST_ASSERT_EQUAL(2, stats.tls_resumed_handshakes);
+    TEST_ASSERT_EQUAL(450, stats.tls_full_handshake_ms);
+    TEST_ASSERT_EQUAL(60, stats.tls_resumed_handshake_ms);
+    
+    mock->stats.tls_resumed_handshakes = 3;
+    mock->stats.tls_resumed_handshake_ms = 55;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_stats(&stats));
+    TEST_ASSERT_EQUAL(1, stats.tls_full_handshakes);
+    TEST_ASSERT_EQUAL(3, stats.tls_resumed_handshakes);
+    TEST_ASSERT_EQUAL(55, stats.tls_resumed_handshake_ms);
+}
+
+void test_sip_manager_registration_refresh_scheduled(void) {
+    // Registrar grants less than the 30 s requested in test_config
+    mock_esp_sip_get_control()->granted_expires = 600;
+    mock_esp_timer_set_time(1000000);
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    TEST_ASSERT_EQUAL(SIP_STATE_REGISTERED, sip_manager_get_state());
+    
+    sip_registration_info_t info;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_registration_info(&info));
+    TEST_ASSERT_EQUAL(600, info.granted_expires);
+    TEST_ASSERT_EQUAL(600, info.binding_remaining);
+    TEST_ASSERT_EQUAL(1, info.refreshes);
+    TEST_ASSERT_EQUAL(0, info.consecutive_failures);
+    
+    // 75% of the lifetime, up to 10% earlier
+    TEST_ASSERT_GREATER_OR_EQUAL(390000, info.next_attempt_ms);
+    TEST_ASSERT_LESS_OR_EQUAL(450000, info.next_attempt_ms);
+    
+    // Refresh completing mid-call keeps the call state
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start_call(NULL));
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_CALL_CONNECTED, NULL);
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_REGISTERED, NULL);
+    TEST_ASSERT_EQUAL(SIP_STATE_CONNECTED, sip_manager_get_state());
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_registration_info(&info));
+    TEST_ASSERT_EQUAL(2, info.refreshes);
+}
+
+void test_sip_manager_registration_refresh_config(void) {
+    test_config.registration_refresh_percent = 50;
+    test_config.registration_jitter_percent = 5;
+    mock_esp_sip_get_control()->granted_expires = 3600;
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    
+    sip_registration_info_t info;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_registration_info(&info));
+    TEST_ASSERT_GREATER_OR_EQUAL(1620000, info.next_attempt_ms);
+    TEST_ASSERT_LESS_OR_EQUAL(1800000, info.next_attempt_ms);
+    sip_manager_stop();
+    
+    // Never later than 32 s (Timer F) before the binding lapses
+    test_config.registration_refresh_percent = 100;
+    test_config.registration_jitter_percent = 1;
+    mock_esp_sip_get_control()->granted_expires = 600;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_registration_info(&info));
+    TEST_ASSERT_EQUAL(568000, info.next_attempt_ms);
+    sip_manager_stop();
+    
+    test_config.registration_refresh_percent = 101;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_manager_init(&test_config));
+}
+
+void test_sip_manager_registration_backoff(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    
+    sip_registration_info_t info;
+    for (uint32_t failures = 1; failures <= 5; failures++) {
+        mock_esp_sip_simulate_event(ESP_SIP_EVENT_REGISTRATION_FAILED, NULL);
+        TEST_ASSERT_EQUAL(SIP_STATE_ERROR, sip_manager_get_state());
+        TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_registration_info(&info));
+        TEST_ASSERT_EQUAL(failures, info.consecutive_failures);
+        
+        // 1 s doubling per failure, the upper half randomized
+        uint32_t backoff = 1000u << (failures - 1);
+        TEST_ASSERT_GREATER_OR_EQUAL(backoff / 2, info.next_attempt_ms);
+        TEST_ASSERT_LESS_OR_EQUAL(backoff, info.next_attempt_ms);
+    }
+    
+    // Capped at five minutes
+    for (int i = 0; i < 20; i++) {
+        mock_esp_sip_simulate_event(ESP_SIP_EVENT_REGISTRATION_FAILED, NULL);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_registration_info(&info));
+    TEST_ASSERT_GREATER_OR_EQUAL(150000, info.next_attempt_ms);
+    TEST_ASSERT_LESS_OR_EQUAL(300000, info.next_attempt_ms);
+    
+    // A successful retry clears the backoff
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_REGISTERED, NULL);
+    TEST_ASSERT_EQUAL(SIP_STATE_REGISTERED, sip_manager_get_state());
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_registration_info(&info));
+    TEST_ASSERT_EQUAL(0, info.consecutive_failures);
+    TEST_ASSERT_EQUAL(30, info.granted_expires);
+}
+
+void test_sip_manager_call_allowed_while_binding_valid(void) {
+    mock_esp_sip_get_control()->granted_expires = 600;
+    mock_esp_timer_set_time(1000000);
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    
+    // A failed call leaves the error state, the binding is still good
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start_call(NULL));
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_CALL_FAILED, NULL);
+    TEST_ASSERT_EQUAL(SIP_STATE_ERROR, sip_manager_get_state());
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start_call(NULL));
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_CALL_FAILED, NULL);
+    
+    // Once the binding has lapsed calls wait for a new registration
+    mock_esp_timer_advance_time(601000000);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, sip_manager_start_call(NULL));
+}
+
 void test_sip_manager_reset_call_statistics(void) {
     // Initialize and start
     TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
@@ -334,6 +582,47 @@ void test_sip_manager_reset_call_statistics(void) {
     TEST_ASSERT_EQUAL(0, stats.total_call_duration);
 }
 
+void test_sip_manager_call_quality_history(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_reset_call_stats());
+    
+    sip_call_quality_t history[SIP_CALL_HISTORY_SIZE + 1];
+    size_t count = 99;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_history(history, SIP_CALL_HISTORY_SIZE + 1, &count));
+    TEST_ASSERT_EQUAL(0, count);
+    
+    // More answered calls than the history holds, call n lasting n seconds; a failed one in between
+    mock_esp_timer_set_time(100 * 1000000LL);
+    for (int call = 1; call <= SIP_CALL_HISTORY_SIZE + 2; call++) {
+        TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start_call(NULL));
+        mock_esp_sip_simulate_event(ESP_SIP_EVENT_CALL_CONNECTED, NULL);
+        mock_esp_timer_advance_time(call * 1000000LL);
+        sip_manager_end_call();
+        if (call == 3) {
+            TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start_call(NULL));
+            mock_esp_sip_simulate_event(ESP_SIP_EVENT_CALL_FAILED, NULL);
+            mock_esp_sip_simulate_event(ESP_SIP_EVENT_REGISTERED, NULL);
+        }
+    }
+    
+    // The newest first, the two oldest gone
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_history(history, SIP_CALL_HISTORY_SIZE + 1, &count));
+    TEST_ASSERT_EQUAL(SIP_CALL_HISTORY_SIZE, count);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(SIP_CALL_HISTORY_SIZE + 2 - i, history[i].duration);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_history(history, 2, &count));
+    TEST_ASSERT_EQUAL(2, count);
+    TEST_ASSERT_EQUAL(SIP_CALL_HISTORY_SIZE + 1, history[1].duration);
+    
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_manager_get_call_history(NULL, 2, &count));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_manager_get_call_history(history, 2, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_reset_call_stats());
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_call_history(history, 2, &count));
+    TEST_ASSERT_EQUAL(0, count);
+}
+
 void test_sip_manager_call_timeout_handling(void) {
     // Initialize with short timeout
     sip_config_t timeout_config = test_config;
@@ -458,6 +747,104 @@ void test_sip_manager_dtmf_command_mapping_custom(void) {
     TEST_ASSERT_FALSE(dtmf_command_callback_called);
 }
 
+void test_sip_manager_dtmf_command_sequence(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
+    
+    // A PIN opens the door, a single digit still works alongside it
+    dtmf_command_mapping_t mappings[] = {
+        {'\0', DTMF_CMD_DOOR_OPEN, 3000, true, "*1234#"},
+        {'0', DTMF_CMD_HANGUP, 0, true},
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_configure_dtmf_commands(mappings, 2));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_set_dtmf_interdigit_timeout(2000));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_register_dtmf_command_callback(test_dtmf_command_callback, NULL));
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start_call(NULL));
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_CALL_CONNECTED, NULL);
+    
+    dtmf_command_callback_called = false;
+    const char *pin = "*1234";
+    for (const char *d = pin; *d != '\0'; d++) {
+        mock_esp_sip_simulate_dtmf(*d);
+    }
+    TEST_ASSERT_FALSE(dtmf_command_callback_called);
+    mock_esp_sip_simulate_dtmf('#');
+    TEST_ASSERT_TRUE(dtmf_command_callback_called);
+    TEST_ASSERT_EQUAL(DTMF_CMD_DOOR_OPEN, last_dtmf_command);
+    TEST_ASSERT_EQUAL(3000, last_dtmf_param);
+    
+    // A wrong PIN does nothing
+    dtmf_command_callback_called = false;
+    pin = "*1235#";
+    for (const char *d = pin; *d != '\0'; d++) {
+        mock_esp_sip_simulate_dtmf(*d);
+    }
+    TEST_ASSERT_FALSE(dtmf_command_callback_called);
+    mock_esp_sip_simulate_dtmf('0');
+    TEST_ASSERT_TRUE(dtmf_command_callback_called);
+    TEST_ASSERT_EQUAL(DTMF_CMD_HANGUP, last_dtmf_command);
+    
+    // Invalid and duplicate sequences are rejected
+    dtmf_command_mapping_t invalid[] = {
+        {'\0', DTMF_CMD_DOOR_OPEN, 0, true, "*12E#"},
+    };
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_manager_configure_dtmf_commands(invalid, 1));
+    dtmf_command_mapping_t duplicate[] = {
+        {'\0', DTMF_CMD_DOOR_OPEN, 0, true, "1"},
+        {'1', DTMF_CMD_HANGUP, 0, true},
+    };
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_manager_configure_dtmf_commands(duplicate, 2));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_manager_set_dtmf_interdigit_timeout(0));
+}
+
+static int event_notify_count;
+
+static void test_event_notify(void *user_data) {
+    event_notify_count++;
+}
+
+void test_sip_manager_event_queue(void) {
+    sip_event_data_t event;
+    sip_event_queue_stats_t before;
+    sip_event_queue_stats_t after;
+    
+    // Events left over from other tests
+    while (sip_manager_poll_event(&event)) {
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_event_stats(&before));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_manager_get_event_stats(NULL));
+    
+    event_notify_count = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_register_event_notify(test_event_notify, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start());
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_start_call(NULL));
+    mock_esp_sip_simulate_event(ESP_SIP_EVENT_CALL_CONNECTED, NULL);
+    mock_esp_sip_simulate_dtmf('7');
+    sip_manager_register_event_notify(NULL, NULL);
+    
+    // The consumer was woken for each event and finds them in order
+    int count = 0;
+    bool connected = false;
+    while (sip_manager_poll_event(&event)) {
+        count++;
+        if (event.event_type == SIP_EVENT_CALL_CONNECTED) {
+            connected = true;
+        } else if (event.event_type == SIP_EVENT_DTMF_RECEIVED) {
+            TEST_ASSERT_TRUE(connected);
+            TEST_ASSERT_EQUAL('7', event.data.dtmf.digit);
+        }
+    }
+    TEST_ASSERT_TRUE(connected);
+    TEST_ASSERT_EQUAL(event_notify_count, count);
+    TEST_ASSERT_EQUAL(SIP_EVENT_DTMF_RECEIVED, event.event_type);
+    
+    TEST_ASSERT_EQUAL(ESP_OK, sip_manager_get_event_stats(&after));
+    TEST_ASSERT_EQUAL(count, after.delivered - before.delivered);
+    TEST_ASSERT_EQUAL(before.dropped, after.dropped);
+}
+
 void test_sip_manager_dtmf_processing_disabled(void) {
     // Initialize
     TEST_ASSERT_EQUAL(ESP_OK, sip_manager_init(&test_config));
@@ -0,0 +1,152 @@
+#include "unity.h"
+#include "sip_message.h"
+#include <string.h>
+
+static sip_message_t msg;
+
+static const char s_invite_ok[] =
+    "SIP/2.0 200 OK\r\n"
+    "Via: SIP/2.0/UDP 192.168.1.50:5060;branch=z9hG4bK1234;rport=5060\r\n"
+    "From: <sip:doorstation@pbx.local>;tag=abc123\r\n"
+    "To: \"Resident\" <sip:resident@pbx.local;user=phone>;tag=xyz789\r\n"
+    "Call-ID: 5f3e2a1b9c\r\n"
+    "CSeq: 1 INVITE\r\n"
+    "Contact: <sip:resident@192.168.1.20:5062>\r\n"
+    "Content-Type: application/sdp\r\n"
+    "Content-Length: 9\r\n"
+    "\r\n"
+    "v=0\r\no=x\r\n";
+
+void setUp(void)
+{
+    memset(&msg, 0, sizeof(msg));
+}
+
+void tearDown(void)
+{
+}
+
+void test_sip_message_parse_response(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(s_invite_ok, strlen(s_invite_ok), &msg));
+
+    TEST_ASSERT_FALSE(msg.is_request);
+    TEST_ASSERT_EQUAL(200, msg.status_code);
+    TEST_ASSERT_TRUE(sip_span_equals(&msg, msg.reason, "OK"));
+    TEST_ASSERT_EQUAL(1, msg.cseq);
+    TEST_ASSERT_EQUAL(SIP_METHOD_INVITE, msg.cseq_method);
+    TEST_ASSERT_EQUAL(8, msg.header_count);
+
+    // Body is bounded by Content-Length, not by the end of the datagram
+    TEST_ASSERT_EQUAL(9, msg.body.len);
+    TEST_ASSERT_EQUAL_STRING_LEN("v=0\r\no=x\r", sip_span_ptr(&msg, msg.body), 9);
+}
+
+void test_sip_message_spans_point_into_buffer(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(s_invite_ok, strlen(s_invite_ok), &msg));
+
+    const sip_header_t *call_id = sip_message_get_header(&msg, SIP_HDR_CALL_ID);
+    TEST_ASSERT_NOT_NULL(call_id);
+
+    // Zero-copy: the span resolves to the original bytes of the datagram
+    const char *expected = strstr(s_invite_ok, "5f3e2a1b9c");
+    TEST_ASSERT_TRUE(sip_span_ptr(&msg, call_id->value) == expected);
+    TEST_ASSERT_TRUE(sip_span_equals(&msg, call_id->value, "5f3e2a1b9c"));
+}
+
+void test_sip_message_parse_request_compact_headers(void)
+{
+    static const char bye[] =
+        "BYE sip:doorstation@192.168.1.50:5060 SIP/2.0\r\n"
+        "v: SIP/2.0/UDP 192.168.1.20:5062;branch=z9hG4bKaaaa\r\n"
+        "v: SIP/2.0/UDP 192.168.1.1;branch=z9hG4bKbbbb\r\n"
+        "f: <sip:resident@pbx.local>;tag=xyz789\r\n"
+        "t: <sip:doorstation@pbx.local>;tag=abc123\r\n"
+        "i: 5f3e2a1b9c\r\n"
+        "CSeq: 2 BYE\r\n"
+        "l: 0\r\n"
+        "\r\n";
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(bye, strlen(bye), &msg));
+
+    TEST_ASSERT_TRUE(msg.is_request);
+    TEST_ASSERT_EQUAL(SIP_METHOD_BYE, msg.method);
+    TEST_ASSERT_TRUE(sip_span_equals(&msg, msg.request_uri, "sip:doorstation@192.168.1.50:5060"));
+    TEST_ASSERT_NOT_NULL(sip_message_get_header(&msg, SIP_HDR_FROM));
+    TEST_ASSERT_NOT_NULL(sip_message_get_header(&msg, SIP_HDR_TO));
+    TEST_ASSERT_NOT_NULL(sip_message_get_header(&msg, SIP_HDR_CALL_ID));
+    TEST_ASSERT_EQUAL(0, msg.body.len);
+
+    // First Via is the topmost one
+    const sip_header_t *via = sip_message_get_header(&msg, SIP_HDR_VIA);
+    sip_span_t branch;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_get_param(&msg, via->value, "branch", &branch));
+    TEST_ASSERT_TRUE(sip_span_equals(&msg, branch, "z9hG4bKaaaa"));
+}
+
+void test_sip_message_header_params_and_uri(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(s_invite_ok, strlen(s_invite_ok), &msg));
+
+    const sip_header_t *to = sip_message_get_header(&msg, SIP_HDR_TO);
+    sip_span_t tag;
+    sip_span_t user;
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_get_param(&msg, to->value, "tag", &tag));
+    TEST_ASSERT_TRUE(sip_span_equals(&msg, tag, "xyz789"));
+
+    // URI parameters inside <...> are not header parameters
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, sip_message_get_param(&msg, to->value, "user", &user));
+
+    sip_span_t uri = sip_message_get_uri(&msg, to->value);
+    TEST_ASSERT_TRUE(sip_span_equals(&msg, uri, "sip:resident@pbx.local;user=phone"));
+
+    char copy[16];
+    const sip_header_t *contact = sip_message_get_header(&msg, SIP_HDR_CONTACT);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE,
+                      sip_span_copy(&msg, sip_message_get_uri(&msg, contact->value), copy, sizeof(copy)));
+}
+
+void test_sip_message_folded_header(void)
+{
+    static const char folded[] =
+        "OPTIONS sip:doorstation@192.168.1.50 SIP/2.0\r\n"
+        "Via: SIP/2.0/UDP 192.168.1.1;branch=z9hG4bKcccc\r\n"
+        "Subject: first part\r\n"
+        "  second part\r\n"
+        "CSeq: 7 OPTIONS\r\n"
+        "\r\n";
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(folded, strlen(folded), &msg));
+    TEST_ASSERT_EQUAL(3, msg.header_count);
+    TEST_ASSERT_EQUAL(SIP_HDR_OTHER, msg.headers[1].id);
+    TEST_ASSERT_TRUE(sip_span_equals(&msg, msg.headers[1].value, "first part\r\n  second part"));
+    TEST_ASSERT_EQUAL(7, msg.cseq);
+    TEST_ASSERT_EQUAL(SIP_METHOD_OPTIONS, msg.cseq_method);
+}
+
+void test_sip_message_rejects_malformed(void)
+{
+    static const char no_version[] = "INVITE sip:x@y\r\n\r\n";
+    static const char bad_status[] = "SIP/2.0 99 Odd\r\n\r\n";
+    static const char no_blank_line[] = "SIP/2.0 200 OK\r\nCSeq: 1 INVITE\r\n";
+    static const char truncated_body[] = "SIP/2.0 200 OK\r\nContent-Length: 100\r\n\r\nv=0\r\n";
+    static const char no_colon[] = "SIP/2.0 200 OK\r\nBroken header\r\n\r\n";
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_message_parse(NULL, 10, &msg));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_message_parse(no_version, strlen(no_version), &msg));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_message_parse(bad_status, strlen(bad_status), &msg));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_message_parse(no_blank_line, strlen(no_blank_line), &msg));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, sip_message_parse(truncated_body, strlen(truncated_body), &msg));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_message_parse(no_colon, strlen(no_colon), &msg));
+}
+
+void test_sip_message_method_names(void)
+{
+    TEST_ASSERT_EQUAL(SIP_METHOD_CANCEL, sip_method_from_string("CANCEL", 6));
+    TEST_ASSERT_EQUAL(SIP_METHOD_UNKNOWN, sip_method_from_string("cancel", 6));
+    TEST_ASSERT_EQUAL(SIP_METHOD_UNKNOWN, sip_method_from_string("SUBSCRIBE", 9));
+    TEST_ASSERT_EQUAL_STRING("REGISTER", sip_method_name(SIP_METHOD_REGISTER));
+    TEST_ASSERT_EQUAL_STRING("UNKNOWN", sip_method_name((sip_method_t)99));
+}
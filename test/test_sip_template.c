@@ -0,0 +1,159 @@
+#include "unity.h"
+#include "sip_template.h"
+#include "sip_message.h"
+#include <string.h>
+
+static sip_template_t tpl;
+static char out[1024];
+static sip_message_t msg;
+
+static void compile_register(void)
+{
+    sip_template_begin(&tpl);
+    sip_template_append(&tpl, "REGISTER sip:%s SIP/2.0\r\n", "pbx.local");
+    sip_template_append(&tpl, "Via: SIP/2.0/UDP 192.168.1.50:5060;branch=");
+    sip_template_field(&tpl, SIP_TEMPLATE_FIELD_BRANCH, 12);
+    sip_template_append(&tpl, ";rport\r\n"
+                              "From: <sip:door@pbx.local>;tag=");
+    sip_template_field(&tpl, SIP_TEMPLATE_FIELD_TAG, 4);
+    sip_template_append(&tpl, "\r\nTo: <sip:door@pbx.local>\r\nCall-ID: ");
+    sip_template_field(&tpl, SIP_TEMPLATE_FIELD_CALL_ID, 6);
+    sip_template_append(&tpl, "\r\nCSeq: ");
+    sip_template_field(&tpl, SIP_TEMPLATE_FIELD_CSEQ, SIP_TEMPLATE_CSEQ_WIDTH);
+    sip_template_append(&tpl, " REGISTER\r\nExpires: ");
+    sip_template_field(&tpl, SIP_TEMPLATE_FIELD_EXPIRES, SIP_TEMPLATE_EXPIRES_WIDTH);
+    sip_template_append(&tpl, "\r\n");
+    TEST_ASSERT_EQUAL(ESP_OK, sip_template_end(&tpl));
+}
+
+void setUp(void)
+{
+    memset(out, 0, sizeof(out));
+    memset(&msg, 0, sizeof(msg));
+    compile_register();
+}
+
+void tearDown(void)
+{
+}
+
+void test_sip_template_render_patches_fields(void)
+{
+    sip_template_values_t values = {
+        .branch = "z9hG4bK00001",
+        .tag = "ab12",
+        .call_id = "cid001",
+        .cseq = 42,
+        .expires = 3600
+    };
+    size_t len = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_template_render(&tpl, &values, out, sizeof(out), &len));
+    TEST_ASSERT_EQUAL(tpl.len, len);
+
+    // The result must read back as an ordinary request
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(out, len, &msg));
+    TEST_ASSERT_EQUAL(SIP_METHOD_REGISTER, msg.method);
+    TEST_ASSERT_EQUAL(42, msg.cseq);
+    TEST_ASSERT_EQUAL(SIP_METHOD_REGISTER, msg.cseq_method);
+
+    const sip_header_t *via = sip_message_get_header(&msg, SIP_HDR_VIA);
+    sip_span_t branch;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_get_param(&msg, via->value, "branch", &branch));
+    TEST_ASSERT_TRUE(sip_span_equals(&msg, branch, "z9hG4bK00001"));
+
+    const sip_header_t *expires = sip_message_get_header(&msg, SIP_HDR_EXPIRES);
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_span_to_u32(&msg, expires->value, &value));
+    TEST_ASSERT_EQUAL(3600, value);
+
+    const sip_header_t *call_id = sip_message_get_header(&msg, SIP_HDR_CALL_ID);
+    TEST_ASSERT_TRUE(sip_span_equals(&msg, call_id->value, "cid001"));
+    TEST_ASSERT_EQUAL(0, msg.body.len);
+}
+
+void test_sip_template_rerender_overwrites_whole_slot(void)
+{
+    sip_template_values_t values = {
+        .branch = "z9hG4bK00001", .tag = "ab12", .call_id = "cid001",
+        .cseq = 1234567890, .expires = 3600
+    };
+    size_t len = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_template_render(&tpl, &values, out, sizeof(out), &len));
+    values.cseq = 7;
+    values.expires = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_template_render(&tpl, &values, out, sizeof(out), &len));
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(out, len, &msg));
+    TEST_ASSERT_EQUAL(7, msg.cseq);
+    TEST_ASSERT_NOT_NULL(strstr(out, "Expires:          0\r\n"));
+}
+
+void test_sip_template_auth_and_body(void)
+{
+    static const char auth[] = "Authorization: Digest username=\"door\", nonce=\"n\"\r\n";
+    static const char body[] = "v=0\r\n";
+    sip_template_values_t values = {
+        .branch = "z9hG4bK00002", .tag = "ab12", .call_id = "cid002",
+        .cseq = 2, .expires = 60,
+        .auth = auth,
+        .body = body, .body_len = strlen(body)
+    };
+    size_t len = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_template_render(&tpl, &values, out, sizeof(out), &len));
+    TEST_ASSERT_EQUAL(tpl.len + strlen(auth) + strlen(body), len);
+
+    // Auth lands right before Content-Length, whose slot shifted with it
+    TEST_ASSERT_NOT_NULL(strstr(out, auth));
+    TEST_ASSERT_NOT_NULL(strstr(out, "nonce=\"n\"\r\nContent-Length:     5\r\n\r\nv=0\r\n"));
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(out, len, &msg));
+    TEST_ASSERT_EQUAL(5, msg.body.len);
+}
+
+void test_sip_template_rejects_values_that_do_not_fit(void)
+{
+    sip_template_values_t values = {
+        .branch = "z9hG4bK1", .tag = "ab12", .call_id = "cid001",
+        .cseq = 1, .expires = 60
+    };
+    size_t len = 0;
+
+    // Strings must fill their slot exactly
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_template_render(&tpl, &values, out, sizeof(out), &len));
+    values.branch = NULL;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_template_render(&tpl, &values, out, sizeof(out), &len));
+
+    values.branch = "z9hG4bK00001";
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, sip_template_render(&tpl, &values, out, tpl.len - 1, &len));
+
+    // Numbers wider than their slot
+    sip_template_begin(&tpl);
+    sip_template_append(&tpl, "OPTIONS sip:x SIP/2.0\r\nCSeq: ");
+    sip_template_field(&tpl, SIP_TEMPLATE_FIELD_CSEQ, 2);
+    sip_template_append(&tpl, " OPTIONS\r\n");
+    TEST_ASSERT_EQUAL(ESP_OK, sip_template_end(&tpl));
+    values.cseq = 100;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_template_render(&tpl, &values, out, sizeof(out), &len));
+    values.cseq = 99;
+    TEST_ASSERT_EQUAL(ESP_OK, sip_template_render(&tpl, &values, out, sizeof(out), &len));
+}
+
+void test_sip_template_overflow_and_incomplete(void)
+{
+    char big[SIP_TEMPLATE_MAX_SIZE];
+    sip_template_values_t values = { 0 };
+    size_t len = 0;
+
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+
+    sip_template_begin(&tpl);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_template_render(&tpl, &values, out, sizeof(out), &len));
+
+    sip_template_append(&tpl, "%s", big);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, sip_template_end(&tpl));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_template_render(&tpl, &values, out, sizeof(out), &len));
+}
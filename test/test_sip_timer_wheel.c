@@ -0,0 +1,114 @@
+#include "unity.h"
+#include "sip_timer_wheel.h"
+#include <string.h>
+
+static sip_timer_wheel_t wheel;
+static uint32_t fired_at[4];
+static int fire_count;
+
+static void record_callback(sip_timer_t *timer, void *arg)
+{
+    if (fire_count < 4) {
+        fired_at[fire_count] = wheel.now;
+    }
+    fire_count++;
+}
+
+static void rearm_callback(sip_timer_t *timer, void *arg)
+{
+    fire_count++;
+    if (fire_count < 3) {
+        sip_timer_start(&wheel, timer, 5);
+    }
+}
+
+void setUp(void)
+{
+    sip_timer_wheel_init(&wheel, 1000);
+    memset(fired_at, 0, sizeof(fired_at));
+    fire_count = 0;
+}
+
+void tearDown(void)
+{
+}
+
+void test_sip_timer_wheel_fires_on_expiry_tick(void)
+{
+    sip_timer_t timer;
+    sip_timer_init(&timer, record_callback, NULL);
+    sip_timer_start(&wheel, &timer, 50);
+    TEST_ASSERT_TRUE(sip_timer_is_active(&timer));
+
+    sip_timer_wheel_advance(&wheel, 1049);
+    TEST_ASSERT_EQUAL(0, fire_count);
+
+    sip_timer_wheel_advance(&wheel, 1050);
+    TEST_ASSERT_EQUAL(1, fire_count);
+    TEST_ASSERT_EQUAL(1050, fired_at[0]);
+    TEST_ASSERT_FALSE(sip_timer_is_active(&timer));
+}
+
+void test_sip_timer_wheel_cascades_long_delays(void)
+{
+    sip_timer_t mid, far;
+    sip_timer_init(&mid, record_callback, NULL);
+    sip_timer_init(&far, record_callback, NULL);
+
+    // 32 s lands on level 1 (Timer B/F/H/J), 10 min on level 2
+    sip_timer_start(&wheel, &mid, sip_timer_ms_to_ticks(32000));
+    sip_timer_start(&wheel, &far, sip_timer_ms_to_ticks(600000));
+
+    sip_timer_wheel_advance(&wheel, 1000 + 3199);
+    TEST_ASSERT_EQUAL(0, fire_count);
+    sip_timer_wheel_advance(&wheel, 1000 + 3200);
+    TEST_ASSERT_EQUAL(1, fire_count);
+    TEST_ASSERT_EQUAL(1000 + 3200, fired_at[0]);
+
+    sip_timer_wheel_advance(&wheel, 1000 + 60000);
+    TEST_ASSERT_EQUAL(2, fire_count);
+    TEST_ASSERT_EQUAL(1000 + 60000, fired_at[1]);
+}
+
+void test_sip_timer_wheel_stop_and_restart(void)
+{
+    sip_timer_t a, b;
+    sip_timer_init(&a, record_callback, NULL);
+    sip_timer_init(&b, record_callback, NULL);
+
+    sip_timer_start(&wheel, &a, 10);
+    sip_timer_start(&wheel, &b, 10);
+    sip_timer_stop(&a);
+    sip_timer_stop(&a);  // Harmless when idle
+    TEST_ASSERT_FALSE(sip_timer_is_active(&a));
+
+    // Re-arming moves the timer instead of linking it twice
+    sip_timer_start(&wheel, &b, 20);
+    sip_timer_wheel_advance(&wheel, 1015);
+    TEST_ASSERT_EQUAL(0, fire_count);
+
+    sip_timer_wheel_advance(&wheel, 1020);
+    TEST_ASSERT_EQUAL(1, fire_count);
+}
+
+void test_sip_timer_wheel_callback_can_rearm(void)
+{
+    sip_timer_t timer;
+    sip_timer_init(&timer, rearm_callback, NULL);
+    sip_timer_start(&wheel, &timer, 5);
+
+    sip_timer_wheel_advance(&wheel, 1100);
+    TEST_ASSERT_EQUAL(3, fire_count);
+    TEST_ASSERT_FALSE(sip_timer_is_active(&timer));
+}
+
+void test_sip_timer_wheel_zero_delay_fires_next_tick(void)
+{
+    sip_timer_t timer;
+    sip_timer_init(&timer, record_callback, NULL);
+    sip_timer_start(&wheel, &timer, 0);
+
+    sip_timer_wheel_advance(&wheel, 1001);
+    TEST_ASSERT_EQUAL(1, fire_count);
+    TEST_ASSERT_EQUAL(1001, fired_at[0]);
+}
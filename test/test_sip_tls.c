@@ -0,0 +1,120 @@
+#include "unity.h"
+#include "sip_tls.h"
+#include "sip_transport.h"
+#include "lwip/sockets.h"
+#include <string.h>
+
+static sip_tls_t *tls;
+
+// Loopback listener standing in for a server that does not speak TLS
+static int listen_sock = -1;
+static int client_sock = -1;
+static int peer_sock = -1;
+
+static void connect_loopback(void)
+{
+    listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT_TRUE(listen_sock >= 0);
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+    TEST_ASSERT_EQUAL(0, bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)));
+    TEST_ASSERT_EQUAL(0, listen(listen_sock, 1));
+    socklen_t len = sizeof(addr);
+    getsockname(listen_sock, (struct sockaddr *)&addr, &len);
+
+    client_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT_EQUAL(0, connect(client_sock, (struct sockaddr *)&addr, sizeof(addr)));
+    peer_sock = accept(listen_sock, NULL, NULL);
+    TEST_ASSERT_TRUE(peer_sock >= 0);
+}
+
+static void close_sock(int *sock)
+{
+    if (*sock >= 0) {
+        close(*sock);
+        *sock = -1;
+    }
+}
+
+void setUp(void)
+{
+    tls = NULL;
+}
+
+void tearDown(void)
+{
+    sip_tls_destroy(tls);
+    tls = NULL;
+    close_sock(&listen_sock);
+    close_sock(&client_sock);
+    close_sock(&peer_sock);
+}
+
+void test_sip_tls_create_invalid_args(void)
+{
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_tls_create(NULL, NULL, &tls));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_tls_create("sip.example.com", NULL, NULL));
+    TEST_ASSERT_NULL(tls);
+
+    TEST_ASSERT_EQUAL(ESP_FAIL, sip_tls_create("sip.example.com", "not a certificate", &tls));
+    TEST_ASSERT_NULL(tls);
+
+    sip_tls_conn_t *conn = NULL;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_tls_handshake(NULL, 0, &conn));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_tls_write(NULL, "x", 1));
+    TEST_ASSERT_EQUAL(0, sip_tls_pending(NULL));
+    sip_tls_close(NULL);
+    sip_tls_destroy(NULL);
+}
+
+void test_sip_tls_create_without_ca(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, sip_tls_create("sip.example.com", NULL, &tls));
+    TEST_ASSERT_NOT_NULL(tls);
+
+    sip_tls_stats_t stats;
+    memset(&stats, 0xff, sizeof(stats));
+    sip_tls_get_stats(tls, &stats);
+    TEST_ASSERT_EQUAL(0, stats.full_handshakes);
+    TEST_ASSERT_EQUAL(0, stats.resumed_handshakes);
+    TEST_ASSERT_EQUAL(0, stats.failed_handshakes);
+}
+
+void test_sip_tls_handshake_fails_on_closed_peer(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, sip_tls_create("sip.example.com", NULL, &tls));
+    connect_loopback();
+
+    // The server hangs up instead of sending a ServerHello
+    close_sock(&peer_sock);
+
+    sip_tls_conn_t *conn = NULL;
+    TEST_ASSERT_EQUAL(ESP_FAIL, sip_tls_handshake(tls, client_sock, &conn));
+    TEST_ASSERT_NULL(conn);
+
+    sip_tls_stats_t stats;
+    sip_tls_get_stats(tls, &stats);
+    TEST_ASSERT_EQUAL(1, stats.failed_handshakes);
+    TEST_ASSERT_EQUAL(0, stats.full_handshakes);
+}
+
+void test_sip_tls_transport_rejects_mismatched_connection(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, sip_tls_create("sip.example.com", NULL, &tls));
+    connect_loopback();
+
+    sip_transport_t transport;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_transport_open_tls(&transport, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_open_tls(&transport, tls));
+    TEST_ASSERT_EQUAL(SIP_TRANSPORT_PROTO_TLS, transport.protocol);
+
+    // A plain TCP connection cannot become the connection of a TLS transport
+    sip_transport_conn_t conn = { .sock = client_sock, .tls = NULL };
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG,
+                      sip_transport_adopt(&transport, &conn, htonl(INADDR_LOOPBACK), 5061));
+    sip_transport_close(&transport);
+}
@@ -0,0 +1,256 @@
+#include "unity.h"
+#include "sip_transaction.h"
+#include <stdio.h>
+#include <string.h>
+
+static sip_transaction_layer_t layer;
+static int send_count;
+static char last_sent[256];
+static int timeout_count;
+static sip_method_t timeout_method;
+static int64_t now_ms;
+static char rx_buf[512];
+static sip_message_t msg;
+
+static esp_err_t capture_send(void *ctx, const char *data, size_t len)
+{
+    send_count++;
+    snprintf(last_sent, sizeof(last_sent), "%.*s", (int)len, data);
+    return ESP_OK;
+}
+
+static void capture_timeout(void *ctx, const sip_transaction_t *transaction)
+{
+    timeout_count++;
+    timeout_method = transaction->method;
+}
+
+static void advance_ms(int64_t ms)
+{
+    now_ms += ms;
+    sip_transaction_layer_tick(&layer, now_ms);
+}
+
+static const sip_message_t *parse_response(int code, const char *branch, const char *method)
+{
+    int n = snprintf(rx_buf, sizeof(rx_buf),
+                     "SIP/2.0 %d X\r\n"
+                     "Via: SIP/2.0/UDP 10.0.0.2:5060;branch=%s\r\n"
+                     "From: <sip:door@pbx>;tag=a\r\n"
+                     "To: <sip:res@pbx>;tag=b\r\n"
+                     "Call-ID: tx-test\r\n"
+                     "CSeq: 1 %s\r\n"
+                     "Content-Length: 0\r\n\r\n",
+                     code, branch, method);
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(rx_buf, (size_t)n, &msg));
+    return &msg;
+}
+
+static const sip_message_t *parse_request(const char *method, const char *branch)
+{
+    int n = snprintf(rx_buf, sizeof(rx_buf),
+                     "%s sip:door@10.0.0.2 SIP/2.0\r\n"
+                     "Via: SIP/2.0/UDP 10.0.0.1:5060;branch=%s\r\n"
+                     "From: <sip:res@pbx>;tag=b\r\n"
+                     "To: <sip:door@pbx>\r\n"
+                     "Call-ID: tx-server\r\n"
+                     "CSeq: 7 %s\r\n"
+                     "Content-Length: 0\r\n\r\n",
+                     method, branch, method);
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(rx_buf, (size_t)n, &msg));
+    return &msg;
+}
+
+void setUp(void)
+{
+    sip_transaction_user_t user = {
+        .send = capture_send,
+        .on_timeout = capture_timeout,
+        .ctx = NULL
+    };
+
+    now_ms = 100000;
+    send_count = 0;
+    timeout_count = 0;
+    last_sent[0] = '\0';
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transaction_layer_init(&layer, &user, now_ms));
+}
+
+void tearDown(void)
+{
+    sip_transaction_layer_reset(&layer);
+}
+
+void test_sip_transaction_invite_timer_a_doubles_until_timer_b(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transaction_client_start(&layer, SIP_METHOD_INVITE, "z9hG4bKa",
+                                                           1, "INVITE", 6, NULL));
+    TEST_ASSERT_EQUAL(1, send_count);
+
+    // Retransmissions at 0.5, 1.5, 3.5, 7.5, 15.5 and 31.5 s
+    advance_ms(499);
+    TEST_ASSERT_EQUAL(1, send_count);
+    advance_ms(1);
+    TEST_ASSERT_EQUAL(2, send_count);
+    advance_ms(1000);
+    TEST_ASSERT_EQUAL(3, send_count);
+    advance_ms(2000);
+    TEST_ASSERT_EQUAL(4, send_count);
+    advance_ms(28000);
+    TEST_ASSERT_EQUAL(7, send_count);
+    TEST_ASSERT_EQUAL(0, timeout_count);
+
+    // Timer B at 64 * T1
+    advance_ms(500);
+    TEST_ASSERT_EQUAL(1, timeout_count);
+    TEST_ASSERT_EQUAL(SIP_METHOD_INVITE, timeout_method);
+    TEST_ASSERT_EQUAL(0, sip_transaction_active_count(&layer));
+}
+
+void test_sip_transaction_provisional_stops_invite_retransmissions(void)
+{
+    sip_transaction_t *tx = NULL;
+    sip_transaction_client_start(&layer, SIP_METHOD_INVITE, "z9hG4bKb", 1, "INVITE", 6, &tx);
+
+    TEST_ASSERT_EQUAL(SIP_TRANSACTION_DELIVER,
+                      sip_transaction_client_receive(&layer, parse_response(180, "z9hG4bKb", "INVITE"), NULL));
+    TEST_ASSERT_EQUAL(SIP_TRANSACTION_STATE_PROCEEDING, tx->state);
+
+    advance_ms(60000);
+    TEST_ASSERT_EQUAL(1, send_count);
+    TEST_ASSERT_EQUAL(0, timeout_count);
+
+    // 2xx ends the transaction; its retransmissions no longer match
+    TEST_ASSERT_EQUAL(SIP_TRANSACTION_DELIVER,
+                      sip_transaction_client_receive(&layer, parse_response(200, "z9hG4bKb", "INVITE"), NULL));
+    TEST_ASSERT_EQUAL(SIP_TRANSACTION_NO_MATCH,
+                      sip_transaction_client_receive(&layer, parse_response(200, "z9hG4bKb", "INVITE"), NULL));
+}
+
+void test_sip_transaction_invite_failure_resends_ack_until_timer_d(void)
+{
+    sip_transaction_t *tx = NULL;
+    sip_transaction_client_start(&layer, SIP_METHOD_INVITE, "z9hG4bKc", 1, "INVITE", 6, &tx);
+
+    TEST_ASSERT_EQUAL(SIP_TRANSACTION_DELIVER,
+                      sip_transaction_client_receive(&layer, parse_response(486, "z9hG4bKc", "INVITE"), NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transaction_client_ack(&layer, tx, "ACK", 3));
+    TEST_ASSERT_EQUAL(2, send_count);
+    TEST_ASSERT_EQUAL_STRING("ACK", last_sent);
+
+    // A retransmitted 486 is absorbed and answered with the stored ACK
+    TEST_ASSERT_EQUAL(SIP_TRANSACTION_ABSORBED,
+                      sip_transaction_client_receive(&layer, parse_response(486, "z9hG4bKc", "INVITE"), NULL));
+    TEST_ASSERT_EQUAL(3, send_count);
+
+    // No INVITE retransmissions while Timer D runs
+    advance_ms(31990);
+    TEST_ASSERT_EQUAL(3, send_count);
+    TEST_ASSERT_EQUAL(1, sip_transaction_active_count(&layer));
+    advance_ms(10);
+    TEST_ASSERT_EQUAL(0, sip_transaction_active_count(&layer));
+    TEST_ASSERT_EQUAL(0, timeout_count);
+}
+
+void test_sip_transaction_non_invite_timer_e_caps_at_t2(void)
+{
+    sip_transaction_client_start(&layer, SIP_METHOD_REGISTER, "z9hG4bKd", 1, "REGISTER", 8, NULL);
+
+    // 0.5, 1.5, 3.5, 7.5 s then every 4 s
+    advance_ms(7500);
+    TEST_ASSERT_EQUAL(5, send_count);
+    advance_ms(3990);
+    TEST_ASSERT_EQUAL(5, send_count);
+    advance_ms(10);
+    TEST_ASSERT_EQUAL(6, send_count);
+
+    // Timer F
+    advance_ms(32000 - 11500);
+    TEST_ASSERT_EQUAL(1, timeout_count);
+    TEST_ASSERT_EQUAL(SIP_METHOD_REGISTER, timeout_method);
+}
+
+void test_sip_transaction_non_invite_final_lingers_for_timer_k(void)
+{
+    sip_transaction_client_start(&layer, SIP_METHOD_BYE, "z9hG4bKe", 1, "BYE", 3, NULL);
+
+    TEST_ASSERT_EQUAL(SIP_TRANSACTION_DELIVER,
+                      sip_transaction_client_receive(&layer, parse_response(200, "z9hG4bKe", "BYE"), NULL));
+    TEST_ASSERT_EQUAL(SIP_TRANSACTION_ABSORBED,
+                      sip_transaction_client_receive(&layer, parse_response(200, "z9hG4bKe", "BYE"), NULL));
+
+    advance_ms(SIP_TIMER_T4_MS);
+    TEST_ASSERT_EQUAL(0, sip_transaction_active_count(&layer));
+    TEST_ASSERT_EQUAL(1, send_count);
+}
+
+void test_sip_transaction_response_matches_method_and_branch(void)
+{
+    sip_transaction_client_start(&layer, SIP_METHOD_INVITE, "z9hG4bKf", 1, "INVITE", 6, NULL);
+    sip_transaction_client_start(&layer, SIP_METHOD_CANCEL, "z9hG4bKf", 1, "CANCEL", 6, NULL);
+
+    TEST_ASSERT_EQUAL(SIP_TRANSACTION_NO_MATCH,
+                      sip_transaction_client_receive(&layer, parse_response(200, "z9hG4bKother", "INVITE"), NULL));
+
+    sip_transaction_t *tx = NULL;
+    sip_transaction_client_receive(&layer, parse_response(200, "z9hG4bKf", "CANCEL"), &tx);
+    TEST_ASSERT_NOT_NULL(tx);
+    TEST_ASSERT_EQUAL(SIP_METHOD_CANCEL, tx->method);
+}
+
+void test_sip_transaction_server_absorbs_retransmitted_request(void)
+{
+    sip_transaction_t *tx = NULL;
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transaction_server_receive(&layer, parse_request("BYE", "z9hG4bKs1"), &tx));
+    TEST_ASSERT_NOT_NULL(tx);
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transaction_server_respond(&layer, tx, 200, "200 OK", 6));
+    TEST_ASSERT_EQUAL(1, send_count);
+
+    // Retransmitted BYE gets the stored 200 and never reaches the user
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transaction_server_receive(&layer, parse_request("BYE", "z9hG4bKs1"), &tx));
+    TEST_ASSERT_NULL(tx);
+    TEST_ASSERT_EQUAL(2, send_count);
+    TEST_ASSERT_EQUAL_STRING("200 OK", last_sent);
+
+    // Timer J
+    advance_ms(64 * SIP_TIMER_T1_MS);
+    TEST_ASSERT_EQUAL(0, sip_transaction_active_count(&layer));
+}
+
+void test_sip_transaction_server_invite_failure_waits_for_ack(void)
+{
+    sip_transaction_t *tx = NULL;
+
+    sip_transaction_server_receive(&layer, parse_request("INVITE", "z9hG4bKs2"), &tx);
+    TEST_ASSERT_NOT_NULL(tx);
+    sip_transaction_server_respond(&layer, tx, 486, "486 Busy", 8);
+    TEST_ASSERT_EQUAL(1, send_count);
+
+    // Timer G retransmits the 486 until the ACK arrives
+    advance_ms(SIP_TIMER_T1_MS);
+    TEST_ASSERT_EQUAL(2, send_count);
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transaction_server_receive(&layer, parse_request("ACK", "z9hG4bKs2"), &tx));
+    TEST_ASSERT_NULL(tx);
+    TEST_ASSERT_EQUAL(SIP_TRANSACTION_STATE_CONFIRMED, layer.pool[0].state);
+
+    advance_ms(SIP_TIMER_T4_MS);
+    TEST_ASSERT_EQUAL(2, send_count);
+    TEST_ASSERT_EQUAL(0, sip_transaction_active_count(&layer));
+}
+
+void test_sip_transaction_pool_exhaustion(void)
+{
+    char branch[16];
+
+    for (int i = 0; i < SIP_TRANSACTION_MAX; i++) {
+        snprintf(branch, sizeof(branch), "z9hG4bK%d", i);
+        TEST_ASSERT_EQUAL(ESP_OK, sip_transaction_client_start(&layer, SIP_METHOD_OPTIONS, branch,
+                                                               1, "OPTIONS", 7, NULL));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, sip_transaction_client_start(&layer, SIP_METHOD_OPTIONS, "z9hG4bKx",
+                                                                   1, "OPTIONS", 7, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_transaction_client_start(&layer, SIP_METHOD_ACK, "z9hG4bKy",
+                                                                        1, "ACK", 3, NULL));
+}
@@ -0,0 +1,277 @@
+#include "unity.h"
+#include "sip_transport.h"
+#include "sip_message.h"
+#include "lwip/sockets.h"
+#include <stdio.h>
+#include <string.h>
+
+// Local SIP stand-in: a plain UDP socket on loopback acting as registrar
+static int standin_sock = -1;
+static uint16_t standin_port;
+static sip_transport_t transport;
+static char rx_buf[SIP_TRANSPORT_MAX_MSG_SIZE + 1];
+
+// TCP stand-in: listening socket plus the connection accepted from the transport
+static int tcp_listen_sock = -1;
+static int tcp_peer_sock = -1;
+
+static void standin_open(void)
+{
+    standin_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    TEST_ASSERT_TRUE(standin_sock >= 0);
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+    TEST_ASSERT_EQUAL(0, bind(standin_sock, (struct sockaddr *)&addr, sizeof(addr)));
+
+    socklen_t len = sizeof(addr);
+    getsockname(standin_sock, (struct sockaddr *)&addr, &len);
+    standin_port = ntohs(addr.sin_port);
+}
+
+static int standin_recv(char *buf, size_t size, struct sockaddr_in *from)
+{
+    struct timeval tv = { .tv_sec = 1 };
+    setsockopt(standin_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    socklen_t from_len = sizeof(*from);
+    int n = recvfrom(standin_sock, buf, size - 1, 0, (struct sockaddr *)from, &from_len);
+    if (n > 0) {
+        buf[n] = '\0';
+    }
+    return n;
+}
+
+static uint16_t tcp_standin_listen(void)
+{
+    tcp_listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT_TRUE(tcp_listen_sock >= 0);
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+    TEST_ASSERT_EQUAL(0, bind(tcp_listen_sock, (struct sockaddr *)&addr, sizeof(addr)));
+    TEST_ASSERT_EQUAL(0, listen(tcp_listen_sock, 1));
+
+    socklen_t len = sizeof(addr);
+    getsockname(tcp_listen_sock, (struct sockaddr *)&addr, &len);
+    return ntohs(addr.sin_port);
+}
+
+static void tcp_standin_accept(void)
+{
+    tcp_peer_sock = accept(tcp_listen_sock, NULL, NULL);
+    TEST_ASSERT_TRUE(tcp_peer_sock >= 0);
+}
+
+void setUp(void)
+{
+    standin_open();
+    memset(&transport, 0, sizeof(transport));
+    transport.sock = -1;
+}
+
+void tearDown(void)
+{
+    sip_transport_close(&transport);
+    if (standin_sock >= 0) {
+        close(standin_sock);
+        standin_sock = -1;
+    }
+    if (tcp_peer_sock >= 0) {
+        close(tcp_peer_sock);
+        tcp_peer_sock = -1;
+    }
+    if (tcp_listen_sock >= 0) {
+        close(tcp_listen_sock);
+        tcp_listen_sock = -1;
+    }
+}
+
+void test_sip_transport_open_ephemeral_port(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_open(&transport, 0));
+    TEST_ASSERT_TRUE(transport.sock >= 0);
+    TEST_ASSERT_NOT_EQUAL(0, transport.local_port);
+}
+
+void test_sip_transport_connect_learns_local_address(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_open(&transport, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_connect(&transport, "127.0.0.1", standin_port));
+
+    TEST_ASSERT_EQUAL_STRING("127.0.0.1", transport.local_ip);
+    TEST_ASSERT_EQUAL(standin_port, transport.remote_port);
+}
+
+void test_sip_transport_invalid_args(void)
+{
+    size_t len = 0;
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_transport_open(NULL, 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_transport_connect(&transport, "127.0.0.1", 5060));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_transport_send(&transport, "x", 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_transport_recv(&transport, rx_buf, sizeof(rx_buf), 10, &len));
+}
+
+void test_sip_transport_recv_timeout(void)
+{
+    size_t len = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_open(&transport, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_connect(&transport, "127.0.0.1", standin_port));
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, sip_transport_recv(&transport, rx_buf, sizeof(rx_buf), 20, &len));
+}
+
+void test_sip_transport_register_exchange_with_standin(void)
+{
+    char request[512];
+    char standin_buf[SIP_TRANSPORT_MAX_MSG_SIZE + 1];
+    struct sockaddr_in client_addr;
+    sip_message_t msg;
+    size_t len = 0;
+
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_open(&transport, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_connect(&transport, "127.0.0.1", standin_port));
+
+    int n = snprintf(request, sizeof(request),
+                     "REGISTER sip:127.0.0.1 SIP/2.0\r\n"
+                     "Via: SIP/2.0/UDP %s:%u;branch=z9hG4bKloop1;rport\r\n"
+                     "From: <sip:doorstation@127.0.0.1>;tag=t1\r\n"
+                     "To: <sip:doorstation@127.0.0.1>\r\n"
+                     "Call-ID: loopback-1\r\n"
+                     "CSeq: 1 REGISTER\r\n"
+                     "Contact: <sip:doorstation@%s:%u>\r\n"
+                     "Expires: 300\r\n"
+                     "Content-Length: 0\r\n\r\n",
+                     transport.local_ip, transport.local_port,
+                     transport.local_ip, transport.local_port);
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_send(&transport, request, (size_t)n));
+
+    // Stand-in parses the REGISTER in place and answers from its spans
+    int received = standin_recv(standin_buf, sizeof(standin_buf), &client_addr);
+    TEST_ASSERT_GREATER_THAN(0, received);
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(standin_buf, (size_t)received, &msg));
+    TEST_ASSERT_EQUAL(SIP_METHOD_REGISTER, msg.method);
+
+    const sip_header_t *via = sip_message_get_header(&msg, SIP_HDR_VIA);
+    const sip_header_t *call_id = sip_message_get_header(&msg, SIP_HDR_CALL_ID);
+    TEST_ASSERT_NOT_NULL(via);
+    TEST_ASSERT_NOT_NULL(call_id);
+
+    char response[512];
+    n = snprintf(response, sizeof(response),
+                 "SIP/2.0 200 OK\r\n"
+                 "Via: %.*s\r\n"
+                 "From: <sip:doorstation@127.0.0.1>;tag=t1\r\n"
+                 "To: <sip:doorstation@127.0.0.1>;tag=reg\r\n"
+                 "Call-ID: %.*s\r\n"
+                 "CSeq: 1 REGISTER\r\n"
+                 "Contact: <sip:doorstation@%s:%u>;expires=300\r\n"
+                 "Content-Length: 0\r\n\r\n",
+                 via->value.len, sip_span_ptr(&msg, via->value),
+                 call_id->value.len, sip_span_ptr(&msg, call_id->value),
+                 transport.local_ip, transport.local_port);
+    sendto(standin_sock, response, (size_t)n, 0, (struct sockaddr *)&client_addr, sizeof(client_addr));
+
+    // Client side receives and parses the answer in its own buffer
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_recv(&transport, rx_buf, sizeof(rx_buf) - 1, 1000, &len));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(rx_buf, len, &msg));
+    TEST_ASSERT_FALSE(msg.is_request);
+    TEST_ASSERT_EQUAL(200, msg.status_code);
+    TEST_ASSERT_EQUAL(SIP_METHOD_REGISTER, msg.cseq_method);
+
+    call_id = sip_message_get_header(&msg, SIP_HDR_CALL_ID);
+    TEST_ASSERT_TRUE(sip_span_equals(&msg, call_id->value, "loopback-1"));
+}
+
+void test_sip_transport_tcp_frames_stream(void)
+{
+    static const char ringing[] =
+        "SIP/2.0 180 Ringing\r\n"
+        "CSeq: 1 INVITE\r\n"
+        "Content-Length: 0\r\n\r\n";
+    static const char answer[] =
+        "SIP/2.0 200 OK\r\n"
+        "CSeq: 1 INVITE\r\n"
+        "Content-Type: application/sdp\r\n"
+        "l: 5\r\n\r\n"
+        "v=0\r\n";
+    char big[SIP_TRANSPORT_MAX_MSG_SIZE + 200];
+    sip_message_t msg;
+    size_t len = 0;
+
+    uint16_t port = tcp_standin_listen();
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_open_tcp(&transport));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_connect(&transport, "127.0.0.1", port));
+    tcp_standin_accept();
+    TEST_ASSERT_EQUAL_STRING("127.0.0.1", transport.local_ip);
+    TEST_ASSERT_NOT_EQUAL(0, transport.local_port);
+
+    // A pong, a message larger than the caller's buffer, then two messages in one segment,
+    // the second one split mid-header
+    int big_len = snprintf(big, sizeof(big), "SIP/2.0 200 OK\r\nContent-Length: %d\r\n\r\n",
+                           SIP_TRANSPORT_MAX_MSG_SIZE);
+    memset(big + big_len, 'x', SIP_TRANSPORT_MAX_MSG_SIZE);
+    TEST_ASSERT_EQUAL(2, send(tcp_peer_sock, "\r\n", 2, 0));
+    TEST_ASSERT_EQUAL(big_len + SIP_TRANSPORT_MAX_MSG_SIZE,
+                      send(tcp_peer_sock, big, big_len + SIP_TRANSPORT_MAX_MSG_SIZE, 0));
+    char segment[sizeof(ringing) - 1 + 20];
+    memcpy(segment, ringing, sizeof(ringing) - 1);
+    memcpy(segment + sizeof(ringing) - 1, answer, 20);
+    TEST_ASSERT_EQUAL((int)sizeof(segment), send(tcp_peer_sock, segment, sizeof(segment), 0));
+
+    esp_err_t ret;
+    while ((ret = sip_transport_recv(&transport, rx_buf, sizeof(rx_buf) - 1, 200, &len)) == ESP_ERR_TIMEOUT) {
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, ret);
+    TEST_ASSERT_EQUAL(sizeof(ringing) - 1, len);
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(rx_buf, len, &msg));
+    TEST_ASSERT_EQUAL(180, msg.status_code);
+    TEST_ASSERT_EQUAL(1, transport.pongs);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, sip_transport_recv(&transport, rx_buf, sizeof(rx_buf) - 1, 50, &len));
+    TEST_ASSERT_EQUAL((int)sizeof(answer) - 1 - 20, send(tcp_peer_sock, answer + 20, sizeof(answer) - 1 - 20, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_recv(&transport, rx_buf, sizeof(rx_buf) - 1, 1000, &len));
+    TEST_ASSERT_EQUAL(sizeof(answer) - 1, len);
+    TEST_ASSERT_EQUAL(ESP_OK, sip_message_parse(rx_buf, len, &msg));
+    TEST_ASSERT_EQUAL(200, msg.status_code);
+    TEST_ASSERT_EQUAL(5, msg.body.len);
+}
+
+void test_sip_transport_tcp_keepalive_and_close(void)
+{
+    char ping[8];
+    size_t len = 0;
+
+    uint16_t port = tcp_standin_listen();
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_open_tcp(&transport));
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_connect(&transport, "127.0.0.1", port));
+    tcp_standin_accept();
+
+    // RFC 5626 ping out, pong back
+    TEST_ASSERT_EQUAL(ESP_OK, sip_transport_send_keepalive(&transport));
+    TEST_ASSERT_EQUAL(4, recv(tcp_peer_sock, ping, sizeof(ping), 0));
+    TEST_ASSERT_EQUAL_MEMORY("\r\n\r\n", ping, 4);
+    TEST_ASSERT_EQUAL(2, send(tcp_peer_sock, "\r\n", 2, 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, sip_transport_recv(&transport, rx_buf, sizeof(rx_buf) - 1, 200, &len));
+    TEST_ASSERT_EQUAL(1, transport.pongs);
+
+    // A closed connection is an error the caller re-dials on
+    close(tcp_peer_sock);
+    tcp_peer_sock = -1;
+    TEST_ASSERT_EQUAL(ESP_FAIL, sip_transport_recv(&transport, rx_buf, sizeof(rx_buf) - 1, 1000, &len));
+
+    // A refused dial leaves the transport closed but pointed at the server
+    close(tcp_listen_sock);
+    tcp_listen_sock = -1;
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, sip_transport_connect(&transport, "127.0.0.1", port));
+    TEST_ASSERT_EQUAL(-1, transport.sock);
+    TEST_ASSERT_EQUAL(port, transport.remote_port);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sip_transport_send_keepalive(NULL));
+}
@@ -0,0 +1,149 @@
+#include "unity.h"
+#include "vad.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VAD_TEST_RATE       8000
+#define VAD_TEST_FRAME      160     // 20 ms
+#define VAD_TEST_FRAMES     250     // 5 s
+#define VAD_LEARN_FRAMES    (VAD_BLOCKS * VAD_BLOCK_MS / 20)
+
+static vad_t vad;
+static int16_t frame[VAD_TEST_FRAME];
+static uint32_t noise_seed;
+static float lowpass_state;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(vad_init(&vad, VAD_TEST_RATE));
+    noise_seed = 12345;
+    lowpass_state = 0;
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief Uniform white noise with unit RMS
+ */
+static float white(void)
+{
+    noise_seed = noise_seed * 1103515245u + 12345u;
+    return ((float)(noise_seed >> 8) / (1 << 24) - 0.5f) * 2 * sqrtf(3.0f);
+}
+
+/**
+ * @brief Low-passed noise like traffic or wind, unit RMS
+ */
+static float rumble(void)
+{
+    lowpass_state = 0.7f * lowpass_state + 0.3f * white();
+    return lowpass_state * 2.38f;       // sqrt(1 - 0.7 * 0.7) / 0.3
+}
+
+/**
+ * @brief A frame of rumble at rms, with another component added by the caller
+ */
+static void make_frame(float rms, float hiss_rms, float voice_rms, int index)
+{
+    for (int i = 0; i < VAD_TEST_FRAME; i++) {
+        double t = (double)(index * VAD_TEST_FRAME + i) / VAD_TEST_RATE;
+        double voice = (sin(2 * M_PI * 140 * t) + 0.5 * sin(2 * M_PI * 280 * t) +
+                        0.25 * sin(2 * M_PI * 420 * t)) / 0.81;
+        // Alternating white samples: a hiss with most of its energy near 4 kHz
+        float hiss = white() * (i % 2 ? 1 : -1);
+        float sample = rms * rumble() + hiss_rms * hiss + voice_rms * (float)voice;
+        frame[i] = (int16_t)(sample > 32767 ? 32767 : sample < -32768 ? -32768 : sample);
+    }
+}
+
+static float dbov(float level)
+{
+    return 32767.0f * powf(10.0f, level / 20.0f);
+}
+
+void test_vad_rejects_bad_rate(void)
+{
+    TEST_ASSERT_FALSE(vad_init(&vad, 44100));
+    TEST_ASSERT_TRUE(vad_init(&vad, 16000));
+    TEST_ASSERT_EQUAL(VAD_HANGOVER_MS * 16, vad.hangover_samples);
+}
+
+void test_vad_steady_noise_is_silence(void)
+{
+    // All is speech while the noise is learned, then the hangover runs out
+    int speech = 0;
+    for (int f = 0; f < VAD_TEST_FRAMES; f++) {
+        make_frame(dbov(-45), 0, 0, f);
+        bool talking = vad_process(&vad, frame, VAD_TEST_FRAME);
+        if (f < VAD_LEARN_FRAMES) {
+            TEST_ASSERT_TRUE(talking);
+        } else {
+            speech += talking;
+        }
+    }
+    TEST_ASSERT_EQUAL(VAD_HANGOVER_MS / 20, speech);
+    // The comfort noise level carries the rumble
+    TEST_ASSERT_TRUE(abs(vad_noise_level(&vad) - 45) <= 1);
+
+    // Digital silence is silence too, and reported as such
+    TEST_ASSERT_TRUE(vad_init(&vad, VAD_TEST_RATE));
+    memset(frame, 0, sizeof(frame));
+    for (int f = 0; f < 2 * VAD_LEARN_FRAMES; f++) {
+        speech = vad_process(&vad, frame, VAD_TEST_FRAME);
+    }
+    TEST_ASSERT_FALSE(speech);
+    TEST_ASSERT_EQUAL(VAD_MAX_LEVEL, vad_noise_level(&vad));
+}
+
+void test_vad_talkspurt_with_hangover(void)
+{
+    const int hangover_frames = VAD_HANGOVER_MS / 20;
+
+    // A visitor talking from the first frame on is not taken for the noise;
+    // later 1 s of a voice 20 dB above the rumble
+    for (int f = 0; f < 250; f++) {
+        bool talking = f < 50 || (f >= 150 && f < 200);
+        make_frame(dbov(-45), 0, talking ? dbov(-25) : 0, f);
+        bool speech = vad_process(&vad, frame, VAD_TEST_FRAME);
+        if (talking || f < VAD_LEARN_FRAMES + hangover_frames || (f >= 200 && f < 200 + hangover_frames)) {
+            TEST_ASSERT_TRUE(speech);
+        } else {
+            TEST_ASSERT_FALSE(speech);
+        }
+    }
+    TEST_ASSERT_EQUAL(VAD_LEARN_FRAMES + hangover_frames + 50 + hangover_frames, vad.speech_frames);
+    // The voice did not leak into the noise estimate
+    TEST_ASSERT_TRUE(abs(vad_noise_level(&vad) - 45) <= 1);
+}
+
+void test_vad_quiet_hiss_found_by_zero_crossings(void)
+{
+    for (int f = 0; f < 100; f++) {
+        make_frame(dbov(-45), 0, 0, f);
+        vad_process(&vad, frame, VAD_TEST_FRAME);
+    }
+    TEST_ASSERT_FALSE(vad.speech);
+
+    // More rumble, 6 dB up, is still noise: only louder than the hiss threshold
+    int speech = 0;
+    for (int f = 100; f < 110; f++) {
+        make_frame(dbov(-39), 0, 0, f);
+        speech += vad_process(&vad, frame, VAD_TEST_FRAME);
+    }
+    TEST_ASSERT_EQUAL(0, speech);
+    for (int f = 110; f < 150; f++) {
+        make_frame(dbov(-45), 0, 0, f);
+        vad_process(&vad, frame, VAD_TEST_FRAME);
+    }
+
+    // An /s/ adding the same energy is speech, told apart by its zero crossings
+    speech = 0;
+    for (int f = 150; f < 160; f++) {
+        make_frame(dbov(-45), dbov(-40.3f), 0, f);
+        speech += vad_process(&vad, frame, VAD_TEST_FRAME);
+    }
+    TEST_ASSERT_EQUAL(10, speech);
+}
@@ -0,0 +1,222 @@
+/*
+ * Host benchmark of the echo canceller: ERLE on a recorded far-end and
+ * microphone pair, and the cost per 10 ms frame.
+ *
+ * Build and run on Linux from the repository root:
+ *
+ *   gcc -O2 -Imain -o aec_bench tools/aec_bench.c main/echo_canceller.c -lm
+ *   ./aec_bench [far.wav mic.wav [out.wav]]
+ *
+ * Both recordings are 16-bit mono WAV at 8 or 16 kHz, sample-aligned: far
+ * is what the speaker played, mic what the microphone picked up at the
+ * same time. Without them a noise far end through a synthetic 15 ms echo
+ * path is generated. The residual is written to out.wav. Cycles are read
+ * from the time stamp counter on x86 and are only a relative measure for
+ * the ESP32-S3.
+ */
+#include "echo_canceller.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#endif
+
+#define BENCH_FRAME_MS      10
+#define BENCH_MAX_SAMPLES   (16000 * 120)
+
+static int16_t s_far[BENCH_MAX_SAMPLES];
+static int16_t s_mic[BENCH_MAX_SAMPLES];
+static int16_t s_out[BENCH_MAX_SAMPLES];
+static echo_canceller_t s_aec;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t read_le(const uint8_t *p, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Load a 16-bit mono WAV file
+ *
+ * @return Samples read, 0 on error
+ */
+static size_t read_wav(const char *path, int16_t *pcm, uint32_t *rate)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        perror(path);
+        return 0;
+    }
+    uint8_t header[12];
+    uint8_t chunk[8];
+    size_t samples = 0;
+    bool format_ok = false;
+
+    if (fread(header, 1, sizeof(header), in) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        fclose(in);
+        return 0;
+    }
+    while (fread(chunk, 1, sizeof(chunk), in) == sizeof(chunk)) {
+        uint32_t size = read_le(chunk + 4, 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < sizeof(fmt) || fread(fmt, 1, sizeof(fmt), in) != sizeof(fmt)) {
+                break;
+            }
+            fseek(in, (long)(size - sizeof(fmt) + (size & 1)), SEEK_CUR);
+            *rate = read_le(fmt + 4, 4);
+            format_ok = read_le(fmt, 2) == 1 && read_le(fmt + 2, 2) == 1 && read_le(fmt + 14, 2) == 16;
+        } else if (memcmp(chunk, "data", 4) == 0 && format_ok) {
+            size_t wanted = size / sizeof(int16_t);
+            samples = fread(pcm, sizeof(int16_t), wanted < BENCH_MAX_SAMPLES ? wanted : BENCH_MAX_SAMPLES, in);
+            break;
+        } else {
+            fseek(in, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    fclose(in);
+    if (!format_ok) {
+        fprintf(stderr, "%s: not 16-bit mono PCM\n", path);
+    }
+    return samples;
+}
+
+static void write_wav(const char *path, const int16_t *pcm, size_t samples, uint32_t rate)
+{
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        perror(path);
+        return;
+    }
+    uint32_t data = (uint32_t)(samples * sizeof(int16_t));
+    uint8_t header[44] = "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\0\0\0\0\0\0\0\0\x02\0\x10\0data";
+    uint32_t fields[][2] = { { 4, 36 + data }, { 24, rate }, { 28, rate * 2 }, { 40, data } };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        for (int b = 0; b < 4; b++) {
+            header[fields[i][0] + b] = (uint8_t)(fields[i][1] >> (8 * b));
+        }
+    }
+    fwrite(header, 1, sizeof(header), out);
+    fwrite(pcm, sizeof(int16_t), samples, out);
+    fclose(out);
+}
+
+static size_t generate(uint32_t rate)
+{
+    // Direct sound after 3 ms and two reflections, scaled to the rate
+    static const struct {
+        float ms;
+        float gain;
+    } path[] = { { 3.0f, 0.4f }, { 3.125f, -0.2f }, { 7.5f, 0.15f }, { 13.75f, -0.05f } };
+    size_t n = rate * 10;
+
+    srand(1);
+    for (size_t i = 0; i < n; i++) {
+        s_far[i] = (int16_t)(rand() % 16001 - 8000);
+    }
+    for (size_t i = 0; i < n; i++) {
+        float echo = 0;
+        for (size_t j = 0; j < sizeof(path) / sizeof(path[0]); j++) {
+            size_t lag = (size_t)(path[j].ms * rate / 1000);
+            echo += i >= lag ? path[j].gain * s_far[i - lag] : 0;
+        }
+        s_mic[i] = (int16_t)(echo + rand() % 65 - 32);
+    }
+    return n;
+}
+
+static double erle_db(size_t from, size_t to)
+{
+    double in = 0;
+    double residual = 0;
+    for (size_t i = from; i < to; i++) {
+        in += (double)s_mic[i] * s_mic[i];
+        residual += (double)s_out[i] * s_out[i];
+    }
+    return residual > 0 ? 10 * log10(in / residual) : INFINITY;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t rate = 8000;
+    size_t samples;
+
+    if (argc > 2) {
+        uint32_t mic_rate = 0;
+        size_t far_samples = read_wav(argv[1], s_far, &rate);
+        samples = read_wav(argv[2], s_mic, &mic_rate);
+        if (far_samples == 0 || samples == 0 || mic_rate != rate) {
+            fprintf(stderr, "need two 16-bit mono WAV files at the same rate\n");
+            return 1;
+        }
+        samples = far_samples < samples ? far_samples : samples;
+    } else {
+        samples = generate(rate);
+    }
+    if (!echo_canceller_init(&s_aec, rate)) {
+        fprintf(stderr, "unsupported rate %u\n", (unsigned)rate);
+        return 1;
+    }
+
+    size_t frame = rate * BENCH_FRAME_MS / 1000;
+    unsigned long frames = 0;
+    double total_ns = 0;
+    double worst_ns = 0;
+#ifdef HAVE_CYCLES
+    unsigned long long total_cycles = 0;
+    unsigned long long worst_cycles = 0;
+#endif
+
+    samples -= samples % frame;
+    for (size_t i = 0; i < samples; i += frame) {
+        double t0 = now_ns();
+#ifdef HAVE_CYCLES
+        unsigned long long c0 = __rdtsc();
+#endif
+        echo_canceller_far_end(&s_aec, s_far + i, frame);
+        echo_canceller_process(&s_aec, s_mic + i, s_out + i, frame);
+#ifdef HAVE_CYCLES
+        unsigned long long cycles = __rdtsc() - c0;
+        total_cycles += cycles;
+        worst_cycles = cycles > worst_cycles ? cycles : worst_cycles;
+#endif
+        double ns = now_ns() - t0;
+        total_ns += ns;
+        worst_ns = ns > worst_ns ? ns : worst_ns;
+        frames++;
+    }
+    if (frames == 0) {
+        fprintf(stderr, "no samples\n");
+        return 1;
+    }
+    if (argc > 3) {
+        write_wav(argv[3], s_out, samples, rate);
+    }
+
+    printf("%lu frames of %d ms at %u Hz, %u taps\n", frames, BENCH_FRAME_MS, (unsigned)rate,
+           (unsigned)s_aec.tap_count);
+    printf("ERLE %.1f dB overall, %.1f dB in the second half, %.1f dB while the far end talked\n",
+           erle_db(0, samples), erle_db(samples / 2, samples), echo_canceller_erle_db(&s_aec));
+    printf("double talk %.1f%% of the samples\n", 100.0 * s_aec.double_talk / samples);
+    printf("%.0f ns/frame average, %.0f ns worst\n", total_ns / frames, worst_ns);
+#ifdef HAVE_CYCLES
+    printf("%llu cycles/frame average, %llu worst\n", total_cycles / frames, worst_cycles);
+#endif
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Host benchmark of the gain control: AGC and limiter on a WAV recording,
+ * the gain over time and the cost per 20 ms frame.
+ *
+ * Build and run on Linux from the repository root:
+ *
+ *   gcc -O2 -Imain -o agc_bench tools/agc_bench.c main/agc.c -lm
+ *   ./agc_bench [-t target_dbfs] [-g max_gain_db] [in.wav [out.wav]]
+ *
+ * The recording is 16-bit mono WAV at 8 or 16 kHz. Without one, a
+ * visitor is generated who starts two metres from the panel, steps
+ * closer every two seconds and finally shouts. The defaults are those of
+ * the microphone path. out.wav is aligned with in.wav, the look-ahead
+ * removed. Cycles are read from the time stamp counter on x86 and are
+ * only a relative measure for the ESP32-S3.
+ */
+#include "agc.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#endif
+
+#define BENCH_FRAME_MS      20
+#define BENCH_REPORT_MS     500
+#define BENCH_MAX_SAMPLES   (16000 * 120)
+
+static int16_t s_in[BENCH_MAX_SAMPLES];
+static int16_t s_out[BENCH_MAX_SAMPLES];
+static agc_t s_agc;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t read_le(const uint8_t *p, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Load a 16-bit mono WAV file
+ *
+ * @return Samples read, 0 on error
+ */
+static size_t read_wav(const char *path, int16_t *pcm, uint32_t *rate)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        perror(path);
+        return 0;
+    }
+    uint8_t header[12];
+    uint8_t chunk[8];
+    size_t samples = 0;
+    bool format_ok = false;
+
+    if (fread(header, 1, sizeof(header), in) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        fclose(in);
+        return 0;
+    }
+    while (fread(chunk, 1, sizeof(chunk), in) == sizeof(chunk)) {
+        uint32_t size = read_le(chunk + 4, 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < sizeof(fmt) || fread(fmt, 1, sizeof(fmt), in) != sizeof(fmt)) {
+                break;
+            }
+            fseek(in, (long)(size - sizeof(fmt) + (size & 1)), SEEK_CUR);
+            *rate = read_le(fmt + 4, 4);
+            format_ok = read_le(fmt, 2) == 1 && read_le(fmt + 2, 2) == 1 && read_le(fmt + 14, 2) == 16;
+        } else if (memcmp(chunk, "data", 4) == 0 && format_ok) {
+            size_t wanted = size / sizeof(int16_t);
+            samples = fread(pcm, sizeof(int16_t), wanted < BENCH_MAX_SAMPLES ? wanted : BENCH_MAX_SAMPLES, in);
+            break;
+        } else {
+            fseek(in, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    fclose(in);
+    if (!format_ok) {
+        fprintf(stderr, "%s: not 16-bit mono PCM\n", path);
+    }
+    return samples;
+}
+
+static void write_wav(const char *path, const int16_t *pcm, size_t samples, uint32_t rate)
+{
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        perror(path);
+        return;
+    }
+    uint32_t data = (uint32_t)(samples * sizeof(int16_t));
+    uint8_t header[44] = "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\0\0\0\0\0\0\0\0\x02\0\x10\0data";
+    uint32_t fields[][2] = { { 4, 36 + data }, { 24, rate }, { 28, rate * 2 }, { 40, data } };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        for (int b = 0; b < 4; b++) {
+            header[fields[i][0] + b] = (uint8_t)(fields[i][1] >> (8 * b));
+        }
+    }
+    fwrite(header, 1, sizeof(header), out);
+    fwrite(pcm, sizeof(int16_t), samples, out);
+    fclose(out);
+}
+
+/**
+ * @brief Voiced syllables, louder every two seconds, then a shout
+ */
+static size_t generate(uint32_t rate)
+{
+    static const float levels_dbfs[] = { -42, -34, -26, -18, -10, -3 };
+    size_t n = rate * 2 * (sizeof(levels_dbfs) / sizeof(levels_dbfs[0]));
+
+    srand(1);
+    for (size_t i = 0; i < n; i++) {
+        float t = (float)i / rate;
+        float amplitude = 32767.0f * powf(10, levels_dbfs[i / (2 * rate)] / 20) * 1.5f;
+        float pitch = 120 + 30 * sinf(2 * (float)M_PI * 0.7f * t);
+        float syllable = fmodf(t, 0.25f) < 0.18f ? sinf((float)M_PI * fmodf(t, 0.25f) / 0.18f) : 0;
+        float voice = sinf(2 * (float)M_PI * pitch * t) + 0.5f * sinf(4 * (float)M_PI * pitch * t);
+        s_in[i] = (int16_t)(amplitude * syllable * voice / 1.3f + rand() % 21 - 10);
+    }
+    return n;
+}
+
+static double rms_dbfs(const int16_t *pcm, size_t from, size_t to)
+{
+    double energy = 1;
+    for (size_t i = from; i < to; i++) {
+        energy += (double)pcm[i] * pcm[i];
+    }
+    return 10 * log10(energy / (to - from) / (32767.0 * 32767.0));
+}
+
+int main(int argc, char **argv)
+{
+    int target_dbfs = -18;
+    int max_gain_db = 24;
+    uint32_t rate = 8000;
+    size_t samples;
+
+    while (argc > 2 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-t") == 0) {
+            target_dbfs = atoi(argv[2]);
+        } else if (strcmp(argv[1], "-g") == 0) {
+            max_gain_db = atoi(argv[2]);
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[1]);
+            return 1;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc > 1) {
+        samples = read_wav(argv[1], s_in, &rate);
+        if (samples == 0) {
+            return 1;
+        }
+    } else {
+        samples = generate(rate);
+    }
+    if (!agc_init(&s_agc, rate, target_dbfs, max_gain_db)) {
+        fprintf(stderr, "unsupported rate %u, target %d or gain %d\n", (unsigned)rate, target_dbfs, max_gain_db);
+        return 1;
+    }
+
+    size_t frame = rate * BENCH_FRAME_MS / 1000;
+    size_t report = rate * BENCH_REPORT_MS / 1000;
+    size_t delay = s_agc.lookahead;
+    unsigned long frames = 0;
+    double total_ns = 0;
+    double worst_ns = 0;
+#ifdef HAVE_CYCLES
+    unsigned long long total_cycles = 0;
+    unsigned long long worst_cycles = 0;
+#endif
+
+    samples -= samples % frame;
+    memcpy(s_out, s_in, samples * sizeof(int16_t));
+    printf("  time   in dBFS  out dBFS  gain dB  limited ms\n");
+    for (size_t i = 0; i < samples; i += frame) {
+        double t0 = now_ns();
+#ifdef HAVE_CYCLES
+        unsigned long long c0 = __rdtsc();
+#endif
+        agc_process(&s_agc, s_out + i, frame);
+#ifdef HAVE_CYCLES
+        unsigned long long cycles = __rdtsc() - c0;
+        total_cycles += cycles;
+        worst_cycles = cycles > worst_cycles ? cycles : worst_cycles;
+#endif
+        double ns = now_ns() - t0;
+        total_ns += ns;
+        worst_ns = ns > worst_ns ? ns : worst_ns;
+        frames++;
+
+        size_t done = i + frame;
+        if (done % report == 0 && done > delay) {
+            printf("%6.1fs  %8.1f  %8.1f  %7d  %10u\n", (double)done / rate, rms_dbfs(s_in, done - report, done - delay),
+                   rms_dbfs(s_out, done - report + delay, done), agc_gain_db(&s_agc),
+                   (unsigned)(s_agc.limited * 1000 / rate));
+        }
+    }
+    if (frames == 0 || samples <= delay) {
+        fprintf(stderr, "no samples\n");
+        return 1;
+    }
+    // Line the output up with the input
+    samples -= delay;
+    memmove(s_out, s_out + delay, samples * sizeof(int16_t));
+    if (argc > 2) {
+        write_wav(argv[2], s_out, samples, rate);
+    }
+
+    printf("%lu frames of %d ms at %u Hz, target %d dBFS, gain up to %d dB\n", frames, BENCH_FRAME_MS,
+           (unsigned)rate, target_dbfs, max_gain_db);
+    printf("%.0f ns/frame average, %.0f ns worst\n", total_ns / frames, worst_ns);
+#ifdef HAVE_CYCLES
+    printf("%llu cycles/frame average, %llu worst\n", total_cycles / frames, worst_cycles);
+#endif
+    return 0;
+}
@@ -0,0 +1,327 @@
+/*
+ * Host benchmark of the whole audio chain: a stand-in for the I2S task
+ * moves raw PCM between files or pipes and the capture and playback
+ * rings, while a second thread runs what the RTP task runs on each
+ * frame, in the ring slots: echo canceller, noise suppressor, AGC,
+ * encoder and RTP header, then the packet looped back through decoder
+ * and speaker AGC into the playback ring.
+ *
+ * Build and run on Linux from the repository root:
+ *
+ *   gcc -O2 -pthread -Imain -o audio_chain_bench tools/audio_chain_bench.c \
+ *       main/audio_ring.c main/echo_canceller.c main/noise_suppressor.c main/agc.c \
+ *       main/g711.c main/g722.c main/rtp_packet.c -lm
+ *   ./audio_chain_bench [-w] [-n level_db] [-p period_ms] in.raw|- [out.raw|-]
+ *
+ * in.raw is 16-bit little-endian mono PCM, 8 kHz or with -w 16 kHz and
+ * G.722; "-" reads from a pipe, e.g. "arecord -t raw -f S16_LE -r 8000 -".
+ * Both threads tick every period_ms, 20 by default as on the panel; a
+ * shorter period runs faster than real time. Reported are the
+ * mouth-to-network latency, from the capture time stamp of a frame to
+ * its packet being ready to send, the cost of each stage and the ring
+ * counters.
+ */
+#include "agc.h"
+#include "audio_ring.h"
+#include "echo_canceller.h"
+#include "g711.h"
+#include "g722.h"
+#include "noise_suppressor.h"
+#include "rtp_packet.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_FRAME_MS          20
+#define BENCH_CAPTURE_TARGET    (-18)
+#define BENCH_CAPTURE_GAIN      24
+#define BENCH_PLAYOUT_TARGET    (-15)
+#define BENCH_PLAYOUT_GAIN      12
+// Frames the chain keeps running after the input ends, to drain the rings
+#define BENCH_DRAIN_FRAMES      (AUDIO_RING_FRAMES + 2)
+
+enum { STAGE_ECHO, STAGE_NOISE, STAGE_GAIN, STAGE_ENCODE, STAGE_DECODE, STAGE_COUNT };
+static const char *const s_stage_names[STAGE_COUNT] = { "echo", "noise", "agc", "encode", "decode+agc" };
+
+static struct {
+    audio_ring_t capture;
+    audio_ring_t playback;
+    FILE *in;
+    FILE *out;
+    bool wideband;
+    uint16_t frame_samples;
+    long period_ns;
+    volatile bool input_done;
+    volatile bool running;
+    int16_t scratch[AUDIO_RING_MAX_FRAME_SAMPLES];
+} s_bench;
+
+// Chain state, only touched by the chain thread
+static echo_canceller_t s_echo;
+static noise_suppressor_t s_noise;
+static agc_t s_capture_agc;
+static agc_t s_playout_agc;
+static g722_state_t s_encoder;
+static g722_state_t s_decoder;
+static rtp_sender_t s_sender;
+static uint8_t s_packet[RTP_HEADER_SIZE + AUDIO_RING_MAX_FRAME_SAMPLES];
+static double s_stage_ns[STAGE_COUNT];
+static double s_latency_sum_us;
+static double s_latency_max_us;
+static uint32_t s_frames;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Sleep until the next tick of a thread's own period
+ */
+static void wait_period(struct timespec *next)
+{
+    next->tv_nsec += s_bench.period_ns;
+    while (next->tv_nsec >= 1000000000L) {
+        next->tv_nsec -= 1000000000L;
+        next->tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, next, NULL);
+}
+
+/**
+ * @brief Stand-in for the I2S task: one frame in and one frame out per tick
+ */
+static void *device_thread(void *arg)
+{
+    (void)arg;
+    const size_t frame = s_bench.frame_samples;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (s_bench.running) {
+        // The file is read straight into the ring slot, as the driver copies its DMA buffer
+        int16_t *slot = audio_ring_write_begin(&s_bench.capture);
+        int16_t *pcm = slot != NULL ? slot : s_bench.scratch;
+        if (!s_bench.input_done) {
+            size_t got = fread(pcm, sizeof(int16_t), frame, s_bench.in);
+            if (got < frame) {
+                memset(pcm + got, 0, (frame - got) * sizeof(int16_t));
+                s_bench.input_done = true;
+            }
+            if (slot != NULL && got > 0) {
+                // Stamped with the frame's first sample, one tick ago
+                audio_ring_write_end(&s_bench.capture, now_us() - s_bench.period_ns / 1000);
+            }
+        }
+
+        const int16_t *play = audio_ring_read_begin(&s_bench.playback, NULL);
+        if (play == NULL) {
+            memset(s_bench.scratch, 0, frame * sizeof(int16_t));
+        }
+        if (s_bench.out != NULL) {
+            fwrite(play != NULL ? play : s_bench.scratch, sizeof(int16_t), frame, s_bench.out);
+        }
+        if (play != NULL) {
+            audio_ring_read_end(&s_bench.playback);
+        }
+        wait_period(&next);
+    }
+    return NULL;
+}
+
+static size_t encode(const int16_t *pcm, uint8_t *payload)
+{
+    if (s_bench.wideband) {
+        return g722_encode(&s_encoder, pcm, payload, s_bench.frame_samples);
+    }
+    g711_encode(G711_ALAW, pcm, payload, s_bench.frame_samples);
+    return s_bench.frame_samples;
+}
+
+/**
+ * @brief Far end of the loop: decode the packet into a playback slot
+ */
+static void play_packet(const uint8_t *packet, size_t len)
+{
+    rtp_packet_t parsed;
+    int16_t *slot = audio_ring_write_begin(&s_bench.playback);
+    if (slot == NULL || !rtp_packet_parse(packet, len, &parsed)) {
+        return;
+    }
+    if (s_bench.wideband) {
+        g722_decode(&s_decoder, parsed.payload, slot, parsed.payload_len);
+    } else {
+        g711_decode(G711_ALAW, parsed.payload, slot, parsed.payload_len);
+    }
+    agc_process(&s_playout_agc, slot, s_bench.frame_samples);
+    echo_canceller_far_end(&s_echo, slot, s_bench.frame_samples);
+    audio_ring_write_end(&s_bench.playback, now_us());
+}
+
+/**
+ * @brief What the RTP task does with one microphone frame
+ */
+static void process_frame(void)
+{
+    const size_t frame = s_bench.frame_samples;
+    int64_t captured_us;
+    int16_t *pcm = audio_ring_read_begin(&s_bench.capture, &captured_us);
+    if (pcm == NULL) {
+        return;
+    }
+
+    double t0 = now_ns();
+    echo_canceller_process(&s_echo, pcm, pcm, frame);
+    double t1 = now_ns();
+    noise_suppressor_process(&s_noise, pcm, pcm, frame);
+    double t2 = now_ns();
+    agc_process(&s_capture_agc, pcm, frame);
+    double t3 = now_ns();
+    size_t payload_len = encode(pcm, s_packet + RTP_HEADER_SIZE);
+    audio_ring_read_end(&s_bench.capture);
+    size_t len = rtp_sender_finish(&s_sender, s_packet, s_bench.wideband ? RTP_PT_G722 : RTP_PT_PCMA,
+                                   s_sender.packets == 0, payload_len,
+                                   s_bench.wideband ? frame / 2 : frame);
+    double t4 = now_ns();
+
+    // The packet is ready for sendto()
+    double latency_us = (double)(now_us() - captured_us);
+    s_latency_sum_us += latency_us;
+    s_latency_max_us = latency_us > s_latency_max_us ? latency_us : s_latency_max_us;
+    s_frames++;
+
+    play_packet(s_packet, len);
+    double t5 = now_ns();
+
+    s_stage_ns[STAGE_ECHO] += t1 - t0;
+    s_stage_ns[STAGE_NOISE] += t2 - t1;
+    s_stage_ns[STAGE_GAIN] += t3 - t2;
+    s_stage_ns[STAGE_ENCODE] += t4 - t3;
+    s_stage_ns[STAGE_DECODE] += t5 - t4;
+}
+
+static void *chain_thread(void *arg)
+{
+    (void)arg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    int drain = BENCH_DRAIN_FRAMES;
+
+    while (drain > 0) {
+        process_frame();
+        if (s_bench.input_done && audio_ring_count(&s_bench.capture) == 0) {
+            drain--;
+        }
+        wait_period(&next);
+    }
+    s_bench.running = false;
+    return NULL;
+}
+
+static void print_ring(FILE *report, const char *name, const audio_ring_t *ring)
+{
+    fprintf(report, "%-9s written %6lu  read %6lu  overruns %4lu  underruns %4lu  high water %lu/%d\n", name,
+           (unsigned long)ring->stats.frames_written, (unsigned long)ring->stats.frames_read,
+           (unsigned long)ring->stats.overruns, (unsigned long)ring->stats.underruns,
+           (unsigned long)ring->stats.high_water, AUDIO_RING_FRAMES);
+}
+
+int main(int argc, char **argv)
+{
+    int level_db = NOISE_SUPPRESSOR_LEVEL_DB;
+    int period_ms = BENCH_FRAME_MS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "wn:p:")) != -1) {
+        switch (opt) {
+        case 'w':
+            s_bench.wideband = true;
+            break;
+        case 'n':
+            level_db = atoi(optarg);
+            break;
+        case 'p':
+            period_ms = atoi(optarg);
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind >= argc || optind + 2 < argc || period_ms < 1) {
+        fprintf(stderr, "usage: %s [-w] [-n level_db] [-p period_ms] in.raw|- [out.raw|-]\n", argv[0]);
+        return 1;
+    }
+
+    const uint32_t rate = s_bench.wideband ? 16000 : 8000;
+    s_bench.frame_samples = (uint16_t)(rate * BENCH_FRAME_MS / 1000);
+    s_bench.period_ns = period_ms * 1000000L;
+    s_bench.in = strcmp(argv[optind], "-") == 0 ? stdin : fopen(argv[optind], "rb");
+    if (s_bench.in == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (optind + 1 < argc) {
+        s_bench.out = strcmp(argv[optind + 1], "-") == 0 ? stdout : fopen(argv[optind + 1], "wb");
+        if (s_bench.out == NULL) {
+            perror(argv[optind + 1]);
+            return 1;
+        }
+    }
+
+    g711_init();
+    g722_init(&s_encoder);
+    g722_init(&s_decoder);
+    rtp_sender_init(&s_sender, 0x5eed, 1, 0);
+    if (!audio_ring_init(&s_bench.capture, s_bench.frame_samples) ||
+        !audio_ring_init(&s_bench.playback, s_bench.frame_samples) ||
+        !echo_canceller_init(&s_echo, rate) ||
+        !noise_suppressor_init(&s_noise, rate, (uint8_t)level_db) ||
+        !agc_init(&s_capture_agc, rate, BENCH_CAPTURE_TARGET, BENCH_CAPTURE_GAIN) ||
+        !agc_init(&s_playout_agc, rate, BENCH_PLAYOUT_TARGET, BENCH_PLAYOUT_GAIN)) {
+        fprintf(stderr, "bad settings\n");
+        return 1;
+    }
+
+    pthread_t device;
+    pthread_t chain;
+    s_bench.running = true;
+    pthread_create(&device, NULL, device_thread, NULL);
+    pthread_create(&chain, NULL, chain_thread, NULL);
+    pthread_join(chain, NULL);
+    pthread_join(device, NULL);
+
+    // Report on stderr, so the output can be a pipe
+    FILE *report = stderr;
+    fprintf(report, "%lu frames of %d ms at %lu Hz, %s, tick %d ms\n", (unsigned long)s_frames,
+            BENCH_FRAME_MS, (unsigned long)rate, s_bench.wideband ? "G.722" : "PCMA", period_ms);
+    if (s_frames > 0) {
+        fprintf(report, "mouth to network: mean %.0f us, max %.0f us\n",
+                s_latency_sum_us / s_frames, s_latency_max_us);
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            fprintf(report, "  %-11s %8.1f us per frame\n", s_stage_names[i], s_stage_ns[i] / 1000 / s_frames);
+        }
+    }
+    print_ring(report, "capture", &s_bench.capture);
+    print_ring(report, "playback", &s_bench.playback);
+
+    if (s_bench.in != stdin) {
+        fclose(s_bench.in);
+    }
+    if (s_bench.out != NULL && s_bench.out != stdout) {
+        fclose(s_bench.out);
+    }
+    return 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * Host benchmark of the audio codecs: encode and decode cost per 20 ms
+ * frame and round-trip SNR, for G.711 and G.722 on the same signal.
+ *
+ * Build and run on Linux from the repository root:
+ *
+ *   gcc -O2 -Imain -o codec_bench tools/codec_bench.c main/g711.c main/g722.c -lm
+ *   ./codec_bench [input.raw]
+ *
+ * input.raw is 16-bit little-endian mono PCM at 16 kHz, e.g. from
+ * "sox speech.wav -r 16000 -c 1 -b 16 -e signed input.raw". Without it
+ * a sweep from 100 Hz to 7 kHz is generated. G.711 gets the signal
+ * halved to 8 kHz by averaging pairs and is measured against that.
+ * Cycles are read from the time stamp counter on x86 and are only a
+ * relative measure for the ESP32-S3; the firmware reports the real cost
+ * as codec_us in the RTP engine counters.
+ */
+#include "g711.h"
+#include "g722.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#endif
+
+#define BENCH_WIDEBAND_FRAME    320
+#define BENCH_NARROWBAND_FRAME  160
+#define BENCH_MAX_SAMPLES       (16000 * 60)
+#define BENCH_G722_DELAY        22      // Samples the G.722 QMF pair adds
+
+static int16_t s_wideband[BENCH_MAX_SAMPLES];
+static int16_t s_narrowband[BENCH_MAX_SAMPLES / 2];
+static int16_t s_decoded[BENCH_MAX_SAMPLES];
+
+typedef struct {
+    double encode_ns;
+    double decode_ns;
+    unsigned long long cycles;
+    unsigned long frames;
+} bench_cost_t;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned long long now_cycles(void)
+{
+#ifdef HAVE_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static size_t generate(void)
+{
+    // 10 s logarithmic sweep at -9 dBFS
+    size_t n = 16000 * 10;
+    double phase = 0;
+    for (size_t i = 0; i < n; i++) {
+        double hz = 100 * pow(70.0, (double)i / n);
+        phase += 2 * M_PI * hz / 16000;
+        s_wideband[i] = (int16_t)(11600 * sin(phase));
+    }
+    return n;
+}
+
+static double snr_db(const int16_t *ref, const int16_t *out, size_t samples, size_t delay)
+{
+    double signal = 0;
+    double noise = 0;
+    for (size_t i = 0; i + delay < samples; i++) {
+        double error = (double)out[i + delay] - ref[i];
+        signal += (double)ref[i] * ref[i];
+        noise += error * error;
+    }
+    return noise > 0 ? 10 * log10(signal / noise) : INFINITY;
+}
+
+static void report(const char *name, const bench_cost_t *cost, double snr, const char *note)
+{
+    double total_ns = (cost->encode_ns + cost->decode_ns) / cost->frames;
+    printf("%-5s encode %6.0f ns  decode %6.0f ns  %6.3f%% of a frame", name,
+           cost->encode_ns / cost->frames, cost->decode_ns / cost->frames, total_ns / 20e6 * 100);
+#ifdef HAVE_CYCLES
+    printf("  %6llu cycles", cost->cycles / cost->frames);
+#endif
+    printf("  SNR %5.1f dB%s\n", snr, note);
+}
+
+static void bench_g711(g711_law_t law, size_t samples, bench_cost_t *cost)
+{
+    uint8_t payload[BENCH_NARROWBAND_FRAME];
+
+    memset(cost, 0, sizeof(*cost));
+    for (size_t i = 0; i + BENCH_NARROWBAND_FRAME <= samples; i += BENCH_NARROWBAND_FRAME) {
+        unsigned long long c0 = now_cycles();
+        double t0 = now_ns();
+        g711_encode(law, s_narrowband + i, payload, BENCH_NARROWBAND_FRAME);
+        double t1 = now_ns();
+        g711_decode(law, payload, s_decoded + i, BENCH_NARROWBAND_FRAME);
+        double t2 = now_ns();
+        cost->cycles += now_cycles() - c0;
+        cost->encode_ns += t1 - t0;
+        cost->decode_ns += t2 - t1;
+        cost->frames++;
+    }
+}
+
+static void bench_g722(size_t samples, bench_cost_t *cost)
+{
+    uint8_t payload[BENCH_WIDEBAND_FRAME / 2];
+    g722_state_t encoder;
+    g722_state_t decoder;
+
+    g722_init(&encoder);
+    g722_init(&decoder);
+    memset(cost, 0, sizeof(*cost));
+    for (size_t i = 0; i + BENCH_WIDEBAND_FRAME <= samples; i += BENCH_WIDEBAND_FRAME) {
+        unsigned long long c0 = now_cycles();
+        double t0 = now_ns();
+        size_t len = g722_encode(&encoder, s_wideband + i, payload, BENCH_WIDEBAND_FRAME);
+        double t1 = now_ns();
+        g722_decode(&decoder, payload, s_decoded + i, len);
+        double t2 = now_ns();
+        cost->cycles += now_cycles() - c0;
+        cost->encode_ns += t1 - t0;
+        cost->decode_ns += t2 - t1;
+        cost->frames++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t samples;
+
+    if (argc > 1) {
+        FILE *in = fopen(argv[1], "rb");
+        if (in == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+        samples = fread(s_wideband, sizeof(int16_t), BENCH_MAX_SAMPLES, in);
+        fclose(in);
+    } else {
+        samples = generate();
+    }
+    samples -= samples % BENCH_WIDEBAND_FRAME;
+    if (samples == 0) {
+        fprintf(stderr, "no samples\n");
+        return 1;
+    }
+
+    size_t narrow_samples = samples / 2;
+    for (size_t i = 0; i < narrow_samples; i++) {
+        s_narrowband[i] = (int16_t)((s_wideband[2 * i] + s_wideband[2 * i + 1]) / 2);
+    }
+
+    g711_init();
+    printf("%lu frames (%.1f s of audio), 20 ms each\n", (unsigned long)(samples / BENCH_WIDEBAND_FRAME),
+           samples / 16000.0);
+
+    bench_cost_t cost;
+    static const struct {
+        const char *name;
+        g711_law_t law;
+    } laws[] = { { "PCMU", G711_ULAW }, { "PCMA", G711_ALAW } };
+    for (size_t i = 0; i < sizeof(laws) / sizeof(laws[0]); i++) {
+        bench_g711(laws[i].law, narrow_samples, &cost);
+        report(laws[i].name, &cost, snr_db(s_narrowband, s_decoded, narrow_samples, 0), " (8 kHz)");
+    }
+
+    bench_g722(samples, &cost);
+    report("G722", &cost, snr_db(s_wideband, s_decoded, samples, BENCH_G722_DELAY), " (16 kHz)");
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Host benchmark of the in-band DTMF detector: cost per 20 ms frame and
+ * the digits it finds.
+ *
+ * Build and run on Linux from the repository root:
+ *
+ *   gcc -O2 -Imain -o dtmf_bench tools/dtmf_bench.c main/dtmf_detect.c -lm
+ *   ./dtmf_bench [input.raw]
+ *
+ * input.raw is 16-bit little-endian mono PCM at 8 kHz. Without it a
+ * signal of keys 0-9, * and # between stretches of noise is generated.
+ * Cycles are read from the time stamp counter on x86 and are only a
+ * relative measure for the ESP32-S3.
+ */
+#include "dtmf_detect.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#endif
+
+#define BENCH_FRAME_SAMPLES 160
+#define BENCH_MAX_SAMPLES   (8000 * 60)
+
+static int16_t s_pcm[BENCH_MAX_SAMPLES];
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static size_t generate(void)
+{
+    static const float row_hz[4] = { 697, 770, 852, 941 };
+    static const float col_hz[4] = { 1209, 1336, 1477, 1633 };
+    static const char keypad[] = "123A456B789C*0#D";
+    static const char keys[] = "1234567890*#";
+    size_t n = 0;
+
+    srand(1);
+    for (const char *key = keys; *key != '\0'; key++) {
+        // 200 ms of noise, then 80 ms of the key
+        for (int i = 0; i < 1600; i++) {
+            s_pcm[n++] = (int16_t)((rand() % 4001) - 2000);
+        }
+        int index = (int)(strchr(keypad, *key) - keypad);
+        for (int i = 0; i < 640; i++, n++) {
+            float t = (float)i / DTMF_DETECT_SAMPLE_RATE;
+            s_pcm[n] = (int16_t)(7000 * sinf(2 * (float)M_PI * row_hz[index / 4] * t) +
+                                 7000 * sinf(2 * (float)M_PI * col_hz[index % 4] * t));
+        }
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    size_t samples;
+
+    if (argc > 1) {
+        FILE *in = fopen(argv[1], "rb");
+        if (in == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+        samples = fread(s_pcm, sizeof(int16_t), BENCH_MAX_SAMPLES, in);
+        fclose(in);
+    } else {
+        samples = generate();
+    }
+
+    dtmf_detector_t detector;
+    dtmf_detector_init(&detector);
+    char digits[64];
+    size_t digit_count = 0;
+    unsigned long frames = 0;
+    double total_ns = 0;
+    double worst_ns = 0;
+#ifdef HAVE_CYCLES
+    unsigned long long total_cycles = 0;
+    unsigned long long worst_cycles = 0;
+#endif
+
+    for (size_t i = 0; i + BENCH_FRAME_SAMPLES <= samples; i += BENCH_FRAME_SAMPLES) {
+        double t0 = now_ns();
+#ifdef HAVE_CYCLES
+        unsigned long long c0 = __rdtsc();
+#endif
+        char digit = dtmf_detector_process(&detector, s_pcm + i, BENCH_FRAME_SAMPLES);
+#ifdef HAVE_CYCLES
+        unsigned long long cycles = __rdtsc() - c0;
+        total_cycles += cycles;
+        if (cycles > worst_cycles) {
+            worst_cycles = cycles;
+        }
+#endif
+        double ns = now_ns() - t0;
+        total_ns += ns;
+        if (ns > worst_ns) {
+            worst_ns = ns;
+        }
+        if (digit != '\0' && digit_count < sizeof(digits) - 1) {
+            digits[digit_count++] = digit;
+        }
+        frames++;
+    }
+    digits[digit_count] = '\0';
+
+    if (frames == 0) {
+        fprintf(stderr, "no samples\n");
+        return 1;
+    }
+    printf("%lu frames, digits \"%s\"\n", frames, digits);
+    printf("%.0f ns/frame average, %.0f ns worst\n", total_ns / frames, worst_ns);
+#ifdef HAVE_CYCLES
+    printf("%llu cycles/frame average, %llu worst\n", total_cycles / frames, worst_cycles);
+#endif
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * Host tool for the noise suppressor: cleans a WAV recording and measures
+ * the cost per 20 ms frame.
+ *
+ * Build and run on Linux from the repository root:
+ *
+ *   gcc -O2 -Imain -o ns_bench tools/ns_bench.c main/noise_suppressor.c -lm
+ *   ./ns_bench [-l level_db] [in.wav [out.wav]]
+ *
+ * The recording is 16-bit mono WAV at 8 or 16 kHz, for example a street
+ * recorded with the door station microphone. Without one, two seconds of
+ * noise are followed by tone bursts over the same noise, and the SNR gain
+ * against the clean bursts is reported. out.wav is aligned with in.wav,
+ * the stage delay removed. The host build uses the portable FFT; cycles
+ * are read from the time stamp counter on x86 and are only a relative
+ * measure for the ESP32-S3.
+ */
+#include "noise_suppressor.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#endif
+
+#define BENCH_FRAME_MS      20
+#define BENCH_MAX_SAMPLES   (16000 * 120)
+
+static int16_t s_clean[BENCH_MAX_SAMPLES];
+static int16_t s_in[BENCH_MAX_SAMPLES];
+static int16_t s_out[BENCH_MAX_SAMPLES];
+static noise_suppressor_t s_ns;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t read_le(const uint8_t *p, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Load a 16-bit mono WAV file
+ *
+ * @return Samples read, 0 on error
+ */
+static size_t read_wav(const char *path, int16_t *pcm, uint32_t *rate)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        perror(path);
+        return 0;
+    }
+    uint8_t header[12];
+    uint8_t chunk[8];
+    size_t samples = 0;
+    bool format_ok = false;
+
+    if (fread(header, 1, sizeof(header), in) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        fclose(in);
+        return 0;
+    }
+    while (fread(chunk, 1, sizeof(chunk), in) == sizeof(chunk)) {
+        uint32_t size = read_le(chunk + 4, 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < sizeof(fmt) || fread(fmt, 1, sizeof(fmt), in) != sizeof(fmt)) {
+                break;
+            }
+            fseek(in, (long)(size - sizeof(fmt) + (size & 1)), SEEK_CUR);
+            *rate = read_le(fmt + 4, 4);
+            format_ok = read_le(fmt, 2) == 1 && read_le(fmt + 2, 2) == 1 && read_le(fmt + 14, 2) == 16;
+        } else if (memcmp(chunk, "data", 4) == 0 && format_ok) {
+            size_t wanted = size / sizeof(int16_t);
+            samples = fread(pcm, sizeof(int16_t), wanted < BENCH_MAX_SAMPLES ? wanted : BENCH_MAX_SAMPLES, in);
+            break;
+        } else {
+            fseek(in, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    fclose(in);
+    if (!format_ok) {
+        fprintf(stderr, "%s: not 16-bit mono PCM\n", path);
+    }
+    return samples;
+}
+
+static void write_wav(const char *path, const int16_t *pcm, size_t samples, uint32_t rate)
+{
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        perror(path);
+        return;
+    }
+    uint32_t data = (uint32_t)(samples * sizeof(int16_t));
+    uint8_t header[44] = "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\0\0\0\0\0\0\0\0\x02\0\x10\0data";
+    uint32_t fields[][2] = { { 4, 36 + data }, { 24, rate }, { 28, rate * 2 }, { 40, data } };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        for (int b = 0; b < 4; b++) {
+            header[fields[i][0] + b] = (uint8_t)(fields[i][1] >> (8 * b));
+        }
+    }
+    fwrite(header, 1, sizeof(header), out);
+    fwrite(pcm, sizeof(int16_t), samples, out);
+    fclose(out);
+}
+
+/**
+ * @brief Noise, then speech-like bursts over it; the bursts alone go to s_clean
+ */
+static size_t generate(uint32_t rate)
+{
+    size_t n = rate * 10;
+    float low = 0;
+
+    srand(1);
+    for (size_t i = 0; i < n; i++) {
+        // White noise plus a low rumble, roughly traffic
+        low += 0.05f * ((float)(rand() % 20001 - 10000) - low);
+        float noise = (float)(rand() % 2001 - 1000) + 2.0f * low;
+        float t = (float)i / rate;
+        bool burst = t >= 2.0f && fmodf(t, 1.0f) < 0.6f;
+        float pitch = 140.0f + 20.0f * sinf(2 * (float)M_PI * 0.5f * t);
+        float speech = 0;
+        for (int h = 1; h <= 8 && burst; h++) {
+            speech += 4000.0f / h * sinf(2 * (float)M_PI * pitch * h * t);
+        }
+        s_clean[i] = (int16_t)speech;
+        s_in[i] = (int16_t)(speech + noise);
+    }
+    return n;
+}
+
+static double energy_db(const int16_t *pcm, size_t from, size_t to)
+{
+    double energy = 1;
+    for (size_t i = from; i < to; i++) {
+        energy += (double)pcm[i] * pcm[i];
+    }
+    return 10 * log10(energy);
+}
+
+static double snr_db(const int16_t *pcm, size_t samples)
+{
+    double speech = 1;
+    double noise = 1;
+    for (size_t i = 0; i < samples; i++) {
+        double residual = (double)pcm[i] - s_clean[i];
+        speech += (double)s_clean[i] * s_clean[i];
+        noise += residual * residual;
+    }
+    return 10 * log10(speech / noise);
+}
+
+int main(int argc, char **argv)
+{
+    int level_db = NOISE_SUPPRESSOR_LEVEL_DB;
+    uint32_t rate = 8000;
+    size_t samples;
+    bool synthetic = true;
+
+    if (argc > 2 && strcmp(argv[1], "-l") == 0) {
+        level_db = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc > 1) {
+        samples = read_wav(argv[1], s_in, &rate);
+        if (samples == 0) {
+            return 1;
+        }
+        synthetic = false;
+    } else {
+        samples = generate(rate);
+    }
+    if (level_db < 0 || !noise_suppressor_init(&s_ns, rate, (uint8_t)level_db)) {
+        fprintf(stderr, "unsupported rate %u or level %d\n", (unsigned)rate, level_db);
+        return 1;
+    }
+
+    size_t frame = rate * BENCH_FRAME_MS / 1000;
+    size_t delay = rate * NOISE_SUPPRESSOR_DELAY_MS / 1000;
+    unsigned long frames = 0;
+    double total_ns = 0;
+    double worst_ns = 0;
+#ifdef HAVE_CYCLES
+    unsigned long long total_cycles = 0;
+    unsigned long long worst_cycles = 0;
+#endif
+
+    samples -= samples % frame;
+    for (size_t i = 0; i < samples; i += frame) {
+        double t0 = now_ns();
+#ifdef HAVE_CYCLES
+        unsigned long long c0 = __rdtsc();
+#endif
+        noise_suppressor_process(&s_ns, s_in + i, s_out + i, frame);
+#ifdef HAVE_CYCLES
+        unsigned long long cycles = __rdtsc() - c0;
+        total_cycles += cycles;
+        worst_cycles = cycles > worst_cycles ? cycles : worst_cycles;
+#endif
+        double ns = now_ns() - t0;
+        total_ns += ns;
+        worst_ns = ns > worst_ns ? ns : worst_ns;
+        frames++;
+    }
+    if (frames == 0 || samples <= delay) {
+        fprintf(stderr, "no samples\n");
+        return 1;
+    }
+    // Line the output up with the input
+    samples -= delay;
+    memmove(s_out, s_out + delay, samples * sizeof(int16_t));
+    if (argc > 2) {
+        write_wav(argv[2], s_out, samples, rate);
+    }
+
+    printf("%lu frames of %d ms at %u Hz, level %d dB, %u-point FFT\n", frames, BENCH_FRAME_MS,
+           (unsigned)rate, level_db, (unsigned)s_ns.fft_size);
+    printf("level reduced by %.1f dB overall\n", noise_suppressor_reduction_db(&s_ns));
+    if (synthetic) {
+        size_t noise_end = 2 * rate - delay;
+        printf("noise alone reduced by %.1f dB after the first second\n",
+               energy_db(s_in, rate, noise_end) - energy_db(s_out, rate, noise_end));
+        printf("SNR %.1f dB in, %.1f dB out\n", snr_db(s_in, samples), snr_db(s_out, samples));
+    }
+    printf("%.0f ns/frame average, %.0f ns worst\n", total_ns / frames, worst_ns);
+#ifdef HAVE_CYCLES
+    printf("%llu cycles/frame average, %llu worst\n", total_cycles / frames, worst_cycles);
+#endif
+    return 0;
+}
@@ -0,0 +1,427 @@
+/*
+ * Host benchmark of packet loss concealment: a WAV recording is encoded
+ * as the far end would, packets are dropped by a loss pattern, and the
+ * rest is decoded with concealment and with silence in the gaps. Both
+ * are scored against the decode without loss, and the cost of received
+ * and concealed frames is measured.
+ *
+ * Build and run on Linux from the repository root:
+ *
+ *   gcc -O2 -Imain -o plc_bench tools/plc_bench.c main/plc.c main/g711.c main/g722.c -lm
+ *   ./plc_bench [-l loss_percent] [-b burst_frames] [-s seed] [-p pattern] [-w] [in.wav [out.wav]]
+ *
+ * The recording is 16-bit mono WAV, 8 kHz for G.711 or 16 kHz for G.722.
+ * Without one, a voiced talker is generated, at 16 kHz with -w. Losses
+ * follow a two-state Gilbert model with the given mean rate and burst
+ * length (10% and 1.5 by default), or a pattern such as "....X..XX"
+ * repeated over the file, one character per 20 ms packet. out.wav is the
+ * concealed decode, aligned with in.wav.
+ *
+ * Scores, over frames where the talker is active: the log-spectral
+ * distance of lost frames to the loss-free decode (how well the talker
+ * is kept), and the steepest step between samples at the edges of
+ * losses relative to the loss-free decode at the same place (clicks,
+ * 1 is none). Cycles are read from the time stamp counter on x86 and are
+ * only a relative measure for the ESP32-S3.
+ */
+#include "g711.h"
+#include "g722.h"
+#include "plc.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#endif
+
+#define BENCH_FRAME_MS      20
+#define BENCH_MAX_SAMPLES   (16000 * 120)
+#define BENCH_MAX_FRAMES    (BENCH_MAX_SAMPLES / 160)
+#define BENCH_MAX_FRAME     320
+#define BENCH_EDGE          20      // Samples either side of a loss edge checked for clicks
+#define BENCH_ACTIVE_POWER  (32768.0 * 32768.0 * 1e-4)     // -40 dBFS: frames scored
+
+static int16_t s_in[BENCH_MAX_SAMPLES];
+static int16_t s_reference[BENCH_MAX_SAMPLES];
+static int16_t s_concealed[BENCH_MAX_SAMPLES];
+static int16_t s_silent[BENCH_MAX_SAMPLES];
+static uint8_t s_payload[BENCH_MAX_SAMPLES];
+static bool s_lost[BENCH_MAX_FRAMES];
+
+typedef struct {
+    double total_ns;
+    double worst_ns;
+    unsigned long frames;
+#ifdef HAVE_CYCLES
+    unsigned long long total_cycles;
+#endif
+} cost_t;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t read_le(const uint8_t *p, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Load a 16-bit mono WAV file
+ *
+ * @return Samples read, 0 on error
+ */
+static size_t read_wav(const char *path, int16_t *pcm, uint32_t *rate)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        perror(path);
+        return 0;
+    }
+    uint8_t header[12];
+    uint8_t chunk[8];
+    size_t samples = 0;
+    bool format_ok = false;
+
+    if (fread(header, 1, sizeof(header), in) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        fclose(in);
+        return 0;
+    }
+    while (fread(chunk, 1, sizeof(chunk), in) == sizeof(chunk)) {
+        uint32_t size = read_le(chunk + 4, 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < sizeof(fmt) || fread(fmt, 1, sizeof(fmt), in) != sizeof(fmt)) {
+                break;
+            }
+            fseek(in, (long)(size - sizeof(fmt) + (size & 1)), SEEK_CUR);
+            *rate = read_le(fmt + 4, 4);
+            format_ok = read_le(fmt, 2) == 1 && read_le(fmt + 2, 2) == 1 && read_le(fmt + 14, 2) == 16;
+        } else if (memcmp(chunk, "data", 4) == 0 && format_ok) {
+            size_t wanted = size / sizeof(int16_t);
+            samples = fread(pcm, sizeof(int16_t), wanted < BENCH_MAX_SAMPLES ? wanted : BENCH_MAX_SAMPLES, in);
+            break;
+        } else {
+            fseek(in, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    fclose(in);
+    if (!format_ok) {
+        fprintf(stderr, "%s: not 16-bit mono PCM\n", path);
+    }
+    return samples;
+}
+
+static void write_wav(const char *path, const int16_t *pcm, size_t samples, uint32_t rate)
+{
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        perror(path);
+        return;
+    }
+    uint32_t data = (uint32_t)(samples * sizeof(int16_t));
+    uint8_t header[44] = "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\0\0\0\0\0\0\0\0\x02\0\x10\0data";
+    uint32_t fields[][2] = { { 4, 36 + data }, { 24, rate }, { 28, rate * 2 }, { 40, data } };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        for (int b = 0; b < 4; b++) {
+            header[fields[i][0] + b] = (uint8_t)(fields[i][1] >> (8 * b));
+        }
+    }
+    fwrite(header, 1, sizeof(header), out);
+    fwrite(pcm, sizeof(int16_t), samples, out);
+    fclose(out);
+}
+
+/**
+ * @brief Ten seconds of voiced syllables with a gliding pitch
+ */
+static size_t generate(uint32_t rate)
+{
+    size_t n = rate * 10;
+
+    srand(1);
+    for (size_t i = 0; i < n; i++) {
+        float t = (float)i / rate;
+        float pitch = 120 + 30 * sinf(2 * (float)M_PI * 0.7f * t);
+        float syllable = fmodf(t, 0.3f) < 0.24f ? sinf((float)M_PI * fmodf(t, 0.3f) / 0.24f) : 0;
+        float voice = sinf(2 * (float)M_PI * pitch * t) + 0.5f * sinf(4 * (float)M_PI * pitch * t) +
+                      0.25f * sinf(6 * (float)M_PI * pitch * t);
+        s_in[i] = (int16_t)(8000 * syllable * voice + rand() % 21 - 10);
+    }
+    return n;
+}
+
+/**
+ * @brief Two-state Gilbert model: losses come in bursts of the given mean length
+ */
+static void gilbert_losses(size_t frames, double loss_percent, double burst)
+{
+    double leave_bad = 1 / burst;
+    double enter_bad = loss_percent / 100 * leave_bad / (1 - loss_percent / 100);
+    bool bad = false;
+
+    for (size_t f = 0; f < frames; f++) {
+        double draw = (double)rand() / RAND_MAX;
+        bad = bad ? draw >= leave_bad : draw < enter_bad;
+        s_lost[f] = bad;
+    }
+}
+
+static void pattern_losses(size_t frames, const char *pattern)
+{
+    size_t len = strlen(pattern);
+    for (size_t f = 0; f < frames; f++) {
+        s_lost[f] = pattern[f % len] == 'X' || pattern[f % len] == 'x';
+    }
+}
+
+/**
+ * @brief Decode the packets in order, concealing the lost ones or leaving them silent
+ */
+static void decode(uint32_t rate, size_t frames, bool lossy, bool conceal, int16_t *out, cost_t *received,
+                   cost_t *concealed)
+{
+    const size_t frame = rate * BENCH_FRAME_MS / 1000;
+    const size_t bytes = rate == 8000 ? frame : frame / 2;
+    int16_t synthesis[BENCH_MAX_FRAME + G722_CONCEAL_LOOKAHEAD];
+    g722_state_t decoder;
+    plc_t plc;
+
+    g722_init(&decoder);
+    plc_init(&plc, rate);
+    for (size_t f = 0; f < frames; f++) {
+        int16_t *pcm = out + f * frame;
+        bool lost = lossy && s_lost[f];
+        cost_t *cost = lost ? concealed : received;
+        double t0 = now_ns();
+#ifdef HAVE_CYCLES
+        unsigned long long c0 = __rdtsc();
+#endif
+        if (!lost) {
+            if (rate == 8000) {
+                g711_decode(G711_ALAW, s_payload + f * bytes, pcm, frame);
+            } else {
+                g722_decode(&decoder, s_payload + f * bytes, pcm, bytes);
+            }
+            plc_add_frame(&plc, pcm, frame);
+        } else if (conceal) {
+            plc_conceal_frame(&plc, pcm, frame);
+            if (rate != 8000) {
+                plc_synthesis(&plc, synthesis, frame, G722_CONCEAL_LOOKAHEAD);
+                g722_conceal(&decoder, synthesis, frame);
+            }
+        } else {
+            memset(pcm, 0, frame * sizeof(int16_t));
+            plc_add_frame(&plc, pcm, frame);
+        }
+#ifdef HAVE_CYCLES
+        if (cost != NULL) {
+            cost->total_cycles += __rdtsc() - c0;
+        }
+#endif
+        double ns = now_ns() - t0;
+        if (cost != NULL) {
+            cost->total_ns += ns;
+            cost->worst_ns = ns > cost->worst_ns ? ns : cost->worst_ns;
+            cost->frames++;
+        }
+    }
+}
+
+/**
+ * @brief Log-spectral distance in dB of one frame to the loss-free decode
+ */
+static double spectral_distance(const int16_t *out, size_t start, size_t frame)
+{
+    const double floor = 1e-6 * 32768.0 * 32768.0 * frame;     // -60 dB per bin
+    double sum = 0;
+    int bins = 0;
+
+    for (size_t k = 1; k < frame / 2; k++) {
+        double re[2] = { 0, 0 };
+        double im[2] = { 0, 0 };
+        for (size_t n = 0; n < frame; n++) {
+            double window = 0.5 - 0.5 * cos(2 * M_PI * n / frame);
+            double c = window * cos(2 * M_PI * k * n / frame);
+            double s = window * sin(2 * M_PI * k * n / frame);
+            re[0] += c * s_reference[start + n];
+            im[0] -= s * s_reference[start + n];
+            re[1] += c * out[start + n];
+            im[1] -= s * out[start + n];
+        }
+        double difference = 10 * log10(re[0] * re[0] + im[0] * im[0] + floor) -
+                            10 * log10(re[1] * re[1] + im[1] * im[1] + floor);
+        sum += difference * difference;
+        bins++;
+    }
+    return sqrt(sum / bins);
+}
+
+static int largest_step(const int16_t *pcm, size_t from, size_t to)
+{
+    int largest = 0;
+    for (size_t i = from < 1 ? 1 : from; i < to; i++) {
+        int step = abs(pcm[i] - pcm[i - 1]);
+        largest = step > largest ? step : largest;
+    }
+    return largest;
+}
+
+static bool talking(size_t start, size_t frame)
+{
+    double energy = 0;
+    for (size_t n = 0; n < frame; n++) {
+        energy += (double)s_reference[start + n] * s_reference[start + n];
+    }
+    return energy / frame > BENCH_ACTIVE_POWER;
+}
+
+static void score(const char *name, const int16_t *out, size_t frames, size_t frame, size_t delay)
+{
+    const size_t end = frames * frame;
+    double distance = 0;
+    double clicks = 0;
+    int lost = 0;
+    int edges = 0;
+
+    for (size_t f = 1; f < frames; f++) {
+        size_t start = f * frame + delay;
+        if (start + frame > end || !talking(start, frame)) {
+            continue;
+        }
+        if (s_lost[f]) {
+            distance += spectral_distance(out, start, frame);
+            lost++;
+        }
+        if (s_lost[f] != s_lost[f - 1]) {
+            // Steepest step at the edge against the loss-free decode at the same place
+            clicks += (double)largest_step(out, start - BENCH_EDGE, start + BENCH_EDGE) /
+                      (largest_step(s_reference, start - BENCH_EDGE, start + BENCH_EDGE) + 1);
+            edges++;
+        }
+    }
+    printf("%-10s spectral distance %5.1f dB   edge steps %5.2f x loss-free\n", name,
+           lost > 0 ? distance / lost : 0, edges > 0 ? clicks / edges : 0);
+}
+
+static void print_cost(const char *name, const cost_t *cost)
+{
+    if (cost->frames == 0) {
+        return;
+    }
+    printf("%-10s %6lu frames  %7.0f ns/frame average  %7.0f ns worst", name, cost->frames,
+           cost->total_ns / cost->frames, cost->worst_ns);
+#ifdef HAVE_CYCLES
+    printf("  %7llu cycles/frame", cost->total_cycles / cost->frames);
+#endif
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    double loss_percent = 10;
+    double burst = 1.5;
+    const char *pattern = NULL;
+    uint32_t rate = 8000;
+    size_t samples;
+
+    srand(1);
+    while (argc > 1 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-w") == 0) {
+            rate = 16000;
+            argc -= 1;
+            argv += 1;
+            continue;
+        }
+        if (argc < 3) {
+            fprintf(stderr, "%s needs a value\n", argv[1]);
+            return 1;
+        }
+        if (strcmp(argv[1], "-l") == 0) {
+            loss_percent = atof(argv[2]);
+        } else if (strcmp(argv[1], "-b") == 0) {
+            burst = atof(argv[2]);
+        } else if (strcmp(argv[1], "-s") == 0) {
+            srand((unsigned)atoi(argv[2]));
+        } else if (strcmp(argv[1], "-p") == 0) {
+            pattern = argv[2];
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[1]);
+            return 1;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    if (loss_percent < 0 || loss_percent >= 100 || burst < 1) {
+        fprintf(stderr, "loss must be 0 to 99%%, bursts at least 1 frame\n");
+        return 1;
+    }
+    if (argc > 1) {
+        samples = read_wav(argv[1], s_in, &rate);
+        if (samples == 0) {
+            return 1;
+        }
+    } else {
+        samples = generate(rate);
+    }
+    if (rate != 8000 && rate != 16000) {
+        fprintf(stderr, "unsupported rate %u\n", (unsigned)rate);
+        return 1;
+    }
+
+    // The far end: 20 ms packets of G.711 A-law or G.722
+    const size_t frame = rate * BENCH_FRAME_MS / 1000;
+    const size_t frames = samples / frame;
+    g722_state_t encoder;
+    g711_init();
+    g722_init(&encoder);
+    for (size_t f = 0; f < frames; f++) {
+        if (rate == 8000) {
+            g711_encode(G711_ALAW, s_in + f * frame, s_payload + f * frame, frame);
+        } else {
+            g722_encode(&encoder, s_in + f * frame, s_payload + f * frame / 2, frame);
+        }
+    }
+    if (pattern != NULL) {
+        pattern_losses(frames, pattern);
+    } else {
+        gilbert_losses(frames, loss_percent, burst);
+    }
+
+    cost_t received = { 0 };
+    cost_t concealed = { 0 };
+    decode(rate, frames, false, false, s_reference, NULL, NULL);
+    decode(rate, frames, true, true, s_concealed, &received, &concealed);
+    decode(rate, frames, true, false, s_silent, NULL, NULL);
+
+    size_t lost = 0;
+    for (size_t f = 0; f < frames; f++) {
+        lost += s_lost[f];
+    }
+    const size_t delay = PLC_DELAY_8K * rate / 8000;
+    printf("%lu packets of %d ms, %s, %lu lost (%.1f%%)\n", (unsigned long)frames, BENCH_FRAME_MS,
+           rate == 8000 ? "G.711 A-law" : "G.722", (unsigned long)lost, frames > 0 ? 100.0 * lost / frames : 0);
+    score("concealed", s_concealed, frames, frame, delay);
+    score("silence", s_silent, frames, frame, delay);
+    print_cost("received", &received);
+    print_cost("concealed", &concealed);
+
+    if (argc > 2 && frames * frame > delay) {
+        // Line the output up with the input
+        write_wav(argv[2], s_concealed + delay, frames * frame - delay, rate);
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Host benchmark of the media path: feeds a PCM file through the same
+ * G.711 and RTP code the firmware runs, frame by frame.
+ *
+ * Build and run on Linux from the repository root:
+ *
+ *   gcc -O2 -Imain -o rtp_bench tools/rtp_bench.c main/g711.c main/rtp_packet.c -lm
+ *   ./rtp_bench input.raw [output.raw] [pcmu|pcma]
+ *
+ * input.raw is 16-bit little-endian mono PCM at 8 kHz, e.g. from
+ * "sox speech.wav -r 8000 -c 1 -b 16 -e signed input.raw". The decoded
+ * far-end signal is written to output.raw.
+ */
+#include "g711.h"
+#include "rtp_packet.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_FRAME_SAMPLES 160
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s input.raw [output.raw] [pcmu|pcma]\n", argv[0]);
+        return 1;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    FILE *out = argc > 2 ? fopen(argv[2], "wb") : NULL;
+    g711_law_t law = argc > 3 && strcmp(argv[3], "pcma") == 0 ? G711_ALAW : G711_ULAW;
+    uint8_t payload_type = law == G711_ULAW ? RTP_PT_PCMU : RTP_PT_PCMA;
+
+    g711_init();
+    rtp_sender_t sender;
+    rtp_receiver_t receiver;
+    rtp_sender_init(&sender, 0x5eed5eed, 1, 0);
+    rtp_receiver_init(&receiver);
+
+    int16_t pcm[BENCH_FRAME_SAMPLES];
+    int16_t decoded[BENCH_FRAME_SAMPLES];
+    uint8_t packet[RTP_HEADER_SIZE + BENCH_FRAME_SAMPLES];
+    double encode_ns = 0;
+    double decode_ns = 0;
+    double signal = 0;
+    double noise = 0;
+    unsigned long frames = 0;
+    size_t samples;
+
+    while ((samples = fread(pcm, sizeof(int16_t), BENCH_FRAME_SAMPLES, in)) > 0) {
+        memset(pcm + samples, 0, (BENCH_FRAME_SAMPLES - samples) * sizeof(int16_t));
+
+        double t0 = now_ns();
+        g711_encode(law, pcm, packet + RTP_HEADER_SIZE, BENCH_FRAME_SAMPLES);
+        size_t len = rtp_sender_finish(&sender, packet, payload_type, frames == 0,
+                                       BENCH_FRAME_SAMPLES, BENCH_FRAME_SAMPLES);
+        double t1 = now_ns();
+
+        rtp_packet_t parsed;
+        if (!rtp_packet_parse(packet, len, &parsed) ||
+            !rtp_receiver_update(&receiver, &parsed, parsed.timestamp)) {
+            fprintf(stderr, "frame %lu rejected\n", frames);
+            return 1;
+        }
+        g711_decode(law, parsed.payload, decoded, parsed.payload_len);
+        double t2 = now_ns();
+
+        encode_ns += t1 - t0;
+        decode_ns += t2 - t1;
+        for (size_t i = 0; i < samples; i++) {
+            signal += (double)pcm[i] * pcm[i];
+            noise += (double)(pcm[i] - decoded[i]) * (pcm[i] - decoded[i]);
+        }
+        if (out != NULL) {
+            fwrite(decoded, sizeof(int16_t), samples, out);
+        }
+        frames++;
+    }
+    fclose(in);
+    if (out != NULL) {
+        fclose(out);
+    }
+
+    if (frames == 0) {
+        fprintf(stderr, "no samples\n");
+        return 1;
+    }
+    printf("%s: %lu frames (%.1f s of audio)\n", law == G711_ULAW ? "PCMU" : "PCMA",
+           frames, frames * 0.02);
+    printf("encode+packetize %.0f ns/frame, parse+decode %.0f ns/frame\n",
+           encode_ns / frames, decode_ns / frames);
+    printf("SNR %.1f dB, %lu packets lost\n", noise > 0 ? 10 * log10(signal / noise) : INFINITY,
+           (unsigned long)rtp_receiver_lost(&receiver));
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Host benchmark of silence suppression: the VAD on a WAV recording, the
+ * packets it saves, the comfort noise updates sent and the cost per 20 ms
+ * frame.
+ *
+ * Build and run on Linux from the repository root:
+ *
+ *   gcc -O2 -Imain -o vad_bench tools/vad_bench.c main/vad.c main/comfort_noise.c -lm
+ *   ./vad_bench [in.wav [out.wav]]
+ *
+ * The recording is 16-bit mono WAV at 8 or 16 kHz. Without one, a
+ * visitor is generated who speaks in short phrases over street noise.
+ * Comfort noise is sent the way the RTP engine does: when a talkspurt
+ * ends, once a second and when the noise level moves by 3 dB. out.wav
+ * is what the far end hears, the pauses filled with comfort noise.
+ * Cycles are read from the time stamp counter on x86 and are only a
+ * relative measure for the ESP32-S3.
+ */
+#include "vad.h"
+#include "comfort_noise.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#endif
+
+#define BENCH_FRAME_MS      20
+#define BENCH_REFRESH_MS    1000
+#define BENCH_LEVEL_STEP_DB 3
+#define BENCH_MAX_SAMPLES   (16000 * 120)
+
+static int16_t s_in[BENCH_MAX_SAMPLES];
+static int16_t s_out[BENCH_MAX_SAMPLES];
+static vad_t s_vad;
+static comfort_noise_t s_cn;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t read_le(const uint8_t *p, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Load a 16-bit mono WAV file
+ *
+ * @return Samples read, 0 on error
+ */
+static size_t read_wav(const char *path, int16_t *pcm, uint32_t *rate)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        perror(path);
+        return 0;
+    }
+    uint8_t header[12];
+    uint8_t chunk[8];
+    size_t samples = 0;
+    bool format_ok = false;
+
+    if (fread(header, 1, sizeof(header), in) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        fclose(in);
+        return 0;
+    }
+    while (fread(chunk, 1, sizeof(chunk), in) == sizeof(chunk)) {
+        uint32_t size = read_le(chunk + 4, 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < sizeof(fmt) || fread(fmt, 1, sizeof(fmt), in) != sizeof(fmt)) {
+                break;
+            }
+            fseek(in, (long)(size - sizeof(fmt) + (size & 1)), SEEK_CUR);
+            *rate = read_le(fmt + 4, 4);
+            format_ok = read_le(fmt, 2) == 1 && read_le(fmt + 2, 2) == 1 && read_le(fmt + 14, 2) == 16;
+        } else if (memcmp(chunk, "data", 4) == 0 && format_ok) {
+            size_t wanted = size / sizeof(int16_t);
+            samples = fread(pcm, sizeof(int16_t), wanted < BENCH_MAX_SAMPLES ? wanted : BENCH_MAX_SAMPLES, in);
+            break;
+        } else {
+            fseek(in, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    fclose(in);
+    if (!format_ok) {
+        fprintf(stderr, "%s: not 16-bit mono PCM\n", path);
+    }
+    return samples;
+}
+
+static void write_wav(const char *path, const int16_t *pcm, size_t samples, uint32_t rate)
+{
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        perror(path);
+        return;
+    }
+    uint32_t data = (uint32_t)(samples * sizeof(int16_t));
+    uint8_t header[44] = "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\0\0\0\0\0\0\0\0\x02\0\x10\0data";
+    uint32_t fields[][2] = { { 4, 36 + data }, { 24, rate }, { 28, rate * 2 }, { 40, data } };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        for (int b = 0; b < 4; b++) {
+            header[fields[i][0] + b] = (uint8_t)(fields[i][1] >> (8 * b));
+        }
+    }
+    fwrite(header, 1, sizeof(header), out);
+    fwrite(pcm, sizeof(int16_t), samples, out);
+    fclose(out);
+}
+
+/**
+ * @brief Phrases of voiced syllables with pauses, over street noise
+ */
+static size_t generate(uint32_t rate)
+{
+    size_t n = rate * 20;
+    float rumble = 0;
+
+    srand(1);
+    for (size_t i = 0; i < n; i++) {
+        float t = (float)i / rate;
+        float pitch = 120 + 30 * sinf(2 * (float)M_PI * 0.7f * t);
+        bool phrase = fmodf(t, 5.0f) > 1.5f && fmodf(t, 5.0f) < 3.5f;
+        float syllable = phrase && fmodf(t, 0.25f) < 0.18f ? sinf((float)M_PI * fmodf(t, 0.25f) / 0.18f) : 0;
+        float voice = sinf(2 * (float)M_PI * pitch * t) + 0.5f * sinf(4 * (float)M_PI * pitch * t);
+        rumble = 0.7f * rumble + 0.3f * ((float)rand() / RAND_MAX - 0.5f);
+        s_in[i] = (int16_t)(3000 * syllable * voice / 1.3f + 600 * rumble);
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t rate = 8000;
+    size_t samples;
+
+    if (argc > 1) {
+        samples = read_wav(argv[1], s_in, &rate);
+        if (samples == 0) {
+            return 1;
+        }
+    } else {
+        samples = generate(rate);
+    }
+    if (!vad_init(&s_vad, rate)) {
+        fprintf(stderr, "unsupported rate %u\n", (unsigned)rate);
+        return 1;
+    }
+    comfort_noise_init(&s_cn, 1);
+
+    size_t frame = rate * BENCH_FRAME_MS / 1000;
+    unsigned refresh = BENCH_REFRESH_MS / BENCH_FRAME_MS;
+    unsigned long frames = 0;
+    unsigned long sent = 0;
+    unsigned long cn_sent = 0;
+    unsigned unsent = 0;
+    bool talking = false;
+    uint8_t level = COMFORT_NOISE_MAX_LEVEL;
+    double total_ns = 0;
+    double worst_ns = 0;
+#ifdef HAVE_CYCLES
+    unsigned long long total_cycles = 0;
+    unsigned long long worst_cycles = 0;
+#endif
+
+    samples -= samples % frame;
+    for (size_t i = 0; i < samples; i += frame) {
+        double t0 = now_ns();
+#ifdef HAVE_CYCLES
+        unsigned long long c0 = __rdtsc();
+#endif
+        bool speech = vad_process(&s_vad, s_in + i, frame);
+#ifdef HAVE_CYCLES
+        unsigned long long cycles = __rdtsc() - c0;
+        total_cycles += cycles;
+        worst_cycles = cycles > worst_cycles ? cycles : worst_cycles;
+#endif
+        double ns = now_ns() - t0;
+        total_ns += ns;
+        worst_ns = ns > worst_ns ? ns : worst_ns;
+        frames++;
+
+        if (speech) {
+            memcpy(s_out + i, s_in + i, frame * sizeof(int16_t));
+            sent++;
+            unsent = 0;
+        } else {
+            uint8_t now = vad_noise_level(&s_vad);
+            if (talking || unsent + 1 >= refresh || abs(now - level) >= BENCH_LEVEL_STEP_DB) {
+                uint8_t payload[COMFORT_NOISE_PAYLOAD_SIZE];
+                size_t len = comfort_noise_write(now, payload);
+                comfort_noise_receive(&s_cn, payload, len);
+                level = now;
+                sent++;
+                cn_sent++;
+                unsent = 0;
+            } else {
+                unsent++;
+            }
+            comfort_noise_generate(&s_cn, s_out + i, frame);
+        }
+        talking = speech;
+    }
+    if (frames == 0) {
+        fprintf(stderr, "no samples\n");
+        return 1;
+    }
+    if (argc > 2) {
+        write_wav(argv[2], s_out, samples, rate);
+    }
+
+    printf("%lu frames of %d ms at %u Hz, %.1f%% speech\n", frames, BENCH_FRAME_MS, (unsigned)rate,
+           100.0 * s_vad.speech_frames / frames);
+    printf("%lu packets sent, %lu of them comfort noise, %lu saved (%.1f%%)\n", sent, cn_sent, frames - sent,
+           100.0 * (frames - sent) / frames);
+    printf("noise level -%u dBov\n", (unsigned)vad_noise_level(&s_vad));
+    printf("%.0f ns/frame average, %.0f ns worst\n", total_ns / frames, worst_ns);
+#ifdef HAVE_CYCLES
+    printf("%llu cycles/frame average, %llu worst\n", total_cycles / frames, worst_cycles);
+#endif
+    return 0;
+}